@@ -1,6 +1,7 @@
 #!/bin/bash
 # ESP-IDF Build Script for Peristaltic Pump Tests
 # Usage: ./build.sh test_00_blink [build|flash|monitor|clean]
+#        ./build.sh app [build|flash|monitor|clean]   (production firmware)
 
 set -e
 
@@ -29,6 +30,7 @@ ACTION=${2:-build}
 
 # Map test names to source files
 declare -A TEST_MAP
+TEST_MAP["app"]="main/main.c"
 TEST_MAP["test_00_blink"]="test/test_00_blink/test_00_blink.c"
 TEST_MAP["test_01_buttons"]="test/test_01_buttons/test_01_buttons.c"
 TEST_MAP["test_02_encoder"]="test/test_02_encoder/test_02_encoder.c"
@@ -57,8 +59,18 @@ echo -e "Source: $SOURCE_FILE"
 echo ""
 
 # Copy test file to main/main.c
-echo -e "${YELLOW}Copying test file to main/main.c...${NC}"
-cp "$SOURCE_FILE" main/main.c
+# main/main.c is the production application - keep it and put it back afterwards.
+# A test links main.c alone (APP_BUILD=0 in main/CMakeLists.txt): the tasks
+# and src/ modules need the queues and globals of the production main.c
+APP_BUILD=1
+if [ "$SOURCE_FILE" != "main/main.c" ]; then
+    APP_BUILD=0
+    cp main/main.c main/main.c.app
+    trap 'mv -f main/main.c.app main/main.c' EXIT
+    echo -e "${YELLOW}Copying test file to main/main.c...${NC}"
+    # Tests include ../common/pin_definitions.h relative to test/<name>/; from main/ it is the copy below
+    sed 's|"\.\./common/pin_definitions\.h"|"pin_definitions.h"|' "$SOURCE_FILE" > main/main.c
+fi
 
 # Copy pin definitions
 if [ -f "test/common/pin_definitions.h" ]; then
@@ -68,27 +80,28 @@ fi
 
 echo ""
 
-# Execute ESP-IDF command
+# Execute ESP-IDF command (APP_BUILD on every call: it is a cached CMake variable)
+IDF="idf.py -DAPP_BUILD=$APP_BUILD"
 case $ACTION in
     build)
         echo -e "${GREEN}Building...${NC}"
-        idf.py build
+        $IDF build
         ;;
     flash)
         echo -e "${GREEN}Building and flashing...${NC}"
-        idf.py flash
+        $IDF flash
         ;;
     monitor)
         echo -e "${GREEN}Opening serial monitor...${NC}"
-        idf.py monitor
+        $IDF monitor
         ;;
     clean)
         echo -e "${YELLOW}Cleaning build...${NC}"
-        idf.py fullclean
+        $IDF fullclean
         ;;
     all)
         echo -e "${GREEN}Building, flashing, and monitoring...${NC}"
-        idf.py build flash monitor
+        $IDF build flash monitor
         ;;
     *)
         echo -e "${RED}ERROR: Unknown action '$ACTION'${NC}"
@@ -0,0 +1,273 @@
+/**
+ * @file Arduino.cpp
+ * @brief Host Arduino core: String, Print/Stream, Serial ports, pins, main()
+ */
+
+#include "Arduino.h"
+
+#include <ctype.h>
+
+#include "hal_linux.h"
+
+// ============================================================================
+// STRING
+// ============================================================================
+
+static std::string format_integer(unsigned long v, bool negative, int base) {
+    if (base < 2 || base > 36) base = DEC;
+    char buf[72];
+    char *p = &buf[sizeof(buf) - 1];
+    *p = '\0';
+    do {
+        int digit = (int)(v % (unsigned long)base);
+        *--p = (char)(digit < 10 ? '0' + digit : 'A' + digit - 10);
+        v /= (unsigned long)base;
+    } while (v != 0);
+    if (negative) *--p = '-';
+    return p;
+}
+
+static std::string format_signed(long v, int base) {
+    // Like the Arduino core: only base 10 prints a sign
+    if (base == DEC && v < 0) {
+        return format_integer(0UL - (unsigned long)v, true, base);
+    }
+    return format_integer((unsigned long)v, false, base);
+}
+
+static std::string format_float(double v, unsigned int decimals) {
+    if (isnan(v)) return "nan";
+    if (isinf(v)) return "inf";
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%.*f", (int)decimals, v);
+    return buf;
+}
+
+String::String(int v, unsigned char base) : s(format_signed(v, base)) {}
+String::String(unsigned int v, unsigned char base) : s(format_integer(v, false, base)) {}
+String::String(long v, unsigned char base) : s(format_signed(v, base)) {}
+String::String(unsigned long v, unsigned char base) : s(format_integer(v, false, base)) {}
+String::String(float v, unsigned int decimals) : s(format_float(v, decimals)) {}
+String::String(double v, unsigned int decimals) : s(format_float(v, decimals)) {}
+
+String String::substring(unsigned int from, unsigned int to) const {
+    if (from > to) std::swap(from, to);
+    if (from >= s.size()) return String();
+    if (to > s.size()) to = (unsigned int)s.size();
+    return String(s.substr(from, to - from));
+}
+
+void String::trim() {
+    size_t b = 0, e = s.size();
+    while (b < e && isspace((unsigned char)s[b])) b++;
+    while (e > b && isspace((unsigned char)s[e - 1])) e--;
+    s = s.substr(b, e - b);
+}
+
+void String::toUpperCase() {
+    for (char &c : s) c = (char)toupper((unsigned char)c);
+}
+
+void String::toLowerCase() {
+    for (char &c : s) c = (char)tolower((unsigned char)c);
+}
+
+void String::toCharArray(char *buf, unsigned int size) const {
+    if (size == 0) return;
+    snprintf(buf, size, "%s", s.c_str());
+}
+
+// ============================================================================
+// PRINT / STREAM
+// ============================================================================
+
+size_t Print::write(const uint8_t *buf, size_t len) {
+    size_t n = 0;
+    while (len-- > 0) {
+        n += write(*buf++);
+    }
+    return n;
+}
+
+size_t Print::print(long v, int base) {
+    std::string t = format_signed(v, base);
+    return write(t.c_str(), t.size());
+}
+
+size_t Print::print(unsigned long v, int base) {
+    std::string t = format_integer(v, false, base);
+    return write(t.c_str(), t.size());
+}
+
+size_t Print::print(double v, int decimals) {
+    std::string t = format_float(v, decimals < 0 ? 2 : (unsigned int)decimals);
+    return write(t.c_str(), t.size());
+}
+
+size_t Print::printf(const char *fmt, ...) {
+    char buf[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n < 0) return 0;
+    if ((size_t)n < sizeof(buf)) return write(buf, (size_t)n);
+
+    std::string big((size_t)n + 1, '\0');
+    va_start(ap, fmt);
+    vsnprintf(&big[0], big.size(), fmt, ap);
+    va_end(ap);
+    return write(big.c_str(), (size_t)n);
+}
+
+int Stream::timedRead() {
+    unsigned long start = millis();
+    do {
+        int c = read();
+        if (c >= 0) return c;
+        delay(1);
+    } while (millis() - start < timeoutMs);
+    return -1;
+}
+
+size_t Stream::readBytes(uint8_t *buf, size_t len) {
+    size_t n = 0;
+    while (n < len) {
+        int c = timedRead();
+        if (c < 0) break;
+        buf[n++] = (uint8_t)c;
+    }
+    return n;
+}
+
+String Stream::readStringUntil(char terminator) {
+    std::string out;
+    int c = timedRead();
+    while (c >= 0 && c != terminator) {
+        out += (char)c;
+        c = timedRead();
+    }
+    return String(out);
+}
+
+// ============================================================================
+// SERIAL
+// ============================================================================
+
+HardwareSerial Serial(0);
+HardwareSerial Serial1(1);
+HardwareSerial Serial2(2);
+
+void HardwareSerial::begin(unsigned long baud, uint32_t config, int8_t rxPin, int8_t txPin) {
+    (void)config;
+    hal_uart_config_t cfg = {
+        .baud = (uint32_t)baud,
+        .tx_pin = txPin,
+        .rx_pin = rxPin,
+        .rx_buffer = (uint32_t)rxBuffer,
+        .tx_buffer = (uint32_t)txBuffer,
+    };
+    if (!hal_uart_open(port, &cfg)) {
+        fprintf(stderr, "[hal] Serial%d: open failed\n", port);
+    }
+}
+
+int HardwareSerial::available() {
+    return (int)hal_uart_available(port) + (peeked >= 0 ? 1 : 0);
+}
+
+int HardwareSerial::read() {
+    if (peeked >= 0) {
+        int c = peeked;
+        peeked = -1;
+        return c;
+    }
+    uint8_t c;
+    return hal_uart_read(port, &c, 1, 0) == 1 ? c : -1;
+}
+
+int HardwareSerial::peek() {
+    if (peeked < 0) peeked = read();
+    return peeked;
+}
+
+size_t HardwareSerial::write(const uint8_t *buf, size_t len) {
+    int n = hal_uart_write(port, buf, len);
+    return n < 0 ? 0 : (size_t)n;
+}
+
+// ============================================================================
+// SYSTEM
+// ============================================================================
+
+EspClass ESP;
+
+uint32_t EspClass::getFreeHeap() {
+    return 300 * 1024;          // Nominal ESP32 figure; host heap is not meaningful
+}
+
+uint32_t getCpuFrequencyMhz() {
+    return 240;
+}
+
+unsigned long millis() {
+    return hal_millis();
+}
+
+unsigned long micros() {
+    return (unsigned long)(uint32_t)hal_time_us();
+}
+
+void delay(uint32_t ms) {
+    hal_delay_ms(ms);
+}
+
+void delayMicroseconds(uint32_t us) {
+    hal_delay_us(us);
+}
+
+void yield() {
+    hal_delay_ms(0);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+    hal_gpio_mode(pin, mode == OUTPUT ? HAL_GPIO_OUTPUT
+                       : mode == INPUT_PULLUP ? HAL_GPIO_INPUT_PULLUP
+                       : HAL_GPIO_INPUT);
+}
+
+int digitalRead(uint8_t pin) {
+    return hal_gpio_read(pin);
+}
+
+void digitalWrite(uint8_t pin, uint8_t level) {
+    hal_gpio_write(pin, level);
+}
+
+static void call_void_isr(void *arg) {
+    ((void (*)(void))arg)();
+}
+
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode) {
+    hal_gpio_edge_t edge = mode == RISING ? HAL_GPIO_EDGE_RISING
+                         : mode == FALLING ? HAL_GPIO_EDGE_FALLING
+                         : HAL_GPIO_EDGE_ANY;
+    hal_gpio_set_isr(pin, edge, call_void_isr, (void *)isr);
+}
+
+void detachInterrupt(uint8_t pin) {
+    hal_gpio_set_isr(pin, HAL_GPIO_EDGE_NONE, NULL, NULL);
+}
+
+bool btStop() {
+    return true;
+}
+
+int main(int argc, char **argv) {
+    hal_linux_init(argc, argv);
+    setup();
+    while (hal_linux_running()) {
+        loop();
+    }
+    return 0;
+}
@@ -0,0 +1,215 @@
+/**
+ * @file Arduino.h
+ * @brief Host build of the Arduino-ESP32 API subset used by the test sketches
+ *
+ * Implemented on src/hal.h (Linux backend), so a sketch compiles unchanged
+ * and runs as a normal process: Serial is the terminal, Serial1/Serial2
+ * are ptys, pins are driven from the gpio pty. main() is in Arduino.cpp.
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <string>
+
+#include "driver/gpio.h"
+#include "esp_attr.h"
+#include "hal.h"
+
+using std::max;
+using std::min;
+
+#define HIGH            1
+#define LOW             0
+
+#define INPUT           0x01
+#define OUTPUT          0x03
+#define INPUT_PULLUP    0x05
+
+#define RISING          0x01
+#define FALLING         0x02
+#define CHANGE          0x03
+
+#define DEC             10
+#define HEX             16
+#define OCT             8
+#define BIN             2
+
+#define SERIAL_8N1      0x800001c
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define digitalPinToInterrupt(p) (p)
+
+// ============================================================================
+// STRING
+// ============================================================================
+
+class String {
+public:
+    String(const char *s = "") : s(s ? s : "") {}
+    String(const std::string &s) : s(s) {}
+    explicit String(char c) : s(1, c) {}
+    explicit String(int v, unsigned char base = DEC);
+    explicit String(unsigned int v, unsigned char base = DEC);
+    explicit String(long v, unsigned char base = DEC);
+    explicit String(unsigned long v, unsigned char base = DEC);
+    explicit String(float v, unsigned int decimals = 2);
+    explicit String(double v, unsigned int decimals = 2);
+
+    unsigned int length() const { return (unsigned int)s.size(); }
+    const char *c_str() const { return s.c_str(); }
+    char charAt(unsigned int i) const { return i < s.size() ? s[i] : 0; }
+    char operator[](unsigned int i) const { return charAt(i); }
+
+    String &operator+=(const String &o) { s += o.s; return *this; }
+    String &operator+=(const char *o) { s += o; return *this; }
+    String &operator+=(char c) { s += c; return *this; }
+    friend String operator+(const String &a, const String &b) { return String(a.s + b.s); }
+    friend String operator+(const String &a, const char *b) { return String(a.s + b); }
+    friend String operator+(const char *a, const String &b) { return String(a + b.s); }
+
+    bool operator==(const String &o) const { return s == o.s; }
+    bool operator==(const char *o) const { return s == o; }
+    bool operator!=(const String &o) const { return s != o.s; }
+    bool operator!=(const char *o) const { return s != o; }
+
+    bool startsWith(const String &p) const { return s.compare(0, p.s.size(), p.s) == 0; }
+    bool endsWith(const String &p) const {
+        return s.size() >= p.s.size() && s.compare(s.size() - p.s.size(), p.s.size(), p.s) == 0;
+    }
+    int indexOf(char c, unsigned int from = 0) const { return pos(s.find(c, from)); }
+    int indexOf(const String &p, unsigned int from = 0) const { return pos(s.find(p.s, from)); }
+    String substring(unsigned int from) const { return substring(from, length()); }
+    String substring(unsigned int from, unsigned int to) const;
+
+    void trim();
+    void toUpperCase();
+    void toLowerCase();
+    long toInt() const { return atol(s.c_str()); }
+    float toFloat() const { return (float)atof(s.c_str()); }
+    void toCharArray(char *buf, unsigned int size) const;
+
+private:
+    static int pos(size_t p) { return p == std::string::npos ? -1 : (int)p; }
+    std::string s;
+};
+
+// ============================================================================
+// PRINT / STREAM / SERIAL
+// ============================================================================
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buf, size_t len);
+    size_t write(const char *str) { return write((const uint8_t *)str, strlen(str)); }
+    size_t write(const char *buf, size_t len) { return write((const uint8_t *)buf, len); }
+
+    size_t print(const char *s) { return write(s); }
+    size_t print(const String &s) { return write(s.c_str(), s.length()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char v, int base = DEC) { return print((unsigned long)v, base); }
+    size_t print(int v, int base = DEC) { return print((long)v, base); }
+    size_t print(unsigned int v, int base = DEC) { return print((unsigned long)v, base); }
+    size_t print(long v, int base = DEC);
+    size_t print(unsigned long v, int base = DEC);
+    size_t print(double v, int decimals = 2);
+
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(const T &v) { size_t n = print(v); return n + println(); }
+    template <typename T>
+    size_t println(const T &v, int fmt) { size_t n = print(v, fmt); return n + println(); }
+
+    size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long ms) { timeoutMs = ms; }
+    size_t readBytes(uint8_t *buf, size_t len);
+    size_t readBytes(char *buf, size_t len) { return readBytes((uint8_t *)buf, len); }
+    String readStringUntil(char terminator);
+
+protected:
+    int timedRead();
+    unsigned long timeoutMs = 1000;
+};
+
+class HardwareSerial : public Stream {
+public:
+    explicit HardwareSerial(int port) : port(port) {}
+
+    void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1);
+    void end() {}
+    size_t setRxBufferSize(size_t size) { rxBuffer = size; return size; }
+    size_t setTxBufferSize(size_t size) { txBuffer = size; return size; }
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    void flush() { hal_uart_flush(port); }
+    int availableForWrite() { return 1024; }    // Host writes do not block for long
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buf, size_t len) override;
+    using Print::write;
+
+    operator bool() const { return true; }
+
+private:
+    int port;
+    int peeked = -1;
+    size_t rxBuffer = 256;
+    size_t txBuffer = 0;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+extern HardwareSerial Serial2;
+
+// ============================================================================
+// SYSTEM
+// ============================================================================
+
+class EspClass {
+public:
+    uint32_t getFreeHeap();
+};
+
+extern EspClass ESP;
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void yield();
+uint32_t getCpuFrequencyMhz();
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t level);
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t pin);
+
+bool btStop();
+
+// Provided by the sketch
+void setup();
+void loop();
+
+#endif // HOST_ARDUINO_H
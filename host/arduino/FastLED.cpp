@@ -0,0 +1,33 @@
+/**
+ * @file FastLED.cpp
+ * @brief Host FastLED: frames go to the LED framebuffer in hal_linux
+ */
+
+#include "FastLED.h"
+
+static_assert(sizeof(CRGB) == 3, "CRGB must be packed r, g, b like FastLED");
+
+CFastLED FastLED;
+
+void CFastLED::attach(int pin, CRGB *data, int n) {
+    leds = data;
+    count = n;
+    hal_leds_init(pin, (size_t)n);
+}
+
+void CFastLED::show() {
+    if (leds == nullptr) return;
+    hal_leds_show(&leds[0].r, (size_t)count, brightness);
+}
+
+void CFastLED::clear(bool writeData) {
+    if (leds == nullptr) return;
+    fill_solid(leds, count, CRGB::Black);
+    if (writeData) show();
+}
+
+void fill_solid(CRGB *leds, int count, const CRGB &color) {
+    for (int i = 0; i < count; i++) {
+        leds[i] = color;
+    }
+}
@@ -0,0 +1,67 @@
+/**
+ * @file FastLED.h
+ * @brief Host build of the FastLED subset used by the sketches (hal_leds_*)
+ */
+
+#ifndef HOST_FASTLED_H
+#define HOST_FASTLED_H
+
+#include <Arduino.h>
+
+struct CRGB {
+    uint8_t r, g, b;
+
+    enum HTMLColorCode {
+        Black = 0x000000,
+        Blue = 0x0000FF,
+        Cyan = 0x00FFFF,
+        Green = 0x008000,
+        Magenta = 0xFF00FF,
+        Orange = 0xFFA500,
+        Purple = 0x800080,
+        Red = 0xFF0000,
+        White = 0xFFFFFF,
+        Yellow = 0xFFFF00,
+    };
+
+    CRGB() : r(0), g(0), b(0) {}
+    CRGB(uint8_t r, uint8_t g, uint8_t b) : r(r), g(g), b(b) {}
+    CRGB(HTMLColorCode c) : r((c >> 16) & 0xFF), g((c >> 8) & 0xFF), b(c & 0xFF) {}
+
+    bool operator==(const CRGB &o) const { return r == o.r && g == o.g && b == o.b; }
+    bool operator!=(const CRGB &o) const { return !(*this == o); }
+};
+
+enum EOrder { RGB = 0012, GRB = 0102 };
+
+// Chipsets only select timing on the target; all map to hal_leds_*
+template <uint8_t DATA_PIN, EOrder RGB_ORDER> class WS2812B {};
+template <uint8_t DATA_PIN, EOrder RGB_ORDER> class WS2812 {};
+template <uint8_t DATA_PIN, EOrder RGB_ORDER> class NEOPIXEL {};
+
+class CFastLED {
+public:
+    template <template <uint8_t, EOrder> class CHIPSET, uint8_t DATA_PIN, EOrder RGB_ORDER>
+    CFastLED &addLeds(CRGB *data, int count) {
+        attach(DATA_PIN, data, count);
+        return *this;
+    }
+
+    void setBrightness(uint8_t scale) { brightness = scale; }
+    uint8_t getBrightness() const { return brightness; }
+    void show();
+    void clear(bool writeData = false);
+
+private:
+    void attach(int pin, CRGB *data, int count);
+
+    CRGB *leds = nullptr;
+    int count = 0;
+    uint8_t brightness = 255;
+};
+
+extern CFastLED FastLED;
+
+void fill_solid(CRGB *leds, int count, const CRGB &color);
+
+#endif // HOST_FASTLED_H
@@ -0,0 +1,22 @@
+/**
+ * @file LiquidCrystal_I2C.cpp
+ * @brief Host LCD and Wire: text goes to the LCD framebuffer in hal_linux
+ */
+
+#include "LiquidCrystal_I2C.h"
+
+#include "Wire.h"
+
+TwoWire Wire;
+
+void LiquidCrystal_I2C::init() {
+    const hal_lcd_config_t config = {
+        .addr = addr,
+        .cols = cols,
+        .rows = rows,
+        .sda_pin = Wire.sdaPin,
+        .scl_pin = Wire.sclPin,
+    };
+    // Like the real library: no error path, a missing display just stays blank
+    hal_lcd_init(&config);
+}
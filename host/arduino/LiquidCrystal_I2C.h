@@ -0,0 +1,37 @@
+/**
+ * @file LiquidCrystal_I2C.h
+ * @brief Host build of the LiquidCrystal_I2C subset used by the sketches
+ */
+
+#ifndef HOST_LIQUIDCRYSTAL_I2C_H
+#define HOST_LIQUIDCRYSTAL_I2C_H
+
+#include <Arduino.h>
+#include <Wire.h>
+
+class LiquidCrystal_I2C : public Print {
+public:
+    LiquidCrystal_I2C(uint8_t addr, uint8_t cols, uint8_t rows)
+        : addr(addr), cols(cols), rows(rows) {}
+
+    void init();
+    void begin() { init(); }
+    void clear() { hal_lcd_clear(); }
+    void setCursor(uint8_t col, uint8_t row) { hal_lcd_set_cursor(col, row); }
+    void backlight() { hal_lcd_backlight(true); }
+    void noBacklight() { hal_lcd_backlight(false); }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buf, size_t len) override {
+        hal_lcd_write((const char *)buf, len);
+        return len;
+    }
+    using Print::write;
+
+private:
+    uint8_t addr;
+    uint8_t cols;
+    uint8_t rows;
+};
+
+#endif // HOST_LIQUIDCRYSTAL_I2C_H
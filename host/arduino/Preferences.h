@@ -0,0 +1,50 @@
+/**
+ * @file Preferences.h
+ * @brief Host build of Preferences (the Arduino-ESP32 NVS wrapper) on hal_nvs
+ *
+ * Only the calls the sketches use. Values survive a restart when
+ * HAL_NVS_FILE is set, as on the board.
+ */
+
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+#include <Arduino.h>
+#include <string.h>
+
+class Preferences {
+public:
+    bool begin(const char *name, bool readOnly = false) {
+        (void)readOnly;
+        snprintf(ns, sizeof(ns), "%s", name);
+        return hal_nvs_init();
+    }
+
+    void end() {}
+
+    uint8_t getUChar(const char *key, uint8_t defaultValue = 0) {
+        uint8_t v;
+        size_t len = sizeof(v);
+        return hal_nvs_get(ns, key, &v, &len) && len == sizeof(v) ? v : defaultValue;
+    }
+
+    size_t putUChar(const char *key, uint8_t value) {
+        return hal_nvs_set(ns, key, &value, sizeof(value)) ? sizeof(value) : 0;
+    }
+
+    size_t getBytes(const char *key, void *buf, size_t maxLen) {
+        size_t len = maxLen;
+        return hal_nvs_get(ns, key, buf, &len) ? len : 0;
+    }
+
+    size_t putBytes(const char *key, const void *value, size_t len) {
+        return hal_nvs_set(ns, key, value, len) ? len : 0;
+    }
+
+    bool remove(const char *key) { return hal_nvs_erase(ns, key); }
+
+private:
+    char ns[16] = "";
+};
+
+#endif // HOST_PREFERENCES_H
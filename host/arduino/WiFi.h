@@ -0,0 +1,29 @@
+/**
+ * @file WiFi.h
+ * @brief Host build of WiFi - the sketches only switch the radio off
+ */
+
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+#include <Arduino.h>
+
+typedef enum {
+    WIFI_OFF = 0,
+    WIFI_STA,
+    WIFI_AP,
+    WIFI_AP_STA,
+} wifi_mode_t;
+
+class WiFiClass {
+public:
+    bool mode(wifi_mode_t m) { current = m; return true; }
+    wifi_mode_t getMode() const { return current; }
+
+private:
+    wifi_mode_t current = WIFI_OFF;
+};
+
+inline WiFiClass WiFi;
+
+#endif // HOST_WIFI_H
@@ -0,0 +1,44 @@
+/**
+ * @file Wire.h
+ * @brief Host build of TwoWire - remembers the pins for the LCD, answers
+ *        address probes from the LCD backpack (hal_lcd_probe)
+ */
+
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+#include <Arduino.h>
+
+class TwoWire {
+public:
+    bool begin(int sda = -1, int scl = -1) {
+        sdaPin = sda;
+        sclPin = scl;
+        return true;
+    }
+
+    void beginTransmission(uint8_t addr) { txAddr = addr; }
+
+    /** @return 0 if a device ACKed, 2 (NACK on address) otherwise */
+    uint8_t endTransmission(bool stop = true) {
+        (void)stop;
+        const hal_lcd_config_t config = {
+            .addr = txAddr,
+            .cols = 16,
+            .rows = 2,
+            .sda_pin = sdaPin,
+            .scl_pin = sclPin,
+        };
+        return hal_lcd_probe(&config, txAddr) ? 0 : 2;
+    }
+
+    int sdaPin = -1;
+    int sclPin = -1;
+
+private:
+    uint8_t txAddr = 0;
+};
+
+extern TwoWire Wire;
+
+#endif // HOST_WIRE_H
@@ -0,0 +1,9 @@
+/**
+ * @file esp_bt.h
+ * @brief Host build: no Bluetooth controller (btStop() is in Arduino.h)
+ */
+
+#ifndef HOST_ESP_BT_H
+#define HOST_ESP_BT_H
+
+#endif // HOST_ESP_BT_H
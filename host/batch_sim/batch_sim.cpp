@@ -0,0 +1,637 @@
+/**
+ * @file batch_sim.cpp
+ * @brief Discrete-event batch run: controller, UART, FluidncSim, plant
+ */
+
+#include "batch_sim.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+
+#include "fluidnc_sim/uart_link.h"
+#include "flow_control.h"
+#include "flow_monitor.h"
+#include "fluidnc_status.h"
+
+// Mirrors pin_definitions.h / task_control.c
+#define MIN_FLOW_RATE_ML_MIN    1.0f
+#define MAX_FLOW_RATE_ML_MIN    500.0f
+#define MIN_FEEDRATE_MM_MIN     10.0f
+#define MAX_FEEDRATE_MM_MIN     5000.0f
+#define DOSE_POS_TOL_MM         0.01f
+#define TEST16_G92_DELAY_MS     100     // test_16 delay(100) after "G92"
+
+#define NONE                    (-1)    // No event pending
+
+const std::vector<Recipe> &builtinRecipes() {
+    // Mirrors test_16_recipe_system.cpp
+    static const std::vector<Recipe> recipes = {
+        {"Cleaning Flush", {{'X', 5.0f, 30.0f}, {'Y', 5.0f, 30.0f}, {'Z', 5.0f, 30.0f}, {'A', 5.0f, 30.0f}}},
+        {"Color Mix", {{'X', 10.0f, 15.0f}, {'Y', 5.0f, 10.0f}, {'Z', 2.5f, 10.0f}}},
+        {"Nutrient Mix", {{'X', 20.0f, 25.0f}, {'Y', 2.0f, 5.0f}, {'Z', 1.5f, 5.0f}, {'A', 0.5f, 2.0f}}},
+    };
+    return recipes;
+}
+
+static int axisIndex(char pump) {
+    switch (pump) {
+        case 'X': return 0;
+        case 'Y': return 1;
+        case 'Z': return 2;
+        case 'A': return 3;
+        default:  return -1;
+    }
+}
+
+bool parseScript(const std::string &text, std::vector<OperatorAction> &out) {
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find(',', start);
+        if (end == std::string::npos) end = text.size();
+        std::string item = text.substr(start, end - start);
+        start = end + 1;
+
+        size_t at = item.find('@');
+        if (at == std::string::npos) return false;
+        std::string kind = item.substr(0, at);
+        OperatorAction action{};
+        action.atUs = (int64_t)(strtod(item.c_str() + at + 1, nullptr) * 1000.0);
+
+        if (kind == "stop") {
+            action.kind = OperatorAction::Stop;
+        } else if (kind == "resume") {
+            action.kind = OperatorAction::Resume;
+        } else if (kind.size() == 7 && kind.compare(0, 6, "burst:") == 0 && axisIndex(kind[6]) >= 0) {
+            action.kind = OperatorAction::Burst;
+            action.pump = kind[6];
+        } else {
+            return false;
+        }
+        out.push_back(action);
+    }
+    std::stable_sort(out.begin(), out.end(),
+                     [](const OperatorAction &a, const OperatorAction &b) { return a.atUs < b.atUs; });
+    return true;
+}
+
+// Deterministic per-run randomness
+class Rng {
+public:
+    explicit Rng(uint32_t seed) : state(seed ? seed : 0x9E3779B9u) {
+        for (int i = 0; i < 4; i++) next();
+    }
+
+    uint32_t next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    double uniform() { return (next() + 0.5) / 4294967296.0; }
+
+    double gaussian() {
+        return std::sqrt(-2.0 * std::log(uniform())) * std::cos(6.283185307179586 * uniform());
+    }
+
+private:
+    uint32_t state;
+};
+
+class Batch {
+public:
+    Batch(const Recipe &recipe, const BatchParams &params, uint32_t seed);
+    BatchResult run();
+
+private:
+    enum class Phase { Starting, Setup, Dosing, Hold, Settling, Done };
+
+    struct PendingLine {
+        int64_t atUs;
+        int64_t generatedUs;
+        std::string line;
+    };
+
+    struct PendingScale {
+        int64_t atUs;
+        float grams;
+    };
+
+    struct InFlight {
+        int64_t generatedUs;
+        int64_t arrivalUs;              // Last byte ('\n') at the ESP32
+    };
+
+    // World
+    void advanceWorld(int64_t t);
+    void trackMotion();
+    void plantUpdate();
+    void plantTick(int64_t t);
+    void scaleSample(int64_t t);
+
+    // Controller
+    void send(const std::string &bytes, int64_t t);
+    void sendRealtime(const uint8_t *bytes, size_t n, int64_t t);
+    void stopFlowControl(int64_t t);
+    void handleLine(const PendingLine &pending, int64_t t);
+    void handleStatus(const fluidnc_status_t &status, int64_t t);
+    void handleScale(float grams, int64_t t);
+    void handleTimer(int64_t t);
+    void operatorAction(const OperatorAction &action, int64_t t);
+    void startStep(int64_t t);
+    void sendMove(int64_t t);
+    void completeStep(int64_t t);
+    void abort(const std::string &why, int64_t t);
+    void finish(int64_t t);
+
+    const Recipe &recipe;
+    const BatchParams &p;
+    Rng rng;
+    BatchResult result;
+
+    FluidncSim sim;
+    UartLink toSim;
+    UartLink toEsp;
+    std::deque<InFlight> inFlight;      // One per line on its way to the ESP32
+    std::string rxLine;
+    std::deque<PendingLine> lines;
+    std::deque<PendingScale> readings;
+    size_t scriptIndex = 0;
+
+    // Plant
+    float trueMlPerMm[BATCH_PUMPS];
+    float lastPos[BATCH_PUMPS] = {0};
+    float sourceG[BATCH_PUMPS] = {0};   // Pumped mass that reaches the container
+    bool burst[BATCH_PUMPS] = {false};
+    int64_t burstUs = NONE;
+    std::deque<std::pair<int64_t, float>> history;     // (time, total pumped)
+    float scaleFiltered = 0.0f;
+    int64_t lastPlantUs = 0;
+    int64_t nextPlantUs = 0;
+    int64_t nextScaleUs = 0;
+
+    // Controller
+    Phase phase = Phase::Starting;
+    size_t step = 0;
+    int movingStep = -1;                // Step whose move went out last
+    int64_t timerUs = NONE;
+    int64_t pollUs = NONE;
+    int64_t lastMotionStartUs = -1;
+    int64_t lastMotionEndUs = -1;
+    int64_t prevStepEndUs = -1;
+    bool awaitingOk = false;
+    bool seenRun = false;
+    bool finished = false;
+    float scaleG = 0.0f;
+    float doseMm = 0.0f;
+    float doseStartPos = 0.0f;
+    float doseStartScaleG = 0.0f;
+    std::vector<float> stepSourceStart;
+    fluidnc_status_t machine{};
+    bool haveMachine = false;
+};
+
+Batch::Batch(const Recipe &recipe, const BatchParams &params, uint32_t seed)
+    : recipe(recipe), p(params), rng(seed), sim(params.sim), toSim(params.baud), toEsp(params.baud) {
+    latency_hist_reset(&result.statusAge);
+    latency_hist_reset(&result.doneDetect);
+    latency_hist_reset(&result.stepGap);
+    latency_hist_reset(&result.faultDetect);
+
+    for (int i = 0; i < BATCH_PUMPS; i++) {
+        trueMlPerMm[i] = p.plant.mlPerMm * (float)(1.0 + p.plant.calibrationSd * rng.gaussian());
+    }
+
+    flow_monitor_config_t fm = FLOW_MONITOR_DEFAULT_CONFIG;
+    for (int i = 0; i < FLOW_MONITOR_PUMPS; i++) fm.ml_per_mm[i] = p.control.mlPerMm;
+    flow_monitor_init(&fm);
+
+    // Above the axis max rate an override does nothing: the loop must know the ceiling
+    flow_control_config_t fc = FLOW_CONTROL_DEFAULT_CONFIG;
+    fc.reading_s = p.plant.scalePeriodMs / 1000.0f;
+    if (fc.window_s < FLOW_CONTROL_MIN_READINGS * fc.reading_s) fc.window_s = FLOW_CONTROL_MIN_READINGS * fc.reading_s;
+    fc.max_window_s = std::min(fc.max_window_s, (FLOW_CONTROL_HISTORY - 1) * fc.reading_s);
+    if (fc.max_window_s < fc.window_s) fc.max_window_s = fc.window_s;
+    fc.min_flow_ml_min = MIN_FLOW_RATE_ML_MIN;
+    fc.max_flow_ml_min = MAX_FLOW_RATE_ML_MIN;
+    for (const SimAxisConfig &ax : p.sim.axes) {
+        fc.max_flow_ml_min = std::min(fc.max_flow_ml_min, ax.maxRateMmMin * p.control.mlPerMm);
+    }
+    flow_control_init(&fc);
+
+    // Sample clocks are not aligned with the recipe start
+    nextPlantUs = (int64_t)(rng.uniform() * p.plant.plantStepMs * 1000.0);
+    nextScaleUs = (int64_t)(rng.uniform() * p.plant.scalePeriodMs * 1000.0);
+    history.push_back({0, 0.0f});
+}
+
+// ============================================================================
+// WORLD
+// ============================================================================
+
+void Batch::advanceWorld(int64_t t) {
+    uint8_t b;
+    int64_t at;
+    while (toSim.receive(t, b, &at)) {
+        sim.receive(b, at);
+    }
+    sim.advance(t);
+    trackMotion();
+
+    SimOutput out;
+    while (sim.popOutput(out)) {
+        int64_t arrival = toEsp.send(out.line + "\r\n", out.atUs);
+        inFlight.push_back({out.atUs, arrival});
+    }
+
+    while (toEsp.receive(t, b)) {
+        if (b == '\n') {
+            lines.push_back({t + (int64_t)p.control.reactionUs, inFlight.front().generatedUs, rxLine});
+            inFlight.pop_front();
+            rxLine.clear();
+        } else if (b != '\r') {
+            rxLine.push_back((char)b);
+        }
+    }
+}
+
+void Batch::trackMotion() {
+    if (movingStep < 0) return;
+    StepResult &sr = result.steps[(size_t)movingStep];
+
+    if (sim.motionStartUs() != lastMotionStartUs) {
+        lastMotionStartUs = sim.motionStartUs();
+        if (sr.motionStartUs < 0) {
+            sr.motionStartUs = lastMotionStartUs;
+            if (prevStepEndUs >= 0) {
+                latency_hist_add(&result.stepGap, (uint32_t)(lastMotionStartUs - prevStepEndUs));
+            }
+        }
+    }
+    if (sim.motionEndUs() != lastMotionEndUs) {
+        lastMotionEndUs = sim.motionEndUs();
+        sr.motionEndUs = lastMotionEndUs;
+        prevStepEndUs = lastMotionEndUs;
+    }
+}
+
+void Batch::plantUpdate() {
+    for (int i = 0; i < BATCH_PUMPS; i++) {
+        float pos = sim.position(i);
+        float moved = pos - lastPos[i];
+        lastPos[i] = pos;
+        if (!burst[i]) sourceG[i] += moved * trueMlPerMm[i] * (1.0f - p.plant.slip) * p.plant.densityGMl[i];
+    }
+}
+
+void Batch::plantTick(int64_t t) {
+    plantUpdate();
+    float total = 0.0f;
+    for (float g : sourceG) total += g;
+    history.push_back({t, total});
+
+    // Mass in the container: what was pumped one transit time ago
+    int64_t arrived = t - (int64_t)(p.plant.transitS * 1e6f);
+    while (history.size() > 2 && history[1].first <= arrived) history.pop_front();
+    float cupG = history.front().second;
+    if (history.size() > 1 && arrived > history[0].first) {
+        const auto &a = history[0];
+        const auto &b = history[1];
+        float k = (float)(arrived - a.first) / (float)(b.first - a.first);
+        cupG = a.second + (b.second - a.second) * std::min(k, 1.0f);
+    }
+
+    float dt = (float)(t - lastPlantUs) * 1e-6f;
+    lastPlantUs = t;
+    scaleFiltered += (cupG - scaleFiltered) * (1.0f - std::exp(-dt / p.plant.scaleTauS));
+}
+
+void Batch::scaleSample(int64_t t) {
+    float g = scaleFiltered + p.plant.noiseG * (float)rng.gaussian();
+    if (p.plant.resolutionG > 0.0f) g = std::round(g / p.plant.resolutionG) * p.plant.resolutionG;
+    readings.push_back({t + (int64_t)p.plant.scaleLatencyUs, g});
+}
+
+// ============================================================================
+// CONTROLLER
+// ============================================================================
+
+void Batch::send(const std::string &bytes, int64_t t) {
+    toSim.send(bytes, t);
+    if (bytes.back() == '\n') result.linesSent++;
+}
+
+void Batch::sendRealtime(const uint8_t *bytes, size_t n, int64_t t) {
+    if (n) send(std::string((const char *)bytes, n), t);
+}
+
+void Batch::stopFlowControl(int64_t t) {
+    uint8_t reset[1];
+    sendRealtime(reset, flow_control_stop(reset, sizeof(reset)), t);
+}
+
+void Batch::startStep(int64_t t) {
+    if (step >= recipe.steps.size()) {
+        result.completed = true;
+        result.makespanUs = t;
+        finish(t);
+        return;
+    }
+
+    const Ingredient &ing = recipe.steps[step];
+    int axis = axisIndex(ing.pump);
+    plantUpdate();
+
+    StepResult sr{};
+    sr.pump = ing.pump;
+    sr.targetG = ing.volumeMl * p.plant.densityGMl[axis];
+    sr.motionStartUs = sr.motionEndUs = sr.completeUs = -1;
+    result.steps.push_back(sr);
+    stepSourceStart.push_back(sourceG[axis]);
+
+    if (p.control.policy == CompletionPolicy::Test16) {
+        char cmd[32];
+        snprintf(cmd, sizeof(cmd), "G92 %c0\n", ing.pump);
+        send(cmd, t);
+        phase = Phase::Setup;
+        timerUs = t + TEST16_G92_DELAY_MS * 1000;
+    } else {
+        sendMove(t);
+    }
+}
+
+void Batch::sendMove(int64_t t) {
+    const Ingredient &ing = recipe.steps[step];
+    int axis = axisIndex(ing.pump);
+
+    float feed = ing.flowRateMlMin / p.control.mlPerMm;
+    feed = std::min(feed, std::min(p.control.feedCapMmMin, MAX_FEEDRATE_MM_MIN));
+    feed = std::max(feed, MIN_FEEDRATE_MM_MIN);
+    doseMm = ing.volumeMl / p.control.mlPerMm;
+    doseStartPos = haveMachine ? machine.pos[axis] : 0.0f;
+    doseStartScaleG = scaleG;
+    seenRun = false;
+
+    char cmd[64];
+    if (p.control.policy == CompletionPolicy::Test16) {
+        snprintf(cmd, sizeof(cmd), "G1 %c%.2f F%.1f\n", ing.pump, doseMm, feed);
+    } else {
+        snprintf(cmd, sizeof(cmd), "G91 G1 %c%.3f F%.1f\n", ing.pump, doseMm, feed);
+    }
+    send(cmd, t);
+    awaitingOk = true;
+    movingStep = (int)step;
+
+    // task_control.c: density-scaled target from the clamped feed (and the axis max rate)
+    float flowMlMin = std::min(feed, p.sim.axes[axis].maxRateMmMin) * p.control.mlPerMm;
+    result.steps[step].targetFlowGS = flowMlMin * p.plant.densityGMl[axis] / 60.0f;
+    if (p.control.flowMonitor) flow_monitor_start(scaleG, t);
+    if (p.control.flowControl && p.control.policy == CompletionPolicy::Firmware) flow_control_start(result.steps[step].targetFlowGS, flowMlMin, t);
+    phase = Phase::Dosing;
+}
+
+void Batch::completeStep(int64_t t) {
+    flow_monitor_stop();
+    stopFlowControl(t);
+    StepResult &sr = result.steps[step];
+    sr.completeUs = t;
+    sr.scaleG = scaleG - doseStartScaleG;
+
+    if (sim.state() == SimState::Idle && sim.motionEndUs() >= sr.motionStartUs && sr.motionStartUs >= 0) {
+        latency_hist_add(&result.doneDetect, (uint32_t)(t - sim.motionEndUs()));
+    } else {
+        result.prematureSteps++;
+    }
+
+    step++;
+    if (p.control.settleMs == 0) {
+        startStep(t);
+    } else {
+        phase = Phase::Settling;
+        timerUs = t + (int64_t)p.control.settleMs * 1000;
+    }
+}
+
+void Batch::abort(const std::string &why, int64_t t) {
+    flow_monitor_stop();
+    stopFlowControl(t);
+    result.abortReason = why;
+    result.makespanUs = t;
+    finish(t);
+}
+
+void Batch::finish(int64_t t) {
+    (void)t;
+    phase = Phase::Done;
+    timerUs = NONE;
+    pollUs = NONE;
+    finished = true;
+}
+
+void Batch::handleLine(const PendingLine &pending, int64_t t) {
+    const std::string &line = pending.line;
+    result.linesReceived++;
+
+    if (!line.empty() && line[0] == '<') {
+        latency_hist_add(&result.statusAge, (uint32_t)(t - pending.generatedUs));
+        fluidnc_status_t status;
+        if (fluidnc_status_parse(line.c_str(), &status)) handleStatus(status, t);
+    } else if (line == "ok") {
+        awaitingOk = false;
+    } else if (line.compare(0, 6, "error:") == 0) {
+        awaitingOk = false;
+        if (phase == Phase::Dosing || phase == Phase::Setup) abort("FluidNC " + line, t);
+        return;
+    } else if (line.compare(0, 6, "ALARM:") == 0) {
+        abort("FluidNC " + line, t);
+        return;
+    }
+
+    // test_16 loop(): any line with "Idle" ends the step
+    if (p.control.policy == CompletionPolicy::Test16 && phase == Phase::Dosing &&
+        line.find("Idle") != std::string::npos) {
+        completeStep(t);
+    }
+}
+
+void Batch::handleStatus(const fluidnc_status_t &status, int64_t t) {
+    machine = status;
+    haveMachine = true;
+    flow_control_on_status(&status, t);
+
+    const flow_fault_t *fault = flow_monitor_on_status(&status, t);
+    if (fault != NULL) {
+        send("!", t);
+        result.flowFaultCode = fault->code;
+        if (burstUs >= 0) latency_hist_add(&result.faultDetect, (uint32_t)(t - burstUs));
+        char text[32];
+        flow_fault_format(fault, text, sizeof(text));
+        abort(std::string("flow fault ") + text, t);
+        return;
+    }
+
+    if (p.control.policy != CompletionPolicy::Firmware || phase != Phase::Dosing) return;
+
+    // task_control.c handle_status()
+    int axis = axisIndex(recipe.steps[step].pump);
+    if (status.state == FLUIDNC_STATE_RUN) {
+        seenRun = true;
+    } else if (status.state == FLUIDNC_STATE_IDLE && !awaitingOk) {
+        float moved = status.pos[axis] - doseStartPos;
+        if (seenRun || std::fabs(moved - doseMm) < DOSE_POS_TOL_MM) completeStep(t);
+    } else if (status.state == FLUIDNC_STATE_ALARM) {
+        abort("alarm during dose", t);
+    }
+}
+
+void Batch::handleScale(float grams, int64_t t) {
+    scaleG = grams;
+    flow_monitor_on_scale(grams, t);
+    uint8_t ov[FLOW_CONTROL_MAX_BYTES];
+    sendRealtime(ov, flow_control_on_scale(grams, t, ov, sizeof(ov)), t);
+}
+
+void Batch::handleTimer(int64_t t) {
+    switch (phase) {
+        case Phase::Starting:
+        case Phase::Settling:
+            startStep(t);
+            break;
+        case Phase::Setup:
+            sendMove(t);
+            break;
+        default:
+            break;
+    }
+}
+
+void Batch::operatorAction(const OperatorAction &action, int64_t t) {
+    switch (action.kind) {
+        case OperatorAction::Stop:
+            send("!", t);
+            flow_monitor_stop();
+            flow_control_pause();
+            if (p.control.policy == CompletionPolicy::Test16) {
+                abort("operator stop", t);         // test_16 drops back to browsing
+            } else if (phase == Phase::Dosing) {
+                phase = Phase::Hold;
+            }
+            break;
+
+        case OperatorAction::Resume:
+            if (phase == Phase::Hold) {
+                send("~", t);
+                if (p.control.flowMonitor) flow_monitor_start(scaleG, t);
+                flow_control_resume(t);
+                phase = Phase::Dosing;
+            }
+            break;
+
+        case OperatorAction::Burst: {
+            plantUpdate();
+            burst[axisIndex(action.pump)] = true;
+            if (burstUs < 0) burstUs = t;
+            break;
+        }
+    }
+}
+
+// ============================================================================
+// EVENT LOOP
+// ============================================================================
+
+BatchResult Batch::run() {
+    int64_t t = 0;
+    timerUs = (int64_t)p.control.startDelayMs * 1000;
+    if (p.control.pollMs) pollUs = (int64_t)p.control.pollMs * 1000;
+
+    while (!finished) {
+        int64_t next = p.timeoutUs;
+        auto consider = [&next](int64_t at) {
+            if (at >= 0 && at < next) next = at;
+        };
+        consider(toSim.nextArrivalUs());
+        // The ESP32 side only acts on complete lines: one event per line, not per byte
+        if (!inFlight.empty()) consider(inFlight.front().arrivalUs);
+        consider(sim.nextOutputUs());
+        consider(timerUs);
+        consider(pollUs);
+        consider(nextPlantUs);
+        consider(nextScaleUs);
+        if (!lines.empty()) consider(lines.front().atUs);
+        if (!readings.empty()) consider(readings.front().atUs);
+        if (scriptIndex < p.script.size()) consider(p.script[scriptIndex].atUs);
+
+        t = std::max(t, next);
+        result.events++;
+        if (t >= p.timeoutUs) {
+            abort("timeout", t);
+            break;
+        }
+
+        advanceWorld(t);
+        if (nextPlantUs <= t) {
+            plantTick(t);
+            nextPlantUs += (int64_t)p.plant.plantStepMs * 1000;
+        }
+        if (nextScaleUs <= t) {
+            scaleSample(t);
+            nextScaleUs += (int64_t)p.plant.scalePeriodMs * 1000;
+        }
+
+        while (!finished && scriptIndex < p.script.size() && p.script[scriptIndex].atUs <= t) {
+            operatorAction(p.script[scriptIndex++], t);
+        }
+        while (!finished && !readings.empty() && readings.front().atUs <= t) {
+            handleScale(readings.front().grams, t);
+            readings.pop_front();
+        }
+        while (!finished && !lines.empty() && lines.front().atUs <= t) {
+            PendingLine pending = std::move(lines.front());
+            lines.pop_front();
+            handleLine(pending, t);
+        }
+        if (!finished && timerUs >= 0 && timerUs <= t) {
+            timerUs = NONE;
+            handleTimer(t);
+        }
+        if (!finished && pollUs >= 0 && pollUs <= t) {
+            send("?", t);
+            pollUs += (int64_t)p.control.pollMs * 1000;
+        }
+    }
+
+    // Let a stopped or still-running pump come to rest before accounting
+    const int64_t restLimitUs = t + 600LL * 1000000;
+    while ((sim.speedMmMin() > 0.0f || sim.state() == SimState::Run) && t < restLimitUs) {
+        t += (int64_t)p.plant.plantStepMs * 1000;
+        advanceWorld(t);
+    }
+    plantUpdate();
+
+    for (size_t i = 0; i < result.steps.size(); i++) {
+        StepResult &sr = result.steps[i];
+        int axis = axisIndex(sr.pump);
+        float end = sourceG[axis];
+        for (size_t j = i + 1; j < result.steps.size(); j++) {
+            if (result.steps[j].pump == sr.pump) {
+                end = stepSourceStart[j];
+                break;
+            }
+        }
+        sr.deliveredG = end - stepSourceStart[i];
+        if (sr.motionEndUs > sr.motionStartUs && sr.motionStartUs >= 0) {
+            sr.flowGS = sr.deliveredG / ((float)(sr.motionEndUs - sr.motionStartUs) * 1e-6f);
+        }
+    }
+    return result;
+}
+
+BatchResult runBatch(const Recipe &recipe, const BatchParams &params, uint32_t seed) {
+    Batch batch(recipe, params, seed);
+    return batch.run();
+}
@@ -0,0 +1,144 @@
+/**
+ * @file batch_sim.h
+ * @brief Deterministic virtual-time batch harness (recipe runs, no hardware)
+ *
+ * One batch = one recipe run through the whole loop on a single virtual
+ * timeline:
+ *
+ *   controller --G-code--> UartLink --> FluidncSim (motion)
+ *       ^                                   |
+ *       +--- status / ok <-- UartLink <-----+
+ *       ^                                   v
+ *       +--- scale readings <-- plant (tube transit, scale lag, noise)
+ *       ^
+ *       +--- operator script (STOP / RESUME at fixed times, tube bursts)
+ *
+ * Nothing sleeps: the loop jumps from one event to the next (byte
+ * arrivals, FluidncSim::nextOutputUs(), controller timers, scale samples,
+ * scripted actions), so a 100 s recipe takes milliseconds of CPU. The
+ * controller is the firmware's: fluidnc_status.c parses the reports,
+ * flow_monitor.c supervises the dose and flow_control.c trims the feed
+ * override, all fed with virtual time; the sequencing follows
+ * task_control.c or test_16 (CompletionPolicy).
+ *
+ * Runs are repeatable: everything random (calibration error, scale noise,
+ * reader phase) comes from the seed passed to runBatch().
+ */
+
+#ifndef BATCH_SIM_H
+#define BATCH_SIM_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "fluidnc_sim/fluidnc_sim.h"
+#include "latency_hist.h"
+#include "scale_weight.h"
+
+#define BATCH_PUMPS     4       // X Y Z A
+
+struct Ingredient {
+    char pump;
+    float volumeMl;
+    float flowRateMlMin;
+};
+
+struct Recipe {
+    std::string name;
+    std::vector<Ingredient> steps;
+};
+
+/** Recipes built into test_16 (Cleaning Flush, Color Mix, Nutrient Mix) */
+const std::vector<Recipe> &builtinRecipes();
+
+enum class CompletionPolicy {
+    Firmware,   // task_control.c: G91 move, wait "ok", step done on Run -> Idle
+    Test16,     // test_16: G92 + absolute move, step done on the first "Idle" line
+};
+
+struct OperatorAction {
+    enum Kind { Stop, Resume, Burst };
+    int64_t atUs;
+    Kind kind;
+    char pump;                  // Burst only: the tube that fails
+};
+
+struct PlantParams {
+    float mlPerMm = 0.05f;                  // True tube calibration (nominal)
+    float calibrationSd = 0.02f;            // Relative error per pump, drawn per run
+    float densityGMl[BATCH_PUMPS] = {1.0f, 1.0f, 1.0f, 1.0f};
+    float slip = 0.0f;                      // Viscous chemical: fraction of tube volume lost
+    float transitS = 0.4f;                  // Tube dead time, pump -> container
+    float scaleTauS = 0.3f;                 // Scale settling (first order)
+    float noiseG = 0.02f;                   // Reading noise, 1 sd
+    float resolutionG = 0.01f;
+    uint32_t scalePeriodMs = SCALE_READING_MS;      // task_scale.c: burst + read window + gap
+    uint32_t scaleLatencyUs = SCALE_READ_WINDOW_MS * 1000;  // Sent at the end of the read window
+    uint32_t plantStepMs = 10;              // Flow / settling integration step
+};
+
+struct ControlParams {
+    CompletionPolicy policy = CompletionPolicy::Firmware;
+    float mlPerMm = 0.05f;                  // Calibration the firmware doses with
+    float feedCapMmMin = 300.0f;            // test_16 SAFE_TEST_FEEDRATE
+    uint32_t startDelayMs = 1000;           // test_16 startRecipe() delay
+    uint32_t settleMs = 500;                // Between steps (test_16 delay(500))
+    uint32_t reactionUs = 200;              // Line received -> acted on
+    uint32_t pollMs = 0;                    // '?' period, 0 = auto-report only
+    bool flowMonitor = true;
+    bool flowControl = true;                // Feed-override flow loop (flow_control.h)
+};
+
+struct BatchParams {
+    SimConfig sim = SimConfig::rodentUart();
+    uint32_t baud = 115200;
+    PlantParams plant;
+    ControlParams control;
+    std::vector<OperatorAction> script;
+    int64_t timeoutUs = 3600LL * 1000000;   // Virtual
+};
+
+struct StepResult {
+    char pump;
+    float targetG;
+    float deliveredG;           // Into the container (true mass)
+    float scaleG;               // Scale delta the controller saw at completion
+    float targetFlowGS;         // Mass flow the move's feed commands
+    float flowGS;               // True mean mass flow over the move
+    int64_t motionStartUs;
+    int64_t motionEndUs;
+    int64_t completeUs;         // Controller considered the step done
+};
+
+struct BatchResult {
+    bool completed = false;
+    std::string abortReason;
+    int64_t makespanUs = 0;     // Recipe start -> last step complete
+    std::vector<StepResult> steps;
+    uint8_t flowFaultCode = 0;
+    uint32_t prematureSteps = 0; // Declared done while the pump was still moving
+
+    // Control-loop latencies
+    latency_hist_t statusAge;   // Report generated -> handled by the controller
+    latency_hist_t doneDetect;  // Motion stopped -> controller saw the step done
+    latency_hist_t stepGap;     // Motion stopped -> next step's motion started
+    latency_hist_t faultDetect; // Scripted tube burst -> feed hold sent
+
+    uint64_t events = 0;        // Loop iterations (cost of the run)
+    uint32_t linesSent = 0;
+    uint32_t linesReceived = 0;
+};
+
+/**
+ * @brief Run one recipe to completion, abort or timeout in virtual time
+ */
+BatchResult runBatch(const Recipe &recipe, const BatchParams &params, uint32_t seed);
+
+/**
+ * @brief "stop@30000,resume@35000,burst:Y@20000" (times in ms)
+ * @return false on a malformed entry
+ */
+bool parseScript(const std::string &text, std::vector<OperatorAction> &out);
+
+#endif // BATCH_SIM_H
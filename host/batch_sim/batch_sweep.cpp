@@ -0,0 +1,305 @@
+/**
+ * @file batch_sweep.cpp
+ * @brief Run recipes in virtual time across parameter sweeps
+ *
+ * Every combination of the --sweep values is one point; each point runs
+ * every selected recipe --runs times (seeds seed, seed+1, ...) and prints
+ * makespan, dosing error, mass-flow error and control-loop latency
+ * distributions. With
+ * --csv, every run is also written as one row for offline analysis.
+ *
+ *   batch_sim [options]
+ *     --recipe NAME|N|all   test_16 recipe (1-3 or name, default all)
+ *     --runs N              runs per recipe and point (100)
+ *     --seed N              first seed (1)
+ *     --policy P            firmware | test16 (firmware)
+ *     --set KEY=V           fixed parameter (repeatable)
+ *     --sweep KEY=V1,V2..   swept parameter (repeatable, cartesian product)
+ *     --script TEXT         operator actions, e.g. "stop@30000,resume@35000,burst:Y@20000"
+ *     --csv FILE            per-run rows
+ *
+ * Keys: feed_cap, settle_ms, start_ms, poll_ms, reaction_us, monitor,
+ * flow_control, ctrl_ml_per_mm, true_ml_per_mm, cal_sd, slip, transit_s, tau_s, noise_g,
+ * scale_ms, report_ms, baud, accel, max_rate, motion_step_us, policy
+ * (0 = firmware, 1 = test16).
+ *
+ * Build & run:
+ *   pio run -e host_batch_sim
+ *   .pio/build/host_batch_sim/program --recipe 3 --sweep settle_ms=0,100,500
+ */
+
+#include <time.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "batch_sim.h"
+
+struct Sweep {
+    std::string key;
+    std::vector<double> values;
+};
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [--recipe NAME|N|all] [--runs N] [--seed N] [--policy firmware|test16]\n"
+            "          [--set KEY=V] [--sweep KEY=V1,V2,...] [--script TEXT] [--csv FILE]\n", prog);
+}
+
+static bool applyParam(BatchParams &bp, const std::string &key, double v) {
+    ControlParams &c = bp.control;
+    PlantParams &pl = bp.plant;
+    if (key == "feed_cap") c.feedCapMmMin = (float)v;
+    else if (key == "settle_ms") c.settleMs = (uint32_t)v;
+    else if (key == "start_ms") c.startDelayMs = (uint32_t)v;
+    else if (key == "poll_ms") c.pollMs = (uint32_t)v;
+    else if (key == "reaction_us") c.reactionUs = (uint32_t)v;
+    else if (key == "monitor") c.flowMonitor = v != 0.0;
+    else if (key == "flow_control") c.flowControl = v != 0.0;
+    else if (key == "ctrl_ml_per_mm") c.mlPerMm = (float)v;
+    else if (key == "policy") c.policy = v != 0.0 ? CompletionPolicy::Test16 : CompletionPolicy::Firmware;
+    else if (key == "true_ml_per_mm") pl.mlPerMm = (float)v;
+    else if (key == "cal_sd") pl.calibrationSd = (float)v;
+    else if (key == "slip") pl.slip = (float)v;
+    else if (key == "transit_s") pl.transitS = (float)v;
+    else if (key == "tau_s") pl.scaleTauS = (float)v;
+    else if (key == "noise_g") pl.noiseG = (float)v;
+    else if (key == "scale_ms") pl.scalePeriodMs = (uint32_t)v;
+    else if (key == "report_ms") bp.sim.reportIntervalMs = (uint32_t)v;
+    else if (key == "baud") bp.baud = (uint32_t)v;
+    else if (key == "motion_step_us") bp.sim.motionStepUs = (uint32_t)v;
+    else if (key == "accel" || key == "max_rate") {
+        for (SimAxisConfig &ax : bp.sim.axes) {
+            (key == "accel" ? ax.accelMmS2 : ax.maxRateMmMin) = (float)v;
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+static bool splitKeyValue(const std::string &arg, std::string &key, std::string &value) {
+    size_t eq = arg.find('=');
+    if (eq == std::string::npos || eq == 0) return false;
+    key = arg.substr(0, eq);
+    value = arg.substr(eq + 1);
+    return true;
+}
+
+static double percentile(std::vector<double> v, double pct) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    size_t i = (size_t)std::ceil(pct / 100.0 * (double)v.size());
+    return v[i == 0 ? 0 : std::min(i, v.size()) - 1];
+}
+
+static void meanSd(const std::vector<double> &v, double &mean, double &sd) {
+    mean = sd = 0.0;
+    if (v.empty()) return;
+    for (double x : v) mean += x;
+    mean /= (double)v.size();
+    for (double x : v) sd += (x - mean) * (x - mean);
+    sd = v.size() > 1 ? std::sqrt(sd / (double)(v.size() - 1)) : 0.0;
+}
+
+static std::vector<double> absValues(const std::vector<double> &v) {
+    std::vector<double> out;
+    for (double x : v) out.push_back(std::fabs(x));
+    return out;
+}
+
+static void printError(const char *label, const std::vector<double> &err) {
+    double mean, sd;
+    meanSd(err, mean, sd);
+    std::vector<double> absErr = absValues(err);
+    printf("  %-16s mean %+7.3f g  sd %6.3f g  p99|e| %6.3f g  max|e| %6.3f g\n", label, mean, sd,
+           percentile(absErr, 99.0), percentile(absErr, 100.0));
+}
+
+static double monoSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char **argv) {
+    std::vector<const Recipe *> selected;
+    std::vector<Sweep> sweeps;
+    BatchParams base;
+    uint32_t runs = 100;
+    uint32_t seed = 1;
+    std::string recipeArg = "all";
+    std::string csvPath;
+
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool hasValue = i + 1 < argc;
+        std::string key, value;
+        if (a == "--recipe" && hasValue) {
+            recipeArg = argv[++i];
+        } else if (a == "--runs" && hasValue) {
+            runs = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        } else if (a == "--seed" && hasValue) {
+            seed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        } else if (a == "--policy" && hasValue) {
+            std::string policy = argv[++i];
+            if (policy != "firmware" && policy != "test16") { usage(argv[0]); return 2; }
+            base.control.policy = policy == "test16" ? CompletionPolicy::Test16 : CompletionPolicy::Firmware;
+        } else if (a == "--set" && hasValue && splitKeyValue(argv[++i], key, value)) {
+            if (!applyParam(base, key, strtod(value.c_str(), nullptr))) {
+                fprintf(stderr, "unknown parameter: %s\n", key.c_str());
+                return 2;
+            }
+        } else if (a == "--sweep" && hasValue && splitKeyValue(argv[++i], key, value)) {
+            Sweep s{key, {}};
+            for (size_t pos = 0; pos <= value.size();) {
+                size_t comma = value.find(',', pos);
+                if (comma == std::string::npos) comma = value.size();
+                s.values.push_back(strtod(value.substr(pos, comma - pos).c_str(), nullptr));
+                pos = comma + 1;
+            }
+            BatchParams probe;
+            if (!applyParam(probe, key, 0.0)) {
+                fprintf(stderr, "unknown parameter: %s\n", key.c_str());
+                return 2;
+            }
+            sweeps.push_back(s);
+        } else if (a == "--script" && hasValue) {
+            if (!parseScript(argv[++i], base.script)) {
+                fprintf(stderr, "bad script: %s\n", argv[i]);
+                return 2;
+            }
+        } else if (a == "--csv" && hasValue) {
+            csvPath = argv[++i];
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (runs == 0) runs = 1;
+
+    const std::vector<Recipe> &recipes = builtinRecipes();
+    for (size_t r = 0; r < recipes.size(); r++) {
+        if (recipeArg == "all" || recipeArg == recipes[r].name || recipeArg == std::to_string(r + 1)) {
+            selected.push_back(&recipes[r]);
+        }
+    }
+    if (selected.empty()) {
+        fprintf(stderr, "no recipe matches \"%s\"\n", recipeArg.c_str());
+        return 2;
+    }
+
+    FILE *csv = nullptr;
+    if (!csvPath.empty()) {
+        csv = fopen(csvPath.c_str(), "w");
+        if (!csv) {
+            perror(csvPath.c_str());
+            return 1;
+        }
+        fprintf(csv, "point,recipe,seed,completed,abort,makespan_s,step,pump,target_g,delivered_g,scale_g,"
+                     "target_flow_g_s,flow_g_s\n");
+    }
+
+    size_t points = 1;
+    for (const Sweep &s : sweeps) points *= s.values.size();
+
+    printf("\n╔════════════════════════════════════════════════════════════╗\n");
+    printf("║          Batch Simulation (virtual time, FluidNC sim)      ║\n");
+    printf("╚════════════════════════════════════════════════════════════╝\n");
+    printf("%zu point(s) x %zu recipe(s) x %lu runs, policy %s\n", points, selected.size(),
+           (unsigned long)runs, base.control.policy == CompletionPolicy::Test16 ? "test16" : "firmware");
+
+    const double wallStart = monoSeconds();
+    uint64_t batches = 0;
+    double virtualS = 0.0;
+
+    for (size_t point = 0; point < points; point++) {
+        BatchParams bp = base;
+        std::string label;
+        size_t index = point;
+        for (const Sweep &s : sweeps) {
+            double v = s.values[index % s.values.size()];
+            index /= s.values.size();
+            applyParam(bp, s.key, v);
+            char buf[64];
+            snprintf(buf, sizeof(buf), "%s%s=%g", label.empty() ? "" : " ", s.key.c_str(), v);
+            label += buf;
+        }
+
+        for (const Recipe *recipe : selected) {
+            std::vector<double> makespan, delivered, reported, flow;
+            uint32_t completed = 0, premature = 0;
+            std::string lastAbort;
+            BatchResult sum;
+            latency_hist_reset(&sum.statusAge);
+            latency_hist_reset(&sum.doneDetect);
+            latency_hist_reset(&sum.stepGap);
+            latency_hist_reset(&sum.faultDetect);
+
+            for (uint32_t r = 0; r < runs; r++) {
+                BatchResult res = runBatch(*recipe, bp, seed + r);
+                batches++;
+                virtualS += res.makespanUs * 1e-6;
+                if (res.completed) {
+                    completed++;
+                    makespan.push_back(res.makespanUs * 1e-6);
+                } else {
+                    lastAbort = res.abortReason;
+                }
+                premature += res.prematureSteps;
+                for (size_t s = 0; s < res.steps.size(); s++) {
+                    const StepResult &sr = res.steps[s];
+                    if (res.completed) {
+                        delivered.push_back(sr.deliveredG - sr.targetG);
+                        reported.push_back(sr.scaleG - sr.targetG);
+                        if (sr.targetFlowGS > 0.0f) flow.push_back(100.0 * (sr.flowGS / sr.targetFlowGS - 1.0));
+                    }
+                    if (csv) {
+                        fprintf(csv, "%zu,%s,%lu,%d,%s,%.3f,%zu,%c,%.3f,%.4f,%.3f,%.4f,%.4f\n", point,
+                                recipe->name.c_str(), (unsigned long)(seed + r), res.completed ? 1 : 0,
+                                res.abortReason.c_str(), res.makespanUs * 1e-6, s + 1, sr.pump,
+                                sr.targetG, sr.deliveredG, sr.scaleG, sr.targetFlowGS, sr.flowGS);
+                    }
+                }
+                latency_hist_merge(&sum.statusAge, &res.statusAge);
+                latency_hist_merge(&sum.doneDetect, &res.doneDetect);
+                latency_hist_merge(&sum.stepGap, &res.stepGap);
+                latency_hist_merge(&sum.faultDetect, &res.faultDetect);
+            }
+
+            printf("\n[%s]%s%s\n", recipe->name.c_str(), label.empty() ? "" : " ", label.c_str());
+            printf("  completed %lu/%lu", (unsigned long)completed, (unsigned long)runs);
+            if (completed < runs) printf("  (last abort: %s)", lastAbort.c_str());
+            if (premature) printf("  premature steps %lu", (unsigned long)premature);
+            printf("\n");
+            if (!makespan.empty()) {
+                printf("  makespan         p50 %7.2f s  p99 %7.2f s  max %7.2f s\n",
+                       percentile(makespan, 50.0), percentile(makespan, 99.0), percentile(makespan, 100.0));
+                printError("delivered-target", delivered);
+                printError("scale-target", reported);
+                if (!flow.empty()) {
+                    double mean, sd;
+                    meanSd(flow, mean, sd);
+                    printf("  flow vs target   mean %+7.2f %%  sd %6.2f %%  p99|e| %6.2f %%\n", mean, sd,
+                           percentile(absValues(flow), 99.0));
+                }
+            }
+            latency_hist_print("  status age      ", &sum.statusAge);
+            latency_hist_print("  done detect     ", &sum.doneDetect);
+            latency_hist_print("  step gap        ", &sum.stepGap);
+            if (sum.faultDetect.count) latency_hist_print("  fault detect    ", &sum.faultDetect);
+        }
+    }
+
+    double wall = monoSeconds() - wallStart;
+    printf("\n%llu batches in %.2f s wall (%.0f batches/min, %.0fx real time)\n",
+           (unsigned long long)batches, wall, wall > 0.0 ? batches * 60.0 / wall : 0.0,
+           wall > 0.0 ? virtualS / wall : 0.0);
+    if (csv) fclose(csv);
+    return 0;
+}
@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""
+Compare benchmark results against a committed baseline.
+
+    bench_compare.py RESULTS BASELINE [--update]
+
+RESULTS is the JSON written by the host suite (host_bench --json FILE)
+or a serial log of test_21_benchmark: the JSON between the
+BENCH-JSON-BEGIN / BENCH-JSON-END markers is used.
+
+Each baseline metric has a value, a direction ("better": higher/lower)
+and a tolerance in percent (per metric "tolerance_pct", else the file's
+"default_tolerance_pct"). A result worse than the baseline by more than
+the tolerance is a regression; a missing metric is a failure. Exit code
+1 on any failure, so the comparison can gate a commit.
+
+--update rewrites BASELINE from RESULTS, keeping existing tolerances.
+Only do that for an intended change, and commit it with the change.
+"""
+
+import json
+import sys
+
+BEGIN = "BENCH-JSON-BEGIN"
+END = "BENCH-JSON-END"
+DEFAULT_TOLERANCE_PCT = 10.0
+
+
+def load_results(path):
+    with open(path, encoding="utf-8", errors="replace") as f:
+        text = f.read()
+    if BEGIN in text:
+        # Serial log: last complete block wins
+        start = text.rindex(BEGIN) + len(BEGIN)
+        end = text.find(END, start)
+        if end < 0:
+            raise ValueError(f"{path}: {BEGIN} without {END}")
+        text = text[start:end]
+    return json.loads(text)
+
+
+def check(name, base, current, default_tol):
+    tol = base.get("tolerance_pct", default_tol)
+    b = float(base["value"])
+    c = float(current["value"])
+    higher = base.get("better", current.get("better")) == "higher"
+    limit = b * (1.0 - tol / 100.0) if higher else b * (1.0 + tol / 100.0)
+    regressed = c < limit if higher else c > limit
+    delta = (c - b) / b * 100.0 if b else 0.0
+    improved = (c > b) if higher else (c < b)
+    status = "REGRESSION" if regressed else ("improved" if improved and abs(delta) > tol else "ok")
+    return status, b, c, delta, tol
+
+
+def main(argv):
+    args = [a for a in argv[1:] if not a.startswith("--")]
+    update = "--update" in argv
+    if len(args) != 2:
+        print(__doc__.strip(), file=sys.stderr)
+        return 2
+    results_path, baseline_path = args
+
+    results = load_results(results_path)
+    try:
+        with open(baseline_path, encoding="utf-8") as f:
+            baseline = json.load(f)
+    except FileNotFoundError:
+        baseline = {"suite": results.get("suite"), "default_tolerance_pct": DEFAULT_TOLERANCE_PCT,
+                    "metrics": {}}
+
+    if results.get("suite") != baseline.get("suite"):
+        print(f"suite mismatch: results '{results.get('suite')}', baseline '{baseline.get('suite')}'",
+              file=sys.stderr)
+        return 2
+
+    current = results["metrics"]
+    base = baseline["metrics"]
+    default_tol = baseline.get("default_tolerance_pct", DEFAULT_TOLERANCE_PCT)
+
+    if update:
+        for name, m in current.items():
+            entry = {"value": m["value"], "unit": m.get("unit", ""), "better": m.get("better", "lower")}
+            if "tolerance_pct" in base.get(name, {}):
+                entry["tolerance_pct"] = base[name]["tolerance_pct"]
+            elif m.get("kind") == "cpu":
+                entry["tolerance_pct"] = 50.0
+            base[name] = entry
+        baseline["metrics"] = dict(sorted(base.items()))
+        with open(baseline_path, "w", encoding="utf-8") as f:
+            json.dump(baseline, f, indent=2)
+            f.write("\n")
+        print(f"baseline {baseline_path} updated ({len(current)} metrics)")
+        return 0
+
+    failures = 0
+    print(f"{'metric':40} {'baseline':>14} {'current':>14} {'delta':>8}  tol   status")
+    for name in sorted(base):
+        if name not in current:
+            print(f"{name:40} {base[name]['value']:>14.6g} {'-':>14} {'':>8}        MISSING")
+            failures += 1
+            continue
+        status, b, c, delta, tol = check(name, base[name], current[name], default_tol)
+        print(f"{name:40} {b:>14.6g} {c:>14.6g} {delta:>+7.1f}% {tol:>4.0f}%  {status}")
+        failures += status == "REGRESSION"
+    for name in sorted(set(current) - set(base)):
+        print(f"{name:40} {'-':>14} {current[name]['value']:>14.6g} {'':>8}        new (not in baseline)")
+
+    print(f"\n{'FAIL' if failures else 'PASS'}: {failures} regression(s) / missing metric(s)")
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
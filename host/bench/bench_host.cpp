@@ -0,0 +1,906 @@
+/**
+ * @file bench_host.cpp
+ * @brief Host benchmark suite: parse rates, UART throughput, e-stop latency,
+ *        stop recovery, limits discovery, recipe makespan, batch queue, resume after a power cut,
+ *        reservoir stock, dosing accuracy vs speed, bias correction, soak
+ *
+ * Two kinds of metric:
+ * - cpu:     wall-clock rates of the shared parsers on this machine; only
+ *            comparable on the same machine, so the baseline is loose
+ * - virtual: deterministic results from the FluidNC simulator, the e-stop
+ *            model and the batch harness; any change is a behaviour change
+ *
+ * Heap high-water mark and loop jitter are ESP32 properties and only come
+ * from the on-target variant (test_21_benchmark). Both variants print the
+ * same JSON layout; host/bench/bench_compare.py checks either against a
+ * committed baseline.
+ *
+ * Build & run:
+ *   pio run -e host_bench
+ *   .pio/build/host_bench/program --json bench.json
+ *   python3 host/bench/bench_compare.py bench.json host/bench/baseline_host.json
+ *
+ * Options: --json FILE ("-" = stdout), --soak N (batches in the soak
+ * run, default 200). Run counts are fixed otherwise: the virtual metrics
+ * are only comparable with the baseline at the same counts.
+ */
+
+#include <time.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "batch_queue.h"
+#include "dose_journal.h"
+#include "dose_stats.h"
+#include "inventory.h"
+#include "batch_sim/batch_sim.h"
+#include "fluidnc_sim/fluidnc_sim.h"
+#include "fluidnc_sim/uart_link.h"
+#include "fluidnc_config.h"
+#include "fluidnc_ctl.h"
+#include "fluidnc_status.h"
+#include "latency_hist.h"
+#include "safety_latency.h"
+#include "scale_weight.h"
+#include "scenarios/estop_model.h"
+
+#define CPU_BENCH_MIN_S         0.3     // Per parse benchmark
+#define UART_BENCH_US           10000000LL
+#define RX_BUFFER_BYTES         128     // FluidNC serial RX buffer (character counting)
+
+struct Metric {
+    std::string name;
+    double value;
+    const char *unit;
+    bool higherIsBetter;
+    const char *kind;           // "cpu" or "virtual"
+};
+
+static std::vector<Metric> metrics;
+static FILE *report = stdout;          // Human-readable table (stderr when JSON goes to stdout)
+
+static void record(const std::string &name, double value, const char *unit, bool higherIsBetter,
+                   const char *kind) {
+    metrics.push_back({name, value, unit, higherIsBetter, kind});
+    fprintf(report, "  %-34s %14.3f %s\n", name.c_str(), value, unit);
+}
+
+static double monoSeconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double percentile(std::vector<double> v, double pct) {
+    if (v.empty()) return 0.0;
+    std::sort(v.begin(), v.end());
+    size_t i = (size_t)std::ceil(pct / 100.0 * (double)v.size());
+    return v[i == 0 ? 0 : std::min(i, v.size()) - 1];
+}
+
+static std::string slug(const std::string &name) {
+    std::string out;
+    for (char c : name) out.push_back(isalnum((unsigned char)c) ? (char)tolower((unsigned char)c) : '_');
+    return out;
+}
+
+// ============================================================================
+// PARSERS (cpu)
+// ============================================================================
+
+static const char *const STATUS_LINES[] = {
+    "<Idle|MPos:0.000,0.000,0.000,0.000|FS:0,0|Ov:100,100,100>",
+    "<Run|MPos:12.345,0.000,0.000,0.000|FS:150,0>",
+    "<Run|MPos:-1.250,3.500,0.000,7.125|FS:300.0,0|WCO:0.000,0.000,0.000,0.000>",
+    "<Hold:1|MPos:40.012,0.000,0.000,0.000|FS:75,0|Ov:100,100,100>",
+    "<Hold:0|MPos:40.100,0.000,0.000,0.000|FS:0,0>",
+    "<Jog|WPos:5.000,0.000,0.000,0.000|FS:500,0|Pn:X>",
+    "<Alarm|MPos:0.000,0.000,0.000,0.000|FS:0,0>",
+    "<Idle|MPos:100.000,20.000,30.000,10.000|FS:0,0|Ov:120,100,100|A:S>",
+};
+
+static const char *const WEIGHT_LINES[] = {
+    "  +012.34 g",
+    "ST,GS,  -0.50 g",
+    "+0000.00g",
+    "US,GS, 1234.5 g",
+    "  +001.07 g\r",
+    "OL",
+};
+
+template <typename Fn>
+static double rate(Fn fn, size_t perIteration) {
+    uint64_t items = 0;
+    volatile uint32_t sink = 0;
+    double start = monoSeconds();
+    double elapsed;
+    do {
+        for (int rep = 0; rep < 1000; rep++) {
+            sink = sink + fn();
+            items += perIteration;
+        }
+        elapsed = monoSeconds() - start;
+    } while (elapsed < CPU_BENCH_MIN_S);
+    (void)sink;
+    return (double)items / elapsed;
+}
+
+static void benchParsers() {
+    fprintf(report, "\n[parsers]\n");
+    const size_t nStatus = sizeof(STATUS_LINES) / sizeof(STATUS_LINES[0]);
+    double statusRate = rate([&]() {
+        uint32_t ok = 0;
+        fluidnc_status_t st;
+        for (size_t i = 0; i < nStatus; i++) ok += fluidnc_status_parse(STATUS_LINES[i], &st);
+        return ok;
+    }, nStatus);
+    record("status_parse_rate", statusRate, "lines/s", true, "cpu");
+
+    const size_t nWeight = sizeof(WEIGHT_LINES) / sizeof(WEIGHT_LINES[0]);
+    double weightRate = rate([&]() {
+        uint32_t ok = 0;
+        float g;
+        char unit[8];
+        for (size_t i = 0; i < nWeight; i++) ok += scale_weight_parse(WEIGHT_LINES[i], &g, unit, sizeof(unit));
+        return ok;
+    }, nWeight);
+    record("weight_parse_rate", weightRate, "lines/s", true, "cpu");
+}
+
+// ============================================================================
+// UART THROUGHPUT (virtual)
+// ============================================================================
+
+/**
+ * @brief "G4 P0" lines per second through the simulator for UART_BENCH_US
+ * @param streaming false: one line in flight (wait for "ok", as
+ *        task_control.c); true: character counting against the RX buffer
+ */
+static double commandsPerSecond(bool streaming) {
+    static const std::string CMD = "G4 P0\n";
+    FluidncSim sim(SimConfig::rodentUart());
+    UartLink toSim(115200);
+    UartLink toEsp(115200);
+    std::vector<size_t> inFlight;          // Lengths of lines awaiting "ok"
+    size_t inFlightBytes = 0;
+    uint32_t acked = 0;
+    std::string rx;
+    int64_t t = 0;
+
+    while (t < UART_BENCH_US) {
+        while ((streaming ? inFlightBytes + CMD.size() <= RX_BUFFER_BYTES : inFlight.empty())) {
+            toSim.send(CMD, t);
+            inFlight.push_back(CMD.size());
+            inFlightBytes += CMD.size();
+        }
+
+        int64_t next = UART_BENCH_US;
+        for (int64_t at : {toSim.nextArrivalUs(), toEsp.nextArrivalUs(), sim.nextOutputUs()}) {
+            if (at >= 0 && at < next) next = at;
+        }
+        t = std::max(t, next);
+
+        uint8_t b;
+        int64_t at;
+        while (toSim.receive(t, b, &at)) sim.receive(b, at);
+        sim.advance(t);
+        SimOutput out;
+        while (sim.popOutput(out)) toEsp.send(out.line + "\r\n", out.atUs);
+        while (toEsp.receive(t, b)) {
+            if (b != '\n') {
+                if (b != '\r') rx.push_back((char)b);
+                continue;
+            }
+            if (rx == "ok" && !inFlight.empty()) {
+                inFlightBytes -= inFlight.front();
+                inFlight.erase(inFlight.begin());
+                acked++;
+            }
+            rx.clear();
+        }
+    }
+    return acked / (UART_BENCH_US * 1e-6);
+}
+
+static void benchUart() {
+    fprintf(report, "\n[uart]\n");
+    record("uart_cmds_per_s_ack", commandsPerSecond(false), "cmd/s", true, "virtual");
+    record("uart_cmds_per_s_stream", commandsPerSecond(true), "cmd/s", true, "virtual");
+}
+
+// ============================================================================
+// E-STOP (virtual)
+// ============================================================================
+
+static void benchEstop(uint32_t runs) {
+    fprintf(report, "\n[estop]\n");
+    for (const char *name : {"pump_run", "fifo_backlog"}) {
+        const EstopScenario *sc = findEstopScenario(name);
+        safety_latency_reset();
+        estopModelSeed(0x12345678u);
+        for (uint32_t i = 0; i < runs; i++) runEstopOnce(*sc);
+        std::string base = std::string("estop_") + name;
+        record(base + "_hold_p99_us", latency_hist_percentile(safety_latency_hist(SAFETY_STAGE_HOLD), 99.0f),
+               "us", false, "virtual");
+        record(base + "_stopped_p99_us",
+               latency_hist_percentile(safety_latency_hist(SAFETY_STAGE_STOPPED), 99.0f), "us", false, "virtual");
+    }
+}
+
+// ============================================================================
+// STOP RECOVERY (virtual)
+// ============================================================================
+
+/**
+ * @brief Pump running for 1 s, then fluidnc_ctl_stop() until READY
+ * @param motion Line that starts the pump; nullptr: idle, ALARM:1 raised at 1 s
+ * @param alarms ALARM lines after the stop (a clean stop raises none)
+ * @return ms from the stop to READY, 0 if it never got there
+ */
+static double recoveryMs(const char *motion, uint32_t *alarms) {
+    const int64_t stopUs = 1000000, endUs = 5000000, stepUs = 500;
+    FluidncSim sim(SimConfig::rodentUart());
+    UartLink toSim(115200);
+    UartLink toEsp(115200);
+    fluidnc_ctl_init(nullptr);
+    std::string rx;
+    *alarms = 0;
+
+    if (motion) toSim.send(std::string(motion) + "\n", 0);
+    for (int64_t t = 0; t < endUs; t += stepUs) {
+        if (t == stopUs) {
+            if (!motion) sim.raiseAlarm(1, t);
+            fluidnc_ctl_stop(t);
+        }
+        fluidnc_ctl_action_t action;
+        while (t >= stopUs && fluidnc_ctl_poll(t, &action)) {
+            if (action.kind == FLUIDNC_CTL_ACTION_REALTIME) {
+                toSim.insert(0, std::string(1, (char)action.byte), t);      // Realtime: HW FIFO path
+            } else {
+                toSim.send(std::string(action.line) + "\n", t);
+            }
+        }
+
+        uint8_t b;
+        int64_t at;
+        while (toSim.receive(t, b, &at)) sim.receive(b, at);
+        sim.advance(t);
+        SimOutput out;
+        while (sim.popOutput(out)) toEsp.send(out.line + "\r\n", out.atUs);
+        while (toEsp.receive(t, b)) {
+            if (b != '\n') {
+                if (b != '\r') rx.push_back((char)b);
+                continue;
+            }
+            fluidnc_status_t status;
+            if (fluidnc_status_parse(rx.c_str(), &status)) {
+                fluidnc_ctl_on_status(&status, t);
+            } else if (!fluidnc_ctl_on_line(rx.c_str(), t) && t >= stopUs && rx.rfind("ALARM:", 0) == 0) {
+                (*alarms)++;
+            }
+            rx.clear();
+        }
+        if (t > stopUs && fluidnc_ctl_ready()) {
+            fluidnc_ctl_stats_t st;
+            fluidnc_ctl_get_stats(&st);
+            return st.last_us / 1000.0;
+        }
+    }
+    return 0.0;
+}
+
+static void benchRecovery() {
+    fprintf(report, "\n[stop recovery]\n");
+    static const struct {
+        const char *name;
+        const char *motion;
+    } cases[] = {
+        {"jog_cancel", "$J=G91 X1000 F150"},    // Dose to weight as a jog: 0x85, no reset
+        {"hold_reset", "G91 G1 X1000 F150"},    // G1: '!', Hold:0, Ctrl-X, banner
+        {"alarm_unlock", nullptr},              // $X only
+    };
+    uint32_t alarms = 0;
+    for (const auto &c : cases) {
+        uint32_t n;
+        record(std::string("recovery_ms.") + c.name, recoveryMs(c.motion, &n), "ms", false, "virtual");
+        if (c.motion) alarms += n;          // alarm_unlock starts from one
+    }
+    record("recovery_alarms", alarms, "alarms", false, "virtual");
+}
+
+// ============================================================================
+// LIMITS DISCOVERY (virtual)
+// ============================================================================
+
+/**
+ * @brief Boot-time "$I" (+ "$$" on a cache miss) against the simulator
+ * @return ms to DONE, 0 if it never got there
+ */
+static double discoveryMs(const fluidnc_config_t *cached, fluidnc_config_t *out) {
+    const int64_t endUs = 2000000, stepUs = 500;
+    FluidncSim sim(SimConfig::rodentUart());
+    UartLink toSim(115200);
+    UartLink toEsp(115200);
+    fluidnc_config_init(nullptr);
+    fluidnc_config_start(cached, 0);
+    std::string rx;
+
+    for (int64_t t = 0; t < endUs; t += stepUs) {
+        if (const char *line = fluidnc_config_poll(t)) toSim.send(std::string(line) + "\n", t);
+
+        uint8_t b;
+        int64_t at;
+        while (toSim.receive(t, b, &at)) sim.receive(b, at);
+        sim.advance(t);
+        SimOutput o;
+        while (sim.popOutput(o)) toEsp.send(o.line + "\r\n", o.atUs);
+        while (toEsp.receive(t, b)) {
+            if (b != '\n') {
+                if (b != '\r') rx.push_back((char)b);
+                continue;
+            }
+            fluidnc_config_on_line(rx.c_str(), t);
+            rx.clear();
+        }
+        if (fluidnc_config_state() == FLUIDNC_CONFIG_DONE) {
+            *out = *fluidnc_config_get();
+            fluidnc_config_stats_t st;
+            fluidnc_config_get_stats(&st);
+            return st.last_us / 1000.0;
+        }
+    }
+    return 0.0;
+}
+
+static void benchDiscovery() {
+    fprintf(report, "\n[limits discovery]\n");
+    fluidnc_config_t cold, warm;
+    record("config_ms.cold", discoveryMs(nullptr, &cold), "ms", false, "virtual");    // "$I" + "$$"
+    record("config_ms.warm", discoveryMs(&cold, &warm), "ms", false, "virtual");      // "$I", cache hit
+    // btt_rodent_uart.yaml: 200 mm/min, not the sketches' 300
+    record("config_max_rate_x", warm.axis_count > 0 ? warm.axes[0].max_rate_mm_min : 0.0, "mm/min", true,
+           "virtual");
+}
+
+// ============================================================================
+// RECIPES, DOSING, SOAK (virtual)
+// ============================================================================
+
+static BatchParams benchParams() {
+    // Machine + protocol time only: no start delay or settle pauses
+    BatchParams bp;
+    bp.control.startDelayMs = 0;
+    bp.control.settleMs = 0;
+    return bp;
+}
+
+static void benchRecipes() {
+    fprintf(report, "\n[recipes]\n");
+    BatchParams bp = benchParams();
+    for (const Recipe &recipe : builtinRecipes()) {
+        BatchResult res = runBatch(recipe, bp, 1);
+        record("makespan_s." + slug(recipe.name), res.completed ? res.makespanUs * 1e-6 : 0.0, "s", false,
+               "virtual");
+    }
+}
+
+/**
+ * @brief `batches` back-to-back batches of one recipe through batch_queue.h
+ *        (streamed, no container swap) against the simulator
+ * @param gapMs Longest batch done -> next batch's first line
+ * @return Seconds per batch, 0 if the queue did not finish
+ */
+static double queueSecondsPerBatch(const Recipe &recipe, uint16_t batches, double *gapMs) {
+    const int64_t endUs = (int64_t)batches * 300000000, stepUs = 1000;
+    std::vector<batch_step_t> steps;
+    for (const Ingredient &ing : recipe.steps) steps.push_back({ing.pump, ing.volumeMl, ing.flowRateMlMin});
+    batch_recipe_t table[] = {{recipe.name.c_str(), steps.data(), (uint8_t)steps.size()}};
+
+    FluidncSim sim(SimConfig::rodentUart());
+    UartLink toSim(115200);
+    UartLink toEsp(115200);
+    batch_queue_config_t cfg = BATCH_QUEUE_DEFAULT_CONFIG;
+    cfg.recipes = table;
+    cfg.recipe_count = 1;
+    cfg.swap = BATCH_SWAP_NONE;
+    batch_queue_init(&cfg);
+    uint8_t id = 0;
+    batch_queue_add(&id, 1, batches);
+    batch_queue_run(0);
+    std::string rx;
+
+    for (int64_t t = 0; t < endUs; t += stepUs) {
+        if (const char *line = batch_queue_poll(t)) toSim.send(std::string(line) + "\n", t);
+
+        uint8_t b;
+        int64_t at;
+        while (toSim.receive(t, b, &at)) sim.receive(b, at);
+        sim.advance(t);
+        SimOutput o;
+        while (sim.popOutput(o)) toEsp.send(o.line + "\r\n", o.atUs);
+        while (toEsp.receive(t, b)) {
+            if (b != '\n') {
+                if (b != '\r') rx.push_back((char)b);
+                continue;
+            }
+            batch_queue_on_line(rx.c_str(), t);
+            rx.clear();
+        }
+        if (batch_queue_state() == BATCH_QUEUE_IDLE) {
+            batch_queue_stats_t st;
+            batch_queue_get_stats(&st);
+            *gapMs = st.gap_us_max / 1000.0;
+            return st.batches_done == batches ? t * 1e-6 / batches : 0.0;
+        }
+    }
+    return 0.0;
+}
+
+static void benchQueue() {
+    fprintf(report, "\n[batch queue]\n");
+    // Compare with makespan_s.*: steps streamed into the planner, no per-batch restart
+    double gapMs = 0.0;
+    for (const Recipe &recipe : builtinRecipes()) {
+        record("queue_s_per_batch." + slug(recipe.name), queueSecondsPerBatch(recipe, 5, &gapMs), "s", false,
+               "virtual");
+    }
+    record("queue_gap_ms_max", gapMs, "ms", false, "virtual");
+}
+
+static dose_journal_t journal;
+
+static void journalStarted(const batch_plan_t *plan, int64_t) {
+    dose_journal_start(&journal, plan, NAN);
+}
+
+static void journalFinished(const batch_plan_t *, int64_t) {
+    dose_journal_done(&journal, NAN);
+}
+
+/** Simulator and UART as seen by a board that can lose power */
+struct JournalRig {
+    FluidncSim sim{SimConfig::rodentUart()};
+    UartLink toSim{115200};
+    UartLink toEsp{115200};
+    std::string rx;
+    fluidnc_status_t last{};
+    bool fresh = false;         // A report arrived since the last '?'
+
+    void tick(int64_t t) {
+        if (const char *line = batch_queue_poll(t)) toSim.send(std::string(line) + "\n", t);
+        uint8_t b;
+        int64_t at;
+        while (toSim.receive(t, b, &at)) sim.receive(b, at);
+        sim.advance(t);
+        SimOutput o;
+        while (sim.popOutput(o)) toEsp.send(o.line + "\r\n", o.atUs);
+        while (toEsp.receive(t, b)) {
+            if (b != '\n') {
+                if (b != '\r') rx.push_back((char)b);
+                continue;
+            }
+            fluidnc_status_t st;
+            if (fluidnc_status_parse(rx.c_str(), &st)) {
+                last = st;
+                fresh = true;
+                dose_journal_update(&journal, &st, NAN, t);
+            } else {
+                batch_queue_on_line(rx.c_str(), t);
+            }
+            rx.clear();
+        }
+    }
+
+    /** '?' until an Idle report is back */
+    bool settle(int64_t &t, int64_t endUs) {
+        fresh = false;
+        for (int64_t asked = -1; t < endUs; t += 1000) {
+            if (asked < 0 || t - asked >= 100000) {
+                toSim.send("?", t);
+                asked = t;
+            }
+            tick(t);
+            if (fresh && last.state == FLUIDNC_STATE_IDLE) return true;
+        }
+        return false;
+    }
+};
+
+/**
+ * @brief One batch through batch_queue.h with dose_journal.h, the board reset at
+ *        cutFrac of its estimated run time and the batch resumed from the journal
+ * @param controllerKept Only the board reset (FluidNC kept its position); else both lost power
+ * @param records Journal records written (cutFrac >= 1: the whole uninterrupted batch)
+ * @return Worst pump's |dispensed - planned| in ml, -1 if the batch did not finish
+ */
+static double resumeErrorMl(const Recipe &recipe, double cutFrac, bool controllerKept, uint32_t *records) {
+    const int64_t endUs = 600000000;
+    std::vector<batch_step_t> steps;
+    for (const Ingredient &ing : recipe.steps) steps.push_back({ing.pump, ing.volumeMl, ing.flowRateMlMin});
+    batch_recipe_t table[] = {{recipe.name.c_str(), steps.data(), (uint8_t)steps.size()}};
+
+    batch_queue_config_t cfg = BATCH_QUEUE_DEFAULT_CONFIG;
+    cfg.recipes = table;
+    cfg.recipe_count = 1;
+    cfg.swap = BATCH_SWAP_NONE;
+    cfg.started = journalStarted;
+    cfg.finished = journalFinished;
+    batch_queue_init(&cfg);
+    dose_journal_init(&journal, "spiffs", nullptr);
+    uint8_t id = 0;
+    batch_queue_add(&id, 1, 1);
+    batch_queue_store_t store;
+    batch_queue_save(&store);
+
+    batch_plan_t plan;
+    batch_queue_plan(batch_queue_job(0), 0, &plan);
+    float planned[BATCH_PLAN_PUMPS] = {};
+    for (int s = 0; s < plan.step_count; s++) planned[strchr("XYZA", plan.steps[s].pump) - "XYZA"] += plan.steps[s].mm;
+
+    auto rig = std::make_unique<JournalRig>();
+    int64_t t = 0;
+    if (!rig->settle(t, endUs)) return -1.0;
+    float before[BATCH_PLAN_PUMPS], cutTravel[BATCH_PLAN_PUMPS] = {};
+    for (int a = 0; a < BATCH_PLAN_PUMPS; a++) before[a] = rig->sim.position(a);
+    batch_queue_run(t);
+
+    int64_t cutUs = cutFrac < 1.0 ? t + (int64_t)(cutFrac * plan.est_ms * 1000.0) : endUs;
+    for (; t < cutUs && batch_queue_state() != BATCH_QUEUE_IDLE; t += 1000) rig->tick(t);
+    dose_journal_stats_t js;
+    dose_journal_get_stats(&journal, &js);
+    *records = js.records;
+
+    if (batch_queue_state() != BATCH_QUEUE_IDLE) {
+        // Reset: queue back from NVS, progress from the journal
+        if (!controllerKept) {
+            for (int a = 0; a < BATCH_PLAN_PUMPS; a++) {
+                cutTravel[a] = rig->sim.position(a) - before[a];
+                before[a] = 0.0f;
+            }
+            rig = std::make_unique<JournalRig>();
+        }
+        batch_queue_init(&cfg);
+        batch_queue_load(&store);
+        dose_journal_init(&journal, "spiffs", nullptr);
+        if (!rig->settle(t, endUs)) return -1.0;
+
+        dose_journal_point_t point;
+        if (!dose_journal_point(&journal, &plan, &rig->last, &point) ||
+            !batch_queue_resume(t, point.step, point.done_mm)) {
+            return -1.0;
+        }
+        for (; t < endUs && batch_queue_state() != BATCH_QUEUE_IDLE; t += 1000) rig->tick(t);
+        dose_journal_get_stats(&journal, &js);
+        *records += js.records;
+    }
+    if (batch_queue_state() != BATCH_QUEUE_IDLE) return -1.0;
+
+    double worst = 0.0;
+    for (int a = 0; a < BATCH_PLAN_PUMPS; a++) {
+        double travel = cutTravel[a] + rig->sim.position(a) - before[a];
+        worst = std::max(worst, std::fabs(travel - planned[a]) * cfg.ml_per_mm);
+    }
+    return worst;
+}
+
+static void benchJournal() {
+    fprintf(report, "\n[dose journal: reset mid-batch, resume]\n");
+    const Recipe &recipe = builtinRecipes()[2];     // Nutrient Mix: slow steps, 4 pumps
+    uint32_t records = 0;
+    double kept = 0.0, lost = 0.0;
+    for (double cut : {0.123, 0.345, 0.567, 0.789, 0.901}) {
+        uint32_t r;
+        double e = resumeErrorMl(recipe, cut, true, &r);
+        kept = e < 0.0 || kept < 0.0 ? -1.0 : std::max(kept, e);
+        e = resumeErrorMl(recipe, cut, false, &r);
+        lost = e < 0.0 || lost < 0.0 ? -1.0 : std::max(lost, e);
+    }
+    resumeErrorMl(recipe, 2.0, true, &records);
+    // Controller kept its position: exact. Both reset: what ran after the last checkpoint
+    record("journal_resume_error_ml.kept", kept < 0.0 ? 99.0 : kept, "ml", false, "virtual");
+    record("journal_resume_error_ml.lost", lost < 0.0 ? 99.0 : lost, "ml", false, "virtual");
+    record("journal_records_per_batch", records, "records", false, "virtual");
+}
+
+static inventory_t inventory;
+
+static const char *inventoryCheck(const batch_plan_t *plan) {
+    return inventory_check(&inventory, plan);
+}
+
+static void inventoryStarted(const batch_plan_t *plan, int64_t) {
+    inventory_started(&inventory, plan);
+}
+
+static void inventoryFinished(const batch_plan_t *, int64_t) {
+    inventory_finished(&inventory);
+}
+
+/**
+ * @brief A job longer than one reservoir lasts, through batch_queue.h with
+ *        inventory.h as its check() against the simulator
+ * @param forecastMiss |forecast first short batch - batch the queue blocked|
+ * @param overdrawMl How far the truest stock (simulator travel) went below the reserve
+ * @param errorMl Worst pump's |tracked stock - true stock|
+ * @param savesPerBatch Stock writes per batch run
+ * @return Batches run, 0 if the queue did not stop on the short reservoir
+ */
+static uint32_t inventoryRun(uint32_t *forecastMiss, double *overdrawMl, double *errorMl, double *savesPerBatch) {
+    const Recipe &recipe = builtinRecipes()[1];     // Color Mix: X Y Z
+    const uint16_t batches = 12;
+    const int64_t endUs = (int64_t)batches * 300000000, stepUs = 1000;
+    std::vector<batch_step_t> steps;
+    for (const Ingredient &ing : recipe.steps) steps.push_back({ing.pump, ing.volumeMl, ing.flowRateMlMin});
+    batch_recipe_t table[] = {{recipe.name.c_str(), steps.data(), (uint8_t)steps.size()}};
+
+    batch_queue_config_t cfg = BATCH_QUEUE_DEFAULT_CONFIG;
+    cfg.recipes = table;
+    cfg.recipe_count = 1;
+    cfg.swap = BATCH_SWAP_NONE;
+    cfg.check = inventoryCheck;
+    cfg.started = inventoryStarted;
+    cfg.finished = inventoryFinished;
+    batch_queue_init(&cfg);
+    inventory_config_t icfg = INVENTORY_DEFAULT_CONFIG;
+    icfg.ml_per_mm = cfg.ml_per_mm;
+    inventory_init(&inventory, &icfg, nullptr);
+    inventory_set_recipes(&inventory, table, 1);
+    float initial[INVENTORY_PUMPS];
+    for (int p = 0; p < INVENTORY_PUMPS; p++) {
+        // Every reservoir 500 ml but the second pump's: enough for a bit over 8 batches
+        float perBatch = inventory.demand[0][p];
+        initial[p] = p == 1 ? 10.0f + 8.5f * perBatch : 500.0f;
+        inventory_set(&inventory, "XYZA"[p], nullptr, 500.0f, 10.0f, 1.0f);
+        inventory_refill(&inventory, "XYZA"[p], initial[p]);
+    }
+    uint8_t id = 0;
+    batch_queue_add(&id, 1, batches);
+    inventory_forecast_t forecast[INVENTORY_PUMPS];
+    inventory_forecast(&inventory, forecast);
+    inventory_store_t store;
+    inventory_save(&inventory, 0, &store);
+    uint32_t saves0 = inventory.stats.saves;
+
+    FluidncSim sim(SimConfig::rodentUart());
+    UartLink toSim(115200);
+    UartLink toEsp(115200);
+    std::string rx;
+    auto tick = [&](int64_t t) {
+        if (const char *line = batch_queue_poll(t)) toSim.send(std::string(line) + "\n", t);
+        uint8_t b;
+        int64_t at;
+        while (toSim.receive(t, b, &at)) sim.receive(b, at);
+        sim.advance(t);
+        SimOutput o;
+        while (sim.popOutput(o)) toEsp.send(o.line + "\r\n", o.atUs);
+        while (toEsp.receive(t, b)) {
+            if (b != '\n') {
+                if (b != '\r') rx.push_back((char)b);
+                continue;
+            }
+            fluidnc_status_t st;
+            if (fluidnc_status_parse(rx.c_str(), &st)) {
+                inventory_update(&inventory, &st, t);
+            } else {
+                batch_queue_on_line(rx.c_str(), t);
+            }
+            rx.clear();
+        }
+        inventory_save(&inventory, t, &store);
+    };
+    batch_queue_run(0);
+    int64_t t = 0;
+    for (; t < endUs; t += stepUs) {
+        tick(t);
+        batch_queue_state_t state = batch_queue_state();
+        if (state == BATCH_QUEUE_BLOCKED || state == BATCH_QUEUE_IDLE) break;
+    }
+    toSim.send("?", t);         // Final position, as the sketches poll while the queue is not idle
+    for (int64_t end = t + 200000; t < end; t += stepUs) tick(t);
+
+    batch_queue_stats_t st;
+    batch_queue_get_stats(&st);
+    *forecastMiss = (uint32_t)std::abs((int)forecast[1].batch - (int)st.batches_done);
+    *overdrawMl = 0.0;
+    *errorMl = 0.0;
+    for (int p = 0; p < INVENTORY_PUMPS; p++) {
+        double truth = initial[p] - sim.position(p) * cfg.ml_per_mm;
+        *overdrawMl = std::max(*overdrawMl, 10.0 - truth);
+        *errorMl = std::max(*errorMl, std::fabs(inventory.store.res[p].stock_ml - truth));
+    }
+    *savesPerBatch = st.batches_done ? (double)(inventory.stats.saves - saves0) / st.batches_done : 0.0;
+    return batch_queue_state() == BATCH_QUEUE_BLOCKED ? st.batches_done : 0;
+}
+
+static void benchInventory() {
+    fprintf(report, "\n[inventory: stock, forecast, pre-flight]\n");
+    uint32_t miss = 0;
+    double overdraw = 0.0, error = 0.0, saves = 0.0;
+    uint32_t ran = inventoryRun(&miss, &overdraw, &error, &saves);
+    record("inventory_batches_before_block", ran, "batches", true, "virtual");
+    record("inventory_forecast_miss", miss, "batches", false, "virtual");
+    record("inventory_overdraw_ml", std::max(0.0, overdraw), "ml", false, "virtual");
+    record("inventory_stock_error_ml", std::round(error * 1000.0) / 1000.0, "ml", false, "virtual");  // To 1 ul
+    record("inventory_saves_per_batch", saves, "saves", false, "virtual");
+
+    // Pre-flight and forecast cost, a full queue of four-recipe jobs
+    std::vector<Recipe> recipes = builtinRecipes();
+    std::vector<std::vector<batch_step_t>> steps(recipes.size());
+    std::vector<batch_recipe_t> table;
+    for (size_t r = 0; r < recipes.size(); r++) {
+        for (const Ingredient &ing : recipes[r].steps) steps[r].push_back({ing.pump, ing.volumeMl, ing.flowRateMlMin});
+        table.push_back({recipes[r].name.c_str(), steps[r].data(), (uint8_t)steps[r].size()});
+    }
+    batch_queue_config_t cfg = BATCH_QUEUE_DEFAULT_CONFIG;
+    cfg.recipes = table.data();
+    cfg.recipe_count = (uint8_t)table.size();
+    batch_queue_init(&cfg);
+    inventory_init(&inventory, nullptr, nullptr);
+    inventory_set_recipes(&inventory, table.data(), (uint8_t)table.size());
+    for (int p = 0; p < INVENTORY_PUMPS; p++) {
+        inventory_set(&inventory, "XYZA"[p], nullptr, 1000.0f, 10.0f, 1.0f);
+        inventory_refill(&inventory, "XYZA"[p], -1.0f);
+    }
+    uint8_t ids[BATCH_QUEUE_MAX_RECIPES] = {0, 1, 2, 1};
+    for (int j = 0; j < BATCH_QUEUE_MAX_JOBS; j++) batch_queue_add(ids, BATCH_QUEUE_MAX_RECIPES, 999);
+    batch_plan_t plan;
+    batch_queue_plan(batch_queue_job(0), 0, &plan);
+    record("inventory_check_rate", rate([&]() { return inventory_check(&inventory, &plan) ? 1u : 0u; }, 1),
+           "checks/s", true, "cpu");
+    inventory_forecast_t forecast[INVENTORY_PUMPS];
+    record("inventory_forecast_rate", rate([&]() { return (uint32_t)inventory_forecast(&inventory, forecast); }, 1),
+           "forecasts/s", true, "cpu");
+}
+
+static void benchDosing(uint32_t runs) {
+    fprintf(report, "\n[dosing accuracy vs speed]\n");
+    BatchParams bp = benchParams();
+    bp.sim = SimConfig::rodentFluidnc();
+    bp.sim.reportIntervalMs = 75;           // Completion needs reports
+    bp.control.feedCapMmMin = 5000.0f;
+
+    for (float flow : {5.0f, 15.0f, 30.0f, 60.0f}) {
+        Recipe single{"dose", {{'X', 5.0f, flow}}};
+        std::vector<double> delivered, seen;
+        for (uint32_t r = 0; r < runs; r++) {
+            BatchResult res = runBatch(single, bp, 1000 + r);
+            if (!res.completed) continue;
+            delivered.push_back(std::fabs(res.steps[0].deliveredG - res.steps[0].targetG));
+            seen.push_back(std::fabs(res.steps[0].scaleG - res.steps[0].targetG));
+        }
+        char suffix[32];
+        snprintf(suffix, sizeof(suffix), ".flow_%.0f", flow);
+        record(std::string("dose_error_p99_g") + suffix, percentile(delivered, 99.0), "g", false, "virtual");
+        record(std::string("dose_seen_error_p99_g") + suffix, percentile(seen, 99.0), "g", false, "virtual");
+    }
+}
+
+/**
+ * @brief Mean error of `doses` 5 g doses on a tube that delivers 3 % over its
+ *        calibration, with or without dose_stats.h correcting each next dose
+ */
+static double biasG(uint32_t doses, bool correct, double *sd) {
+    BatchParams bp = benchParams();
+    bp.plant.mlPerMm = 0.0515f;             // Systematic: +0.15 g per 5 g
+    bp.plant.calibrationSd = 0.005f;        // Dose to dose
+    static dose_stats_t ds;
+    dose_stats_init(&ds, nullptr, nullptr);
+    const float target = 5.0f;
+    for (uint32_t r = 0; r < doses; r++) {
+        float setpoint = correct ? dose_stats_setpoint(&ds, 'X', "bench", target) : target;
+        Recipe single{"dose", {{'X', setpoint, 15.0f}}};        // Density 1
+        BatchResult res = runBatch(single, bp, 7000 + r);
+        if (!res.completed) continue;
+        dose_stats_record(&ds, 'X', "bench", target, setpoint, res.steps[0].deliveredG,
+                          (uint32_t)(res.steps[0].completeUs - res.steps[0].motionStartUs), 0);
+    }
+    dose_stats_summary_t sum;
+    dose_stats_summary(&ds, dose_stats_find(&ds, 'X', "bench"), &sum);
+    *sd = sum.sd_error_g;
+    return sum.mean_error_g;
+}
+
+static void benchBias() {
+    fprintf(report, "\n[dosing bias correction]\n");
+    double sdRaw = 0.0, sdCorrected = 0.0;
+    record("dose_bias_g.uncorrected", std::fabs(biasG(40, false, &sdRaw)), "g", false, "virtual");
+    record("dose_bias_g.corrected", std::fabs(biasG(40, true, &sdCorrected)), "g", false, "virtual");
+    record("dose_error_sd_g.corrected", sdCorrected, "g", false, "virtual");
+
+    static dose_stats_t ds;
+    dose_stats_init(&ds, nullptr, nullptr);
+    uint32_t n = 0;
+    record("dose_stats_record_rate", rate([&]() {
+               n++;
+               char pump = "XYZA"[n & 3];
+               return dose_stats_record(&ds, pump, "bench", 5.0f, 5.0f, 5.0f + (n % 7) * 0.01f, 1000000, 0) ? 1u : 0u;
+           }, 1),
+           "records/s", true, "cpu");
+}
+
+static void benchSoak(uint32_t batches) {
+    fprintf(report, "\n[soak]\n");
+    BatchParams bp = benchParams();
+    const std::vector<Recipe> &recipes = builtinRecipes();
+    uint32_t aborts = 0;
+    double start = monoSeconds();
+    for (uint32_t i = 0; i < batches; i++) {
+        BatchResult res = runBatch(recipes[i % recipes.size()], bp, 5000 + i);
+        if (!res.completed) aborts++;
+    }
+    double wall = monoSeconds() - start;
+    record("soak_aborts", aborts, "batches", false, "virtual");
+    record("soak_batches_per_min", wall > 0.0 ? batches * 60.0 / wall : 0.0, "batches/min", true, "cpu");
+}
+
+// ============================================================================
+// OUTPUT
+// ============================================================================
+
+static void writeJson(FILE *f) {
+    fprintf(f, "{\n  \"suite\": \"host\",\n  \"version\": 1,\n  \"metrics\": {\n");
+    for (size_t i = 0; i < metrics.size(); i++) {
+        const Metric &m = metrics[i];
+        fprintf(f, "    \"%s\": {\"value\": %.6g, \"unit\": \"%s\", \"better\": \"%s\", \"kind\": \"%s\"}%s\n",
+                m.name.c_str(), m.value, m.unit, m.higherIsBetter ? "higher" : "lower", m.kind,
+                i + 1 < metrics.size() ? "," : "");
+    }
+    fprintf(f, "  }\n}\n");
+}
+
+int main(int argc, char **argv) {
+    std::string jsonPath;
+    uint32_t soakBatches = 200;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (strcmp(argv[i], "--soak") == 0 && i + 1 < argc) {
+            soakBatches = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        } else {
+            fprintf(stderr, "usage: %s [--json FILE|-] [--soak N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    if (jsonPath == "-") report = stderr;
+
+    fprintf(report, "\n╔════════════════════════════════════════════════════════════╗\n");
+    fprintf(report, "║                 Host Benchmark Suite                       ║\n");
+    fprintf(report, "╚════════════════════════════════════════════════════════════╝\n");
+
+    benchParsers();
+    benchUart();
+    benchEstop(200);
+    benchRecovery();
+    benchDiscovery();
+    benchRecipes();
+    benchQueue();
+    benchJournal();
+    benchInventory();
+    benchDosing(100);
+    benchBias();
+    benchSoak(soakBatches);
+
+    if (jsonPath == "-") {
+        writeJson(stdout);
+    } else if (!jsonPath.empty()) {
+        FILE *json = fopen(jsonPath.c_str(), "w");
+        if (!json) {
+            perror(jsonPath.c_str());
+            return 1;
+        }
+        writeJson(json);
+        fclose(json);
+        fprintf(report, "\nJSON written to %s\n", jsonPath.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,13 @@
+/**
+ * @file esp_attr.h
+ * @brief Host stand-in: placement attributes are no-ops on Linux
+ */
+
+#ifndef HOST_ESP_ATTR_H
+#define HOST_ESP_ATTR_H
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_NOINIT_ATTR
+
+#endif // HOST_ESP_ATTR_H
@@ -0,0 +1,316 @@
+/**
+ * @file esp_idf_host.c
+ * @brief ESP-IDF calls used by src/ modules, implemented on the Linux HAL
+ */
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "driver/gpio.h"
+#include "esp_partition.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "hal.h"
+#include "hal/gpio_ll.h"
+#include "hal/uart_ll.h"
+
+// ============================================================================
+// CRITICAL SECTIONS
+// ============================================================================
+
+static pthread_mutex_t critical = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+void host_critical_enter(void) {
+    pthread_mutex_lock(&critical);
+}
+
+void host_critical_exit(void) {
+    pthread_mutex_unlock(&critical);
+}
+
+// ============================================================================
+// UART LL
+// ============================================================================
+
+uart_dev_t UART0 = {0};
+uart_dev_t UART1 = {1};
+uart_dev_t UART2 = {2};
+
+// ============================================================================
+// GPIO
+// ============================================================================
+
+gpio_dev_t GPIO = {0};
+
+static gpio_int_type_t intr_type[GPIO_NUM_MAX];
+static bool isr_service = false;
+
+esp_err_t gpio_config(const gpio_config_t *config) {
+    for (int pin = 0; pin < GPIO_NUM_MAX; pin++) {
+        if (!(config->pin_bit_mask & (1ULL << pin))) continue;
+
+        hal_gpio_mode_t mode = HAL_GPIO_INPUT;
+        if (config->mode == GPIO_MODE_OUTPUT) {
+            mode = HAL_GPIO_OUTPUT;
+        } else if (config->pull_up_en == GPIO_PULLUP_ENABLE) {
+            mode = HAL_GPIO_INPUT_PULLUP;
+        }
+        if (!hal_gpio_mode(pin, mode)) return ESP_ERR_INVALID_ARG;
+        intr_type[pin] = config->intr_type;
+    }
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t pin) {
+    return hal_gpio_read(pin);
+}
+
+esp_err_t gpio_set_level(gpio_num_t pin, uint32_t level) {
+    hal_gpio_write(pin, (int)level);
+    return ESP_OK;
+}
+
+esp_err_t gpio_install_isr_service(int intr_alloc_flags) {
+    (void)intr_alloc_flags;
+    if (isr_service) return ESP_ERR_INVALID_STATE;
+    isr_service = true;
+    return ESP_OK;
+}
+
+esp_err_t gpio_isr_handler_add(gpio_num_t pin, gpio_isr_t isr, void *arg) {
+    static const hal_gpio_edge_t edges[] = {
+        [GPIO_INTR_DISABLE] = HAL_GPIO_EDGE_NONE,
+        [GPIO_INTR_POSEDGE] = HAL_GPIO_EDGE_RISING,
+        [GPIO_INTR_NEGEDGE] = HAL_GPIO_EDGE_FALLING,
+        [GPIO_INTR_ANYEDGE] = HAL_GPIO_EDGE_ANY,
+    };
+    if (!isr_service) return ESP_ERR_INVALID_STATE;
+    if (!GPIO_IS_VALID_GPIO(pin)) return ESP_ERR_INVALID_ARG;
+    return hal_gpio_set_isr(pin, edges[intr_type[pin]], isr, arg) ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t gpio_isr_handler_remove(gpio_num_t pin) {
+    return hal_gpio_set_isr(pin, HAL_GPIO_EDGE_NONE, NULL, NULL) ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+// ============================================================================
+// ESP_TIMER
+// ============================================================================
+
+struct esp_timer {
+    esp_timer_create_args_t args;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint64_t period_us;             // 0 = one-shot
+    int64_t due_us;                 // < 0 = stopped
+};
+
+int64_t esp_timer_get_time(void) {
+    return hal_time_us();
+}
+
+static void *timer_thread(void *arg) {
+    struct esp_timer *t = arg;
+
+    pthread_mutex_lock(&t->lock);
+    for (;;) {
+        while (t->due_us < 0) {
+            pthread_cond_wait(&t->cond, &t->lock);
+        }
+        int64_t wait_us = t->due_us - hal_time_us();
+        if (wait_us > 0) {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            ts.tv_sec += wait_us / 1000000;
+            ts.tv_nsec += (wait_us % 1000000) * 1000;
+            if (ts.tv_nsec >= 1000000000L) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&t->cond, &t->lock, &ts);
+            continue;               // Re-check: stopped, restarted or due
+        }
+
+        if (t->period_us == 0) {
+            t->due_us = -1;
+        } else {
+            t->due_us += (int64_t)t->period_us;
+            // skip_unhandled_events: after a stall, run once and resync
+            if (t->args.skip_unhandled_events && t->due_us <= hal_time_us()) {
+                t->due_us = hal_time_us() + (int64_t)t->period_us;
+            }
+        }
+        pthread_mutex_unlock(&t->lock);
+        t->args.callback(t->args.arg);
+        pthread_mutex_lock(&t->lock);
+    }
+    return NULL;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out) {
+    if (args == NULL || args->callback == NULL || out == NULL) return ESP_ERR_INVALID_ARG;
+
+    struct esp_timer *t = calloc(1, sizeof(*t));
+    if (t == NULL) return ESP_ERR_NO_MEM;
+    t->args = *args;
+    t->due_us = -1;
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&t->cond, &attr);
+    pthread_condattr_destroy(&attr);
+    if (pthread_create(&t->thread, NULL, timer_thread, t) != 0) {
+        free(t);
+        return ESP_ERR_NO_MEM;
+    }
+    pthread_detach(t->thread);
+    *out = t;
+    return ESP_OK;
+}
+
+static esp_err_t timer_start(esp_timer_handle_t t, uint64_t us, uint64_t period_us) {
+    if (t == NULL) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&t->lock);
+    esp_err_t err = ESP_OK;
+    if (t->due_us >= 0) {
+        err = ESP_ERR_INVALID_STATE;
+    } else {
+        t->period_us = period_us;
+        t->due_us = hal_time_us() + (int64_t)us;
+        pthread_cond_signal(&t->cond);
+    }
+    pthread_mutex_unlock(&t->lock);
+    return err;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+    return timer_start(timer, period_us, period_us);
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    return timer_start(timer, timeout_us, 0);
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t t) {
+    if (t == NULL) return ESP_ERR_INVALID_ARG;
+    pthread_mutex_lock(&t->lock);
+    esp_err_t err = t->due_us < 0 ? ESP_ERR_INVALID_STATE : ESP_OK;
+    t->due_us = -1;
+    pthread_cond_signal(&t->cond);
+    pthread_mutex_unlock(&t->lock);
+    return err;
+}
+
+// ============================================================================
+// PARTITIONS
+// ============================================================================
+
+typedef struct {
+    esp_partition_t part;
+    uint8_t *image;             // Allocated on the first find
+    int fd;                     // $HAL_FLASH_DIR/<label>.bin, -1 if none
+} host_partition_t;
+
+static host_partition_t partitions[] = {
+    // Arduino-ESP32 default.csv
+    {{ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, 0x290000, 0x160000, SPI_FLASH_SEC_SIZE,
+      "spiffs", false}, NULL, -1},
+    // partitions.csv (main/)
+    {{ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_UNDEFINED, 0x190000, 0x100000, SPI_FLASH_SEC_SIZE,
+      "evlog", false}, NULL, -1},
+    {{ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_UNDEFINED, 0x290000, 0x40000, SPI_FLASH_SEC_SIZE,
+      "tlmq", false}, NULL, -1},
+};
+static pthread_mutex_t partition_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static bool partition_open(host_partition_t *p) {
+    p->image = malloc(p->part.size);
+    if (p->image == NULL) return false;
+    memset(p->image, 0xFF, p->part.size);
+
+    const char *dir = getenv("HAL_FLASH_DIR");
+    if (dir == NULL) return true;
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s.bin", dir, p->part.label);
+    p->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (p->fd < 0) return true;                 // RAM only
+    ssize_t n = pread(p->fd, p->image, p->part.size, 0);
+    if (n < (ssize_t)p->part.size) {
+        // New or short file: extend it with erased flash
+        size_t have = n > 0 ? (size_t)n : 0;
+        if (pwrite(p->fd, p->image + have, p->part.size - have, (off_t)have) < 0) {
+            close(p->fd);
+            p->fd = -1;
+        }
+    }
+    return true;
+}
+
+static void partition_sync(const host_partition_t *p, size_t offset, size_t size) {
+    if (p->fd >= 0 && pwrite(p->fd, p->image + offset, size, (off_t)offset) != (ssize_t)size) {
+        fprintf(stderr, "esp_partition: write-through to %s failed\n", p->part.label);
+    }
+}
+
+static host_partition_t *partition_of(const esp_partition_t *part) {
+    return (host_partition_t *)((char *)part - offsetof(host_partition_t, part));
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label) {
+    const esp_partition_t *found = NULL;
+    pthread_mutex_lock(&partition_lock);
+    for (size_t i = 0; i < sizeof(partitions) / sizeof(partitions[0]); i++) {
+        host_partition_t *p = &partitions[i];
+        if (p->part.type != type) continue;
+        if (subtype != ESP_PARTITION_SUBTYPE_ANY && p->part.subtype != subtype) continue;
+        if (label != NULL && strcmp(p->part.label, label) != 0) continue;
+        if (p->image == NULL && !partition_open(p)) break;
+        found = &p->part;
+        break;
+    }
+    pthread_mutex_unlock(&partition_lock);
+    return found;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *part, size_t src_offset, void *dst, size_t size) {
+    if (part == NULL || src_offset + size > part->size) return ESP_ERR_INVALID_SIZE;
+    host_partition_t *p = partition_of(part);
+    pthread_mutex_lock(&partition_lock);
+    memcpy(dst, p->image + src_offset, size);
+    pthread_mutex_unlock(&partition_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *part, size_t dst_offset, const void *src, size_t size) {
+    if (part == NULL || dst_offset + size > part->size) return ESP_ERR_INVALID_SIZE;
+    host_partition_t *p = partition_of(part);
+    const uint8_t *in = src;
+    pthread_mutex_lock(&partition_lock);
+    for (size_t i = 0; i < size; i++) {
+        p->image[dst_offset + i] &= in[i];      // NOR flash: 1 -> 0 only
+    }
+    partition_sync(p, dst_offset, size);
+    pthread_mutex_unlock(&partition_lock);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *part, size_t offset, size_t size) {
+    if (part == NULL || offset + size > part->size) return ESP_ERR_INVALID_SIZE;
+    if (offset % SPI_FLASH_SEC_SIZE != 0 || size % SPI_FLASH_SEC_SIZE != 0) return ESP_ERR_INVALID_ARG;
+    host_partition_t *p = partition_of(part);
+    pthread_mutex_lock(&partition_lock);
+    memset(p->image + offset, 0xFF, size);
+    partition_sync(p, offset, size);
+    pthread_mutex_unlock(&partition_lock);
+    return ESP_OK;
+}
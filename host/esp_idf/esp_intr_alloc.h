@@ -0,0 +1,14 @@
+/**
+ * @file esp_intr_alloc.h
+ * @brief Host stand-in: interrupt flags are accepted and ignored
+ */
+
+#ifndef HOST_ESP_INTR_ALLOC_H
+#define HOST_ESP_INTR_ALLOC_H
+
+#define ESP_INTR_FLAG_LEVEL1    (1 << 1)
+#define ESP_INTR_FLAG_LEVEL2    (1 << 2)
+#define ESP_INTR_FLAG_LEVEL3    (1 << 3)
+#define ESP_INTR_FLAG_IRAM      (1 << 10)
+
+#endif // HOST_ESP_INTR_ALLOC_H
@@ -0,0 +1,62 @@
+/**
+ * @file esp_partition.h
+ * @brief Host stand-in for the esp_partition calls used by src/
+ *
+ * The data partitions of the targets exist: "spiffs" (Arduino default
+ * table, used by the sketches), "evlog" and "tlmq" (partitions.csv, used
+ * by main/).
+ * Each is a RAM image with NOR semantics - a write can only clear bits,
+ * erase sets a whole 4 KB sector to 0xFF - so code that forgets to erase
+ * fails here as it would on the chip. With HAL_FLASH_DIR set, a partition
+ * is loaded from and written through to $HAL_FLASH_DIR/<label>.bin, the
+ * same layout as an esptool read_flash image of it.
+ */
+
+#ifndef HOST_ESP_PARTITION_H
+#define HOST_ESP_PARTITION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SPI_FLASH_SEC_SIZE      4096
+
+typedef enum {
+    ESP_PARTITION_TYPE_APP = 0x00,
+    ESP_PARTITION_TYPE_DATA = 0x01,
+} esp_partition_type_t;
+
+typedef enum {
+    ESP_PARTITION_SUBTYPE_DATA_NVS = 0x02,
+    ESP_PARTITION_SUBTYPE_DATA_UNDEFINED = 0x06,
+    ESP_PARTITION_SUBTYPE_DATA_SPIFFS = 0x82,
+    ESP_PARTITION_SUBTYPE_ANY = 0xff,
+} esp_partition_subtype_t;
+
+typedef struct {
+    esp_partition_type_t type;
+    esp_partition_subtype_t subtype;
+    uint32_t address;
+    uint32_t size;
+    uint32_t erase_size;
+    char label[17];
+    bool encrypted;
+} esp_partition_t;
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label);
+esp_err_t esp_partition_read(const esp_partition_t *part, size_t src_offset, void *dst, size_t size);
+esp_err_t esp_partition_write(const esp_partition_t *part, size_t dst_offset, const void *src, size_t size);
+esp_err_t esp_partition_erase_range(const esp_partition_t *part, size_t offset, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_ESP_PARTITION_H
@@ -0,0 +1,38 @@
+/**
+ * @file FreeRTOS.h
+ * @brief Host stand-in for the critical-section macros used by src/
+ *
+ * A spinlock section on the ESP32 masks interrupts on that core. Here
+ * "interrupts" are the GPIO-injection and esp_timer threads, so every
+ * portMUX maps to one process-wide recursive mutex: while any section is
+ * held, no other ISR or timer callback runs.
+ */
+
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    {0}
+
+void host_critical_enter(void);
+void host_critical_exit(void);
+
+#define portENTER_CRITICAL(mux)         ((void)(mux), host_critical_enter())
+#define portEXIT_CRITICAL(mux)          ((void)(mux), host_critical_exit())
+#define portENTER_CRITICAL_ISR(mux)     portENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL_ISR(mux)      portEXIT_CRITICAL(mux)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HOST_FREERTOS_H
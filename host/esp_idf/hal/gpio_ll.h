@@ -0,0 +1,27 @@
+/**
+ * @file gpio_ll.h
+ * @brief Host stand-in for the GPIO low-level read used by the IRAM ISRs
+ *
+ * On the chip gpio_ll_get_level() is an inline register read, safe while
+ * the flash cache is off; here it is hal_gpio_read().
+ */
+
+#ifndef HOST_HAL_GPIO_LL_H
+#define HOST_HAL_GPIO_LL_H
+
+#include <stdint.h>
+
+#include "hal.h"
+
+typedef struct {
+    int unused;
+} gpio_dev_t;
+
+extern gpio_dev_t GPIO;
+
+static inline int gpio_ll_get_level(gpio_dev_t *hw, uint32_t gpio_num) {
+    (void)hw;
+    return hal_gpio_read((int)gpio_num);
+}
+
+#endif // HOST_HAL_GPIO_LL_H
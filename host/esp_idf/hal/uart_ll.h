@@ -0,0 +1,37 @@
+/**
+ * @file uart_ll.h
+ * @brief Host stand-in for the UART low-level FIFO calls used by estop.c
+ *
+ * There is no separate hardware FIFO on a pty: "writing the FIFO" goes
+ * straight to hal_uart_write(), i.e. ahead of nothing, which is what the
+ * e-stop path wants anyway. The FIFO always reports itself empty.
+ */
+
+#ifndef HOST_HAL_UART_LL_H
+#define HOST_HAL_UART_LL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hal.h"
+
+#define UART_LL_FIFO_DEF_LEN    128
+
+typedef struct {
+    int port;
+} uart_dev_t;
+
+extern uart_dev_t UART0, UART1, UART2;
+
+#define UART_LL_GET_HW(num) (((num) == 0) ? &UART0 : ((num) == 1) ? &UART1 : &UART2)
+
+static inline uint32_t uart_ll_get_txfifo_len(uart_dev_t *hw) {
+    (void)hw;
+    return UART_LL_FIFO_DEF_LEN;
+}
+
+static inline void uart_ll_write_txfifo(uart_dev_t *hw, const uint8_t *buf, uint32_t len) {
+    hal_uart_write(hw->port, buf, len);
+}
+
+#endif // HOST_HAL_UART_LL_H
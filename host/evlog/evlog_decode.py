@@ -0,0 +1,215 @@
+#!/usr/bin/env python3
+"""
+Decode event log records (src/event_log.h) to CSV.
+
+    evlog_decode.py INPUT [-o OUT.csv]
+    evlog_decode.py --port /dev/ttyUSB0 [--baud 115200] [--last N] [--save RAW] [-o OUT.csv]
+
+INPUT is either
+  - a serial capture holding a 'd' dump of test_18 (EVLD header, records,
+    EVLE trailer; text around it is ignored, the last complete dump wins), or
+  - a raw image of the log partition, e.g.
+        esptool.py read_flash 0x290000 0x160000 evlog.bin     (Arduino "spiffs")
+        esptool.py read_flash 0x190000 0x100000 evlog.bin     (partitions.csv "evlog")
+    or $HAL_FLASH_DIR/<label>.bin of a host run. Records of every sector
+    are decoded and sorted by seq.
+
+--port sends "d [N]" itself and reads the dump (needs pyserial).
+
+Records failing their CRC are reported on stderr and skipped; a dump with
+a bad CRC-32 or a missing trailer exits with code 1 after writing what
+was decoded.
+"""
+
+import csv
+import math
+import struct
+import sys
+import zlib
+
+RECORD = struct.Struct("<IIqfIHHBBH")          # event_record_t
+SECTOR_HEADER = struct.Struct("<IBBHIII10sH")  # sector_header_t
+DUMP_HEADER = struct.Struct("<4sBBHII")        # event_log_dump_header_t
+DUMP_TRAILER = struct.Struct("<4sII")          # event_log_dump_trailer_t
+
+VERSION = 1
+SECTOR_SIZE = 4096
+SECTOR_MAGIC = 0x474C5645
+ERASED_SEQ = 0xFFFFFFFF
+
+TYPES = ["?", "BOOT", "COMMAND", "DOSE_START", "DOSE_DONE", "HOLD",
+         "RESUME", "ESTOP", "FLOW_FAULT", "ALARM", "MARK"]
+RESULTS = ["OK", "ERROR", "TIMEOUT", "ABORTED"]
+
+COLUMNS = ["seq", "boot", "t_us", "t_s", "type", "result", "cmd_id",
+           "duration_us", "mass_g", "arg", "detail"]
+
+
+def crc16(data):
+    """CRC-16/CCITT-FALSE, as event_log.c"""
+    crc = 0xFFFF
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+
+def decode_record(raw):
+    """Dict of one record, None if erased or damaged"""
+    seq, duration, t_us, mass, arg, cmd_id, boot, typ, result, crc = RECORD.unpack(raw)
+    if seq == ERASED_SEQ or crc != crc16(raw[:-2]):
+        return None
+    type_name = TYPES[typ] if typ < len(TYPES) else f"?{typ}"
+    if typ == TYPES.index("COMMAND"):
+        detail = bytes(arg.to_bytes(4, "little")).split(b"\0")[0].decode("ascii", "replace")
+    elif typ in (TYPES.index("DOSE_START"), TYPES.index("DOSE_DONE")) and 0x20 < arg < 0x7F:
+        detail = f"pump {chr(arg)}"
+    else:
+        detail = ""
+    return {
+        "seq": seq,
+        "boot": boot,
+        "t_us": t_us,
+        "t_s": f"{t_us / 1e6:.6f}",
+        "type": type_name,
+        "result": RESULTS[result] if result < len(RESULTS) else f"?{result}",
+        "cmd_id": cmd_id,
+        "duration_us": duration,
+        "mass_g": "" if math.isnan(mass) else f"{mass:.3f}",
+        "arg": arg,
+        "detail": detail,
+    }
+
+
+def decode_dump(data):
+    """Records of the last complete EVLD..EVLE dump; (records, ok)"""
+    start = data.rfind(b"EVLD")
+    while start >= 0:
+        magic, version, size, boot, count, first_seq = DUMP_HEADER.unpack_from(data, start)
+        body = start + DUMP_HEADER.size
+        if version == VERSION and size == RECORD.size:
+            break
+        start = data.rfind(b"EVLD", 0, start)
+    if start < 0:
+        return None, False
+
+    # The trailer count is authoritative: the dump may end early
+    end = data.find(b"EVLE", body)
+    while end >= 0 and (end - body) % RECORD.size != 0:
+        end = data.find(b"EVLE", end + 1)
+    if end < 0 or end + DUMP_TRAILER.size > len(data):
+        print(f"dump of {count} records from seq {first_seq} has no trailer (aborted?)", file=sys.stderr)
+        end = body + (len(data) - body) // RECORD.size * RECORD.size
+        sent, crc, ok = (end - body) // RECORD.size, None, False
+    else:
+        _, sent, crc = DUMP_TRAILER.unpack_from(data, end)
+        ok = True
+
+    payload = data[body:body + sent * RECORD.size]
+    if crc is not None and zlib.crc32(payload) != crc:
+        print("dump CRC-32 mismatch", file=sys.stderr)
+        ok = False
+    if sent != count:
+        print(f"dump announced {count} records, sent {sent}", file=sys.stderr)
+
+    records = []
+    for i in range(sent):
+        rec = decode_record(payload[i * RECORD.size:(i + 1) * RECORD.size])
+        if rec is None:
+            print(f"record {i} of the dump fails its CRC", file=sys.stderr)
+            continue
+        records.append(rec)
+    return records, ok
+
+
+def decode_image(data):
+    """Every valid record of a partition image, by seq"""
+    records = []
+    per_sector = SECTOR_SIZE // RECORD.size - 1
+    for base in range(0, len(data) - SECTOR_SIZE + 1, SECTOR_SIZE):
+        hdr = SECTOR_HEADER.unpack_from(data, base)
+        magic, version, size = hdr[0], hdr[1], hdr[2]
+        if magic != SECTOR_MAGIC or version != VERSION or size != RECORD.size:
+            continue
+        if hdr[-1] != crc16(data[base:base + SECTOR_HEADER.size - 2]):
+            continue
+        for slot in range(per_sector):
+            off = base + RECORD.size * (slot + 1)
+            raw = data[off:off + RECORD.size]
+            if raw == b"\xff" * RECORD.size:
+                break
+            rec = decode_record(raw)
+            if rec is None:
+                print(f"torn record in sector {base // SECTOR_SIZE}, slot {slot}", file=sys.stderr)
+                continue
+            records.append(rec)
+    records.sort(key=lambda r: r["seq"])
+    return records
+
+
+def capture(port, baud, last, save):
+    import serial  # pyserial, only needed here
+
+    with serial.Serial(port, baud, timeout=2) as s:
+        s.reset_input_buffer()
+        s.write(f"d {last}\n".encode() if last else b"d\n")
+        data = bytearray()
+        while True:
+            chunk = s.read(4096)
+            if not chunk:
+                break                               # 2 s of silence: done (or dead)
+            data += chunk
+            end = data.rfind(b"EVLE")
+            if end >= 0 and len(data) >= end + DUMP_TRAILER.size:
+                break
+    if save:
+        with open(save, "wb") as f:
+            f.write(data)
+    return bytes(data)
+
+
+def main(argv):
+    args = argv[1:]
+    opts = {"-o": None, "--port": None, "--baud": "115200", "--last": "0", "--save": None}
+    inputs = []
+    while args:
+        a = args.pop(0)
+        if a in opts and args:
+            opts[a] = args.pop(0)
+        elif a.startswith("-"):
+            print(__doc__.strip(), file=sys.stderr)
+            return 2
+        else:
+            inputs.append(a)
+    if bool(inputs) == bool(opts["--port"]) or len(inputs) > 1:
+        print(__doc__.strip(), file=sys.stderr)
+        return 2
+
+    if opts["--port"]:
+        data = capture(opts["--port"], int(opts["--baud"]), int(opts["--last"]), opts["--save"])
+    else:
+        with open(inputs[0], "rb") as f:
+            data = f.read()
+
+    records, ok = decode_dump(data)
+    if records is None:
+        records, ok = decode_image(data), True
+        source = "image"
+    else:
+        source = "dump"
+
+    out = open(opts["-o"], "w", newline="") if opts["-o"] else sys.stdout
+    try:
+        w = csv.DictWriter(out, fieldnames=COLUMNS)
+        w.writeheader()
+        w.writerows(records)
+    finally:
+        if out is not sys.stdout:
+            out.close()
+    print(f"{len(records)} records from {source}", file=sys.stderr)
+    return 0 if ok else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
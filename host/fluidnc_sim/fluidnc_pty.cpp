@@ -0,0 +1,224 @@
+/**
+ * @file fluidnc_pty.cpp
+ * @brief FluidncSim on a pseudo-terminal, in real time
+ *
+ * Stands in for the BTT Rodent on the UART: anything that talks to a
+ * serial port (a test sketch built with the Linux HAL, picocom, a host
+ * tool) can talk to it. Output is paced at the configured baud through
+ * UartLink, so "ok" and status timing look like the real wire.
+ *
+ *   fluidnc_sim [options]
+ *     --config FILE      FluidNC YAML (default: btt_rodent_uart.yaml rates)
+ *     --link PATH        symlink the new pty here (e.g. /tmp/pump/rodent)
+ *     --connect TTY      use an existing tty instead of a new pty, e.g. the
+ *                        sketch's $HAL_PTY_DIR/uart2
+ *     --baud N           line rate for output pacing (115200)
+ *     --rx-buffer N      RX buffer bytes (128)
+ *     --planner N        planner blocks (16)
+ *     --report-ms N      override report_interval_ms (0 = '?' only)
+ *     -v                 log traffic to stderr
+ *
+ * Commands on stdin: "alarm N" (machine-side alarm, 1 = hard limit),
+ * "state", "quit".
+ */
+
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "fluidnc_sim.h"
+#include "uart_link.h"
+
+struct Options {
+    std::string config;
+    std::string link;
+    std::string connect;
+    uint32_t baud = 115200;
+    long rxBuffer = -1;
+    long planner = -1;
+    long reportMs = -1;
+    bool verbose = false;
+};
+
+static int64_t monoUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [--config FILE.yaml] [--link PATH | --connect TTY] [--baud N]\n"
+            "          [--rx-buffer N] [--planner N] [--report-ms N] [-v]\n", prog);
+}
+
+static bool parseArgs(int argc, char **argv, Options &o) {
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (a == "-v") o.verbose = true;
+        else if (a == "--config" && hasValue) o.config = argv[++i];
+        else if (a == "--link" && hasValue) o.link = argv[++i];
+        else if (a == "--connect" && hasValue) o.connect = argv[++i];
+        else if (a == "--baud" && hasValue) o.baud = (uint32_t)strtoul(argv[++i], nullptr, 10);
+        else if (a == "--rx-buffer" && hasValue) o.rxBuffer = strtol(argv[++i], nullptr, 10);
+        else if (a == "--planner" && hasValue) o.planner = strtol(argv[++i], nullptr, 10);
+        else if (a == "--report-ms" && hasValue) o.reportMs = strtol(argv[++i], nullptr, 10);
+        else return false;
+    }
+    return true;
+}
+
+static void makeRaw(int fd) {
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+}
+
+/**
+ * @brief New pty (the slave stays open so the master never sees HUP)
+ */
+static int openPty(const Options &o) {
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) return -1;
+    const char *slavePath = ptsname(fd);
+    int slave = open(slavePath, O_RDWR | O_NOCTTY);
+    if (slave >= 0) makeRaw(slave);
+
+    fprintf(stderr, "[sim] pty %s\n", slavePath);
+    if (!o.link.empty()) {
+        unlink(o.link.c_str());
+        if (symlink(slavePath, o.link.c_str()) == 0) {
+            fprintf(stderr, "[sim] linked as %s\n", o.link.c_str());
+        }
+    }
+    return fd;
+}
+
+static void logLine(const char *dir, const std::string &line) {
+    fprintf(stderr, "%s ", dir);
+    for (unsigned char c : line) {
+        if (c >= 0x20 && c < 0x7F) fputc(c, stderr);
+        else fprintf(stderr, "<%02X>", c);
+    }
+    fputc('\n', stderr);
+}
+
+static bool handleCommand(const std::string &cmd, FluidncSim &sim, int64_t now) {
+    int code;
+    if (cmd == "quit") {
+        return false;
+    } else if (sscanf(cmd.c_str(), "alarm %d", &code) == 1) {
+        sim.raiseAlarm(code, now);
+    } else if (cmd == "state") {
+        fprintf(stderr, "[sim] %s planner=%zu rx=%u/%u overflows=%u\n",
+                sim.statusLine().c_str(), sim.plannerDepth(), sim.rxUsed(),
+                sim.config().rxBufferBytes, sim.rxOverflows());
+    } else if (!cmd.empty()) {
+        fprintf(stderr, "[sim] commands: alarm N | state | quit\n");
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    Options o;
+    if (!parseArgs(argc, argv, o)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    SimConfig cfg = SimConfig::rodentUart();
+    if (!o.config.empty()) {
+        std::string err;
+        if (!SimConfig::fromYaml(o.config, cfg, &err)) {
+            fprintf(stderr, "[sim] %s\n", err.c_str());
+            return 1;
+        }
+    }
+    if (o.rxBuffer > 0) cfg.rxBufferBytes = (uint32_t)o.rxBuffer;
+    if (o.planner > 0) cfg.plannerBlocks = (uint32_t)o.planner;
+    if (o.reportMs >= 0) cfg.reportIntervalMs = (uint32_t)o.reportMs;
+
+    int fd;
+    if (!o.connect.empty()) {
+        fd = open(o.connect.c_str(), O_RDWR | O_NOCTTY);
+        if (fd >= 0) makeRaw(fd);
+    } else {
+        fd = openPty(o);
+    }
+    if (fd < 0) {
+        perror("[sim] open");
+        return 1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    fprintf(stderr, "[sim] %s: %.0f mm/min, %.0f mm/s^2, %.0f steps/mm, report %u ms, "
+                    "RX %u B, planner %u\n",
+            cfg.name.c_str(), cfg.axes[0].maxRateMmMin, cfg.axes[0].accelMmS2,
+            cfg.axes[0].stepsPerMm, (unsigned)cfg.reportIntervalMs,
+            (unsigned)cfg.rxBufferBytes, (unsigned)cfg.plannerBlocks);
+
+    FluidncSim sim(cfg);
+    UartLink toHost(o.baud);
+    const int64_t start = monoUs();
+    std::string rxLine, stdinLine;
+    bool stdinOpen = true;
+
+    for (;;) {
+        // 1 ms tick: the motion step, and finer than one output line at 115200
+        struct pollfd pfd[2] = {{fd, POLLIN, 0}, {stdinOpen ? STDIN_FILENO : -1, POLLIN, 0}};
+        poll(pfd, 2, 1);
+        int64_t now = monoUs() - start;
+
+        if (pfd[0].revents & POLLIN) {
+            uint8_t buf[256];
+            ssize_t n = read(fd, buf, sizeof(buf));
+            for (ssize_t i = 0; i < n; i++) {
+                sim.receive(buf[i], now);
+                if (o.verbose) {
+                    if (buf[i] == '\n') { logLine(">", rxLine); rxLine.clear(); }
+                    else if (buf[i] == '?' || buf[i] == '!' || buf[i] == '~' || buf[i] >= 0x80 || buf[i] == 0x18) {
+                        logLine(">", std::string(1, (char)buf[i]));
+                    } else if (buf[i] != '\r') rxLine.push_back((char)buf[i]);
+                }
+            }
+        }
+
+        if (pfd[1].revents & (POLLIN | POLLHUP)) {
+            char buf[128];
+            ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+            if (n <= 0) stdinOpen = false;         // EOF: keep serving the UART
+            for (ssize_t i = 0; i < n; i++) {
+                if (buf[i] != '\n') { stdinLine.push_back(buf[i]); continue; }
+                if (!handleCommand(stdinLine, sim, now)) return 0;
+                stdinLine.clear();
+            }
+        }
+
+        sim.advance(now);
+        SimOutput out;
+        while (sim.popOutput(out)) {
+            if (o.verbose) logLine("<", out.line);
+            toHost.send(out.line + "\r\n", std::max(out.atUs, now));
+        }
+
+        // Release the bytes that have "arrived" on the wire by now
+        std::string wire;
+        uint8_t b;
+        while (toHost.receive(now, b)) wire.push_back((char)b);
+        if (!wire.empty()) {
+            ssize_t w = write(fd, wire.data(), wire.size());
+            (void)w;            // Nobody reading: dropped, like an unplugged cable
+        }
+    }
+}
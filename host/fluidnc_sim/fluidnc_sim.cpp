@@ -0,0 +1,728 @@
+/**
+ * @file fluidnc_sim.cpp
+ * @brief FluidNC (Grbl protocol) simulator in virtual time
+ *
+ * See fluidnc_sim.h for the model and its limits.
+ */
+
+#include "fluidnc_sim.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#define CMD_STATUS          '?'
+#define CMD_FEED_HOLD       '!'
+#define CMD_CYCLE_START     '~'
+#define CMD_RESET           0x18
+#define CMD_JOG_CANCEL      0x85
+#define CMD_FEED_OV_RESET   0x90
+#define CMD_FEED_OV_PLUS    0x91
+#define CMD_FEED_OV_MINUS   0x92
+#define CMD_FEED_OV_FINE_P  0x93
+#define CMD_FEED_OV_FINE_M  0x94
+#define CMD_RAPID_OV_RESET  0x95
+#define CMD_RAPID_OV_MEDIUM 0x96
+#define CMD_RAPID_OV_LOW    0x97
+#define CMD_SPINDLE_OV_RESET    0x99
+#define CMD_SPINDLE_OV_PLUS     0x9A
+#define CMD_SPINDLE_OV_MINUS    0x9B
+#define CMD_SPINDLE_OV_FINE_P   0x9C
+#define CMD_SPINDLE_OV_FINE_M   0x9D
+
+// Grbl status codes used by the simulator
+#define STATUS_OK                   0
+#define STATUS_EXPECTED_COMMAND     1
+#define STATUS_BAD_NUMBER           2
+#define STATUS_INVALID_STATEMENT    3
+#define STATUS_SETTING_DISABLED     5
+#define STATUS_IDLE_ERROR           8
+#define STATUS_ALARM_LOCK           9
+#define STATUS_TRAVEL_EXCEEDED      15
+#define STATUS_UNSUPPORTED_COMMAND  20
+#define STATUS_UNDEFINED_FEED_RATE  22
+#define STATUS_DEFERRED             -1      // "ok" comes later ($H)
+#define STATUS_SOFT_LIMIT           -2      // ALARM:2 instead of a response
+
+// Alarm codes
+#define ALARM_SOFT_LIMIT            2
+#define ALARM_ABORT_CYCLE           3
+#define ALARM_HOMING_FAIL_RESET     6
+
+static const char *const AXIS_LETTERS = "XYZA";
+static const char *const BANNER = "Grbl 3.7 [FluidNC v3.7.8 (sim) '$' for help]";
+static const char *const UNLOCK_MSG = "[MSG:INFO: '$H'|'$X' to unlock]";
+
+SimConfig SimConfig::rodentUart() {
+    SimConfig c;
+    for (auto &a : c.axes) {
+        a.stepsPerMm = 80.0f;
+        a.maxRateMmMin = 200.0f;
+        a.accelMmS2 = 100.0f;
+    }
+    c.reportIntervalMs = 75;
+    return c;
+}
+
+SimConfig SimConfig::rodentFluidnc() {
+    SimConfig c;
+    for (auto &a : c.axes) {
+        a.stepsPerMm = 80.0f;
+        a.maxRateMmMin = 5000.0f;
+        a.accelMmS2 = 200.0f;
+    }
+    c.reportIntervalMs = 0;     // No report_interval_ms in btt_rodent_fluidnc.yaml
+    return c;
+}
+
+FluidncSim::FluidncSim(const SimConfig &config) : cfg(config) {
+    emit(BANNER, 0);
+    if (cfg.mustHome) {
+        simState = SimState::Alarm;
+        emit(UNLOCK_MSG, 0);
+    }
+}
+
+// ============================================================================
+// INPUT
+// ============================================================================
+
+static bool isRealtime(uint8_t b) {
+    return b == CMD_STATUS || b == CMD_FEED_HOLD || b == CMD_CYCLE_START ||
+           b == CMD_RESET || b >= 0x80;
+}
+
+void FluidncSim::receive(uint8_t byte, int64_t atUs) {
+    int64_t due = atUs + (isRealtime(byte) ? (int64_t)cfg.realtimeLatencyUs : 0);
+    inputs.push_back({due, byte});
+}
+
+void FluidncSim::processByte(uint8_t b, int64_t t) {
+    if (isRealtime(b)) {
+        processRealtime(b, t);
+        return;
+    }
+    if (rxBytes >= cfg.rxBufferBytes) {
+        overflowCount++;        // Sender ignored the RX buffer size
+        return;
+    }
+    rxBytes++;
+    if (b == '\r') {
+        return;                 // Counted, but CRLF yields one line
+    }
+    if (b == '\n') {
+        lines.push_back(lineBuf);
+        lineBuf.clear();
+        if (lineReadyUs < 0) {
+            lineReadyUs = t + cfg.lineLatencyUs;
+        }
+        return;
+    }
+    lineBuf.push_back((char)b);
+}
+
+void FluidncSim::processRealtime(uint8_t b, int64_t t) {
+    switch (b) {
+        case CMD_STATUS:
+            emit(statusLine(), t);
+            break;
+
+        case CMD_FEED_HOLD:
+            if (simState == SimState::Run) {
+                simState = SimState::Hold;
+                holdRequested = true;
+            } else if (simState == SimState::Jog) {
+                jogCancelRequested = true;      // Feed hold cancels a jog
+            }
+            break;
+
+        case CMD_CYCLE_START:
+            if (simState == SimState::Hold && velocity == 0.0f) {
+                holdRequested = false;
+                simState = (active || !planner.empty()) ? SimState::Run : SimState::Idle;
+            }
+            break;
+
+        case CMD_RESET:
+            softReset(t);
+            break;
+
+        case CMD_JOG_CANCEL:
+            if (simState == SimState::Jog) {
+                jogCancelRequested = true;
+            }
+            break;
+
+        case CMD_FEED_OV_RESET:   ovFeed = 100; break;
+        case CMD_FEED_OV_PLUS:    ovFeed = (uint8_t)std::min(200, ovFeed + 10); break;
+        case CMD_FEED_OV_MINUS:   ovFeed = (uint8_t)std::max(10, ovFeed - 10); break;
+        case CMD_FEED_OV_FINE_P:  ovFeed = (uint8_t)std::min(200, ovFeed + 1); break;
+        case CMD_FEED_OV_FINE_M:  ovFeed = (uint8_t)std::max(10, ovFeed - 1); break;
+        case CMD_RAPID_OV_RESET:  ovRapid = 100; break;
+        case CMD_RAPID_OV_MEDIUM: ovRapid = 50; break;
+        case CMD_RAPID_OV_LOW:    ovRapid = 25; break;
+        case CMD_SPINDLE_OV_RESET:  ovSpindle = 100; break;
+        case CMD_SPINDLE_OV_PLUS:   ovSpindle = (uint8_t)std::min(200, ovSpindle + 10); break;
+        case CMD_SPINDLE_OV_MINUS:  ovSpindle = (uint8_t)std::max(10, ovSpindle - 10); break;
+        case CMD_SPINDLE_OV_FINE_P: ovSpindle = (uint8_t)std::min(200, ovSpindle + 1); break;
+        case CMD_SPINDLE_OV_FINE_M: ovSpindle = (uint8_t)std::max(10, ovSpindle - 1); break;
+
+        default:
+            break;      // Other overrides / extended commands are accepted and ignored
+    }
+}
+
+bool FluidncSim::tryExecuteLine(int64_t t) {
+    if (lines.empty()) {
+        lineReadyUs = -1;
+        return false;
+    }
+    if (lineReadyUs > t || planner.size() >= cfg.plannerBlocks || simState == SimState::Home || syncing) {
+        return false;           // Still parsing, planner full, homing or G4 (line stays in RX buffer)
+    }
+
+    std::string line = lines.front();
+    lines.pop_front();
+    uint32_t used = (uint32_t)line.size() + 1;
+    rxBytes = rxBytes > used ? rxBytes - used : 0;
+    executeLine(line, t);
+    lineReadyUs = lines.empty() ? -1 : t + cfg.lineLatencyUs;
+    return true;
+}
+
+// ============================================================================
+// LINE COMMANDS
+// ============================================================================
+
+void FluidncSim::executeLine(const std::string &raw, int64_t t) {
+    // Strip comments and whitespace, upper-case
+    std::string line;
+    bool inParen = false;
+    for (char c : raw) {
+        if (c == ';') break;
+        if (c == '(') { inParen = true; continue; }
+        if (c == ')') { inParen = false; continue; }
+        if (inParen || std::isspace((unsigned char)c)) continue;
+        line.push_back((char)std::toupper((unsigned char)c));
+    }
+
+    int status = STATUS_OK;
+    if (line.empty()) {
+        status = STATUS_OK;
+    } else if (line == "$X") {
+        if (simState == SimState::Alarm) {
+            simState = SimState::Idle;
+            emit("[MSG:INFO: Caution: Unlocked]", t);
+        }
+    } else if (line.compare(0, 3, "$J=") == 0) {
+        if (simState == SimState::Alarm) {
+            status = STATUS_ALARM_LOCK;
+        } else if (simState != SimState::Idle && simState != SimState::Jog) {
+            status = STATUS_IDLE_ERROR;
+        } else {
+            status = executeGcode(line.substr(3), true);
+        }
+    } else if (line[0] == '$') {
+        status = executeSetting(line, t);
+    } else if (simState == SimState::Alarm) {
+        status = STATUS_ALARM_LOCK;
+    } else {
+        status = executeGcode(line, false);
+    }
+
+    if (status == STATUS_DEFERRED) {
+        return;
+    } else if (status == STATUS_SOFT_LIMIT) {
+        raiseAlarm(ALARM_SOFT_LIMIT, t);
+    } else if (status == STATUS_OK) {
+        emit("ok", t);
+    } else {
+        char buf[16];
+        snprintf(buf, sizeof(buf), "error:%d", status);
+        emit(buf, t);
+    }
+}
+
+int FluidncSim::executeSetting(const std::string &line, int64_t t) {
+    char buf[96];
+
+    if (line == "$I") {
+        emit("[VER:3.7 FluidNC v3.7.8 (sim):]", t);
+        emit("[OPT:PHS]", t);
+        emit("[MSG: Machine: " + cfg.name + "]", t);
+        return STATUS_OK;
+    }
+
+    if (line == "$$") {
+        // Grbl-compatible numeric view of the YAML settings
+        bool hardLimits = false, homing = false, softLimits = false;
+        for (const SimAxisConfig &a : cfg.axes) {
+            hardLimits |= a.hardLimits;
+            softLimits |= a.softLimits;
+            homing |= a.homingCycle > 0;
+        }
+        snprintf(buf, sizeof(buf), "$11=%.3f", cfg.junctionDeviationMm); emit(buf, t);
+        emit("$13=0", t);
+        snprintf(buf, sizeof(buf), "$20=%d", softLimits ? 1 : 0); emit(buf, t);
+        snprintf(buf, sizeof(buf), "$21=%d", hardLimits ? 1 : 0); emit(buf, t);
+        snprintf(buf, sizeof(buf), "$22=%d", homing ? 1 : 0); emit(buf, t);
+        static const char *const groups[] = {"10", "11", "12", "13"};
+        for (int g = 0; g < 4; g++) {
+            for (int a = 0; a < SIM_AXES; a++) {
+                const SimAxisConfig &ax = cfg.axes[a];
+                float v = g == 0 ? ax.stepsPerMm : g == 1 ? ax.maxRateMmMin
+                        : g == 2 ? ax.accelMmS2 : ax.maxTravelMm;
+                snprintf(buf, sizeof(buf), "$%s%d=%.3f", groups[g], a, v);
+                emit(buf, t);
+            }
+        }
+        return STATUS_OK;
+    }
+
+    if (line == "$G") {
+        snprintf(buf, sizeof(buf), "[GC:G%d G54 G17 G21 G%d G94 M5 M9 T0 F%.0f S0]",
+                 motionMode, absolute ? 90 : 91, feedMmMin);
+        emit(buf, t);
+        return STATUS_OK;
+    }
+
+    if (line == "$H") {
+        return startHoming(t);
+    }
+
+    return STATUS_INVALID_STATEMENT;
+}
+
+int FluidncSim::startHoming(int64_t t) {
+    if (simState != SimState::Idle && simState != SimState::Alarm) {
+        return STATUS_IDLE_ERROR;
+    }
+
+    // Cycles run one after another; axes within a cycle move together.
+    // Each axis: seek to the switch, pull off, locate at feed rate, pull off.
+    int64_t totalUs = 0;
+    bool any = false;
+    for (int cycle = 1; cycle <= SIM_AXES; cycle++) {
+        int64_t cycleUs = 0;
+        for (int a = 0; a < SIM_AXES; a++) {
+            const SimAxisConfig &ax = cfg.axes[a];
+            if (ax.homingCycle != cycle) continue;
+            any = true;
+            float seekMm = std::fabs(mpos[a] - ax.homingMposMm) + ax.pulloffMm;
+            double s = seekMm / (ax.homingSeekMmMin / 60.0) +
+                       3.0 * ax.pulloffMm / (ax.homingFeedMmMin / 60.0) +
+                       2.0 * ax.homingSettleMs / 1000.0;
+            cycleUs = std::max(cycleUs, (int64_t)(s * 1e6));
+        }
+        totalUs += cycleUs;
+    }
+    if (!any) {
+        return STATUS_SETTING_DISABLED;     // No axis has a homing cycle
+    }
+
+    simState = SimState::Home;
+    homingDoneUs = t + totalUs;
+    return STATUS_DEFERRED;
+}
+
+bool FluidncSim::withinSoftLimits(const float *target) const {
+    for (int a = 0; a < SIM_AXES; a++) {
+        const SimAxisConfig &ax = cfg.axes[a];
+        if (!ax.softLimits) continue;
+        float lo = ax.homingPositive ? ax.homingMposMm - ax.maxTravelMm : ax.homingMposMm;
+        float hi = lo + ax.maxTravelMm;
+        if (target[a] < lo || target[a] > hi) return false;
+    }
+    return true;
+}
+
+int FluidncSim::executeGcode(const std::string &line, bool jog) {
+    bool abs = jog ? true : absolute;
+    int motion = jog ? 1 : motionMode;
+    bool setOffset = false;
+    bool dwell = false;
+    float feed = jog ? 0.0f : feedMmMin;
+    float words[SIM_AXES];
+    bool present[SIM_AXES] = {false};
+    float dwellS = 0.0f;
+
+    size_t i = 0;
+    while (i < line.size()) {
+        char letter = line[i++];
+        if (!std::isalpha((unsigned char)letter)) return STATUS_EXPECTED_COMMAND;
+        char *end;
+        float value = std::strtof(line.c_str() + i, &end);
+        if (end == line.c_str() + i) return STATUS_BAD_NUMBER;
+        i = (size_t)(end - line.c_str());
+
+        const char *axis = std::strchr(AXIS_LETTERS, letter);
+        if (axis != nullptr) {
+            int a = (int)(axis - AXIS_LETTERS);
+            words[a] = value;
+            present[a] = true;
+            continue;
+        }
+        switch (letter) {
+            case 'G': {
+                int g = (int)std::lround(value * 10.0f);
+                if (g == 0 || g == 10)       motion = g / 10;
+                else if (g == 40)            dwell = true;
+                else if (g == 900)           abs = true;
+                else if (g == 910)           abs = false;
+                else if (g == 920)           setOffset = true;
+                else if (g == 210 || g == 170 || g == 940 || g == 540) { /* accepted, no effect */ }
+                else return STATUS_UNSUPPORTED_COMMAND;
+                break;
+            }
+            case 'F': feed = value; break;
+            case 'P': dwellS = value; break;
+            case 'M': case 'N': case 'S': case 'T': break;
+            default:  return STATUS_UNSUPPORTED_COMMAND;
+        }
+    }
+
+    if (!jog) {
+        absolute = abs;
+        feedMmMin = feed;
+        motionMode = motion;
+    }
+
+    // End of everything already planned = start of the next block
+    float from[SIM_AXES];
+    if (!planner.empty()) {
+        std::copy(planner.back().target, planner.back().target + SIM_AXES, from);
+    } else if (active) {
+        std::copy(current.target, current.target + SIM_AXES, from);
+    } else {
+        std::copy(mpos, mpos + SIM_AXES, from);
+    }
+
+    if (setOffset) {
+        for (int a = 0; a < SIM_AXES; a++) {
+            if (present[a]) wcsOffset[a] = from[a] - words[a];
+        }
+        return STATUS_OK;
+    }
+
+    if (dwell) {
+        // As Grbl: wait for the planned motion to finish, dwell, then "ok"
+        if (dwellS > 0.0f) {
+            Block b{};
+            std::copy(from, from + SIM_AXES, b.target);
+            b.dwellUs = (int64_t)(dwellS * 1e6f);
+            planner.push_back(b);
+        }
+        if (planner.empty() && !active) return STATUS_OK;
+        syncing = true;
+        return STATUS_DEFERRED;
+    }
+
+    bool anyAxis = std::any_of(present, present + SIM_AXES, [](bool p) { return p; });
+    if (!anyAxis) {
+        return jog ? STATUS_INVALID_STATEMENT : STATUS_OK;
+    }
+    if (motion == 1 && feed <= 0.0f) {
+        return STATUS_UNDEFINED_FEED_RATE;
+    }
+
+    Block b{};
+    for (int a = 0; a < SIM_AXES; a++) {
+        if (!present[a]) b.target[a] = from[a];
+        else b.target[a] = abs ? words[a] + wcsOffset[a] : from[a] + words[a];
+    }
+    if (!withinSoftLimits(b.target)) {
+        return jog ? STATUS_TRAVEL_EXCEEDED : STATUS_SOFT_LIMIT;
+    }
+    b.feedMmMin = motion == 0 ? 0.0f : feed;
+    b.jog = jog;
+    planner.push_back(b);
+    if (jog && simState == SimState::Idle) {
+        simState = SimState::Jog;
+    }
+    return STATUS_OK;
+}
+
+// ============================================================================
+// MOTION
+// ============================================================================
+
+void FluidncSim::startNextBlock() {
+    current = planner.front();
+    planner.pop_front();
+    active = true;
+    travelled = 0.0f;
+    std::copy(mpos, mpos + SIM_AXES, startPos);
+
+    float sq = 0.0f;
+    for (int a = 0; a < SIM_AXES; a++) {
+        dir[a] = current.target[a] - startPos[a];
+        sq += dir[a] * dir[a];
+    }
+    length = std::sqrt(sq);
+    for (int a = 0; a < SIM_AXES; a++) {
+        dir[a] = length > 0.0f ? dir[a] / length : 0.0f;
+    }
+}
+
+void FluidncSim::stepMotion(double dtS) {
+    if (!active || dtS <= 0.0) return;
+
+    if (current.dwellUs > 0) {
+        current.dwellUs -= (int64_t)(dtS * 1e6);
+        if (current.dwellUs <= 0) active = false;
+        return;
+    }
+
+    // Path limits: slowest participating axis wins
+    float rateLimit = 1e9f, accel = 1e9f;
+    for (int a = 0; a < SIM_AXES; a++) {
+        float d = std::fabs(dir[a]);
+        if (d < 1e-6f) continue;
+        rateLimit = std::min(rateLimit, cfg.axes[a].maxRateMmMin / 60.0f / d);
+        accel = std::min(accel, cfg.axes[a].accelMmS2 / d);
+    }
+    float target = current.feedMmMin > 0.0f ? current.feedMmMin / 60.0f : rateLimit;
+    if (current.feedMmMin > 0.0f && !current.jog) target *= ovFeed / 100.0f;
+    if (current.feedMmMin == 0.0f) target *= ovRapid / 100.0f;
+    target = std::min(target, rateLimit);
+
+    float remaining = length - travelled;
+    bool stopping = holdRequested || jogCancelRequested;
+    float dt = (float)dtS;
+
+    if (stopping) {
+        velocity = std::max(0.0f, velocity - accel * dt);
+    } else {
+        if (velocity < target) velocity = std::min(target, velocity + accel * dt);
+        else if (velocity > target) velocity = std::max(target, velocity - accel * dt);
+        float brake = std::sqrt(2.0f * accel * std::max(remaining, 0.0f));
+        if (velocity > brake) velocity = brake;
+    }
+
+    float ds = velocity * dt;
+    if (ds >= remaining) {
+        travelled = length;
+        active = false;
+        if (!stopping) velocity = 0.0f;     // No junction blending
+    } else {
+        travelled += ds;
+    }
+    for (int a = 0; a < SIM_AXES; a++) {
+        mpos[a] = active ? startPos[a] + dir[a] * travelled : current.target[a];
+    }
+    if (!active && planner.empty()) velocity = 0.0f;
+
+    if (stopping && velocity == 0.0f && jogCancelRequested) {
+        // Jog cancel: drop the rest of the jog and go Idle
+        jogCancelRequested = false;
+        active = false;
+        while (!planner.empty() && planner.front().jog) planner.pop_front();
+        simState = SimState::Idle;
+    }
+}
+
+void FluidncSim::softReset(int64_t t) {
+    bool homing = simState == SimState::Home;
+    bool moving = simState == SimState::Run || simState == SimState::Jog ||
+                  (simState == SimState::Hold && velocity > 0.0f);
+
+    planner.clear();
+    active = false;
+    velocity = 0.0f;
+    holdRequested = false;
+    jogCancelRequested = false;
+    lines.clear();
+    lineBuf.clear();
+    rxBytes = 0;
+    lineReadyUs = -1;
+    ovFeed = 100;
+    ovRapid = 100;
+    ovSpindle = 100;
+    homingDoneUs = -1;
+    syncing = false;
+    absolute = true;
+    motionMode = 0;
+    feedMmMin = 0.0f;
+    std::fill(wcsOffset, wcsOffset + SIM_AXES, 0.0f);
+
+    if (homing) {
+        simState = SimState::Alarm;
+        emit("ALARM:" + std::to_string(ALARM_HOMING_FAIL_RESET), t);
+    } else if (moving) {
+        simState = SimState::Alarm;
+        emit("ALARM:" + std::to_string(ALARM_ABORT_CYCLE), t);     // Position may be lost
+    } else if (simState != SimState::Alarm) {
+        simState = SimState::Idle;
+    }
+    emit("", t);
+    emit(BANNER, t);
+    if (simState == SimState::Alarm) {
+        emit(UNLOCK_MSG, t);
+    }
+}
+
+void FluidncSim::raiseAlarm(int code, int64_t atUs) {
+    advance(atUs);
+
+    // Machine-side stop: no deceleration, queued motion and input discarded
+    planner.clear();
+    active = false;
+    velocity = 0.0f;
+    holdRequested = false;
+    jogCancelRequested = false;
+    homingDoneUs = -1;
+    syncing = false;
+    lines.clear();
+    lineBuf.clear();
+    rxBytes = 0;
+    lineReadyUs = -1;
+
+    simState = SimState::Alarm;
+    emit("ALARM:" + std::to_string(code), clockUs);
+}
+
+// ============================================================================
+// OUTPUT
+// ============================================================================
+
+std::string FluidncSim::statusLine() const {
+    const char *name = "Idle";
+    switch (simState) {
+        case SimState::Idle:  name = "Idle"; break;
+        case SimState::Run:   name = "Run"; break;
+        case SimState::Hold:  name = velocity > 0.0f ? "Hold:1" : "Hold:0"; break;
+        case SimState::Jog:   name = "Jog"; break;
+        case SimState::Home:  name = "Home"; break;
+        case SimState::Alarm: name = "Alarm"; break;
+    }
+    char buf[160];
+    int n = snprintf(buf, sizeof(buf), "<%s|MPos:%.3f,%.3f,%.3f,%.3f|FS:%.0f,0",
+                     name, mpos[0], mpos[1], mpos[2], mpos[3], velocity * 60.0f);
+    bool overridden = ovFeed != 100 || ovRapid != 100 || ovSpindle != 100;
+    if (overridden && n > 0 && n < (int)sizeof(buf)) {
+        n += snprintf(buf + n, sizeof(buf) - n, "|Ov:%u,%u,%u",
+                      (unsigned)ovFeed, (unsigned)ovRapid, (unsigned)ovSpindle);
+    }
+    std::string s(buf);
+    s.push_back('>');
+    return s;
+}
+
+void FluidncSim::emit(const std::string &line, int64_t t) {
+    output.push_back({t, line});
+}
+
+bool FluidncSim::popOutput(SimOutput &out) {
+    if (output.empty()) return false;
+    out = output.front();
+    output.pop_front();
+    return true;
+}
+
+void FluidncSim::autoReport(int64_t t) {
+    if (cfg.reportIntervalMs == 0 || t < nextReportUs) return;
+    nextReportUs = t + (int64_t)cfg.reportIntervalMs * 1000;
+
+    // FluidNC only auto-reports while something changes
+    std::string s = statusLine();
+    if (s != lastReported) {
+        lastReported = s;
+        emit(s, t);
+    }
+}
+
+// ============================================================================
+// TIME
+// ============================================================================
+
+int64_t FluidncSim::nextOutputUs() const {
+    int64_t next = INT64_MAX;
+    for (const Input &in : inputs) next = std::min(next, in.dueUs);
+    if (lineReadyUs >= 0 && simState != SimState::Home && !syncing) {
+        // A full planner frees up when a block finishes: step with the motion
+        next = std::min(next, planner.size() < cfg.plannerBlocks
+                                  ? lineReadyUs : clockUs + (int64_t)cfg.motionStepUs);
+    }
+    if (cfg.reportIntervalMs) next = std::min(next, nextReportUs);
+    if (homingDoneUs >= 0) next = std::min(next, homingDoneUs);
+    if (syncing && active) next = std::min(next, clockUs + (int64_t)cfg.motionStepUs);
+    if (next == INT64_MAX) return -1;
+    return std::max(next, clockUs);
+}
+
+void FluidncSim::advance(int64_t nowUs) {
+    while (true) {
+        // Next thing that can happen
+        int64_t next = nowUs;
+        for (const Input &in : inputs) next = std::min(next, in.dueUs);
+        bool lineRunnable = lineReadyUs >= 0 && planner.size() < cfg.plannerBlocks &&
+                            simState != SimState::Home && !syncing;
+        if (lineRunnable) next = std::min(next, lineReadyUs);
+        if (cfg.reportIntervalMs) next = std::min(next, nextReportUs);
+        if (homingDoneUs >= 0) next = std::min(next, homingDoneUs);
+        if (active) next = std::min(next, clockUs + (int64_t)cfg.motionStepUs);
+        if (next < clockUs) next = clockUs;
+
+        if (next > clockUs) {
+            stepMotion((double)(next - clockUs) * 1e-6);
+            clockUs = next;
+        }
+
+        // Inputs due now, in arrival order
+        while (true) {
+            auto due = std::min_element(inputs.begin(), inputs.end(),
+                [](const Input &a, const Input &b) { return a.dueUs < b.dueUs; });
+            if (due == inputs.end() || due->dueUs > clockUs) break;
+            uint8_t b = due->byte;
+            inputs.erase(due);
+            processByte(b, clockUs);
+        }
+
+        if (homingDoneUs >= 0 && clockUs >= homingDoneUs) {
+            for (int a = 0; a < SIM_AXES; a++) {
+                if (cfg.axes[a].homingCycle > 0) mpos[a] = cfg.axes[a].homingMposMm;
+            }
+            homingDoneUs = -1;
+            simState = SimState::Idle;
+            emit("ok", clockUs);
+            if (!lines.empty()) lineReadyUs = clockUs + cfg.lineLatencyUs;
+        }
+        if (syncing && !active && planner.empty()) {
+            syncing = false;
+            emit("ok", clockUs);
+            if (!lines.empty()) lineReadyUs = clockUs + cfg.lineLatencyUs;
+        }
+
+        tryExecuteLine(clockUs);
+
+        // Pick up the next block / settle the state
+        // (a hold that is still decelerating carries on into the next block)
+        if (!active && !planner.empty() && (!holdRequested || velocity > 0.0f) &&
+            simState != SimState::Alarm) {
+            startNextBlock();
+        }
+        if (simState == SimState::Run || simState == SimState::Idle) {
+            bool busy = active || !planner.empty();
+            SimState settled = busy ? SimState::Run : SimState::Idle;
+            if (settled != simState) {
+                (settled == SimState::Run ? runStartUs : runEndUs) = clockUs;
+            }
+            simState = settled;
+        } else if (simState == SimState::Jog && !active && planner.empty()) {
+            simState = SimState::Idle;
+        }
+
+        autoReport(clockUs);
+
+        if (clockUs >= nowUs) {
+            bool inputDue = std::any_of(inputs.begin(), inputs.end(),
+                [&](const Input &in) { return in.dueUs <= nowUs; });
+            bool lineDue = lineReadyUs >= 0 && lineReadyUs <= nowUs &&
+                           planner.size() < cfg.plannerBlocks && simState != SimState::Home && !syncing;
+            if (!inputDue && !lineDue) break;
+        }
+    }
+}
@@ -0,0 +1,213 @@
+/**
+ * @file fluidnc_sim.h
+ * @brief FluidNC (Grbl protocol) simulator in virtual time
+ *
+ * Behaves like the BTT Rodent on the other end of the UART closely
+ * enough to test the ESP32 side without hardware:
+ * - Line protocol with ok / error:N, RX buffer and planner accounting
+ * - Realtime bytes: '?' '!' '~' Ctrl-X, jog cancel, feed / rapid /
+ *   spindle overrides
+ * - Status reports on '?' and every report_interval_ms while changing
+ * - $I, $$, $G, $X, $H (timed from the homing rates), $J=
+ * - Trapezoidal motion per block using steps/mm, max rate and
+ *   acceleration from the YAML configs (no junction blending)
+ * - Feed hold deceleration (Hold:1 -> Hold:0), ALARM:3 on reset in
+ *   motion, ALARM:2 soft limits, injected alarms (raiseAlarm), start-up
+ *   lock with must_home
+ *
+ * The simulator has no clock of its own: bytes are handed in with their
+ * arrival time and advance() runs everything up to a given time. Output
+ * lines carry the time they were generated; the caller decides how they
+ * reach the ESP32 side (see uart_link.h).
+ */
+
+#ifndef FLUIDNC_SIM_H
+#define FLUIDNC_SIM_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+
+#define SIM_AXES    4       // X Y Z A = pumps 1-4
+
+struct SimAxisConfig {
+    float stepsPerMm = 80.0f;
+    float maxRateMmMin = 200.0f;
+    float accelMmS2 = 100.0f;
+    float maxTravelMm = 200.0f;
+    bool softLimits = false;
+    bool hardLimits = false;            // Reported by $$ only (alarms: raiseAlarm)
+    int homingCycle = 0;                // 0 = not homed by $H
+    bool homingPositive = false;
+    float homingMposMm = 0.0f;
+    float homingFeedMmMin = 800.0f;
+    float homingSeekMmMin = 2000.0f;
+    uint32_t homingSettleMs = 500;
+    float pulloffMm = 1.0f;
+};
+
+struct SimConfig {
+    SimAxisConfig axes[SIM_AXES];
+    std::string name = "BTT Rodent (sim)";
+    float junctionDeviationMm = 0.01f;  // Reported by $$ only
+    bool mustHome = false;              // Start locked in Alarm
+    uint32_t reportIntervalMs = 75;     // 0 = report only on '?'
+    uint32_t rxBufferBytes = 128;
+    uint32_t plannerBlocks = 16;
+    uint32_t realtimeLatencyUs = 50;    // Byte received -> realtime command acted on
+    uint32_t lineLatencyUs = 300;       // Line complete -> parsed, planned, "ok"
+    uint32_t motionStepUs = 1000;       // Motion integration step
+
+    /** btt_rodent_uart.yaml: 200 mm/min, 100 mm/s^2, report_interval_ms 75 */
+    static SimConfig rodentUart();
+    /** btt_rodent_fluidnc.yaml: 5000 mm/min, 200 mm/s^2 */
+    static SimConfig rodentFluidnc();
+
+    /**
+     * @brief Overlay the settings found in a FluidNC config.yaml
+     *
+     * Reads name, axes.<x|y|z|a>.{steps_per_mm, max_rate_mm_per_min,
+     * acceleration_mm_per_sec2, max_travel_mm, soft_limits, homing.*,
+     * motor0.{pulloff_mm, hard_limits}}, uart_channel*.report_interval_ms (absent = 0,
+     * as in FluidNC), junction_deviation_mm and start.must_home. Everything
+     * else in the file is ignored. Implemented in sim_config.cpp.
+     *
+     * @return false (with *error set) if the file cannot be read
+     */
+    static bool fromYaml(const std::string &path, SimConfig &config, std::string *error);
+};
+
+enum class SimState { Idle, Run, Hold, Jog, Home, Alarm };
+
+struct SimOutput {
+    int64_t atUs;           // Time the line was generated
+    std::string line;       // Without line terminator
+};
+
+class FluidncSim {
+public:
+    explicit FluidncSim(const SimConfig &config = SimConfig());
+
+    /**
+     * @brief A byte arrived from the ESP32 at atUs (must not go backwards)
+     */
+    void receive(uint8_t byte, int64_t atUs);
+
+    void receive(const std::string &data, int64_t atUs) {
+        for (char c : data) receive((uint8_t)c, atUs);
+    }
+
+    /**
+     * @brief Run input processing, motion and auto-reports up to nowUs
+     */
+    void advance(int64_t nowUs);
+
+    /**
+     * @brief Next generated output line (FIFO order)
+     */
+    bool popOutput(SimOutput &out);
+
+    /**
+     * @brief Machine-side alarm at atUs (1 = hard limit, ...): motion
+     *        stops without deceleration, the planner is flushed
+     */
+    void raiseAlarm(int code, int64_t atUs);
+
+    // Introspection for scenarios and assertions
+    SimState state() const { return simState; }
+    bool holdComplete() const { return simState == SimState::Hold && velocity == 0.0f; }
+    float position(int axis) const { return mpos[axis]; }
+    float speedMmMin() const { return velocity * 60.0f; }
+    size_t plannerDepth() const { return planner.size() + (active ? 1 : 0); }
+    uint32_t rxUsed() const { return rxBytes; }
+    uint32_t rxOverflows() const { return overflowCount; }
+    uint8_t feedOverride() const { return ovFeed; }
+    uint8_t rapidOverride() const { return ovRapid; }
+    uint8_t spindleOverride() const { return ovSpindle; }
+    const SimConfig &config() const { return cfg; }
+    int64_t now() const { return clockUs; }
+    int64_t motionStartUs() const { return runStartUs; }    // Last Idle -> Run (-1: never)
+    int64_t motionEndUs() const { return runEndUs; }        // Last Run -> Idle (-1: never)
+    std::string statusLine() const;
+
+    /**
+     * @brief Earliest time advance() can produce output (-1: nothing pending)
+     *
+     * Output only comes from input processing, line execution, homing and
+     * auto-reports; motion in between is silent. A discrete-event caller can
+     * jump straight to this time without missing a line.
+     */
+    int64_t nextOutputUs() const;
+
+private:
+    struct Block {
+        float target[SIM_AXES];
+        float feedMmMin;        // 0 = rapid
+        bool jog;
+        int64_t dwellUs;        // G4 (no motion)
+    };
+
+    struct Input {
+        int64_t dueUs;
+        uint8_t byte;
+    };
+
+    void processByte(uint8_t b, int64_t t);
+    void processRealtime(uint8_t b, int64_t t);
+    bool tryExecuteLine(int64_t t);
+    void executeLine(const std::string &line, int64_t t);
+    int executeGcode(const std::string &line, bool jog);
+    int executeSetting(const std::string &line, int64_t t);
+    int startHoming(int64_t t);
+    bool withinSoftLimits(const float *target) const;
+    void startNextBlock();
+    void stepMotion(double dtS);
+    void softReset(int64_t t);
+    void emit(const std::string &line, int64_t t);
+    void autoReport(int64_t t);
+
+    SimConfig cfg;
+    int64_t clockUs = 0;
+
+    // Input side
+    std::deque<Input> inputs;           // Waiting for their realtime/line latency
+    std::string lineBuf;                // Bytes of the line being received
+    std::deque<std::string> lines;      // Complete lines not yet executed
+    uint32_t rxBytes = 0;               // Bytes held in the RX buffer
+    uint32_t overflowCount = 0;
+    int64_t lineReadyUs = -1;           // Head line finishes parsing at this time
+
+    // Modal state
+    bool absolute = true;
+    int motionMode = 0;                 // G0 / G1
+    float feedMmMin = 0.0f;
+    float wcsOffset[SIM_AXES] = {0};
+
+    // Motion
+    SimState simState = SimState::Idle;
+    std::deque<Block> planner;
+    bool active = false;
+    Block current{};
+    float startPos[SIM_AXES] = {0};
+    float dir[SIM_AXES] = {0};
+    float length = 0.0f;
+    float travelled = 0.0f;
+    float velocity = 0.0f;              // mm/s along the path
+    float mpos[SIM_AXES] = {0};
+    uint8_t ovFeed = 100;
+    uint8_t ovRapid = 100;
+    uint8_t ovSpindle = 100;
+    int64_t homingDoneUs = -1;          // $H running until then ("ok" at the end)
+    bool syncing = false;               // G4 waiting for the planner to drain ("ok" at the end)
+    int64_t runStartUs = -1;
+    int64_t runEndUs = -1;
+    bool holdRequested = false;
+    bool jogCancelRequested = false;
+
+    // Reporting
+    std::deque<SimOutput> output;
+    int64_t nextReportUs = 0;
+    std::string lastReported;
+};
+
+#endif // FLUIDNC_SIM_H
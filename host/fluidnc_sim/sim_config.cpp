@@ -0,0 +1,131 @@
+/**
+ * @file sim_config.cpp
+ * @brief SimConfig from a FluidNC config.yaml (btt_rodent_*.yaml)
+ *
+ * FluidNC configs only use block mappings with scalar values, so this is
+ * a small indentation-based reader, not a YAML library: each "key: value"
+ * line becomes a path such as "axes/x/homing/cycle". Lists, anchors and
+ * multi-line scalars do not occur in these files and are not supported.
+ */
+
+#include "fluidnc_sim.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <type_traits>
+#include <vector>
+
+static std::string trim(const std::string &s) {
+    size_t b = s.find_first_not_of(" \t\r");
+    if (b == std::string::npos) return "";
+    size_t e = s.find_last_not_of(" \t\r");
+    return s.substr(b, e - b + 1);
+}
+
+static std::string stripComment(const std::string &s) {
+    bool quoted = false;
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] == '"') quoted = !quoted;
+        if (s[i] == '#' && !quoted && (i == 0 || s[i - 1] == ' ' || s[i - 1] == '\t')) {
+            return s.substr(0, i);
+        }
+    }
+    return s;
+}
+
+static std::string unquote(const std::string &s) {
+    if (s.size() >= 2 && s.front() == '"' && s.back() == '"') {
+        return s.substr(1, s.size() - 2);
+    }
+    return s;
+}
+
+static bool readYaml(const std::string &path, std::map<std::string, std::string> &out) {
+    std::ifstream in(path);
+    if (!in) return false;
+
+    std::vector<std::pair<size_t, std::string>> stack;     // (indent, key)
+    std::string raw;
+    while (std::getline(in, raw)) {
+        std::string line = stripComment(raw);
+        if (trim(line).empty()) continue;
+
+        size_t indent = line.find_first_not_of(' ');
+        size_t colon = line.find(':', indent);
+        if (colon == std::string::npos) continue;
+
+        std::string key = trim(line.substr(indent, colon - indent));
+        std::string value = unquote(trim(line.substr(colon + 1)));
+
+        while (!stack.empty() && stack.back().first >= indent) {
+            stack.pop_back();
+        }
+        std::string full;
+        for (const auto &level : stack) full += level.second + "/";
+        full += key;
+
+        if (value.empty()) {
+            stack.push_back({indent, key});     // Start of a nested mapping
+        } else {
+            out[full] = value;
+        }
+    }
+    return true;
+}
+
+bool SimConfig::fromYaml(const std::string &path, SimConfig &config, std::string *error) {
+    std::map<std::string, std::string> kv;
+    if (!readYaml(path, kv)) {
+        if (error) *error = "cannot read " + path;
+        return false;
+    }
+
+    auto number = [&](const std::string &key, float &dst) {
+        auto it = kv.find(key);
+        if (it != kv.end()) dst = std::strtof(it->second.c_str(), nullptr);
+    };
+    auto integer = [&](const std::string &key, auto &dst) {
+        auto it = kv.find(key);
+        if (it != kv.end()) dst = (std::remove_reference_t<decltype(dst)>)std::strtol(it->second.c_str(), nullptr, 10);
+    };
+    auto flag = [&](const std::string &key, bool &dst) {
+        auto it = kv.find(key);
+        if (it != kv.end()) dst = it->second == "true";
+    };
+
+    if (kv.count("name")) config.name = kv["name"];
+
+    static const char *const axisKeys[SIM_AXES] = {"x", "y", "z", "a"};
+    for (int a = 0; a < SIM_AXES; a++) {
+        const std::string base = std::string("axes/") + axisKeys[a] + "/";
+        SimAxisConfig &ax = config.axes[a];
+        number(base + "steps_per_mm", ax.stepsPerMm);
+        number(base + "max_rate_mm_per_min", ax.maxRateMmMin);
+        number(base + "acceleration_mm_per_sec2", ax.accelMmS2);
+        number(base + "max_travel_mm", ax.maxTravelMm);
+        flag(base + "soft_limits", ax.softLimits);
+        integer(base + "homing/cycle", ax.homingCycle);
+        flag(base + "homing/positive_direction", ax.homingPositive);
+        number(base + "homing/mpos_mm", ax.homingMposMm);
+        number(base + "homing/feed_mm_per_min", ax.homingFeedMmMin);
+        number(base + "homing/seek_mm_per_min", ax.homingSeekMmMin);
+        integer(base + "homing/settle_ms", ax.homingSettleMs);
+        number(base + "motor0/pulloff_mm", ax.pulloffMm);
+        flag(base + "motor0/hard_limits", ax.hardLimits);
+    }
+
+    // FluidNC only auto-reports on channels that set report_interval_ms
+    config.reportIntervalMs = 0;
+    for (const auto &entry : kv) {
+        const std::string &key = entry.first;
+        if (key.compare(0, 12, "uart_channel") == 0 &&
+            key.size() > 19 && key.compare(key.size() - 19, 19, "/report_interval_ms") == 0) {
+            config.reportIntervalMs = (uint32_t)std::strtoul(entry.second.c_str(), nullptr, 10);
+        }
+    }
+
+    number("junction_deviation_mm", config.junctionDeviationMm);
+    flag("start/must_home", config.mustHome);
+    return true;
+}
@@ -0,0 +1,116 @@
+/**
+ * @file uart_link.h
+ * @brief One direction of an 8N1 serial line in virtual time
+ *
+ * Bytes are shifted out back to back at the configured baud (10 bits per
+ * byte); each queued byte carries its arrival time at the receiver.
+ * insert() puts bytes at an arbitrary position among the bytes still on
+ * their way and re-times everything behind them - used to model the
+ * e-stop writing '!' into the hardware FIFO behind the bytes already
+ * there but ahead of the driver's software ring.
+ */
+
+#ifndef UART_LINK_H
+#define UART_LINK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+class UartLink {
+public:
+    explicit UartLink(uint32_t baud = 115200)
+        : byteUs(10.0e6 / baud) {}
+
+    double byteTimeUs() const { return byteUs; }
+
+    /**
+     * @brief Queue bytes at the tail (driver TX ring)
+     * @return Arrival time of the last byte
+     */
+    int64_t send(const std::string &data, int64_t nowUs) {
+        for (char c : data) {
+            double start = pending.empty() ? lastEndUs : pending.back().arrivalUs;
+            if (start < (double)nowUs) start = (double)nowUs;
+            pending.push_back({start + byteUs, (uint8_t)c});
+        }
+        if (!pending.empty()) lastEndUs = pending.back().arrivalUs;
+        return pending.empty() ? nowUs : rounded(pending.back().arrivalUs);
+    }
+
+    int64_t send(uint8_t b, int64_t nowUs) {
+        return send(std::string(1, (char)b), nowUs);
+    }
+
+    /**
+     * @brief Insert bytes after the first `position` bytes still on their way
+     * @return Arrival time of the last inserted byte
+     */
+    int64_t insert(size_t position, const std::string &data, int64_t nowUs) {
+        size_t index = arrivedCount(nowUs) + position;
+        if (index >= pending.size()) {
+            return send(data, nowUs);
+        }
+
+        std::deque<Byte> tail(pending.begin() + index, pending.end());
+        pending.erase(pending.begin() + index, pending.end());
+        lastEndUs = pending.empty() ? receivedEndUs : pending.back().arrivalUs;
+        // Inserted bytes go out next; everything that was behind them moves back
+        int64_t result = send(data, nowUs);
+        std::string rest;
+        for (const Byte &b : tail) rest.push_back((char)b.value);
+        send(rest, nowUs);
+        return result;
+    }
+
+    /**
+     * @brief Pop the next byte that has fully arrived by nowUs
+     */
+    bool receive(int64_t nowUs, uint8_t &b, int64_t *arrivedUs = nullptr) {
+        if (pending.empty() || rounded(pending.front().arrivalUs) > nowUs) return false;
+        if (arrivedUs) *arrivedUs = rounded(pending.front().arrivalUs);
+        b = pending.front().value;
+        receivedEndUs = pending.front().arrivalUs;
+        pending.pop_front();
+        return true;
+    }
+
+    /**
+     * @brief Arrival time of the next byte, or -1 if idle
+     */
+    int64_t nextArrivalUs() const {
+        return pending.empty() ? -1 : rounded(pending.front().arrivalUs);
+    }
+
+    /**
+     * @brief Bytes that have not fully arrived by nowUs
+     */
+    size_t inFlightBytes(int64_t nowUs) const {
+        return pending.size() - arrivedCount(nowUs);
+    }
+
+    void clear() { pending.clear(); }
+
+private:
+    struct Byte {
+        double arrivalUs;
+        uint8_t value;
+    };
+
+    static int64_t rounded(double us) { return (int64_t)(us + 0.5); }
+
+    // Bytes that arrived but were not popped by the receiver yet
+    size_t arrivedCount(int64_t nowUs) const {
+        size_t n = 0;
+        while (n < pending.size() && rounded(pending[n].arrivalUs) <= nowUs) n++;
+        return n;
+    }
+
+    double byteUs;
+    double lastEndUs = 0.0;         // Arrival of the last byte ever queued
+    double receivedEndUs = 0.0;     // Arrival of the last byte popped
+    std::deque<Byte> pending;
+};
+
+#endif // UART_LINK_H
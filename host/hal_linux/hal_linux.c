@@ -0,0 +1,642 @@
+/**
+ * @file hal_linux.c
+ * @brief src/hal.h on Linux: ptys, virtual GPIO, framebuffers, file NVS
+ *
+ * See hal_linux.h for how to drive it.
+ */
+
+#define _GNU_SOURCE
+
+#include "hal_linux.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define GPIO_COUNT          64
+#define UART_RX_RING        8192        // Power of two
+#define LCD_MAX_ROWS        4
+#define LCD_MAX_COLS        40
+#define LED_MAX             256
+#define ECHO_INTERVAL_US    100000      // LCD / LED echo rate limit
+#define NVS_MAX_ENTRIES     64
+#define NVS_MAX_KEY         16          // Same limit as ESP-IDF NVS (15 chars + NUL)
+#define NVS_MAX_BLOB        2048
+
+static bool quiet = false;
+static int64_t run_until_us = 0;
+static const char *pty_dir = NULL;
+
+// ============================================================================
+// CLOCK
+// ============================================================================
+
+static int64_t boot_ns = -1;
+
+static int64_t mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int64_t hal_time_us(void) {
+    if (boot_ns < 0) boot_ns = mono_ns();
+    return (mono_ns() - boot_ns) / 1000;
+}
+
+uint32_t hal_millis(void) {
+    return (uint32_t)(hal_time_us() / 1000);
+}
+
+void hal_delay_ms(uint32_t ms) {
+    struct timespec ts = {.tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000L};
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+void hal_delay_us(uint32_t us) {
+    int64_t end = hal_time_us() + us;
+    while (hal_time_us() < end) {
+    }
+}
+
+// ============================================================================
+// GPIO
+// ============================================================================
+
+typedef struct {
+    hal_gpio_mode_t mode;
+    int level;
+    hal_gpio_edge_t edge;
+    hal_gpio_isr_t isr;
+    void *arg;
+} vpin_t;
+
+static vpin_t pins[GPIO_COUNT];
+static pthread_mutex_t gpio_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static bool pin_valid(int pin) {
+    return pin >= 0 && pin < GPIO_COUNT;
+}
+
+bool hal_gpio_mode(int pin, hal_gpio_mode_t mode) {
+    if (!pin_valid(pin)) return false;
+    pthread_mutex_lock(&gpio_lock);
+    pins[pin].mode = mode;
+    if (mode == HAL_GPIO_INPUT_PULLUP) pins[pin].level = 1;
+    pthread_mutex_unlock(&gpio_lock);
+    return true;
+}
+
+int hal_gpio_read(int pin) {
+    if (!pin_valid(pin)) return 0;
+    return __atomic_load_n(&pins[pin].level, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Set a level and run the edge ISR, if any, on this thread
+ */
+static void gpio_drive(int pin, int level) {
+    if (!pin_valid(pin)) return;
+    level = level ? 1 : 0;
+
+    pthread_mutex_lock(&gpio_lock);
+    int old = pins[pin].level;
+    __atomic_store_n(&pins[pin].level, level, __ATOMIC_RELEASE);
+    hal_gpio_edge_t edge = pins[pin].edge;
+    hal_gpio_isr_t isr = pins[pin].isr;
+    void *arg = pins[pin].arg;
+    pthread_mutex_unlock(&gpio_lock);
+
+    if (isr == NULL || old == level) return;
+    bool rising = level == 1;
+    if (edge == HAL_GPIO_EDGE_ANY || (edge == HAL_GPIO_EDGE_RISING && rising) ||
+        (edge == HAL_GPIO_EDGE_FALLING && !rising)) {
+        isr(arg);
+    }
+}
+
+void hal_gpio_write(int pin, int level) {
+    gpio_drive(pin, level);
+}
+
+bool hal_gpio_set_isr(int pin, hal_gpio_edge_t edge, hal_gpio_isr_t isr, void *arg) {
+    if (!pin_valid(pin)) return false;
+    pthread_mutex_lock(&gpio_lock);
+    pins[pin].edge = isr ? edge : HAL_GPIO_EDGE_NONE;
+    pins[pin].isr = isr;
+    pins[pin].arg = arg;
+    pthread_mutex_unlock(&gpio_lock);
+    return true;
+}
+
+void hal_linux_gpio_inject(int pin, int level) {
+    gpio_drive(pin, level);
+}
+
+// ============================================================================
+// PTYS
+// ============================================================================
+
+/**
+ * @brief Raw pty; the slave stays open here so the master never sees HUP
+ */
+static int open_pty(char *path, size_t path_len, const char *link_name) {
+    int fd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    const char *name = ptsname(fd);
+    snprintf(path, path_len, "%s", name ? name : "?");
+
+    int slave = open(path, O_RDWR | O_NOCTTY);
+    if (slave >= 0) {
+        struct termios tio;
+        tcgetattr(slave, &tio);
+        cfmakeraw(&tio);
+        tcsetattr(slave, TCSANOW, &tio);
+        // Intentionally kept open for the life of the process
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    if (pty_dir != NULL && link_name != NULL) {
+        char link_path[256];
+        snprintf(link_path, sizeof(link_path), "%s/%s", pty_dir, link_name);
+        unlink(link_path);
+        if (symlink(path, link_path) == 0) {
+            fprintf(stderr, "[hal] %s -> %s (%s)\n", link_name, path, link_path);
+            return fd;
+        }
+    }
+    fprintf(stderr, "[hal] %s -> %s\n", link_name ? link_name : "pty", path);
+    return fd;
+}
+
+// ============================================================================
+// UART
+// ============================================================================
+
+typedef struct {
+    bool open;
+    int fd_in;
+    int fd_out;
+    char path[64];
+    uint8_t rx[UART_RX_RING];
+    uint32_t head;
+    uint32_t tail;
+    uint32_t baud;
+    pthread_mutex_t lock;
+} vuart_t;
+
+static vuart_t uarts[HAL_UART_COUNT] = {
+    {.lock = PTHREAD_MUTEX_INITIALIZER},
+    {.lock = PTHREAD_MUTEX_INITIALIZER},
+    {.lock = PTHREAD_MUTEX_INITIALIZER},
+};
+
+static bool port_valid(int port) {
+    return port >= 0 && port < HAL_UART_COUNT;
+}
+
+/**
+ * @brief Move whatever the fd has into the RX ring (never blocks)
+ */
+static void uart_pump(vuart_t *u) {
+    for (;;) {
+        struct pollfd pfd = {.fd = u->fd_in, .events = POLLIN};
+        if (poll(&pfd, 1, 0) <= 0 || !(pfd.revents & POLLIN)) return;
+
+        uint32_t space = UART_RX_RING - (u->head - u->tail);
+        if (space == 0) return;
+        uint8_t buf[256];
+        ssize_t n = read(u->fd_in, buf, space < sizeof(buf) ? space : sizeof(buf));
+        if (n <= 0) return;
+        for (ssize_t i = 0; i < n; i++) {
+            u->rx[u->head++ & (UART_RX_RING - 1)] = buf[i];
+        }
+    }
+}
+
+bool hal_uart_open(int port, const hal_uart_config_t *config) {
+    if (!port_valid(port)) return false;
+    vuart_t *u = &uarts[port];
+    pthread_mutex_lock(&u->lock);
+    if (!u->open) {
+        if (port == HAL_UART_CONSOLE) {
+            u->fd_in = STDIN_FILENO;
+            u->fd_out = STDOUT_FILENO;
+            u->path[0] = '\0';
+        } else {
+            char name[8];
+            snprintf(name, sizeof(name), "uart%d", port);
+            int fd = open_pty(u->path, sizeof(u->path), name);
+            if (fd < 0) {
+                pthread_mutex_unlock(&u->lock);
+                return false;
+            }
+            u->fd_in = u->fd_out = fd;
+        }
+        u->open = true;
+    }
+    u->baud = config ? config->baud : 115200;
+    pthread_mutex_unlock(&u->lock);
+    return true;
+}
+
+int hal_uart_write(int port, const void *data, size_t len) {
+    if (!port_valid(port) || !uarts[port].open) return -1;
+    vuart_t *u = &uarts[port];
+
+    if (port == HAL_UART_CONSOLE) {
+        // Through stdio so it interleaves correctly with printf() from C modules
+        fwrite(data, 1, len, stdout);
+        fflush(stdout);
+        return (int)len;
+    }
+
+    const uint8_t *p = (const uint8_t *)data;
+    size_t left = len;
+    while (left > 0) {
+        ssize_t n = write(u->fd_out, p, left);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;                  // EAGAIN: nobody reading, drop like an unplugged cable
+        }
+        p += n;
+        left -= (size_t)n;
+    }
+    return (int)(len - left);
+}
+
+int hal_uart_read(int port, void *buf, size_t len, uint32_t timeout_ms) {
+    if (!port_valid(port) || !uarts[port].open) return -1;
+    vuart_t *u = &uarts[port];
+
+    pthread_mutex_lock(&u->lock);
+    uart_pump(u);
+    if (u->head == u->tail && timeout_ms > 0) {
+        pthread_mutex_unlock(&u->lock);
+        struct pollfd pfd = {.fd = u->fd_in, .events = POLLIN};
+        poll(&pfd, 1, (int)timeout_ms);
+        pthread_mutex_lock(&u->lock);
+        uart_pump(u);
+    }
+    size_t n = 0;
+    uint8_t *out = (uint8_t *)buf;
+    while (n < len && u->tail != u->head) {
+        out[n++] = u->rx[u->tail++ & (UART_RX_RING - 1)];
+    }
+    pthread_mutex_unlock(&u->lock);
+    return (int)n;
+}
+
+size_t hal_uart_available(int port) {
+    if (!port_valid(port) || !uarts[port].open) return 0;
+    vuart_t *u = &uarts[port];
+    pthread_mutex_lock(&u->lock);
+    uart_pump(u);
+    size_t n = u->head - u->tail;
+    pthread_mutex_unlock(&u->lock);
+    return n;
+}
+
+void hal_uart_flush(int port) {
+    if (!port_valid(port) || !uarts[port].open) return;
+    if (port == HAL_UART_CONSOLE) {
+        fflush(stdout);
+    }
+    // Pty writes are complete once write() returns
+}
+
+const char *hal_linux_uart_path(int port) {
+    return port_valid(port) ? uarts[port].path : "";
+}
+
+// ============================================================================
+// LCD FRAMEBUFFER
+// ============================================================================
+
+static char lcd_fb[LCD_MAX_ROWS][LCD_MAX_COLS + 1];
+static char lcd_shown[LCD_MAX_ROWS][LCD_MAX_COLS + 1];
+static uint8_t lcd_cols = 16;
+static uint8_t lcd_rows = 2;
+static uint8_t lcd_col = 0;
+static uint8_t lcd_row = 0;
+static bool lcd_on = false;
+static bool lcd_light = true;
+static int64_t lcd_echo_us = 0;
+
+static void lcd_echo(void) {
+    if (quiet || !lcd_on) return;
+    int64_t now = hal_time_us();
+    if (now - lcd_echo_us < ECHO_INTERVAL_US) return;
+    if (memcmp(lcd_fb, lcd_shown, sizeof(lcd_fb)) == 0) return;
+
+    memcpy(lcd_shown, lcd_fb, sizeof(lcd_fb));
+    lcd_echo_us = now;
+    fprintf(stderr, "[LCD]%s", lcd_light ? " " : "*");
+    for (int r = 0; r < lcd_rows; r++) {
+        fprintf(stderr, "|%s", lcd_fb[r]);
+    }
+    fprintf(stderr, "|\n");
+}
+
+bool hal_lcd_probe(const hal_lcd_config_t *config, uint8_t addr) {
+    (void)config;
+    const char *env = getenv("HAL_LCD_ADDR");
+    unsigned present = env ? (unsigned)strtoul(env, NULL, 0) : 0x27;
+    return addr == present;
+}
+
+bool hal_lcd_init(const hal_lcd_config_t *config) {
+    if (!hal_lcd_probe(config, config->addr)) return false;
+    lcd_cols = config->cols > LCD_MAX_COLS ? LCD_MAX_COLS : config->cols;
+    lcd_rows = config->rows > LCD_MAX_ROWS ? LCD_MAX_ROWS : config->rows;
+    lcd_on = true;
+    hal_lcd_clear();
+    return true;
+}
+
+void hal_lcd_clear(void) {
+    for (int r = 0; r < LCD_MAX_ROWS; r++) {
+        memset(lcd_fb[r], ' ', lcd_cols);
+        lcd_fb[r][lcd_cols] = '\0';
+    }
+    lcd_col = lcd_row = 0;
+    lcd_echo();
+}
+
+void hal_lcd_set_cursor(uint8_t col, uint8_t row) {
+    lcd_col = col;
+    lcd_row = row < lcd_rows ? row : lcd_rows - 1;
+}
+
+void hal_lcd_write(const char *text, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (lcd_col < lcd_cols) {
+            lcd_fb[lcd_row][lcd_col] = text[i];
+        }
+        lcd_col++;                  // Like the HD44780: text past the edge is lost
+    }
+    lcd_echo();
+}
+
+void hal_lcd_backlight(bool on) {
+    lcd_light = on;
+}
+
+const char *hal_linux_lcd_row(int row) {
+    return (row >= 0 && row < lcd_rows) ? lcd_fb[row] : "";
+}
+
+// ============================================================================
+// LED FRAMEBUFFER
+// ============================================================================
+
+static uint8_t led_fb[LED_MAX * 3];
+static uint8_t led_shown[LED_MAX * 3];
+static size_t led_count = 0;
+static int64_t led_echo_us = 0;
+
+bool hal_leds_init(int pin, size_t count) {
+    (void)pin;
+    led_count = count > LED_MAX ? LED_MAX : count;
+    memset(led_fb, 0, sizeof(led_fb));
+    return true;
+}
+
+void hal_leds_show(const uint8_t *rgb, size_t count, uint8_t brightness) {
+    if (count > led_count) count = led_count;
+    for (size_t i = 0; i < count * 3; i++) {
+        led_fb[i] = (uint8_t)((rgb[i] * (brightness + 1)) >> 8);
+    }
+
+    if (quiet) return;
+    int64_t now = hal_time_us();
+    if (now - led_echo_us < ECHO_INTERVAL_US || memcmp(led_fb, led_shown, led_count * 3) == 0) {
+        return;
+    }
+    memcpy(led_shown, led_fb, led_count * 3);
+    led_echo_us = now;
+
+    // Full-scale colours so dim frames stay visible in a terminal
+    fprintf(stderr, "[LED] ");
+    for (size_t i = 0; i < led_count; i++) {
+        const uint8_t *c = &rgb[i * 3];
+        fprintf(stderr, "\x1b[38;2;%u;%u;%um●", c[0], c[1], c[2]);
+    }
+    fprintf(stderr, "\x1b[0m\n");
+}
+
+const uint8_t *hal_linux_leds(size_t *count) {
+    if (count) *count = led_count;
+    return led_fb;
+}
+
+// ============================================================================
+// NVS
+// ============================================================================
+
+typedef struct {
+    bool used;
+    char ns[NVS_MAX_KEY];
+    char key[NVS_MAX_KEY];
+    uint32_t len;
+    uint8_t data[NVS_MAX_BLOB];
+} nvs_entry_t;
+
+static nvs_entry_t nvs[NVS_MAX_ENTRIES];
+static pthread_mutex_t nvs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void nvs_save(void) {
+    const char *path = getenv("HAL_NVS_FILE");
+    if (path == NULL) return;
+
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "wb");
+    if (f == NULL) return;
+    for (int i = 0; i < NVS_MAX_ENTRIES; i++) {
+        if (!nvs[i].used) continue;
+        fwrite(nvs[i].ns, 1, NVS_MAX_KEY, f);
+        fwrite(nvs[i].key, 1, NVS_MAX_KEY, f);
+        fwrite(&nvs[i].len, sizeof(nvs[i].len), 1, f);
+        fwrite(nvs[i].data, 1, nvs[i].len, f);
+    }
+    fclose(f);
+    rename(tmp, path);          // Atomic, like an NVS commit
+}
+
+static void nvs_load(void) {
+    const char *path = getenv("HAL_NVS_FILE");
+    FILE *f = path ? fopen(path, "rb") : NULL;
+    if (f == NULL) return;
+    for (int i = 0; i < NVS_MAX_ENTRIES; i++) {
+        nvs_entry_t *e = &nvs[i];
+        if (fread(e->ns, 1, NVS_MAX_KEY, f) != NVS_MAX_KEY ||
+            fread(e->key, 1, NVS_MAX_KEY, f) != NVS_MAX_KEY ||
+            fread(&e->len, sizeof(e->len), 1, f) != 1 || e->len > NVS_MAX_BLOB ||
+            fread(e->data, 1, e->len, f) != e->len) {
+            memset(e, 0, sizeof(*e));
+            break;
+        }
+        e->ns[NVS_MAX_KEY - 1] = e->key[NVS_MAX_KEY - 1] = '\0';
+        e->used = true;
+    }
+    fclose(f);
+}
+
+static nvs_entry_t *nvs_find(const char *ns, const char *key) {
+    for (int i = 0; i < NVS_MAX_ENTRIES; i++) {
+        if (nvs[i].used && strcmp(nvs[i].ns, ns) == 0 && strcmp(nvs[i].key, key) == 0) {
+            return &nvs[i];
+        }
+    }
+    return NULL;
+}
+
+bool hal_nvs_init(void) {
+    static bool loaded = false;
+    pthread_mutex_lock(&nvs_lock);
+    if (!loaded) {
+        nvs_load();
+        loaded = true;
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return true;
+}
+
+bool hal_nvs_get(const char *ns, const char *key, void *buf, size_t *len) {
+    pthread_mutex_lock(&nvs_lock);
+    nvs_entry_t *e = nvs_find(ns, key);
+    bool ok = e != NULL && e->len <= *len;
+    if (ok) {
+        memcpy(buf, e->data, e->len);
+    }
+    if (e != NULL) *len = e->len;
+    pthread_mutex_unlock(&nvs_lock);
+    return ok;
+}
+
+bool hal_nvs_set(const char *ns, const char *key, const void *data, size_t len) {
+    if (strlen(ns) >= NVS_MAX_KEY || strlen(key) >= NVS_MAX_KEY || len > NVS_MAX_BLOB) {
+        return false;
+    }
+    pthread_mutex_lock(&nvs_lock);
+    nvs_entry_t *e = nvs_find(ns, key);
+    for (int i = 0; e == NULL && i < NVS_MAX_ENTRIES; i++) {
+        if (!nvs[i].used) e = &nvs[i];
+    }
+    if (e != NULL) {
+        e->used = true;
+        snprintf(e->ns, sizeof(e->ns), "%s", ns);
+        snprintf(e->key, sizeof(e->key), "%s", key);
+        e->len = (uint32_t)len;
+        memcpy(e->data, data, len);
+        nvs_save();
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return e != NULL;
+}
+
+bool hal_nvs_erase(const char *ns, const char *key) {
+    pthread_mutex_lock(&nvs_lock);
+    nvs_entry_t *e = nvs_find(ns, key);
+    if (e != NULL) {
+        e->used = false;
+        nvs_save();
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return true;
+}
+
+// ============================================================================
+// GPIO CONTROL PTY
+// ============================================================================
+
+static void gpio_command(char *line) {
+    int pin, level, ms;
+    if (sscanf(line, "%d=%d", &pin, &level) == 2) {
+        hal_linux_gpio_inject(pin, level);
+    } else if (sscanf(line, "pulse %d %d", &pin, &ms) == 2) {
+        hal_linux_gpio_inject(pin, 0);
+        hal_delay_ms((uint32_t)ms);
+        hal_linux_gpio_inject(pin, 1);
+    } else if (line[0] != '\0') {
+        fprintf(stderr, "[hal] gpio: expected '<pin>=<0|1>' or 'pulse <pin> <ms>'\n");
+    }
+}
+
+static void *gpio_thread(void *arg) {
+    int fd = *(int *)arg;
+    char line[64];
+    size_t len = 0;
+
+    for (;;) {
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        if (poll(&pfd, 1, -1) <= 0) continue;
+        uint8_t buf[64];
+        ssize_t n = read(fd, buf, sizeof(buf));
+        for (ssize_t i = 0; i < n; i++) {
+            if (buf[i] == '\n' || buf[i] == '\r') {
+                line[len] = '\0';
+                gpio_command(line);
+                len = 0;
+            } else if (len < sizeof(line) - 1) {
+                line[len++] = (char)buf[i];
+            }
+        }
+    }
+    return NULL;
+}
+
+// ============================================================================
+// INIT
+// ============================================================================
+
+void hal_linux_init(int argc, char **argv) {
+    static int gpio_fd = -1;
+
+    hal_time_us();                  // Boot time = now
+    pty_dir = getenv("HAL_PTY_DIR");
+    quiet = getenv("HAL_QUIET") != NULL && strcmp(getenv("HAL_QUIET"), "0") != 0;
+
+    const char *run_ms = getenv("HAL_RUN_MS");
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--run-ms") == 0 && i + 1 < argc) {
+            run_ms = argv[++i];
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            quiet = true;
+        }
+    }
+    if (run_ms != NULL) {
+        run_until_us = (int64_t)strtoll(run_ms, NULL, 10) * 1000;
+    }
+
+    // Inputs idle high (buttons have pull-ups) until configured otherwise
+    for (int i = 0; i < GPIO_COUNT; i++) {
+        pins[i].level = 1;
+    }
+
+    char path[64];
+    gpio_fd = open_pty(path, sizeof(path), "gpio");
+    if (gpio_fd >= 0) {
+        pthread_t th;
+        pthread_create(&th, NULL, gpio_thread, &gpio_fd);
+        pthread_detach(th);
+    }
+
+    hal_nvs_init();
+}
+
+bool hal_linux_running(void) {
+    return run_until_us == 0 || hal_time_us() < run_until_us;
+}
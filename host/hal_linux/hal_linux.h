@@ -0,0 +1,75 @@
+/**
+ * @file hal_linux.h
+ * @brief Linux backend of src/hal.h - extra controls for host runs
+ *
+ * Peripherals:
+ * - UART0      = this process's stdin / stdout (the sketch console)
+ * - UART1..2   = pseudo-terminals; the slave path is printed at open and,
+ *                with HAL_PTY_DIR set, symlinked as $HAL_PTY_DIR/uartN.
+ *                Connect the FluidNC simulator, a real adapter via socat,
+ *                or a terminal (picocom / screen) to it.
+ * - GPIO       = virtual pin array. Inputs are driven through the "gpio"
+ *                pty ($HAL_PTY_DIR/gpio) with lines such as
+ *                    35=0          drive pin 35 low
+ *                    pulse 13 120  pull pin 13 low for 120 ms, then release
+ *                or from code with hal_linux_gpio_inject(). Edge ISRs fire
+ *                on the thread that changed the pin.
+ * - LCD / LEDs = in-memory framebuffers, echoed to stderr when they change
+ *                (rate-limited; HAL_QUIET=1 or --quiet to silence)
+ * - NVS        = in memory; persisted to $HAL_NVS_FILE when set
+ *
+ * Environment / arguments:
+ *   --run-ms N  or HAL_RUN_MS=N     stop after N ms (CI-style runs)
+ *   --quiet     or HAL_QUIET=1      no LCD / LED echo
+ *   HAL_LCD_ADDR=0x3F               address the virtual LCD answers on
+ *   HAL_FLASH_DIR=DIR               flash partitions kept as DIR/<label>.bin (esp_partition.h)
+ */
+
+#ifndef HAL_LINUX_H
+#define HAL_LINUX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hal.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Parse arguments / environment and start the GPIO control pty
+ */
+void hal_linux_init(int argc, char **argv);
+
+/**
+ * @brief false once --run-ms has elapsed
+ */
+bool hal_linux_running(void);
+
+/**
+ * @brief Slave path of a UART pty ("" for the console or unopened ports)
+ */
+const char *hal_linux_uart_path(int port);
+
+/**
+ * @brief Drive a virtual input pin and fire its edge ISR
+ */
+void hal_linux_gpio_inject(int pin, int level);
+
+/**
+ * @brief Current LCD text, one row (NUL-terminated, padded to the width)
+ */
+const char *hal_linux_lcd_row(int row);
+
+/**
+ * @brief Last frame sent to the LED strip (count x {r, g, b}, brightness applied)
+ */
+const uint8_t *hal_linux_leds(size_t *count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HAL_LINUX_H
@@ -0,0 +1,204 @@
+/**
+ * @file estop_model.cpp
+ * @brief Firmware e-stop path replayed in virtual time (see estop_model.h)
+ */
+
+#include "estop_model.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "fluidnc_sim/uart_link.h"
+#include "fluidnc_status.h"
+#include "safety_latency.h"
+
+// Mirrors estop.h
+#define ESTOP_HOLD_TIMEOUT_MS   500
+#define ESTOP_STATUS_POLL_MS    20
+#define ESTOP_DRAIN_TIMEOUT_MS  1000
+#define UART_FIFO_LEN           128     // ESP32 UART hardware TX FIFO
+
+#define RUN_TIMEOUT_US          3000000 // Give up on a trace after 3 s
+#define RESET_SETTLE_US         300000  // Watch for motion this long after Ctrl-X
+
+// Deterministic jitter so runs are repeatable
+static uint32_t rngState = 0x12345678u;
+
+static uint32_t rng(uint32_t range) {
+    rngState ^= rngState << 13;
+    rngState ^= rngState >> 17;
+    rngState ^= rngState << 5;
+    return range ? rngState % range : 0;
+}
+
+const std::vector<EstopScenario> &estopScenarios() {
+    static const std::vector<EstopScenario> scenarios = {
+        {"idle", "Machine idle, nothing queued",
+         SimConfig::rodentUart(), 0.0f, 0, 1000, 5,
+         500, 0, 8000},
+        {"pump_run", "Pump running at 150 mm/min, event-driven RX",
+         SimConfig::rodentUart(), 150.0f, 0, 1000, 5,
+         500, 10000, 70000},
+        {"fifo_backlog", "Pump running, up to 200 bytes of G-code queued (FIFO full)",
+         SimConfig::rodentUart(), 150.0f, 200, 1000, 5,
+         12000, 30000, 85000},
+        {"fast_axis", "btt_rodent_fluidnc.yaml rates, 3000 mm/min, no auto-report",
+         SimConfig::rodentFluidnc(), 3000.0f, 0, 1000, 5,
+         500, 8000, 320000},
+        {"idle_backlog", "Machine idle, job just queued: FIFO + 512-byte TX ring of moves",
+         SimConfig::rodentUart(), 0.0f, 640, 1000, 5,
+         12000, 45000, 50000},
+        {"loop_50ms", "test_17 loop (delay(50)) reading the UART",
+         SimConfig::rodentUart(), 150.0f, 0, 50000, 5,
+         500, 65000, 140000},
+    };
+    return scenarios;
+}
+
+const EstopScenario *findEstopScenario(const char *name) {
+    for (const EstopScenario &sc : estopScenarios()) {
+        if (strcmp(sc.name, name) == 0) return &sc;
+    }
+    return nullptr;
+}
+
+void estopModelSeed(uint32_t seed) {
+    rngState = seed ? seed : 0x12345678u;
+}
+
+bool runEstopOnce(const EstopScenario &sc, float *movedAfterResetMm) {
+    FluidncSim sim(sc.sim);
+    UartLink toSim(115200);
+    UartLink toEsp(115200);
+    std::string rxLine;
+
+    int64_t t = 0;
+    const int64_t loopPhase = rng(sc.loopPeriodUs);
+    const int64_t triggerUs = 300000 + loopPhase + rng(100000);
+
+    // Start a long move so the trigger lands mid-motion
+    if (sc.feedMmMin > 0.0f) {
+        char cmd[48];
+        snprintf(cmd, sizeof(cmd), "G91 G1 X500 F%.0f\n", sc.feedMmMin);
+        toSim.send(cmd, t);
+    }
+
+    bool triggered = false;
+    bool holdSent = false;          // ESTOP_STATE_HOLD_SENT
+    bool holdComplete = false;
+    bool rehold = false;
+    int64_t lastPollUs = 0;
+    int64_t resetDueUs = -1;        // Ctrl-X acted on by FluidNC
+    float resetPos = 0.0f;
+    bool resetPosTaken = false;
+
+    auto pumpLinks = [&](int64_t now) {
+        uint8_t b;
+        int64_t at;
+        while (toSim.receive(now, b, &at)) {
+            sim.receive(b, at);
+        }
+        sim.advance(now);
+        SimOutput out;
+        while (sim.popOutput(out)) {
+            toEsp.send(out.line + "\r\n", out.atUs);
+        }
+    };
+
+    auto fifoInsert = [&](const std::string &bytes, int64_t now) {
+        size_t backlog = toSim.inFlightBytes(now);
+        if (backlog > UART_FIFO_LEN) backlog = UART_FIFO_LEN;
+        return toSim.insert(backlog, bytes, now);
+    };
+
+    while (t < triggerUs + RUN_TIMEOUT_US) {
+        // Next loop iteration, unless the ISR fires first
+        int64_t k = t >= loopPhase ? (t - loopPhase) / sc.loopPeriodUs + 1 : 0;
+        int64_t next = k * sc.loopPeriodUs + loopPhase;
+
+        if (!triggered && triggerUs <= next) {
+            pumpLinks(triggerUs);
+
+            // G-code the sender had queued just before the press. Idle: the
+            // start of a job, relative moves so any that run show as travel.
+            uint32_t backlog = sc.backlogBytes ? sc.backlogBytes / 2 + rng(sc.backlogBytes / 2 + 1) : 0;
+            const char *line = sc.feedMmMin > 0.0f ? "G1 X0.01\n" : "G91 G1 X1 F150\n";
+            std::string filler;
+            while (filler.size() < backlog) filler += line;
+            if (!filler.empty()) toSim.send(filler, triggerUs);
+
+            // ISR: edge -> stamp -> "!?" into the HW FIFO
+            int64_t isrUs = triggerUs + 1 + rng(sc.isrEntryMaxUs);
+            safety_latency_begin(triggerUs);
+            int64_t holdOnWire = fifoInsert("!", isrUs);
+            fifoInsert("?", isrUs);
+            safety_latency_mark(SAFETY_STAGE_ISR, isrUs + 2);
+            safety_latency_mark(SAFETY_STAGE_WIRE, holdOnWire);
+
+            triggered = true;
+            holdSent = true;
+            lastPollUs = isrUs;
+            t = triggerUs;
+            continue;
+        }
+
+        t = next;
+        pumpLinks(t);
+
+        // Sketch loop: read every complete line that has arrived
+        uint8_t b;
+        while (toEsp.receive(t, b)) {
+            if (b == '\n') {
+                if (triggered) {
+                    fluidnc_status_t st;
+                    if (fluidnc_status_parse(rxLine.c_str(), &st)) {
+                        if ((st.state == FLUIDNC_STATE_HOLD && st.substate == 0) ||
+                            st.state == FLUIDNC_STATE_ALARM || st.state == FLUIDNC_STATE_IDLE) {
+                            holdComplete = true;
+                        } else if (holdSent && (st.state == FLUIDNC_STATE_RUN ||
+                                                st.state == FLUIDNC_STATE_JOG)) {
+                            holdComplete = false;       // A drained line started a move
+                            rehold = true;
+                        }
+                    }
+                    safety_latency_on_status(rxLine.c_str(), t);
+                }
+                rxLine.clear();
+            } else if (b != '\r') {
+                rxLine.push_back((char)b);
+            }
+        }
+
+        // Once Ctrl-X has been acted on, nothing may move any more
+        if (resetDueUs >= 0 && t >= resetDueUs) {
+            if (!resetPosTaken) {
+                resetPos = sim.position(0);
+                resetPosTaken = true;
+            } else if (t >= resetDueUs + RESET_SETTLE_US && !safety_latency_active()) {
+                if (movedAfterResetMm) *movedAfterResetMm = std::fabs(sim.position(0) - resetPos);
+                return true;
+            }
+        }
+
+        // estop_service(): poll '?' until Hold:0 and the TX ring has drained, then Ctrl-X
+        if (holdSent) {
+            if (rehold) {
+                fifoInsert("!", t);
+                rehold = false;
+            }
+            bool ready = holdComplete || t - triggerUs >= (int64_t)ESTOP_HOLD_TIMEOUT_MS * 1000;
+            bool drained = toSim.inFlightBytes(t) == 0 ||
+                           t - triggerUs >= (int64_t)ESTOP_DRAIN_TIMEOUT_MS * 1000;
+            if (ready && drained) {
+                resetDueUs = fifoInsert("\x18", t) + sc.sim.realtimeLatencyUs;
+                holdSent = false;
+            } else if (t - lastPollUs >= (int64_t)ESTOP_STATUS_POLL_MS * 1000) {
+                fifoInsert("?", t);
+                lastPollUs = t;
+            }
+        }
+    }
+    return false;
+}
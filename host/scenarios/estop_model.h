@@ -0,0 +1,57 @@
+/**
+ * @file estop_model.h
+ * @brief Firmware e-stop path replayed in virtual time against FluidncSim
+ *
+ *   STOP edge -> ISR writes "!?" into the TX FIFO (behind its backlog)
+ *   -> UART wire -> FluidNC simulator -> status lines back over the wire
+ *   -> ESP32 loop reads them -> safety_latency_on_status()
+ *
+ * Feeds the real firmware modules (safety_latency.c, fluidnc_status.c,
+ * latency_hist.c) exactly as estop.c does on the target; results land in
+ * the safety_latency histograms. Used by the scenario suite and the
+ * benchmark.
+ */
+
+#ifndef ESTOP_MODEL_H
+#define ESTOP_MODEL_H
+
+#include <cstdint>
+#include <vector>
+
+#include "fluidnc_sim/fluidnc_sim.h"
+
+struct EstopScenario {
+    const char *name;
+    const char *description;
+    SimConfig sim;
+    float feedMmMin;            // Move in progress at trigger (0 = machine idle)
+    uint32_t backlogBytes;      // G-code queued in the ESP32 TX path at trigger (max)
+    uint32_t loopPeriodUs;      // How often the sketch loop reads UART / runs estop_service()
+    uint32_t isrEntryMaxUs;     // Edge -> first ISR instruction (jittered 1..max)
+    // p99 budgets in us from the STOP edge; 0 = stage not expected
+    uint32_t budgetWire;
+    uint32_t budgetHold;
+    uint32_t budgetStopped;
+};
+
+/** The scenario table (budgets are p99 from the STOP edge) */
+const std::vector<EstopScenario> &estopScenarios();
+
+const EstopScenario *findEstopScenario(const char *name);
+
+/**
+ * @brief Restart the jitter sequence (trigger time, ISR entry, backlog)
+ */
+void estopModelSeed(uint32_t seed);
+
+/**
+ * @brief One e-stop, start to STOPPED and past Ctrl-X, with jittered
+ *        trigger time, ISR entry and FIFO backlog
+ * @param movedAfterResetMm Travel in the RESET_SETTLE_US after FluidNC
+ *        acted on Ctrl-X; non-zero means G-code still queued in the TX
+ *        path ran after the reset (optional)
+ * @return false if the trace never completed
+ */
+bool runEstopOnce(const EstopScenario &sc, float *movedAfterResetMm = nullptr);
+
+#endif // ESTOP_MODEL_H
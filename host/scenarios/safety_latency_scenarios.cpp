@@ -0,0 +1,88 @@
+/**
+ * @file safety_latency_scenarios.cpp
+ * @brief Host scenario suite: e-stop latency against the FluidNC simulator
+ *
+ * Replays the firmware e-stop path in virtual time (estop_model.h):
+ *   STOP edge -> ISR writes "!?" into the TX FIFO (behind its backlog)
+ *   -> UART wire -> FluidNC simulator -> status lines back over the wire
+ *   -> ESP32 loop reads them -> safety_latency_on_status()
+ * and feeds the real firmware modules (safety_latency.c, fluidnc_status.c,
+ * latency_hist.c) exactly as estop.c does on the target. Each scenario
+ * runs many times with jittered trigger time, ISR entry and FIFO backlog;
+ * the p99 of every stage is checked against a budget, and no run may move
+ * the machine after FluidNC has acted on the Ctrl-X.
+ *
+ * Exit code is non-zero if any budget is exceeded or anything moved after the reset, so the suite can gate
+ * a commit or a deployment.
+ *
+ * Build & run:
+ *   pio run -e host_safety_latency -t exec
+ *   (program args: [runs-per-scenario], default 200)
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include "estop_model.h"
+#include "latency_hist.h"
+#include "safety_latency.h"
+
+#define RESET_MOVE_TOL_MM   0.001f   // Leftover G-code ran after the reset
+
+static bool checkBudget(const char *stage, const latency_hist_t *h, uint32_t budget, uint32_t runs) {
+    if (budget == 0) {
+        return true;
+    }
+    uint32_t p99 = latency_hist_percentile(h, 99.0f);
+    bool ok = h->count == runs && p99 <= budget;
+    printf("  %-8s p99 %7lu us  budget %7lu us  %s\n", stage, (unsigned long)p99,
+           (unsigned long)budget, ok ? "PASS" : (h->count == runs ? "FAIL" : "FAIL (missing samples)"));
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    uint32_t runs = argc > 1 ? (uint32_t)strtoul(argv[1], nullptr, 10) : 200;
+    if (runs == 0) runs = 1;
+
+    printf("\n╔════════════════════════════════════════════════════════════╗\n");
+    printf("║        Safety Latency Scenarios (FluidNC simulator)        ║\n");
+    printf("╚════════════════════════════════════════════════════════════╝\n");
+    printf("%lu runs per scenario, 115200 baud\n", (unsigned long)runs);
+
+    bool allOk = true;
+    for (const EstopScenario &sc : estopScenarios()) {
+        safety_latency_reset();
+        uint32_t incomplete = 0;
+        uint32_t movedRuns = 0;
+        float movedMaxMm = 0.0f;
+        for (uint32_t i = 0; i < runs; i++) {
+            float moved = 0.0f;
+            if (!runEstopOnce(sc, &moved)) incomplete++;
+            if (moved > RESET_MOVE_TOL_MM) movedRuns++;
+            if (moved > movedMaxMm) movedMaxMm = moved;
+        }
+
+        printf("\n[%s] %s\n", sc.name, sc.description);
+        for (int s = SAFETY_STAGE_ISR; s < SAFETY_STAGE_COUNT; s++) {
+            char label[24];
+            snprintf(label, sizeof(label), "  EDGE->%s", safety_stage_name((safety_stage_t)s));
+            latency_hist_print(label, safety_latency_hist((safety_stage_t)s));
+        }
+        if (incomplete) {
+            printf("  %lu runs never reached STOPPED\n", (unsigned long)incomplete);
+        }
+
+        bool ok = incomplete == 0;
+        ok &= checkBudget("WIRE", safety_latency_hist(SAFETY_STAGE_WIRE), sc.budgetWire, runs);
+        ok &= checkBudget("HOLD", safety_latency_hist(SAFETY_STAGE_HOLD), sc.budgetHold, runs);
+        ok &= checkBudget("STOPPED", safety_latency_hist(SAFETY_STAGE_STOPPED), sc.budgetStopped, runs);
+        printf("  %-8s max %7.3f mm  %lu runs moved after Ctrl-X  %s\n", "RESET", movedMaxMm,
+               (unsigned long)movedRuns, movedRuns == 0 ? "PASS" : "FAIL");
+        ok &= movedRuns == 0;
+        allOk &= ok;
+    }
+
+    printf("\n%s\n", allOk ? "✓ All safety latency budgets met" : "✗ Safety latency budget exceeded");
+    return allOk ? 0 : 1;
+}
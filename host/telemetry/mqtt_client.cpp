@@ -0,0 +1,279 @@
+/**
+ * @file mqtt_client.cpp
+ * @brief MQTT 3.1.1 packets over a non-blocking TCP socket
+ */
+
+#include "mqtt_client.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+
+#define RETRY_MS        2000
+#define TX_LIMIT        (64 * 1024)     // Queued bytes before publish() refuses
+
+enum : uint8_t {
+    PKT_CONNECT = 1,
+    PKT_CONNACK = 2,
+    PKT_PUBLISH = 3,
+    PKT_PUBACK = 4,
+    PKT_SUBSCRIBE = 8,
+    PKT_SUBACK = 9,
+    PKT_PINGREQ = 12,
+    PKT_PINGRESP = 13,
+};
+
+static void putLength(std::string &out, size_t len) {
+    do {
+        uint8_t b = len % 128;
+        len /= 128;
+        if (len > 0) b |= 0x80;
+        out.push_back((char)b);
+    } while (len > 0);
+}
+
+static void putString(std::string &out, const std::string &s) {
+    out.push_back((char)(s.size() >> 8));
+    out.push_back((char)(s.size() & 0xFF));
+    out += s;
+}
+
+MqttClient::MqttClient(const std::string &host, uint16_t port, const std::string &clientId, uint16_t keepaliveS)
+    : host_(host), port_(port), clientId_(clientId), keepaliveS_(keepaliveS) {}
+
+MqttClient::~MqttClient() {
+    if (fd_ >= 0) close(fd_);
+}
+
+// ============================================================================
+// CONNECTION
+// ============================================================================
+
+void MqttClient::fail(int64_t nowMs, const char *why) {
+    if (verbose || state_ == State::Connected) fprintf(stderr, "mqtt: %s\n", why);
+    if (fd_ >= 0) close(fd_);
+    fd_ = -1;
+    state_ = State::Idle;
+    tx_.clear();
+    rx_.clear();
+    retryAtMs_ = nowMs + RETRY_MS;
+}
+
+void MqttClient::disconnect(int64_t nowMs) {
+    fail(nowMs, "connection dropped");
+}
+
+void MqttClient::startConnect(int64_t nowMs) {
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *res = nullptr;
+    char port[8];
+    snprintf(port, sizeof(port), "%u", (unsigned)port_);
+    if (getaddrinfo(host_.c_str(), port, &hints, &res) != 0 || res == nullptr) {
+        fail(nowMs, "cannot resolve broker");
+        return;
+    }
+    fd_ = socket(res->ai_family, res->ai_socktype, 0);
+    if (fd_ < 0) {
+        freeaddrinfo(res);
+        fail(nowMs, "socket failed");
+        return;
+    }
+    fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) | O_NONBLOCK);
+    int one = 1;
+    setsockopt(fd_, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    int rc = connect(fd_, res->ai_addr, res->ai_addrlen);
+    freeaddrinfo(res);
+    if (rc < 0 && errno != EINPROGRESS) {
+        fail(nowMs, "connect failed");
+        return;
+    }
+    state_ = State::Connecting;
+    retryAtMs_ = nowMs + RETRY_MS;              // Connect + CONNACK deadline
+}
+
+void MqttClient::sendConnect() {
+    std::string body;
+    putString(body, "MQTT");
+    body.push_back(4);                          // Protocol level 3.1.1
+    body.push_back(0x02);                       // Clean session
+    body.push_back((char)(keepaliveS_ >> 8));
+    body.push_back((char)(keepaliveS_ & 0xFF));
+    putString(body, clientId_);
+    tx_.push_back((char)(PKT_CONNECT << 4));
+    putLength(tx_, body.size());
+    tx_ += body;
+    state_ = State::WaitConnack;
+}
+
+// ============================================================================
+// I/O
+// ============================================================================
+
+bool MqttClient::flush() {
+    while (!tx_.empty()) {
+        ssize_t n = send(fd_, tx_.data(), tx_.size(), MSG_NOSIGNAL);
+        if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+        tx_.erase(0, (size_t)n);
+        lastSendMs_ = nowMs_;
+    }
+    return true;
+}
+
+bool MqttClient::receive() {
+    char buf[2048];
+    for (;;) {
+        ssize_t n = recv(fd_, buf, sizeof(buf), 0);
+        if (n == 0) return false;               // Broker closed
+        if (n < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return false;
+        }
+        rx_.append(buf, (size_t)n);
+    }
+
+    // Whole packets only: fixed header, remaining length, body
+    for (;;) {
+        size_t len = 0;
+        size_t pos = 1;
+        int shift = 0;
+        for (;;) {
+            if (pos >= rx_.size()) return true;
+            uint8_t b = (uint8_t)rx_[pos++];
+            len |= (size_t)(b & 0x7F) << shift;
+            shift += 7;
+            if (!(b & 0x80)) break;
+            if (shift > 21) return false;
+        }
+        if (rx_.size() < pos + len) return true;
+        if (!handlePacket((uint8_t)rx_[0], (const uint8_t *)rx_.data() + pos, len)) return false;
+        rx_.erase(0, pos + len);
+    }
+}
+
+bool MqttClient::handlePacket(uint8_t header, const uint8_t *body, size_t len) {
+    uint8_t type = header >> 4;
+    switch (type) {
+        case PKT_CONNACK:
+            if (len < 2 || body[1] != 0) {
+                fprintf(stderr, "mqtt: connection refused (code %d)\n", len >= 2 ? body[1] : -1);
+                return false;
+            }
+            state_ = State::Connected;
+            fprintf(stderr, "mqtt: connected to %s:%u\n", host_.c_str(), (unsigned)port_);
+            if (!filters_.empty()) sendSubscribe();
+            return true;
+        case PKT_PUBACK:
+            if (len >= 2 && onAck) onAck((body[0] << 8) | body[1]);
+            return true;
+        case PKT_PUBLISH: {
+            uint8_t qos = (header >> 1) & 0x03;
+            if (len < 2) return false;
+            size_t topicLen = (size_t)(body[0] << 8 | body[1]);
+            size_t pos = 2 + topicLen + (qos > 0 ? 2 : 0);
+            if (pos > len) return false;
+            if (qos == 1) {
+                tx_.push_back((char)(PKT_PUBACK << 4));
+                tx_.push_back(2);
+                tx_.append((const char *)body + 2 + topicLen, 2);
+            }
+            if (onMessage) onMessage(std::string((const char *)body + 2, topicLen), body + pos, len - pos);
+            return true;
+        }
+        case PKT_SUBACK:
+        case PKT_PINGRESP:
+            return true;
+        default:
+            if (verbose) fprintf(stderr, "mqtt: ignored packet type %u\n", (unsigned)type);
+            return true;
+    }
+}
+
+// ============================================================================
+// API
+// ============================================================================
+
+void MqttClient::poll(int64_t nowMs) {
+    nowMs_ = nowMs;
+    if (state_ == State::Idle) {
+        if (nowMs < retryAtMs_) return;
+        startConnect(nowMs);
+        if (state_ == State::Idle) return;
+    }
+
+    if (state_ == State::Connecting) {
+        struct pollfd p = {fd_, POLLOUT, 0};
+        if (::poll(&p, 1, 0) <= 0) {
+            if (nowMs >= retryAtMs_) fail(nowMs, "connect timed out");
+            return;
+        }
+        int err = 0;
+        socklen_t errLen = sizeof(err);
+        getsockopt(fd_, SOL_SOCKET, SO_ERROR, &err, &errLen);
+        if (err != 0) {
+            fail(nowMs, "broker not reachable");
+            return;
+        }
+        sendConnect();
+    }
+
+    if (state_ == State::WaitConnack && nowMs >= retryAtMs_) {
+        fail(nowMs, "no CONNACK");
+        return;
+    }
+    if (state_ == State::Connected && keepaliveS_ > 0 && nowMs - lastSendMs_ >= keepaliveS_ * 500) {
+        tx_.push_back((char)(PKT_PINGREQ << 4));
+        tx_.push_back(0);
+    }
+    if (!flush()) {
+        fail(nowMs, "send failed");
+        return;
+    }
+    if (!receive()) fail(nowMs, "connection lost");
+}
+
+void MqttClient::subscribe(const std::string &filter) {
+    filters_.push_back(filter);
+    if (state_ == State::Connected) sendSubscribe();
+}
+
+void MqttClient::sendSubscribe() {
+    std::string body;
+    uint16_t id = nextId_;
+    nextId_ = nextId_ == 0xFFFF ? 1 : nextId_ + 1;
+    body.push_back((char)(id >> 8));
+    body.push_back((char)(id & 0xFF));
+    for (const std::string &f : filters_) {
+        putString(body, f);
+        body.push_back(0);                      // QoS 0
+    }
+    tx_.push_back((char)((PKT_SUBSCRIBE << 4) | 0x02));
+    putLength(tx_, body.size());
+    tx_ += body;
+}
+
+int MqttClient::publish(const std::string &topic, const char *payload, size_t len) {
+    if (state_ != State::Connected || tx_.size() > TX_LIMIT) return -1;
+    uint16_t id = nextId_;
+    nextId_ = nextId_ == 0xFFFF ? 1 : nextId_ + 1;
+
+    tx_.push_back((char)((PKT_PUBLISH << 4) | 0x02));      // QoS 1
+    putLength(tx_, 2 + topic.size() + 2 + len);
+    putString(tx_, topic);
+    tx_.push_back((char)(id >> 8));
+    tx_.push_back((char)(id & 0xFF));
+    tx_.append(payload, len);
+    if (verbose) fprintf(stderr, "mqtt: PUBLISH %u %s (%zu bytes)\n", (unsigned)id, topic.c_str(), len);
+    return id;
+}
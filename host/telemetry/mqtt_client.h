@@ -0,0 +1,72 @@
+/**
+ * @file mqtt_client.h
+ * @brief Minimal non-blocking MQTT 3.1.1 client for host tools
+ *
+ * Just what telemetry_transport_t and the telemetry bridge need, so host
+ * runs talk to a real broker (mosquitto) the way esp-mqtt does on the target:
+ *   CONNECT (clean session), PUBLISH QoS 1 + PUBACK, SUBSCRIBE QoS 0,
+ *   incoming PUBLISH (QoS 0/1), PINGREQ, reconnect.
+ * No TLS. Nothing blocks: poll() connects, flushes and reads; publish()
+ * only queues bytes.
+ */
+
+#ifndef HOST_MQTT_CLIENT_H
+#define HOST_MQTT_CLIENT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class MqttClient {
+public:
+    MqttClient(const std::string &host, uint16_t port, const std::string &clientId, uint16_t keepaliveS = 30);
+    ~MqttClient();
+
+    /** Connect / reconnect, send queued bytes, handle incoming packets; call often */
+    void poll(int64_t nowMs);
+
+    /** Queue a QoS 1 PUBLISH; message id, or -1 if not connected or the send buffer is full */
+    int publish(const std::string &topic, const char *payload, size_t len);
+
+    /** Add a topic filter (QoS 0); (re)subscribed after every connect */
+    void subscribe(const std::string &filter);
+
+    bool connected() const { return state_ == State::Connected; }
+
+    /** Drop the connection (as a WiFi loss would); reconnects after the retry delay */
+    void disconnect(int64_t nowMs);
+
+    std::function<void(int msgId)> onAck;
+    std::function<void(const std::string &topic, const uint8_t *payload, size_t len)> onMessage;
+    bool verbose = false;
+
+private:
+    enum class State { Idle, Connecting, WaitConnack, Connected };
+
+    void startConnect(int64_t nowMs);
+    void sendConnect();
+    bool flush();
+    bool receive();
+    bool handlePacket(uint8_t header, const uint8_t *body, size_t len);
+    void sendSubscribe();
+    void fail(int64_t nowMs, const char *why);
+
+    std::string host_;
+    uint16_t port_;
+    std::string clientId_;
+    uint16_t keepaliveS_;
+
+    int fd_ = -1;
+    State state_ = State::Idle;
+    int64_t retryAtMs_ = 0;
+    int64_t lastSendMs_ = 0;
+    int64_t nowMs_ = 0;
+    uint16_t nextId_ = 1;
+    std::string tx_;
+    std::string rx_;
+    std::vector<std::string> filters_;
+};
+
+#endif // HOST_MQTT_CLIENT_H
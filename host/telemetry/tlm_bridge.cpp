@@ -0,0 +1,217 @@
+/**
+ * @file tlm_bridge.cpp
+ * @brief Status stream bridge: binary tlm_codec.h frames from MQTT -> InfluxDB line protocol
+ *
+ * Subscribes to <prefix>/status/+ and writes one line per sample to stdout,
+ * for Telegraf's execd input (data_format = "influx") or any tool that
+ * reads line protocol:
+ *
+ *   station_status,device_id=pump-01,state=DOSING,machine=Run
+ *       weight_g=1234.56,dosed_g=3.21,target_g=10,pump=1i,fault=0i 1761830400123000000
+ *
+ * Frames without a set clock (SNTP not synced yet) are placed so that their
+ * last sample lands at the arrival time. Statistics go to stderr: frames,
+ * samples, frames lost (frame_seq gaps), and the binary size next to what
+ * the same samples would have cost as the JSON of the other topics.
+ *
+ *   tlm_bridge [options]
+ *     --broker HOST:PORT   MQTT broker (127.0.0.1:1883)
+ *     --prefix P           topic prefix (factory)
+ *     --stats-s N          print statistics every N s (60, 0 = at exit only)
+ *     --seconds N          run time, 0 = until killed (0)
+ *     -v                   log MQTT traffic
+ */
+
+#include <signal.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "fluidnc_status.h"
+#include "mqtt_client.h"
+#include "tlm_codec.h"
+
+struct Options {
+    std::string host = "127.0.0.1";
+    uint16_t port = 1883;
+    std::string prefix = "factory";
+    int statsS = 60;
+    int seconds = 0;
+    bool verbose = false;
+};
+
+struct Stats {
+    uint64_t frames = 0;
+    uint64_t samples = 0;
+    uint64_t lost = 0;              // frame_seq gaps
+    uint64_t bad = 0;               // Wrong schema, truncated
+    uint64_t binaryBytes = 0;
+    uint64_t jsonBytes = 0;         // Same samples as a JSON array
+};
+
+static volatile sig_atomic_t stop = 0;
+
+static void onSignal(int) {
+    stop = 1;
+}
+
+static int64_t monoMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int64_t unixMs() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [--broker HOST:PORT] [--prefix P] [--stats-s N] [--seconds N] [-v]\n", prog);
+}
+
+static bool parseArgs(int argc, char **argv, Options &o) {
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (a == "--broker" && hasValue) {
+            std::string b = argv[++i];
+            size_t colon = b.rfind(':');
+            o.host = b.substr(0, colon);
+            if (colon != std::string::npos) o.port = (uint16_t)atoi(b.c_str() + colon + 1);
+        } else if (a == "--prefix" && hasValue) {
+            o.prefix = argv[++i];
+        } else if (a == "--stats-s" && hasValue) {
+            o.statsS = atoi(argv[++i]);
+        } else if (a == "--seconds" && hasValue) {
+            o.seconds = atoi(argv[++i]);
+        } else if (a == "-v") {
+            o.verbose = true;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+/** Tag value: commas, spaces and '=' escaped */
+static std::string tagValue(const std::string &s) {
+    std::string out;
+    for (char c : s) {
+        if (c == ',' || c == ' ' || c == '=') out.push_back('\\');
+        out.push_back(c);
+    }
+    return out;
+}
+
+/** Length of one sample as the JSON style of src/telemetry.c would encode it */
+static size_t jsonLength(const std::string &device, const tlm_status_t &s, bool clock) {
+    char buf[256];
+    int n = snprintf(buf, sizeof(buf),
+                     "%s\"device_id\":\"%s\",\"state\":\"%s\",\"machine\":\"%s\",\"pump\":%u,"
+                     "\"weight_g\":%.2f,\"dosed_g\":%.2f,\"target_g\":%.2f,\"fault\":%u}",
+                     clock ? "{\"timestamp\":1761830400.123," : "{", device.c_str(),
+                     tlm_codec_state_name(s.state), fluidnc_state_name((fluidnc_state_t)s.machine),
+                     (unsigned)s.pump + 1, (double)s.weight_g, (double)s.dosed_g, (double)s.target_g,
+                     (unsigned)s.fault);
+    return n > 0 ? (size_t)n + 1 : 0;           // + the comma between array elements
+}
+
+static void printStats(const Stats &st) {
+    double ratio = st.binaryBytes > 0 ? (double)st.jsonBytes / (double)st.binaryBytes : 0.0;
+    fprintf(stderr,
+            "tlm_bridge: %llu frames, %llu samples, %llu lost, %llu bad; %llu bytes binary "
+            "(%.1f B/sample) vs %llu as JSON: %.1fx smaller\n",
+            (unsigned long long)st.frames, (unsigned long long)st.samples, (unsigned long long)st.lost,
+            (unsigned long long)st.bad, (unsigned long long)st.binaryBytes,
+            st.samples > 0 ? (double)st.binaryBytes / (double)st.samples : 0.0, (unsigned long long)st.jsonBytes,
+            ratio);
+}
+
+int main(int argc, char **argv) {
+    Options o;
+    if (!parseArgs(argc, argv, o)) {
+        usage(argv[0]);
+        return 2;
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    char clientId[48];
+    snprintf(clientId, sizeof(clientId), "tlm-bridge-%d", (int)getpid());
+    MqttClient mqtt(o.host, o.port, clientId);
+    mqtt.verbose = o.verbose;
+
+    Stats st;
+    std::map<std::string, uint32_t> nextFrame;      // Per device
+    const std::string statusPrefix = o.prefix + "/status/";
+
+    mqtt.onMessage = [&](const std::string &topic, const uint8_t *payload, size_t len) {
+        if (topic.compare(0, statusPrefix.size(), statusPrefix) != 0) return;
+        std::string device = topic.substr(statusPrefix.size());
+
+        tlm_codec_decoder_t d;
+        if (!tlm_codec_open(&d, payload, len)) {
+            st.bad++;
+            fprintf(stderr, "tlm_bridge: %s: not a schema %d frame (%zu bytes)\n", device.c_str(),
+                    TLM_CODEC_SCHEMA, len);
+            return;
+        }
+        std::vector<tlm_status_t> samples;
+        tlm_status_t s;
+        while (tlm_codec_next(&d, &s)) samples.push_back(s);
+        if (d.error) {
+            st.bad++;
+            fprintf(stderr, "tlm_bridge: %s: frame %u truncated after %zu samples\n", device.c_str(),
+                    (unsigned)d.frame_seq, samples.size());
+        }
+
+        auto it = nextFrame.find(device);
+        if (it != nextFrame.end() && d.frame_seq != it->second) {
+            // A restarted device begins at 0 again: only forward gaps count
+            if ((int32_t)(d.frame_seq - it->second) > 0) st.lost += d.frame_seq - it->second;
+        }
+        nextFrame[device] = d.frame_seq + 1;
+        st.frames++;
+        st.binaryBytes += len;
+        st.jsonBytes += 2;                      // [ ]
+
+        bool clock = d.flags & TLM_CODEC_FLAG_CLOCK;
+        int64_t shift = clock || samples.empty() ? 0 : unixMs() - samples.back().time_ms;
+        std::string tags = "station_status,device_id=" + tagValue(device);
+        for (const tlm_status_t &r : samples) {
+            printf("%s,state=%s,machine=%s weight_g=%.2f,dosed_g=%.2f,target_g=%.2f,pump=%ui,fault=%ui %lld\n",
+                   tags.c_str(), tlm_codec_state_name(r.state),
+                   fluidnc_state_name((fluidnc_state_t)r.machine), (double)r.weight_g, (double)r.dosed_g,
+                   (double)r.target_g, (unsigned)r.pump + 1, (unsigned)r.fault,
+                   (long long)((r.time_ms + shift) * 1000000));
+            st.samples++;
+            st.jsonBytes += jsonLength(device, r, clock);
+        }
+        fflush(stdout);
+    };
+    mqtt.subscribe(statusPrefix + "+");
+
+    int64_t start = monoMs();
+    int64_t nextStats = start + (int64_t)o.statsS * 1000;
+    while (!stop) {
+        int64_t now = monoMs();
+        if (o.seconds > 0 && now - start >= (int64_t)o.seconds * 1000) break;
+        mqtt.poll(now);
+        if (o.statsS > 0 && now >= nextStats) {
+            nextStats += (int64_t)o.statsS * 1000;
+            printStats(st);
+        }
+        usleep(10000);
+    }
+    printStats(st);
+    return 0;
+}
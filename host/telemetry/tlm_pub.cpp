@@ -0,0 +1,244 @@
+/**
+ * @file tlm_pub.cpp
+ * @brief src/telemetry.c against a real MQTT broker, fed with synthetic doses
+ *
+ * Runs the firmware's telemetry path unchanged - RAM queues, the "tlmq"
+ * flash outbox (host esp_partition), batching, QoS 1 acks - with the host
+ * MqttClient as transport. Every dose also goes through dose_stats.h: the
+ * synthetic pumps overshoot by 0.05 g more per pump, and dosing/accuracy
+ * shows the correction taking it out. Stop the broker or type "drop" to watch samples
+ * pile up in the outbox and replay in order once the broker is back; with
+ * HAL_FLASH_DIR set the outbox also survives a restart of this program.
+ *
+ *   tlm_pub [options]
+ *     --broker HOST:PORT   MQTT broker (127.0.0.1:1883)
+ *     --device ID          device_id field and client id (pump-host)
+ *     --prefix P           topic prefix (factory)
+ *     --dose-ms N          one synthetic dose every N ms (1000)
+ *     --status-ms N        status stream sample period, 0 = off (50)
+ *     --seconds N          run time, 0 = until "quit" (0)
+ *     -v                   log MQTT traffic
+ *
+ * Commands on stdin: "drop" (close the connection), "stats", "quit".
+ *
+ *   mosquitto_sub -h 127.0.0.1 -t 'factory/#' -v
+ */
+
+#include <poll.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "dose_stats.h"
+#include "fluidnc_status.h"
+#include "mqtt_client.h"
+#include "telemetry.h"
+
+struct Options {
+    std::string host = "127.0.0.1";
+    uint16_t port = 1883;
+    std::string device = "pump-host";
+    std::string prefix = "factory";
+    int doseMs = 1000;
+    int statusMs = 50;
+    int seconds = 0;
+    bool verbose = false;
+};
+
+static int64_t monoMs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int64_t unixMs() {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "usage: %s [--broker HOST:PORT] [--device ID] [--prefix P] [--dose-ms N]\n"
+            "          [--status-ms N] [--seconds N] [-v]\n", prog);
+}
+
+static bool parseArgs(int argc, char **argv, Options &o) {
+    for (int i = 1; i < argc; i++) {
+        std::string a = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (a == "--broker" && hasValue) {
+            std::string b = argv[++i];
+            size_t colon = b.rfind(':');
+            o.host = b.substr(0, colon);
+            if (colon != std::string::npos) o.port = (uint16_t)atoi(b.c_str() + colon + 1);
+        } else if (a == "--device" && hasValue) {
+            o.device = argv[++i];
+        } else if (a == "--prefix" && hasValue) {
+            o.prefix = argv[++i];
+        } else if (a == "--dose-ms" && hasValue) {
+            o.doseMs = atoi(argv[++i]);
+        } else if (a == "--status-ms" && hasValue) {
+            o.statusMs = atoi(argv[++i]);
+        } else if (a == "--seconds" && hasValue) {
+            o.seconds = atoi(argv[++i]);
+        } else if (a == "-v") {
+            o.verbose = true;
+        } else {
+            return false;
+        }
+    }
+    return o.doseMs > 0 && o.statusMs >= 0;
+}
+
+// ============================================================================
+// TRANSPORT
+// ============================================================================
+
+static int transportPublish(void *ctx, const char *topic, const char *payload, size_t len) {
+    return static_cast<MqttClient *>(ctx)->publish(topic, payload, len);
+}
+
+static bool transportConnected(void *ctx) {
+    return static_cast<MqttClient *>(ctx)->connected();
+}
+
+static void printStats(const telemetry_t &t) {
+    telemetry_stats_t s;
+    telemetry_get_stats(&t, &s);
+    printf("pushed %u  published %u  acked %u msgs / %u samples  pending %u  resent %u  "
+           "dropped %u+%u  coalesced %u  damaged %u\n",
+           (unsigned)s.pushed, (unsigned)s.published, (unsigned)s.acked, (unsigned)s.samples_acked,
+           (unsigned)s.pending, (unsigned)s.resent, (unsigned)s.dropped_queue, (unsigned)s.dropped_store,
+           (unsigned)s.coalesced, (unsigned)s.damaged);
+    printf("status: %u samples  %u frames  %u bytes  dropped %u\n", (unsigned)s.status_samples,
+           (unsigned)s.status_frames, (unsigned)s.status_bytes, (unsigned)s.status_dropped);
+    fflush(stdout);
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main(int argc, char **argv) {
+    Options o;
+    if (!parseArgs(argc, argv, o)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    MqttClient mqtt(o.host, o.port, o.device);
+    mqtt.verbose = o.verbose;
+
+    static telemetry_t tlm;
+    static const char *const recipes[] = {"manual", "Nutrient Mix", "Cleaning"};
+    telemetry_config_t cfg = {};
+    cfg.device_id = o.device.c_str();
+    cfg.topic_prefix = o.prefix.c_str();
+    cfg.chemicals[0] = "Chemical X";
+    cfg.chemicals[1] = "Chemical Y";
+    cfg.chemicals[2] = "Chemical Z";
+    cfg.chemicals[3] = "Chemical A";
+    cfg.recipes = recipes;
+    cfg.recipe_count = sizeof(recipes) / sizeof(recipes[0]);
+    cfg.clock_ms = unixMs;
+    telemetry_transport_t io = {transportPublish, transportConnected, &mqtt};
+    telemetry_init(&tlm, &cfg, &io, "tlmq");
+    mqtt.onAck = [](int msgId) { telemetry_on_ack(&tlm, msgId); };
+    printf("outbox: %s, %u samples pending, next seq %u\n", tlm.have_store ? "tlmq" : "none",
+           (unsigned)(tlm.have_store ? tlm_store_pending(&tlm.store) : 0), (unsigned)tlm.next_seq);
+
+    // Synthetic production: recipe 1 doses pumps 0..3 as one batch, then a pause
+    float remaining[TELEMETRY_PUMPS] = {5000.0f, 5000.0f, 5000.0f, 5000.0f};
+    const float capacity = 5000.0f;
+    int64_t start = monoMs();
+    int64_t nextDose = start;
+    int64_t nextStats = start + 5000;
+    int64_t nextStatus = start;
+    int step = 0;
+    uint32_t rng = 12345;
+    static dose_stats_t stats;
+    dose_stats_init(&stats, nullptr, nullptr);
+    bool stdinOpen = true;
+
+    for (;;) {
+        int64_t now = monoMs();
+        if (o.seconds > 0 && now - start >= (int64_t)o.seconds * 1000) break;
+
+        while (now >= nextDose) {
+            nextDose += o.doseMs;
+            int pump = step % 5;                // 0..3 dose, 4 = idle slot between batches
+            if (pump == 0) telemetry_push_batch(&tlm, TELEMETRY_BATCH_START, 1, 4);
+            if (pump < 4) {
+                rng = rng * 1103515245u + 12345u;
+                float target = 10.0f + (float)pump * 5.0f;
+                char axis = "XYZA"[pump];
+                float setpoint = dose_stats_setpoint(&stats, axis, cfg.chemicals[pump], target);
+                float overshoot = 0.05f * (float)(pump + 1) + ((float)((rng >> 16) % 200) - 100.0f) / 1000.0f;
+                float actual = setpoint + overshoot;
+                telemetry_push_dose(&tlm, (uint8_t)pump, 1, target, actual, (uint32_t)(target * 400.0f));
+                dose_stats_summary_t sum;
+                dose_stats_summary(&stats, dose_stats_record(&stats, axis, cfg.chemicals[pump], target, setpoint,
+                                                             actual, (uint32_t)(target * 400000.0f), now * 1000),
+                                   &sum);
+                telemetry_accuracy_t acc = {sum.doses, sum.mean_error_g, sum.sd_error_g, sum.correction_g,
+                                            sum.mean_time_s};
+                telemetry_push_accuracy(&tlm, (uint8_t)pump, &acc);
+                remaining[pump] = std::fmax(0.0f, remaining[pump] - actual);
+                telemetry_push_inventory(&tlm, (uint8_t)pump, remaining[pump], capacity);
+                if (pump == 3) telemetry_push_batch(&tlm, TELEMETRY_BATCH_COMPLETE, 1, 4);
+            }
+            step++;
+        }
+
+        // Status stream: the dose of the current slot ramps up over 80 % of it
+        while (o.statusMs > 0 && now >= nextStatus) {
+            int64_t slotStart = nextDose - o.doseMs;
+            int pump = (step + 4) % 5;          // Slot the last dose was pushed for
+            float progress = std::fmin(1.0f, (float)(nextStatus - slotStart) / (0.8f * (float)o.doseMs));
+            float target = pump < 4 ? 10.0f + (float)pump * 5.0f : 0.0f;
+            float total = 0.0f;
+            for (int p = 0; p < TELEMETRY_PUMPS; p++) total += capacity - remaining[p];
+            tlm_status_t st = {};
+            st.time_ms = nextStatus;
+            st.dosed_g = target * progress;
+            st.target_g = target;
+            st.weight_g = 250.0f + total - target + st.dosed_g;     // Container on the scale
+            st.state = pump < 4 && progress < 1.0f ? TLM_STATE_DOSING : TLM_STATE_IDLE;
+            st.machine = pump < 4 && progress < 1.0f ? FLUIDNC_STATE_RUN : FLUIDNC_STATE_IDLE;
+            st.pump = (uint8_t)(pump < 4 ? pump : 0);
+            telemetry_push_status(&tlm, &st);
+            nextStatus += o.statusMs;
+        }
+
+        mqtt.poll(now);
+        telemetry_service(&tlm, now);
+        mqtt.poll(now);
+
+        if (now >= nextStats) {
+            nextStats += 5000;
+            printStats(tlm);
+        }
+
+        struct pollfd in = {stdinOpen ? STDIN_FILENO : -1, POLLIN, 0};
+        if (::poll(&in, 1, 20) > 0) {
+            char line[64];
+            if (fgets(line, sizeof(line), stdin) == nullptr) {
+                stdinOpen = false;
+                if (o.seconds == 0) break;
+                continue;
+            }
+            if (strncmp(line, "quit", 4) == 0) break;
+            if (strncmp(line, "drop", 4) == 0) mqtt.disconnect(now);
+            if (strncmp(line, "stats", 5) == 0) printStats(tlm);
+        }
+    }
+    printStats(tlm);
+    return 0;
+}
@@ -0,0 +1,123 @@
+/**
+ * @file app_config.h
+ * @brief Task layout of the production firmware: cores, priorities, stacks, periods
+ *
+ * All tuning of the task architecture lives here so latency budgets can be
+ * reviewed in one place.
+ *
+ * CORE ASSIGNMENT:
+ *   PRO_CPU (core 0): comms, control, scale, UI, web, telemetry (+ WiFi/BT
+ *                     stack, esp_timer task, httpd task)
+ *   APP_CPU (core 1): safety only - nothing else is pinned there, so the
+ *                     e-stop path never waits behind application work. The
+ *                     safety task also installs the GPIO ISR service, which
+ *                     puts the STOP edge ISR on core 1 as well.
+ *
+ * PRIORITIES (configMAX_PRIORITIES = 25, idle = 0):
+ *   safety > comms > control > scale > UI > web / httpd > telemetry
+ *   Comms sits above control so FluidNC responses are never left in the
+ *   UART driver while control is busy; UI, web and telemetry only ever see
+ *   snapshots and may lag without affecting dosing.
+ */
+
+#ifndef APP_CONFIG_H
+#define APP_CONFIG_H
+
+// ============================================================================
+// CORES
+// ============================================================================
+#define APP_CORE_MAIN           0
+#define APP_CORE_SAFETY         1
+
+// ============================================================================
+// PRIORITIES
+// ============================================================================
+#define APP_PRIO_SAFETY         20
+#define APP_PRIO_COMMS          15
+#define APP_PRIO_CONTROL        12
+#define APP_PRIO_SCALE          10
+#define APP_PRIO_UI             5
+#define APP_PRIO_WEB            4       // Web task and the httpd task (net_web.h)
+#define APP_PRIO_TELEMETRY      3
+
+// ============================================================================
+// STACKS (bytes - ESP-IDF StackType_t is uint8_t)
+// ============================================================================
+#define APP_STACK_SAFETY        3072
+#define APP_STACK_COMMS         4096
+#define APP_STACK_CONTROL       4096
+#define APP_STACK_SCALE         3072
+#define APP_STACK_UI            3072
+#define APP_STACK_WEB           2560
+#define APP_STACK_HTTPD         4608    // httpd task: WebSocket frames, page, push
+#define APP_STACK_TELEMETRY     6144    // printf of the task table, telemetry batch + JSON
+
+// ============================================================================
+// PERIODS (CONFIG_FREERTOS_HZ = 1000, see sdkconfig.defaults)
+// ============================================================================
+#define SAFETY_PERIOD_MS        2       // estop_service() / status drain
+#define COMMS_READ_TIMEOUT_MS   2       // Longest wait in uart_read_bytes()
+#define CONTROL_PERIOD_MS       10      // Upper bound; woken early by queue pushes
+// Scale: SCALE_GAP_MS / SCALE_READING_MS in scale_weight.h (the protocol sets the pace)
+#define UI_PERIOD_MS            50
+#define STATUS_STREAM_PERIOD_MS 50      // Weight / state stream to telemetry (20 Hz)
+#define WEB_PUSH_PERIOD_MS      100     // Dashboard frames to browsers
+#define TELEMETRY_PERIOD_MS     1000
+#define TASK_MONITOR_PERIOD_MS  10000   // Stack / CPU table
+
+// ============================================================================
+// QUEUE DEPTHS (power of two - spsc_ring.h)
+// ============================================================================
+#define Q_DEPTH_STATUS          8       // comms -> control, comms -> safety
+#define Q_DEPTH_RESPONSE        8       // comms -> control
+#define Q_DEPTH_GCODE           8       // control -> comms
+#define Q_DEPTH_SCALE           8       // scale -> control
+#define Q_DEPTH_COMMAND         8       // UI -> control, httpd -> control
+
+// ============================================================================
+// UART
+// ============================================================================
+#define APP_UART_RX_BUFFER      1024
+#define APP_UART_TX_BUFFER      512
+
+// ============================================================================
+// DOSING DEFAULTS (UI START without a recipe)
+// ============================================================================
+#define APP_DEFAULT_DOSE_G      10.0f
+#define APP_DEFAULT_FLOW_ML_MIN 7.5f
+#define APP_ML_PER_MM           0.05f   // Tube calibration, as in the test sketches
+#define APP_FLOW_CONTROL        1       // Hold g/s with feed overrides (flow_control.h); 0 = feed only
+#define APP_JOG_MM_PER_DETENT   0.5f    // Encoder prime, slow turning (jog_stream.h)
+#define APP_JOG_MAX_FEED_MM_MIN 600.0f  // Also capped by each axis' max rate read at boot
+#define APP_CONFIG_RETRY_MS     5000    // FluidNC limits discovery failed: ask again (fluidnc_config.h)
+#define APP_DOSE_SETTLE_MS      1500    // Scale settling after a dose before it is scored (dose_stats.h)
+#define APP_DOSE_BIAS_CORRECTION 1      // Next move corrected by the pump's mean offset; 0 = figures only
+
+// ============================================================================
+// NETWORK / MQTT TELEMETRY (net_mqtt.h; override with -D at build time)
+// ============================================================================
+#ifndef APP_WIFI_SSID
+#define APP_WIFI_SSID           ""      // Empty: no network, telemetry waits in flash
+#endif
+#ifndef APP_WIFI_PASSWORD
+#define APP_WIFI_PASSWORD       ""
+#endif
+#ifndef APP_MQTT_URI
+#define APP_MQTT_URI            "mqtt://mosquitto.local:1883"
+#endif
+#ifndef APP_DEVICE_ID
+#define APP_DEVICE_ID           "pump-01"
+#endif
+#define APP_MQTT_TOPIC_PREFIX   "factory"
+#define APP_MQTT_KEEPALIVE_S    30
+#define APP_SNTP_SERVER         "pool.ntp.org"
+#define APP_CHEMICALS           {"Chemical X", "Chemical Y", "Chemical Z", "Chemical A"}    // Per pump
+
+// ============================================================================
+// WEB DASHBOARD (net_web.h; started with the network)
+// ============================================================================
+#define WEB_MAX_SOCKETS         6       // Browsers + page loads (<= CONFIG_LWIP_MAX_SOCKETS - 3)
+#define WEB_SEND_TIMEOUT_S      2       // A send blocked longer drops the client
+#define WEB_RX_MAX              128     // Longest browser message
+
+#endif // APP_CONFIG_H
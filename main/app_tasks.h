@@ -0,0 +1,270 @@
+/**
+ * @file app_tasks.h
+ * @brief Task entry points, inter-task messages and queues
+ *
+ * DATA FLOW:
+ *
+ *              q_gcode                     q_status_safety
+ *   control ------------> comms ---------------------------> safety
+ *      ^  ^  <------------  |    (every status line)          (core 1)
+ *      |  |   q_status_ctrl |
+ *      |  |   q_response    |
+ *      |  +-- q_scale ---- scale
+ *      +----- q_command -- UI  <-- snapshot_ui ---+
+ *      +-- q_command_web - httpd                  |
+ *                    web <-- snapshot_web --------+ control
+ *            telemetry <-- snapshot_telemetry ----+
+ *
+ * Every queue is an spsc_ring (lock-free, bounded, fixed-size messages)
+ * with exactly one producer task and one consumer task. A push wakes the
+ * consumer with a task notification; consumers also wake on their own
+ * period, so a missed notification costs at most one period. A full
+ * queue drops the new message and counts it (see task_monitor).
+ *
+ * Snapshots are not queued: each reader has a one-slot snapshot_box_t
+ * that control overwrites, so a slow reader skips states instead of
+ * showing old ones.
+ */
+
+#ifndef APP_TASKS_H
+#define APP_TASKS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "event_log.h"
+#include "fluidnc_status.h"
+#include "spsc_ring.h"
+#include "telemetry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// QUEUES
+// ============================================================================
+
+typedef struct {
+    spsc_ring_t ring;
+    const char *name;
+    TaskHandle_t consumer;      // Set by the consumer with app_queue_bind()
+    uint32_t high_water;        // Deepest fill seen by the producer
+} app_queue_t;
+
+/**
+ * @brief Consumer side: register the calling task for wake-ups
+ */
+static inline void app_queue_bind(app_queue_t *q) {
+    q->consumer = xTaskGetCurrentTaskHandle();
+}
+
+/**
+ * @brief Producer side: push and wake the consumer
+ * @return false if the queue was full (message dropped and counted)
+ */
+static inline bool app_queue_send(app_queue_t *q, const void *msg) {
+    bool ok = spsc_ring_push(&q->ring, msg);
+    uint32_t depth = spsc_ring_count(&q->ring);
+    if (depth > q->high_water) q->high_water = depth;
+    TaskHandle_t consumer = q->consumer;
+    if (consumer != NULL) {
+        xTaskNotifyGive(consumer);
+    }
+    return ok;
+}
+
+static inline bool app_queue_receive(app_queue_t *q, void *msg) {
+    return spsc_ring_pop(&q->ring, msg);
+}
+
+// ============================================================================
+// MESSAGES
+// ============================================================================
+
+#define APP_LINE_MAX    96          // Longest FluidNC line kept
+
+/** comms -> control / safety: one status report */
+typedef struct {
+    int64_t t_us;                   // Line complete (esp_timer)
+    fluidnc_status_t status;        // Parsed
+    char line[APP_LINE_MAX];        // Raw, for estop_on_status_line()
+} status_msg_t;
+
+typedef enum {
+    RESPONSE_OK = 0,
+    RESPONSE_ERROR,                 // error:N
+    RESPONSE_ALARM,                 // ALARM:N
+    RESPONSE_BANNER,                // Grbl ... after a reset
+    RESPONSE_OTHER,                 // [MSG:...], $ output, ...
+} response_kind_t;
+
+/** comms -> control: every non-status line */
+typedef struct {
+    int64_t t_us;
+    response_kind_t kind;
+    int16_t code;                   // error / alarm number
+    char line[APP_LINE_MAX];
+} response_msg_t;
+
+/** control -> comms: one G-code line (without terminator) */
+typedef struct {
+    char line[64];
+} gcode_msg_t;
+
+/** scale -> control */
+typedef struct {
+    int64_t t_us;
+    float grams;
+} scale_msg_t;
+
+typedef enum {
+    COMMAND_DOSE = 0,               // pump, grams, flow
+    COMMAND_STOP,                   // Feed hold, abandon the dose
+    COMMAND_RESUME,                 // Cycle start after a hold
+    COMMAND_RESET,                  // Clear e-stop, Ctrl-X, $X
+    COMMAND_JOG,                    // pump, detents (encoder prime; idle only)
+    COMMAND_JOG_END,                // Stop jogging, back to idle
+} command_kind_t;
+
+/** UI / httpd -> control */
+typedef struct {
+    command_kind_t kind;
+    char pump;                      // 'X' 'Y' 'Z' 'A'
+    float grams;
+    float flow_ml_min;
+    int16_t detents;                // COMMAND_JOG: encoder turn since the last one
+} command_msg_t;
+
+typedef enum {
+    CONTROL_IDLE = 0,
+    CONTROL_DOSING,
+    CONTROL_HOLD,                   // Feed hold (operator or flow fault)
+    CONTROL_ESTOP,                  // E-stop latched
+} control_state_t;
+
+/** control -> UI / web / telemetry: latest system state */
+typedef struct {
+    int64_t t_us;
+    control_state_t state;
+    fluidnc_state_t machine;
+    float pos[4];
+    float scale_g;
+    char pump;                      // Active / selected pump
+    float dose_target_g;
+    float dosed_g;                  // Scale delta since the dose started
+    uint8_t flow_fault_code;        // 0 = none (flow_monitor.h)
+    uint32_t doses_completed;
+    bool jogging;                   // Encoder prime active (state stays IDLE)
+} snapshot_msg_t;
+
+extern app_queue_t q_status_control;
+extern app_queue_t q_status_safety;
+extern app_queue_t q_response;
+extern app_queue_t q_gcode;
+extern app_queue_t q_scale;
+extern app_queue_t q_command;
+extern app_queue_t q_command_web;
+
+// ============================================================================
+// SNAPSHOT BOXES
+// ============================================================================
+
+#define SNAPSHOT_BOX_TRIES  4       // Reads torn by a publish before giving up this period
+
+/**
+ * control -> one reader: the latest snapshot, overwritten in place (seqlock).
+ * A ring would drop the newest snapshot once a slow reader fell behind.
+ */
+typedef struct {
+    snapshot_msg_t slot;
+    uint32_t seq;                   // Odd while control is writing the slot
+    uint32_t taken;                 // Reader side: seq of the last snapshot taken
+    TaskHandle_t consumer;          // Set by the reader with snapshot_box_bind()
+} snapshot_box_t;
+
+/**
+ * @brief Reader side: register the calling task for wake-ups
+ */
+static inline void snapshot_box_bind(snapshot_box_t *box) {
+    box->consumer = xTaskGetCurrentTaskHandle();
+}
+
+/**
+ * @brief Producer side: replace the snapshot and wake the reader
+ */
+static inline void snapshot_box_publish(snapshot_box_t *box, const snapshot_msg_t *snap) {
+    uint32_t seq = box->seq;
+    __atomic_store_n(&box->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&box->slot, snap, sizeof(*snap));
+    __atomic_store_n(&box->seq, seq + 2, __ATOMIC_RELEASE);
+    TaskHandle_t consumer = box->consumer;
+    if (consumer != NULL) {
+        xTaskNotifyGive(consumer);
+    }
+}
+
+/**
+ * @brief Reader side: copy the snapshot if it changed since the last take
+ * @return false if nothing new (or every try was torn by a publish; *out untouched)
+ */
+static inline bool snapshot_box_take(snapshot_box_t *box, snapshot_msg_t *out) {
+    for (int i = 0; i < SNAPSHOT_BOX_TRIES; i++) {
+        uint32_t seq = __atomic_load_n(&box->seq, __ATOMIC_ACQUIRE);
+        if (seq == box->taken) return false;
+        if (seq & 1) continue;
+        snapshot_msg_t copy;
+        memcpy(&copy, &box->slot, sizeof(copy));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&box->seq, __ATOMIC_RELAXED) == seq) {
+            box->taken = seq;
+            *out = copy;
+            return true;
+        }
+    }
+    return false;
+}
+
+extern snapshot_box_t snapshot_ui;
+extern snapshot_box_t snapshot_web;
+extern snapshot_box_t snapshot_telemetry;
+
+/** Persistent event log ("evlog" partition): any task appends, telemetry writes it to flash */
+extern event_log_t app_event_log;
+
+/** MQTT telemetry ("tlmq" outbox): control pushes, telemetry services */
+extern telemetry_t app_telemetry;
+
+// ============================================================================
+// TASKS
+// ============================================================================
+
+/** One row of the task table in main.c */
+typedef struct {
+    const char *name;
+    TaskFunction_t entry;
+    uint32_t stack_bytes;
+    UBaseType_t priority;
+    BaseType_t core;
+    TaskHandle_t handle;            // Filled in by app_main()
+} app_task_def_t;
+
+void safety_task(void *arg);        // arg: TaskHandle_t to notify once the e-stop is armed
+void comms_task(void *arg);
+void control_task(void *arg);
+void scale_task(void *arg);
+void ui_task(void *arg);
+void web_task(void *arg);
+void telemetry_task(void *arg);
+
+const char *control_state_name(control_state_t state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // APP_TASKS_H
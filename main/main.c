@@ -1,25 +1,174 @@
 /**
  * @file main.c
- * @brief Main application placeholder
+ * @brief Production application: pinned FreeRTOS tasks
  *
- * This is the main component required by ESP-IDF.
- * For Phase 1 testing, we use separate test environments.
+ * The test sketches run everything from one Arduino loop() with delays in
+ * between. Here each concern is its own task with a fixed core, priority
+ * and stack (app_config.h), and tasks only talk through bounded lock-free
+ * queues and one-slot snapshot boxes (app_tasks.h):
  *
- * This file will be populated in Phase 7 with the complete application.
+ *   Task       Core  Prio  Owns
+ *   safety       1    20   STOP ISR, e-stop state machine
+ *   comms        0    15   FluidNC UART (lines in, G-code out)
+ *   control      0    12   Dosing state, flow supervision
+ *   scale        0    10   Scale UART
+ *   ui           0     5   Buttons, display frame
+ *   web          0     4   Dashboard state for the httpd task (net_web.h)
+ *   telemetry    0     3   State line, task / queue table, MQTT outbox
+ *
+ * Start-up order: event log, telemetry outbox, NVS -> UART drivers -> safety
+ * (arms the e-stop on core 1) -> everything else -> WiFi / MQTT -> web
+ * server. Nothing can send G-code before STOP is live, and the network
+ * comes up last.
+ *
+ * Build (ESP-IDF):
+ *   idf.py build flash monitor
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "driver/uart.h"
+#include "esp_log.h"
+
+#include "app_config.h"
+#include "app_tasks.h"
+#include "hal.h"
+#include "net_mqtt.h"
+#include "net_web.h"
+#include "pin_definitions.h"
+#include "task_monitor.h"
+
+static const char *TAG = "MAIN";
+
+// ============================================================================
+// QUEUES
+// ============================================================================
+
+#define APP_QUEUE_DEFINE(q, type, depth)                \
+    static type q##_storage[depth];                     \
+    app_queue_t q = {.name = #q}
+
+APP_QUEUE_DEFINE(q_status_control, status_msg_t, Q_DEPTH_STATUS);
+APP_QUEUE_DEFINE(q_status_safety, status_msg_t, Q_DEPTH_STATUS);
+APP_QUEUE_DEFINE(q_response, response_msg_t, Q_DEPTH_RESPONSE);
+APP_QUEUE_DEFINE(q_gcode, gcode_msg_t, Q_DEPTH_GCODE);
+APP_QUEUE_DEFINE(q_scale, scale_msg_t, Q_DEPTH_SCALE);
+APP_QUEUE_DEFINE(q_command, command_msg_t, Q_DEPTH_COMMAND);
+APP_QUEUE_DEFINE(q_command_web, command_msg_t, Q_DEPTH_COMMAND);
+
+#define APP_QUEUE_INIT(q) \
+    spsc_ring_init(&q.ring, q##_storage, sizeof(q##_storage[0]), sizeof(q##_storage) / sizeof(q##_storage[0]))
+
+snapshot_box_t snapshot_ui;
+snapshot_box_t snapshot_web;
+snapshot_box_t snapshot_telemetry;
+
+event_log_t app_event_log;
+telemetry_t app_telemetry;
+
+static app_queue_t *const queues[] = {
+    &q_status_control, &q_status_safety, &q_response, &q_gcode,
+    &q_scale, &q_command, &q_command_web,
+};
+
+// ============================================================================
+// TASK TABLE (safety first - see app_main)
+// ============================================================================
+
+static app_task_def_t tasks[] = {
+    {"safety",    safety_task,    APP_STACK_SAFETY,    APP_PRIO_SAFETY,    APP_CORE_SAFETY, NULL},
+    {"comms",     comms_task,     APP_STACK_COMMS,     APP_PRIO_COMMS,     APP_CORE_MAIN,   NULL},
+    {"control",   control_task,   APP_STACK_CONTROL,   APP_PRIO_CONTROL,   APP_CORE_MAIN,   NULL},
+    {"scale",     scale_task,     APP_STACK_SCALE,     APP_PRIO_SCALE,     APP_CORE_MAIN,   NULL},
+    {"ui",        ui_task,        APP_STACK_UI,        APP_PRIO_UI,        APP_CORE_MAIN,   NULL},
+    {"web",       web_task,       APP_STACK_WEB,       APP_PRIO_WEB,       APP_CORE_MAIN,   NULL},
+    {"telemetry", telemetry_task, APP_STACK_TELEMETRY, APP_PRIO_TELEMETRY, APP_CORE_MAIN,   NULL},
+};
+
+#define TASK_COUNT  (sizeof(tasks) / sizeof(tasks[0]))
+
+static void init_uart(int port, uint32_t baud, int tx_pin, int rx_pin) {
+    const hal_uart_config_t config = {
+        .baud = baud,
+        .tx_pin = tx_pin,
+        .rx_pin = rx_pin,
+        .rx_buffer = APP_UART_RX_BUFFER,
+        .tx_buffer = APP_UART_TX_BUFFER,
+    };
+    if (!hal_uart_open(port, &config)) {
+        ESP_LOGE(TAG, "UART%d open failed", port);
+        abort();
+    }
+}
+
+static void create_task(app_task_def_t *t, void *arg) {
+    BaseType_t ok = xTaskCreatePinnedToCore(t->entry, t->name, t->stack_bytes, arg,
+                                            t->priority, &t->handle, t->core);
+    if (ok != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create task %s", t->name);
+        abort();
+    }
+}
 
 void app_main(void) {
+    printf("\n========================================\n");
     printf("Peristaltic Pump System - Main Application\n");
-    printf("This is a placeholder. Use test environments for Phase 1:\n");
-    printf("  pio run -e test_00_blink -t upload -t monitor\n");
-    printf("  pio run -e test_01_buttons -t upload -t monitor\n");
-    printf("  pio run -e test_02_encoder -t upload -t monitor\n");
+    printf("========================================\n");
+
+    APP_QUEUE_INIT(q_status_control);
+    APP_QUEUE_INIT(q_status_safety);
+    APP_QUEUE_INIT(q_response);
+    APP_QUEUE_INIT(q_gcode);
+    APP_QUEUE_INIT(q_scale);
+    APP_QUEUE_INIT(q_command);
+    APP_QUEUE_INIT(q_command_web);
+
+    if (event_log_init(&app_event_log, "evlog")) {
+        ESP_LOGI(TAG, "Event log: %lu records, capacity %lu, boot %u",
+                 (unsigned long)event_log_count(&app_event_log),
+                 (unsigned long)event_log_capacity(&app_event_log), (unsigned)app_event_log.boot);
+    } else {
+        ESP_LOGW(TAG, "No \"evlog\" partition (partitions.csv) - events are not logged");
+    }
+
+    static const char *const recipes[] = {"manual"};
+    const telemetry_config_t tlm_config = {
+        .device_id = APP_DEVICE_ID,
+        .topic_prefix = APP_MQTT_TOPIC_PREFIX,
+        .chemicals = APP_CHEMICALS,
+        .recipes = recipes,
+        .recipe_count = sizeof(recipes) / sizeof(recipes[0]),
+        .clock_ms = net_mqtt_clock_ms,
+    };
+    telemetry_init(&app_telemetry, &tlm_config, net_mqtt_transport(), "tlmq");
+    if (app_telemetry.have_store) {
+        ESP_LOGI(TAG, "Telemetry outbox: %lu samples pending", (unsigned long)tlm_store_pending(&app_telemetry.store));
+    } else {
+        ESP_LOGW(TAG, "No \"tlmq\" partition (partitions.csv) - telemetry is lost while offline");
+    }
+
+    if (!hal_nvs_init()) {                      // Cached FluidNC limits (task_control)
+        ESP_LOGW(TAG, "NVS init failed - FluidNC limits are read with \"$$\" on every boot");
+    }
+
+    init_uart(RODENT_UART_NUM, RODENT_BAUD_RATE, RODENT_TX_PIN, RODENT_RX_PIN);
+    init_uart(SCALE_UART_NUM, SCALE_BAUD_RATE, SCALE_TX_PIN, SCALE_RX_PIN);
+
+    // Safety first, and wait until STOP is armed
+    create_task(&tasks[0], xTaskGetCurrentTaskHandle());
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    for (size_t i = 1; i < TASK_COUNT; i++) {
+        create_task(&tasks[i], NULL);
+    }
 
-    while(1) {
-        vTaskDelay(pdMS_TO_TICKS(1000));
+    task_monitor_init(tasks, TASK_COUNT, queues, sizeof(queues) / sizeof(queues[0]));
+    if (net_mqtt_start(&app_telemetry)) {
+        net_web_start();
     }
+    ESP_LOGI(TAG, "%u tasks running", (unsigned)TASK_COUNT);
+    task_monitor_report();
 }
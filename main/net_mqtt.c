@@ -0,0 +1,150 @@
+/**
+ * @file net_mqtt.c
+ * @brief WiFi station + esp-mqtt client behind telemetry_transport_t
+ */
+
+#include "net_mqtt.h"
+
+#include <string.h>
+#include <sys/time.h>
+
+#include "app_config.h"
+
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_sntp.h"
+#include "esp_wifi.h"
+#include "hal.h"
+#include "mqtt_client.h"
+
+static const char *TAG = "NET";
+
+static esp_mqtt_client_handle_t client = NULL;
+static telemetry_t *telemetry = NULL;
+static volatile bool mqtt_connected = false;
+static volatile bool clock_synced = false;
+
+// ============================================================================
+// TRANSPORT
+// ============================================================================
+
+static int mqtt_publish(void *ctx, const char *topic, const char *payload, size_t len) {
+    (void)ctx;
+    if (client == NULL) return -1;
+    // store = true: esp-mqtt keeps it until the PUBACK; -1 if its outbox is full
+    return esp_mqtt_client_enqueue(client, topic, payload, (int)len, 1, 0, true);
+}
+
+static bool mqtt_is_connected(void *ctx) {
+    (void)ctx;
+    return mqtt_connected;
+}
+
+static const telemetry_transport_t transport = {
+    .publish = mqtt_publish,
+    .connected = mqtt_is_connected,
+    .ctx = NULL,
+};
+
+const telemetry_transport_t *net_mqtt_transport(void) {
+    return &transport;
+}
+
+int64_t net_mqtt_clock_ms(void) {
+    if (!clock_synced) return 0;
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+// ============================================================================
+// EVENTS (esp-mqtt / WiFi / lwIP tasks)
+// ============================================================================
+
+static void mqtt_event(void *arg, esp_event_base_t base, int32_t id, void *data) {
+    (void)arg;
+    (void)base;
+    esp_mqtt_event_handle_t event = data;
+    switch ((esp_mqtt_event_id_t)id) {
+        case MQTT_EVENT_CONNECTED:
+            ESP_LOGI(TAG, "MQTT connected");
+            mqtt_connected = true;
+            break;
+        case MQTT_EVENT_DISCONNECTED:
+            ESP_LOGW(TAG, "MQTT disconnected");
+            mqtt_connected = false;
+            break;
+        case MQTT_EVENT_PUBLISHED:
+            if (telemetry != NULL) telemetry_on_ack(telemetry, event->msg_id);
+            break;
+        default:
+            break;
+    }
+}
+
+static void wifi_event(void *arg, esp_event_base_t base, int32_t id, void *data) {
+    (void)arg;
+    (void)data;
+    if (base == WIFI_EVENT && (id == WIFI_EVENT_STA_START || id == WIFI_EVENT_STA_DISCONNECTED)) {
+        esp_wifi_connect();                     // esp-mqtt reconnects on its own once IP is back
+    } else if (base == IP_EVENT && id == IP_EVENT_STA_GOT_IP) {
+        ESP_LOGI(TAG, "WiFi connected");
+    }
+}
+
+static void sntp_synced(struct timeval *tv) {
+    (void)tv;
+    clock_synced = true;
+}
+
+// ============================================================================
+// START
+// ============================================================================
+
+bool net_mqtt_start(telemetry_t *tlm) {
+    telemetry = tlm;
+    if (APP_WIFI_SSID[0] == '\0') {
+        ESP_LOGW(TAG, "APP_WIFI_SSID not set - telemetry stays offline (kept in flash)");
+        return false;
+    }
+    if (!hal_nvs_init()) {                      // WiFi keeps its calibration in NVS
+        ESP_LOGE(TAG, "NVS init failed");
+        return false;
+    }
+
+    ESP_ERROR_CHECK(esp_netif_init());
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+    esp_netif_create_default_wifi_sta();
+    wifi_init_config_t init = WIFI_INIT_CONFIG_DEFAULT();
+    ESP_ERROR_CHECK(esp_wifi_init(&init));
+    ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, wifi_event, NULL));
+    ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, wifi_event, NULL));
+
+    wifi_config_t wifi = {0};
+    strncpy((char *)wifi.sta.ssid, APP_WIFI_SSID, sizeof(wifi.sta.ssid));
+    strncpy((char *)wifi.sta.password, APP_WIFI_PASSWORD, sizeof(wifi.sta.password));
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi));
+    ESP_ERROR_CHECK(esp_wifi_start());
+
+    esp_sntp_setoperatingmode(ESP_SNTP_OPMODE_POLL);
+    esp_sntp_setservername(0, APP_SNTP_SERVER);
+    sntp_set_time_sync_notification_cb(sntp_synced);
+    esp_sntp_init();
+
+    const esp_mqtt_client_config_t mqtt = {
+        .broker.address.uri = APP_MQTT_URI,
+        .credentials.client_id = APP_DEVICE_ID,
+        .session.keepalive = APP_MQTT_KEEPALIVE_S,
+    };
+    client = esp_mqtt_client_init(&mqtt);
+    if (client == NULL) {
+        ESP_LOGE(TAG, "MQTT client init failed");
+        return false;
+    }
+    esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, mqtt_event, NULL);
+    esp_mqtt_client_start(client);
+    ESP_LOGI(TAG, "WiFi \"%s\", broker %s", APP_WIFI_SSID, APP_MQTT_URI);
+    return true;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file net_mqtt.h
+ * @brief WiFi station, SNTP clock and the esp-mqtt transport for telemetry.h
+ *
+ * Everything here runs in ESP-IDF's own tasks (WiFi, lwIP, esp-mqtt): the
+ * application tasks never block on the network. The telemetry task sees
+ * only the telemetry_transport_t callbacks:
+ *   publish()    esp_mqtt_client_enqueue() at QoS 1 - copies the payload
+ *                into esp-mqtt's outbox and returns its message id
+ *   connected()  flag set from MQTT_EVENT_CONNECTED / _DISCONNECTED
+ * MQTT_EVENT_PUBLISHED (the PUBACK) is forwarded to telemetry_on_ack().
+ *
+ * With APP_WIFI_SSID empty (app_config.h) nothing is started and the
+ * transport stays disconnected: samples wait in the flash outbox.
+ */
+
+#ifndef NET_MQTT_H
+#define NET_MQTT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "telemetry.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Start WiFi, SNTP and the MQTT client; acks go to tlm
+ * @return false if networking is not configured
+ */
+bool net_mqtt_start(telemetry_t *tlm);
+
+/** Transport for telemetry_init() */
+const telemetry_transport_t *net_mqtt_transport(void);
+
+/** Unix time in ms from SNTP, 0 until the first sync */
+int64_t net_mqtt_clock_ms(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NET_MQTT_H
@@ -0,0 +1,213 @@
+/**
+ * @file net_web.c
+ * @brief esp_http_server: gzip page from flash, WebSocket delta push, browser commands
+ */
+
+#include "net_web.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+
+#include "app_config.h"
+#include "app_tasks.h"
+
+#include "esp_http_server.h"
+#include "esp_log.h"
+
+static const char *TAG = "WEB";
+
+// main/web/index.html, gzip -9 at build time (main/CMakeLists.txt)
+extern const uint8_t index_html_gz_start[] asm("_binary_index_html_gz_start");
+extern const uint8_t index_html_gz_end[] asm("_binary_index_html_gz_end");
+
+static httpd_handle_t server = NULL;
+static char etag[12];                       // "xxxxxxxx" of the page
+static net_web_stats_t stats;
+
+// web task -> httpd task
+static portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+static dashboard_state_t latest;
+static bool push_queued = false;
+
+// ============================================================================
+// PAGE
+// ============================================================================
+
+static esp_err_t page_get(httpd_req_t *req) {
+    char match[sizeof(etag)];
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");          // Revalidate: a 304 after a firmware update
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", match, sizeof(match)) == ESP_OK &&
+        strcmp(match, etag) == 0) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+    httpd_resp_set_type(req, "text/html");
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, (const char *)index_html_gz_start, index_html_gz_end - index_html_gz_start);
+}
+
+// ============================================================================
+// WEBSOCKET (httpd task)
+// ============================================================================
+
+static void handle_command(const char *json) {
+    static const char pumps[DASHBOARD_PUMPS] = {'X', 'Y', 'Z', 'A'};
+    static const command_kind_t kinds[] = {
+        [DASHBOARD_CMD_DOSE] = COMMAND_DOSE,
+        [DASHBOARD_CMD_STOP] = COMMAND_STOP,
+        [DASHBOARD_CMD_RESUME] = COMMAND_RESUME,
+        [DASHBOARD_CMD_RESET] = COMMAND_RESET,
+    };
+
+    dashboard_cmd_t in;
+    if (!dashboard_parse_command(json, &in)) {
+        stats.rejected++;
+        ESP_LOGW(TAG, "Unknown command: %.48s", json);
+        return;
+    }
+    command_msg_t cmd = {
+        .kind = kinds[in.kind],
+        .pump = pumps[in.pump],
+        .grams = in.grams > 0.0f ? in.grams : APP_DEFAULT_DOSE_G,
+        .flow_ml_min = APP_DEFAULT_FLOW_ML_MIN,
+    };
+    if (!app_queue_send(&q_command_web, &cmd)) {
+        stats.rejected++;
+        ESP_LOGW(TAG, "Command queue full");
+        return;
+    }
+    stats.commands++;
+}
+
+static esp_err_t ws_handler(httpd_req_t *req) {
+    if (req->method == HTTP_GET) {
+        // Handshake done: the session is a subscriber from now on
+        dashboard_client_t *c = calloc(1, sizeof(*c));
+        if (c == NULL) return ESP_ERR_NO_MEM;
+        req->sess_ctx = c;
+        req->free_ctx = free;
+        ESP_LOGI(TAG, "Dashboard client %d", httpd_req_to_sockfd(req));
+        return ESP_OK;
+    }
+
+    httpd_ws_frame_t frame = {0};
+    esp_err_t err = httpd_ws_recv_frame(req, &frame, 0);       // Length only
+    if (err != ESP_OK) return err;
+    if (frame.len >= WEB_RX_MAX) return ESP_FAIL;              // Closes the session
+    char buf[WEB_RX_MAX];
+    frame.payload = (uint8_t *)buf;
+    err = httpd_ws_recv_frame(req, &frame, sizeof(buf) - 1);
+    if (err != ESP_OK) return err;
+    buf[frame.len] = '\0';
+    if (frame.type == HTTPD_WS_TYPE_TEXT) handle_command(buf);
+    return ESP_OK;
+}
+
+/** The socket's send buffer still holds earlier frames (lwIP: below TCP_SNDLOWAT) */
+static bool backlogged(int fd) {
+    fd_set w;
+    FD_ZERO(&w);
+    FD_SET(fd, &w);
+    struct timeval now = {0, 0};
+    return select(fd + 1, NULL, &w, NULL, &now) <= 0;
+}
+
+static void push_work(void *arg) {
+    (void)arg;
+    static char frame_buf[DASHBOARD_FRAME_MAX];
+    dashboard_state_t cur;
+    portENTER_CRITICAL(&mux);
+    cur = latest;
+    push_queued = false;
+    portEXIT_CRITICAL(&mux);
+
+    int fds[WEB_MAX_SOCKETS];
+    size_t count = WEB_MAX_SOCKETS;
+    if (httpd_get_client_list(server, &count, fds) != ESP_OK) return;
+
+    uint32_t clients = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (httpd_ws_get_fd_info(server, fds[i]) != HTTPD_WS_CLIENT_WEBSOCKET) continue;
+        dashboard_client_t *c = httpd_sess_get_ctx(server, fds[i]);
+        if (c == NULL) continue;
+        clients++;
+
+        uint32_t coalesced = c->coalesced;
+        size_t len = dashboard_client_frame(c, &cur, backlogged(fds[i]), frame_buf, sizeof(frame_buf));
+        stats.coalesced += c->coalesced - coalesced;
+        if (len == 0) continue;
+
+        httpd_ws_frame_t frame = {
+            .final = true,
+            .type = HTTPD_WS_TYPE_TEXT,
+            .payload = (uint8_t *)frame_buf,
+            .len = len,
+        };
+        if (httpd_ws_send_frame_async(server, fds[i], &frame) != ESP_OK) {
+            c->synced = false;
+            stats.send_errors++;
+            httpd_sess_trigger_close(server, fds[i]);
+            continue;
+        }
+        stats.frames++;
+        stats.bytes += (uint32_t)len;
+    }
+    stats.clients = clients;
+}
+
+// ============================================================================
+// API
+// ============================================================================
+
+void net_web_publish(const dashboard_state_t *state) {
+    if (server == NULL) return;
+    bool queue;
+    portENTER_CRITICAL(&mux);
+    latest = *state;
+    queue = !push_queued;                   // Else the pending push picks this state up
+    push_queued = true;
+    portEXIT_CRITICAL(&mux);
+
+    if (queue && httpd_queue_work(server, push_work, NULL) != ESP_OK) {
+        portENTER_CRITICAL(&mux);
+        push_queued = false;
+        portEXIT_CRITICAL(&mux);
+    }
+}
+
+void net_web_get_stats(net_web_stats_t *out) {
+    *out = stats;
+}
+
+bool net_web_start(void) {
+    uint32_t hash = 2166136261u;            // FNV-1a of the page: changes with every edit
+    for (const uint8_t *p = index_html_gz_start; p < index_html_gz_end; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    snprintf(etag, sizeof(etag), "\"%08lx\"", (unsigned long)hash);
+
+    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+    config.task_priority = APP_PRIO_WEB;
+    config.core_id = APP_CORE_MAIN;
+    config.stack_size = APP_STACK_HTTPD;
+    config.max_open_sockets = WEB_MAX_SOCKETS;
+    config.lru_purge_enable = true;         // A new browser replaces the idlest connection
+    config.send_wait_timeout = WEB_SEND_TIMEOUT_S;
+    if (httpd_start(&server, &config) != ESP_OK) {
+        ESP_LOGE(TAG, "HTTP server start failed");
+        server = NULL;
+        return false;
+    }
+
+    static const httpd_uri_t page = {.uri = "/", .method = HTTP_GET, .handler = page_get};
+    static const httpd_uri_t ws = {.uri = "/ws", .method = HTTP_GET, .handler = ws_handler, .is_websocket = true};
+    httpd_register_uri_handler(server, &page);
+    httpd_register_uri_handler(server, &ws);
+    ESP_LOGI(TAG, "Dashboard on port %u (%u bytes gzip)", (unsigned)config.server_port,
+             (unsigned)(index_html_gz_end - index_html_gz_start));
+    return true;
+}
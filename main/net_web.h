@@ -0,0 +1,58 @@
+/**
+ * @file net_web.h
+ * @brief Dashboard HTTP / WebSocket server (esp_http_server)
+ *
+ *   GET /     main/web/index.html, gzip-compressed at build time and
+ *             embedded in flash; sent as is with Content-Encoding: gzip
+ *             and an ETag, so a reload costs a 304
+ *   GET /ws   WebSocket: delta frames of dashboard.h out, commands in
+ *
+ * Everything runs in the httpd task (APP_PRIO_WEB, core 0). The web
+ * task hands over the latest state with net_web_publish() and the httpd
+ * task pushes it to every client whose socket has room; the control tasks
+ * never wait on a browser. Commands go to control through q_command_web.
+ */
+
+#ifndef NET_WEB_H
+#define NET_WEB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "dashboard.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t clients;           // WebSocket clients now
+    uint32_t frames;            // Sent, all clients
+    uint32_t bytes;
+    uint32_t coalesced;         // Client ticks skipped on a full send buffer
+    uint32_t send_errors;       // Client dropped
+    uint32_t commands;          // Accepted from browsers
+    uint32_t rejected;          // Unknown, malformed, or q_command_web full
+} net_web_stats_t;
+
+/**
+ * @brief Start the server (after the network stack is up, see net_mqtt_start)
+ * @return false if the server could not start
+ */
+bool net_web_start(void);
+
+/**
+ * @brief Latest state for the next push; call from one task (the web task)
+ *
+ * Queues one push to the httpd task unless the previous one has not run
+ * yet - then that push sends this state.
+ */
+void net_web_publish(const dashboard_state_t *state);
+
+void net_web_get_stats(net_web_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // NET_WEB_H
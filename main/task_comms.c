@@ -0,0 +1,107 @@
+/**
+ * @file task_comms.c
+ * @brief FluidNC UART task: G-code out, lines in, status reports fanned out
+ *
+ * The only task that reads the FluidNC UART. Every status report is parsed
+ * once and sent to both control and safety; every other line goes to
+ * control as a response. Realtime bytes do not go through here: the
+ * latched e-stop's '!', '?' polls and Ctrl-X go straight into the HW FIFO
+ * (estop.c); all others (status queries, overrides, jog cancel, feed hold
+ * and cycle start for pause/resume) go through the UART driver from
+ * whichever task needs them (hal_uart_write / estop_send_realtime),
+ * behind the G-code already in the TX ring.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "app_config.h"
+#include "app_tasks.h"
+
+#include "driver/uart.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "estop.h"
+#include "hal.h"
+#include "line_framer.h"
+#include "pin_definitions.h"
+
+static const char *TAG = "COMMS";
+
+static char line_buf[APP_LINE_MAX];
+static line_framer_t framer;
+
+static void dispatch_status(const char *line, int64_t now_us) {
+    status_msg_t msg;
+    msg.t_us = now_us;
+    if (!fluidnc_status_parse(line, &msg.status)) {
+        return;
+    }
+    strncpy(msg.line, line, sizeof(msg.line) - 1);
+    msg.line[sizeof(msg.line) - 1] = '\0';
+
+    app_queue_send(&q_status_safety, &msg);
+    app_queue_send(&q_status_control, &msg);
+}
+
+static void dispatch_response(const char *line, int64_t now_us) {
+    response_msg_t msg;
+    msg.t_us = now_us;
+    msg.code = 0;
+    strncpy(msg.line, line, sizeof(msg.line) - 1);
+    msg.line[sizeof(msg.line) - 1] = '\0';
+
+    int code;
+    if (strcmp(line, "ok") == 0) {
+        msg.kind = RESPONSE_OK;
+    } else if (sscanf(line, "error:%d", &code) == 1) {
+        msg.kind = RESPONSE_ERROR;
+        msg.code = (int16_t)code;
+    } else if (sscanf(line, "ALARM:%d", &code) == 1) {
+        msg.kind = RESPONSE_ALARM;
+        msg.code = (int16_t)code;
+    } else if (strncmp(line, "Grbl", 4) == 0) {
+        msg.kind = RESPONSE_BANNER;
+    } else {
+        msg.kind = RESPONSE_OTHER;
+    }
+
+    if (!app_queue_send(&q_response, &msg)) {
+        ESP_LOGW(TAG, "Response dropped: %s", line);
+    }
+}
+
+static void handle_line(const line_framer_line_t *line, void *ctx) {
+    (void)ctx;
+    if (line->text[0] == '<') {
+        dispatch_status(line->text, line->end_us);
+    } else {
+        dispatch_response(line->text, line->end_us);
+    }
+}
+
+void comms_task(void *arg) {
+    (void)arg;
+    app_queue_bind(&q_gcode);
+    line_framer_init(&framer, line_buf, sizeof(line_buf), LINE_FRAMER_DROP);   // Never act on half a line
+
+    uint8_t rx[128];
+    gcode_msg_t out;
+
+    for (;;) {
+        // Outgoing lines first: control waits for their "ok"
+        while (app_queue_receive(&q_gcode, &out)) {
+            if (estop_is_latched()) {
+                continue;       // Queued before the latch: must not reach FluidNC
+            }
+            size_t len = strlen(out.line);
+            hal_uart_write(RODENT_UART_NUM, out.line, len);
+            hal_uart_write(RODENT_UART_NUM, "\n", 1);
+        }
+
+        int n = hal_uart_read(RODENT_UART_NUM, rx, sizeof(rx), COMMS_READ_TIMEOUT_MS);
+        if (n > 0) {
+            line_framer_feed(&framer, rx, (size_t)n, esp_timer_get_time(), handle_line, NULL);
+        }
+    }
+}
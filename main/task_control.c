@@ -0,0 +1,682 @@
+/**
+ * @file task_control.c
+ * @brief Control / dosing task: commands in, G-code out, flow supervision
+ *
+ * Single owner of the dosing state. Consumes operator commands, status
+ * reports, FluidNC responses and scale readings; produces G-code lines and
+ * snapshots for UI / web / telemetry. One G-code line is in flight at a time
+ * (wait for "ok"), which is all a volumetric dose needs.
+ *
+ * A dose is one relative move: grams -> ml (density 1) -> mm of tube. It
+ * is complete when FluidNC is back to Idle after the move. The scale is
+ * used to supervise it (flow_monitor), to hold the mass flow with feed
+ * overrides (flow_control, APP_FLOW_CONTROL) and to report what was
+ * delivered.
+ * In idle, the UI can prime a pump from the encoder (COMMAND_JOG): the
+ * turn is streamed as short "$J=" jogs and stopped with a jog cancel
+ * (jog_stream), and while it runs every "ok" belongs to the jog stream.
+ * At start-up the axis limits are read from FluidNC ("$I", and "$$" unless
+ * the NVS copy matches - fluidnc_config); dose and jog feeds are capped by
+ * the pump's max rate, and nothing starts until the limits are known.
+ * A reset (COMMAND_RESET) goes through fluidnc_ctl: feed hold, Ctrl-X once
+ * stopped, "$X" only if a report shows Alarm - each step on the report,
+ * banner or "ok" it waits for, and no dose or jog starts until it is done.
+ * Every dose, hold, fault and e-stop is appended to the event log; every
+ * dose end is also pushed to MQTT telemetry (grams actually delivered),
+ * and weight and state are sampled into its status stream at 20 Hz.
+ * A completed dose is scored once the scale has settled (dose_stats):
+ * its error goes to the per-pump figures in the log and telemetry, and
+ * the pump's mean offset is taken off the next dose's move
+ * (APP_DOSE_BIAS_CORRECTION). The figures are kept in NVS.
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+#include "app_config.h"
+#include "app_tasks.h"
+
+#include "dose_stats.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "estop.h"
+#include "flow_control.h"
+#include "flow_monitor.h"
+#include "fluidnc_config.h"
+#include "fluidnc_ctl.h"
+#include "hal.h"
+#include "jog_stream.h"
+#include "pin_definitions.h"
+
+static const char *TAG = "CONTROL";
+
+#define CMD_FEED_HOLD       '!'
+#define CMD_CYCLE_START     '~'
+#define CMD_RESET           0x18
+#define CMD_STATUS_QUERY    '?'
+#define DOSE_POS_TOL_MM     0.01f
+#define CONFIG_NVS_NS       "fluidnc"
+#define CONFIG_NVS_KEY      "limits"
+#define STATS_NVS_NS        "dose"
+#define STATS_NVS_KEY       "stats"
+
+static control_state_t state = CONTROL_IDLE;
+static fluidnc_status_t machine;            // Latest status report
+static bool have_machine = false;
+static float scale_g = 0.0f;
+
+static char pump = 'X';
+static int pump_axis = 0;
+static float dose_target_g = 0.0f;
+static float dose_mm = 0.0f;
+static float dose_start_pos = 0.0f;
+static float dose_start_scale_g = 0.0f;
+static bool awaiting_ok = false;
+static bool seen_run = false;
+static bool recovering = false;             // fluidnc_ctl stop / reset in progress
+static bool discovering = false;            // fluidnc_config started, result not logged
+static int64_t config_retry_us = 0;
+static bool jogging = false;                // jog_stream_busy() as last published
+static uint32_t doses_completed = 0;
+static uint16_t dose_id = 0;                // Event log cmd_id of the current dose
+static int64_t dose_start_us = 0;
+static float dose_setpoint_g = 0.0f;        // Target + bias correction: what the move is computed from
+static bool dose_settling = false;          // Done, not scored yet
+static int64_t dose_settle_us = 0;
+static uint32_t dose_time_us = 0;
+
+static dose_stats_t dose_stats;
+static dose_stats_store_t stats_store;      // NVS copy, 2 KB: not on the task stack
+static const char *const chemicals[] = APP_CHEMICALS;
+
+static bool snapshot_due = false;
+static int64_t next_status_us = 0;
+
+_Static_assert(CONTROL_ESTOP == (control_state_t)TLM_STATE_ESTOP, "status stream carries control_state_t");
+
+const char *control_state_name(control_state_t s) {
+    static const char *const names[] = {"IDLE", "DOSING", "HOLD", "ESTOP"};
+    return s <= CONTROL_ESTOP ? names[s] : "?";
+}
+
+static int axis_index(char axis) {
+    switch (axis) {
+        case 'X': return 0;
+        case 'Y': return 1;
+        case 'Z': return 2;
+        case 'A': return 3;
+        default:  return -1;
+    }
+}
+
+static void set_state(control_state_t next) {
+    if (next != state) {
+        ESP_LOGI(TAG, "%s -> %s", control_state_name(state), control_state_name(next));
+        state = next;
+        snapshot_due = true;
+    }
+}
+
+static bool queue_gcode(const char *line) {
+    gcode_msg_t msg;
+    snprintf(msg.line, sizeof(msg.line), "%s", line);
+    if (!app_queue_send(&q_gcode, &msg)) {
+        ESP_LOGE(TAG, "G-code queue full, dropped: %s", line);
+        return false;
+    }
+    return true;
+}
+
+static bool send_gcode(const char *line) {
+    if (!queue_gcode(line)) return false;
+    awaiting_ok = true;
+    return true;
+}
+
+/**
+ * @brief Non-latching realtime byte through the UART driver
+ *
+ * task_comms fills the driver's TX ring with G-code; writing the HW FIFO
+ * beside it (the e-stop path) could interleave with or drop bytes of a
+ * line. FluidNC picks realtime bytes out of the stream wherever they land.
+ */
+static void send_realtime(uint8_t cmd) {
+    hal_uart_write(RODENT_UART_NUM, &cmd, 1);
+}
+
+static void send_override(const uint8_t *bytes, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        send_realtime(bytes[i]);
+    }
+}
+
+/**
+ * @brief Dose over (done, aborted, e-stop): back to 100 % for the next move
+ */
+static void stop_flow_control(void) {
+    uint8_t reset[1];
+    send_override(reset, flow_control_stop(reset, sizeof(reset)));
+}
+
+static void log_event(event_type_t type, event_result_t result, uint32_t duration_us, float mass_g,
+                      uint32_t arg) {
+    event_log_append(&app_event_log, type, result, dose_id, duration_us, mass_g, arg);
+}
+
+/**
+ * @brief Score the last completed dose: statistics, log, telemetry
+ */
+static void record_dose(void) {
+    dose_settling = false;
+    float final_g = scale_g - dose_start_scale_g;
+    const dose_stats_slot_t *slot = dose_stats_record(&dose_stats, pump, chemicals[pump_axis], dose_target_g,
+                                                      dose_setpoint_g, final_g, dose_time_us,
+                                                      esp_timer_get_time());
+    if (slot == NULL) return;
+    dose_stats_summary_t sum;
+    dose_stats_summary(&dose_stats, slot, &sum);
+    ESP_LOGI(TAG, "Dose on %c settled: %.2f g for %.2f g (error %+.2f g); %lu doses, mean %+.3f sd %.3f g, "
+             "next correction %+.2f g", pump, final_g, dose_target_g, final_g - dose_target_g,
+             (unsigned long)sum.doses, sum.mean_error_g, sum.sd_error_g, sum.correction_g);
+    telemetry_accuracy_t acc = {
+        .doses = sum.doses,
+        .mean_error_g = sum.mean_error_g,
+        .sd_error_g = sum.sd_error_g,
+        .correction_g = sum.correction_g,
+        .mean_time_s = sum.mean_time_s,
+    };
+    telemetry_push_accuracy(&app_telemetry, (uint8_t)pump_axis, &acc);
+}
+
+/**
+ * @brief Score a settled dose; write the statistics when they are due
+ */
+static void service_stats(int64_t now) {
+    if (dose_settling && state == CONTROL_IDLE && now >= dose_settle_us) record_dose();
+
+    if (dose_stats_save(&dose_stats, now, &stats_store) &&
+        !hal_nvs_set(STATS_NVS_NS, STATS_NVS_KEY, &stats_store, sizeof(stats_store))) {
+        ESP_LOGW(TAG, "Dose statistics not saved (NVS)");
+    }
+}
+
+static void start_dose(const command_msg_t *cmd) {
+    int axis = axis_index(cmd->pump);
+    if (axis < 0 || cmd->grams <= 0.0f) {
+        ESP_LOGW(TAG, "Invalid dose: pump %c, %.2f g", cmd->pump, cmd->grams);
+        log_event(EVENT_DOSE_START, EVENT_RESULT_ERROR, 0, cmd->grams, (uint8_t)cmd->pump);
+        return;
+    }
+    if (state != CONTROL_IDLE || awaiting_ok || jog_stream_busy() || !fluidnc_ctl_ready() ||
+        fluidnc_config_busy()) {
+        ESP_LOGW(TAG, "Dose refused in state %s%s%s%s", control_state_name(state),
+                 jog_stream_busy() ? " (jogging)" : "",
+                 fluidnc_ctl_ready() ? "" : " (controller recovering)",
+                 fluidnc_config_busy() ? " (reading limits)" : "");
+        log_event(EVENT_DOSE_START, EVENT_RESULT_ERROR, 0, cmd->grams, (uint8_t)cmd->pump);
+        return;
+    }
+
+    float flow = cmd->flow_ml_min;
+    if (flow < MIN_FLOW_RATE_ML_MIN) flow = MIN_FLOW_RATE_ML_MIN;
+    if (flow > MAX_FLOW_RATE_ML_MIN) flow = MAX_FLOW_RATE_ML_MIN;
+    float feed = flow / APP_ML_PER_MM;
+    if (feed < MIN_FEEDRATE_MM_MIN) feed = MIN_FEEDRATE_MM_MIN;
+    float max_feed = fluidnc_config_max_feed(fluidnc_config_get(), axis, MAX_FEEDRATE_MM_MIN);
+    if (feed > max_feed) feed = max_feed;
+
+    if (dose_settling) record_dose();       // Scored with what the scale shows now
+
+    pump = cmd->pump;
+    pump_axis = axis;
+    dose_target_g = cmd->grams;
+#if APP_DOSE_BIAS_CORRECTION
+    dose_setpoint_g = dose_stats_setpoint(&dose_stats, pump, chemicals[axis], cmd->grams);
+#else
+    dose_setpoint_g = cmd->grams;
+#endif
+    dose_mm = dose_setpoint_g / APP_ML_PER_MM;  // Density 1 g/ml
+    dose_start_pos = have_machine ? machine.pos[axis] : 0.0f;
+    dose_start_scale_g = scale_g;
+    seen_run = false;
+
+    char line[64];
+    snprintf(line, sizeof(line), "G91 G1 %c%.3f F%.1f", pump, dose_mm, feed);
+    if (!send_gcode(line)) return;
+
+    dose_start_us = esp_timer_get_time();
+    dose_id++;
+    flow_monitor_start(scale_g, dose_start_us);
+#if APP_FLOW_CONTROL
+    // Density 1 g/ml: the feed actually commanded, after clamping
+    flow_control_start(feed * APP_ML_PER_MM / 60.0f, feed * APP_ML_PER_MM, dose_start_us);
+#endif
+    log_event(EVENT_DOSE_START, EVENT_RESULT_OK, 0, dose_target_g, (uint8_t)pump);
+    ESP_LOGI(TAG, "Dose %.2f g on %c (correction %+.2f g): %s", dose_target_g, pump, dose_setpoint_g - dose_target_g,
+             line);
+    set_state(CONTROL_DOSING);
+}
+
+/**
+ * @brief Log the end of the current dose (done, error, alarm, e-stop)
+ */
+static void log_dose_end(event_result_t result) {
+    uint32_t duration_us = (uint32_t)(esp_timer_get_time() - dose_start_us);
+    float delivered_g = scale_g - dose_start_scale_g;
+    log_event(EVENT_DOSE_DONE, result, duration_us, delivered_g, (uint8_t)pump);
+    telemetry_push_dose(&app_telemetry, (uint8_t)pump_axis, 0, dose_target_g, delivered_g, duration_us / 1000);
+}
+
+static void finish_dose(const char *why) {
+    flow_control_stats_t fc;
+    flow_control_get_stats(&fc);            // Before stop: it resets the override
+    flow_monitor_stop();
+    stop_flow_control();
+    if (state == CONTROL_DOSING) {
+        doses_completed++;
+        log_dose_end(EVENT_RESULT_OK);
+        dose_time_us = (uint32_t)(esp_timer_get_time() - dose_start_us);
+        dose_settle_us = esp_timer_get_time() + (int64_t)APP_DOSE_SETTLE_MS * 1000;
+        dose_settling = true;
+        ESP_LOGI(TAG, "Dose done (%s): target %.2f g, scale %.2f g, flow %.3f/%.3f g/s at %u%%", why,
+                 dose_target_g, scale_g - dose_start_scale_g, fc.measured_g_s, fc.target_g_s,
+                 (unsigned)fc.ov_pct);
+    }
+    set_state(CONTROL_IDLE);
+}
+
+/**
+ * @brief Jog stream settings for the pump about to prime (its max rate)
+ */
+static void init_jog(float max_feed_mm_min) {
+    jog_stream_config_t jc = JOG_STREAM_DEFAULT_CONFIG;
+    jc.mm_per_detent = APP_JOG_MM_PER_DETENT;
+    jc.max_feed_mm_min = max_feed_mm_min;
+    if (jc.min_feed_mm_min > jc.max_feed_mm_min) jc.min_feed_mm_min = jc.max_feed_mm_min;
+    jog_stream_init(&jc);
+}
+
+/**
+ * @brief Encoder turn: enter jog mode on the first one (idle, nothing in flight)
+ */
+static void jog(const command_msg_t *cmd) {
+    int64_t now = esp_timer_get_time();
+    if (!jog_stream_busy()) {
+        int axis = axis_index(cmd->pump);
+        if (state != CONTROL_IDLE || awaiting_ok || !fluidnc_ctl_ready() || fluidnc_config_busy() || axis < 0) {
+            ESP_LOGW(TAG, "Jog refused in state %s", control_state_name(state));
+            return;
+        }
+        if (dose_settling) record_dose();   // Before priming adds to the scale
+        float max_feed = fluidnc_config_max_feed(fluidnc_config_get(), axis, APP_JOG_MAX_FEED_MM_MIN);
+        init_jog(max_feed < APP_JOG_MAX_FEED_MM_MIN ? max_feed : APP_JOG_MAX_FEED_MM_MIN);
+        jog_stream_begin(cmd->pump);
+        if (have_machine) jog_stream_on_status(&machine, now);
+        pump = cmd->pump;
+        pump_axis = axis;
+        jogging = true;
+        snapshot_due = true;
+        ESP_LOGI(TAG, "Jog mode on %c", pump);
+    }
+    jog_stream_on_detents(cmd->detents, now);
+}
+
+/**
+ * @brief Read the axis limits, from NVS if FluidNC still identifies the same
+ */
+static void start_config(int64_t now) {
+    fluidnc_config_t cached;
+    size_t len = sizeof(cached);
+    bool have = hal_nvs_get(CONFIG_NVS_NS, CONFIG_NVS_KEY, &cached, &len) && len == sizeof(cached);
+    fluidnc_config_start(have ? &cached : NULL, now);
+    discovering = true;
+}
+
+/**
+ * @brief Send discovery lines (not while a recovery owns the line); store a new dump
+ */
+static void service_config(int64_t now) {
+    if (!discovering && fluidnc_config_state() == FLUIDNC_CONFIG_FAILED && now >= config_retry_us) {
+        start_config(now);
+    }
+    if (!fluidnc_ctl_ready()) return;
+    const char *line = fluidnc_config_poll(now);
+    if (line) queue_gcode(line);                // fluidnc_config takes its own "ok"
+
+    fluidnc_config_state_t cs = fluidnc_config_state();
+    if (!discovering || (cs != FLUIDNC_CONFIG_DONE && cs != FLUIDNC_CONFIG_FAILED)) return;
+    discovering = false;
+    if (cs == FLUIDNC_CONFIG_FAILED) {
+        ESP_LOGW(TAG, "FluidNC limits not read; retry in %d ms, feeds capped at %.0f mm/min",
+                 APP_CONFIG_RETRY_MS, (double)MAX_FEEDRATE_MM_MIN);
+        config_retry_us = now + (int64_t)APP_CONFIG_RETRY_MS * 1000;
+        return;
+    }
+
+    fluidnc_config_stats_t st;
+    fluidnc_config_get_stats(&st);
+    const fluidnc_config_t *c = fluidnc_config_get();
+    ESP_LOGI(TAG, "FluidNC limits (%s, %lu ms, key %08lx):", st.from_cache ? "cached" : "$$",
+             (unsigned long)(st.last_us / 1000), (unsigned long)c->key);
+    for (int i = 0; i < c->axis_count; i++) {
+        ESP_LOGI(TAG, "  %c: %.0f mm/min, %.0f mm/s^2, %.3f steps/mm, travel %.0f mm", "XYZA"[i],
+                 c->axes[i].max_rate_mm_min, c->axes[i].accel_mm_s2, c->axes[i].steps_per_mm,
+                 c->axes[i].max_travel_mm);
+    }
+    if (st.changed && !hal_nvs_set(CONFIG_NVS_NS, CONFIG_NVS_KEY, c, sizeof(*c))) {
+        ESP_LOGW(TAG, "FluidNC limits not cached (NVS)");
+    }
+}
+
+/**
+ * @brief Send what the controller recovery asks for; log how it ended
+ */
+static void service_ctl(int64_t now) {
+    fluidnc_ctl_action_t action;
+    while (fluidnc_ctl_poll(now, &action)) {
+        if (action.kind == FLUIDNC_CTL_ACTION_REALTIME) {
+            send_realtime(action.byte);
+        } else {
+            queue_gcode(action.line);           // fluidnc_ctl takes its own "ok"
+        }
+    }
+
+    fluidnc_ctl_state_t cs = fluidnc_ctl_state();
+    if (recovering && (cs == FLUIDNC_CTL_READY || cs == FLUIDNC_CTL_FAILED)) {
+        fluidnc_ctl_stats_t st;
+        fluidnc_ctl_get_stats(&st);
+        if (cs == FLUIDNC_CTL_READY) {
+            ESP_LOGI(TAG, "Controller ready in %lu ms (%lu resets, %lu unlocks)",
+                     (unsigned long)(st.last_us / 1000), (unsigned long)st.resets, (unsigned long)st.unlocks);
+        } else {
+            ESP_LOGE(TAG, "Controller recovery failed (machine %s); reset again",
+                     fluidnc_state_name(st.machine));
+        }
+        recovering = false;
+    }
+}
+
+/**
+ * @brief Send whatever the jog stream asks for; log the end of jog mode
+ */
+static void service_jog(int64_t now) {
+    char line[sizeof(((gcode_msg_t *)0)->line)];
+    jog_action_t action;
+    while ((action = jog_stream_poll(now, line, sizeof(line))) != JOG_ACTION_NONE) {
+        if (action == JOG_ACTION_CANCEL) {
+            send_realtime(FLUIDNC_JOG_CANCEL);
+        } else if (action == JOG_ACTION_QUERY) {
+            send_realtime(CMD_STATUS_QUERY);
+        } else if (!queue_gcode(line)) {
+            send_realtime(FLUIDNC_JOG_CANCEL);          // The stream counted it as sent
+            jog_stream_abort();
+        }
+    }
+
+    if (jogging && !jog_stream_busy()) {
+        jog_stream_stats_t js;
+        jog_stream_get_stats(&js);
+        ESP_LOGI(TAG, "Jog mode off: moved %.2f mm in %lu segments, %lu cancels, stop %lu ms max, %lu errors",
+                 js.moved_mm, (unsigned long)js.segments, (unsigned long)js.cancels,
+                 (unsigned long)(js.max_stop_us / 1000), (unsigned long)js.errors);
+        jogging = false;
+        snapshot_due = true;
+    }
+}
+
+static void handle_command(const command_msg_t *cmd) {
+    switch (cmd->kind) {
+        case COMMAND_DOSE:
+            start_dose(cmd);
+            break;
+
+        case COMMAND_JOG:
+            jog(cmd);
+            break;
+
+        case COMMAND_JOG_END:
+            jog_stream_end();
+            break;
+
+        case COMMAND_STOP:
+            if (jog_stream_busy()) {
+                jog_stream_end();           // Jog cancel, not a feed hold
+                break;
+            }
+            send_realtime(CMD_FEED_HOLD);
+            flow_monitor_stop();
+            flow_control_pause();
+            log_event(EVENT_HOLD, EVENT_RESULT_OK, 0, scale_g, 0);
+            if (state == CONTROL_DOSING) set_state(CONTROL_HOLD);
+            break;
+
+        case COMMAND_RESUME:
+            if (state == CONTROL_HOLD) {
+                send_realtime(CMD_CYCLE_START);
+                // New baseline: the scale kept settling during the hold
+                flow_monitor_start(scale_g, esp_timer_get_time());
+                flow_control_resume(esp_timer_get_time());
+                log_event(EVENT_RESUME, EVENT_RESULT_OK, 0, scale_g, 0);
+                set_state(CONTROL_DOSING);
+            }
+            break;
+
+        case COMMAND_RESET:
+            if (estop_is_latched()) {
+                if (!estop_clear()) {
+                    ESP_LOGW(TAG, "E-stop not cleared (STOP still held or reset pending)");
+                    return;
+                }
+                fluidnc_ctl_stop(esp_timer_get_time());     // estop already sent Ctrl-X: "$X" if locked
+            } else {
+                fluidnc_ctl_reset(esp_timer_get_time());
+                awaiting_ok = false;        // Reset discards whatever was pending
+            }
+            recovering = true;
+            jog_stream_abort();
+            flow_monitor_stop();
+            stop_flow_control();
+            if (state == CONTROL_DOSING || state == CONTROL_HOLD) log_dose_end(EVENT_RESULT_ABORTED);
+            set_state(CONTROL_IDLE);
+            break;
+    }
+}
+
+static void handle_status(const status_msg_t *msg) {
+    machine = msg->status;
+    have_machine = true;
+    snapshot_due = true;
+    flow_control_on_status(&msg->status, msg->t_us);
+    jog_stream_on_status(&msg->status, msg->t_us);
+    fluidnc_ctl_on_status(&msg->status, msg->t_us);
+
+    const flow_fault_t *fault = flow_monitor_on_status(&msg->status, msg->t_us);
+    if (fault != NULL) {
+        send_realtime(CMD_FEED_HOLD);
+        char text[32];
+        flow_fault_format(fault, text, sizeof(text));
+        ESP_LOGE(TAG, "FLOW FAULT %s: expected %.2f g, scale %.2f g", text, fault->expected_g,
+                 fault->actual_g);
+        log_event(EVENT_FLOW_FAULT, EVENT_RESULT_ERROR, 0, fault->actual_g, fault->code);
+        flow_control_pause();
+        set_state(CONTROL_HOLD);
+        return;
+    }
+
+    if (state != CONTROL_DOSING) return;
+
+    fluidnc_state_t ms = msg->status.state;
+    if (ms == FLUIDNC_STATE_RUN) {
+        seen_run = true;
+    } else if (ms == FLUIDNC_STATE_IDLE && !awaiting_ok) {
+        float moved = msg->status.pos[pump_axis] - dose_start_pos;
+        if (seen_run || fabsf(moved - dose_mm) < DOSE_POS_TOL_MM) {
+            finish_dose("move complete");
+        }
+    } else if (ms == FLUIDNC_STATE_ALARM) {
+        ESP_LOGE(TAG, "Alarm during dose: %s", msg->line);
+        log_dose_end(EVENT_RESULT_ABORTED);
+        flow_monitor_stop();
+        stop_flow_control();
+        set_state(CONTROL_IDLE);
+    }
+}
+
+static void handle_response(const response_msg_t *msg) {
+    if (fluidnc_config_on_line(msg->line, msg->t_us)) return;
+    // The banner is still ours too (pending lines are gone); the "$X" reply is not
+    if (fluidnc_ctl_on_line(msg->line, msg->t_us) && msg->kind != RESPONSE_BANNER) return;
+    if (jog_stream_busy() && (msg->kind == RESPONSE_OK || msg->kind == RESPONSE_ERROR)) {
+        if (msg->kind == RESPONSE_ERROR) ESP_LOGW(TAG, "Jog rejected: error:%d", msg->code);
+        jog_stream_on_response(msg->kind == RESPONSE_OK);
+        return;
+    }
+    switch (msg->kind) {
+        case RESPONSE_OK:
+            awaiting_ok = false;
+            break;
+        case RESPONSE_ERROR:
+            awaiting_ok = false;
+            ESP_LOGE(TAG, "FluidNC error:%d", msg->code);
+            if (state == CONTROL_DOSING) {
+                log_dose_end(EVENT_RESULT_ERROR);
+                flow_monitor_stop();
+                stop_flow_control();
+                set_state(CONTROL_IDLE);
+            }
+            break;
+        case RESPONSE_ALARM:
+            ESP_LOGE(TAG, "FluidNC ALARM:%d", msg->code);
+            log_event(EVENT_ALARM, EVENT_RESULT_ERROR, 0, NAN, (uint32_t)msg->code);
+            jog_stream_abort();
+            break;
+        case RESPONSE_BANNER:
+            awaiting_ok = false;
+            jog_stream_abort();
+            config_retry_us = 0;            // FluidNC (re)started: limits discovery may retry now
+            break;
+        case RESPONSE_OTHER:
+            ESP_LOGI(TAG, "FluidNC: %s", msg->line);
+            break;
+    }
+}
+
+static void publish_snapshot(void) {
+    snapshot_msg_t snap;
+    flow_fault_t fault;
+
+    snap.t_us = esp_timer_get_time();
+    snap.state = state;
+    snap.machine = have_machine ? machine.state : FLUIDNC_STATE_UNKNOWN;
+    for (int i = 0; i < 4; i++) {
+        snap.pos[i] = have_machine ? machine.pos[i] : 0.0f;
+    }
+    snap.scale_g = scale_g;
+    snap.pump = pump;
+    snap.dose_target_g = dose_target_g;
+    snap.dosed_g = dose_target_g > 0.0f ? scale_g - dose_start_scale_g : 0.0f;
+    snap.flow_fault_code = flow_monitor_get_fault(&fault) ? fault.code : 0;
+    snap.doses_completed = doses_completed;
+    snap.jogging = jogging;
+
+    // Latest-value: each box overwrites whatever its reader has not taken yet
+    snapshot_box_publish(&snapshot_ui, &snap);
+    snapshot_box_publish(&snapshot_web, &snap);
+    snapshot_box_publish(&snapshot_telemetry, &snap);
+}
+
+/**
+ * @brief One sample of the telemetry status stream (sample-and-hold between scale readings)
+ */
+static void push_status(int64_t now_us) {
+    flow_fault_t fault;
+    tlm_status_t s = {
+        .time_ms = now_us / 1000,
+        .weight_g = scale_g,
+        .dosed_g = dose_target_g > 0.0f ? scale_g - dose_start_scale_g : 0.0f,
+        .target_g = dose_target_g,
+        .state = (uint8_t)state,
+        .machine = (uint8_t)(have_machine ? machine.state : FLUIDNC_STATE_UNKNOWN),
+        .pump = (uint8_t)pump_axis,
+        .fault = flow_monitor_get_fault(&fault) ? fault.code : 0,
+    };
+    telemetry_push_status(&app_telemetry, &s);
+}
+
+void control_task(void *arg) {
+    (void)arg;
+    app_queue_bind(&q_command);
+    app_queue_bind(&q_command_web);
+    app_queue_bind(&q_status_control);
+    app_queue_bind(&q_response);
+    app_queue_bind(&q_scale);
+
+    flow_monitor_init(NULL);
+    flow_control_config_t fc = FLOW_CONTROL_DEFAULT_CONFIG;
+    fc.min_flow_ml_min = MIN_FLOW_RATE_ML_MIN;
+    fc.max_flow_ml_min = MAX_FLOW_RATE_ML_MIN;
+    if (!flow_control_init(&fc)) ESP_LOGW(TAG, "Flow control windows do not fit the scale period: defaults");
+    init_jog(APP_JOG_MAX_FEED_MM_MIN);
+    fluidnc_ctl_init(NULL);
+    fluidnc_config_init(NULL);
+    start_config(esp_timer_get_time());
+
+    size_t len = sizeof(stats_store);
+    bool have_stats = hal_nvs_get(STATS_NVS_NS, STATS_NVS_KEY, &stats_store, &len) && len == sizeof(stats_store);
+    dose_stats_init(&dose_stats, NULL, have_stats ? &stats_store : NULL);
+
+    command_msg_t cmd;
+    status_msg_t status;
+    response_msg_t response;
+    scale_msg_t scale;
+    uint8_t ov[FLOW_CONTROL_MAX_BYTES];
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(CONTROL_PERIOD_MS));
+
+        if (estop_is_latched() && state != CONTROL_ESTOP) {
+            if (state == CONTROL_DOSING || state == CONTROL_HOLD) log_dose_end(EVENT_RESULT_ABORTED);
+            log_event(EVENT_ESTOP, EVENT_RESULT_OK, 0, scale_g, 0);
+            flow_monitor_stop();
+            flow_control_stop(ov, sizeof(ov));      // Nothing to send: Ctrl-X reset the overrides
+            jog_stream_abort();
+            awaiting_ok = false;
+            set_state(CONTROL_ESTOP);
+        }
+
+        // Responses before status: an "ok" must land before the Idle that follows it
+        while (app_queue_receive(&q_response, &response)) {
+            handle_response(&response);
+        }
+        while (app_queue_receive(&q_scale, &scale)) {
+            scale_g = scale.grams;
+            flow_monitor_on_scale(scale.grams, scale.t_us);
+            send_override(ov, flow_control_on_scale(scale.grams, scale.t_us, ov, sizeof(ov)));
+            snapshot_due = true;
+        }
+        while (app_queue_receive(&q_status_control, &status)) {
+            handle_status(&status);
+        }
+        while (app_queue_receive(&q_command, &cmd)) {
+            handle_command(&cmd);
+        }
+        while (app_queue_receive(&q_command_web, &cmd)) {
+            handle_command(&cmd);
+        }
+        service_ctl(esp_timer_get_time());
+        service_config(esp_timer_get_time());
+        service_jog(esp_timer_get_time());
+        service_stats(esp_timer_get_time());
+
+        if (snapshot_due) {
+            snapshot_due = false;
+            publish_snapshot();
+        }
+
+        int64_t now = esp_timer_get_time();
+        if (now >= next_status_us) {
+            next_status_us = now + (int64_t)STATUS_STREAM_PERIOD_MS * 1000;
+            push_status(now);
+        }
+    }
+}
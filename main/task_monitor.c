@@ -0,0 +1,96 @@
+/**
+ * @file task_monitor.c
+ * @brief Per-task stack and CPU usage, per-queue depth and drops
+ */
+
+#include "task_monitor.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const app_task_def_t *app_tasks = NULL;
+static size_t app_task_count = 0;
+static app_queue_t *const *app_queues = NULL;
+static size_t app_queue_count = 0;
+
+// Previous run-time counters, matched by task number
+static TaskStatus_t statuses[TASK_MONITOR_MAX_TASKS];
+static UBaseType_t prev_number[TASK_MONITOR_MAX_TASKS];
+static uint32_t prev_runtime[TASK_MONITOR_MAX_TASKS];
+static size_t prev_count = 0;
+static uint32_t prev_total = 0;
+
+void task_monitor_init(const app_task_def_t *tasks, size_t task_count,
+                       app_queue_t *const *queues, size_t queue_count) {
+    app_tasks = tasks;
+    app_task_count = task_count;
+    app_queues = queues;
+    app_queue_count = queue_count;
+}
+
+static const app_task_def_t *find_app_task(TaskHandle_t handle) {
+    for (size_t i = 0; i < app_task_count; i++) {
+        if (app_tasks[i].handle == handle) return &app_tasks[i];
+    }
+    return NULL;
+}
+
+static uint32_t previous_runtime(UBaseType_t number, bool *found) {
+    for (size_t i = 0; i < prev_count; i++) {
+        if (prev_number[i] == number) {
+            *found = true;
+            return prev_runtime[i];
+        }
+    }
+    *found = false;
+    return 0;
+}
+
+void task_monitor_report(void) {
+    uint32_t total = 0;
+    UBaseType_t n = uxTaskGetSystemState(statuses, TASK_MONITOR_MAX_TASKS, &total);
+    uint32_t total_delta = total - prev_total;
+
+    printf("\n=== TASKS ===\n");
+    printf("%-14s %4s %4s %6s %8s %6s\n", "Task", "Core", "Prio", "Stack", "MinFree", "CPU%");
+    for (UBaseType_t i = 0; i < n; i++) {
+        const TaskStatus_t *t = &statuses[i];
+        const app_task_def_t *def = find_app_task(t->xHandle);
+
+        bool found;
+        uint32_t before = previous_runtime(t->xTaskNumber, &found);
+        float cpu = (found && total_delta > 0)
+                        ? 100.0f * (float)(t->ulRunTimeCounter - before) / (float)total_delta
+                        : 0.0f;
+
+        // usStackHighWaterMark is in bytes on ESP-IDF (StackType_t = uint8_t)
+        uint32_t min_free = (uint32_t)t->usStackHighWaterMark;
+        if (def) {
+            printf("%-14s %4d %4u %6lu %8lu %6.1f%s\n", t->pcTaskName, (int)def->core,
+                   (unsigned)t->uxCurrentPriority, (unsigned long)def->stack_bytes,
+                   (unsigned long)min_free, cpu,
+                   min_free < TASK_MONITOR_STACK_WARN ? "  <- LOW STACK" : "");
+        } else {
+            printf("%-14s %4s %4u %6s %8lu %6.1f\n", t->pcTaskName, "-",
+                   (unsigned)t->uxCurrentPriority, "-", (unsigned long)min_free, cpu);
+        }
+
+        if (i < TASK_MONITOR_MAX_TASKS) {
+            prev_number[i] = t->xTaskNumber;
+            prev_runtime[i] = t->ulRunTimeCounter;
+        }
+    }
+    prev_count = n;
+    prev_total = total;
+
+    if (app_queue_count > 0) {
+        printf("%-20s %5s %5s %5s %7s\n", "Queue", "Depth", "Size", "Peak", "Dropped");
+        for (size_t i = 0; i < app_queue_count; i++) {
+            const app_queue_t *q = app_queues[i];
+            printf("%-20s %5lu %5lu %5lu %7lu\n", q->name,
+                   (unsigned long)spsc_ring_count(&q->ring), (unsigned long)(q->ring.mask + 1),
+                   (unsigned long)q->high_water, (unsigned long)q->ring.dropped);
+        }
+    }
+    printf("=============\n");
+}
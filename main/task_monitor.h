@@ -0,0 +1,48 @@
+/**
+ * @file task_monitor.h
+ * @brief Per-task stack and CPU usage, per-queue depth and drops
+ *
+ * Needs CONFIG_FREERTOS_USE_TRACE_FACILITY and
+ * CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS (sdkconfig.defaults). CPU usage
+ * is the share of one core between two reports, so a task pinned to a
+ * core and its IDLE task add up to ~100%.
+ *
+ * Example:
+ *   Task          Core Prio  Stack  MinFree   CPU%
+ *   safety           1   20   3072     1844    0.8
+ *   comms            0   15   4096     2560    1.9
+ *   ...
+ */
+
+#ifndef TASK_MONITOR_H
+#define TASK_MONITOR_H
+
+#include <stddef.h>
+
+#include "app_tasks.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TASK_MONITOR_MAX_TASKS      32
+#define TASK_MONITOR_STACK_WARN     512     // Flag tasks with less free stack (bytes)
+
+/**
+ * @brief Register the application task table and queues
+ */
+void task_monitor_init(const app_task_def_t *tasks, size_t task_count,
+                       app_queue_t *const *queues, size_t queue_count);
+
+/**
+ * @brief Print stack / CPU per task (all tasks, not only ours) and queue stats
+ *
+ * CPU figures cover the time since the previous call.
+ */
+void task_monitor_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TASK_MONITOR_H
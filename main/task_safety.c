@@ -0,0 +1,45 @@
+/**
+ * @file task_safety.c
+ * @brief Safety task (APP_CPU, highest application priority)
+ *
+ * Owns the STOP path: installs the GPIO ISR service from this core so the
+ * STOP edge ISR runs on core 1, arms the e-stop on the FluidNC UART, then
+ * runs estop_service() every SAFETY_PERIOD_MS and feeds it every status
+ * report that comms forwards.
+ */
+
+#include "app_config.h"
+#include "app_tasks.h"
+
+#include "button_events.h"
+#include "esp_log.h"
+#include "estop.h"
+#include "pin_definitions.h"
+
+static const char *TAG = "SAFETY";
+
+void safety_task(void *arg) {
+    TaskHandle_t notify_when_armed = (TaskHandle_t)arg;
+
+    app_queue_bind(&q_status_safety);
+
+    // GPIO ISR service is allocated on the calling core
+    ESP_ERROR_CHECK(button_events_init());
+    ESP_ERROR_CHECK(estop_init(RODENT_UART_NUM, RODENT_BAUD_RATE));
+    ESP_LOGI(TAG, "E-stop armed on core %d", xPortGetCoreID());
+
+    if (notify_when_armed != NULL) {
+        xTaskNotifyGive(notify_when_armed);
+    }
+
+    status_msg_t msg;
+    for (;;) {
+        estop_service();
+
+        while (app_queue_receive(&q_status_safety, &msg)) {
+            estop_on_status_line(msg.line);
+        }
+
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SAFETY_PERIOD_MS));
+    }
+}
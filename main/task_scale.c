@@ -0,0 +1,79 @@
+/**
+ * @file task_scale.c
+ * @brief Scale task: RS232 burst protocol, readings to control
+ *
+ * Same protocol as test_15 (13 x "@P<CR><LF>" with per-character pacing,
+ * then a read window), but every wait is a vTaskDelay / UART timeout, so
+ * the ~1 s burst only occupies this task instead of the whole firmware.
+ * A reading every SCALE_READING_MS (~1.4 s): the burst is most of it.
+ */
+
+#include "app_config.h"
+#include "app_tasks.h"
+
+#include "driver/uart.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "hal.h"
+#include "line_framer.h"
+#include "pin_definitions.h"
+#include "scale_weight.h"
+
+static const char *TAG = "SCALE";
+
+// Burst protocol: scale_weight.h (one reading per SCALE_READING_MS)
+static void send_burst(void) {
+    static const char cmd[] = SCALE_BURST_CMD;
+    for (int repeat = 0; repeat < SCALE_REPEATS_PER_BURST; repeat++) {
+        for (size_t i = 0; i < sizeof(cmd) - 1; i++) {
+            hal_uart_write(SCALE_UART_NUM, &cmd[i], 1);
+            vTaskDelay(pdMS_TO_TICKS(SCALE_CHAR_DELAY_MS));
+        }
+        vTaskDelay(pdMS_TO_TICKS(SCALE_LINE_DELAY_MS));
+    }
+}
+
+/**
+ * @brief Read responses for SCALE_READ_WINDOW_MS, keep the last valid weight and when it arrived
+ */
+static bool read_window(float *grams, int64_t *t_us) {
+    static char buf[48];
+    static line_framer_t framer;
+    line_framer_init(&framer, buf, sizeof(buf), LINE_FRAMER_DROP);    // A cut number is a wrong weight
+
+    bool found = false;
+    int64_t end_us = esp_timer_get_time() + (int64_t)SCALE_READ_WINDOW_MS * 1000;
+
+    while (esp_timer_get_time() < end_us) {
+        uint8_t rx[32];
+        int n = hal_uart_read(SCALE_UART_NUM, rx, sizeof(rx), 10);
+        int64_t now = esp_timer_get_time();
+        line_framer_line_t line;
+        for (int i = 0; i < n; i++) {
+            if (line_framer_push(&framer, rx[i], now, &line) && scale_weight_parse(line.text, grams, NULL, 0)) {
+                *t_us = line.end_us;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+void scale_task(void *arg) {
+    (void)arg;
+    uint32_t misses = 0;
+
+    for (;;) {
+        send_burst();
+
+        scale_msg_t msg;
+        if (read_window(&msg.grams, &msg.t_us)) {
+            app_queue_send(&q_scale, &msg);
+            misses = 0;
+        } else if (++misses == 5) {
+            ESP_LOGW(TAG, "No reading in 5 bursts - check scale cable / baud");
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(SCALE_GAP_MS));
+    }
+}
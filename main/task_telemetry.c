@@ -0,0 +1,75 @@
+/**
+ * @file task_telemetry.c
+ * @brief Telemetry task: periodic state line and the task / queue table
+ *
+ * Lowest application priority - it only ever reads snapshots, so it may
+ * fall behind without affecting dosing. Prints a state line to the console
+ * and services MQTT telemetry (flash outbox writes, batching, publishes).
+ * Also the single writer of the event log: records staged by any task go
+ * to flash once per period.
+ */
+
+#include <stdio.h>
+
+#include "app_config.h"
+#include "app_tasks.h"
+
+#include "esp_timer.h"
+#include "net_web.h"
+#include "task_monitor.h"
+
+void telemetry_task(void *arg) {
+    (void)arg;
+    // Not bound to snapshot_telemetry: this task runs on its period, not on pushes
+
+    snapshot_msg_t snap;
+    bool have_snap = false;
+    TickType_t last_wake = xTaskGetTickCount();
+    int64_t next_monitor_us = esp_timer_get_time() + (int64_t)TASK_MONITOR_PERIOD_MS * 1000;
+
+    for (;;) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(TELEMETRY_PERIOD_MS));
+
+        if (snapshot_box_take(&snapshot_telemetry, &snap)) {
+            have_snap = true;
+        }
+
+        if (have_snap) {
+            printf("T,%lld,%s,%s,%.3f,%.3f,%.3f,%.3f,%.2f,%c,%.2f,%.2f,%u,%lu\n",
+                   (long long)(snap.t_us / 1000), control_state_name(snap.state),
+                   fluidnc_state_name(snap.machine), snap.pos[0], snap.pos[1], snap.pos[2],
+                   snap.pos[3], snap.scale_g, snap.pump, snap.dose_target_g, snap.dosed_g,
+                   (unsigned)snap.flow_fault_code, (unsigned long)snap.doses_completed);
+        }
+
+        // Sector erases (~45 ms each) land here, never in a dosing task
+        while (event_log_service(&app_event_log, EVENT_LOG_SERVICE_BATCH) > 0) {
+        }
+
+        int64_t now = esp_timer_get_time();
+        telemetry_service(&app_telemetry, now / 1000);
+
+        if (now >= next_monitor_us) {
+            next_monitor_us = now + (int64_t)TASK_MONITOR_PERIOD_MS * 1000;
+            task_monitor_report();
+
+            telemetry_stats_t st;
+            telemetry_get_stats(&app_telemetry, &st);
+            printf("MQTT: pushed %lu, published %lu, acked %lu msgs / %lu samples, pending %lu, "
+                   "resent %lu, dropped %lu+%lu, coalesced %lu\n",
+                   (unsigned long)st.pushed, (unsigned long)st.published, (unsigned long)st.acked,
+                   (unsigned long)st.samples_acked, (unsigned long)st.pending, (unsigned long)st.resent,
+                   (unsigned long)st.dropped_queue, (unsigned long)st.dropped_store, (unsigned long)st.coalesced);
+            printf("MQTT status stream: %lu samples, %lu frames, %lu bytes, %lu dropped\n",
+                   (unsigned long)st.status_samples, (unsigned long)st.status_frames,
+                   (unsigned long)st.status_bytes, (unsigned long)st.status_dropped);
+
+            net_web_stats_t web;
+            net_web_get_stats(&web);
+            printf("Web: %lu clients, %lu frames, %lu bytes, coalesced %lu, dropped %lu, commands %lu (%lu rejected)\n",
+                   (unsigned long)web.clients, (unsigned long)web.frames, (unsigned long)web.bytes,
+                   (unsigned long)web.coalesced, (unsigned long)web.send_errors, (unsigned long)web.commands,
+                   (unsigned long)web.rejected);
+        }
+    }
+}
@@ -0,0 +1,186 @@
+/**
+ * @file task_ui.c
+ * @brief UI task: buttons -> commands, snapshots -> 16x2 display frame
+ *
+ * STOP is not handled here - it is hooked in the GPIO ISR by the e-stop
+ * (safety task). The display frame is rendered into a 16x2 text buffer;
+ * until the LCD driver is available to ESP-IDF builds it is logged
+ * whenever its first line changes.
+ *
+ * Buttons:
+ *   START   idle: dose the selected pump   hold: resume   e-stop: reset
+ *           prime: leave prime mode
+ *   MODE    select next pump (idle only)
+ *   SELECT  feed hold during a dose (non-latching pause)
+ *           idle: prime mode on / off - the encoder runs the selected pump
+ *
+ * In prime mode every encoder turn goes to control as COMMAND_JOG as soon
+ * as it happens (the encoder ISR wakes this task); outside it the encoder
+ * count is discarded.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "app_config.h"
+#include "app_tasks.h"
+
+#include "button_events.h"
+#include "encoder.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+
+static const char *TAG = "UI";
+
+static const char pumps[] = {'X', 'Y', 'Z', 'A'};
+
+static snapshot_msg_t snap;
+static bool have_snap = false;
+static int selected = 0;
+static char frame[2][17];
+static char shown_line0[17];
+static bool priming = false;
+static TaskHandle_t ui_handle = NULL;
+
+static void IRAM_ATTR wake_on_detent(void) {
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(ui_handle, &woken);
+    if (woken) portYIELD_FROM_ISR();
+}
+
+static void send_jog(command_kind_t kind, int32_t detents) {
+    if (detents > INT16_MAX) detents = INT16_MAX;
+    if (detents < INT16_MIN) detents = INT16_MIN;
+    command_msg_t cmd = {
+        .kind = kind,
+        .pump = pumps[selected],
+        .detents = (int16_t)detents,
+    };
+    if (!app_queue_send(&q_command, &cmd)) {
+        ESP_LOGW(TAG, "Command queue full");
+    }
+}
+
+static void set_priming(bool on) {
+    priming = on;
+    encoder_take();                         // Turns from before don't count
+    send_jog(on ? COMMAND_JOG : COMMAND_JOG_END, 0);
+}
+
+static void send_command(command_kind_t kind) {
+    command_msg_t cmd = {
+        .kind = kind,
+        .pump = pumps[selected],
+        .grams = APP_DEFAULT_DOSE_G,
+        .flow_ml_min = APP_DEFAULT_FLOW_ML_MIN,
+    };
+    if (!app_queue_send(&q_command, &cmd)) {
+        ESP_LOGW(TAG, "Command queue full");
+    }
+}
+
+static void handle_button(const button_event_t *ev) {
+    if (ev->type != BUTTON_EVENT_PRESS) return;
+    control_state_t st = have_snap ? snap.state : CONTROL_IDLE;
+
+    switch (ev->button) {
+        case BUTTON_START:
+            if (priming) {
+                set_priming(false);
+            } else if (st == CONTROL_ESTOP) {
+                send_command(COMMAND_RESET);
+            } else if (st == CONTROL_HOLD) {
+                send_command(COMMAND_RESUME);
+            } else if (st == CONTROL_IDLE) {
+                send_command(COMMAND_DOSE);
+            }
+            break;
+        case BUTTON_MODE:
+            if (st == CONTROL_IDLE && !priming) {
+                selected = (selected + 1) % (int)sizeof(pumps);
+            }
+            break;
+        case BUTTON_SELECT:
+            if (st == CONTROL_DOSING) {
+                send_command(COMMAND_STOP);
+            } else if (st == CONTROL_IDLE) {
+                set_priming(!priming);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+static void render(void) {
+    if (!have_snap) {
+        snprintf(frame[0], sizeof(frame[0]), "Pump %c  READY", pumps[selected]);
+        snprintf(frame[1], sizeof(frame[1]), "START to dose");
+        return;
+    }
+
+    switch (snap.state) {
+        case CONTROL_IDLE:
+            if (priming || snap.jogging) {
+                snprintf(frame[0], sizeof(frame[0]), "Pump %c  PRIME", pumps[selected]);
+                snprintf(frame[1], sizeof(frame[1]), "%7.2fmm %s", snap.pos[selected],
+                         snap.machine == FLUIDNC_STATE_JOG ? "RUN" : "");
+                break;
+            }
+            snprintf(frame[0], sizeof(frame[0]), "Pump %c  READY", pumps[selected]);
+            snprintf(frame[1], sizeof(frame[1]), "%6.2fg  #%lu", snap.scale_g,
+                     (unsigned long)snap.doses_completed);
+            break;
+        case CONTROL_DOSING:
+            snprintf(frame[0], sizeof(frame[0]), "Pump %c  DOSING", snap.pump);
+            snprintf(frame[1], sizeof(frame[1]), "%5.2f/%5.2fg", snap.dosed_g, snap.dose_target_g);
+            break;
+        case CONTROL_HOLD:
+            if (snap.flow_fault_code) {
+                snprintf(frame[0], sizeof(frame[0]), "FLOW FAULT F%02u", (unsigned)snap.flow_fault_code);
+            } else {
+                snprintf(frame[0], sizeof(frame[0]), "Pump %c  HOLD", snap.pump);
+            }
+            snprintf(frame[1], sizeof(frame[1]), "START to resume");
+            break;
+        case CONTROL_ESTOP:
+            snprintf(frame[0], sizeof(frame[0]), "E-STOP!");
+            snprintf(frame[1], sizeof(frame[1]), "START to reset");
+            break;
+    }
+}
+
+void ui_task(void *arg) {
+    (void)arg;
+    snapshot_box_bind(&snapshot_ui);
+    ui_handle = xTaskGetCurrentTaskHandle();
+    ESP_ERROR_CHECK(encoder_init());        // The safety task installed the GPIO ISR service
+    encoder_set_isr_hook(wake_on_detent);
+
+    button_event_t ev;
+
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(UI_PERIOD_MS));
+
+        while (button_events_poll(&ev)) {
+            handle_button(&ev);
+        }
+        if (snapshot_box_take(&snapshot_ui, &snap)) {
+            have_snap = true;
+        }
+        if (priming && have_snap && snap.state != CONTROL_IDLE) {
+            priming = false;                // E-stop: control already dropped the jog
+        }
+
+        int32_t detents = encoder_take();
+        if (priming && detents != 0) {
+            send_jog(COMMAND_JOG, detents);
+        }
+
+        render();
+        if (strcmp(frame[0], shown_line0) != 0) {
+            memcpy(shown_line0, frame[0], sizeof(shown_line0));
+            ESP_LOGI(TAG, "[%-16s|%-16s]", frame[0], frame[1]);
+        }
+    }
+}
@@ -0,0 +1,66 @@
+/**
+ * @file task_web.c
+ * @brief Web task: snapshots -> dashboard state, handed to the httpd task every 100 ms
+ *
+ * Snapshots carry only the active pump; the dashboard shows all four. The
+ * last target / delivered grams of every pump are kept here, so a pump's
+ * bar stays where its dose ended while the next pump runs. Runs on its
+ * own period below UI priority: a burst of browsers delays only this task
+ * and the httpd task, never a snapshot producer.
+ */
+
+#include "app_config.h"
+#include "app_tasks.h"
+
+#include "dashboard.h"
+#include "net_web.h"
+
+static int pump_index(char axis) {
+    switch (axis) {
+        case 'X': return 0;
+        case 'Y': return 1;
+        case 'Z': return 2;
+        case 'A': return 3;
+        default: return -1;
+    }
+}
+
+static void update(dashboard_state_t *d, const snapshot_msg_t *snap) {
+    d->weight_g = snap->scale_g;
+    d->state = (uint8_t)snap->state;
+    d->machine = (uint8_t)snap->machine;
+    d->fault = snap->flow_fault_code;
+    d->doses = snap->doses_completed;
+
+    int p = pump_index(snap->pump);
+    if (p < 0) return;
+    d->pump = (uint8_t)p;
+    bool running = snap->state == CONTROL_DOSING || snap->state == CONTROL_HOLD;
+    for (int i = 0; i < DASHBOARD_PUMPS; i++) {
+        d->pumps[i].active = i == p && snap->state == CONTROL_DOSING;
+    }
+    if (running || snap->dose_target_g != d->pumps[p].target_g) {
+        d->pumps[p].target_g = snap->dose_target_g;
+        d->pumps[p].dispensed_g = snap->dosed_g;
+    }
+}
+
+void web_task(void *arg) {
+    (void)arg;
+    // Not bound to snapshot_web: this task runs on its period, not on pushes
+
+    snapshot_msg_t snap;
+    dashboard_state_t state = {0};
+    bool have_snap = false;
+    TickType_t last_wake = xTaskGetTickCount();
+
+    for (;;) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(WEB_PUSH_PERIOD_MS));
+
+        if (snapshot_box_take(&snapshot_web, &snap)) {
+            update(&state, &snap);
+            have_snap = true;
+        }
+        if (have_snap) net_web_publish(&state);
+    }
+}
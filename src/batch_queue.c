@@ -0,0 +1,412 @@
+/**
+ * @file batch_queue.c
+ * @brief Batch queue: N batches of one or more recipes, pipelined, persisted
+ *
+ * See batch_queue.h for the sequence. Two plan buffers: the one being
+ * streamed and the next batch's, built on the first poll after the
+ * current batch's first line went out. At the end of a batch the buffers
+ * swap, so starting the next batch is a pointer change, not a planning
+ * step. The job list is the only persistent state; plans are rebuilt
+ * from it after a load or a hold.
+ */
+
+#include "batch_queue.h"
+
+#include <stdio.h>
+#include <string.h>
+
+typedef enum {
+    NEXT_NONE = 0,              // Not planned yet
+    NEXT_READY,                 // Planned and checked
+    NEXT_BLOCKED,               // Planned, check() said no
+    NEXT_END,                   // Current batch is the last one
+} next_state_t;
+
+static batch_queue_config_t cfg = BATCH_QUEUE_DEFAULT_CONFIG;
+static batch_queue_state_t state = BATCH_QUEUE_IDLE;
+
+static batch_queue_store_t q;           // Jobs, oldest first: jobs[0] runs
+static bool dirty = false;
+
+static batch_plan_t plans[2];
+static batch_plan_t *cur = NULL;        // Batch jobs[0].done of jobs[0]
+static batch_plan_t *next = NULL;       // The one after it
+static next_state_t next_state = NEXT_NONE;
+
+static uint8_t sent = 0;                // Lines of cur sent
+static uint8_t acked = 0;               // ... answered "ok"
+static bool in_flight = false;
+static int64_t start_us = 0;            // First line of cur
+static int64_t end_us = 0;              // Last batch done, 0 = started from HELD
+static int64_t swap_us = 0;             // Swap wait before cur
+
+static batch_queue_stats_t stats;
+
+static int pump_index(char pump) {
+    const char *p = strchr("XYZA", pump);
+    return p && pump ? (int)(p - "XYZA") : -1;
+}
+
+void batch_queue_init(const batch_queue_config_t *config) {
+    static const batch_queue_config_t defaults = BATCH_QUEUE_DEFAULT_CONFIG;
+    cfg = config ? *config : defaults;
+    memset(&q, 0, sizeof(q));
+    q.version = BATCH_QUEUE_VERSION;
+    q.next_id = 1;
+    dirty = false;
+    state = BATCH_QUEUE_IDLE;
+    cur = &plans[0];
+    next = &plans[1];
+    cur->line_count = 0;
+    next_state = NEXT_NONE;
+    in_flight = false;
+    memset(&stats, 0, sizeof(stats));
+}
+
+void batch_queue_set_swap(batch_swap_t swap, uint32_t swap_ms) {
+    cfg.swap = swap;
+    cfg.swap_ms = swap_ms;
+}
+
+/**
+ * @brief Recipes known and all their steps fit one plan
+ */
+static bool job_valid(const uint8_t *recipes, uint8_t count) {
+    if (count == 0 || count > BATCH_QUEUE_MAX_RECIPES) return false;
+    unsigned steps = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        if (recipes[i] >= cfg.recipe_count) return false;
+        steps += cfg.recipes[recipes[i]].step_count;
+    }
+    return steps > 0 && steps <= BATCH_PLAN_MAX_STEPS;
+}
+
+bool batch_queue_load(const batch_queue_store_t *store) {
+    batch_queue_init(&cfg);
+    if (store->version != BATCH_QUEUE_VERSION || store->count > BATCH_QUEUE_MAX_JOBS) return false;
+    for (uint8_t i = 0; i < store->count; i++) {
+        const batch_job_t *j = &store->jobs[i];
+        if (!job_valid(j->recipes, j->recipe_count) || j->done >= j->batches) return false;
+    }
+    q = *store;
+    if (q.next_id == 0) q.next_id = 1;
+    state = q.count > 0 ? BATCH_QUEUE_HELD : BATCH_QUEUE_IDLE;
+    return true;
+}
+
+bool batch_queue_save(batch_queue_store_t *out) {
+    if (!dirty) return false;
+    dirty = false;
+    *out = q;
+    return true;
+}
+
+uint32_t batch_queue_add(const uint8_t *recipes, uint8_t count, uint16_t batches) {
+    if (q.count == BATCH_QUEUE_MAX_JOBS || batches == 0 || !job_valid(recipes, count)) return 0;
+    batch_job_t *j = &q.jobs[q.count++];
+    memset(j, 0, sizeof(*j));
+    j->id = q.next_id++;
+    if (q.next_id == 0) q.next_id = 1;
+    memcpy(j->recipes, recipes, count);
+    j->recipe_count = count;
+    j->batches = batches;
+    dirty = true;
+    if (state == BATCH_QUEUE_IDLE) state = BATCH_QUEUE_HELD;
+    if (next_state == NEXT_END) next_state = NEXT_NONE;    // The new job follows the current batch
+    return j->id;
+}
+
+bool batch_queue_clear(void) {
+    if (state == BATCH_QUEUE_RUNNING) return false;
+    q.count = 0;
+    dirty = true;
+    state = BATCH_QUEUE_IDLE;
+    cur->line_count = 0;
+    next_state = NEXT_NONE;
+    return true;
+}
+
+/**
+ * @brief Lines and estimate for steps[first_step..], the first one less first_done_mm
+ */
+static void format_lines(batch_plan_t *p) {
+    float est_ms = 0.0f;
+    p->line_count = 0;
+    for (uint8_t s = p->first_step; s < p->step_count; s++) {
+        const batch_move_t *m = &p->steps[s];
+        float mm = s == p->first_step ? m->mm - p->first_done_mm : m->mm;
+        est_ms += mm / m->feed_mm_min * 60000.0f;
+        snprintf(p->lines[p->line_count++], BATCH_PLAN_LINE_MAX, "G92 %c0", m->pump);
+        snprintf(p->lines[p->line_count++], BATCH_PLAN_LINE_MAX, "G1 %c%.2f F%.1f", m->pump, mm, m->feed_mm_min);
+    }
+    snprintf(p->lines[p->line_count++], BATCH_PLAN_LINE_MAX, "G4 P0");     // "ok" once motion is done
+    p->est_ms = (uint32_t)est_ms;
+}
+
+bool batch_queue_plan(const batch_job_t *job, uint16_t batch, batch_plan_t *out) {
+    memset(out, 0, sizeof(*out));
+    out->job_id = job->id;
+    out->batch = batch;
+    out->batches = job->batches;
+    if (!job_valid(job->recipes, job->recipe_count) || cfg.ml_per_mm <= 0.0f) return false;
+
+    for (uint8_t r = 0; r < job->recipe_count; r++) {
+        const batch_recipe_t *recipe = &cfg.recipes[job->recipes[r]];
+        for (uint8_t s = 0; s < recipe->step_count; s++) {
+            const batch_step_t *st = &recipe->steps[s];
+            int p = pump_index(st->pump);
+            if (p < 0) return false;
+            if (st->volume_ml <= 0.0f) continue;            // Pump not used in this recipe
+
+            batch_move_t *m = &out->steps[out->step_count++];
+            m->pump = st->pump;
+            m->recipe = job->recipes[r];
+            m->ml = st->volume_ml;
+            m->mm = st->volume_ml / cfg.ml_per_mm;
+            m->feed_mm_min = st->flow_ml_min / cfg.ml_per_mm;
+            if (cfg.max_feed) {
+                float cap = cfg.max_feed(st->pump);
+                if (cap > 0.0f && m->feed_mm_min > cap) m->feed_mm_min = cap;
+            }
+            if (m->feed_mm_min <= 0.0f) return false;
+            out->ml[p] += m->ml;
+        }
+    }
+    format_lines(out);
+    return out->step_count > 0;
+}
+
+void batch_queue_plan_from(batch_plan_t *plan, uint8_t step, float done_mm) {
+    if (step < plan->step_count && done_mm >= plan->steps[step].mm - 0.005f) {
+        step++;                                     // Less than the G-code resolution left
+        done_mm = 0.0f;
+    }
+    if (step >= plan->step_count || done_mm < 0.0f) done_mm = 0.0f;
+    if (step > plan->step_count) step = plan->step_count;
+    for (uint8_t s = 0; s < step; s++) {
+        plan->ml[pump_index(plan->steps[s].pump)] -= plan->steps[s].ml;
+    }
+    if (step < plan->step_count) plan->ml[pump_index(plan->steps[step].pump)] -= done_mm * cfg.ml_per_mm;
+    plan->first_step = step;
+    plan->first_done_mm = done_mm;
+    format_lines(plan);
+}
+
+/**
+ * @brief Plan batch `batch` of jobs[index] and run check() on it
+ * @return Reason it cannot run, NULL if it can
+ */
+static const char *plan_checked(uint8_t index, uint16_t batch, batch_plan_t *out) {
+    stats.plans++;
+    if (!batch_queue_plan(&q.jobs[index], batch, out)) return "recipe does not fit a batch";
+    return cfg.check ? cfg.check(out) : NULL;
+}
+
+/**
+ * @brief Plan what comes after the current batch (pipelined with its motion)
+ */
+static void plan_next(void) {
+    const batch_job_t *j = &q.jobs[0];
+    uint8_t index = 0;
+    uint16_t batch = j->done + 1;
+    if (batch >= j->batches) {
+        index = 1;
+        batch = q.count > 1 ? q.jobs[1].done : 0;
+    }
+    if (index >= q.count) {
+        next_state = NEXT_END;
+        return;
+    }
+    const char *why = plan_checked(index, batch, next);
+    stats.blocked = why;
+    next_state = why ? NEXT_BLOCKED : NEXT_READY;
+}
+
+static void start(int64_t now_us) {
+    state = BATCH_QUEUE_RUNNING;
+    sent = acked = 0;
+    in_flight = false;
+    swap_us = end_us ? now_us - end_us : 0;
+    if (end_us) stats.swap_us_last = (uint32_t)swap_us;
+    next_state = NEXT_NONE;
+}
+
+/**
+ * @brief Plan the current batch from a standstill (HELD / BLOCKED) and start it
+ */
+static bool run_from(int64_t now_us, uint8_t step, float done_mm) {
+    if (q.count == 0) {
+        state = BATCH_QUEUE_IDLE;
+        return false;
+    }
+    stats.plans++;
+    const char *why = "recipe does not fit a batch";
+    if (batch_queue_plan(&q.jobs[0], q.jobs[0].done, cur)) {
+        if (step > 0 || done_mm > 0.0f) batch_queue_plan_from(cur, step, done_mm);
+        why = cfg.check ? cfg.check(cur) : NULL;
+    }
+    stats.blocked = why;
+    if (why) {
+        state = BATCH_QUEUE_BLOCKED;
+        return false;
+    }
+    end_us = 0;                                     // No gap to measure from a standstill
+    start(now_us);
+    return true;
+}
+
+bool batch_queue_run(int64_t now_us) {
+    switch (state) {
+        case BATCH_QUEUE_SWAP:
+            start(now_us);
+            return true;
+
+        case BATCH_QUEUE_HELD:
+        case BATCH_QUEUE_BLOCKED:
+            return run_from(now_us, 0, 0.0f);
+
+        default:
+            return false;
+    }
+}
+
+bool batch_queue_resume(int64_t now_us, uint8_t step, float done_mm) {
+    if (state != BATCH_QUEUE_HELD && state != BATCH_QUEUE_BLOCKED) return false;
+    return run_from(now_us, step, done_mm);
+}
+
+void batch_queue_hold(void) {
+    if (state == BATCH_QUEUE_IDLE || state == BATCH_QUEUE_HELD) return;
+    state = BATCH_QUEUE_HELD;
+    in_flight = false;
+    next_state = NEXT_NONE;
+    stats.holds++;
+}
+
+/**
+ * @brief Last "ok" of a batch: count it, move on to the next one
+ */
+static void complete(int64_t now_us) {
+    if (cfg.finished) cfg.finished(cur, now_us);
+    stats.batches_done++;
+    batch_job_t *j = &q.jobs[0];
+    if (++j->done >= j->batches) {
+        q.count--;
+        memmove(&q.jobs[0], &q.jobs[1], q.count * sizeof(q.jobs[0]));
+    }
+    dirty = true;
+    end_us = now_us;
+
+    if (q.count == 0) {
+        state = BATCH_QUEUE_IDLE;
+        cur->line_count = 0;
+        next_state = NEXT_NONE;
+        return;
+    }
+    if (next_state != NEXT_READY && next_state != NEXT_BLOCKED) {
+        // Batch shorter than one poll: jobs[0].done is the next batch by now
+        const char *why = plan_checked(0, q.jobs[0].done, next);
+        stats.blocked = why;
+        next_state = why ? NEXT_BLOCKED : NEXT_READY;
+    }
+    batch_plan_t *t = cur;
+    cur = next;
+    next = t;
+    bool blocked = next_state == NEXT_BLOCKED;
+    next_state = NEXT_NONE;
+    if (blocked) {
+        state = BATCH_QUEUE_BLOCKED;
+        return;
+    }
+    if (cfg.swap == BATCH_SWAP_NONE) {
+        start(now_us);
+    } else {
+        state = BATCH_QUEUE_SWAP;
+    }
+}
+
+bool batch_queue_on_line(const char *line, int64_t now_us) {
+    if (state != BATCH_QUEUE_RUNNING || !in_flight) return false;
+    if (strcmp(line, "ok") == 0) {
+        in_flight = false;
+        if (++acked == cur->line_count) complete(now_us);
+        return true;
+    }
+    if (strncmp(line, "error", 5) == 0) {
+        in_flight = false;
+        stats.errors++;
+        batch_queue_hold();
+        return true;
+    }
+    return false;
+}
+
+const char *batch_queue_poll(int64_t now_us) {
+    if (state == BATCH_QUEUE_SWAP && cfg.swap == BATCH_SWAP_TIMED &&
+        now_us - end_us >= (int64_t)cfg.swap_ms * 1000) {
+        start(now_us);
+    }
+    if (state != BATCH_QUEUE_RUNNING) return NULL;
+
+    if (sent > 0 && next_state == NEXT_NONE) plan_next();     // Current batch underway
+    if (in_flight || sent >= cur->line_count) return NULL;
+
+    if (sent == 0) {
+        start_us = now_us;
+        if (end_us) {
+            stats.gap_us_last = (uint32_t)(now_us - end_us - swap_us);
+            if (stats.gap_us_last > stats.gap_us_max) stats.gap_us_max = stats.gap_us_last;
+        }
+        if (cfg.started) cfg.started(cur, now_us);
+    }
+    in_flight = true;
+    stats.lines_sent++;
+    return cur->lines[sent++];
+}
+
+batch_queue_state_t batch_queue_state(void) {
+    return state;
+}
+
+const char *batch_queue_state_name(batch_queue_state_t s) {
+    static const char *const names[] = {"IDLE", "HELD", "RUNNING", "SWAP", "BLOCKED"};
+    return s <= BATCH_QUEUE_BLOCKED ? names[s] : "?";
+}
+
+const batch_plan_t *batch_queue_current(void) {
+    return state == BATCH_QUEUE_IDLE || cur->line_count == 0 ? NULL : cur;
+}
+
+uint8_t batch_queue_step(int64_t now_us) {
+    if (state != BATCH_QUEUE_RUNNING) return state == BATCH_QUEUE_SWAP ? cur->step_count : 0;
+
+    // Steps sit in FluidNC's planner ahead of the motion: go by the planned
+    // durations, but never past the last G1 FluidNC has accepted
+    uint8_t accepted = acked / 2;
+    uint8_t limit = cur->first_step + (accepted > 0 ? accepted - 1 : 0);
+    float elapsed_ms = sent > 0 ? (float)(now_us - start_us) / 1000.0f : 0.0f;
+    uint8_t step = cur->first_step;
+    for (float t = 0.0f; step < limit; step++) {
+        const batch_move_t *m = &cur->steps[step];
+        float mm = step == cur->first_step ? m->mm - cur->first_done_mm : m->mm;
+        t += mm / m->feed_mm_min * 60000.0f;
+        if (elapsed_ms < t) break;
+    }
+    return step;
+}
+
+const batch_job_t *batch_queue_job(uint8_t index) {
+    return index < q.count ? &q.jobs[index] : NULL;
+}
+
+uint32_t batch_queue_remaining(void) {
+    uint32_t n = 0;
+    for (uint8_t i = 0; i < q.count; i++) n += q.jobs[i].batches - q.jobs[i].done;
+    return n;
+}
+
+void batch_queue_get_stats(batch_queue_stats_t *out) {
+    *out = stats;
+    out->state = state;
+    out->next_ready = next_state == NEXT_READY;
+}
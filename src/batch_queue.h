@@ -0,0 +1,284 @@
+/**
+ * @file batch_queue.h
+ * @brief Batch queue: N batches of one or more recipes, pipelined, persisted
+ *
+ * The sketches used to run one recipe, sit on a completion screen for 2-3 s
+ * and go back to browsing; each batch of a shift cost a selection, a start
+ * screen and a settle pause per step. Here batches are queued as jobs
+ * ("40 x Color Mix + Nutrient Mix") and run back to back:
+ *
+ *   HELD --run()--> RUNNING --last "ok"--> SWAP --run() / swap_ms--> RUNNING ...
+ *                      |                                               |
+ *                      +-- next batch planned and checked meanwhile ---+
+ *
+ * - A batch is streamed send-response: the next line goes out on the "ok"
+ *   to the previous one, so FluidNC plans step N+1 while step N runs and
+ *   the pumps go from one step to the next without stopping. The batch
+ *   ends with "G4 P0", whose "ok" FluidNC only sends once all motion is
+ *   done - no polling for Idle, no settle pauses.
+ * - As soon as a batch is underway the next one is planned (G-code
+ *   formatted, feeds capped) and checked (the caller's check(), e.g.
+ *   stock) while the pumps run. A batch that cannot run is reported while
+ *   the one before it is still dispensing, not after.
+ * - Between batches the container is swapped: BATCH_SWAP_CONFIRM waits for
+ *   run() (START / console), BATCH_SWAP_TIMED for swap_ms (a conveyor),
+ *   BATCH_SWAP_NONE goes straight on (one container for the whole job).
+ * - The job list is plain data (batch_queue_store_t) saved by the caller
+ *   whenever batch_queue_save() says it changed: on add, clear and batch
+ *   completion - one small write per batch. After a reboot the queue is
+ *   loaded HELD: nothing moves before the operator has checked the
+ *   container. The batch that was running was not counted done: run()
+ *   starts it again, resume() continues it from a journaled position
+ *   (dose_journal.h).
+ *
+ * RULES:
+ * - Nothing else may be in flight while RUNNING: the "ok" lines are
+ *   consumed by batch_queue_on_line().
+ * - On a stop, reset or alarm call batch_queue_hold(); an "error" reply
+ *   holds the queue by itself.
+ * - Recipes are referenced by index: keep the table order when adding
+ *   recipes, or clear the stored queue.
+ *
+ * Shared by the firmware and the host tools; does not depend on ESP-IDF.
+ *
+ * Usage:
+ *   batch_queue_config_t cfg = BATCH_QUEUE_DEFAULT_CONFIG;
+ *   cfg.recipes = table; cfg.recipe_count = n;
+ *   batch_queue_init(&cfg);
+ *   if (stored) batch_queue_load(&stored);
+ *   batch_queue_add(ids, 2, 40);  batch_queue_run(now_us);
+ *   loop():
+ *     if (!batch_queue_on_line(line, now_us)) handle(line);
+ *     if ((line = batch_queue_poll(now_us))) send(line);
+ *     if (batch_queue_save(&store)) write store;
+ */
+
+#ifndef BATCH_QUEUE_H
+#define BATCH_QUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BATCH_QUEUE_MAX_JOBS        8
+#define BATCH_QUEUE_MAX_RECIPES     4       // Recipes per batch, run into the same container
+#define BATCH_QUEUE_VERSION         1       // Layout of batch_queue_store_t
+#define BATCH_PLAN_MAX_STEPS        16
+#define BATCH_PLAN_MAX_LINES        (2 * BATCH_PLAN_MAX_STEPS + 1)     // G92 + G1 per step, "G4 P0"
+#define BATCH_PLAN_LINE_MAX         32
+#define BATCH_PLAN_PUMPS            4       // X Y Z A
+
+typedef struct {
+    char pump;                  // 'X' 'Y' 'Z' 'A'
+    float volume_ml;
+    float flow_ml_min;
+} batch_step_t;
+
+typedef struct {
+    const char *name;
+    const batch_step_t *steps;
+    uint8_t step_count;
+} batch_recipe_t;
+
+typedef struct {
+    uint32_t id;
+    uint8_t recipes[BATCH_QUEUE_MAX_RECIPES];   // Indexes into the recipe table
+    uint8_t recipe_count;
+    uint16_t batches;           // Ordered
+    uint16_t done;              // Completed
+} batch_job_t;
+
+/** Plain data: stored as one blob */
+typedef struct {
+    uint32_t version;           // BATCH_QUEUE_VERSION
+    uint32_t next_id;
+    uint8_t count;
+    batch_job_t jobs[BATCH_QUEUE_MAX_JOBS];     // Oldest first
+} batch_queue_store_t;
+
+typedef struct {
+    char pump;
+    uint8_t recipe;             // Index into the recipe table
+    float ml;
+    float mm;
+    float feed_mm_min;          // Capped
+} batch_move_t;
+
+/** One batch, ready to stream */
+typedef struct {
+    uint32_t job_id;
+    uint16_t batch;             // 0-based within the job
+    uint16_t batches;
+    uint8_t step_count;
+    batch_move_t steps[BATCH_PLAN_MAX_STEPS];
+    float ml[BATCH_PLAN_PUMPS];     // Per pump, for check()
+    uint32_t est_ms;            // At the planned feeds, acceleration ignored
+    uint8_t first_step;         // Resumed batch: steps before this one are done ...
+    float first_done_mm;        // ... and this much of it; lines and est_ms cover the rest
+    uint8_t line_count;
+    char lines[BATCH_PLAN_MAX_LINES][BATCH_PLAN_LINE_MAX];
+} batch_plan_t;
+
+typedef enum {
+    BATCH_SWAP_NONE = 0,        // Next batch at once (same container)
+    BATCH_SWAP_CONFIRM,         // Wait for batch_queue_run()
+    BATCH_SWAP_TIMED,           // Wait swap_ms (run() goes early)
+} batch_swap_t;
+
+typedef struct {
+    const batch_recipe_t *recipes;
+    uint8_t recipe_count;
+    float ml_per_mm;
+    float (*max_feed)(char pump);                   // mm/min cap, NULL = none
+    const char *(*check)(const batch_plan_t *plan); // NULL = can run, else why not
+    void (*started)(const batch_plan_t *plan, int64_t now_us);     // First line going out, NULL = none
+    void (*finished)(const batch_plan_t *plan, int64_t now_us);    // Last "ok": motion done, NULL = none
+    batch_swap_t swap;
+    uint32_t swap_ms;
+} batch_queue_config_t;
+
+#define BATCH_QUEUE_DEFAULT_CONFIG { \
+    .recipes = NULL, \
+    .recipe_count = 0, \
+    .ml_per_mm = 0.05f, \
+    .max_feed = NULL, \
+    .check = NULL, \
+    .started = NULL, \
+    .finished = NULL, \
+    .swap = BATCH_SWAP_CONFIRM, \
+    .swap_ms = 0, \
+}
+
+typedef enum {
+    BATCH_QUEUE_IDLE = 0,       // Nothing queued
+    BATCH_QUEUE_HELD,           // Queued, waiting for run() (also after load, hold or an error)
+    BATCH_QUEUE_RUNNING,        // Streaming the current batch
+    BATCH_QUEUE_SWAP,           // Batch done, container swap
+    BATCH_QUEUE_BLOCKED,        // Next batch failed check(): fix it, then run()
+} batch_queue_state_t;
+
+typedef struct {
+    batch_queue_state_t state;
+    uint32_t batches_done;
+    uint32_t lines_sent;
+    uint32_t errors;            // "error" replies
+    uint32_t holds;
+    uint32_t plans;             // Plans built (and checked)
+    uint32_t gap_us_last;       // Batch done -> next batch's first line, swap wait excluded
+    uint32_t gap_us_max;
+    uint32_t swap_us_last;      // Container swap wait
+    bool next_ready;            // Next batch planned and checked
+    const char *blocked;        // check() reason for the next batch, NULL if none
+} batch_queue_stats_t;
+
+/**
+ * @brief Load the config (NULL = BATCH_QUEUE_DEFAULT_CONFIG), empty queue, IDLE
+ */
+void batch_queue_init(const batch_queue_config_t *config);
+
+/**
+ * @brief Swap handshake from now on (the next batch boundary)
+ */
+void batch_queue_set_swap(batch_swap_t swap, uint32_t swap_ms);
+
+/**
+ * @brief Restore a stored queue; HELD if it has work
+ * @return false (queue left empty) on a wrong version or unknown recipe
+ */
+bool batch_queue_load(const batch_queue_store_t *store);
+
+/**
+ * @brief Copy of the queue if it changed since the last call
+ * @return true if *out should be written
+ */
+bool batch_queue_save(batch_queue_store_t *out);
+
+/**
+ * @brief Queue a job: `batches` batches of recipes[0..count-1], in that order
+ * @return Job id, 0 if the queue is full or the job is invalid
+ */
+uint32_t batch_queue_add(const uint8_t *recipes, uint8_t count, uint16_t batches);
+
+/**
+ * @brief Drop every job
+ * @return false while RUNNING (hold first)
+ */
+bool batch_queue_clear(void);
+
+/**
+ * @brief Start, continue after a hold or a block, or confirm the container swap
+ * @return false if there is nothing to run, the batch failed check(), or already RUNNING
+ */
+bool batch_queue_run(int64_t now_us);
+
+/**
+ * @brief As run() from HELD or BLOCKED, but continue the current batch part-way
+ *
+ * Steps before `step` are skipped and `done_mm` of it is taken off (a
+ * journaled position, see dose_journal.h); check() sees the remaining ml.
+ * @return false if not HELD / BLOCKED, nothing to run, or the rest failed check()
+ */
+bool batch_queue_resume(int64_t now_us, uint8_t step, float done_mm);
+
+/**
+ * @brief Stop streaming (the caller stops the motion); run() starts the batch again, resume() continues it
+ */
+void batch_queue_hold(void);
+
+/**
+ * @brief Every line that is not a status report
+ * @return true if it was the reply to a batch line
+ */
+bool batch_queue_on_line(const char *line, int64_t now_us);
+
+/**
+ * @brief Line to send now (no terminator), or NULL; also plans the next batch
+ */
+const char *batch_queue_poll(int64_t now_us);
+
+batch_queue_state_t batch_queue_state(void);
+const char *batch_queue_state_name(batch_queue_state_t state);
+
+/**
+ * @brief Batch being run or about to run (NULL if none planned)
+ */
+const batch_plan_t *batch_queue_current(void);
+
+/**
+ * @brief Step of the current batch the pumps are on (0-based, step_count when done)
+ *
+ * Estimated from the planned feeds (acceleration ignored): for the display.
+ */
+uint8_t batch_queue_step(int64_t now_us);
+
+/**
+ * @brief Queued job by position (0 = running / next), NULL past the end
+ */
+const batch_job_t *batch_queue_job(uint8_t index);
+
+/**
+ * @brief Batches still to run, over all jobs
+ */
+uint32_t batch_queue_remaining(void);
+
+void batch_queue_get_stats(batch_queue_stats_t *out);
+
+/**
+ * @brief Plan a batch of a job (no check()); used for the next batch and by tools
+ * @return false if a recipe is unknown or the steps do not fit
+ */
+bool batch_queue_plan(const batch_job_t *job, uint16_t batch, batch_plan_t *out);
+
+/**
+ * @brief Cut a plan down to what is left from `step`, `done_mm` into it (lines, est_ms, ml)
+ */
+void batch_queue_plan_from(batch_plan_t *plan, uint8_t step, float done_mm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BATCH_QUEUE_H
@@ -0,0 +1,134 @@
+/**
+ * @file boot_seq.c
+ * @brief Boot sequencer: overlapping start-up stages, readiness instead of sleeps
+ *
+ * See boot_seq.h. One pass of boot_seq_poll() walks the table once: a
+ * stage started in this pass is also checked in it, so a chain of
+ * stages that are ready at once settles in a single call.
+ */
+
+#include "boot_seq.h"
+
+#include <stdio.h>
+#include <string.h>
+
+static const boot_stage_t *table = NULL;
+static size_t stage_count = 0;
+static boot_stage_timing_t timing[BOOT_SEQ_MAX_STAGES];
+static bool done = false;
+static int64_t done_us = 0;
+
+bool boot_seq_init(const boot_stage_t *stages, size_t count) {
+    if (count > BOOT_SEQ_MAX_STAGES) return false;
+    table = stages;
+    stage_count = count;
+    memset(timing, 0, sizeof(timing));
+    done = false;
+    done_us = 0;
+    return true;
+}
+
+static bool settled(size_t i) {
+    return timing[i].state >= BOOT_STAGE_READY;
+}
+
+static bool deps_settled(uint32_t deps) {
+    for (size_t i = 0; i < stage_count; i++) {
+        if ((deps & (1u << i)) && !settled(i)) return false;
+    }
+    return true;
+}
+
+static void settle(size_t i, boot_stage_state_t state, int64_t now_us) {
+    timing[i].state = state;
+    timing[i].end_us = now_us;
+}
+
+bool boot_seq_poll(int64_t now_us) {
+    if (done) return true;
+
+    bool all = true;
+    for (size_t i = 0; i < stage_count; i++) {
+        const boot_stage_t *s = &table[i];
+        boot_stage_timing_t *t = &timing[i];
+
+        if (t->state == BOOT_STAGE_WAITING && deps_settled(s->deps)) {
+            t->begin_us = now_us;
+            if (s->begin != NULL && !s->begin()) {
+                settle(i, BOOT_STAGE_FAILED, now_us);
+            } else {
+                t->state = BOOT_STAGE_RUNNING;
+            }
+        }
+        if (t->state == BOOT_STAGE_RUNNING) {
+            t->polls++;
+            if (s->ready == NULL || s->ready()) {
+                settle(i, BOOT_STAGE_READY, now_us);
+            } else if (s->timeout_ms > 0 && now_us - t->begin_us > (int64_t)s->timeout_ms * 1000) {
+                settle(i, BOOT_STAGE_TIMEOUT, now_us);
+            }
+        }
+        all &= settled(i);
+    }
+    if (all) {
+        done = true;
+        done_us = now_us;
+    }
+    return all;
+}
+
+bool boot_seq_done(void) {
+    return done;
+}
+
+int64_t boot_seq_done_us(void) {
+    return done_us;
+}
+
+boot_stage_state_t boot_seq_stage_state(size_t index) {
+    return index < stage_count ? timing[index].state : BOOT_STAGE_WAITING;
+}
+
+void boot_seq_get_timing(size_t index, boot_stage_timing_t *out) {
+    if (index < stage_count) {
+        *out = timing[index];
+    } else {
+        memset(out, 0, sizeof(*out));
+    }
+}
+
+const char *boot_seq_state_name(boot_stage_state_t state) {
+    static const char *const names[] = {"waiting", "running", "ready", "FAILED", "TIMEOUT"};
+    return state <= BOOT_STAGE_TIMEOUT ? names[state] : "?";
+}
+
+size_t boot_seq_format(char *buf, size_t size) {
+    size_t n = 0;
+    if (size == 0) return 0;
+    buf[0] = '\0';
+
+#define APPEND(...)                                                     \
+    do {                                                                \
+        if (n < size) {                                                 \
+            int w = snprintf(buf + n, size - n, __VA_ARGS__);           \
+            n = w < 0 ? n : (n + (size_t)w < size ? n + (size_t)w : size - 1); \
+        }                                                               \
+    } while (0)
+
+    APPEND("  %-10s %9s %9s %9s\n", "stage", "start ms", "ready ms", "took ms");
+    for (size_t i = 0; i < stage_count; i++) {
+        const boot_stage_timing_t *t = &timing[i];
+        if (t->state == BOOT_STAGE_WAITING) {
+            APPEND("  %-10s %9s\n", table[i].name, "-");
+        } else if (t->state == BOOT_STAGE_RUNNING) {
+            APPEND("  %-10s %9.1f %9s\n", table[i].name, t->begin_us / 1000.0, "...");
+        } else {
+            APPEND("  %-10s %9.1f %9.1f %9.1f%s%s\n", table[i].name, t->begin_us / 1000.0, t->end_us / 1000.0,
+                   (t->end_us - t->begin_us) / 1000.0, t->state == BOOT_STAGE_READY ? "" : "  ",
+                   t->state == BOOT_STAGE_READY ? "" : boot_seq_state_name(t->state));
+        }
+    }
+    if (done) APPEND("  all settled at %.1f ms\n", done_us / 1000.0);
+#undef APPEND
+    return n;
+}
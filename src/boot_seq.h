@@ -0,0 +1,112 @@
+/**
+ * @file boot_seq.h
+ * @brief Boot sequencer: overlapping start-up stages, readiness instead of sleeps
+ *
+ * A sketch used to come up one peripheral at a time with a fixed sleep
+ * after each (Serial 500 ms, LEDs 50 ms, 1 s before the first '?'), so it
+ * took seconds to accept input after a power cycle. Here every peripheral
+ * is a stage with a non-blocking begin() and a ready() check:
+ *
+ *   stage      begin()                     ready()
+ *   uart       UART + e-stop armed         -
+ *   lcd        probe cached address first  -
+ *   fluidnc    send '?'                    first line back (report or banner)
+ *
+ * boot_seq_poll() starts every stage whose dependencies have settled and
+ * checks the running ones, so waits overlap: FluidNC can still be booting
+ * while the display comes up, and the loop is already serving STOP and the
+ * console. A stage that is not ready within timeout_ms is given up on
+ * (TIMEOUT) and its dependents start anyway - a missing display must not
+ * keep the pumps from running.
+ *
+ * Each stage's start and ready times (esp_timer, i.e. since reset) make up
+ * the boot timeline.
+ *
+ * RULES:
+ * - begin() and ready() must not block; anything slow is started in
+ *   begin() and finished by repeated ready() calls.
+ * - Stages are started in table order among those whose deps have
+ *   settled; put the safety stage (STOP armed) first.
+ *
+ * Shared by the firmware and the host tools; does not depend on ESP-IDF.
+ *
+ * Usage:
+ *   static const boot_stage_t stages[] = {
+ *       {"uart", beginUart, NULL, 0, 0},
+ *       {"fluidnc", askFluidnc, fluidncAnswered, BOOT_DEP(0), 1000},
+ *   };
+ *   boot_seq_init(stages, 2);
+ *   loop(): if (boot_seq_poll(now_us) && !reported) boot_seq_format(buf, sizeof(buf));
+ */
+
+#ifndef BOOT_SEQ_H
+#define BOOT_SEQ_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BOOT_SEQ_MAX_STAGES     16
+#define BOOT_DEP(i)             (1u << (i))
+
+typedef struct {
+    const char *name;
+    bool (*begin)(void);        // false = failed (dependents still start)
+    bool (*ready)(void);        // NULL = ready as soon as begin() returns true
+    uint32_t deps;              // BOOT_DEP() of stages that must settle first
+    uint32_t timeout_ms;        // begin() -> ready(); 0 = wait forever
+} boot_stage_t;
+
+typedef enum {
+    BOOT_STAGE_WAITING = 0,     // Dependencies not settled
+    BOOT_STAGE_RUNNING,         // begin() done, not ready yet
+    BOOT_STAGE_READY,
+    BOOT_STAGE_FAILED,          // begin() returned false
+    BOOT_STAGE_TIMEOUT,         // Not ready within timeout_ms
+} boot_stage_state_t;
+
+typedef struct {
+    boot_stage_state_t state;
+    int64_t begin_us;           // esp_timer time begin() was called
+    int64_t end_us;             // ... settled
+    uint32_t polls;             // ready() calls
+} boot_stage_timing_t;
+
+/**
+ * @brief Take a stage table (kept by reference); nothing starts until the first poll
+ * @return false if there are more than BOOT_SEQ_MAX_STAGES stages
+ */
+bool boot_seq_init(const boot_stage_t *stages, size_t count);
+
+/**
+ * @brief Start what can start, check what is running
+ * @return true once every stage has settled (READY, FAILED or TIMEOUT)
+ */
+bool boot_seq_poll(int64_t now_us);
+
+bool boot_seq_done(void);
+
+/**
+ * @brief esp_timer time the last stage settled (0 while running)
+ */
+int64_t boot_seq_done_us(void);
+
+boot_stage_state_t boot_seq_stage_state(size_t index);
+void boot_seq_get_timing(size_t index, boot_stage_timing_t *out);
+const char *boot_seq_state_name(boot_stage_state_t state);
+
+/**
+ * @brief Timeline as text: one line per stage, in ms since reset
+ * @return Length written (truncated to fit)
+ */
+size_t boot_seq_format(char *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BOOT_SEQ_H
@@ -0,0 +1,241 @@
+/**
+ * @file button_events.c
+ * @brief Interrupt-driven, non-blocking button event engine
+ *
+ * See button_events.h for the design overview.
+ */
+
+#include "button_events.h"
+
+#include "driver/gpio.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "hal/gpio_ll.h"
+#include "pin_definitions.h"
+#include "spsc_ring.h"
+
+typedef enum {
+    BTN_STATE_RELEASED = 0,
+    BTN_STATE_PRESS_DEBOUNCE,
+    BTN_STATE_PRESSED,
+    BTN_STATE_RELEASE_DEBOUNCE
+} btn_state_t;
+
+typedef struct {
+    gpio_num_t pin;
+    const char *name;
+    btn_state_t state;
+    bool repeat_enabled;
+    bool long_sent;
+    int64_t edge_us;            // Edge that started the current debounce
+    int64_t press_us;           // Confirmed press time
+    int64_t next_repeat_us;     // Next REPEAT deadline while held
+} btn_t;
+
+static btn_t buttons[BUTTON_COUNT] = {
+    [BUTTON_START]  = {.pin = START_BUTTON_PIN, .name = "START"},
+    [BUTTON_MODE]   = {.pin = MODE_BUTTON_PIN,  .name = "MODE"},
+    [BUTTON_STOP]   = {.pin = STOP_BUTTON_PIN,  .name = "STOP"},
+    [BUTTON_SELECT] = {.pin = ENCODER_SW_PIN,   .name = "SELECT"},
+};
+
+// Written by the GPIO ISR, consumed by the timer tick
+static volatile button_isr_hook_t isr_hooks[BUTTON_COUNT];
+static volatile int64_t isr_edge_us[BUTTON_COUNT];
+static volatile uint32_t isr_pending_mask = 0;
+
+// Event rings: STOP gets its own lane so it is never queued behind others
+static button_event_t stop_storage[BUTTON_QUEUE_DEPTH];
+static button_event_t event_storage[BUTTON_QUEUE_DEPTH];
+static spsc_ring_t stop_ring;
+static spsc_ring_t event_ring;
+
+static volatile uint8_t pressed_mask = 0;
+static esp_timer_handle_t tick_timer = NULL;
+
+/**
+ * @brief Register read: gpio_get_level() is in flash, and the ISR runs with the cache off during flash writes
+ */
+static inline bool IRAM_ATTR read_pressed(const btn_t *btn) {
+    return gpio_ll_get_level(&GPIO, btn->pin) == 0;     // Active LOW
+}
+
+/**
+ * @brief Edge ISR - timestamp the edge and flag the button; no debouncing here
+ */
+static void IRAM_ATTR button_isr(void *arg) {
+    int64_t now = esp_timer_get_time();
+    uint32_t id = (uint32_t)(uintptr_t)arg;
+    button_isr_hook_t hook = isr_hooks[id];
+    if (hook != NULL) {
+        hook(read_pressed(&buttons[id]), now);
+    }
+    isr_edge_us[id] = now;
+    __atomic_fetch_or(&isr_pending_mask, 1u << id, __ATOMIC_RELEASE);
+}
+
+static void emit(button_id_t id, button_event_type_t type, int64_t at_us, int64_t held_us) {
+    button_event_t ev = {
+        .button = id,
+        .type = type,
+        .time_ms = (uint32_t)(at_us / 1000),
+        .held_ms = (uint32_t)(held_us / 1000),
+    };
+    spsc_ring_push(id == BUTTON_STOP ? &stop_ring : &event_ring, &ev);
+}
+
+/**
+ * @brief Advance one button's debounce state machine
+ */
+static void step_button(button_id_t id, int64_t now, bool edge_seen, int64_t edge_us) {
+    btn_t *btn = &buttons[id];
+    bool level = read_pressed(btn);
+    const int64_t settle_us = (int64_t)BUTTON_DEBOUNCE_MS * 1000;
+
+    switch (btn->state) {
+        case BTN_STATE_RELEASED:
+            if (level || edge_seen) {
+                btn->state = BTN_STATE_PRESS_DEBOUNCE;
+                btn->edge_us = edge_seen ? edge_us : now;
+            }
+            break;
+
+        case BTN_STATE_PRESS_DEBOUNCE:
+            if (!level) {
+                btn->state = BTN_STATE_RELEASED;    // Bounce or glitch
+            } else if (now - btn->edge_us >= settle_us) {
+                btn->state = BTN_STATE_PRESSED;
+                btn->press_us = btn->edge_us;
+                btn->long_sent = false;
+                pressed_mask |= (uint8_t)(1u << id);
+                emit(id, BUTTON_EVENT_PRESS, btn->press_us, 0);
+            }
+            break;
+
+        case BTN_STATE_PRESSED:
+            if (!level) {
+                btn->state = BTN_STATE_RELEASE_DEBOUNCE;
+                btn->edge_us = edge_seen ? edge_us : now;
+            } else if (!btn->long_sent && now - btn->press_us >= (int64_t)BUTTON_LONG_PRESS_MS * 1000) {
+                btn->long_sent = true;
+                btn->next_repeat_us = now + (int64_t)BUTTON_REPEAT_MS * 1000;
+                emit(id, BUTTON_EVENT_LONG_PRESS, now, now - btn->press_us);
+            } else if (btn->long_sent && btn->repeat_enabled && now >= btn->next_repeat_us) {
+                btn->next_repeat_us += (int64_t)BUTTON_REPEAT_MS * 1000;
+                emit(id, BUTTON_EVENT_REPEAT, now, now - btn->press_us);
+            }
+            break;
+
+        case BTN_STATE_RELEASE_DEBOUNCE:
+            if (level) {
+                btn->state = BTN_STATE_PRESSED;     // Bounce while held
+            } else if (now - btn->edge_us >= settle_us) {
+                btn->state = BTN_STATE_RELEASED;
+                pressed_mask &= (uint8_t)~(1u << id);
+                emit(id, BUTTON_EVENT_RELEASE, btn->edge_us, btn->edge_us - btn->press_us);
+            }
+            break;
+    }
+}
+
+/**
+ * @brief Periodic tick (esp_timer task context) - runs every button's state machine
+ */
+static void button_tick(void *arg) {
+    (void)arg;
+    int64_t now = esp_timer_get_time();
+    uint32_t pending = __atomic_exchange_n(&isr_pending_mask, 0, __ATOMIC_ACQUIRE);
+
+    // STOP first so its event is timestamped and queued before anything else
+    step_button(BUTTON_STOP, now, pending & (1u << BUTTON_STOP), isr_edge_us[BUTTON_STOP]);
+    for (int id = 0; id < BUTTON_COUNT; id++) {
+        if (id == BUTTON_STOP) continue;
+        step_button((button_id_t)id, now, pending & (1u << id), isr_edge_us[id]);
+    }
+}
+
+esp_err_t button_events_init(void) {
+    spsc_ring_init(&stop_ring, stop_storage, sizeof(button_event_t), BUTTON_QUEUE_DEPTH);
+    spsc_ring_init(&event_ring, event_storage, sizeof(button_event_t), BUTTON_QUEUE_DEPTH);
+
+    // Shared GPIO ISR service at level 3; may already exist if attachInterrupt() ran first
+    esp_err_t err = gpio_install_isr_service(ESP_INTR_FLAG_IRAM | ESP_INTR_FLAG_LEVEL3);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+        return err;
+    }
+
+    for (int id = 0; id < BUTTON_COUNT; id++) {
+        btn_t *btn = &buttons[id];
+        gpio_config_t io_conf = {
+            .pin_bit_mask = (1ULL << btn->pin),
+            .mode = GPIO_MODE_INPUT,
+            // GPIO 34-39 are input-only and have no internal pull-up
+            .pull_up_en = GPIO_IS_VALID_OUTPUT_GPIO(btn->pin) ? GPIO_PULLUP_ENABLE : GPIO_PULLUP_DISABLE,
+            .pull_down_en = GPIO_PULLDOWN_DISABLE,
+            .intr_type = GPIO_INTR_ANYEDGE
+        };
+        err = gpio_config(&io_conf);
+        if (err != ESP_OK) return err;
+
+        btn->state = read_pressed(btn) ? BTN_STATE_PRESS_DEBOUNCE : BTN_STATE_RELEASED;
+        btn->edge_us = esp_timer_get_time();
+
+        err = gpio_isr_handler_add(btn->pin, button_isr, (void *)(uintptr_t)id);
+        if (err != ESP_OK) return err;
+    }
+
+    if (tick_timer == NULL) {
+        const esp_timer_create_args_t timer_args = {
+            .callback = button_tick,
+            .arg = NULL,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "button_tick",
+            .skip_unhandled_events = true
+        };
+        err = esp_timer_create(&timer_args, &tick_timer);
+        if (err != ESP_OK) return err;
+        err = esp_timer_start_periodic(tick_timer, BUTTON_TICK_MS * 1000);
+    }
+
+    return err;
+}
+
+bool button_events_poll(button_event_t *ev) {
+    if (spsc_ring_pop(&stop_ring, ev)) {
+        return true;
+    }
+    return spsc_ring_pop(&event_ring, ev);
+}
+
+bool button_events_is_pressed(button_id_t button) {
+    if (button >= BUTTON_COUNT) return false;
+    return (pressed_mask & (1u << button)) != 0;
+}
+
+void button_events_set_isr_hook(button_id_t button, button_isr_hook_t hook) {
+    if (button >= BUTTON_COUNT) return;
+    isr_hooks[button] = hook;
+}
+
+void button_events_set_repeat(button_id_t button, bool enable) {
+    if (button >= BUTTON_COUNT) return;
+    buttons[button].repeat_enabled = enable;
+}
+
+uint32_t button_events_dropped(void) {
+    return stop_ring.dropped + event_ring.dropped;
+}
+
+const char *button_name(button_id_t button) {
+    return button < BUTTON_COUNT ? buttons[button].name : "?";
+}
+
+const char *button_event_name(button_event_type_t type) {
+    switch (type) {
+        case BUTTON_EVENT_PRESS:      return "PRESS";
+        case BUTTON_EVENT_RELEASE:    return "RELEASE";
+        case BUTTON_EVENT_LONG_PRESS: return "LONG_PRESS";
+        case BUTTON_EVENT_REPEAT:     return "REPEAT";
+    }
+    return "?";
+}
@@ -0,0 +1,124 @@
+/**
+ * @file button_events.h
+ * @brief Interrupt-driven, non-blocking button event engine
+ *
+ * Replaces the blocking debounce loops in the test sketches
+ * (delay(200) + "while (pressed) delay(10)" and readEncoderButton()'s
+ * delay(50)). Nothing in this module ever blocks the caller.
+ *
+ * HOW IT WORKS:
+ * - GPIO ISR (any edge) timestamps the edge and flags the button
+ * - esp_timer tick (BUTTON_TICK_MS) runs one debounce state machine per
+ *   button and emits PRESS / RELEASE / LONG_PRESS / REPEAT events
+ * - Events go into lock-free rings (spsc_ring.h); STOP has its own ring
+ *   that button_events_poll() always drains first, so a STOP press is
+ *   never queued behind a held SELECT or a burst of REPEAT events
+ *
+ * Usage (Arduino sketch):
+ *   button_events_init();                    // instead of pinMode() on buttons
+ *   button_event_t ev;
+ *   while (button_events_poll(&ev)) { ... }  // in loop()
+ */
+
+#ifndef BUTTON_EVENTS_H
+#define BUTTON_EVENTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// TIMING
+// ============================================================================
+#define BUTTON_TICK_MS          2           // Debounce state machine period
+#define BUTTON_LONG_PRESS_MS    800         // Hold time before LONG_PRESS
+#define BUTTON_REPEAT_MS        150         // REPEAT interval after LONG_PRESS
+#define BUTTON_QUEUE_DEPTH      16          // Events per ring (power of two)
+
+// Debounce settle time comes from pin_definitions.h (BUTTON_DEBOUNCE_MS)
+
+typedef enum {
+    BUTTON_START = 0,       // START_BUTTON_PIN
+    BUTTON_MODE,            // MODE_BUTTON_PIN
+    BUTTON_STOP,            // STOP_BUTTON_PIN
+    BUTTON_SELECT,          // ENCODER_SW_PIN
+    BUTTON_COUNT
+} button_id_t;
+
+typedef enum {
+    BUTTON_EVENT_PRESS = 0,     // Debounced press (time = edge time)
+    BUTTON_EVENT_RELEASE,       // Debounced release (held_ms = press duration)
+    BUTTON_EVENT_LONG_PRESS,    // Held for BUTTON_LONG_PRESS_MS
+    BUTTON_EVENT_REPEAT         // Every BUTTON_REPEAT_MS after LONG_PRESS (if enabled)
+} button_event_type_t;
+
+typedef struct {
+    button_id_t button;
+    button_event_type_t type;
+    uint32_t time_ms;           // Event time (ms since boot)
+    uint32_t held_ms;           // How long the button has been held
+} button_event_t;
+
+/**
+ * @brief Edge hook called from the GPIO ISR (must be IRAM_ATTR, must not block)
+ * @param pressed Raw pin level at the edge (true = LOW = pressed)
+ * @param edge_us esp_timer time taken on ISR entry
+ */
+typedef void (*button_isr_hook_t)(bool pressed, int64_t edge_us);
+
+/**
+ * @brief Configure button GPIOs, install edge ISRs and start the debounce timer
+ *
+ * Installs the shared GPIO ISR service at interrupt level 3 (the highest
+ * level usable from C) so safety hooks run ahead of UART/timer ISRs.
+ * Call this BEFORE any attachInterrupt() so the service is not created
+ * at the Arduino default level.
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t button_events_init(void);
+
+/**
+ * @brief Attach a hook that runs inside the GPIO ISR on every raw edge
+ *
+ * Used by estop.c to act on the STOP edge in microseconds, before any
+ * debouncing. Pass NULL to remove.
+ */
+void button_events_set_isr_hook(button_id_t button, button_isr_hook_t hook);
+
+/**
+ * @brief Pop the next event (STOP events first). Never blocks.
+ * @return true if an event was written to *ev
+ */
+bool button_events_poll(button_event_t *ev);
+
+/**
+ * @brief Debounced "currently held" state of a button
+ */
+bool button_events_is_pressed(button_id_t button);
+
+/**
+ * @brief Enable or disable auto-repeat for a button (default: disabled)
+ */
+void button_events_set_repeat(button_id_t button, bool enable);
+
+/**
+ * @brief Number of events dropped because a ring was full
+ */
+uint32_t button_events_dropped(void);
+
+/**
+ * @brief Human-readable names for logging
+ */
+const char *button_name(button_id_t button);
+const char *button_event_name(button_event_type_t type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BUTTON_EVENTS_H
@@ -0,0 +1,343 @@
+/**
+ * @file console.c
+ * @brief Command lookup, argument parsing and async stepping for console.h
+ */
+
+#include "console.h"
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PRINTF_MAX      256
+
+// ============================================================================
+// LOOKUP
+// ============================================================================
+
+/**
+ * @brief FNV-1a over the lower-cased name, salted with the table seed
+ *
+ * The final mix spreads the high bits into the low ones the slot index
+ * uses; without it one-letter names that share their low 6 bits ('q', '1')
+ * collide for every seed.
+ */
+static uint32_t name_hash(const char *name, uint32_t seed) {
+    uint32_t h = 2166136261u ^ seed;
+    for (const char *p = name; *p; p++) {
+        h ^= (uint8_t)tolower((unsigned char)*p);
+        h *= 16777619u;
+    }
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    return h;
+}
+
+static bool name_equal(const char *a, const char *b) {
+    while (*a && *b) {
+        if (tolower((unsigned char)*a) != tolower((unsigned char)*b)) return false;
+        a++;
+        b++;
+    }
+    return *a == *b;
+}
+
+/**
+ * @brief Try one seed: every name in its own slot
+ */
+static bool build_slots(console_t *c, uint32_t seed) {
+    memset(c->slots, 0, sizeof(c->slots));
+    for (size_t i = 0; i < c->count; i++) {
+        uint32_t slot = name_hash(c->cmds[i].name, seed) & (CONSOLE_HASH_SLOTS - 1);
+        if (c->slots[slot] != 0) return false;
+        c->slots[slot] = (uint8_t)(i + 1);
+    }
+    c->seed = seed;
+    return true;
+}
+
+const console_cmd_t *console_find(const console_t *c, const char *name) {
+    uint32_t slot = name_hash(name, c->seed) & (CONSOLE_HASH_SLOTS - 1);
+    uint8_t entry = c->slots[slot];
+    if (entry == 0) return NULL;
+    const console_cmd_t *cmd = &c->cmds[entry - 1];
+    return name_equal(cmd->name, name) ? cmd : NULL;
+}
+
+bool console_init(console_t *c, const console_cmd_t *cmds, size_t count, const console_io_t *io) {
+    memset(c, 0, sizeof(*c));
+    c->cmds = cmds;
+    c->count = count;
+    c->io = *io;
+    line_framer_init(&c->framer, c->rx, sizeof(c->rx), LINE_FRAMER_DROP);
+
+    if (count > CONSOLE_MAX_COMMANDS) return false;
+    for (size_t i = 0; i < count; i++) {
+        for (size_t j = i + 1; j < count; j++) {
+            if (name_equal(cmds[i].name, cmds[j].name)) return false;
+        }
+    }
+    // A 32-of-64 table needs a few hundred tries at worst; this runs once
+    for (uint32_t seed = 0; seed < 100000; seed++) {
+        if (build_slots(c, seed)) return true;
+    }
+    return false;
+}
+
+// ============================================================================
+// OUTPUT
+// ============================================================================
+
+static void write_text(console_t *c, const char *text) {
+    c->io.write(c->io.ctx, text, strlen(text));
+}
+
+size_t console_room(const console_call_t *call) {
+    const console_t *c = call->console;
+    return c->io.room ? c->io.room(c->io.ctx) : PRINTF_MAX;
+}
+
+void console_printf(console_call_t *call, const char *fmt, ...) {
+    char buf[PRINTF_MAX];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (n <= 0) return;
+    if ((size_t)n >= sizeof(buf)) n = sizeof(buf) - 1;
+    call->console->io.write(call->console->io.ctx, buf, (size_t)n);
+}
+
+void console_write(console_call_t *call, const void *data, size_t len) {
+    call->console->io.write(call->console->io.ctx, (const char *)data, len);
+}
+
+void console_print_help(console_call_t *call) {
+    const console_t *c = call->console;
+    console_printf(call, "Commands:\n");
+    for (size_t i = 0; i < c->count; i++) {
+        const console_cmd_t *cmd = &c->cmds[i];
+        console_printf(call, "  %-6s %-10s %s\n", cmd->name, cmd->args, cmd->help ? cmd->help : "");
+    }
+}
+
+static void print_usage(console_t *c, const console_cmd_t *cmd) {
+    char buf[PRINTF_MAX];
+    snprintf(buf, sizeof(buf), "Usage: %s %s  (i=int f=float c=char s=word r=text ?=optional after)\n",
+             cmd->name, cmd->args);
+    write_text(c, buf);
+}
+
+// ============================================================================
+// PARSING
+// ============================================================================
+
+static char *skip_blanks(char *p) {
+    while (*p == ' ' || *p == '\t') p++;
+    return p;
+}
+
+/**
+ * @brief Cut the next word off *p (NUL-terminated in place)
+ */
+static char *next_word(char **p) {
+    char *start = skip_blanks(*p);
+    if (*start == '\0') return NULL;
+    char *end = start;
+    while (*end && *end != ' ' && *end != '\t') end++;
+    if (*end) *end++ = '\0';
+    *p = end;
+    return start;
+}
+
+static bool parse_value(char kind, char *text, console_value_t *out) {
+    char *end;
+    switch (kind) {
+        case 'i':
+            out->i = strtol(text, &end, 0);
+            return end != text && *end == '\0';
+        case 'f':
+            out->f = strtof(text, &end);
+            return end != text && *end == '\0';
+        case 'c':
+            out->c = text[0];
+            return text[1] == '\0';
+        case 's':
+        case 'r':
+            out->s = text;
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Split buf into command and typed arguments
+ * @return The command, or NULL (unknown / bad arguments, already reported)
+ */
+static const console_cmd_t *parse_line(console_t *c, char *buf, console_call_t *call) {
+    char *p = buf;
+    char *name = next_word(&p);
+    if (name == NULL) return NULL;
+
+    const console_cmd_t *cmd = console_find(c, name);
+    if (cmd == NULL) {
+        if (name_equal(name, "help")) {
+            call->console = c;
+            console_print_help(call);
+            return NULL;
+        }
+        char msg[PRINTF_MAX];
+        snprintf(msg, sizeof(msg), "Unknown command '%s' - type help\n", name);
+        write_text(c, msg);
+        c->errors++;
+        return NULL;
+    }
+
+    memset(call, 0, sizeof(*call));
+    call->console = c;
+    call->cmd = cmd;
+    bool optional = false;
+    for (const char *spec = cmd->args; *spec; spec++) {
+        if (*spec == '?') {
+            optional = true;
+            continue;
+        }
+        char *text;
+        if (*spec == 'r') {
+            text = skip_blanks(p);
+            p += strlen(p);
+            if (*text == '\0') text = NULL;
+        } else {
+            text = next_word(&p);
+        }
+        if (text == NULL) {
+            if (optional) break;
+            print_usage(c, cmd);
+            c->errors++;
+            return NULL;
+        }
+        if (call->argc >= CONSOLE_MAX_ARGS || !parse_value(*spec, text, &call->arg[call->argc])) {
+            print_usage(c, cmd);
+            c->errors++;
+            return NULL;
+        }
+        call->argc++;
+    }
+    if (*skip_blanks(p) != '\0') {
+        print_usage(c, cmd);                // Extra arguments
+        c->errors++;
+        return NULL;
+    }
+    return cmd;
+}
+
+// ============================================================================
+// EXECUTION
+// ============================================================================
+
+/**
+ * @brief Run a line as the (new) current command
+ */
+static bool start_line(console_t *c, const char *text, int64_t now_us) {
+    strncpy(c->line, text, sizeof(c->line) - 1);
+    c->line[sizeof(c->line) - 1] = '\0';
+    const console_cmd_t *cmd = parse_line(c, c->line, &c->call);
+    if (cmd == NULL) return false;
+
+    c->executed++;
+    c->call.now_us = now_us;
+    if (cmd->handler(&c->call) == CONSOLE_MORE) {
+        c->running = cmd;
+        c->call.step = 1;
+    }
+    return true;
+}
+
+/**
+ * @brief Run an immediate command beside the running one (own buffers)
+ */
+static bool run_immediate(console_t *c, const console_cmd_t *cmd, const char *text, int64_t now_us) {
+    char buf[CONSOLE_LINE_MAX];
+    console_call_t call;
+    strncpy(buf, text, sizeof(buf) - 1);
+    buf[sizeof(buf) - 1] = '\0';
+    if (parse_line(c, buf, &call) != cmd) return false;
+    c->executed++;
+    call.now_us = now_us;
+    cmd->handler(&call);                // Immediate commands finish in one call
+    return true;
+}
+
+/**
+ * @brief First word of a line, copied (for the lookup before tokenizing)
+ */
+static const console_cmd_t *peek_command(const console_t *c, const char *text) {
+    char name[24];
+    size_t n = 0;
+    while (text[n] && text[n] != ' ' && text[n] != '\t' && n < sizeof(name) - 1) {
+        name[n] = text[n];
+        n++;
+    }
+    name[n] = '\0';
+    return console_find(c, name);
+}
+
+bool console_exec(console_t *c, const char *line, int64_t now_us) {
+    if (c->running != NULL) {
+        const console_cmd_t *cmd = peek_command(c, line);
+        if (cmd == NULL || !(cmd->flags & CONSOLE_IMMEDIATE)) return false;
+        return run_immediate(c, cmd, line, now_us);
+    }
+    return start_line(c, line, now_us);
+}
+
+void console_abort(console_t *c) {
+    c->running = NULL;
+}
+
+bool console_busy(const console_t *c) {
+    return c->running != NULL;
+}
+
+void console_poll(console_t *c, int64_t now_us) {
+    if (c->running != NULL) {
+        c->call.now_us = now_us;
+        if (c->running->handler(&c->call) == CONSOLE_DONE) {
+            c->running = NULL;
+        } else {
+            c->call.step++;
+        }
+    }
+    if (c->running == NULL && c->has_pending) {
+        c->has_pending = false;
+        start_line(c, c->pending, now_us);
+    }
+
+    for (int lines = 0; lines < CONSOLE_LINES_PER_POLL; lines++) {
+        if (c->has_pending) return;         // Busy: leave the rest in the RX buffer
+
+        line_framer_line_t line;
+        bool complete = false;
+        int b;
+        while (!complete && (b = c->io.read(c->io.ctx)) >= 0) {
+            complete = line_framer_push(&c->framer, (uint8_t)b, now_us, &line);
+        }
+        if (!complete) return;
+
+        if (c->running == NULL) {
+            start_line(c, line.text, now_us);
+            continue;
+        }
+        const console_cmd_t *cmd = peek_command(c, line.text);
+        if (cmd != NULL && (cmd->flags & CONSOLE_IMMEDIATE)) {
+            run_immediate(c, cmd, line.text, now_us);
+        } else {
+            strcpy(c->pending, line.text);  // Both CONSOLE_LINE_MAX
+            c->has_pending = true;
+        }
+    }
+}
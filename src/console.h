@@ -0,0 +1,199 @@
+/**
+ * @file console.h
+ * @brief Table-driven serial console: hashed command lookup, typed arguments, async commands
+ *
+ * A sketch declares its commands once in a const table; console_poll()
+ * reads every complete input line (line_framer.h, never blocks), looks
+ * the command up through a collision-free hash built at init, checks
+ * and converts the arguments, and calls the handler.
+ *
+ * Argument spec, one letter per argument:
+ *   i  integer      f  float      c  single character
+ *   s  word         r  rest of the line, spaces included (last only)
+ *   ?  everything after it is optional
+ * e.g. "cff" for "w X 10 5", "?i" for "l" or "l 20", "r" for "x G1 X10 F150".
+ * Wrong or missing arguments print the usage line instead of calling the
+ * handler. Command names match case-insensitively.
+ *
+ * ASYNC COMMANDS:
+ * A handler that returns CONSOLE_MORE is called again from the next
+ * console_poll(), with call->step incremented and call->cursor kept, until
+ * it returns CONSOLE_DONE. Long output goes out in pieces that fit
+ * console_room(), so a dump never stalls the control loop on a full TX
+ * buffer. While one runs, further lines wait in the RX buffer, except
+ * commands flagged CONSOLE_IMMEDIATE (stop, abort), which run at once.
+ *
+ * Shared by the sketches and the host tools; does not depend on ESP-IDF
+ * or Arduino (see console_stream_io() for the Arduino glue).
+ *
+ * Usage:
+ *   static console_status_t cmdRead(console_call_t *call) { ...; return CONSOLE_DONE; }
+ *   static const console_cmd_t commands[] = {
+ *       {"r", "", "Manual read", cmdRead, 0},
+ *   };
+ *   console_t console;
+ *   console_io_t io = console_stream_io(Serial);
+ *   console_init(&console, commands, sizeof(commands) / sizeof(commands[0]), &io);
+ *   loop() { console_poll(&console, esp_timer_get_time()); }
+ */
+
+#ifndef CONSOLE_H
+#define CONSOLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "line_framer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CONSOLE_LINE_MAX        96
+#define CONSOLE_MAX_ARGS        6
+#define CONSOLE_MAX_COMMANDS    32
+#define CONSOLE_HASH_SLOTS      64      // Power of two, >= 2 x CONSOLE_MAX_COMMANDS
+#define CONSOLE_LINES_PER_POLL  8       // Bounds the time one console_poll() can take
+
+#define CONSOLE_IMMEDIATE       0x01    // Runs even while an async command is in progress
+
+typedef enum {
+    CONSOLE_DONE = 0,
+    CONSOLE_MORE,                       // Call again on the next poll
+} console_status_t;
+
+typedef union {
+    long i;
+    float f;
+    char c;
+    const char *s;
+} console_value_t;
+
+typedef struct console console_t;
+
+typedef struct {
+    console_t *console;
+    const struct console_cmd *cmd;      // Entry being run (handlers shared by aliases)
+    int argc;                           // Arguments given
+    console_value_t arg[CONSOLE_MAX_ARGS];
+    uint32_t step;                      // 0 on the first call, +1 per CONSOLE_MORE
+    uint32_t cursor;                    // Handler's own position between steps
+    int64_t now_us;                     // console_poll() time of this step
+} console_call_t;
+
+typedef console_status_t (*console_handler_t)(console_call_t *call);
+
+typedef struct console_cmd {
+    const char *name;
+    const char *args;                   // Spec, see above ("" = none)
+    const char *help;
+    console_handler_t handler;
+    uint8_t flags;
+} console_cmd_t;
+
+typedef struct {
+    int (*read)(void *ctx);                                 // Next byte, -1 if none
+    size_t (*write)(void *ctx, const char *data, size_t len);
+    size_t (*room)(void *ctx);                              // Bytes writable without blocking
+    void *ctx;
+} console_io_t;
+
+struct console {
+    const console_cmd_t *cmds;
+    size_t count;
+    uint8_t slots[CONSOLE_HASH_SLOTS];  // Command index + 1, 0 = empty
+    uint32_t seed;
+    console_io_t io;
+
+    line_framer_t framer;
+    char rx[CONSOLE_LINE_MAX];
+    char pending[CONSOLE_LINE_MAX];     // Line that arrived while busy
+    bool has_pending;
+
+    char line[CONSOLE_LINE_MAX];        // Tokenized copy of the running command
+    const console_cmd_t *running;
+    console_call_t call;
+
+    uint32_t executed;
+    uint32_t errors;                    // Unknown command or bad arguments
+};
+
+/**
+ * @brief Bind the command table and I/O, build the lookup hash
+ * @return false if the table is too big or has duplicate names
+ */
+bool console_init(console_t *c, const console_cmd_t *cmds, size_t count, const console_io_t *io);
+
+/**
+ * @brief Advance a running async command, then execute complete input lines
+ */
+void console_poll(console_t *c, int64_t now_us);
+
+/**
+ * @brief Execute one line as if typed (scripts, startup defaults)
+ * @return false if the command is unknown, its arguments are bad, or one is already running
+ */
+bool console_exec(console_t *c, const char *line, int64_t now_us);
+
+/**
+ * @brief Command entry for a name, NULL if none
+ */
+const console_cmd_t *console_find(const console_t *c, const char *name);
+
+/**
+ * @brief Stop the running async command (from an immediate command)
+ */
+void console_abort(console_t *c);
+
+/**
+ * @brief True while an async command is in progress
+ */
+bool console_busy(const console_t *c);
+
+/**
+ * @brief Bytes the output takes now without blocking
+ */
+size_t console_room(const console_call_t *call);
+
+/**
+ * @brief Formatted output (up to 256 bytes per call)
+ */
+void console_printf(console_call_t *call, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Raw output (binary dumps); check console_room() first to avoid blocking
+ */
+void console_write(console_call_t *call, const void *data, size_t len);
+
+/**
+ * @brief Print name, arguments and help of every command
+ */
+void console_print_help(console_call_t *call);
+
+#ifdef __cplusplus
+}
+
+/**
+ * @brief console_io_t over an Arduino Stream (HardwareSerial, the host Serial shim)
+ */
+template <typename StreamT>
+inline console_io_t console_stream_io(StreamT &stream) {
+    console_io_t io;
+    io.read = [](void *ctx) -> int {
+        StreamT *s = static_cast<StreamT *>(ctx);
+        return s->available() > 0 ? s->read() : -1;
+    };
+    io.write = [](void *ctx, const char *data, size_t len) -> size_t {
+        return static_cast<StreamT *>(ctx)->write(reinterpret_cast<const uint8_t *>(data), len);
+    };
+    io.room = [](void *ctx) -> size_t {
+        int room = static_cast<StreamT *>(ctx)->availableForWrite();
+        return room > 0 ? (size_t)room : 0;
+    };
+    io.ctx = &stream;
+    return io;
+}
+#endif
+
+#endif // CONSOLE_H
@@ -0,0 +1,224 @@
+/**
+ * @file dashboard.c
+ * @brief Delta JSON frames and command parsing for dashboard.h
+ */
+
+#include "dashboard.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fluidnc_status.h"
+
+// ============================================================================
+// JSON WRITER
+// ============================================================================
+
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+    bool ok;                    // false once anything did not fit
+} writer_t;
+
+__attribute__((format(printf, 2, 3))) static void put(writer_t *w, const char *fmt, ...) {
+    if (!w->ok) return;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(w->buf + w->len, w->size - w->len, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= w->size - w->len) {
+        w->ok = false;
+        return;
+    }
+    w->len += (size_t)n;
+}
+
+/** "name": with the comma before it unless it is the first member */
+static void key(writer_t *w, bool *first, const char *name) {
+    put(w, "%s\"%s\":", *first ? "" : ",", name);
+    *first = false;
+}
+
+static void put_grams(writer_t *w, float g) {
+    if (isfinite(g)) {
+        put(w, "%.2f", (double)g);
+    } else {
+        put(w, "null");
+    }
+}
+
+/** Display resolution: values closer than 0.01 g are the same */
+static long cg(float g) {
+    return isfinite(g) ? lroundf(g * 100.0f) : LONG_MIN;
+}
+
+static const char *state_name(uint8_t state) {
+    static const char *const names[] = {"idle", "dosing", "hold", "estop"};
+    return state < 4 ? names[state] : "unknown";
+}
+
+// ============================================================================
+// FRAMES
+// ============================================================================
+
+size_t dashboard_encode(const dashboard_state_t *prev, const dashboard_state_t *cur, char *buf, size_t size) {
+    if (size == 0) return 0;
+    writer_t w = {buf, size, 0, true};
+    bool first = true;
+    put(&w, "{");
+    if (prev == NULL) {
+        key(&w, &first, "full");
+        put(&w, "true");
+    }
+
+    if (prev == NULL || cg(prev->weight_g) != cg(cur->weight_g)) {
+        key(&w, &first, "weight");
+        put_grams(&w, cur->weight_g);
+    }
+
+    bool state = prev == NULL || prev->state != cur->state;
+    bool machine = prev == NULL || prev->machine != cur->machine;
+    bool fault = prev == NULL || prev->fault != cur->fault;
+    bool pump = prev == NULL || prev->pump != cur->pump;
+    bool doses = prev == NULL || prev->doses != cur->doses;
+    if (state || machine || fault || pump || doses) {
+        bool f = true;
+        key(&w, &first, "status");
+        put(&w, "{");
+        if (state) {
+            key(&w, &f, "state");
+            put(&w, "\"%s\"", state_name(cur->state));
+        }
+        if (machine) {
+            key(&w, &f, "machine");
+            put(&w, "\"%s\"", fluidnc_state_name((fluidnc_state_t)cur->machine));
+        }
+        if (fault) {
+            key(&w, &f, "fault");
+            put(&w, "%u", (unsigned)cur->fault);
+        }
+        if (pump) {
+            key(&w, &f, "pump");
+            put(&w, "%u", (unsigned)cur->pump + 1);
+        }
+        if (doses) {
+            key(&w, &f, "doses");
+            put(&w, "%lu", (unsigned long)cur->doses);
+        }
+        put(&w, "}");
+    }
+
+    for (int i = 0; i < DASHBOARD_PUMPS; i++) {
+        const dashboard_pump_t *p = &cur->pumps[i];
+        const dashboard_pump_t *q = prev != NULL ? &prev->pumps[i] : NULL;
+        bool target = q == NULL || cg(q->target_g) != cg(p->target_g);
+        bool dispensed = q == NULL || cg(q->dispensed_g) != cg(p->dispensed_g);
+        bool active = q == NULL || q->active != p->active;
+        if (!target && !dispensed && !active) continue;
+
+        char name[8];
+        snprintf(name, sizeof(name), "pump%d", i + 1);
+        bool f = true;
+        key(&w, &first, name);
+        put(&w, "{");
+        if (target) {
+            key(&w, &f, "target");
+            put_grams(&w, p->target_g);
+        }
+        if (dispensed) {
+            key(&w, &f, "dispensed");
+            put_grams(&w, p->dispensed_g);
+        }
+        if (active) {
+            key(&w, &f, "active");
+            put(&w, "%s", p->active ? "true" : "false");
+        }
+        put(&w, "}");
+    }
+
+    put(&w, "}");
+    if (first || !w.ok) return 0;               // Nothing changed, or buf too small
+    return w.len;
+}
+
+size_t dashboard_client_frame(dashboard_client_t *c, const dashboard_state_t *cur, bool backlogged, char *buf,
+                              size_t size) {
+    const dashboard_state_t *prev = c->synced ? &c->sent : NULL;
+    size_t len = dashboard_encode(prev, cur, buf, size);
+    if (len == 0) return 0;
+    if (backlogged) {
+        c->coalesced++;                         // Goes out merged with the next change
+        return 0;
+    }
+    c->sent = *cur;
+    c->synced = true;
+    c->frames++;
+    c->bytes += (uint32_t)len;
+    return len;
+}
+
+// ============================================================================
+// COMMANDS
+// ============================================================================
+
+/**
+ * @brief Value of "name" in a flat JSON object, NULL if absent
+ */
+static const char *value_of(const char *json, const char *name) {
+    size_t n = strlen(name);
+    for (const char *p = strchr(json, '"'); p != NULL; p = strchr(p + 1, '"')) {
+        if (strncmp(p + 1, name, n) != 0 || p[n + 1] != '"') continue;
+        const char *v = p + n + 2;
+        while (*v == ' ' || *v == '\t') v++;
+        if (*v != ':') continue;                // A string value equal to name
+        v++;
+        while (*v == ' ' || *v == '\t') v++;
+        return v;
+    }
+    return NULL;
+}
+
+static bool is_string(const char *v, const char *s) {
+    size_t n = strlen(s);
+    return v != NULL && v[0] == '"' && strncmp(v + 1, s, n) == 0 && v[n + 1] == '"';
+}
+
+static bool number_of(const char *json, const char *name, float *out) {
+    const char *v = value_of(json, name);
+    if (v == NULL) return false;
+    char *end;
+    float f = strtof(v, &end);
+    if (end == v || !isfinite(f)) return false;
+    *out = f;
+    return true;
+}
+
+bool dashboard_parse_command(const char *json, dashboard_cmd_t *out) {
+    const char *cmd = value_of(json, "command");
+    memset(out, 0, sizeof(*out));
+
+    if (is_string(cmd, "start")) {
+        float pump;
+        if (!number_of(json, "pump", &pump) || pump < 1.0f || pump > (float)DASHBOARD_PUMPS ||
+            pump != floorf(pump)) {
+            return false;
+        }
+        if (number_of(json, "grams", &out->grams) && out->grams < 0.0f) return false;
+        out->kind = DASHBOARD_CMD_DOSE;
+        out->pump = (uint8_t)(pump - 1.0f);
+    } else if (is_string(cmd, "stop")) {
+        out->kind = DASHBOARD_CMD_STOP;
+    } else if (is_string(cmd, "resume")) {
+        out->kind = DASHBOARD_CMD_RESUME;
+    } else if (is_string(cmd, "reset")) {
+        out->kind = DASHBOARD_CMD_RESET;
+    } else {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,107 @@
+/**
+ * @file dashboard.h
+ * @brief Web dashboard state, per-client delta frames and browser commands
+ *
+ * The dashboard (docs/reference/WEB_UI_README.md) shows live weight, the
+ * progress of each pump and the system state every 100 ms. Sending the
+ * whole state to every browser at that rate is ~500 bytes x 10/s per
+ * client; most of it does not change. Each client instead remembers what
+ * it was last sent and gets only the fields that differ:
+ *
+ *   {"weight":45.30,"pump1":{"dispensed":23.50}}
+ *
+ * The first frame of a client (and the one after a failed send) is full
+ * and carries "full":true. Values are compared at display resolution
+ * (0.01 g), so float noise below it sends nothing.
+ *
+ * COALESCING: a client whose socket cannot take a frame (its send buffer
+ * still holds earlier ones) is skipped for that tick. Its next frame is
+ * the delta against what it last received, so skipped ticks merge into one
+ * frame instead of queueing up: a slow browser sees a lower rate, never
+ * stale data, and never holds memory on the device.
+ *
+ * Shared by the firmware (main/net_web.c) and host tools; does not depend
+ * on ESP-IDF.
+ *
+ * Usage (every push period, per client):
+ *   size_t len = dashboard_client_frame(&client, &state, backlogged, buf, sizeof(buf));
+ *   if (len > 0 && !send(buf, len)) client.synced = false;
+ */
+
+#ifndef DASHBOARD_H
+#define DASHBOARD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DASHBOARD_PUMPS         4
+#define DASHBOARD_FRAME_MAX     512     // Longest (full) frame, with margin
+
+typedef struct {
+    float target_g;             // Last / current dose target, 0 = none yet
+    float dispensed_g;          // Delivered in that dose
+    bool active;                // Dosing now
+} dashboard_pump_t;
+
+typedef struct {
+    float weight_g;             // Scale
+    uint8_t state;              // control_state_t: idle, dosing, hold, estop
+    uint8_t machine;            // fluidnc_state_t
+    uint8_t fault;              // flow_monitor fault code, 0 = none
+    uint8_t pump;               // Selected / active pump 0..3
+    uint32_t doses;             // Completed since boot
+    dashboard_pump_t pumps[DASHBOARD_PUMPS];
+} dashboard_state_t;
+
+/** What one browser has been sent */
+typedef struct {
+    dashboard_state_t sent;
+    bool synced;                // false: next frame is full (new client, failed send)
+    uint32_t frames;
+    uint32_t bytes;
+    uint32_t coalesced;         // Ticks skipped with a change pending
+} dashboard_client_t;
+
+typedef enum {
+    DASHBOARD_CMD_DOSE = 0,     // {"command":"start","pump":1..4,"grams":g}
+    DASHBOARD_CMD_STOP,         // {"command":"stop"} feed hold
+    DASHBOARD_CMD_RESUME,       // {"command":"resume"}
+    DASHBOARD_CMD_RESET,        // {"command":"reset"} clear e-stop / alarm
+} dashboard_cmd_kind_t;
+
+typedef struct {
+    dashboard_cmd_kind_t kind;
+    uint8_t pump;               // 0..3
+    float grams;                // 0 = default dose
+} dashboard_cmd_t;
+
+/**
+ * @brief Encode cur as JSON: only what differs from prev, or all of it when prev is NULL
+ * @return Length (no terminator written past it), 0 if nothing changed or buf is too small
+ */
+size_t dashboard_encode(const dashboard_state_t *prev, const dashboard_state_t *cur, char *buf, size_t size);
+
+/**
+ * @brief Next frame for one client
+ * @param backlogged The client's socket cannot take a frame now: skip and coalesce
+ * @return Frame length, 0 = nothing to send; on > 0 the client counts cur as sent
+ */
+size_t dashboard_client_frame(dashboard_client_t *c, const dashboard_state_t *cur, bool backlogged, char *buf,
+                              size_t size);
+
+/**
+ * @brief Parse one browser message (NUL-terminated JSON object)
+ * @return false if it is not a known command or its fields are out of range
+ */
+bool dashboard_parse_command(const char *json, dashboard_cmd_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DASHBOARD_H
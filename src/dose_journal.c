@@ -0,0 +1,433 @@
+/**
+ * @file dose_journal.c
+ * @brief Sector ring, batch replay and progress location for dose_journal.h
+ *
+ * Every record, written or read back at boot, goes through apply(): the
+ * RAM copy of the open batch is the replay of the journal, so what is
+ * recovered after a reset is exactly what was tracked before it.
+ */
+
+#include "dose_journal.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "esp_timer.h"
+
+#define SECTOR_MAGIC        0x4E524A44u     // "DJRN"
+#define SECTOR_FULL         DOSE_JOURNAL_RECORDS_PER_SECTOR
+#define STEP_EPS_MM         0.01f           // G-code resolution ("G1 X%.2f")
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t record_size;
+    uint16_t reserved;
+    uint32_t sector_seq;        // +1 per sector opened; the highest is the head
+    uint32_t erase_count;       // Erases of this sector
+    uint32_t first_seq;         // Seq of slot 0
+    uint8_t pad[10];
+    uint16_t crc;
+} sector_header_t;
+
+_Static_assert(sizeof(dose_journal_record_t) == DOSE_JOURNAL_RECORD_SIZE, "dose_journal_record_t must be 32 bytes");
+_Static_assert(sizeof(sector_header_t) == DOSE_JOURNAL_RECORD_SIZE, "sector header must be one record slot");
+
+static uint16_t crc16(const void *data, size_t len) {
+    const uint8_t *p = data;
+    uint16_t crc = 0xFFFF;                      // CRC-16/CCITT-FALSE
+    while (len--) {
+        crc ^= (uint16_t)(*p++) << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+bool dose_journal_record_valid(const dose_journal_record_t *rec) {
+    return rec->seq != 0xFFFFFFFFu && rec->crc == crc16(rec, offsetof(dose_journal_record_t, crc));
+}
+
+static bool header_valid(const sector_header_t *h) {
+    return h->magic == SECTOR_MAGIC && h->version == DOSE_JOURNAL_VERSION &&
+           h->record_size == DOSE_JOURNAL_RECORD_SIZE && h->crc == crc16(h, offsetof(sector_header_t, crc));
+}
+
+static bool erased(const void *data, size_t len) {
+    const uint8_t *p = data;
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+static int axis_of(char pump) {
+    const char *p = strchr("XYZA", pump);
+    return p && pump ? (int)(p - "XYZA") : -1;
+}
+
+// ============================================================================
+// PROGRESS
+// ============================================================================
+
+static uint8_t load_moves(const batch_plan_t *plan, dose_journal_move_t *moves) {
+    for (uint8_t s = 0; s < plan->step_count; s++) {
+        moves[s].pump = plan->steps[s].pump;
+        moves[s].mm = plan->steps[s].mm;
+    }
+    return plan->step_count;
+}
+
+/**
+ * @brief Step the pumps are on, and how far into it, from the travel since the start
+ *
+ * Steps run one after the other and each moves one pump, so a pump's
+ * travel is used up by its steps in plan order.
+ */
+static void locate(const dose_journal_move_t *moves, uint8_t count, const float *start, const float *pos,
+                   uint8_t *step, float *done_mm) {
+    float travel[DOSE_JOURNAL_AXES];
+    for (int a = 0; a < DOSE_JOURNAL_AXES; a++) travel[a] = pos[a] - start[a];
+    for (uint8_t s = 0; s < count; s++) {
+        int a = axis_of(moves[s].pump);
+        if (a < 0) continue;
+        if (travel[a] >= moves[s].mm - STEP_EPS_MM) {
+            travel[a] -= moves[s].mm;
+            continue;
+        }
+        *step = s;
+        *done_mm = travel[a] > 0.0f ? travel[a] : 0.0f;
+        return;
+    }
+    *step = count;
+    *done_mm = 0.0f;
+}
+
+// ============================================================================
+// RECORDS
+// ============================================================================
+
+/**
+ * @brief What a record says about the open batch (while journaling and on replay)
+ */
+static void apply(dose_journal_batch_t *b, const dose_journal_record_t *rec) {
+    switch (rec->type) {
+        case DOSE_JOURNAL_BATCH:
+        case DOSE_JOURNAL_RESUME:
+            if (rec->type == DOSE_JOURNAL_BATCH || !b->open || b->job != rec->job || b->batch != rec->batch) {
+                b->start_scale_g = rec->scale_g;
+            }
+            b->open = true;
+            b->job = rec->job;
+            b->batch = rec->batch;
+            b->step = rec->step;
+            memcpy(b->start, rec->pos, sizeof(b->start));
+            memcpy(b->pos, rec->pos, sizeof(b->pos));
+            b->scale_g = rec->scale_g;
+            break;
+
+        case DOSE_JOURNAL_STEP:
+        case DOSE_JOURNAL_CHECKPOINT:
+        case DOSE_JOURNAL_STEP_DONE:
+            if (!b->open || b->job != rec->job || b->batch != rec->batch) break;
+            b->step = rec->type == DOSE_JOURNAL_STEP_DONE ? rec->step + 1 : rec->step;
+            memcpy(b->pos, rec->pos, sizeof(b->pos));
+            b->scale_g = rec->scale_g;
+            break;
+
+        case DOSE_JOURNAL_BATCH_DONE:
+        case DOSE_JOURNAL_ABORT:
+            b->open = false;
+            memcpy(b->pos, rec->pos, sizeof(b->pos));
+            b->scale_g = rec->scale_g;
+            break;
+
+        default:
+            break;
+    }
+}
+
+static inline size_t sector_addr(uint32_t sector) {
+    return (size_t)sector * DOSE_JOURNAL_SECTOR_SIZE;
+}
+
+static inline size_t slot_addr(uint32_t sector, uint32_t slot) {
+    return sector_addr(sector) + DOSE_JOURNAL_RECORD_SIZE * (size_t)(slot + 1);
+}
+
+static bool read_header(const dose_journal_t *j, uint32_t sector, sector_header_t *h) {
+    return esp_partition_read(j->part, sector_addr(sector), h, sizeof(*h)) == ESP_OK && header_valid(h);
+}
+
+/**
+ * @brief Erase the sector after the head and make it the head
+ */
+static bool open_sector(dose_journal_t *j) {
+    uint32_t next = (j->head_sector + 1) % j->sectors;
+
+    sector_header_t h;
+    uint32_t erase_count = read_header(j, next, &h) ? h.erase_count + 1 : 1;
+    if (esp_partition_erase_range(j->part, sector_addr(next), DOSE_JOURNAL_SECTOR_SIZE) != ESP_OK) return false;
+    j->stats.erases++;
+
+    memset(&h, 0, sizeof(h));
+    h.magic = SECTOR_MAGIC;
+    h.version = DOSE_JOURNAL_VERSION;
+    h.record_size = DOSE_JOURNAL_RECORD_SIZE;
+    h.sector_seq = j->head_sector_seq + 1;
+    h.erase_count = erase_count;
+    h.first_seq = j->next_seq;
+    h.crc = crc16(&h, offsetof(sector_header_t, crc));
+    if (esp_partition_write(j->part, sector_addr(next), &h, sizeof(h)) != ESP_OK) return false;
+
+    j->head_sector = next;
+    j->head_slot = 0;
+    j->head_sector_seq = h.sector_seq;
+    if (erase_count > j->stats.max_erase_count) j->stats.max_erase_count = erase_count;
+    return true;
+}
+
+static bool write_record(dose_journal_t *j, dose_journal_record_t *rec) {
+    if (j->head_slot >= SECTOR_FULL && !open_sector(j)) {
+        j->stats.write_errors++;
+        return false;
+    }
+    rec->seq = j->next_seq++;
+    rec->crc = crc16(rec, offsetof(dose_journal_record_t, crc));
+    if (esp_partition_write(j->part, slot_addr(j->head_sector, j->head_slot), rec, sizeof(*rec)) != ESP_OK) {
+        j->stats.write_errors++;
+        j->head_slot = SECTOR_FULL;             // Go on in a fresh sector
+        return false;
+    }
+    j->head_slot++;
+    j->stats.records++;
+    return true;
+}
+
+static dose_journal_record_t make(const dose_journal_t *j, uint8_t type, uint8_t step, const float *pos,
+                                  float scale_g) {
+    dose_journal_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    memcpy(rec.pos, pos, sizeof(rec.pos));
+    rec.scale_g = scale_g;
+    rec.job = j->batch.job;
+    rec.batch = j->batch.batch;
+    rec.type = type;
+    rec.step = step;
+    return rec;
+}
+
+/**
+ * @brief Journal one record (a new sector first opens with a copy of the open batch)
+ *
+ * The RAM state follows even if flash fails: the batch can still be
+ * resumed after a stop, only not after a reset.
+ */
+static void append(dose_journal_t *j, uint8_t type, uint8_t step, const float *pos, float scale_g) {
+    dose_journal_record_t rec = make(j, type, step, pos, scale_g);
+    if (j->ready) {
+        int64_t t0 = esp_timer_get_time();
+        if (j->head_slot >= SECTOR_FULL && j->batch.open && type != DOSE_JOURNAL_BATCH &&
+            type != DOSE_JOURNAL_RESUME) {
+            dose_journal_record_t b = make(j, DOSE_JOURNAL_BATCH, j->batch.step, j->batch.start, j->batch.start_scale_g);
+            dose_journal_record_t c = make(j, DOSE_JOURNAL_CHECKPOINT, j->batch.step, j->batch.pos, j->batch.scale_g);
+            if (write_record(j, &b) && write_record(j, &c)) j->stats.carried++;
+        }
+        write_record(j, &rec);
+        uint32_t took = (uint32_t)(esp_timer_get_time() - t0);
+        if (took > j->stats.max_write_us) j->stats.max_write_us = took;
+    }
+    apply(&j->batch, &rec);
+    memcpy(j->record_pos, pos, sizeof(j->record_pos));
+}
+
+// ============================================================================
+// INIT
+// ============================================================================
+
+/**
+ * @brief Replay a sector into the batch state
+ * @return Slots used (SECTOR_FULL after a torn write: go on in a new sector)
+ */
+static uint32_t replay(dose_journal_t *j, uint32_t sector, bool *any) {
+    uint32_t used = 0;
+    bool torn = false;
+    for (; used < SECTOR_FULL; used++) {
+        dose_journal_record_t rec;
+        if (esp_partition_read(j->part, slot_addr(sector, used), &rec, sizeof(rec)) != ESP_OK ||
+            erased(&rec, sizeof(rec))) {
+            break;
+        }
+        if (!dose_journal_record_valid(&rec)) {
+            torn = true;
+            continue;
+        }
+        apply(&j->batch, &rec);
+        j->next_seq = rec.seq + 1;
+        *any = true;
+    }
+    return torn ? SECTOR_FULL : used;
+}
+
+static void recover(dose_journal_t *j) {
+    bool found = false;
+    sector_header_t head_hdr;
+    for (uint32_t s = 0; s < j->sectors; s++) {
+        sector_header_t h;
+        if (!read_header(j, s, &h)) continue;
+        if (h.erase_count > j->stats.max_erase_count) j->stats.max_erase_count = h.erase_count;
+        if (!found || h.sector_seq > head_hdr.sector_seq) {
+            j->head_sector = s;
+            head_hdr = h;
+        }
+        found = true;
+    }
+    if (!found) {
+        // Blank (or foreign) partition: the first record opens sector 0
+        j->head_sector = j->sectors - 1;
+        j->head_slot = SECTOR_FULL;
+        return;
+    }
+    j->head_sector_seq = head_hdr.sector_seq;
+    j->next_seq = head_hdr.first_seq;
+
+    // A sector opens with the batch copy; if the reset came before it, the previous sector has it
+    uint32_t prev = (j->head_sector + j->sectors - 1) % j->sectors;
+    sector_header_t prev_hdr;
+    bool any = false;
+    dose_journal_t probe = *j;
+    probe.head_slot = replay(&probe, j->head_sector, &any);
+    if (!any && read_header(j, prev, &prev_hdr) && prev_hdr.sector_seq + 1 == head_hdr.sector_seq) {
+        replay(j, prev, &any);
+        j->next_seq = head_hdr.first_seq;
+        j->head_slot = replay(j, j->head_sector, &any);
+    } else {
+        *j = probe;
+    }
+}
+
+bool dose_journal_init(dose_journal_t *j, const char *label, const dose_journal_config_t *config) {
+    static const dose_journal_config_t defaults = DOSE_JOURNAL_DEFAULT_CONFIG;
+    memset(j, 0, sizeof(*j));
+    j->cfg = config ? *config : defaults;
+    j->batch.scale_g = j->batch.start_scale_g = NAN;
+
+    j->part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (j->part == NULL) return false;
+    j->sectors = j->part->size / DOSE_JOURNAL_SECTOR_SIZE;
+    if (j->cfg.sectors > 0 && j->cfg.sectors < j->sectors) j->sectors = j->cfg.sectors;
+    if (j->sectors < 2) return false;
+
+    recover(j);
+    j->ready = true;
+    return true;
+}
+
+// ============================================================================
+// JOURNALING
+// ============================================================================
+
+bool dose_journal_matches(const dose_journal_t *j, const batch_plan_t *plan) {
+    return j->batch.open && j->batch.job == (uint16_t)plan->job_id && j->batch.batch == plan->batch;
+}
+
+bool dose_journal_start(dose_journal_t *j, const batch_plan_t *plan, float scale_g) {
+    bool resumed = (plan->first_step > 0 || plan->first_done_mm > 0.0f) && dose_journal_matches(j, plan);
+    if (!resumed) dose_journal_abort(j);        // Superseded: it will not be resumed now
+    j->tracking = false;
+    if (!j->have_pos) return false;
+
+    j->step_count = load_moves(plan, j->moves);
+
+    // Start = where the pumps would have been with none of the plan done
+    float start[DOSE_JOURNAL_AXES];
+    memcpy(start, j->pos, sizeof(start));
+    for (uint8_t s = 0; s < plan->first_step && s < plan->step_count; s++) {
+        start[axis_of(plan->steps[s].pump)] -= plan->steps[s].mm;
+    }
+    if (plan->first_step < plan->step_count) start[axis_of(plan->steps[plan->first_step].pump)] -= plan->first_done_mm;
+
+    j->batch.job = (uint16_t)plan->job_id;
+    j->batch.batch = plan->batch;
+    append(j, resumed ? DOSE_JOURNAL_RESUME : DOSE_JOURNAL_BATCH, plan->first_step, start, scale_g);
+    append(j, resumed ? DOSE_JOURNAL_CHECKPOINT : DOSE_JOURNAL_STEP, plan->first_step, j->pos, scale_g);
+    j->record_us = 0;
+    j->tracking = true;
+    return true;
+}
+
+void dose_journal_update(dose_journal_t *j, const fluidnc_status_t *status, float scale_g, int64_t now_us) {
+    if (!status->has_mpos) return;
+    for (int a = 0; a < DOSE_JOURNAL_AXES; a++) j->pos[a] = a < status->axis_count ? status->pos[a] : 0.0f;
+    j->have_pos = true;
+    if (!j->tracking || !j->batch.open) return;
+
+    uint8_t step;
+    float done_mm;
+    locate(j->moves, j->step_count, j->batch.start, j->pos, &step, &done_mm);
+    if (step > j->batch.step) {
+        for (uint8_t s = j->batch.step; s < step; s++) append(j, DOSE_JOURNAL_STEP_DONE, s, j->pos, scale_g);
+        if (step < j->step_count) append(j, DOSE_JOURNAL_STEP, step, j->pos, scale_g);
+        j->record_us = now_us;
+        return;
+    }
+
+    float moved = 0.0f;
+    for (int a = 0; a < DOSE_JOURNAL_AXES; a++) moved = fmaxf(moved, fabsf(j->pos[a] - j->record_pos[a]));
+    if (moved >= j->cfg.checkpoint_mm && now_us - j->record_us >= (int64_t)j->cfg.checkpoint_ms * 1000) {
+        append(j, DOSE_JOURNAL_CHECKPOINT, step, j->pos, scale_g);
+        j->stats.checkpoints++;
+        j->record_us = now_us;
+    }
+}
+
+void dose_journal_done(dose_journal_t *j, float scale_g) {
+    if (!j->batch.open) return;
+    if (j->tracking) {
+        // Motion has finished: the end is the start plus every move (a report may be stale)
+        memcpy(j->pos, j->batch.start, sizeof(j->pos));
+        for (uint8_t s = 0; s < j->step_count; s++) j->pos[axis_of(j->moves[s].pump)] += j->moves[s].mm;
+    }
+    append(j, DOSE_JOURNAL_BATCH_DONE, j->step_count, j->pos, scale_g);
+    j->tracking = false;
+}
+
+void dose_journal_abort(dose_journal_t *j) {
+    if (!j->batch.open) return;
+    append(j, DOSE_JOURNAL_ABORT, j->batch.step, j->batch.pos, j->batch.scale_g);
+    j->tracking = false;
+}
+
+bool dose_journal_point(const dose_journal_t *j, const batch_plan_t *plan, const fluidnc_status_t *live,
+                        dose_journal_point_t *out) {
+    if (!dose_journal_matches(j, plan)) return false;
+
+    // Pumps only move forward: a controller that is not behind the journal kept its position
+    const float *pos = j->batch.pos;
+    float live_pos[DOSE_JOURNAL_AXES];
+    out->live = live != NULL && live->has_mpos;
+    for (int a = 0; a < DOSE_JOURNAL_AXES && out->live; a++) {
+        live_pos[a] = a < live->axis_count ? live->pos[a] : 0.0f;
+        if (live_pos[a] < j->batch.pos[a] - STEP_EPS_MM) out->live = false;
+    }
+    if (out->live) pos = live_pos;
+
+    dose_journal_move_t moves[BATCH_PLAN_MAX_STEPS] = {{0, 0.0f}};
+    uint8_t count = load_moves(plan, moves);
+    locate(moves, count, j->batch.start, pos, &out->step, &out->done_mm);
+    out->done_ml = out->step < count ? out->done_mm * plan->steps[out->step].ml / plan->steps[out->step].mm : 0.0f;
+    out->scale_g = j->batch.scale_g;
+    return true;
+}
+
+void dose_journal_get_stats(const dose_journal_t *j, dose_journal_stats_t *out) {
+    *out = j->stats;
+}
+
+const char *dose_journal_type_name(uint8_t type) {
+    static const char *const names[] = {"?", "BATCH", "STEP", "CHECKPOINT", "STEP_DONE", "BATCH_DONE", "ABORT",
+                                        "RESUME"};
+    return type <= DOSE_JOURNAL_RESUME ? names[type] : "?";
+}
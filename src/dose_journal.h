@@ -0,0 +1,227 @@
+/**
+ * @file dose_journal.h
+ * @brief Power-fail-safe dosing journal: resume a batch where it stopped
+ *
+ * A reset mid-batch used to lose the step being run and how much of it
+ * had gone out; the batch was dumped or pieced together by hand. Here the
+ * progress of the running batch is journaled to flash as it happens:
+ *
+ *   BATCH       batch started (job, batch), MPos at its start
+ *   STEP        step N started
+ *   CHECKPOINT  MPos and scale reading mid-step
+ *   STEP_DONE   step N done
+ *   BATCH_DONE  last "ok": nothing to resume
+ *   ABORT       batch dropped (it runs again from the start)
+ *   RESUME      batch continued, start rebased to the controller's MPos
+ *
+ * Progress is the MPos travelled since the batch started, walked through
+ * the plan's moves in order: each step moves one pump, so the travel
+ * tells which step the pumps are on and how far into it. On boot the
+ * journal is read back; dose_journal_point() turns it into (step, mm done)
+ * for batch_queue_resume(). If FluidNC kept its position (only the ESP32
+ * reset, or a stop) its live MPos is used - it also counts the lines that
+ * were already in its planner - otherwise the last journaled one. When
+ * the resumed batch goes out, dose_journal_start() rebases the batch's
+ * start on the controller's MPos and journaling carries on.
+ *
+ * WRITE AMPLIFICATION:
+ *   Records are 32 bytes in a ring of 4 KB sectors, 127 per sector, like
+ *   event_log.h, written straight to flash (no staging: a record must
+ *   survive the reset that follows it). A checkpoint is written at most
+ *   every checkpoint_ms and only after checkpoint_mm of travel - never at
+ *   a standstill - plus two records per step and per batch. A sector is
+ *   erased once per 127 records, once per lap of the ring. Each sector
+ *   opens with a copy of the open batch (BATCH + CHECKPOINT), so the
+ *   newest sector alone is enough to resume and a boot reads one sector.
+ *   At the defaults (500 ms, 16 sectors) a sector is erased at most once
+ *   per ~17 minutes of pumping: 100k erase cycles last > 25 000 h.
+ *
+ * RULES:
+ * - Feed every status report with MPos to dose_journal_update(), running
+ *   or not: the last position is where the next batch starts.
+ * - Call dose_journal_start() / dose_journal_done() from the batch
+ *   queue's started / finished hooks (no report in between).
+ * - Positions are MPos (FluidNC's default report, $10=1): G92 moves WPos.
+ * - Do not jog a pump while a batch is open (held): the travel would
+ *   count as dosed. dose_journal_abort() first.
+ * - Motion after the last checkpoint is lost if FluidNC lost power too:
+ *   at most checkpoint_ms of the running step (and shown by the scale).
+ *
+ * Shared by the firmware and the host tools; uses esp_partition (host
+ * stand-in in host/esp_idf).
+ *
+ * Usage:
+ *   static dose_journal_t journal;
+ *   dose_journal_init(&journal, "spiffs", NULL);   // Recovers the open batch
+ *   queue hooks: started -> dose_journal_start(), finished -> dose_journal_done()
+ *   every report:  dose_journal_update(&journal, &status, scale_g, now_us);
+ *   after a reset:  batch_queue_plan(batch_queue_job(0), batch_queue_job(0)->done, &plan);
+ *                   if (dose_journal_point(&journal, &plan, &status, &point))
+ *                       batch_queue_resume(now_us, point.step, point.done_mm);
+ */
+
+#ifndef DOSE_JOURNAL_H
+#define DOSE_JOURNAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "batch_queue.h"
+#include "esp_partition.h"
+#include "fluidnc_status.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DOSE_JOURNAL_VERSION        1
+#define DOSE_JOURNAL_SECTOR_SIZE    4096
+#define DOSE_JOURNAL_RECORD_SIZE    32
+#define DOSE_JOURNAL_RECORDS_PER_SECTOR ((DOSE_JOURNAL_SECTOR_SIZE - DOSE_JOURNAL_RECORD_SIZE) / DOSE_JOURNAL_RECORD_SIZE)
+#define DOSE_JOURNAL_AXES           BATCH_PLAN_PUMPS    // X Y Z A
+
+typedef enum {
+    DOSE_JOURNAL_BATCH = 1,     // pos: MPos at the start, step: step in progress (a sector's carried copy)
+    DOSE_JOURNAL_STEP,          // step started, pos: where
+    DOSE_JOURNAL_CHECKPOINT,
+    DOSE_JOURNAL_STEP_DONE,
+    DOSE_JOURNAL_BATCH_DONE,
+    DOSE_JOURNAL_ABORT,
+    DOSE_JOURNAL_RESUME,        // pos: start rebased so that progress is unchanged
+} dose_journal_type_t;
+
+/** One record exactly as stored in flash (little endian) */
+typedef struct __attribute__((packed)) {
+    uint32_t seq;               // +1 per record; 0xFFFFFFFF = erased slot
+    float pos[DOSE_JOURNAL_AXES];   // MPos (BATCH / RESUME: batch start)
+    float scale_g;              // NAN if no scale
+    uint16_t job;               // Job id, low 16 bits
+    uint16_t batch;             // 0-based within the job
+    uint8_t type;               // dose_journal_type_t
+    uint8_t step;
+    uint16_t crc;               // CRC-16/CCITT of the bytes before it
+} dose_journal_record_t;
+
+typedef struct {
+    uint32_t checkpoint_ms;     // Min time between checkpoints
+    float checkpoint_mm;        // Min travel since the last record
+    uint32_t sectors;           // Of the partition, from its start (0 = all of it)
+} dose_journal_config_t;
+
+#define DOSE_JOURNAL_DEFAULT_CONFIG { \
+    .checkpoint_ms = 500, \
+    .checkpoint_mm = 0.5f, \
+    .sectors = 16, \
+}
+
+/** The batch being journaled (or recovered) */
+typedef struct {
+    bool open;                  // Started, not done or aborted
+    uint16_t job;
+    uint16_t batch;
+    uint8_t step;               // Last STEP seen
+    float start[DOSE_JOURNAL_AXES];     // MPos at the start (rebased on resume)
+    float pos[DOSE_JOURNAL_AXES];       // Last journaled MPos
+    float start_scale_g;        // NAN if none
+    float scale_g;              // Last journaled reading
+} dose_journal_batch_t;
+
+/** Where to continue a batch */
+typedef struct {
+    uint8_t step;               // step_count = all done
+    float done_mm;              // Into that step
+    float done_ml;
+    bool live;                  // From the controller's MPos (false: last journaled one)
+    float scale_g;              // Journaled reading at that point, NAN if none
+} dose_journal_point_t;
+
+typedef struct {
+    char pump;
+    float mm;
+} dose_journal_move_t;
+
+typedef struct {
+    uint32_t records;           // Written since init
+    uint32_t checkpoints;
+    uint32_t carried;           // Batch copies opening a sector
+    uint32_t erases;
+    uint32_t write_errors;
+    uint32_t max_erase_count;   // Highest of any sector
+    uint32_t max_write_us;      // Longest record write (a sector erase included)
+} dose_journal_stats_t;
+
+typedef struct {
+    const esp_partition_t *part;
+    dose_journal_config_t cfg;
+    uint32_t sectors;
+    uint32_t head_sector;
+    uint32_t head_slot;         // RECORDS_PER_SECTOR = open a new sector first
+    uint32_t head_sector_seq;
+    uint32_t next_seq;
+
+    dose_journal_batch_t batch;
+    bool tracking;              // Moves known: update() journals progress
+    uint8_t step_count;
+    dose_journal_move_t moves[BATCH_PLAN_MAX_STEPS];
+
+    bool have_pos;
+    float pos[DOSE_JOURNAL_AXES];       // Last reported MPos
+    float record_pos[DOSE_JOURNAL_AXES];    // ... as of the last record
+    int64_t record_us;
+    dose_journal_stats_t stats;
+    bool ready;
+} dose_journal_t;
+
+/**
+ * @brief Find the partition, recover the head and the open batch (config NULL = defaults)
+ * @return false if there is no such partition (nothing is journaled)
+ */
+bool dose_journal_init(dose_journal_t *j, const char *label, const dose_journal_config_t *config);
+
+/**
+ * @brief Batch plan's first line is going out: journal its start at the last reported MPos
+ *
+ * A resumed plan (first_step / first_done_mm) of the open batch continues
+ * it (RESUME, start rebased); anything else closes the open batch first.
+ * @return false if no MPos has been reported yet (not journaled)
+ */
+bool dose_journal_start(dose_journal_t *j, const batch_plan_t *plan, float scale_g);
+
+/**
+ * @brief Every status report: last position; steps and checkpoints while a batch runs
+ */
+void dose_journal_update(dose_journal_t *j, const fluidnc_status_t *status, float scale_g, int64_t now_us);
+
+/**
+ * @brief Batch done (its last "ok"): closes it; the end position is the next start
+ */
+void dose_journal_done(dose_journal_t *j, float scale_g);
+
+/**
+ * @brief Drop the open batch: it will run again from the start
+ */
+void dose_journal_abort(dose_journal_t *j);
+
+/**
+ * @brief The open batch is this plan's (job and batch)
+ */
+bool dose_journal_matches(const dose_journal_t *j, const batch_plan_t *plan);
+
+/**
+ * @brief Where the open batch stopped, by its plan
+ * @param live Current report (NULL = none): used if it has not lost the journaled position
+ * @return false if no batch is open or it is not this plan's
+ */
+bool dose_journal_point(const dose_journal_t *j, const batch_plan_t *plan, const fluidnc_status_t *live,
+                        dose_journal_point_t *out);
+
+void dose_journal_get_stats(const dose_journal_t *j, dose_journal_stats_t *out);
+
+bool dose_journal_record_valid(const dose_journal_record_t *rec);
+const char *dose_journal_type_name(uint8_t type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DOSE_JOURNAL_H
@@ -0,0 +1,210 @@
+/**
+ * @file dose_stats.c
+ * @brief Welford updates, bias correction and the slot table for dose_stats.h
+ *
+ * A record is O(slots) for the lookup and O(1) for the statistics; nothing
+ * allocates. Records only mark the table dirty; dose_stats_save() turns
+ * them into one write.
+ */
+
+#include "dose_stats.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static bool pump_valid(char pump) {
+    return pump && strchr("XYZA", pump) != NULL;
+}
+
+static const char *chemical_key(const char *chemical) {
+    return chemical ? chemical : "";
+}
+
+static bool matches(const dose_stats_slot_t *s, char pump, const char *chemical) {
+    return s->pump == pump && strncmp(s->chemical, chemical_key(chemical), DOSE_STATS_NAME_MAX - 1) == 0;
+}
+
+/** Add x; past `cap` samples (0 = none) n stops growing and older ones fade out */
+static void welford_add(dose_stats_welford_t *w, double x, uint32_t cap) {
+    if (cap == 0 || w->n < cap) {
+        w->n++;
+    } else {
+        w->m2 *= (double)(w->n - 1) / w->n;
+    }
+    double d = x - w->mean;
+    w->mean += d / w->n;
+    w->m2 += d * (x - w->mean);
+}
+
+static double welford_sd(const dose_stats_welford_t *w) {
+    return w->n > 1 ? sqrt(w->m2 / (w->n - 1)) : 0.0;
+}
+
+static int find(const dose_stats_t *ds, char pump, const char *chemical) {
+    for (int i = 0; i < DOSE_STATS_SLOTS; i++) {
+        if (matches(&ds->store.slots[i], pump, chemical)) return i;
+    }
+    return -1;
+}
+
+/** Slot of the pair, a free one, or the one with the fewest doses */
+static dose_stats_slot_t *take(dose_stats_t *ds, char pump, const char *chemical) {
+    int i = find(ds, pump, chemical);
+    if (i >= 0) return &ds->store.slots[i];
+    dose_stats_slot_t *s = NULL;
+    for (i = 0; i < DOSE_STATS_SLOTS; i++) {
+        dose_stats_slot_t *c = &ds->store.slots[i];
+        if (c->pump == '\0') {
+            s = c;
+            break;
+        }
+        if (!s || c->error.n < s->error.n) s = c;
+    }
+    if (s->pump != '\0') ds->stats.evicted++;
+    memset(s, 0, sizeof(*s));
+    s->pump = pump;
+    strncpy(s->chemical, chemical_key(chemical), DOSE_STATS_NAME_MAX - 1);
+    return s;
+}
+
+static float correction(const dose_stats_t *ds, const dose_stats_slot_t *s) {
+    uint16_t min_doses = ds->cfg.min_doses > 0 ? ds->cfg.min_doses : 1;
+    if (!s || s->offset.n < min_doses) return 0.0f;
+    float c = (float)-s->offset.mean;
+    float max = ds->cfg.max_correction_g;
+    return c > max ? max : c < -max ? -max : c;
+}
+
+void dose_stats_init(dose_stats_t *ds, const dose_stats_config_t *config, const dose_stats_store_t *stored) {
+    static const dose_stats_config_t defaults = DOSE_STATS_DEFAULT_CONFIG;
+    memset(ds, 0, sizeof(*ds));
+    ds->cfg = config ? *config : defaults;
+    if (stored && stored->version == DOSE_STATS_VERSION) {
+        ds->store = *stored;
+        for (int i = 0; i < DOSE_STATS_SLOTS; i++) {
+            dose_stats_slot_t *s = &ds->store.slots[i];
+            s->chemical[DOSE_STATS_NAME_MAX - 1] = '\0';
+            if (!pump_valid(s->pump)) memset(s, 0, sizeof(*s));
+        }
+    }
+    ds->store.version = DOSE_STATS_VERSION;
+}
+
+float dose_stats_correction(const dose_stats_t *ds, char pump, const char *chemical) {
+    return correction(ds, dose_stats_find(ds, pump, chemical));
+}
+
+float dose_stats_setpoint(dose_stats_t *ds, char pump, const char *chemical, float target_g) {
+    float c = dose_stats_correction(ds, pump, chemical);
+    if (c != 0.0f) ds->stats.corrected++;
+    float setpoint = target_g + c;
+    return setpoint > 0.0f ? setpoint : 0.0f;
+}
+
+const dose_stats_slot_t *dose_stats_record(dose_stats_t *ds, char pump, const char *chemical, float target_g,
+                                           float setpoint_g, float final_g, uint32_t time_us, int64_t now_us) {
+    if (!pump_valid(pump)) return NULL;
+    dose_stats_slot_t *s = take(ds, pump, chemical);
+
+    float error = final_g - target_g;
+    float time_s = time_us / 1e6f;
+    if (s->error.n == 0 || error < s->min_error_g) s->min_error_g = error;
+    if (s->error.n == 0 || error > s->max_error_g) s->max_error_g = error;
+    if (time_s > s->max_time_s) s->max_time_s = time_s;
+    s->last_error_g = error;
+    welford_add(&s->error, error, 0);
+    welford_add(&s->time, time_s, 0);
+
+    float bin = DOSE_STATS_BINS / 2 + (ds->cfg.bin_g > 0.0f ? floorf(error / ds->cfg.bin_g) : 0.0f);
+    int b = bin < 0.0f ? 0 : bin > DOSE_STATS_BINS - 1 ? DOSE_STATS_BINS - 1 : (int)bin;
+    if (s->bins[b] < UINT16_MAX) s->bins[b]++;
+
+    // The correction learns from the offset, which the correction itself does not move
+    double offset = final_g - setpoint_g;
+    uint16_t min_doses = ds->cfg.min_doses > 0 ? ds->cfg.min_doses : 1;
+    if (s->offset.n >= min_doses && fabs(offset - s->offset.mean) > ds->cfg.outlier_g) {
+        s->outliers++;
+        ds->stats.outliers++;
+        if (++s->outlier_run >= min_doses) {
+            memset(&s->offset, 0, sizeof(s->offset));      // Not outliers any more: the pump changed
+            s->outlier_run = 0;
+            welford_add(&s->offset, offset, ds->cfg.window);
+        }
+    } else {
+        s->outlier_run = 0;
+        welford_add(&s->offset, offset, ds->cfg.window);
+    }
+
+    if (!ds->dirty) ds->dirty_us = now_us;
+    ds->dirty = true;
+    ds->stats.records++;
+    return s;
+}
+
+const dose_stats_slot_t *dose_stats_find(const dose_stats_t *ds, char pump, const char *chemical) {
+    int i = pump_valid(pump) ? find(ds, pump, chemical) : -1;
+    return i < 0 ? NULL : &ds->store.slots[i];
+}
+
+const dose_stats_slot_t *dose_stats_slot(const dose_stats_t *ds, uint8_t i) {
+    if (i >= DOSE_STATS_SLOTS || ds->store.slots[i].pump == '\0') return NULL;
+    return &ds->store.slots[i];
+}
+
+void dose_stats_summary(const dose_stats_t *ds, const dose_stats_slot_t *slot, dose_stats_summary_t *out) {
+    memset(out, 0, sizeof(*out));
+    if (!slot) return;
+    out->doses = slot->error.n;
+    out->mean_error_g = (float)slot->error.mean;
+    out->sd_error_g = (float)welford_sd(&slot->error);
+    out->min_error_g = slot->min_error_g;
+    out->max_error_g = slot->max_error_g;
+    out->offset_g = (float)slot->offset.mean;
+    out->correction_g = correction(ds, slot);
+    out->mean_time_s = (float)slot->time.mean;
+    out->sd_time_s = (float)welford_sd(&slot->time);
+    out->max_time_s = slot->max_time_s;
+}
+
+size_t dose_stats_format(const dose_stats_t *ds, const dose_stats_slot_t *slot, char *buf, size_t size) {
+    dose_stats_summary_t sum;
+    dose_stats_summary(ds, slot, &sum);
+    if (!slot || size == 0) return 0;
+    int n = snprintf(buf, size, "%c%s%s: %lu doses, error %+.2f +/- %.2f g (%+.2f .. %+.2f), correction %+.2f g, %.1f s",
+                     slot->pump, slot->chemical[0] ? " " : "", slot->chemical, (unsigned long)sum.doses,
+                     (double)sum.mean_error_g, (double)sum.sd_error_g, (double)sum.min_error_g,
+                     (double)sum.max_error_g, (double)sum.correction_g, (double)sum.mean_time_s);
+    return n < 0 ? 0 : (size_t)n < size ? (size_t)n : size - 1;
+}
+
+uint8_t dose_stats_reset(dose_stats_t *ds, char pump, const char *chemical) {
+    uint8_t cleared = 0;
+    for (int i = 0; i < DOSE_STATS_SLOTS; i++) {
+        dose_stats_slot_t *s = &ds->store.slots[i];
+        if (s->pump == '\0') continue;
+        if (pump && (s->pump != pump || (chemical && !matches(s, pump, chemical)))) continue;
+        memset(s, 0, sizeof(*s));
+        cleared++;
+    }
+    if (cleared) {
+        ds->dirty = true;
+        ds->flush = true;
+    }
+    return cleared;
+}
+
+bool dose_stats_save(dose_stats_t *ds, int64_t now_us, dose_stats_store_t *out) {
+    if (!ds->dirty) return false;
+    if (!ds->flush && now_us - ds->dirty_us < (int64_t)ds->cfg.persist_ms * 1000) return false;
+    ds->store.saves++;
+    *out = ds->store;
+    ds->dirty = false;
+    ds->flush = false;
+    ds->stats.saves++;
+    return true;
+}
+
+void dose_stats_get_stats(const dose_stats_t *ds, dose_stats_stats_t *out) {
+    *out = ds->stats;
+}
@@ -0,0 +1,207 @@
+/**
+ * @file dose_stats.h
+ * @brief Dosing accuracy per pump and chemical, and the bias correction of the next dose
+ *
+ * Nothing kept how far each dose landed from its target: the final weight
+ * was printed once and dropped, and a pump that stops 0.3 g over did so on
+ * every batch. Here every finished dose is folded into running statistics
+ * of its pump and chemical - Welford updates, constant memory, no samples
+ * kept:
+ *
+ *   error   final - target: mean, variance, min / max, and the overshoot
+ *           distribution (DOSE_STATS_BINS bins of bin_g around 0)
+ *   offset  final - setpoint: what lands past what the pump was told (in
+ *           flight after the stop, deceleration, scale lag, drips). It
+ *           does not depend on the correction applied, so the correction
+ *           is estimated from it.
+ *   time    start to the stop trigger (scale) or to Idle (move): mean,
+ *           variance, max
+ *
+ * BIAS CORRECTION: dose_stats_setpoint() is the target less the mean
+ * offset, once min_doses have been seen - the scale stop point, or the
+ * grams a move is computed from. The offset weighs the last `window`
+ * doses (n capped in its Welford update: an exponential average past
+ * that), so it follows tube wear. An offset further than outlier_g from
+ * the mean (air, a kinked tube) is kept out of it but still counts as an
+ * error; min_doses of them in a row are a new pump behaviour and restart
+ * the estimate. The correction is clamped to max_correction_g. It is an
+ * offset, not a gain: right for the mass after the stop and for a fixed
+ * dead volume. A calibration error that grows with the dose belongs in
+ * ml_per_mm.
+ *
+ * PERSISTENCE: the table is plain data (dose_stats_store_t) the caller
+ * writes when dose_stats_save() says so - at most every persist_ms, so a
+ * run of short doses is one write. A reset loses the doses since.
+ *
+ * RULES:
+ * - Record only a dose that ended on its own (target reached, move done),
+ *   once the scale has settled: a stopped or faulted dose says nothing
+ *   about bias.
+ * - Slots are (pump, chemical); with all DOSE_STATS_SLOTS used, the one
+ *   with the fewest doses is reused.
+ * - dose_stats_reset() after a tube or reservoir change.
+ *
+ * Shared by the firmware and the host tools; does not depend on ESP-IDF.
+ *
+ * Usage:
+ *   dose_stats_init(&ds, NULL, stored_or_NULL);
+ *   start:    setpoint_g = dose_stats_setpoint(&ds, pump, chemical, target_g);
+ *   settled:  slot = dose_stats_record(&ds, pump, chemical, target_g, setpoint_g, final_g, time_us, now_us);
+ *             dose_stats_summary(&ds, slot, &sum);     // console, telemetry_push_accuracy()
+ *   loop():   if (dose_stats_save(&ds, now_us, &store)) write store;
+ */
+
+#ifndef DOSE_STATS_H
+#define DOSE_STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DOSE_STATS_VERSION      1           // Layout of dose_stats_store_t
+#define DOSE_STATS_SLOTS        16          // (pump, chemical) pairs
+#define DOSE_STATS_NAME_MAX     16
+#define DOSE_STATS_BINS         8           // Error histogram, centred on 0
+
+/** Running mean and sum of squared deviations */
+typedef struct {
+    uint32_t n;
+    double mean;
+    double m2;
+} dose_stats_welford_t;
+
+typedef struct {
+    char pump;                  // '\0' = free
+    char chemical[DOSE_STATS_NAME_MAX];
+    uint8_t outlier_run;        // Outlying offsets in a row
+    uint32_t outliers;          // Offsets kept out of the correction
+    dose_stats_welford_t error;     // final - target, g
+    dose_stats_welford_t offset;    // final - setpoint, g (window, no outliers)
+    dose_stats_welford_t time;      // s
+    float min_error_g;
+    float max_error_g;
+    float max_time_s;
+    float last_error_g;
+    uint16_t bins[DOSE_STATS_BINS];     // Error in [i - BINS/2, i - BINS/2 + 1) x bin_g; the end bins are open
+} dose_stats_slot_t;
+
+/** Plain data: stored as one blob */
+typedef struct {
+    uint32_t version;           // DOSE_STATS_VERSION
+    uint32_t saves;             // Writes so far (wear)
+    dose_stats_slot_t slots[DOSE_STATS_SLOTS];
+} dose_stats_store_t;
+
+typedef struct {
+    uint16_t min_doses;         // Before the first correction
+    uint16_t window;            // Doses the offset mean weighs
+    float max_correction_g;     // |correction| limit
+    float outlier_g;            // Offset this far from the mean: not used for the correction
+    float bin_g;                // Histogram bin width
+    uint32_t persist_ms;        // Longest recorded doses stay unsaved
+} dose_stats_config_t;
+
+#define DOSE_STATS_DEFAULT_CONFIG { \
+    .min_doses = 3, \
+    .window = 20, \
+    .max_correction_g = 2.0f, \
+    .outlier_g = 1.0f, \
+    .bin_g = 0.1f, \
+    .persist_ms = 60000, \
+}
+
+/** One slot's figures */
+typedef struct {
+    uint32_t doses;
+    float mean_error_g;
+    float sd_error_g;
+    float min_error_g;
+    float max_error_g;
+    float offset_g;             // Mean final - setpoint
+    float correction_g;         // Added to the next dose's target (0 before min_doses)
+    float mean_time_s;
+    float sd_time_s;
+    float max_time_s;
+} dose_stats_summary_t;
+
+typedef struct {
+    uint32_t records;
+    uint32_t corrected;         // Setpoints that differ from their target
+    uint32_t outliers;
+    uint32_t evicted;           // Slots reused for another pair
+    uint32_t saves;
+} dose_stats_stats_t;
+
+typedef struct {
+    dose_stats_config_t cfg;
+    dose_stats_store_t store;
+    bool dirty;
+    bool flush;                 // Save at once (reset)
+    int64_t dirty_us;           // First unsaved record
+    dose_stats_stats_t stats;
+} dose_stats_t;
+
+/**
+ * @brief Load the config (NULL = defaults) and a stored table (NULL or a wrong version = empty)
+ */
+void dose_stats_init(dose_stats_t *ds, const dose_stats_config_t *config, const dose_stats_store_t *stored);
+
+/**
+ * @brief Correction for the next dose of a pair (0 if it has fewer than min_doses)
+ */
+float dose_stats_correction(const dose_stats_t *ds, char pump, const char *chemical);
+
+/**
+ * @brief Where to stop (scale) or how much to move for target_g: target + correction, >= 0
+ */
+float dose_stats_setpoint(dose_stats_t *ds, char pump, const char *chemical, float target_g);
+
+/**
+ * @brief Fold in a finished dose
+ * @param setpoint_g What the dose was run to (dose_stats_setpoint())
+ * @param final_g Settled net weight
+ * @return Its slot, NULL for a pump that is not X Y Z A
+ */
+const dose_stats_slot_t *dose_stats_record(dose_stats_t *ds, char pump, const char *chemical, float target_g,
+                                           float setpoint_g, float final_g, uint32_t time_us, int64_t now_us);
+
+/**
+ * @brief Slot of a pair, NULL if it has no doses
+ */
+const dose_stats_slot_t *dose_stats_find(const dose_stats_t *ds, char pump, const char *chemical);
+
+/**
+ * @brief Slot i (0 .. DOSE_STATS_SLOTS - 1), NULL if free
+ */
+const dose_stats_slot_t *dose_stats_slot(const dose_stats_t *ds, uint8_t i);
+
+void dose_stats_summary(const dose_stats_t *ds, const dose_stats_slot_t *slot, dose_stats_summary_t *out);
+
+/**
+ * @brief One line: "X Magenta: 12 doses, error +0.04 +/- 0.03 g (-0.01 .. +0.10), correction -0.21 g, 4.2 s"
+ */
+size_t dose_stats_format(const dose_stats_t *ds, const dose_stats_slot_t *slot, char *buf, size_t size);
+
+/**
+ * @brief Forget doses: a pump ('\0' = all) and chemical (NULL = any of the pump)
+ * @return Slots cleared
+ */
+uint8_t dose_stats_reset(dose_stats_t *ds, char pump, const char *chemical);
+
+/**
+ * @brief Copy of the table if it is due for a write
+ * @return true if *out should be written
+ */
+bool dose_stats_save(dose_stats_t *ds, int64_t now_us, dose_stats_store_t *out);
+
+void dose_stats_get_stats(const dose_stats_t *ds, dose_stats_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DOSE_STATS_H
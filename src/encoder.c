@@ -0,0 +1,59 @@
+/**
+ * @file encoder.c
+ * @brief Rotary encoder (KY-040) detent counter from the GPIO ISR
+ *
+ * See encoder.h. The count is only touched with atomics: the ISR adds,
+ * encoder_take() exchanges with zero, so no detent is lost between them.
+ */
+
+#include "encoder.h"
+
+#include <stddef.h>
+
+#include "driver/gpio.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "hal/gpio_ll.h"
+#include "pin_definitions.h"
+
+static volatile int32_t count = 0;
+static int64_t last_us = 0;                 // ISR only
+static volatile encoder_isr_hook_t isr_hook = NULL;
+
+// Pins are read with gpio_ll_get_level(): gpio_get_level() is in flash, and
+// this ISR also runs while a flash write has the cache off
+static void IRAM_ATTR encoder_isr(void *arg) {
+    (void)arg;
+    int64_t now = esp_timer_get_time();
+    if (now - last_us < (int64_t)ENCODER_DEBOUNCE_MS * 1000) return;
+    if (gpio_ll_get_level(&GPIO, ENCODER_CLK_PIN) != 0) return;      // Bounce back up: not a falling edge
+    last_us = now;
+    __atomic_fetch_add(&count, gpio_ll_get_level(&GPIO, ENCODER_DT_PIN) ? 1 : -1, __ATOMIC_RELAXED);
+
+    encoder_isr_hook_t hook = isr_hook;
+    if (hook != NULL) hook();
+}
+
+esp_err_t encoder_init(void) {
+    gpio_config_t io_conf = {
+        .pin_bit_mask = (1ULL << ENCODER_CLK_PIN) | (1ULL << ENCODER_DT_PIN),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    esp_err_t err = gpio_config(&io_conf);
+    if (err != ESP_OK) return err;
+
+    err = gpio_set_intr_type(ENCODER_CLK_PIN, GPIO_INTR_NEGEDGE);
+    if (err != ESP_OK) return err;
+    return gpio_isr_handler_add(ENCODER_CLK_PIN, encoder_isr, NULL);
+}
+
+void encoder_set_isr_hook(encoder_isr_hook_t hook) {
+    isr_hook = hook;
+}
+
+int32_t encoder_take(void) {
+    return __atomic_exchange_n(&count, 0, __ATOMIC_RELAXED);
+}
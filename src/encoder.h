@@ -0,0 +1,45 @@
+/**
+ * @file encoder.h
+ * @brief Rotary encoder (KY-040) detent counter from the GPIO ISR
+ *
+ * One count per detent, decoded like test_02: on the falling CLK edge,
+ * DT high = clockwise (+1), low = counter-clockwise (-1). Edges closer
+ * than ENCODER_DEBOUNCE_MS to the previous accepted one are contact
+ * bounce and dropped. The push switch is BUTTON_SELECT (button_events.h).
+ *
+ * Usage (after button_events_init(), which installs the GPIO ISR service):
+ *   encoder_init();
+ *   encoder_set_isr_hook(wake_ui);           // optional, runs in the ISR
+ *   int32_t detents = encoder_take();        // since the last take
+ */
+
+#ifndef ENCODER_H
+#define ENCODER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Called from the GPIO ISR after every counted detent (IRAM_ATTR, must not block) */
+typedef void (*encoder_isr_hook_t)(void);
+
+/**
+ * @brief Configure CLK / DT with pull-ups and attach the CLK edge ISR
+ */
+esp_err_t encoder_init(void);
+
+void encoder_set_isr_hook(encoder_isr_hook_t hook);
+
+/**
+ * @brief Detents since the previous call (signed), and reset
+ */
+int32_t encoder_take(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ENCODER_H
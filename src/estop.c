@@ -0,0 +1,294 @@
+/**
+ * @file estop.c
+ * @brief Hardware e-stop path with deterministic, microsecond-scale latency
+ *
+ * See estop.h for the design overview.
+ */
+
+#include "estop.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "button_events.h"
+#include "driver/gpio.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "hal/uart_ll.h"
+#include "pin_definitions.h"
+#include "safety_latency.h"
+
+#define ESTOP_CMD_FEED_HOLD     '!'
+#define ESTOP_CMD_STATUS        '?'
+#define ESTOP_CMD_RESET         0x18
+
+static uart_dev_t *estop_uart = NULL;
+static uart_port_t estop_port = UART_NUM_0;
+static uint32_t estop_baud = 115200;
+
+// Trigger side may run in the GPIO ISR on either core
+static portMUX_TYPE estop_mux = portMUX_INITIALIZER_UNLOCKED;
+static volatile estop_state_t state = ESTOP_STATE_CLEAR;
+static volatile estop_source_t source = ESTOP_SOURCE_NONE;
+static const char *volatile reason = NULL;
+static volatile uint32_t trigger_count = 0;
+static volatile int64_t trigger_us = 0;
+static volatile uint32_t fifo_backlog = 0;
+static volatile bool hold_pending = false;      // FIFO was full at trigger, '!' not out yet
+
+// Task side (estop_service / estop_on_status_line)
+static int64_t hold_us = 0;
+static int64_t reset_us = 0;
+static int64_t last_poll_us = 0;
+static bool hold_complete = false;
+static bool rehold = false;                     // A queued line started a move after '!'
+static uint32_t last_latency_us = 0;
+static uint32_t min_latency_us = UINT32_MAX;
+static uint32_t max_latency_us = 0;
+static uint32_t latency_samples = 0;
+
+/**
+ * @brief Put realtime bytes straight into the HW TX FIFO, bypassing the driver ring
+ * @return Number of bytes written (less than len only if the FIFO is full)
+ */
+static uint32_t IRAM_ATTR fifo_write(const uint8_t *bytes, uint32_t len) {
+    uint32_t space = uart_ll_get_txfifo_len(estop_uart);
+    if (len > space) len = space;
+    if (len > 0) {
+        uart_ll_write_txfifo(estop_uart, bytes, len);
+    }
+    return len;
+}
+
+/**
+ * @brief Microseconds to shift n bytes out at the configured baud (10 bits per byte)
+ */
+static inline uint32_t IRAM_ATTR wire_time_us(uint32_t n) {
+    // n <= 129 (FIFO + 1) keeps this within 32 bits; no 64-bit divide in the ISR
+    return estop_baud ? n * 10000000u / estop_baud : 0;
+}
+
+/**
+ * @brief Latch and send '!?' - caller holds estop_mux
+ * @param edge_us Time of the triggering edge (ISR entry) or call
+ */
+static void IRAM_ATTR latch_locked(estop_source_t src, const char *why, int64_t edge_us) {
+    static const DRAM_ATTR uint8_t hold_seq[2] = {ESTOP_CMD_FEED_HOLD, ESTOP_CMD_STATUS};
+
+    trigger_us = edge_us;
+    safety_latency_begin(edge_us);
+    fifo_backlog = UART_LL_FIFO_DEF_LEN - uart_ll_get_txfifo_len(estop_uart);
+    hold_pending = fifo_write(hold_seq, sizeof(hold_seq)) == 0;
+    if (!hold_pending) {
+        int64_t queued_us = esp_timer_get_time();
+        safety_latency_mark(SAFETY_STAGE_ISR, queued_us);
+        // '!' is shifted out after the backlog that was already in the FIFO
+        safety_latency_mark(SAFETY_STAGE_WIRE, queued_us + wire_time_us(fifo_backlog + 1));
+    }
+    source = src;
+    reason = why;
+    trigger_count++;
+    state = ESTOP_STATE_HOLD_SENT;
+}
+
+/**
+ * @brief STOP edge hook - runs inside the level-3 GPIO ISR
+ */
+static void IRAM_ATTR estop_stop_isr(bool pressed, int64_t edge_us) {
+    if (!pressed || estop_uart == NULL) return;
+
+    portENTER_CRITICAL_ISR(&estop_mux);
+    if (state == ESTOP_STATE_CLEAR) {
+        latch_locked(ESTOP_SOURCE_BUTTON, "STOP button", edge_us);
+    }
+    portEXIT_CRITICAL_ISR(&estop_mux);
+}
+
+esp_err_t estop_init(uart_port_t uart_num, uint32_t baud) {
+    if (uart_num >= UART_NUM_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    estop_uart = UART_LL_GET_HW(uart_num);
+    estop_port = uart_num;
+    estop_baud = baud;
+    button_events_set_isr_hook(BUTTON_STOP, estop_stop_isr);
+
+    // STOP already held at boot counts as a press
+    if (gpio_get_level(STOP_BUTTON_PIN) == 0) {
+        estop_trigger("STOP held at boot");
+    }
+    return ESP_OK;
+}
+
+void estop_trigger(const char *why) {
+    if (estop_uart == NULL) return;
+
+    portENTER_CRITICAL(&estop_mux);
+    if (state == ESTOP_STATE_CLEAR) {
+        latch_locked(ESTOP_SOURCE_SOFTWARE, why, esp_timer_get_time());
+    }
+    portEXIT_CRITICAL(&estop_mux);
+}
+
+bool estop_send_realtime(uint8_t cmd) {
+    if (estop_uart == NULL) return false;
+    return uart_write_bytes(estop_port, &cmd, 1) == 1;     // The driver serialises it with G-code writes
+}
+
+void estop_service(void) {
+    if (state != ESTOP_STATE_HOLD_SENT) return;
+
+    int64_t now = esp_timer_get_time();
+
+    if (hold_pending) {
+        static const uint8_t hold_seq[2] = {ESTOP_CMD_FEED_HOLD, ESTOP_CMD_STATUS};
+        portENTER_CRITICAL(&estop_mux);
+        uint32_t backlog = UART_LL_FIFO_DEF_LEN - uart_ll_get_txfifo_len(estop_uart);
+        hold_pending = fifo_write(hold_seq, sizeof(hold_seq)) == 0;
+        portEXIT_CRITICAL(&estop_mux);
+        if (!hold_pending) {
+            safety_latency_mark(SAFETY_STAGE_ISR, now);
+            safety_latency_mark(SAFETY_STAGE_WIRE, now + wire_time_us(backlog + 1));
+        }
+        last_poll_us = now;
+        return;
+    }
+
+    if (rehold) {
+        static const uint8_t hold = ESTOP_CMD_FEED_HOLD;
+        portENTER_CRITICAL(&estop_mux);
+        rehold = fifo_write(&hold, 1) == 0;
+        portEXIT_CRITICAL(&estop_mux);
+    }
+
+    // Ctrl-X only flushes what FluidNC has already received: anything still
+    // in the driver's TX ring would arrive after the reset and run. Let the
+    // ring drain first (the senders stop at the latch), unless it never does.
+    bool ready = hold_complete || now - trigger_us >= (int64_t)ESTOP_HOLD_TIMEOUT_MS * 1000;
+    bool drained = uart_wait_tx_done(estop_port, 0) == ESP_OK ||
+                   now - trigger_us >= (int64_t)ESTOP_DRAIN_TIMEOUT_MS * 1000;
+
+    if (ready && drained) {
+        static const uint8_t reset = ESTOP_CMD_RESET;
+        portENTER_CRITICAL(&estop_mux);
+        bool sent = fifo_write(&reset, 1) == 1;
+        if (sent) {
+            state = ESTOP_STATE_RESET_SENT;
+        }
+        portEXIT_CRITICAL(&estop_mux);
+        if (sent) {
+            reset_us = now;
+        }
+        return;
+    }
+
+    if (now - last_poll_us >= (int64_t)ESTOP_STATUS_POLL_MS * 1000) {
+        static const uint8_t status = ESTOP_CMD_STATUS;
+        portENTER_CRITICAL(&estop_mux);
+        fifo_write(&status, 1);
+        portEXIT_CRITICAL(&estop_mux);
+        last_poll_us = now;
+    }
+}
+
+bool estop_on_status_line(const char *line) {
+    if (line == NULL || line[0] != '<' || state == ESTOP_STATE_CLEAR) {
+        return false;
+    }
+
+    bool completed = false;
+    safety_latency_on_status(line, esp_timer_get_time());
+
+    // Hold:0 = deceleration finished, Hold:1 = still decelerating.
+    // Idle means nothing was moving, so there is nothing to wait for.
+    if (strncmp(line, "<Hold:0", 7) == 0 || strncmp(line, "<Alarm", 6) == 0 ||
+        strncmp(line, "<Idle", 5) == 0) {
+        hold_complete = true;
+    } else if (state == ESTOP_STATE_HOLD_SENT &&
+               (strncmp(line, "<Run", 4) == 0 || strncmp(line, "<Jog", 4) == 0)) {
+        // A line still draining from the TX ring started a move after '!'
+        // was seen (e.g. '!' arrived while Idle): hold again before Ctrl-X
+        hold_complete = false;
+        rehold = true;
+    }
+
+    if (hold_us == 0 && (strncmp(line, "<Hold", 5) == 0 || strncmp(line, "<Alarm", 6) == 0)) {
+        hold_us = esp_timer_get_time();
+        int64_t latency = hold_us - trigger_us;
+        last_latency_us = latency > 0 ? (uint32_t)latency : 0;
+        if (last_latency_us < min_latency_us) min_latency_us = last_latency_us;
+        if (last_latency_us > max_latency_us) max_latency_us = last_latency_us;
+        latency_samples++;
+        completed = true;
+    }
+
+    return completed;
+}
+
+bool estop_is_latched(void) {
+    return state != ESTOP_STATE_CLEAR;
+}
+
+bool estop_clear(void) {
+    if (state != ESTOP_STATE_RESET_SENT) return false;
+    if (gpio_get_level(STOP_BUTTON_PIN) == 0) return false;     // Still held
+
+    portENTER_CRITICAL(&estop_mux);
+    state = ESTOP_STATE_CLEAR;
+    source = ESTOP_SOURCE_NONE;
+    portEXIT_CRITICAL(&estop_mux);
+
+    hold_us = 0;
+    reset_us = 0;
+    hold_complete = false;
+    rehold = false;
+    return true;
+}
+
+void estop_get_status(estop_status_t *out) {
+    portENTER_CRITICAL(&estop_mux);
+    out->state = state;
+    out->source = source;
+    out->reason = reason;
+    out->trigger_count = trigger_count;
+    out->trigger_us = trigger_us;
+    out->fifo_backlog = fifo_backlog;
+    portEXIT_CRITICAL(&estop_mux);
+
+    out->hold_us = hold_us;
+    out->reset_us = reset_us;
+    out->last_latency_us = last_latency_us;
+    out->min_latency_us = latency_samples ? min_latency_us : 0;
+    out->max_latency_us = max_latency_us;
+    out->latency_samples = latency_samples;
+}
+
+void estop_report(void) {
+    static const char *state_names[] = {"CLEAR", "HOLD_SENT", "RESET_SENT"};
+    static const char *source_names[] = {"none", "button", "software"};
+    estop_status_t st;
+    estop_get_status(&st);
+
+    uint32_t backlog_us = wire_time_us(st.fifo_backlog);
+
+    printf("\n=== E-STOP ===\n");
+    printf("State:     %s (source: %s)\n", state_names[st.state], source_names[st.source]);
+    printf("Reason:    %s\n", st.reason ? st.reason : "-");
+    printf("Triggers:  %lu\n", (unsigned long)st.trigger_count);
+    printf("Backlog:   %lu bytes ahead of '!' (~%lu us on the wire)\n",
+           (unsigned long)st.fifo_backlog, (unsigned long)backlog_us);
+    if (st.reset_us > 0) {
+        printf("Ctrl-X:    %lu us after trigger\n", (unsigned long)(st.reset_us - st.trigger_us));
+    }
+    if (st.latency_samples > 0) {
+        printf("Press->Hold latency: last %lu us, min %lu us, max %lu us (%lu samples)\n",
+               (unsigned long)st.last_latency_us, (unsigned long)st.min_latency_us,
+               (unsigned long)st.max_latency_us, (unsigned long)st.latency_samples);
+    } else {
+        printf("Press->Hold latency: no samples yet\n");
+    }
+    printf("==============\n");
+
+    safety_latency_report();
+}
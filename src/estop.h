@@ -0,0 +1,152 @@
+/**
+ * @file estop.h
+ * @brief Hardware e-stop path with deterministic, microsecond-scale latency
+ *
+ * The old sketches polled STOP_BUTTON_PIN once per loop (50 ms in test_17,
+ * behind every delay() in test_19) and then sent "!" with println() +
+ * flush(), i.e. behind any G-code still in the UART driver's TX buffer.
+ *
+ * This module instead:
+ * 1. Hooks the STOP edge inside the level-3 GPIO ISR (button_events.c)
+ * 2. Writes the realtime feed-hold byte '!' (plus '?' for an immediate
+ *    status report) straight into the UART hardware TX FIFO, ahead of
+ *    everything queued in the driver's software ring buffer
+ * 3. Latches the e-stop state; G-code senders must check estop_is_latched()
+ * 4. From estop_service(): once FluidNC reports Hold:0 (deceleration done)
+ *    or ESTOP_HOLD_TIMEOUT_MS expires, and the driver's TX ring has
+ *    drained, sends Ctrl-X (0x18) on the same path
+ * 5. Measures press-to-Hold latency from status lines fed to
+ *    estop_on_status_line(); the full edge -> ISR -> wire -> Hold ->
+ *    stopped timeline and its histograms live in safety_latency.h
+ *
+ * Realtime bytes are filtered out by FluidNC wherever they appear in the
+ * stream, so injecting them between bytes of an in-flight G-code line is
+ * safe. Worst case the '!' waits behind what is already in the 128-byte
+ * hardware FIFO; that backlog is recorded with every trigger.
+ *
+ * G-code already in the driver's TX ring keeps going out behind the '!'.
+ * Ctrl-X only discards what FluidNC has received, so it waits for the ring
+ * to drain (up to ESTOP_DRAIN_TIMEOUT_MS); the leftover lines land in the
+ * held planner and are flushed by the reset instead of running after it.
+ * A '!' that arrives while Idle is ignored by FluidNC, so a Run/Jog report
+ * after the latch gets another '!' before the reset.
+ *
+ * Usage (Arduino sketch):
+ *   UartSerial.begin(...);              // UART driver must exist first
+ *   button_events_init();
+ *   estop_init(RODENT_UART_NUM, 115200);
+ *   loop():  estop_service();
+ *            estop_on_status_line(line);   // every line from FluidNC
+ */
+
+#ifndef ESTOP_H
+#define ESTOP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "driver/uart.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ESTOP_HOLD_TIMEOUT_MS   500     // Send Ctrl-X even if Hold:0 never arrives
+#define ESTOP_STATUS_POLL_MS    20      // '?' interval while waiting for Hold:0
+#define ESTOP_DRAIN_TIMEOUT_MS  1000    // Send Ctrl-X even if the TX ring never drains
+
+typedef enum {
+    ESTOP_STATE_CLEAR = 0,      // Normal operation
+    ESTOP_STATE_HOLD_SENT,      // '!' in the FIFO, waiting for Hold:0
+    ESTOP_STATE_RESET_SENT,     // Ctrl-X sent, latched until estop_clear()
+} estop_state_t;
+
+typedef enum {
+    ESTOP_SOURCE_NONE = 0,
+    ESTOP_SOURCE_BUTTON,        // STOP button edge (GPIO ISR)
+    ESTOP_SOURCE_SOFTWARE,      // estop_trigger() from task context
+} estop_source_t;
+
+typedef struct {
+    estop_state_t state;
+    estop_source_t source;
+    const char *reason;             // Last trigger reason (static string)
+    uint32_t trigger_count;
+    int64_t trigger_us;             // ISR / trigger time of the current e-stop
+    uint32_t fifo_backlog;          // Bytes ahead of '!' in the HW FIFO at trigger
+    int64_t hold_us;                // First <Hold or <Alarm status after trigger (0 = not yet)
+    int64_t reset_us;               // Ctrl-X sent (0 = not yet)
+    uint32_t last_latency_us;       // trigger -> first Hold status
+    uint32_t min_latency_us;
+    uint32_t max_latency_us;
+    uint32_t latency_samples;
+} estop_status_t;
+
+/**
+ * @brief Hook the STOP button ISR and bind the e-stop to a UART
+ * @param uart_num UART connected to FluidNC (driver already installed)
+ * @param baud Baud rate, used to compute wire time for the backlog
+ * @return ESP_OK on success
+ */
+esp_err_t estop_init(uart_port_t uart_num, uint32_t baud);
+
+/**
+ * @brief Software e-stop (console command, safety monitor, ...)
+ *
+ * Same path as the button: '!' goes straight into the HW FIFO.
+ * Safe from any task; not from an ISR (use the button hook for that).
+ */
+void estop_trigger(const char *reason);
+
+/**
+ * @brief Non-latching realtime byte ('!' feed hold, 0x85 jog cancel, '?', ...) on the e-stop's UART
+ *
+ * Not the e-stop fast path: the byte goes through the UART driver, after
+ * the G-code already in its TX ring. Writing the HW FIFO is only safe
+ * for the latched e-stop, which stops everything else; here it would
+ * interleave with or drop bytes of a line the driver is sending. Realtime
+ * bytes are filtered out wherever they land in the stream, so a byte
+ * between two lines is fine. Blocks while the TX ring is full. Safe from
+ * any task; not from an ISR.
+ *
+ * @return false if estop_init() has not run or the driver refused it
+ */
+bool estop_send_realtime(uint8_t cmd);
+
+/**
+ * @brief Advance the e-stop state machine (poll status, drain, send Ctrl-X). Call every loop.
+ */
+void estop_service(void);
+
+/**
+ * @brief Feed every line received from FluidNC
+ * @return true if this line completed a press-to-Hold latency measurement
+ */
+bool estop_on_status_line(const char *line);
+
+/**
+ * @brief True from the trigger until estop_clear() succeeds
+ */
+bool estop_is_latched(void);
+
+/**
+ * @brief Operator reset. Refused while STOP is still held or before Ctrl-X went out.
+ * @return true if the latch was cleared
+ */
+bool estop_clear(void);
+
+/**
+ * @brief Snapshot of state and latency figures
+ */
+void estop_get_status(estop_status_t *out);
+
+/**
+ * @brief Print state, latency figures and the safety_latency histograms
+ */
+void estop_report(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESTOP_H
@@ -0,0 +1,387 @@
+/**
+ * @file event_log.c
+ * @brief Sector ring, head recovery, staging and read cursor for event_log.h
+ */
+
+#include "event_log.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "esp_timer.h"
+
+#define SECTOR_MAGIC        0x474C5645u     // "EVLG"
+#define STAGE_MASK          (EVENT_LOG_STAGE - 1)
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t record_size;
+    uint16_t reserved;
+    uint32_t sector_seq;        // +1 per sector opened; the highest is the head
+    uint32_t erase_count;       // Erases of this sector
+    uint32_t first_seq;         // Seq of slot 0
+    uint8_t pad[10];
+    uint16_t crc;
+} sector_header_t;
+
+_Static_assert(sizeof(event_record_t) == EVENT_LOG_RECORD_SIZE, "event_record_t must be 32 bytes");
+_Static_assert(sizeof(sector_header_t) == EVENT_LOG_RECORD_SIZE, "sector header must be one record slot");
+_Static_assert((EVENT_LOG_STAGE & STAGE_MASK) == 0, "EVENT_LOG_STAGE must be a power of two");
+_Static_assert(sizeof(event_log_dump_header_t) == 16, "dump header is 16 bytes");
+_Static_assert(sizeof(event_log_dump_trailer_t) == 12, "dump trailer is 12 bytes");
+
+// ============================================================================
+// CHECKSUMS
+// ============================================================================
+
+static uint16_t crc16(const void *data, size_t len) {
+    const uint8_t *p = data;
+    uint16_t crc = 0xFFFF;                      // CRC-16/CCITT-FALSE
+    while (len--) {
+        crc ^= (uint16_t)(*p++) << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+uint32_t event_log_crc32(uint32_t crc, const void *data, size_t len) {
+    const uint8_t *p = data;
+    crc = ~crc;
+    while (len--) {
+        crc ^= *p++;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+bool event_log_record_valid(const event_record_t *rec) {
+    return rec->seq != 0xFFFFFFFFu && rec->crc == crc16(rec, offsetof(event_record_t, crc));
+}
+
+static bool header_valid(const sector_header_t *h) {
+    return h->magic == SECTOR_MAGIC && h->version == EVENT_LOG_VERSION &&
+           h->record_size == EVENT_LOG_RECORD_SIZE && h->crc == crc16(h, offsetof(sector_header_t, crc));
+}
+
+static bool erased(const void *data, size_t len) {
+    const uint8_t *p = data;
+    for (size_t i = 0; i < len; i++) {
+        if (p[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+// ============================================================================
+// FLASH ACCESS
+// ============================================================================
+
+static inline size_t sector_addr(uint32_t sector) {
+    return (size_t)sector * EVENT_LOG_SECTOR_SIZE;
+}
+
+static inline size_t slot_addr(uint32_t sector, uint32_t slot) {
+    return sector_addr(sector) + EVENT_LOG_RECORD_SIZE * (size_t)(slot + 1);
+}
+
+static bool read_header(const event_log_t *log, uint32_t sector, sector_header_t *h) {
+    return esp_partition_read(log->part, sector_addr(sector), h, sizeof(*h)) == ESP_OK && header_valid(h);
+}
+
+static bool read_slot(const event_log_t *log, uint32_t sector, uint32_t slot, event_record_t *rec) {
+    return esp_partition_read(log->part, slot_addr(sector, slot), rec, sizeof(*rec)) == ESP_OK;
+}
+
+/**
+ * @brief Newest valid record of a sector
+ */
+static bool last_record(const event_log_t *log, uint32_t sector, event_record_t *out) {
+    for (int slot = EVENT_LOG_RECORDS_PER_SECTOR - 1; slot >= 0; slot--) {
+        if (read_slot(log, sector, (uint32_t)slot, out) && event_log_record_valid(out)) return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Erase the sector after the head and make it the head
+ */
+static bool open_sector(event_log_t *log, uint32_t first_seq) {
+    uint32_t next = (log->head_sector + 1) % log->sectors;
+
+    sector_header_t h;
+    uint32_t erase_count = read_header(log, next, &h) ? h.erase_count + 1 : 1;
+    if (esp_partition_erase_range(log->part, sector_addr(next), EVENT_LOG_SECTOR_SIZE) != ESP_OK) {
+        return false;
+    }
+
+    memset(&h, 0, sizeof(h));
+    h.magic = SECTOR_MAGIC;
+    h.version = EVENT_LOG_VERSION;
+    h.record_size = EVENT_LOG_RECORD_SIZE;
+    h.sector_seq = log->head_sector_seq + 1;
+    h.erase_count = erase_count;
+    h.first_seq = first_seq;
+    h.crc = crc16(&h, offsetof(sector_header_t, crc));
+    if (esp_partition_write(log->part, sector_addr(next), &h, sizeof(h)) != ESP_OK) return false;
+
+    log->head_sector = next;
+    log->head_slot = 0;
+    log->head_sector_seq = h.sector_seq;
+    if (erase_count > log->max_erase_count) log->max_erase_count = erase_count;
+
+    // The sector after the new head is now the oldest one, once the ring has wrapped
+    sector_header_t after;
+    if (read_header(log, (next + 1) % log->sectors, &after) && after.sector_seq < h.sector_seq) {
+        log->oldest_seq = after.first_seq;
+    } else if (log->oldest_seq > first_seq || log->flushed_seq == log->oldest_seq) {
+        log->oldest_seq = first_seq;
+    }
+    return true;
+}
+
+// ============================================================================
+// INIT
+// ============================================================================
+
+/**
+ * @brief Head sector, first free slot and next seq from what is in flash
+ */
+static void recover(event_log_t *log) {
+    bool found = false;
+    uint32_t head = 0;
+    sector_header_t head_hdr;
+    uint32_t oldest_sector_seq = 0;
+    uint32_t oldest_first_seq = 0;
+
+    for (uint32_t s = 0; s < log->sectors; s++) {
+        sector_header_t h;
+        if (!read_header(log, s, &h)) continue;
+        if (h.erase_count > log->max_erase_count) log->max_erase_count = h.erase_count;
+        if (!found || h.sector_seq > head_hdr.sector_seq) {
+            head = s;
+            head_hdr = h;
+        }
+        if (!found || h.sector_seq < oldest_sector_seq) {
+            oldest_sector_seq = h.sector_seq;
+            oldest_first_seq = h.first_seq;
+        }
+        found = true;
+    }
+
+    if (!found) {
+        // Blank (or foreign) partition: the first service opens sector 0
+        log->head_sector = log->sectors - 1;
+        log->head_slot = EVENT_LOG_RECORDS_PER_SECTOR;
+        log->head_sector_seq = 0;
+        log->next_seq = 0;
+        log->oldest_seq = 0;
+        log->boot = 1;
+        return;
+    }
+
+    log->head_sector = head;
+    log->head_sector_seq = head_hdr.sector_seq;
+    log->oldest_seq = oldest_first_seq;
+
+    // First erased slot; anything else that fails its CRC is a torn write
+    uint32_t used = 0;
+    bool torn = false;
+    event_record_t rec;
+    event_record_t last;
+    bool have_last = false;
+    for (; used < EVENT_LOG_RECORDS_PER_SECTOR; used++) {
+        if (!read_slot(log, head, used, &rec) || erased(&rec, sizeof(rec))) break;
+        if (event_log_record_valid(&rec)) {
+            last = rec;
+            have_last = true;
+        } else {
+            torn = true;
+        }
+    }
+    // Keep seq contiguous within a sector: continue after a torn slot in a new one
+    log->head_slot = torn ? EVENT_LOG_RECORDS_PER_SECTOR : used;
+
+    if (!have_last) {
+        uint32_t prev = (head + log->sectors - 1) % log->sectors;
+        have_last = last_record(log, prev, &last);
+    }
+    log->next_seq = have_last ? last.seq + 1 : head_hdr.first_seq;
+    log->boot = have_last ? (uint16_t)(last.boot + 1) : 1;
+}
+
+bool event_log_init(event_log_t *log, const char *label) {
+    portMUX_TYPE unlocked = portMUX_INITIALIZER_UNLOCKED;
+    memset(log, 0, sizeof(*log));
+    log->mux = unlocked;
+
+    log->part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (log->part == NULL) return false;
+    log->sectors = log->part->size / EVENT_LOG_SECTOR_SIZE;
+    if (log->sectors < 2) return false;
+
+    recover(log);
+    log->flushed_seq = log->next_seq;
+    log->ready = true;
+    event_log_append(log, EVENT_BOOT, EVENT_RESULT_OK, 0, 0, NAN, log->sectors);
+    return true;
+}
+
+// ============================================================================
+// APPEND / SERVICE
+// ============================================================================
+
+bool event_log_append(event_log_t *log, event_type_t type, event_result_t result, uint16_t cmd_id,
+                      uint32_t duration_us, float mass_g, uint32_t arg) {
+    event_record_t rec;
+    rec.duration_us = duration_us;
+    rec.t_us = esp_timer_get_time();
+    rec.mass_g = mass_g;
+    rec.arg = arg;
+    rec.cmd_id = cmd_id;
+    rec.type = (uint8_t)type;
+    rec.result = (uint8_t)result;
+    rec.crc = 0;                                // By event_log_service(), outside the lock
+
+    bool ok = false;
+    portENTER_CRITICAL(&log->mux);
+    if (!log->ready || log->stage_head - log->stage_tail >= EVENT_LOG_STAGE) {
+        log->dropped++;
+    } else {
+        rec.seq = log->next_seq++;              // Seq order = staging order, across tasks
+        rec.boot = log->boot;
+        log->stage[log->stage_head & STAGE_MASK] = rec;
+        log->stage_head++;
+        ok = true;
+    }
+    portEXIT_CRITICAL(&log->mux);
+    return ok;
+}
+
+int event_log_service(event_log_t *log, int max_records) {
+    if (!log->ready) return 0;
+
+    int written = 0;
+    while (written < max_records) {
+        event_record_t rec;
+        bool have;
+        portENTER_CRITICAL(&log->mux);
+        have = log->stage_head != log->stage_tail;
+        if (have) rec = log->stage[log->stage_tail & STAGE_MASK];
+        portEXIT_CRITICAL(&log->mux);
+        if (!have) break;
+
+        if (log->head_slot >= EVENT_LOG_RECORDS_PER_SECTOR && !open_sector(log, rec.seq)) {
+            log->write_errors++;
+            break;                              // Stays staged; retried next service
+        }
+
+        rec.crc = crc16(&rec, offsetof(event_record_t, crc));
+        if (esp_partition_write(log->part, slot_addr(log->head_sector, log->head_slot), &rec, sizeof(rec)) !=
+            ESP_OK) {
+            log->write_errors++;
+            log->head_slot = EVENT_LOG_RECORDS_PER_SECTOR;  // Retry in a fresh sector
+            break;
+        }
+        log->head_slot++;
+        log->flushed_seq = rec.seq + 1;
+
+        portENTER_CRITICAL(&log->mux);
+        log->stage_tail++;
+        portEXIT_CRITICAL(&log->mux);
+        written++;
+    }
+    return written;
+}
+
+// ============================================================================
+// READ
+// ============================================================================
+
+uint32_t event_log_count(const event_log_t *log) {
+    return log->flushed_seq - log->oldest_seq;
+}
+
+uint32_t event_log_capacity(const event_log_t *log) {
+    return log->sectors * EVENT_LOG_RECORDS_PER_SECTOR;
+}
+
+uint32_t event_log_seek(const event_log_t *log, event_log_cursor_t *cur, uint32_t last_n) {
+    uint32_t avail = event_log_count(log);
+    uint32_t n = (last_n == 0 || last_n > avail) ? avail : last_n;
+    uint32_t target = log->flushed_seq - n;
+
+    cur->sector = log->head_sector;
+    cur->slot = log->head_slot;
+    cur->seq = log->flushed_seq;
+    if (n == 0) return 0;
+
+    uint32_t s = log->head_sector;
+    for (uint32_t i = 0; i < log->sectors; i++) {
+        sector_header_t h;
+        if (read_header(log, s, &h) && h.first_seq <= target) {
+            cur->sector = s;
+            cur->slot = target - h.first_seq;
+            cur->seq = target;
+            return n;
+        }
+        s = (s + log->sectors - 1) % log->sectors;
+    }
+    return 0;
+}
+
+bool event_log_next(const event_log_t *log, event_log_cursor_t *cur, event_record_t *rec) {
+    // Two tries: a torn slot ends its sector, the record is then at slot 0 of the next
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (cur->seq >= log->flushed_seq) return false;
+        if (cur->slot >= EVENT_LOG_RECORDS_PER_SECTOR) {
+            cur->sector = (cur->sector + 1) % log->sectors;
+            cur->slot = 0;
+        }
+        if (read_slot(log, cur->sector, cur->slot, rec) && event_log_record_valid(rec) && rec->seq == cur->seq) {
+            cur->slot++;
+            cur->seq++;
+            return true;
+        }
+        if (cur->slot == 0) return false;       // Overwritten under the cursor
+        cur->slot = EVENT_LOG_RECORDS_PER_SECTOR;
+    }
+    return false;
+}
+
+// ============================================================================
+// DUMP / NAMES
+// ============================================================================
+
+void event_log_dump_header(const event_log_t *log, const event_log_cursor_t *cur, uint32_t count,
+                           event_log_dump_header_t *out) {
+    memcpy(out->magic, EVENT_LOG_DUMP_MAGIC, sizeof(out->magic));
+    out->version = EVENT_LOG_VERSION;
+    out->record_size = EVENT_LOG_RECORD_SIZE;
+    out->boot = log->boot;
+    out->count = count;
+    out->first_seq = cur->seq;
+}
+
+void event_log_dump_trailer(uint32_t count, uint32_t crc32, event_log_dump_trailer_t *out) {
+    memcpy(out->magic, EVENT_LOG_DUMP_END_MAGIC, sizeof(out->magic));
+    out->count = count;
+    out->crc32 = crc32;
+}
+
+const char *event_type_name(uint8_t type) {
+    static const char *const names[] = {
+        "?", "BOOT", "COMMAND", "DOSE_START", "DOSE_DONE", "HOLD",
+        "RESUME", "ESTOP", "FLOW_FAULT", "ALARM", "MARK",
+    };
+    return type < sizeof(names) / sizeof(names[0]) ? names[type] : "?";
+}
+
+const char *event_result_name(uint8_t result) {
+    static const char *const names[] = {"OK", "ERROR", "TIMEOUT", "ABORTED"};
+    return result < sizeof(names) / sizeof(names[0]) ? names[result] : "?";
+}
@@ -0,0 +1,219 @@
+/**
+ * @file event_log.h
+ * @brief Persistent event log: fixed 32-byte records in a wear-leveled flash ring
+ *
+ * Replaces the RAM-only String log of test_18, which lost everything on
+ * reset and fragmented the heap. Every command, dose, hold, fault and
+ * e-stop becomes one fixed-size record in a dedicated data partition, so
+ * the whole batch history survives resets and can be pulled for audits.
+ *
+ * FLASH LAYOUT:
+ *   The partition is a ring of 4 KB sectors. Each sector starts with a
+ *   32-byte header (magic, format, sector sequence, erase count, seq of its
+ *   first record) followed by 127 records. Records are only ever appended;
+ *   when the head sector is full the next one in the ring (the oldest) is
+ *   erased and reopened. Every sector is erased exactly once per lap, which
+ *   is as even as wear can get; the erase counts in the headers show it.
+ *   A 1 MB partition holds 32 512 records, the 1.375 MB Arduino "spiffs"
+ *   partition 44 704.
+ *
+ * RULES:
+ * - event_log_append() is O(1) and never touches flash: it stamps the
+ *   record (time, sequence number) and copies it into a RAM staging ring
+ *   under a spinlock. Any task may call it. A full staging ring drops the
+ *   record and counts it.
+ * - event_log_service() moves staged records to flash. Call it from one
+ *   low-priority context (sketch loop, telemetry task). Opening a sector
+ *   costs one erase (~45 ms); everything else is a 32-byte write.
+ * - Record seq numbers are contiguous within a sector. A torn write after
+ *   a power cut fails its CRC; the next boot starts a fresh sector after it.
+ * - Records are not readable until serviced to flash.
+ * - The partition is owned by the log: a SPIFFS image in it is overwritten.
+ *
+ * EXPORT:
+ *   event_log_dump_* frame a binary dump for a serial link:
+ *   header (16 bytes, "EVLD") + records + trailer (12 bytes, "EVLE", count,
+ *   CRC-32 of the records). host/evlog/evlog_decode.py turns a capture (or
+ *   a raw partition image read with esptool) into CSV.
+ *
+ * Shared by the firmware (main/), test_18 and the host tools; uses
+ * esp_partition and a portMUX (host stand-ins in host/esp_idf).
+ *
+ * Usage:
+ *   static event_log_t evlog;
+ *   event_log_init(&evlog, "spiffs");               // Partition label
+ *   event_log_append(&evlog, EVENT_DOSE_DONE, EVENT_RESULT_OK, dose_id, us, grams, 'X');
+ *   loop():  event_log_service(&evlog, EVENT_LOG_SERVICE_BATCH);
+ */
+
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_partition.h"
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define EVENT_LOG_VERSION           1
+#define EVENT_LOG_SECTOR_SIZE       4096
+#define EVENT_LOG_RECORD_SIZE       32
+#define EVENT_LOG_RECORDS_PER_SECTOR ((EVENT_LOG_SECTOR_SIZE - EVENT_LOG_RECORD_SIZE) / EVENT_LOG_RECORD_SIZE)
+#define EVENT_LOG_STAGE             64      // Power of two; records between two services
+#define EVENT_LOG_SERVICE_BATCH     16      // Suggested records per service call
+
+typedef enum {
+    EVENT_BOOT = 1,             // arg: partition sectors
+    EVENT_COMMAND,              // cmd_id: line number, duration: to response, arg: first 4 chars
+    EVENT_DOSE_START,           // cmd_id: dose number, mass: target g, arg: pump letter
+    EVENT_DOSE_DONE,            // cmd_id: dose number, duration: dose time, mass: dosed g, arg: pump
+    EVENT_HOLD,                 // Feed hold (operator or flow fault)
+    EVENT_RESUME,
+    EVENT_ESTOP,
+    EVENT_FLOW_FAULT,           // arg: flow_fault_code_t, mass: scale g
+    EVENT_ALARM,                // arg: ALARM:N
+    EVENT_MARK,                 // Operator mark (log "cleared" from the console)
+} event_type_t;
+
+typedef enum {
+    EVENT_RESULT_OK = 0,
+    EVENT_RESULT_ERROR,         // error:N / refused (arg or cmd_id carries the code)
+    EVENT_RESULT_TIMEOUT,
+    EVENT_RESULT_ABORTED,       // Stopped by hold, e-stop or alarm
+} event_result_t;
+
+/** One record exactly as stored in flash and in a dump (little endian) */
+typedef struct __attribute__((packed)) {
+    uint32_t seq;               // Global, +1 per record; 0xFFFFFFFF = erased slot
+    uint32_t duration_us;
+    int64_t t_us;               // esp_timer time of the event (since this boot)
+    float mass_g;               // NAN if none
+    uint32_t arg;               // Type-specific, see event_type_t
+    uint16_t cmd_id;
+    uint16_t boot;              // Boot count, so t_us can be ordered across resets
+    uint8_t type;               // event_type_t
+    uint8_t result;             // event_result_t
+    uint16_t crc;               // CRC-16/CCITT of the bytes before it
+} event_record_t;
+
+typedef struct {
+    const esp_partition_t *part;
+    uint32_t sectors;
+    uint32_t head_sector;       // Sector being filled
+    uint32_t head_slot;         // Next free slot in it (RECORDS_PER_SECTOR = open a new one)
+    uint32_t head_sector_seq;
+    uint32_t oldest_seq;        // First record still in flash
+    uint32_t next_seq;          // Next record to be staged
+    uint32_t flushed_seq;       // Next record to be written to flash
+    uint16_t boot;
+    uint32_t max_erase_count;
+
+    portMUX_TYPE mux;
+    event_record_t stage[EVENT_LOG_STAGE];
+    uint32_t stage_head;        // Free-running; head - tail = staged
+    uint32_t stage_tail;
+
+    uint32_t dropped;           // Staging ring full
+    uint32_t write_errors;
+    bool ready;
+} event_log_t;
+
+/** Read position, see event_log_seek() */
+typedef struct {
+    uint32_t sector;
+    uint32_t slot;
+    uint32_t seq;               // Expected seq of the next record
+} event_log_cursor_t;
+
+/** Dump framing */
+#define EVENT_LOG_DUMP_MAGIC        "EVLD"
+#define EVENT_LOG_DUMP_END_MAGIC    "EVLE"
+
+typedef struct __attribute__((packed)) {
+    char magic[4];              // "EVLD"
+    uint8_t version;
+    uint8_t record_size;
+    uint16_t boot;              // Boot the dump was taken in
+    uint32_t count;             // Records announced (the trailer has the real count)
+    uint32_t first_seq;
+} event_log_dump_header_t;
+
+typedef struct __attribute__((packed)) {
+    char magic[4];              // "EVLE"
+    uint32_t count;             // Records sent
+    uint32_t crc32;             // CRC-32 (zlib) of the records sent
+} event_log_dump_trailer_t;
+
+/**
+ * @brief Find the partition, recover the head from the sector headers, log EVENT_BOOT
+ * @param label Partition label ("spiffs" on the Arduino default table, "evlog" in partitions.csv)
+ * @return false if there is no such partition (appends are then dropped)
+ */
+bool event_log_init(event_log_t *log, const char *label);
+
+/**
+ * @brief Stage one record; O(1), never touches flash, any task
+ * @return false if the staging ring is full (record dropped and counted)
+ */
+bool event_log_append(event_log_t *log, event_type_t type, event_result_t result, uint16_t cmd_id,
+                      uint32_t duration_us, float mass_g, uint32_t arg);
+
+/**
+ * @brief Write up to max_records staged records to flash (single caller)
+ * @return Records written
+ */
+int event_log_service(event_log_t *log, int max_records);
+
+/**
+ * @brief Records in flash (oldest to newest, not counting staged ones)
+ */
+uint32_t event_log_count(const event_log_t *log);
+
+/**
+ * @brief Records the partition holds when full
+ */
+uint32_t event_log_capacity(const event_log_t *log);
+
+/**
+ * @brief Position a cursor on the last n records in flash (n = 0: all)
+ * @return Records from the cursor to the newest
+ */
+uint32_t event_log_seek(const event_log_t *log, event_log_cursor_t *cur, uint32_t last_n);
+
+/**
+ * @brief Read the record at the cursor and advance
+ * @return false at the end, or if the record was overwritten / is damaged
+ */
+bool event_log_next(const event_log_t *log, event_log_cursor_t *cur, event_record_t *rec);
+
+/**
+ * @brief Record CRC check (erased or torn slots fail)
+ */
+bool event_log_record_valid(const event_record_t *rec);
+
+/**
+ * @brief Incremental CRC-32 (zlib polynomial); start with crc = 0
+ */
+uint32_t event_log_crc32(uint32_t crc, const void *data, size_t len);
+
+/**
+ * @brief Dump header for the records from cur (count from event_log_seek())
+ */
+void event_log_dump_header(const event_log_t *log, const event_log_cursor_t *cur, uint32_t count,
+                           event_log_dump_header_t *out);
+
+void event_log_dump_trailer(uint32_t count, uint32_t crc32, event_log_dump_trailer_t *out);
+
+const char *event_type_name(uint8_t type);
+const char *event_result_name(uint8_t result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // EVENT_LOG_H
@@ -0,0 +1,252 @@
+/**
+ * @file flow_control.c
+ * @brief Closed-loop mass flow: scale slope -> FluidNC feed-override bytes
+ *
+ * See flow_control.h for the control law and its limits.
+ *
+ * The override FluidNC holds is tracked here byte by byte (with its 10-200
+ * clamp), because realtime commands are never acknowledged. "Ov:" fields
+ * in status reports correct the tracked value, but only resync_ms after
+ * the last byte - an older report still shows the value before it.
+ */
+
+#include "flow_control.h"
+
+#include <math.h>
+#include <string.h>
+
+typedef struct {
+    int64_t t_us;
+    float grams;
+} reading_t;
+
+static flow_control_config_t cfg = FLOW_CONTROL_DEFAULT_CONFIG;
+static bool armed = false;
+static bool paused = false;
+
+static reading_t ring[FLOW_CONTROL_HISTORY];
+static uint32_t head = 0;               // Next write
+static uint32_t count = 0;
+
+static float target_g_s = 0.0f;
+static float measured_g_s = 0.0f;
+static float integral = 0.0f;
+static float window_s = 0.0f;
+static float gain = 1.0f;               // kp / ki scale for the window
+static uint8_t ov_pct = 100;
+static uint8_t ov_min = 100;
+static uint8_t ov_max = 100;
+static int64_t control_from_us = 0;     // No evaluation before this
+static int64_t last_eval_us = 0;
+static int64_t last_byte_us = 0;
+
+static uint32_t updates = 0;
+static uint32_t bytes_out = 0;
+static uint32_t saturated = 0;
+static uint32_t held = 0;
+static uint32_t resyncs = 0;
+
+/** Windows hold MIN_READINGS readings and fit the history */
+static bool windows_fit(const flow_control_config_t *c) {
+    return c->reading_s > 0.0f && c->window_s >= FLOW_CONTROL_MIN_READINGS * c->reading_s &&
+           c->max_window_s >= c->window_s && c->max_window_s <= (FLOW_CONTROL_HISTORY - 1) * c->reading_s;
+}
+
+bool flow_control_init(const flow_control_config_t *config) {
+    static const flow_control_config_t defaults = FLOW_CONTROL_DEFAULT_CONFIG;
+    bool ok = config == NULL || windows_fit(config);
+    cfg = ok && config ? *config : defaults;
+    if (cfg.min_ov_pct < FLUIDNC_OV_FEED_MIN) cfg.min_ov_pct = FLUIDNC_OV_FEED_MIN;
+    if (cfg.max_ov_pct > FLUIDNC_OV_FEED_MAX) cfg.max_ov_pct = FLUIDNC_OV_FEED_MAX;
+    if (cfg.max_step_pct == 0) cfg.max_step_pct = 1;
+    armed = false;
+    paused = false;
+    ov_pct = 100;
+    return ok;
+}
+
+static uint8_t clamp_pct(float pct, uint8_t lo, uint8_t hi) {
+    if (pct < lo) return lo;
+    if (pct > hi) return hi;
+    return (uint8_t)lroundf(pct);
+}
+
+void flow_control_start(float target, float flow_ml_min, int64_t now_us) {
+    armed = target > 0.0f && flow_ml_min > 0.0f;
+    paused = false;
+    head = count = 0;
+    target_g_s = target;
+    measured_g_s = 0.0f;
+    integral = 0.0f;
+    window_s = target > 0.0f ? cfg.window_g / target : cfg.window_s;
+    if (window_s > cfg.max_window_s) window_s = cfg.max_window_s;
+    if (window_s < cfg.window_s) window_s = cfg.window_s;
+    gain = cfg.window_s / window_s;
+    control_from_us = now_us + (int64_t)((cfg.lag_s + window_s) * 1e6f);
+    last_eval_us = control_from_us;
+    last_byte_us = now_us;                  // Reports from before a 0x90 at stop still show the old value
+    updates = bytes_out = saturated = held = resyncs = 0;
+    if (!armed) return;
+
+    // Authority: configured range, narrowed so flow x override stays legal
+    float lo = ceilf(100.0f * cfg.min_flow_ml_min / flow_ml_min);
+    float hi = floorf(100.0f * cfg.max_flow_ml_min / flow_ml_min);
+    ov_min = clamp_pct(lo, cfg.min_ov_pct, cfg.max_ov_pct);
+    ov_max = clamp_pct(hi, cfg.min_ov_pct, cfg.max_ov_pct);
+    if (ov_min > 100) ov_min = 100;         // The move itself is already legal
+    if (ov_max < 100) ov_max = 100;
+}
+
+void flow_control_pause(void) {
+    paused = true;
+}
+
+void flow_control_resume(int64_t now_us) {
+    if (!armed) return;
+    paused = false;
+    head = count = 0;                       // The hold put a flat spot in the window
+    control_from_us = now_us + (int64_t)((cfg.lag_s + window_s) * 1e6f);
+    last_eval_us = control_from_us;
+}
+
+size_t flow_control_stop(uint8_t *out, size_t size) {
+    armed = false;
+    paused = false;
+    if (ov_pct == 100 || size == 0) return 0;
+    out[0] = FLUIDNC_OV_FEED_RESET;
+    ov_pct = 100;
+    bytes_out++;
+    return 1;
+}
+
+size_t flow_control_override_bytes(uint8_t from, uint8_t to, uint8_t *out, size_t size) {
+    size_t n = 0;
+    int cur = from;
+    while (cur != to && n < size) {
+        int d = to - cur;
+        if (d >= 6 && cur + 10 <= FLUIDNC_OV_FEED_MAX) {
+            out[n++] = FLUIDNC_OV_FEED_PLUS;
+            cur += 10;
+        } else if (d <= -6 && cur - 10 >= FLUIDNC_OV_FEED_MIN) {
+            out[n++] = FLUIDNC_OV_FEED_MINUS;
+            cur -= 10;
+        } else if (d > 0) {
+            out[n++] = FLUIDNC_OV_FEED_FINE_PLUS;
+            cur++;
+        } else {
+            out[n++] = FLUIDNC_OV_FEED_FINE_MINUS;
+            cur--;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Mass flow as the least-squares slope of the readings in the window
+ * @return false with fewer than FLOW_CONTROL_MIN_READINGS readings or a window under half full
+ */
+static bool slope(int64_t now_us, float *g_s) {
+    const int64_t window_us = (int64_t)(window_s * 1e6f);
+    float st = 0.0f, sg = 0.0f, stt = 0.0f, stg = 0.0f;
+    uint32_t n = 0;
+    int64_t oldest = now_us;
+    for (uint32_t i = 0; i < count; i++) {
+        const reading_t *r = &ring[(head + FLOW_CONTROL_HISTORY - 1 - i) % FLOW_CONTROL_HISTORY];
+        if (now_us - r->t_us > window_us) break;
+        float t = (float)(r->t_us - now_us) * 1e-6f;     // Relative: keeps float precision
+        st += t;
+        sg += r->grams;
+        stt += t * t;
+        stg += t * r->grams;
+        oldest = r->t_us;
+        n++;
+    }
+    if (n < FLOW_CONTROL_MIN_READINGS || now_us - oldest < window_us / 2) return false;
+    float den = (float)n * stt - st * st;
+    if (den <= 0.0f) return false;
+    *g_s = ((float)n * stg - st * sg) / den;
+    return true;
+}
+
+size_t flow_control_on_scale(float grams, int64_t now_us, uint8_t *out, size_t size) {
+    ring[head].t_us = now_us;
+    ring[head].grams = grams;
+    head = (head + 1) % FLOW_CONTROL_HISTORY;
+    if (count < FLOW_CONTROL_HISTORY) count++;
+
+    if (!armed || paused || now_us < control_from_us) return 0;
+    if (!slope(now_us, &measured_g_s)) return 0;
+
+    float dt = (float)(now_us - last_eval_us) * 1e-6f;
+    if (dt > 2.0f * cfg.reading_s) dt = 2.0f * cfg.reading_s;     // Scale gap: don't integrate across it
+    last_eval_us = now_us;
+    updates++;
+
+    float ratio = measured_g_s / target_g_s;
+    if (ratio < cfg.hold_ratio_lo || ratio > cfg.hold_ratio_hi) {
+        held++;
+        return 0;
+    }
+
+    float e = 1.0f - ratio;
+    float lo = ov_min / 100.0f - 1.0f;      // Output limits as override fraction - 1
+    float hi = ov_max / 100.0f - 1.0f;
+    const float kp = cfg.kp * gain;
+    const float ki = cfg.ki * gain;
+    float u = kp * e + integral + ki * e * dt;
+    bool pinned = (u > hi && e > 0.0f) || (u < lo && e < 0.0f);
+    if (pinned) {
+        saturated++;                        // Conditional integration
+    } else {
+        integral += ki * e * dt;
+        if (integral > hi) integral = hi;
+        if (integral < lo) integral = lo;
+    }
+    u = kp * e + integral;
+
+    int want = clamp_pct(100.0f * (1.0f + u), ov_min, ov_max);
+    int step = want - ov_pct;
+    if (step > cfg.max_step_pct) want = ov_pct + cfg.max_step_pct;
+    if (step < -cfg.max_step_pct) want = ov_pct - cfg.max_step_pct;
+    if (step < cfg.deadband_pct && step > -cfg.deadband_pct) return 0;
+
+    if (size > FLOW_CONTROL_MAX_BYTES) size = FLOW_CONTROL_MAX_BYTES;
+    size_t n = flow_control_override_bytes(ov_pct, (uint8_t)want, out, size);
+    for (size_t i = 0; i < n; i++) {
+        switch (out[i]) {
+            case FLUIDNC_OV_FEED_PLUS:       ov_pct += 10; break;
+            case FLUIDNC_OV_FEED_MINUS:      ov_pct -= 10; break;
+            case FLUIDNC_OV_FEED_FINE_PLUS:  ov_pct++;     break;
+            case FLUIDNC_OV_FEED_FINE_MINUS: ov_pct--;     break;
+        }
+    }
+    if (n) last_byte_us = now_us;
+    bytes_out += (uint32_t)n;
+    return n;
+}
+
+void flow_control_on_status(const fluidnc_status_t *status, int64_t now_us) {
+    if (!armed || status == NULL || !status->has_ov) return;
+    if (now_us - last_byte_us < (int64_t)cfg.resync_ms * 1000) return;
+    if (status->ov_feed != ov_pct) {
+        ov_pct = status->ov_feed;
+        resyncs++;
+    }
+}
+
+void flow_control_get_stats(flow_control_stats_t *out) {
+    memset(out, 0, sizeof(*out));
+    out->active = armed && !paused;
+    out->target_g_s = target_g_s;
+    out->measured_g_s = measured_g_s;
+    out->window_s = window_s;
+    out->integral = integral;
+    out->ov_pct = ov_pct;
+    out->ov_min_pct = ov_min;
+    out->ov_max_pct = ov_max;
+    out->updates = updates;
+    out->bytes = bytes_out;
+    out->saturated = saturated;
+    out->held = held;
+    out->resyncs = resyncs;
+}
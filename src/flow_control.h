@@ -0,0 +1,189 @@
+/**
+ * @file flow_control.h
+ * @brief Closed-loop mass flow: scale slope -> FluidNC feed-override bytes
+ *
+ * A dose is one volumetric move at a feed computed from the tube
+ * calibration. A thicker (or colder) chemical slips more in the tube, so
+ * the same feed delivers less mass per second. This module holds the mass
+ * flow at the commanded rate without touching the move: it trims the
+ * FluidNC feed override (realtime bytes 0x90-0x94, applied by the planner
+ * mid-move - no new G-code, no stop) with a PI controller on
+ *
+ *   error = 1 - measured g/s / target g/s     (relative, unitless)
+ *
+ * where the measured rate is the least-squares slope of the raw scale
+ * readings over a window long enough to carry window_g at the target rate
+ * (at least window_s, at most max_window_s): a 2 ml/min pump needs seconds
+ * of readings before 0.02 g of scale noise stops dominating the slope.
+ * Gains shrink with the window (the loop sees older data), and control
+ * starts lag_s + window after the move.
+ *
+ * READINGS: the scale gives one reading per SCALE_READING_MS (~1.4 s,
+ * scale_weight.h), so the windows are sized in readings: the shortest
+ * holds FLOW_CONTROL_MIN_READINGS of them, the longest fits the history.
+ * flow_control_init() refuses a config that breaks either - a window
+ * that never holds three readings never yields a slope, and the loop
+ * would silently never act.
+ *
+ * RULES:
+ * - Authority is bounded: the override stays within [min_ov_pct,
+ *   max_ov_pct] and within what keeps commanded flow x override inside
+ *   [min_flow_ml_min, max_flow_ml_min]. Anti-windup: the integrator stops
+ *   while the output is pinned at a limit and pushing further into it.
+ * - Each update moves the override by at most max_step_pct, so the
+ *   planner only ever sees small speed changes.
+ * - A measured/target ratio outside [hold_ratio_lo, hold_ratio_hi] is a
+ *   fault for flow_monitor.h, not a viscosity change: the controller
+ *   freezes instead of chasing it.
+ * - The override is only correct at the end if every byte is sent:
+ *   callers must transmit everything the functions return.
+ *
+ * The move length is unchanged, so the dose volume is what it always was;
+ * only the rate is held.
+ *
+ * Shared by the firmware and the host tools; does not depend on ESP-IDF.
+ *
+ * Usage:
+ *   flow_control_init(NULL);                                // defaults
+ *   flow_control_start(target_g_s, flow_ml_min, now_us);     // move sent
+ *   n = flow_control_on_scale(grams, now_us, buf, sizeof(buf));  // every reading
+ *   for (i = 0; i < n; i++) send_realtime(buf[i]);
+ *   flow_control_on_status(&status, now_us);                 // picks up "Ov:"
+ *   n = flow_control_stop(buf, sizeof(buf));                 // dose over: 0x90
+ */
+
+#ifndef FLOW_CONTROL_H
+#define FLOW_CONTROL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "fluidnc_status.h"
+#include "scale_weight.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLOW_CONTROL_HISTORY    16      // Scale readings kept (22 s at SCALE_READING_MS)
+#define FLOW_CONTROL_MIN_READINGS 3     // Fewest readings a slope is taken from
+#define FLOW_CONTROL_MAX_BYTES  8       // Largest burst one update can return
+
+// FluidNC realtime feed-override commands
+#define FLUIDNC_OV_FEED_RESET       0x90    // 100 %
+#define FLUIDNC_OV_FEED_PLUS        0x91    // +10 %
+#define FLUIDNC_OV_FEED_MINUS       0x92    // -10 %
+#define FLUIDNC_OV_FEED_FINE_PLUS   0x93    // +1 %
+#define FLUIDNC_OV_FEED_FINE_MINUS  0x94    // -1 %
+#define FLUIDNC_OV_FEED_MIN         10
+#define FLUIDNC_OV_FEED_MAX         200
+
+typedef struct {
+    float kp;                   // Override fraction per unit relative error
+    float ki;                   // ... per second
+    float reading_s;            // Scale reading period
+    float window_s;             // Shortest slope window (gains are tuned for it), >= MIN_READINGS readings
+    float max_window_s;         // Longest, < FLOW_CONTROL_HISTORY readings
+    float window_g;             // Mass the window should carry at the target rate
+    float lag_s;                // Tube transit + scale settling
+    float min_flow_ml_min;      // Commanded flow x override stays inside
+    float max_flow_ml_min;
+    uint8_t min_ov_pct;         // Controller authority
+    uint8_t max_ov_pct;
+    uint8_t max_step_pct;       // Largest override change per update
+    uint8_t deadband_pct;       // Smaller corrections are not sent
+    float hold_ratio_lo;        // measured/target outside -> freeze (fault case)
+    float hold_ratio_hi;
+    uint32_t resync_ms;         // Quiet time before an "Ov:" report is trusted
+} flow_control_config_t;
+
+#define FLOW_CONTROL_DEFAULT_CONFIG { \
+    .kp = 0.5f, \
+    .ki = 0.8f, \
+    .reading_s = SCALE_READING_MS / 1000.0f, \
+    .window_s = 4.5f, \
+    .max_window_s = 15.0f, \
+    .window_g = 0.5f, \
+    .lag_s = 0.8f, \
+    .min_flow_ml_min = 1.0f, \
+    .max_flow_ml_min = 500.0f, \
+    .min_ov_pct = 50, \
+    .max_ov_pct = 150, \
+    .max_step_pct = 5, \
+    .deadband_pct = 1, \
+    .hold_ratio_lo = 0.5f, \
+    .hold_ratio_hi = 1.6f, \
+    .resync_ms = 500, \
+}
+
+typedef struct {
+    bool active;
+    float target_g_s;
+    float measured_g_s;         // Last slope (0 until the first full window)
+    float window_s;             // Slope window for the current dose
+    float integral;             // Override fraction
+    uint8_t ov_pct;             // Override FluidNC has (or will have once sent)
+    uint8_t ov_min_pct;         // Limits for the current dose
+    uint8_t ov_max_pct;
+    uint32_t updates;           // Controller evaluations
+    uint32_t bytes;             // Override bytes returned
+    uint32_t saturated;         // Evaluations pinned at a limit
+    uint32_t held;              // Evaluations frozen by the hold ratios
+    uint32_t resyncs;           // "Ov:" reports that corrected ov_pct
+} flow_control_stats_t;
+
+/**
+ * @brief Load configuration (NULL = FLOW_CONTROL_DEFAULT_CONFIG) and disarm
+ * @return false if its windows do not fit the reading period (defaults loaded instead)
+ */
+bool flow_control_init(const flow_control_config_t *config);
+
+/**
+ * @brief Arm for a move that was just sent
+ * @param target_g_s Mass flow to hold
+ * @param flow_ml_min Flow the move's F word commands (limits the override)
+ */
+void flow_control_start(float target_g_s, float flow_ml_min, int64_t now_us);
+
+/**
+ * @brief Feed hold: keep the override and integrator, stop evaluating
+ */
+void flow_control_pause(void);
+
+/**
+ * @brief Cycle start after a hold: a fresh window before the next correction
+ */
+void flow_control_resume(int64_t now_us);
+
+/**
+ * @brief Disarm and return the override to 100 %
+ * @return Bytes to send (0x90, or nothing if already at 100 %)
+ */
+size_t flow_control_stop(uint8_t *out, size_t size);
+
+/**
+ * @brief Feed every scale reading; evaluates the controller when armed
+ * @return Number of override bytes written to out (send them all)
+ */
+size_t flow_control_on_scale(float grams, int64_t now_us, uint8_t *out, size_t size);
+
+/**
+ * @brief Adopt FluidNC's "Ov:" feed value once no byte of ours is in flight
+ */
+void flow_control_on_status(const fluidnc_status_t *status, int64_t now_us);
+
+void flow_control_get_stats(flow_control_stats_t *out);
+
+/**
+ * @brief Shortest byte sequence taking the feed override from one value to another
+ *
+ * Coarse (+-10) steps, then fine (+-1), never leaving FluidNC's 10-200 %.
+ * @return Bytes written; stops early (out of space) with a partial move
+ */
+size_t flow_control_override_bytes(uint8_t from_pct, uint8_t to_pct, uint8_t *out, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLOW_CONTROL_H
@@ -0,0 +1,292 @@
+/**
+ * @file flow_monitor.c
+ * @brief Stall / tube-failure detection: commanded motion vs scale response
+ *
+ * See flow_monitor.h for the detection rule.
+ *
+ * Two histories are kept:
+ * - status ring: cumulative expected grams per pump at every status report
+ * - scale ring:  filtered scale weight at every scale reading
+ * A judgement pairs the newest scale reading with an older one and looks
+ * up the expected mass at those two times minus lag_s, so a slow scale
+ * (one burst reading per second) is never compared against motion it
+ * could not have seen yet.
+ */
+
+#include "flow_monitor.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define SCALE_HISTORY   16
+
+typedef struct {
+    int64_t t_us;
+    float expected_g[FLOW_MONITOR_PUMPS];   // Cumulative since start
+} status_sample_t;
+
+typedef struct {
+    int64_t t_us;
+    float grams;                            // Filtered
+} scale_sample_t;
+
+static const char *const fault_names[] = {
+    [FLOW_FAULT_NONE]        = "OK",
+    [FLOW_FAULT_NO_FLOW]     = "NO_FLOW",
+    [FLOW_FAULT_LOW_FLOW]    = "LOW_FLOW",
+    [FLOW_FAULT_OVER_FLOW]   = "OVER_FLOW",
+    [FLOW_FAULT_SCALE_STALE] = "SCALE_STALE",
+};
+
+static const char axis_letters[FLOW_MONITOR_PUMPS] = {'X', 'Y', 'Z', 'A'};
+
+static flow_monitor_config_t cfg = FLOW_MONITOR_DEFAULT_CONFIG;
+static bool armed = false;
+
+static status_sample_t status_ring[FLOW_MONITOR_HISTORY];
+static uint32_t status_head = 0;        // Next write
+static uint32_t status_count = 0;
+
+static scale_sample_t scale_ring[SCALE_HISTORY];
+static uint32_t scale_head = 0;
+static uint32_t scale_count = 0;
+static float scale_base_g = 0.0f;
+static float filtered_g = 0.0f;
+static int64_t last_scale_us = 0;
+static int64_t judged_scale_us = 0;     // Scale reading behind the last judgement
+
+static bool have_base_pos = false;
+static float base_pos[FLOW_MONITOR_PUMPS];
+static float expected_now_g = 0.0f;
+
+static flow_fault_type_t pending = FLOW_FAULT_NONE;
+static uint8_t pending_count = 0;
+static flow_fault_t fault;              // type != NONE = latched
+
+static float last_expected_rate = 0.0f;
+static float last_actual_rate = 0.0f;
+static uint32_t evaluations = 0;
+
+void flow_monitor_init(const flow_monitor_config_t *config) {
+    static const flow_monitor_config_t defaults = FLOW_MONITOR_DEFAULT_CONFIG;
+    cfg = config ? *config : defaults;
+    if (cfg.confirm_count == 0) cfg.confirm_count = 1;
+    armed = false;
+    memset(&fault, 0, sizeof(fault));
+}
+
+static void push_scale(float grams, int64_t now_us) {
+    scale_ring[scale_head].t_us = now_us;
+    scale_ring[scale_head].grams = grams;
+    scale_head = (scale_head + 1) % SCALE_HISTORY;
+    if (scale_count < SCALE_HISTORY) scale_count++;
+}
+
+/**
+ * @brief i-th newest scale sample (0 = newest)
+ */
+static const scale_sample_t *scale_at(uint32_t i) {
+    return &scale_ring[(scale_head + SCALE_HISTORY - 1 - i) % SCALE_HISTORY];
+}
+
+void flow_monitor_start(float scale_g, int64_t now_us) {
+    armed = true;
+    status_head = status_count = 0;
+    scale_head = scale_count = 0;
+    scale_base_g = scale_g;
+    filtered_g = scale_g;
+    last_scale_us = now_us;
+    judged_scale_us = now_us;
+    have_base_pos = false;
+    expected_now_g = 0.0f;
+    pending = FLOW_FAULT_NONE;
+    pending_count = 0;
+    last_expected_rate = last_actual_rate = 0.0f;
+    evaluations = 0;
+    memset(&fault, 0, sizeof(fault));
+
+    push_scale(scale_g, now_us);
+}
+
+void flow_monitor_stop(void) {
+    armed = false;
+}
+
+void flow_monitor_on_scale(float grams, int64_t now_us) {
+    if (!armed) return;
+
+    // First-order low-pass; alpha from the actual sample spacing
+    float dt = (float)(now_us - last_scale_us) / 1e6f;
+    if (dt < 0.0f) dt = 0.0f;
+    float alpha = cfg.scale_tau_s > 0.0f ? dt / (cfg.scale_tau_s + dt) : 1.0f;
+    filtered_g += alpha * (grams - filtered_g);
+    last_scale_us = now_us;
+
+    push_scale(filtered_g, now_us);
+}
+
+/**
+ * @brief Cumulative expected grams per pump at time t
+ * @return false if t is older than the retained history
+ */
+static bool expected_at(int64_t t_us, float out[FLOW_MONITOR_PUMPS]) {
+    for (uint32_t i = 0; i < status_count; i++) {
+        const status_sample_t *s =
+            &status_ring[(status_head + FLOW_MONITOR_HISTORY - 1 - i) % FLOW_MONITOR_HISTORY];
+        if (s->t_us <= t_us) {
+            memcpy(out, s->expected_g, sizeof(s->expected_g));
+            return true;
+        }
+    }
+    if (status_count == FLOW_MONITOR_HISTORY) {
+        return false;           // Wrapped: the baseline is gone
+    }
+    // Before the first report nothing had moved yet
+    memset(out, 0, sizeof(float) * FLOW_MONITOR_PUMPS);
+    return true;
+}
+
+static const flow_fault_t *raise(flow_fault_type_t type, int pump, bool ambiguous,
+                                 float expected_g, float actual_g, int64_t now_us) {
+    fault.type = type;
+    fault.pump = (int8_t)pump;
+    fault.ambiguous = ambiguous;
+    fault.code = (uint8_t)(type * 10 + pump + 1);
+    fault.expected_g = expected_g;
+    fault.actual_g = actual_g;
+    fault.time_us = now_us;
+    return &fault;
+}
+
+/**
+ * @brief Judge the newest scale reading against the commanded motion
+ */
+static const flow_fault_t *evaluate(int64_t now_us) {
+    if (scale_count < 2) return NULL;
+    const scale_sample_t *latest = scale_at(0);
+    if (latest->t_us == judged_scale_us) {
+        return NULL;            // No new evidence since the last judgement
+    }
+
+    const int64_t lag_us = (int64_t)(cfg.lag_s * 1e6f);
+    const int64_t min_span_us = (int64_t)(cfg.min_span_s * 1e6f);
+    float e_now[FLOW_MONITOR_PUMPS];
+    if (!expected_at(latest->t_us - lag_us, e_now)) return NULL;
+
+    // Shortest window that carries enough expected mass to judge
+    for (uint32_t i = 1; i < scale_count; i++) {
+        const scale_sample_t *ref = scale_at(i);
+        if (latest->t_us - ref->t_us < min_span_us) continue;
+
+        float e_ref[FLOW_MONITOR_PUMPS];
+        if (!expected_at(ref->t_us - lag_us, e_ref)) break;
+
+        float d_exp[FLOW_MONITOR_PUMPS];
+        float expected = 0.0f;
+        int top = 0;
+        for (int p = 0; p < FLOW_MONITOR_PUMPS; p++) {
+            d_exp[p] = e_now[p] - e_ref[p];
+            expected += d_exp[p];
+            if (d_exp[p] > d_exp[top]) top = p;
+        }
+        if (expected < cfg.min_expected_g) continue;
+
+        float actual = latest->grams - ref->grams;
+        float span_s = (float)(latest->t_us - ref->t_us) / 1e6f;
+        judged_scale_us = latest->t_us;
+        evaluations++;
+        last_expected_rate = expected / span_s;
+        last_actual_rate = actual / span_s;
+
+        float ratio = actual / expected;
+        flow_fault_type_t type = FLOW_FAULT_NONE;
+        if (ratio < cfg.no_flow_ratio) {
+            type = FLOW_FAULT_NO_FLOW;
+        } else if (ratio < cfg.low_flow_ratio) {
+            type = FLOW_FAULT_LOW_FLOW;
+        } else if (ratio > cfg.over_flow_ratio) {
+            type = FLOW_FAULT_OVER_FLOW;
+        }
+
+        if (type == FLOW_FAULT_NONE) {
+            pending = FLOW_FAULT_NONE;
+            pending_count = 0;
+            return NULL;
+        }
+        if (type != pending) {
+            pending = type;
+            pending_count = 0;
+        }
+        if (++pending_count < cfg.confirm_count) {
+            return NULL;
+        }
+
+        // Attribute to the pump that dominated the window
+        bool ambiguous = false;
+        for (int p = 0; p < FLOW_MONITOR_PUMPS; p++) {
+            if (p != top && d_exp[p] > 0.25f * expected) ambiguous = true;
+        }
+        return raise(type, top, ambiguous, expected, actual, now_us);
+    }
+    return NULL;
+}
+
+const flow_fault_t *flow_monitor_on_status(const fluidnc_status_t *status, int64_t now_us) {
+    if (!armed || fault.type != FLOW_FAULT_NONE || status == NULL) return NULL;
+    if (!status->has_mpos && !status->has_wpos) return NULL;
+
+    // Only deltas matter, so MPos and WPos are equally good
+    if (!have_base_pos) {
+        for (int p = 0; p < FLOW_MONITOR_PUMPS; p++) {
+            base_pos[p] = p < status->axis_count ? status->pos[p] : 0.0f;
+        }
+        have_base_pos = true;
+    }
+
+    status_sample_t *s = &status_ring[status_head];
+    s->t_us = now_us;
+    expected_now_g = 0.0f;
+    for (int p = 0; p < FLOW_MONITOR_PUMPS; p++) {
+        float mm = p < status->axis_count ? status->pos[p] - base_pos[p] : 0.0f;
+        s->expected_g[p] = mm * cfg.ml_per_mm[p] * cfg.density_g_ml[p];
+        expected_now_g += s->expected_g[p];
+    }
+    status_head = (status_head + 1) % FLOW_MONITOR_HISTORY;
+    if (status_count < FLOW_MONITOR_HISTORY) status_count++;
+
+    bool moving = status->state == FLUIDNC_STATE_RUN || status->state == FLUIDNC_STATE_JOG;
+    if (moving && now_us - last_scale_us > (int64_t)cfg.scale_stale_ms * 1000) {
+        return raise(FLOW_FAULT_SCALE_STALE, -1, false, expected_now_g,
+                     filtered_g - scale_base_g, now_us);
+    }
+
+    return evaluate(now_us);
+}
+
+bool flow_monitor_get_fault(flow_fault_t *out) {
+    if (fault.type == FLOW_FAULT_NONE) return false;
+    if (out) *out = fault;
+    return true;
+}
+
+void flow_monitor_get_stats(flow_monitor_stats_t *out) {
+    out->armed = armed;
+    out->expected_g = expected_now_g;
+    out->actual_g = filtered_g - scale_base_g;
+    out->expected_rate_g_s = last_expected_rate;
+    out->actual_rate_g_s = last_actual_rate;
+    out->evaluations = evaluations;
+}
+
+const char *flow_fault_name(flow_fault_type_t type) {
+    return type <= FLOW_FAULT_SCALE_STALE ? fault_names[type] : "?";
+}
+
+void flow_fault_format(const flow_fault_t *f, char *buf, size_t len) {
+    if (f->pump >= 0 && f->pump < FLOW_MONITOR_PUMPS) {
+        snprintf(buf, len, "F%02u %c %s", (unsigned)f->code, axis_letters[(int)f->pump],
+                 flow_fault_name(f->type));
+    } else {
+        snprintf(buf, len, "F%02u %s", (unsigned)f->code, flow_fault_name(f->type));
+    }
+}
@@ -0,0 +1,145 @@
+/**
+ * @file flow_monitor.h
+ * @brief Stall / tube-failure detection: commanded motion vs scale response
+ *
+ * A burst tube or an empty reservoir keeps the motor turning with no mass
+ * gain. This module cross-checks, on every FluidNC status report:
+ *
+ *   expected mass = sum over pumps of (MPos delta x ml/mm x density)
+ *   actual mass   = filtered scale weight delta
+ *
+ * over the shortest recent window that carries at least min_expected_g of
+ * expected mass (so slow pumps are judged on a longer span than fast
+ * ones), with the expected side delayed by lag_s for tube transit and
+ * scale settling. A divergence that persists for confirm_count scale
+ * readings raises a latched fault naming the pump that dominated the window.
+ *
+ * Fault codes (LCD / log friendly): F<type><pump>, e.g. F11 = no flow on
+ * pump 1 (X). Pump 0 = not attributable (scale stale).
+ *
+ * Shared by the firmware and the host tools; does not depend on ESP-IDF.
+ *
+ * Usage:
+ *   flow_monitor_init(NULL);                      // defaults
+ *   flow_monitor_start(current_grams, now_us);    // when dispensing starts
+ *   flow_monitor_on_scale(grams, now_us);         // every scale reading
+ *   fault = flow_monitor_on_status(&status, now_us);
+ *   if (fault) { send '!' ... }
+ */
+
+#ifndef FLOW_MONITOR_H
+#define FLOW_MONITOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "fluidnc_status.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLOW_MONITOR_PUMPS      4       // X Y Z A
+#define FLOW_MONITOR_HISTORY    64      // Status reports kept (~4.8 s at 75 ms)
+
+typedef enum {
+    FLOW_FAULT_NONE = 0,
+    FLOW_FAULT_NO_FLOW,         // Motor turning, (almost) no mass: burst tube / empty reservoir
+    FLOW_FAULT_LOW_FLOW,        // Well below expected: worn tube, kink, air
+    FLOW_FAULT_OVER_FLOW,       // Well above expected: siphoning, wrong pump, calibration
+    FLOW_FAULT_SCALE_STALE,     // Motors moving but no scale reading
+} flow_fault_type_t;
+
+typedef struct {
+    flow_fault_type_t type;
+    int8_t pump;                // 0-3 = X Y Z A, -1 = not attributable
+    bool ambiguous;             // Several pumps contributed; pump is the largest
+    uint8_t code;               // type * 10 + pump + 1
+    float expected_g;           // Over the judged window
+    float actual_g;
+    int64_t time_us;
+} flow_fault_t;
+
+typedef struct {
+    float ml_per_mm[FLOW_MONITOR_PUMPS];        // Tube calibration
+    float density_g_ml[FLOW_MONITOR_PUMPS];     // Chemical density
+    float scale_tau_s;          // Scale weight low-pass time constant
+    float lag_s;                // Tube transit + scale settling
+    float min_expected_g;       // Expected mass needed before judging a window
+    float min_span_s;           // Shortest window judged
+    float no_flow_ratio;        // actual/expected below this -> NO_FLOW
+    float low_flow_ratio;       // ... below this -> LOW_FLOW
+    float over_flow_ratio;      // ... above this -> OVER_FLOW
+    uint8_t confirm_count;      // Consecutive bad scale readings before raising
+    uint32_t scale_stale_ms;    // No scale reading for this long while moving
+} flow_monitor_config_t;
+
+#define FLOW_MONITOR_DEFAULT_CONFIG { \
+    .ml_per_mm = {0.05f, 0.05f, 0.05f, 0.05f}, \
+    .density_g_ml = {1.0f, 1.0f, 1.0f, 1.0f}, \
+    .scale_tau_s = 0.3f, \
+    .lag_s = 1.0f, \
+    .min_expected_g = 0.3f, \
+    .min_span_s = 0.5f, \
+    .no_flow_ratio = 0.2f, \
+    .low_flow_ratio = 0.6f, \
+    .over_flow_ratio = 1.8f, \
+    .confirm_count = 2, \
+    .scale_stale_ms = 3000, \
+}
+
+typedef struct {
+    bool armed;
+    float expected_g;           // Since flow_monitor_start()
+    float actual_g;             // Filtered scale delta since start
+    float expected_rate_g_s;    // Over the last judged window
+    float actual_rate_g_s;
+    uint32_t evaluations;
+} flow_monitor_stats_t;
+
+/**
+ * @brief Load configuration (NULL = FLOW_MONITOR_DEFAULT_CONFIG) and disarm
+ */
+void flow_monitor_init(const flow_monitor_config_t *config);
+
+/**
+ * @brief Arm at the start of a dispense; clears any latched fault
+ * @param scale_g Current scale reading (baseline)
+ */
+void flow_monitor_start(float scale_g, int64_t now_us);
+
+/**
+ * @brief Disarm (dispense finished or aborted); the fault stays readable
+ */
+void flow_monitor_stop(void);
+
+/**
+ * @brief Feed every scale reading
+ */
+void flow_monitor_on_scale(float grams, int64_t now_us);
+
+/**
+ * @brief Evaluate on a status report
+ * @return The fault if one was raised by this report, otherwise NULL
+ */
+const flow_fault_t *flow_monitor_on_status(const fluidnc_status_t *status, int64_t now_us);
+
+/**
+ * @brief Latched fault, if any
+ */
+bool flow_monitor_get_fault(flow_fault_t *out);
+
+void flow_monitor_get_stats(flow_monitor_stats_t *out);
+
+/**
+ * @brief "F11 X NO_FLOW" style text
+ */
+void flow_fault_format(const flow_fault_t *fault, char *buf, size_t len);
+
+const char *flow_fault_name(flow_fault_type_t type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLOW_MONITOR_H
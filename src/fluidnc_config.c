@@ -0,0 +1,233 @@
+/**
+ * @file fluidnc_config.c
+ * @brief Axis limits read from FluidNC at boot, cached by a config hash
+ *
+ * See fluidnc_config.h for the sequence. The dump is parsed into a scratch
+ * config and only replaces the current one on its "ok" with every limit of
+ * at least one axis present, so a reply cut short by a reset or an error
+ * never leaves half a config behind. A banner is not a reason to start
+ * over: the line in flight may or may not have reached FluidNC before the
+ * reset (or before it came up), so only a missing reply makes it resend. Hashes are 32-bit FNV-1a over the
+ * lines (terminators excluded).
+ */
+
+#include "fluidnc_config.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FNV_OFFSET  2166136261u
+#define FNV_PRIME   16777619u
+
+static fluidnc_config_options_t opts = FLUIDNC_CONFIG_DEFAULT_OPTIONS;
+static fluidnc_config_state_t state = FLUIDNC_CONFIG_IDLE;
+
+static fluidnc_config_t current;        // Last good config
+static fluidnc_config_t scratch;        // Dump in progress
+static fluidnc_config_t cache;          // From fluidnc_config_start()
+static bool have_cache = false;
+
+static const char *pending = NULL;      // Line for the next poll
+static const char *asked = NULL;        // Line awaiting its reply
+static uint8_t tries = 0;               // Sends of that line
+static int64_t start_us = 0;
+static int64_t sent_us = 0;
+static uint32_t key = FNV_OFFSET;
+
+static fluidnc_config_stats_t stats;
+
+static uint32_t hash_line(uint32_t h, const char *line) {
+    for (const char *p = line; *p; p++) {
+        h ^= (uint8_t)*p;
+        h *= FNV_PRIME;
+    }
+    h ^= '\n';
+    return h * FNV_PRIME;
+}
+
+void fluidnc_config_init(const fluidnc_config_options_t *options) {
+    static const fluidnc_config_options_t defaults = FLUIDNC_CONFIG_DEFAULT_OPTIONS;
+    opts = options ? *options : defaults;
+    state = FLUIDNC_CONFIG_IDLE;
+    memset(&current, 0, sizeof(current));
+    current.version = FLUIDNC_CONFIG_VERSION;
+    have_cache = false;
+    pending = NULL;
+    memset(&stats, 0, sizeof(stats));
+}
+
+static void begin_reply(void) {
+    if (state == FLUIDNC_CONFIG_IDENT) {
+        key = FNV_OFFSET;
+    } else {
+        memset(&scratch, 0, sizeof(scratch));
+        scratch.version = FLUIDNC_CONFIG_VERSION;
+        scratch.key = key;
+        scratch.hash = FNV_OFFSET;
+    }
+}
+
+static void send(const char *line, fluidnc_config_state_t next, int64_t now_us) {
+    state = next;
+    pending = asked = line;
+    tries = 1;
+    sent_us = now_us;               // Timeout also covers a caller that never polls
+    begin_reply();
+}
+
+void fluidnc_config_start(const fluidnc_config_t *cached, int64_t now_us) {
+    have_cache = cached != NULL && cached->version == FLUIDNC_CONFIG_VERSION && cached->axis_count > 0;
+    if (have_cache) cache = *cached;
+    stats.starts++;
+    stats.from_cache = stats.changed = false;
+    start_us = now_us;
+    send("$I", FLUIDNC_CONFIG_IDENT, now_us);
+}
+
+static void done(int64_t now_us) {
+    state = FLUIDNC_CONFIG_DONE;
+    stats.last_us = (uint32_t)(now_us - start_us);
+}
+
+static void fail(void) {
+    state = FLUIDNC_CONFIG_FAILED;
+    pending = NULL;
+    stats.failures++;
+}
+
+/**
+ * @brief Leading axes with steps/mm, max rate and acceleration all read
+ */
+static uint8_t count_axes(const fluidnc_config_t *c) {
+    uint8_t n = 0;
+    while (n < FLUIDNC_CONFIG_AXES && c->axes[n].steps_per_mm > 0.0f &&
+           c->axes[n].max_rate_mm_min > 0.0f && c->axes[n].accel_mm_s2 > 0.0f) {
+        n++;
+    }
+    return n;
+}
+
+static bool is_identity(const char *line) {
+    return strncmp(line, "[VER:", 5) == 0 || strncmp(line, "[OPT:", 5) == 0 ||
+           strncmp(line, "[MSG: Machine:", 14) == 0;
+}
+
+bool fluidnc_config_on_line(const char *line, int64_t now_us) {
+    if (state != FLUIDNC_CONFIG_IDENT && state != FLUIDNC_CONFIG_DUMP) return false;
+
+    if (pending) return false;                  // Not sent yet: the reply is someone else's
+    if (strncmp(line, "error", 5) == 0) {
+        fail();
+        return true;
+    }
+
+    bool ok = strcmp(line, "ok") == 0;
+    if (state == FLUIDNC_CONFIG_IDENT) {
+        if (ok) {
+            if (have_cache && cache.key == key) {
+                current = cache;
+                stats.from_cache = true;
+                done(now_us);
+            } else {
+                stats.dumps++;
+                send("$$", FLUIDNC_CONFIG_DUMP, now_us);
+            }
+            return true;
+        }
+        if (line[0] != '[') return false;
+        // Network lines ([MSG: Mode=STA ...]) change between boots; the rest identify the config
+        if (is_identity(line)) key = hash_line(key, line);
+        stats.lines++;
+        return true;
+    }
+
+    // FLUIDNC_CONFIG_DUMP
+    if (ok) {
+        scratch.axis_count = count_axes(&scratch);
+        if (scratch.axis_count == 0) {
+            fail();
+        } else {
+            current = scratch;
+            stats.changed = true;
+            done(now_us);
+        }
+        return true;
+    }
+    if (line[0] != '$') return false;
+    fluidnc_config_parse_setting(&scratch, line);
+    scratch.hash = hash_line(scratch.hash, line);
+    stats.lines++;
+    return true;
+}
+
+const char *fluidnc_config_poll(int64_t now_us) {
+    if ((state == FLUIDNC_CONFIG_IDENT || state == FLUIDNC_CONFIG_DUMP) &&
+        now_us - sent_us > (int64_t)opts.reply_timeout_ms * 1000) {
+        if (tries > opts.retries) {
+            fail();
+        } else {
+            tries++;                            // Lost (FluidNC not up yet, or reset): ask again
+            pending = asked;
+            sent_us = now_us;
+            stats.retries++;
+            begin_reply();
+        }
+    }
+    const char *line = pending;
+    if (line) {
+        pending = NULL;
+        sent_us = now_us;
+    }
+    return line;
+}
+
+fluidnc_config_state_t fluidnc_config_state(void) {
+    return state;
+}
+
+bool fluidnc_config_busy(void) {
+    return state == FLUIDNC_CONFIG_IDENT || state == FLUIDNC_CONFIG_DUMP;
+}
+
+const fluidnc_config_t *fluidnc_config_get(void) {
+    return &current;
+}
+
+void fluidnc_config_get_stats(fluidnc_config_stats_t *out) {
+    *out = stats;
+    out->state = state;
+}
+
+bool fluidnc_config_parse_setting(fluidnc_config_t *config, const char *line) {
+    if (line[0] != '$') return false;
+    char *end;
+    long n = strtol(line + 1, &end, 10);
+    if (end == line + 1 || *end != '=') return false;
+    float v = strtof(end + 1, NULL);
+
+    if (n >= 100 && n < 140 && n % 10 < FLUIDNC_CONFIG_AXES) {
+        fluidnc_axis_config_t *a = &config->axes[n % 10];
+        switch (n / 10) {
+            case 10: a->steps_per_mm = v; break;
+            case 11: a->max_rate_mm_min = v; break;
+            case 12: a->accel_mm_s2 = v; break;
+            default: a->max_travel_mm = v; break;
+        }
+        return true;
+    }
+    switch (n) {
+        case 11: config->junction_deviation_mm = v; break;
+        case 20: config->soft_limits = v != 0.0f; break;
+        case 21: config->hard_limits = v != 0.0f; break;
+        case 22: config->homing = v != 0.0f; break;
+        default: break;                         // Known to Grbl, not needed here
+    }
+    return true;
+}
+
+float fluidnc_config_max_feed(const fluidnc_config_t *config, int axis, float fallback) {
+    if (axis < 0 || axis >= config->axis_count) return fallback;
+    float rate = config->axes[axis].max_rate_mm_min;
+    return rate > 0.0f ? rate : fallback;
+}
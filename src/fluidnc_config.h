@@ -0,0 +1,161 @@
+/**
+ * @file fluidnc_config.h
+ * @brief Axis limits read from FluidNC at boot, cached by a config hash
+ *
+ * The limits that matter on this side of the UART - steps/mm, max rate,
+ * acceleration, travel - live in FluidNC's config.yaml. Copies of them as
+ * constants drift (300 mm/min test feeds against a 200 mm/min axis), so
+ * they are read from the controller instead:
+ *
+ *   "$I"  -> [VER:...] [OPT:...] [MSG: Machine: <yaml name>]  ok
+ *   "$$"  -> $11=... $20=... $100=80.000 ... $133=200.000      ok
+ *
+ * "$$" is FluidNC's Grbl-numbered view of the YAML ($10N steps/mm, $11N
+ * max rate, $12N acceleration, $13N max travel for axis N) and carries
+ * every limit used here in ~25 short lines; "$Config/Dump" is the whole
+ * YAML tree and is not needed.
+ *
+ * The dump is what costs time, so it is skipped on a warm boot: the "$I"
+ * identity lines (firmware version, options, machine name) are hashed
+ * into a key, and a cached config with the same key is used as is. Only
+ * a different firmware or config file (name:) triggers a new dump - an
+ * in-place edit of the same file keeps the name, so clear the cache
+ * (or rename the machine) after changing limits.
+ *
+ * RULES:
+ * - Nothing else may be in flight once a discovery line has been polled:
+ *   its "ok" and reply lines are consumed by fluidnc_config_on_line().
+ *   Until it is polled, discovery consumes nothing, so the caller can hold
+ *   it back while another exchange finishes.
+ * - A line without a reply within reply_timeout_ms is sent again (up to
+ *   retries times): FluidNC drops lines while booting and on Ctrl-X.
+ * - FAILED (error or no reply) leaves the previous config in place; limits
+ *   that were never read fall back to the caller's constants.
+ *
+ * Shared by the firmware and the host tools; does not depend on ESP-IDF.
+ *
+ * Usage:
+ *   fluidnc_config_init(NULL);
+ *   fluidnc_config_start(cached_or_NULL, now_us);
+ *   loop():
+ *     if (!fluidnc_config_on_line(line, now_us)) handle(line);
+ *     if ((line = fluidnc_config_poll(now_us))) send(line);
+ *     if (fluidnc_config_state() == FLUIDNC_CONFIG_DONE) use fluidnc_config_get()
+ *   feed = fluidnc_config_max_feed(fluidnc_config_get(), axis, MAX_FEEDRATE_MM_MIN);
+ */
+
+#ifndef FLUIDNC_CONFIG_H
+#define FLUIDNC_CONFIG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLUIDNC_CONFIG_AXES     4           // X Y Z A = pumps 1-4
+#define FLUIDNC_CONFIG_VERSION  1           // Layout of fluidnc_config_t (cache blobs)
+
+typedef struct {
+    float steps_per_mm;         // $10N
+    float max_rate_mm_min;      // $11N
+    float accel_mm_s2;          // $12N
+    float max_travel_mm;        // $13N
+} fluidnc_axis_config_t;
+
+/** Plain data: stored as one blob */
+typedef struct {
+    uint32_t version;           // FLUIDNC_CONFIG_VERSION
+    uint32_t key;               // Hash of the "$I" identity lines
+    uint32_t hash;              // Hash of the "$$" reply
+    uint8_t axis_count;         // Axes with all four limits
+    bool soft_limits;           // $20
+    bool hard_limits;           // $21
+    bool homing;                // $22
+    float junction_deviation_mm;    // $11
+    fluidnc_axis_config_t axes[FLUIDNC_CONFIG_AXES];
+} fluidnc_config_t;
+
+typedef struct {
+    uint32_t reply_timeout_ms;  // Line sent -> its "ok" ("$$" takes ~45 ms at 115200)
+    uint8_t retries;            // Resends of a line without a reply
+} fluidnc_config_options_t;
+
+#define FLUIDNC_CONFIG_DEFAULT_OPTIONS { \
+    .reply_timeout_ms = 250, \
+    .retries = 2, \
+}
+
+typedef enum {
+    FLUIDNC_CONFIG_IDLE = 0,    // Not started
+    FLUIDNC_CONFIG_IDENT,       // "$I" sent
+    FLUIDNC_CONFIG_DUMP,        // Cache miss: "$$" sent
+    FLUIDNC_CONFIG_DONE,        // fluidnc_config_get() is the controller's
+    FLUIDNC_CONFIG_FAILED,      // Error or timeout: start again to retry
+} fluidnc_config_state_t;
+
+typedef struct {
+    fluidnc_config_state_t state;
+    bool from_cache;            // DONE without a dump
+    bool changed;               // DONE from a dump: store the new config
+    uint32_t starts;
+    uint32_t dumps;
+    uint32_t retries;           // Lines sent again
+    uint32_t lines;             // Reply lines consumed
+    uint32_t failures;
+    uint32_t last_us;           // fluidnc_config_start() -> DONE
+} fluidnc_config_stats_t;
+
+/**
+ * @brief Load options (NULL = FLUIDNC_CONFIG_DEFAULT_OPTIONS), state IDLE, no config
+ */
+void fluidnc_config_init(const fluidnc_config_options_t *options);
+
+/**
+ * @brief Begin discovery
+ * @param cached Config from the last boot (NULL or wrong version = none)
+ */
+void fluidnc_config_start(const fluidnc_config_t *cached, int64_t now_us);
+
+/**
+ * @brief Every line that is not a status report
+ * @return true if the line was the reply to a discovery command
+ */
+bool fluidnc_config_on_line(const char *line, int64_t now_us);
+
+/**
+ * @brief Line to send now (no terminator), or NULL
+ */
+const char *fluidnc_config_poll(int64_t now_us);
+
+fluidnc_config_state_t fluidnc_config_state(void);
+
+/**
+ * @brief Discovery started and not yet DONE / FAILED
+ */
+bool fluidnc_config_busy(void);
+
+/**
+ * @brief Last good config (axis_count 0 until one was read or loaded)
+ */
+const fluidnc_config_t *fluidnc_config_get(void);
+
+void fluidnc_config_get_stats(fluidnc_config_stats_t *out);
+
+/**
+ * @brief Apply one "$N=value" line to a config
+ * @return false if the line is not a numbered setting
+ */
+bool fluidnc_config_parse_setting(fluidnc_config_t *config, const char *line);
+
+/**
+ * @brief Axis max rate, or fallback if it is not known
+ */
+float fluidnc_config_max_feed(const fluidnc_config_t *config, int axis, float fallback);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLUIDNC_CONFIG_H
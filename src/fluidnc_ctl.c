@@ -0,0 +1,261 @@
+/**
+ * @file fluidnc_ctl.c
+ * @brief FluidNC controller state: stop without a reset, reset without sleeps
+ *
+ * See fluidnc_ctl.h for the sequence. Each report re-runs decide(), so the
+ * step taken always follows the latest state rather than the state at the
+ * call: a move that ends on its own while the feed hold is on its way
+ * finishes as Idle with no reset at all. Every byte is sent at most once
+ * per attempt (the *_sent flags); reports taken before the banner are
+ * stale and ignored.
+ */
+
+#include "fluidnc_ctl.h"
+
+#include <stddef.h>
+#include <string.h>
+
+static fluidnc_ctl_config_t cfg = FLUIDNC_CTL_DEFAULT_CONFIG;
+static fluidnc_ctl_state_t state = FLUIDNC_CTL_READY;
+
+static bool force_reset = false;        // fluidnc_ctl_reset()
+static bool reset_done = false;         // Banner seen in this attempt
+static bool cancel_sent = false;
+static bool hold_sent = false;
+static bool unlock_sent = false;
+
+static fluidnc_status_t last;
+static bool have_status = false;
+
+static int64_t start_us = 0;            // fluidnc_ctl_stop() / _reset()
+static int64_t phase_us = 0;            // Current state entered
+static int64_t query_us = 0;            // Last '?'
+
+#define PENDING_MAX     4               // Actions between two polls (one per step)
+static fluidnc_ctl_action_t pending[PENDING_MAX];
+static uint8_t pending_count = 0;
+
+static fluidnc_ctl_stats_t stats;
+
+void fluidnc_ctl_init(const fluidnc_ctl_config_t *config) {
+    static const fluidnc_ctl_config_t defaults = FLUIDNC_CTL_DEFAULT_CONFIG;
+    cfg = config ? *config : defaults;
+    if (cfg.query_ms == 0) cfg.query_ms = 1;
+    state = FLUIDNC_CTL_READY;
+    have_status = false;
+    pending_count = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+static void push(fluidnc_ctl_action_kind_t kind, uint8_t b, const char *line) {
+    if (pending_count == PENDING_MAX) return;      // Not reachable: each byte is sent once per attempt
+    fluidnc_ctl_action_t *a = &pending[pending_count++];
+    a->kind = kind;
+    a->byte = b;
+    a->line = line;
+}
+
+static void push_realtime(uint8_t b) {
+    push(FLUIDNC_CTL_ACTION_REALTIME, b, NULL);
+}
+
+static void push_line(const char *line) {
+    push(FLUIDNC_CTL_ACTION_LINE, 0, line);
+}
+
+static void enter(fluidnc_ctl_state_t next, int64_t now_us) {
+    if (next == state) return;
+    state = next;
+    phase_us = now_us;
+    query_us = now_us - (int64_t)cfg.query_ms * 1000;      // First '?' right away
+}
+
+static void finish(int64_t now_us) {
+    state = FLUIDNC_CTL_READY;
+    stats.last_us = (uint32_t)(now_us - start_us);
+    if (stats.last_us > stats.max_us) stats.max_us = stats.last_us;
+}
+
+static void fail(void) {
+    state = FLUIDNC_CTL_FAILED;
+    stats.failures++;
+}
+
+static void start_reset(int64_t now_us) {
+    push_realtime(FLUIDNC_RT_RESET);
+    stats.resets++;
+    enter(FLUIDNC_CTL_RESETTING, now_us);
+}
+
+/**
+ * @brief Next step from the latest report
+ */
+static void decide(int64_t now_us) {
+    switch (have_status ? last.state : FLUIDNC_STATE_UNKNOWN) {
+        case FLUIDNC_STATE_JOG:
+            if (!cancel_sent) {
+                push_realtime(FLUIDNC_RT_JOG_CANCEL);
+                cancel_sent = true;
+                stats.jog_cancels++;
+            }
+            enter(FLUIDNC_CTL_STOPPING, now_us);
+            break;
+
+        case FLUIDNC_STATE_RUN:
+            if (!hold_sent) {
+                push_realtime(FLUIDNC_RT_FEED_HOLD);
+                hold_sent = true;
+                stats.holds++;
+            }
+            enter(FLUIDNC_CTL_STOPPING, now_us);
+            break;
+
+        case FLUIDNC_STATE_HOLD:
+            if (last.substate == 0) {
+                start_reset(now_us);                // Stopped: the reset loses no position
+            } else {
+                enter(FLUIDNC_CTL_STOPPING, now_us);
+            }
+            break;
+
+        case FLUIDNC_STATE_ALARM:
+            if (!unlock_sent) {
+                push_line("$X");
+                unlock_sent = true;
+                stats.unlocks++;
+            }
+            enter(FLUIDNC_CTL_UNLOCKING, now_us);
+            break;
+
+        case FLUIDNC_STATE_IDLE:
+            if (force_reset && !reset_done) {
+                start_reset(now_us);
+            } else {
+                finish(now_us);
+            }
+            break;
+
+        case FLUIDNC_STATE_UNKNOWN:
+            enter(FLUIDNC_CTL_CHECKING, now_us);
+            break;
+
+        default:                                    // Door, Check, Home, Sleep
+            start_reset(now_us);
+            break;
+    }
+}
+
+static void begin(bool reset, int64_t now_us) {
+    stats.stops++;
+    start_us = now_us;
+    force_reset = reset;
+    reset_done = cancel_sent = hold_sent = unlock_sent = false;
+    pending_count = 0;
+    state = FLUIDNC_CTL_READY;
+
+    // Moving / stopped / locked can be acted on at once; an older "Idle" may
+    // predate a line just sent, so that one is confirmed with a fresh report
+    fluidnc_state_t m = have_status ? last.state : FLUIDNC_STATE_UNKNOWN;
+    if (m == FLUIDNC_STATE_IDLE) have_status = false;
+    decide(now_us);
+}
+
+void fluidnc_ctl_stop(int64_t now_us) {
+    begin(false, now_us);
+}
+
+void fluidnc_ctl_reset(int64_t now_us) {
+    begin(true, now_us);
+}
+
+void fluidnc_ctl_on_status(const fluidnc_status_t *status, int64_t now_us) {
+    last = *status;
+    have_status = true;
+    if (state == FLUIDNC_CTL_STOPPING || state == FLUIDNC_CTL_CHECKING) {
+        decide(now_us);
+    }
+}
+
+bool fluidnc_ctl_on_line(const char *line, int64_t now_us) {
+    if (state == FLUIDNC_CTL_RESETTING && strncmp(line, "Grbl", 4) == 0) {
+        reset_done = true;
+        cancel_sent = hold_sent = unlock_sent = false;
+        have_status = false;                        // Reports before the banner are stale
+        enter(FLUIDNC_CTL_CHECKING, now_us);
+        return true;
+    }
+    if (state == FLUIDNC_CTL_UNLOCKING) {
+        if (strcmp(line, "ok") == 0) {
+            have_status = false;                    // Confirm Idle with a fresh report
+            enter(FLUIDNC_CTL_CHECKING, now_us);
+            return true;
+        }
+        if (strncmp(line, "error", 5) == 0) {
+            fail();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool fluidnc_ctl_poll(int64_t now_us, fluidnc_ctl_action_t *action) {
+    int64_t waited_ms = (now_us - phase_us) / 1000;
+    switch (state) {
+        case FLUIDNC_CTL_STOPPING:
+            if (waited_ms > cfg.stop_timeout_ms) {
+                stats.timeouts++;
+                start_reset(now_us);                // As estop.h: stop waiting, reset anyway
+            }
+            break;
+        case FLUIDNC_CTL_RESETTING:
+        case FLUIDNC_CTL_CHECKING:
+            if (waited_ms > cfg.banner_timeout_ms) {
+                stats.timeouts++;
+                fail();
+            }
+            break;
+        case FLUIDNC_CTL_UNLOCKING:
+            if (waited_ms > cfg.unlock_timeout_ms) {
+                stats.timeouts++;
+                fail();
+            }
+            break;
+        default:
+            break;
+    }
+
+    if (pending_count > 0) {
+        *action = pending[0];
+        pending_count--;
+        memmove(&pending[0], &pending[1], pending_count * sizeof(pending[0]));
+        return true;
+    }
+    if ((state == FLUIDNC_CTL_STOPPING || state == FLUIDNC_CTL_CHECKING) &&
+        now_us - query_us >= (int64_t)cfg.query_ms * 1000) {
+        query_us = now_us;
+        action->kind = FLUIDNC_CTL_ACTION_REALTIME;
+        action->byte = FLUIDNC_RT_STATUS;
+        action->line = NULL;
+        return true;
+    }
+    return false;
+}
+
+bool fluidnc_ctl_ready(void) {
+    return state == FLUIDNC_CTL_READY;
+}
+
+fluidnc_ctl_state_t fluidnc_ctl_state(void) {
+    return state;
+}
+
+const char *fluidnc_ctl_state_name(fluidnc_ctl_state_t s) {
+    static const char *const names[] = {"READY", "STOPPING", "RESETTING", "CHECKING", "UNLOCKING", "FAILED"};
+    return s <= FLUIDNC_CTL_FAILED ? names[s] : "?";
+}
+
+void fluidnc_ctl_get_stats(fluidnc_ctl_stats_t *out) {
+    *out = stats;
+    out->state = state;
+    out->machine = have_status ? last.state : FLUIDNC_STATE_UNKNOWN;
+}
@@ -0,0 +1,162 @@
+/**
+ * @file fluidnc_ctl.h
+ * @brief FluidNC controller state: stop without a reset, reset without sleeps
+ *
+ * The sketches used to end every stop with the same fixed sequence:
+ *
+ *   '!'  delay(100)  Ctrl-X  delay(100)  "$X"
+ *
+ * which costs 200+ ms, raises ALARM:3 whenever the reset lands while the
+ * pump is still decelerating, and throws away the planner and the modal
+ * state even when none of that was needed. This module instead drives the
+ * controller from what its status reports say, one step at a time:
+ *
+ *   Jog       -> 0x85 jog cancel: decelerate, drop queued jogs, Idle.
+ *                No reset - the fast path for anything sent as "$J=".
+ *   Run       -> '!' feed hold; wait for Hold:0 (stopped)
+ *   Hold:0    -> Ctrl-X (motion has stopped: no ALARM:3); wait for the
+ *                "Grbl ..." banner, then ask for a report
+ *   Alarm     -> "$X"; wait for its "ok"
+ *   Idle      -> done
+ *
+ * Every wait ends on the event itself (a report, the banner, the "ok"),
+ * with '?' sent every query_ms while a report is awaited. Only a timeout
+ * ends a wait otherwise: motion that does not stop within stop_timeout_ms
+ * is reset anyway (as estop.h does), and a missing banner or "ok" makes
+ * the attempt FAILED.
+ *
+ * A G1 move cannot be abandoned without Ctrl-X - Grbl has no planner flush
+ * other than a reset - so open-ended motion that may be stopped early (dose
+ * to weight, priming) should be sent as "$J=G91 ..." to stop on the jog
+ * cancel path.
+ *
+ * RULES:
+ * - Feed every status report and every other line while not ready; lines
+ *   the module consumes (banner, the "ok" / "error" to its "$X") are not
+ *   the caller's.
+ * - Send nothing else until fluidnc_ctl_ready(). After a reset FluidNC has
+ *   discarded every line the caller still expected an "ok" for.
+ * - Realtime bytes go through the UART driver (estop_send_realtime() or a
+ *   one-byte write); lines are G-code lines.
+ *
+ * Shared by the firmware and the host tools; does not depend on ESP-IDF.
+ *
+ * Usage:
+ *   fluidnc_ctl_init(NULL);
+ *   fluidnc_ctl_on_status(&status, now_us);      // every report, always
+ *   fluidnc_ctl_stop(now_us);                    // or fluidnc_ctl_reset(now_us)
+ *   loop():
+ *     if (!fluidnc_ctl_on_line(line, now_us)) handle(line);
+ *     while (fluidnc_ctl_poll(now_us, &action)) send(action);
+ *     if (fluidnc_ctl_ready()) next dose
+ */
+
+#ifndef FLUIDNC_CTL_H
+#define FLUIDNC_CTL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "fluidnc_status.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Realtime commands (Grbl 1.1 / FluidNC)
+#define FLUIDNC_RT_STATUS       '?'
+#define FLUIDNC_RT_FEED_HOLD    '!'
+#define FLUIDNC_RT_RESET        0x18
+#define FLUIDNC_RT_JOG_CANCEL   0x85
+
+typedef struct {
+    uint32_t query_ms;          // '?' interval while a report is awaited
+    uint32_t stop_timeout_ms;   // Jog cancel / feed hold -> stopped, else Ctrl-X anyway
+    uint32_t banner_timeout_ms; // Ctrl-X -> "Grbl ..." banner
+    uint32_t unlock_timeout_ms; // "$X" -> "ok"
+} fluidnc_ctl_config_t;
+
+#define FLUIDNC_CTL_DEFAULT_CONFIG { \
+    .query_ms = 20, \
+    .stop_timeout_ms = 500, \
+    .banner_timeout_ms = 1000, \
+    .unlock_timeout_ms = 1000, \
+}
+
+typedef enum {
+    FLUIDNC_CTL_READY = 0,      // Nothing in progress
+    FLUIDNC_CTL_STOPPING,       // Jog cancel / feed hold sent, waiting for Idle / Hold:0
+    FLUIDNC_CTL_RESETTING,      // Ctrl-X sent, waiting for the banner
+    FLUIDNC_CTL_CHECKING,       // Waiting for a report to decide the next step
+    FLUIDNC_CTL_UNLOCKING,      // "$X" sent, waiting for "ok"
+    FLUIDNC_CTL_FAILED,         // Timed out or "$X" refused; stop / reset to retry
+} fluidnc_ctl_state_t;
+
+typedef enum {
+    FLUIDNC_CTL_ACTION_REALTIME = 0,    // Send byte on the realtime path
+    FLUIDNC_CTL_ACTION_LINE,            // Send line (no terminator) as G-code
+} fluidnc_ctl_action_kind_t;
+
+typedef struct {
+    fluidnc_ctl_action_kind_t kind;
+    uint8_t byte;
+    const char *line;
+} fluidnc_ctl_action_t;
+
+typedef struct {
+    fluidnc_ctl_state_t state;
+    fluidnc_state_t machine;    // Latest report
+    uint32_t stops;             // fluidnc_ctl_stop() / _reset() calls
+    uint32_t jog_cancels;       // 0x85 sent
+    uint32_t holds;             // '!' sent
+    uint32_t resets;            // Ctrl-X sent
+    uint32_t unlocks;           // "$X" sent
+    uint32_t timeouts;
+    uint32_t failures;
+    uint32_t last_us;           // Last call -> READY
+    uint32_t max_us;
+} fluidnc_ctl_stats_t;
+
+/**
+ * @brief Load configuration (NULL = FLUIDNC_CTL_DEFAULT_CONFIG), state READY
+ */
+void fluidnc_ctl_init(const fluidnc_ctl_config_t *config);
+
+/**
+ * @brief Bring the controller to Idle and unlocked, resetting only if motion
+ *        has to be abandoned (Run / Hold) or the state needs it
+ */
+void fluidnc_ctl_stop(int64_t now_us);
+
+/**
+ * @brief As fluidnc_ctl_stop(), but always with a Ctrl-X (after motion has
+ *        stopped) - clears modal state and G92 offsets as well
+ */
+void fluidnc_ctl_reset(int64_t now_us);
+
+void fluidnc_ctl_on_status(const fluidnc_status_t *status, int64_t now_us);
+
+/**
+ * @brief Every line that is not a status report
+ * @return true if the line was the module's (banner, reply to its "$X")
+ */
+bool fluidnc_ctl_on_line(const char *line, int64_t now_us);
+
+/**
+ * @brief Next thing to send; call until it returns false
+ */
+bool fluidnc_ctl_poll(int64_t now_us, fluidnc_ctl_action_t *action);
+
+/**
+ * @brief READY (also true before the first stop)
+ */
+bool fluidnc_ctl_ready(void);
+
+fluidnc_ctl_state_t fluidnc_ctl_state(void);
+const char *fluidnc_ctl_state_name(fluidnc_ctl_state_t state);
+void fluidnc_ctl_get_stats(fluidnc_ctl_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLUIDNC_CTL_H
@@ -0,0 +1,129 @@
+/**
+ * @file fluidnc_status.c
+ * @brief Allocation-free parser for FluidNC/Grbl status reports
+ */
+
+#include "fluidnc_status.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const char *const state_names[] = {
+    [FLUIDNC_STATE_UNKNOWN] = "Unknown",
+    [FLUIDNC_STATE_IDLE]    = "Idle",
+    [FLUIDNC_STATE_RUN]     = "Run",
+    [FLUIDNC_STATE_HOLD]    = "Hold",
+    [FLUIDNC_STATE_JOG]     = "Jog",
+    [FLUIDNC_STATE_ALARM]   = "Alarm",
+    [FLUIDNC_STATE_DOOR]    = "Door",
+    [FLUIDNC_STATE_CHECK]   = "Check",
+    [FLUIDNC_STATE_HOME]    = "Home",
+    [FLUIDNC_STATE_SLEEP]   = "Sleep",
+};
+
+#define STATE_COUNT (sizeof(state_names) / sizeof(state_names[0]))
+
+static bool is_field_end(char c) {
+    return c == '|' || c == '>' || c == '\0' || c == '\r' || c == '\n';
+}
+
+/**
+ * @brief Parse up to max comma-separated floats; stops at the field end
+ * @return Number of values parsed
+ */
+static int parse_floats(const char *p, float *vals, int max, const char **end) {
+    int n = 0;
+    while (n < max) {
+        char *next;
+        float v = strtof(p, &next);
+        if (next == p) break;
+        vals[n++] = v;
+        p = next;
+        if (*p != ',') break;
+        p++;
+    }
+    while (!is_field_end(*p)) p++;
+    *end = p;
+    return n;
+}
+
+static bool field_is(const char *p, const char *name, size_t len) {
+    return strncmp(p, name, len) == 0;
+}
+
+bool fluidnc_status_parse(const char *line, fluidnc_status_t *out) {
+    if (line == NULL || line[0] != '<') {
+        return false;
+    }
+    memset(out, 0, sizeof(*out));
+    out->substate = -1;
+
+    // State: letters up to ':' or '|'
+    const char *p = line + 1;
+    size_t len = 0;
+    while (p[len] != '\0' && p[len] != '|' && p[len] != ':' && p[len] != '>') len++;
+    for (size_t i = 1; i < STATE_COUNT; i++) {
+        if (strlen(state_names[i]) == len && strncmp(p, state_names[i], len) == 0) {
+            out->state = (fluidnc_state_t)i;
+            break;
+        }
+    }
+    p += len;
+    if (*p == ':') {
+        out->substate = (int8_t)strtol(p + 1, (char **)&p, 10);
+    }
+
+    while (*p == '|') {
+        p++;
+        float vals[FLUIDNC_MAX_AXES];
+        int n;
+        if (field_is(p, "MPos:", 5) || field_is(p, "WPos:", 5)) {
+            bool mpos = p[0] == 'M';
+            n = parse_floats(p + 5, out->pos, FLUIDNC_MAX_AXES, &p);
+            out->axis_count = (uint8_t)n;
+            out->has_mpos = mpos;
+            out->has_wpos = !mpos;
+        } else if (field_is(p, "FS:", 3)) {
+            n = parse_floats(p + 3, vals, 2, &p);
+            if (n >= 1) { out->has_fs = true; out->feed = vals[0]; }
+            if (n >= 2) out->spindle = vals[1];
+        } else if (field_is(p, "F:", 2)) {
+            n = parse_floats(p + 2, vals, 1, &p);
+            if (n >= 1) { out->has_fs = true; out->feed = vals[0]; }
+        } else if (field_is(p, "Ov:", 3)) {
+            n = parse_floats(p + 3, vals, 3, &p);
+            if (n == 3) {
+                out->has_ov = true;
+                out->ov_feed = (uint8_t)vals[0];
+                out->ov_rapid = (uint8_t)vals[1];
+                out->ov_spindle = (uint8_t)vals[2];
+            }
+        } else if (field_is(p, "Bf:", 3)) {
+            n = parse_floats(p + 3, vals, 2, &p);
+            if (n == 2) {
+                out->has_bf = true;
+                out->planner_free = (int16_t)vals[0];
+                out->rx_free = (int16_t)vals[1];
+            }
+        } else {
+            while (!is_field_end(*p)) p++;
+        }
+    }
+
+    return out->state != FLUIDNC_STATE_UNKNOWN;
+}
+
+bool fluidnc_status_same_position(const fluidnc_status_t *a, const fluidnc_status_t *b, float tol_mm) {
+    if (a->axis_count == 0 || a->axis_count != b->axis_count || a->has_mpos != b->has_mpos) {
+        return false;
+    }
+    for (int i = 0; i < a->axis_count; i++) {
+        float d = a->pos[i] - b->pos[i];
+        if (d > tol_mm || d < -tol_mm) return false;
+    }
+    return true;
+}
+
+const char *fluidnc_state_name(fluidnc_state_t state) {
+    return (size_t)state < STATE_COUNT ? state_names[state] : "Unknown";
+}
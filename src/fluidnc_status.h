@@ -0,0 +1,78 @@
+/**
+ * @file fluidnc_status.h
+ * @brief Allocation-free parser for FluidNC/Grbl status reports
+ *
+ * Parses lines such as
+ *   <Run|MPos:50.123,0.000,0.000,0.000|FS:100,0>
+ *   <Hold:0|MPos:12.000,0.000,0.000,0.000|Bf:15,127|FS:0,0|Ov:100,100,100>
+ * into a fixed struct. Unknown fields are ignored.
+ *
+ * Shared by the firmware and the host tools; does not depend on ESP-IDF.
+ */
+
+#ifndef FLUIDNC_STATUS_H
+#define FLUIDNC_STATUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLUIDNC_MAX_AXES    6       // X Y Z A B C (pumps use X Y Z A)
+
+typedef enum {
+    FLUIDNC_STATE_UNKNOWN = 0,
+    FLUIDNC_STATE_IDLE,
+    FLUIDNC_STATE_RUN,
+    FLUIDNC_STATE_HOLD,         // substate 0 = stopped, 1 = decelerating
+    FLUIDNC_STATE_JOG,
+    FLUIDNC_STATE_ALARM,
+    FLUIDNC_STATE_DOOR,
+    FLUIDNC_STATE_CHECK,
+    FLUIDNC_STATE_HOME,
+    FLUIDNC_STATE_SLEEP,
+} fluidnc_state_t;
+
+typedef struct {
+    fluidnc_state_t state;
+    int8_t substate;                    // Number after ':' in the state, -1 if none
+    uint8_t axis_count;                 // Axes in MPos/WPos
+    bool has_mpos;                      // Position below is MPos (false: WPos or absent)
+    bool has_wpos;
+    float pos[FLUIDNC_MAX_AXES];
+    bool has_fs;
+    float feed;                         // FS: / F: current feed (mm/min)
+    float spindle;
+    bool has_ov;
+    uint8_t ov_feed;                    // Ov: feed, rapid, spindle (%)
+    uint8_t ov_rapid;
+    uint8_t ov_spindle;
+    bool has_bf;
+    int16_t planner_free;               // Bf: free planner blocks, free RX bytes
+    int16_t rx_free;
+} fluidnc_status_t;
+
+/**
+ * @brief Parse one status report
+ * @param line Line as received (leading '<' required, trailing '>' / CR / LF optional)
+ * @return false if the line is not a status report
+ */
+bool fluidnc_status_parse(const char *line, fluidnc_status_t *out);
+
+/**
+ * @brief True if every axis of a and b is within tol_mm (both need a position)
+ */
+bool fluidnc_status_same_position(const fluidnc_status_t *a, const fluidnc_status_t *b, float tol_mm);
+
+/**
+ * @brief State name as FluidNC prints it ("Idle", "Hold", ...)
+ */
+const char *fluidnc_state_name(fluidnc_state_t state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // FLUIDNC_STATUS_H
@@ -0,0 +1,160 @@
+/**
+ * @file hal.h
+ * @brief Thin hardware abstraction: clock, GPIO, UART, I2C LCD, LED strip, NVS
+ *
+ * Two backends implement this interface:
+ * - src/hal_esp32.c            ESP-IDF drivers (production firmware, main/)
+ * - host/hal_linux/hal_linux.c Linux: UARTs are pseudo-terminals, GPIO is
+ *                              a virtual pin array, the LCD and LED strip
+ *                              are in-memory framebuffers, NVS is a file
+ *
+ * On the host the Arduino API used by the test sketches (Serial2,
+ * digitalRead, millis, LiquidCrystal_I2C, FastLED, ...) is provided by
+ * host/arduino on top of this interface, and the ESP-IDF calls used by the
+ * shared modules (esp_timer, gpio ISR, uart_ll) by host/esp_idf - so
+ * test_12..test_19 build unchanged for both targets.
+ *
+ * There is one LCD and one LED strip, as on the hardware. Functions return
+ * false on failure; nothing here allocates after init.
+ */
+
+#ifndef HAL_H
+#define HAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// CLOCK
+// ============================================================================
+
+/** Microseconds since boot (esp_timer time base) */
+int64_t hal_time_us(void);
+
+/** Milliseconds since boot (wraps like Arduino millis()) */
+uint32_t hal_millis(void);
+
+/** Yielding delay (task delay on the ESP32) */
+void hal_delay_ms(uint32_t ms);
+
+/** Busy-wait delay for short protocol timing */
+void hal_delay_us(uint32_t us);
+
+// ============================================================================
+// GPIO
+// ============================================================================
+
+typedef enum {
+    HAL_GPIO_INPUT = 0,
+    HAL_GPIO_INPUT_PULLUP,
+    HAL_GPIO_OUTPUT,
+} hal_gpio_mode_t;
+
+typedef enum {
+    HAL_GPIO_EDGE_NONE = 0,
+    HAL_GPIO_EDGE_RISING,
+    HAL_GPIO_EDGE_FALLING,
+    HAL_GPIO_EDGE_ANY,
+} hal_gpio_edge_t;
+
+typedef void (*hal_gpio_isr_t)(void *arg);
+
+bool hal_gpio_mode(int pin, hal_gpio_mode_t mode);
+int hal_gpio_read(int pin);
+void hal_gpio_write(int pin, int level);
+
+/**
+ * @brief Attach (isr != NULL) or detach an edge interrupt
+ *
+ * Handlers run in interrupt context on the ESP32 (IRAM, no blocking) and
+ * on the thread that changed the pin on Linux.
+ */
+bool hal_gpio_set_isr(int pin, hal_gpio_edge_t edge, hal_gpio_isr_t isr, void *arg);
+
+// ============================================================================
+// UART
+// ============================================================================
+
+#define HAL_UART_CONSOLE    0       // UART0 = USB console (stdin/stdout on Linux)
+#define HAL_UART_COUNT      3
+
+typedef struct {
+    uint32_t baud;
+    int tx_pin;                     // -1 = default pin
+    int rx_pin;
+    uint32_t rx_buffer;             // Driver RX ring (bytes)
+    uint32_t tx_buffer;             // Driver TX ring (0 = blocking writes)
+} hal_uart_config_t;
+
+bool hal_uart_open(int port, const hal_uart_config_t *config);
+
+/** @return Bytes queued for transmission, or -1 */
+int hal_uart_write(int port, const void *data, size_t len);
+
+/** @return Bytes read (0 on timeout), or -1 */
+int hal_uart_read(int port, void *buf, size_t len, uint32_t timeout_ms);
+
+/** @return Bytes waiting in the RX path */
+size_t hal_uart_available(int port);
+
+/** @brief Wait until everything written has left the TX path */
+void hal_uart_flush(int port);
+
+// ============================================================================
+// I2C CHARACTER LCD (HD44780 behind a PCF8574 backpack)
+// ============================================================================
+
+typedef struct {
+    uint8_t addr;                   // 0x27 or 0x3F
+    uint8_t cols;
+    uint8_t rows;
+    int sda_pin;
+    int scl_pin;
+} hal_lcd_config_t;
+
+/** @return true if a device ACKs at addr (I2C bus set up on first use) */
+bool hal_lcd_probe(const hal_lcd_config_t *config, uint8_t addr);
+
+bool hal_lcd_init(const hal_lcd_config_t *config);
+void hal_lcd_clear(void);
+void hal_lcd_set_cursor(uint8_t col, uint8_t row);
+void hal_lcd_write(const char *text, size_t len);
+void hal_lcd_backlight(bool on);
+
+// ============================================================================
+// LED STRIP (WS2812B)
+// ============================================================================
+
+bool hal_leds_init(int pin, size_t count);
+
+/**
+ * @brief Send a frame
+ * @param rgb count x {r, g, b}; the backend applies wire order and brightness
+ */
+void hal_leds_show(const uint8_t *rgb, size_t count, uint8_t brightness);
+
+// ============================================================================
+// NVS (small key / value blobs that survive reset)
+// ============================================================================
+
+bool hal_nvs_init(void);
+
+/**
+ * @param len In: capacity of buf. Out: stored size.
+ * @return false if the key does not exist or buf is too small
+ */
+bool hal_nvs_get(const char *ns, const char *key, void *buf, size_t *len);
+
+bool hal_nvs_set(const char *ns, const char *key, const void *data, size_t len);
+bool hal_nvs_erase(const char *ns, const char *key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HAL_H
@@ -0,0 +1,328 @@
+/**
+ * @file hal_esp32.c
+ * @brief hal.h on ESP-IDF drivers
+ *
+ * UART: driver/uart.h. GPIO: driver/gpio.h with the shared ISR service
+ * (installed at level 3 by button_events_init() if that runs first).
+ * LCD: PCF8574 backpack in 4-bit mode over the legacy I2C master driver.
+ * LEDs: WS2812B via the RMT TX bytes encoder. NVS: nvs_flash blobs.
+ */
+
+#include "hal.h"
+
+#include <string.h>
+
+#include "driver/gpio.h"
+#include "driver/i2c.h"
+#include "driver/rmt_tx.h"
+#include "driver/uart.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+
+// ============================================================================
+// CLOCK
+// ============================================================================
+
+int64_t hal_time_us(void) {
+    return esp_timer_get_time();
+}
+
+uint32_t hal_millis(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+void hal_delay_ms(uint32_t ms) {
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+void hal_delay_us(uint32_t us) {
+    esp_rom_delay_us(us);
+}
+
+// ============================================================================
+// GPIO
+// ============================================================================
+
+static bool isr_service_installed = false;
+
+bool hal_gpio_mode(int pin, hal_gpio_mode_t mode) {
+    gpio_config_t io_conf = {
+        .pin_bit_mask = 1ULL << pin,
+        .mode = mode == HAL_GPIO_OUTPUT ? GPIO_MODE_OUTPUT : GPIO_MODE_INPUT,
+        .pull_up_en = mode == HAL_GPIO_INPUT_PULLUP ? GPIO_PULLUP_ENABLE : GPIO_PULLUP_DISABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_DISABLE,
+    };
+    return gpio_config(&io_conf) == ESP_OK;
+}
+
+int hal_gpio_read(int pin) {
+    return gpio_get_level((gpio_num_t)pin);
+}
+
+void hal_gpio_write(int pin, int level) {
+    gpio_set_level((gpio_num_t)pin, level ? 1 : 0);
+}
+
+bool hal_gpio_set_isr(int pin, hal_gpio_edge_t edge, hal_gpio_isr_t isr, void *arg) {
+    static const gpio_int_type_t types[] = {
+        [HAL_GPIO_EDGE_NONE]    = GPIO_INTR_DISABLE,
+        [HAL_GPIO_EDGE_RISING]  = GPIO_INTR_POSEDGE,
+        [HAL_GPIO_EDGE_FALLING] = GPIO_INTR_NEGEDGE,
+        [HAL_GPIO_EDGE_ANY]     = GPIO_INTR_ANYEDGE,
+    };
+
+    if (!isr_service_installed) {
+        // ESP_ERR_INVALID_STATE = already installed (e.g. by button_events_init)
+        esp_err_t err = gpio_install_isr_service(ESP_INTR_FLAG_IRAM);
+        if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) return false;
+        isr_service_installed = true;
+    }
+
+    if (isr == NULL || edge == HAL_GPIO_EDGE_NONE) {
+        gpio_set_intr_type((gpio_num_t)pin, GPIO_INTR_DISABLE);
+        return gpio_isr_handler_remove((gpio_num_t)pin) == ESP_OK;
+    }
+    if (gpio_set_intr_type((gpio_num_t)pin, types[edge]) != ESP_OK) return false;
+    return gpio_isr_handler_add((gpio_num_t)pin, isr, arg) == ESP_OK;
+}
+
+// ============================================================================
+// UART
+// ============================================================================
+
+bool hal_uart_open(int port, const hal_uart_config_t *config) {
+    const uart_config_t uart_config = {
+        .baud_rate = (int)config->baud,
+        .data_bits = UART_DATA_8_BITS,
+        .parity = UART_PARITY_DISABLE,
+        .stop_bits = UART_STOP_BITS_1,
+        .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
+        .source_clk = UART_SCLK_DEFAULT,
+    };
+    if (uart_driver_install((uart_port_t)port, (int)config->rx_buffer, (int)config->tx_buffer,
+                            0, NULL, 0) != ESP_OK) {
+        return false;
+    }
+    if (uart_param_config((uart_port_t)port, &uart_config) != ESP_OK) return false;
+    return uart_set_pin((uart_port_t)port,
+                        config->tx_pin < 0 ? UART_PIN_NO_CHANGE : config->tx_pin,
+                        config->rx_pin < 0 ? UART_PIN_NO_CHANGE : config->rx_pin,
+                        UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) == ESP_OK;
+}
+
+int hal_uart_write(int port, const void *data, size_t len) {
+    return uart_write_bytes((uart_port_t)port, data, len);
+}
+
+int hal_uart_read(int port, void *buf, size_t len, uint32_t timeout_ms) {
+    return uart_read_bytes((uart_port_t)port, buf, len, pdMS_TO_TICKS(timeout_ms));
+}
+
+size_t hal_uart_available(int port) {
+    size_t len = 0;
+    uart_get_buffered_data_len((uart_port_t)port, &len);
+    return len;
+}
+
+void hal_uart_flush(int port) {
+    uart_wait_tx_done((uart_port_t)port, portMAX_DELAY);
+}
+
+// ============================================================================
+// I2C LCD (PCF8574: P0=RS P1=RW P2=EN P3=backlight P4-P7=D4-D7)
+// ============================================================================
+
+#define LCD_I2C_PORT        I2C_NUM_0
+#define LCD_I2C_HZ          100000
+#define LCD_I2C_TIMEOUT     pdMS_TO_TICKS(20)
+
+#define LCD_RS              0x01
+#define LCD_EN              0x04
+#define LCD_BL              0x08
+
+static bool i2c_ready = false;
+static uint8_t lcd_addr = 0;
+static uint8_t lcd_rows = 2;
+static uint8_t lcd_backlight = LCD_BL;
+
+static bool i2c_setup(const hal_lcd_config_t *config) {
+    if (i2c_ready) return true;
+    const i2c_config_t conf = {
+        .mode = I2C_MODE_MASTER,
+        .sda_io_num = config->sda_pin,
+        .scl_io_num = config->scl_pin,
+        .sda_pullup_en = GPIO_PULLUP_ENABLE,
+        .scl_pullup_en = GPIO_PULLUP_ENABLE,
+        .master.clk_speed = LCD_I2C_HZ,
+    };
+    if (i2c_param_config(LCD_I2C_PORT, &conf) != ESP_OK) return false;
+    if (i2c_driver_install(LCD_I2C_PORT, I2C_MODE_MASTER, 0, 0, 0) != ESP_OK) return false;
+    i2c_ready = true;
+    return true;
+}
+
+static void lcd_expander(uint8_t value) {
+    uint8_t b = value | lcd_backlight;
+    i2c_master_write_to_device(LCD_I2C_PORT, lcd_addr, &b, 1, LCD_I2C_TIMEOUT);
+}
+
+static void lcd_nibble(uint8_t nibble, uint8_t mode) {
+    uint8_t bits = (uint8_t)(nibble << 4) | mode;
+    uint8_t seq[2] = {(uint8_t)(bits | LCD_EN | lcd_backlight), (uint8_t)((bits & ~LCD_EN) | lcd_backlight)};
+    i2c_master_write_to_device(LCD_I2C_PORT, lcd_addr, seq, sizeof(seq), LCD_I2C_TIMEOUT);
+    esp_rom_delay_us(40);                       // Command execution time
+}
+
+static void lcd_send(uint8_t value, uint8_t mode) {
+    lcd_nibble(value >> 4, mode);
+    lcd_nibble(value & 0x0F, mode);
+}
+
+bool hal_lcd_probe(const hal_lcd_config_t *config, uint8_t addr) {
+    if (!i2c_setup(config)) return false;
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (uint8_t)(addr << 1) | I2C_MASTER_WRITE, true);
+    i2c_master_stop(cmd);
+    esp_err_t err = i2c_master_cmd_begin(LCD_I2C_PORT, cmd, LCD_I2C_TIMEOUT);
+    i2c_cmd_link_delete(cmd);
+    return err == ESP_OK;
+}
+
+bool hal_lcd_init(const hal_lcd_config_t *config) {
+    if (!i2c_setup(config)) return false;
+    lcd_addr = config->addr;
+    lcd_rows = config->rows;
+
+    // HD44780 4-bit init sequence (datasheet figure 24)
+    vTaskDelay(pdMS_TO_TICKS(50));
+    lcd_expander(0);
+    lcd_nibble(0x03, 0);
+    esp_rom_delay_us(4500);
+    lcd_nibble(0x03, 0);
+    esp_rom_delay_us(4500);
+    lcd_nibble(0x03, 0);
+    esp_rom_delay_us(150);
+    lcd_nibble(0x02, 0);
+
+    lcd_send(lcd_rows > 1 ? 0x28 : 0x20, 0);   // 4-bit, lines, 5x8
+    lcd_send(0x0C, 0);                          // Display on, cursor off
+    lcd_send(0x06, 0);                          // Entry mode: increment
+    hal_lcd_clear();
+    return true;
+}
+
+void hal_lcd_clear(void) {
+    lcd_send(0x01, 0);
+    esp_rom_delay_us(1600);
+}
+
+void hal_lcd_set_cursor(uint8_t col, uint8_t row) {
+    static const uint8_t row_offsets[] = {0x00, 0x40, 0x14, 0x54};
+    if (row >= lcd_rows) row = lcd_rows - 1;
+    lcd_send(0x80 | (uint8_t)(col + row_offsets[row & 3]), 0);
+}
+
+void hal_lcd_write(const char *text, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        lcd_send((uint8_t)text[i], LCD_RS);
+    }
+}
+
+void hal_lcd_backlight(bool on) {
+    lcd_backlight = on ? LCD_BL : 0;
+    lcd_expander(0);
+}
+
+// ============================================================================
+// LED STRIP (WS2812B over RMT, 10 MHz resolution)
+// ============================================================================
+
+#define LED_RMT_HZ          10000000
+#define LED_MAX_COUNT       64
+
+static rmt_channel_handle_t led_chan = NULL;
+static rmt_encoder_handle_t led_encoder = NULL;
+static uint8_t led_grb[LED_MAX_COUNT * 3];
+
+bool hal_leds_init(int pin, size_t count) {
+    if (count > LED_MAX_COUNT) return false;
+
+    const rmt_tx_channel_config_t chan_conf = {
+        .gpio_num = pin,
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = LED_RMT_HZ,
+        .mem_block_symbols = 64,
+        .trans_queue_depth = 1,
+    };
+    if (rmt_new_tx_channel(&chan_conf, &led_chan) != ESP_OK) return false;
+
+    // T0H 0.4 us / T0L 0.85 us, T1H 0.8 us / T1L 0.45 us
+    const rmt_bytes_encoder_config_t enc_conf = {
+        .bit0 = {.level0 = 1, .duration0 = 4, .level1 = 0, .duration1 = 9},
+        .bit1 = {.level0 = 1, .duration0 = 8, .level1 = 0, .duration1 = 4},
+        .flags.msb_first = 1,
+    };
+    if (rmt_new_bytes_encoder(&enc_conf, &led_encoder) != ESP_OK) return false;
+    return rmt_enable(led_chan) == ESP_OK;
+}
+
+void hal_leds_show(const uint8_t *rgb, size_t count, uint8_t brightness) {
+    if (led_chan == NULL) return;
+    if (count > LED_MAX_COUNT) count = LED_MAX_COUNT;
+
+    for (size_t i = 0; i < count; i++) {
+        led_grb[i * 3 + 0] = (uint8_t)((rgb[i * 3 + 1] * (brightness + 1)) >> 8);
+        led_grb[i * 3 + 1] = (uint8_t)((rgb[i * 3 + 0] * (brightness + 1)) >> 8);
+        led_grb[i * 3 + 2] = (uint8_t)((rgb[i * 3 + 2] * (brightness + 1)) >> 8);
+    }
+
+    const rmt_transmit_config_t tx_conf = {.loop_count = 0};
+    rmt_transmit(led_chan, led_encoder, led_grb, count * 3, &tx_conf);
+    rmt_tx_wait_all_done(led_chan, pdMS_TO_TICKS(10));
+    esp_rom_delay_us(60);                       // Latch (reset) time
+}
+
+// ============================================================================
+// NVS
+// ============================================================================
+
+bool hal_nvs_init(void) {
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        nvs_flash_erase();
+        err = nvs_flash_init();
+    }
+    return err == ESP_OK;
+}
+
+bool hal_nvs_get(const char *ns, const char *key, void *buf, size_t *len) {
+    nvs_handle_t h;
+    if (nvs_open(ns, NVS_READONLY, &h) != ESP_OK) return false;
+    esp_err_t err = nvs_get_blob(h, key, buf, len);
+    nvs_close(h);
+    return err == ESP_OK;
+}
+
+bool hal_nvs_set(const char *ns, const char *key, const void *data, size_t len) {
+    nvs_handle_t h;
+    if (nvs_open(ns, NVS_READWRITE, &h) != ESP_OK) return false;
+    esp_err_t err = nvs_set_blob(h, key, data, len);
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    return err == ESP_OK;
+}
+
+bool hal_nvs_erase(const char *ns, const char *key) {
+    nvs_handle_t h;
+    if (nvs_open(ns, NVS_READWRITE, &h) != ESP_OK) return false;
+    esp_err_t err = nvs_erase_key(h, key);
+    if (err == ESP_OK) err = nvs_commit(h);
+    nvs_close(h);
+    return err == ESP_OK || err == ESP_ERR_NVS_NOT_FOUND;
+}
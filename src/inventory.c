@@ -0,0 +1,261 @@
+/**
+ * @file inventory.c
+ * @brief Stock accounting, pre-flight check and forecast for inventory.h
+ *
+ * Draws only mark the store dirty and add up per pump; inventory_save()
+ * turns them into one write when one of the limits is reached. The check
+ * and the forecast only read.
+ */
+
+#include "inventory.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define SHORT_EPS_ML        0.001f          // Float slack when comparing volumes
+
+static int pump_index(char pump) {
+    const char *p = strchr("XYZA", pump);
+    return p && pump ? (int)(p - "XYZA") : -1;
+}
+
+static bool tracked(const inventory_reservoir_t *r) {
+    return r->capacity_ml > 0.0f;
+}
+
+static void changed(inventory_t *inv, bool now) {
+    inv->dirty = true;
+    inv->flush |= now;
+    inv->stats.draws++;
+}
+
+/** Take ml off pump p (negative: a correction back) */
+static void draw(inventory_t *inv, int p, float ml, int64_t now_us) {
+    inventory_reservoir_t *r = &inv->store.res[p];
+    if (!tracked(r) || ml == 0.0f) return;
+
+    double stock = inv->stock_ml[p] - ml;
+    if (stock < 0.0) stock = 0.0;
+    if (stock > r->capacity_ml) stock = r->capacity_ml;
+    inv->stock_ml[p] = stock;
+    r->stock_ml = (float)stock;
+    if (!inv->dirty) inv->dirty_us = now_us;
+    inv->unsaved_ml[p] += ml > 0.0f ? ml : -ml;
+    changed(inv, false);
+}
+
+void inventory_init(inventory_t *inv, const inventory_config_t *config, const inventory_store_t *stored) {
+    static const inventory_config_t defaults = INVENTORY_DEFAULT_CONFIG;
+    memset(inv, 0, sizeof(*inv));
+    inv->cfg = config ? *config : defaults;
+    if (stored && stored->version == INVENTORY_VERSION) {
+        inv->store = *stored;
+        for (int p = 0; p < INVENTORY_PUMPS; p++) {
+            inv->store.res[p].name[INVENTORY_NAME_MAX - 1] = '\0';
+            inv->stock_ml[p] = inv->store.res[p].stock_ml;
+        }
+    }
+    inv->store.version = INVENTORY_VERSION;
+}
+
+bool inventory_set_recipes(inventory_t *inv, const batch_recipe_t *recipes, uint8_t count) {
+    if (count > INVENTORY_MAX_RECIPES) return false;
+    memset(inv->demand, 0, sizeof(inv->demand));
+    memset(inv->recipe_ms, 0, sizeof(inv->recipe_ms));
+    for (uint8_t r = 0; r < count; r++) {
+        for (uint8_t s = 0; s < recipes[r].step_count; s++) {
+            const batch_step_t *st = &recipes[r].steps[s];
+            int p = pump_index(st->pump);
+            if (p < 0 || st->volume_ml <= 0.0f) continue;   // As batch_queue_plan(): pump not used
+            inv->demand[r][p] += st->volume_ml;
+            if (st->flow_ml_min > 0.0f) inv->recipe_ms[r] += (uint32_t)(st->volume_ml / st->flow_ml_min * 60000.0f);
+        }
+    }
+    inv->recipe_count = count;
+    return true;
+}
+
+bool inventory_set(inventory_t *inv, char pump, const char *name, float capacity_ml, float reserve_ml,
+                   float density_g_ml) {
+    int p = pump_index(pump);
+    if (p < 0 || capacity_ml < 0.0f || reserve_ml < 0.0f || reserve_ml > capacity_ml) return false;
+
+    inventory_reservoir_t *r = &inv->store.res[p];
+    if (name) {
+        strncpy(r->name, name, INVENTORY_NAME_MAX - 1);
+        r->name[INVENTORY_NAME_MAX - 1] = '\0';
+    }
+    r->capacity_ml = capacity_ml;
+    r->reserve_ml = reserve_ml;
+    r->density_g_ml = density_g_ml > 0.0f ? density_g_ml : 1.0f;
+    if (r->stock_ml > capacity_ml) r->stock_ml = capacity_ml;
+    inv->stock_ml[p] = r->stock_ml;
+    changed(inv, true);
+    return true;
+}
+
+bool inventory_refill(inventory_t *inv, char pump, float stock_ml) {
+    int p = pump_index(pump);
+    if (p < 0 || !tracked(&inv->store.res[p])) return false;
+
+    inventory_reservoir_t *r = &inv->store.res[p];
+    r->stock_ml = stock_ml < 0.0f || stock_ml > r->capacity_ml ? r->capacity_ml : stock_ml;
+    inv->stock_ml[p] = r->stock_ml;
+    inv->unsaved_ml[p] = 0.0f;
+    changed(inv, true);
+    return true;
+}
+
+void inventory_update(inventory_t *inv, const fluidnc_status_t *status, int64_t now_us) {
+    if (!status->has_mpos) return;
+    int axes = status->axis_count < INVENTORY_PUMPS ? status->axis_count : INVENTORY_PUMPS;
+    for (int p = 0; p < axes; p++) {
+        float delta = status->pos[p] - inv->pos[p];
+        if (inv->have_pos && delta > 0.0f) {
+            float ml = delta * inv->cfg.ml_per_mm;
+            draw(inv, p, ml, now_us);
+            if (inv->running) inv->committed[p] = inv->committed[p] > ml ? inv->committed[p] - ml : 0.0f;
+        }
+        inv->pos[p] = status->pos[p];       // Backwards (reversed pump, MPos reset): re-based, not refilled
+    }
+    inv->have_pos = true;
+}
+
+void inventory_take(inventory_t *inv, char pump, float ml, int64_t now_us) {
+    int p = pump_index(pump);
+    if (p >= 0 && ml > 0.0f) draw(inv, p, ml, now_us);
+}
+
+void inventory_weighed(inventory_t *inv, char pump, float grams, float motion_ml, int64_t now_us) {
+    int p = pump_index(pump);
+    if (p < 0 || grams < 0.0f) return;
+    float density = inv->store.res[p].density_g_ml > 0.0f ? inv->store.res[p].density_g_ml : 1.0f;
+    draw(inv, p, grams / density - motion_ml, now_us);     // What the running batch still moves is unchanged
+}
+
+void inventory_started(inventory_t *inv, const batch_plan_t *plan) {
+    inv->running = true;
+    inv->run_job = plan->job_id;
+    inv->run_batch = plan->batch;
+    for (int p = 0; p < INVENTORY_PUMPS; p++) inv->committed[p] = plan->ml[p] > 0.0f ? plan->ml[p] : 0.0f;
+}
+
+void inventory_finished(inventory_t *inv) {
+    inv->running = false;
+    memset(inv->committed, 0, sizeof(inv->committed));
+    if (inv->dirty) inv->flush = true;
+}
+
+/** Usable ml of pump p for `plan`: the running batch's commitment is replaced by its own (resumed) plan */
+static float usable(const inventory_t *inv, int p, const batch_plan_t *plan) {
+    const inventory_reservoir_t *r = &inv->store.res[p];
+    float ml = r->stock_ml - r->reserve_ml;
+    bool same = plan && inv->running && plan->job_id == inv->run_job && plan->batch == inv->run_batch;
+    if (inv->running && !same) ml -= inv->committed[p];
+    return ml;
+}
+
+const char *inventory_check(inventory_t *inv, const batch_plan_t *plan) {
+    inv->stats.checks++;
+    for (int p = 0; p < INVENTORY_PUMPS; p++) {
+        const inventory_reservoir_t *r = &inv->store.res[p];
+        if (!tracked(r) || plan->ml[p] <= 0.0f) continue;
+        float ml = usable(inv, p, plan);
+        if (plan->ml[p] > ml + SHORT_EPS_ML) {
+            snprintf(inv->why, sizeof(inv->why), "%s (pump %c) low: needs %.1f ml, %.1f ml usable",
+                     r->name[0] ? r->name : "Reservoir", "XYZA"[p], plan->ml[p], ml > 0.0f ? ml : 0.0f);
+            inv->stats.blocked++;
+            return inv->why;
+        }
+    }
+    return NULL;
+}
+
+uint8_t inventory_forecast(const inventory_t *inv, inventory_forecast_t *out) {
+    float left[INVENTORY_PUMPS];
+    uint8_t short_count = 0;
+    memset(out, 0, sizeof(*out) * INVENTORY_PUMPS);
+    for (int p = 0; p < INVENTORY_PUMPS; p++) {
+        left[p] = usable(inv, p, NULL);
+        out[p].demand_ml = inv->running ? inv->committed[p] : 0.0f;
+        if (inv->running && tracked(&inv->store.res[p]) && left[p] < -SHORT_EPS_ML) {
+            out[p].job_id = inv->run_job;       // Even the running batch is short
+            out[p].batch = inv->run_batch;
+            short_count++;
+        }
+    }
+
+    uint64_t ms = 0;            // Pumping time before the batch being looked at
+    for (uint8_t i = 0; batch_queue_job(i) != NULL; i++) {
+        const batch_job_t *job = batch_queue_job(i);
+        float per_batch[INVENTORY_PUMPS] = {0};
+        uint32_t batch_ms = 0;
+        for (uint8_t r = 0; r < job->recipe_count; r++) {
+            uint8_t id = job->recipes[r];
+            if (id >= inv->recipe_count) continue;
+            for (int p = 0; p < INVENTORY_PUMPS; p++) per_batch[p] += inv->demand[id][p];
+            batch_ms += inv->recipe_ms[id];
+        }
+        uint16_t first = job->done;
+        if (inv->running && job->id == inv->run_job && first == inv->run_batch) first++;    // Committed above
+        uint32_t count = job->batches > first ? (uint32_t)(job->batches - first) : 0;
+
+        for (int p = 0; p < INVENTORY_PUMPS; p++) {
+            inventory_forecast_t *f = &out[p];
+            if (!tracked(&inv->store.res[p])) continue;
+            f->demand_ml += per_batch[p] * count;
+            if (f->job_id != 0 || per_batch[p] <= 0.0f) {
+                if (f->job_id == 0) f->batches_ok += count;
+                continue;
+            }
+            uint32_t fit = left[p] < 0.0f ? 0 : (uint32_t)((left[p] + SHORT_EPS_ML) / per_batch[p]);
+            if (fit < count) {
+                f->job_id = job->id;
+                f->batch = (uint16_t)(first + fit);
+                f->batches_ok += fit;
+                f->empty_ms = (uint32_t)(ms + (uint64_t)fit * batch_ms);
+                short_count++;
+            } else {
+                f->batches_ok += count;
+            }
+            left[p] -= per_batch[p] * count;
+        }
+        ms += (uint64_t)count * batch_ms;
+    }
+    for (int p = 0; p < INVENTORY_PUMPS; p++) {
+        const inventory_reservoir_t *r = &inv->store.res[p];
+        out[p].left_ml = tracked(r) ? r->stock_ml - r->reserve_ml - out[p].demand_ml : 0.0f;
+    }
+    return short_count;
+}
+
+bool inventory_save(inventory_t *inv, int64_t now_us, inventory_store_t *out) {
+    if (!inv->dirty) return false;
+    bool due = inv->flush || now_us - inv->dirty_us >= (int64_t)inv->cfg.persist_ms * 1000;
+    for (int p = 0; p < INVENTORY_PUMPS && !due; p++) due = inv->unsaved_ml[p] >= inv->cfg.persist_ml;
+    if (!due) return false;
+
+    inv->store.saves++;
+    *out = inv->store;
+    inv->dirty = false;
+    inv->flush = false;
+    memset(inv->unsaved_ml, 0, sizeof(inv->unsaved_ml));
+    inv->stats.saves++;
+    return true;
+}
+
+const inventory_reservoir_t *inventory_reservoir(const inventory_t *inv, char pump) {
+    int p = pump_index(pump);
+    return p < 0 ? NULL : &inv->store.res[p];
+}
+
+float inventory_usable_ml(const inventory_t *inv, char pump) {
+    int p = pump_index(pump);
+    if (p < 0 || !tracked(&inv->store.res[p])) return 0.0f;
+    float ml = usable(inv, p, NULL);
+    return ml > 0.0f ? ml : 0.0f;
+}
+
+void inventory_get_stats(const inventory_t *inv, inventory_stats_t *out) {
+    *out = inv->stats;
+}
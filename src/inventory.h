@@ -0,0 +1,222 @@
+/**
+ * @file inventory.h
+ * @brief Reservoir stock per pump: drawn from actual motion or weight, forecast, pre-flight check
+ *
+ * Nothing knew how much was left in the reservoirs: a recipe ran until a
+ * pump was drawing air and the batch was short without anyone noticing.
+ * Each pump draws one chemical from one reservoir; here its stock is
+ * kept as it is actually dispensed:
+ *
+ * - Calibrated motion: every status report's MPos travel on a pump axis
+ *   times ml_per_mm is taken off its reservoir - batches, jogs and
+ *   priming alike, and a batch cut short only counts what ran. Only
+ *   forward travel counts (a reversed pump or an MPos reset does not
+ *   refill the stock): errors stay on the safe side.
+ * - Scale: a weighed step replaces the motion estimate for it
+ *   (inventory_weighed(), density per chemical).
+ *
+ * PRE-FLIGHT: inventory_check() is the batch queue's check() hook. It
+ * compares the plan's ml per pump (what is left of it on a resume) with
+ * the stock less the reserve (dead volume) and less what the running
+ * batch still has to draw: O(pumps), no recipe walk. The queue calls it
+ * for the next batch while the current one dispenses, so a batch that
+ * cannot complete is blocked before its first line goes out.
+ *
+ * FORECAST: inventory_forecast() walks the queued jobs with a per-recipe
+ * demand table built once by inventory_set_recipes() - O(jobs x recipes),
+ * independent of the batch count - and tells for each reservoir which
+ * batch will be the first one short, and after how much pumping.
+ *
+ * PERSISTENCE: the stock is plain data (inventory_store_t) the caller
+ * writes when inventory_save() says so. Draws are coalesced: a write at
+ * most every persist_ms or persist_ml drawn on one pump, plus one at the
+ * end of each batch and on every refill or setting change - not one per
+ * status report. A reset loses what was drawn since the last write (at
+ * most persist_ml per pump): keep reserve_ml above it.
+ *
+ * RULES:
+ * - Feed every status report to inventory_update() (positions are MPos).
+ * - Call inventory_started() / inventory_finished() from the batch
+ *   queue's started / finished hooks, and inventory_finished() when the
+ *   queue is cleared.
+ * - A reservoir with capacity 0 is not tracked: it never blocks a batch.
+ *
+ * Shared by the firmware and the host tools; does not depend on ESP-IDF.
+ *
+ * Usage:
+ *   inventory_init(&inv, NULL, stored_or_NULL);
+ *   inventory_set_recipes(&inv, recipes, recipe_count);
+ *   queue: check -> inventory_check(), started / finished -> inventory_started() / _finished()
+ *   every report:  inventory_update(&inv, &status, now_us);
+ *   loop():        if (inventory_save(&inv, now_us, &store)) write store;
+ *   after queueing: inventory_forecast(&inv, forecast) -> warn about the short reservoirs
+ *   telemetry:      telemetry_push_inventory(&tlm, p, r->stock_ml * r->density_g_ml,
+ *                                            r->capacity_ml * r->density_g_ml);
+ */
+
+#ifndef INVENTORY_H
+#define INVENTORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "batch_queue.h"
+#include "fluidnc_status.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define INVENTORY_VERSION       1           // Layout of inventory_store_t
+#define INVENTORY_PUMPS         BATCH_PLAN_PUMPS    // X Y Z A
+#define INVENTORY_NAME_MAX      16
+#define INVENTORY_MAX_RECIPES   32          // Demand table size
+
+typedef struct {
+    char name[INVENTORY_NAME_MAX];  // Chemical
+    float capacity_ml;          // 0 = not tracked
+    float stock_ml;
+    float reserve_ml;           // Dead volume: never planned below it
+    float density_g_ml;         // For scale readings
+} inventory_reservoir_t;
+
+/** Plain data: stored as one blob */
+typedef struct {
+    uint32_t version;           // INVENTORY_VERSION
+    uint32_t saves;             // Writes so far (wear)
+    inventory_reservoir_t res[INVENTORY_PUMPS];     // X Y Z A
+} inventory_store_t;
+
+typedef struct {
+    float ml_per_mm;            // Pump calibration, as the batch queue's
+    uint32_t persist_ms;        // Longest a draw stays unsaved
+    float persist_ml;           // Or this much drawn on one pump
+} inventory_config_t;
+
+#define INVENTORY_DEFAULT_CONFIG { \
+    .ml_per_mm = 0.05f, \
+    .persist_ms = 60000, \
+    .persist_ml = 10.0f, \
+}
+
+/** One reservoir against the queued batches */
+typedef struct {
+    float demand_ml;            // Queued batches (the running one: what it still draws)
+    float left_ml;              // Usable after all of them, negative = short
+    uint32_t job_id;            // First batch that cannot run (0 = none) ...
+    uint16_t batch;             // ... 0-based within the job
+    uint32_t batches_ok;        // Batches that still run before it
+    uint32_t empty_ms;          // Their pumping time (planned flows), 0 if the running batch is short
+} inventory_forecast_t;
+
+typedef struct {
+    uint32_t draws;             // Stock changes
+    uint32_t saves;             // Of them written (coalesced)
+    uint32_t checks;
+    uint32_t blocked;           // Checks that said no
+} inventory_stats_t;
+
+typedef struct {
+    inventory_config_t cfg;
+    inventory_store_t store;
+    double stock_ml[INVENTORY_PUMPS];   // Running stock; a float loses ~1e-5 ml per report at 500 ml
+
+    uint8_t recipe_count;
+    float demand[INVENTORY_MAX_RECIPES][INVENTORY_PUMPS];   // ml per batch
+    uint32_t recipe_ms[INVENTORY_MAX_RECIPES];
+
+    bool have_pos;
+    float pos[INVENTORY_PUMPS];         // Last reported MPos
+
+    bool running;
+    uint32_t run_job;
+    uint16_t run_batch;
+    float committed[INVENTORY_PUMPS];   // Still to draw by the running batch
+
+    bool dirty;
+    bool flush;                 // Save at once
+    int64_t dirty_us;           // First unsaved draw
+    float unsaved_ml[INVENTORY_PUMPS];
+    char why[64];
+    inventory_stats_t stats;
+} inventory_t;
+
+/**
+ * @brief Load the config (NULL = defaults) and a stored stock (NULL or a wrong version = nothing tracked)
+ */
+void inventory_init(inventory_t *inv, const inventory_config_t *config, const inventory_store_t *stored);
+
+/**
+ * @brief Build the per-recipe demand table used by inventory_forecast()
+ * @return false if there are more than INVENTORY_MAX_RECIPES
+ */
+bool inventory_set_recipes(inventory_t *inv, const batch_recipe_t *recipes, uint8_t count);
+
+/**
+ * @brief Set up a reservoir (stock unchanged, capped to the capacity; capacity 0 = stop tracking)
+ */
+bool inventory_set(inventory_t *inv, char pump, const char *name, float capacity_ml, float reserve_ml,
+                   float density_g_ml);
+
+/**
+ * @brief Reservoir refilled to stock_ml (negative = full)
+ */
+bool inventory_refill(inventory_t *inv, char pump, float stock_ml);
+
+/**
+ * @brief Every status report: forward MPos travel is drawn from the reservoirs
+ */
+void inventory_update(inventory_t *inv, const fluidnc_status_t *status, int64_t now_us);
+
+/**
+ * @brief Draw without a report (e.g. a manual top-up of a container)
+ */
+void inventory_take(inventory_t *inv, char pump, float ml, int64_t now_us);
+
+/**
+ * @brief A step weighed on the scale: `grams` replaces the motion_ml already drawn for it
+ */
+void inventory_weighed(inventory_t *inv, char pump, float grams, float motion_ml, int64_t now_us);
+
+/**
+ * @brief Batch queue hooks: what the batch still draws is committed until it is done
+ *
+ * inventory_finished() also ends a dropped batch (queue cleared) and saves at once.
+ */
+void inventory_started(inventory_t *inv, const batch_plan_t *plan);
+void inventory_finished(inventory_t *inv);
+
+/**
+ * @brief Pre-flight: NULL if every reservoir has the plan's ml, else why not
+ */
+const char *inventory_check(inventory_t *inv, const batch_plan_t *plan);
+
+/**
+ * @brief Each reservoir against the queued batches (out[INVENTORY_PUMPS], X Y Z A)
+ * @return Reservoirs that run short
+ */
+uint8_t inventory_forecast(const inventory_t *inv, inventory_forecast_t *out);
+
+/**
+ * @brief Copy of the stock if it is due for a write
+ * @return true if *out should be written
+ */
+bool inventory_save(inventory_t *inv, int64_t now_us, inventory_store_t *out);
+
+/**
+ * @brief Reservoir of a pump, NULL for an unknown pump
+ */
+const inventory_reservoir_t *inventory_reservoir(const inventory_t *inv, char pump);
+
+/**
+ * @brief Usable stock (stock - reserve - committed), 0 if not tracked
+ */
+float inventory_usable_ml(const inventory_t *inv, char pump);
+
+void inventory_get_stats(const inventory_t *inv, inventory_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // INVENTORY_H
@@ -0,0 +1,247 @@
+/**
+ * @file jog_stream.c
+ * @brief Encoder jogging: short "$J=" segments sized to the turning speed, 0x85 to stop
+ *
+ * See jog_stream.h for the streaming rules.
+ *
+ * The detent rate is a running average of detents over the time since the
+ * previous batch; the first batch after a rest has no previous one and
+ * is counted over velocity_ms instead. "ok" to a "$J=" arrives as soon
+ * as the jog is planned, so it bounds the serial backlog but not the
+ * motion queued ahead - that is what the position estimate is for.
+ */
+
+#include "jog_stream.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+static jog_stream_config_t cfg = JOG_STREAM_DEFAULT_CONFIG;
+
+static jog_state_t state = JOG_OFF;
+static bool ending = false;             // jog_stream_end(): OFF once stopped
+static bool cancel_pending = false;     // Reversal or error while streaming
+static bool error_latched = false;      // Until the knob rests
+static char axis = 'X';
+static int axis_index = 0;
+static int dir = 0;                     // +1 / -1 while streaming
+static int next_dir = 0;                // Direction turned while stopping
+
+static float rate = 0.0f;               // Detents / s
+static int64_t last_detent_us = 0;
+
+static uint8_t unacked = 0;
+static float sent_mm = 0.0f;            // Since the stream started
+static float stream_pos = 0.0f;         // Axis position at the stream start
+static int64_t cancel_us = 0;
+static int64_t query_us = 0;            // Last '?' while stopping
+
+// Latest report
+static bool have_pos = false;
+static float pos = 0.0f;
+static float begin_pos = 0.0f;
+static int64_t pos_us = 0;
+static fluidnc_state_t machine = FLUIDNC_STATE_UNKNOWN;
+
+static jog_stream_stats_t stats;
+
+void jog_stream_init(const jog_stream_config_t *config) {
+    static const jog_stream_config_t defaults = JOG_STREAM_DEFAULT_CONFIG;
+    cfg = config ? *config : defaults;
+    if (cfg.max_unacked == 0) cfg.max_unacked = 1;
+    if (cfg.max_ahead == 0) cfg.max_ahead = 1;
+    if (cfg.velocity_ms == 0) cfg.velocity_ms = 1;
+    if (cfg.query_ms == 0) cfg.query_ms = 1;
+    state = JOG_OFF;
+    memset(&stats, 0, sizeof(stats));
+}
+
+static int index_of(char a) {
+    switch (a) {
+        case 'X': return 0;
+        case 'Y': return 1;
+        case 'Z': return 2;
+        case 'A': return 3;
+        default:  return -1;
+    }
+}
+
+bool jog_stream_begin(char a) {
+    int i = index_of(a);
+    if (i < 0 || state == JOG_STOPPING) return false;
+    axis = a;
+    axis_index = i;
+    state = JOG_READY;
+    ending = cancel_pending = error_latched = false;
+    dir = next_dir = 0;
+    rate = 0.0f;
+    last_detent_us = 0;
+    unacked = 0;
+    have_pos = false;
+    memset(&stats, 0, sizeof(stats));
+    return true;
+}
+
+void jog_stream_end(void) {
+    ending = true;
+    if (state == JOG_READY) state = JOG_OFF;
+}
+
+void jog_stream_abort(void) {
+    state = JOG_OFF;
+    ending = cancel_pending = false;
+    unacked = 0;
+}
+
+static float feed_for_rate(float r) {
+    float feed = r * cfg.mm_per_detent * (1.0f + r / cfg.boost_detents_s) * 60.0f;
+    if (feed < cfg.min_feed_mm_min) feed = cfg.min_feed_mm_min;
+    if (feed > cfg.max_feed_mm_min) feed = cfg.max_feed_mm_min;
+    return feed;
+}
+
+static void start_stream(int d) {
+    state = JOG_STREAMING;
+    dir = d;
+    next_dir = 0;
+    sent_mm = 0.0f;
+    stream_pos = pos;
+}
+
+void jog_stream_on_detents(int32_t detents, int64_t now_us) {
+    if (state == JOG_OFF || ending || detents == 0) return;
+
+    float n = (float)(detents < 0 ? -detents : detents);
+    bool fresh = last_detent_us == 0 || now_us - last_detent_us > (int64_t)cfg.stop_ms * 1000;
+    if (fresh) {
+        rate = n * 1000.0f / (float)cfg.velocity_ms;
+    } else {
+        float dt = (float)(now_us - last_detent_us) * 1e-6f;
+        if (dt < 0.02f) dt = 0.02f;         // Batched detents: don't read a burst as infinite speed
+        rate = 0.5f * rate + 0.5f * n / dt;
+    }
+    last_detent_us = now_us;
+    stats.feed_mm_min = feed_for_rate(rate);
+
+    int d = detents > 0 ? 1 : -1;
+    if (error_latched) return;
+    switch (state) {
+        case JOG_READY:
+        case JOG_STOPPING:
+            next_dir = d;                   // Started by the next poll (once stopped)
+            break;
+        case JOG_STREAMING:
+            if (d != dir) {
+                stats.reversals++;
+                cancel_pending = true;
+                next_dir = d;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief STOPPING -> READY / OFF once every line is answered and a report
+ *        taken after the cancel shows Idle
+ */
+static void check_stopped(void) {
+    if (state != JOG_STOPPING || unacked > 0) return;
+    if (!have_pos || pos_us <= cancel_us || machine != FLUIDNC_STATE_IDLE) return;
+    stats.stop_us = (uint32_t)(pos_us - cancel_us);
+    if (stats.stop_us > stats.max_stop_us) stats.max_stop_us = stats.stop_us;
+    state = ending ? JOG_OFF : JOG_READY;
+}
+
+void jog_stream_on_status(const fluidnc_status_t *status, int64_t now_us) {
+    if (!status->has_mpos && !status->has_wpos) return;
+    if (axis_index >= status->axis_count) return;
+    pos = status->pos[axis_index];
+    pos_us = now_us;
+    machine = status->state;
+    if (!have_pos) {
+        have_pos = true;
+        begin_pos = pos;
+    }
+    stats.moved_mm = pos - begin_pos;
+    check_stopped();
+}
+
+void jog_stream_on_response(bool ok) {
+    if (unacked > 0) unacked--;
+    if (!ok) {
+        stats.errors++;
+        error_latched = true;
+        if (state == JOG_STREAMING) cancel_pending = true;
+    }
+    check_stopped();                        // The Idle report may have come first
+}
+
+/**
+ * @brief Planned but unexecuted distance, from the last report moved on at the current feed
+ */
+static float ahead_mm(int64_t now_us) {
+    float moved = (float)dir * (pos - stream_pos);
+    if (machine == FLUIDNC_STATE_JOG && now_us > pos_us) {
+        moved += stats.feed_mm_min / 60.0f * (float)(now_us - pos_us) * 1e-6f;
+    }
+    float ahead = sent_mm - moved;
+    return ahead > 0.0f ? ahead : 0.0f;
+}
+
+jog_action_t jog_stream_poll(int64_t now_us, char *line, size_t len) {
+    bool resting = now_us - last_detent_us > (int64_t)cfg.stop_ms * 1000;
+    if (resting) error_latched = false;
+
+    switch (state) {
+        case JOG_READY:
+            if (next_dir != 0 && have_pos && !resting && !error_latched && !ending) start_stream(next_dir);
+            if (state != JOG_STREAMING) return JOG_ACTION_NONE;
+            break;
+        case JOG_STREAMING:
+            break;
+        case JOG_STOPPING:
+            if (now_us - query_us < (int64_t)cfg.query_ms * 1000) return JOG_ACTION_NONE;
+            query_us = now_us;
+            return JOG_ACTION_QUERY;
+        default:
+            return JOG_ACTION_NONE;
+    }
+
+    if (cancel_pending || ending || resting) {
+        cancel_pending = false;
+        state = JOG_STOPPING;
+        cancel_us = query_us = now_us;
+        stats.cancels++;
+        return JOG_ACTION_CANCEL;
+    }
+
+    float feed = stats.feed_mm_min;
+    float seg = feed / 60.0f * (float)cfg.segment_ms * 1e-3f;
+    stats.ahead_mm = ahead_mm(now_us);
+    if (unacked >= cfg.max_unacked || stats.ahead_mm + seg > (float)cfg.max_ahead * seg + 1e-4f) {
+        return JOG_ACTION_NONE;
+    }
+    snprintf(line, len, "$J=G91 %c%.3f F%.0f", axis, (double)((float)dir * seg), (double)feed);
+    sent_mm += seg;
+    unacked++;
+    stats.segments++;
+    return JOG_ACTION_LINE;
+}
+
+bool jog_stream_busy(void) {
+    return state != JOG_OFF;
+}
+
+jog_state_t jog_stream_state(void) {
+    return state;
+}
+
+void jog_stream_get_stats(jog_stream_stats_t *out) {
+    *out = stats;
+    out->state = state;
+    out->axis = axis;
+    out->unacked = unacked;
+}
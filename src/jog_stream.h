@@ -0,0 +1,161 @@
+/**
+ * @file jog_stream.h
+ * @brief Encoder jogging: short "$J=" segments sized to the turning speed, 0x85 to stop
+ *
+ * Priming a pump from the encoder. While the knob turns, the pump runs at
+ * a feed proportional to the detent rate (faster turning also scales the
+ * distance per detent up). The motion is streamed as short incremental
+ * jogs of segment_ms each:
+ *
+ *   $J=G91 X0.250 F300
+ *
+ * and only a little of it is ever queued in FluidNC: at most max_unacked
+ * lines without "ok", and at most max_ahead segments of motion planned
+ * but not yet executed (sent distance minus the reported position,
+ * extrapolated over the report's age). When the knob stops (no detent
+ * for stop_ms) or reverses, one jog-cancel byte (0x85) flushes the
+ * planned jogs and FluidNC decelerates to Idle - no feed hold, no
+ * Ctrl-X, so no alarm and no $X.
+ *
+ * RULES:
+ * - After a cancel nothing is sent until every line has its "ok" (or
+ *   error) and a report shows Idle: a "$J=" arriving mid-deceleration
+ *   would be flushed with the rest. Auto-reports stop once nothing
+ *   changes, so poll asks for a report ('?') every query_ms meanwhile.
+ * - An error response to a jog (e.g. error:15, travel exceeded) ends the
+ *   stream; the knob has to stop before it restarts.
+ * - The caller routes every "ok" / "error" to jog_stream_on_response()
+ *   while jogging; no other lines may be in flight.
+ *
+ * Shared by the firmware and the host tools; does not depend on ESP-IDF.
+ *
+ * Usage:
+ *   jog_stream_init(NULL);
+ *   jog_stream_begin('X');                       // pump to prime
+ *   jog_stream_on_detents(n, now_us);            // encoder
+ *   jog_stream_on_status(&status, now_us);       // every report
+ *   jog_stream_on_response(ok);                  // every ok / error
+ *   switch (jog_stream_poll(now_us, line, sizeof(line))) {
+ *       case JOG_ACTION_LINE:   send line; break;
+ *       case JOG_ACTION_CANCEL: send 0x85; break;
+ *       case JOG_ACTION_QUERY:  send '?'; break;
+ *   }
+ *   jog_stream_end();                            // then poll until !jog_stream_busy()
+ */
+
+#ifndef JOG_STREAM_H
+#define JOG_STREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "fluidnc_status.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FLUIDNC_JOG_CANCEL      0x85
+
+typedef struct {
+    float mm_per_detent;        // At slow turning
+    float boost_detents_s;      // Rate at which the distance per detent has doubled
+    float min_feed_mm_min;
+    float max_feed_mm_min;      // Keep at or below the axis max rate ($11x)
+    uint32_t velocity_ms;       // Rate estimate window for the first detents
+    uint32_t segment_ms;        // Motion time carried by one "$J=" line
+    uint8_t max_unacked;        // Lines without "ok"
+    uint8_t max_ahead;          // Planned, unexecuted motion (segments)
+    uint32_t stop_ms;           // No detent for this long -> jog cancel
+    uint32_t query_ms;          // Status query interval while stopping
+} jog_stream_config_t;
+
+#define JOG_STREAM_DEFAULT_CONFIG { \
+    .mm_per_detent = 0.5f, \
+    .boost_detents_s = 20.0f, \
+    .min_feed_mm_min = 30.0f, \
+    .max_feed_mm_min = 600.0f, \
+    .velocity_ms = 200, \
+    .segment_ms = 50, \
+    .max_unacked = 2, \
+    .max_ahead = 3, \
+    .stop_ms = 200, \
+    .query_ms = 50, \
+}
+
+typedef enum {
+    JOG_OFF = 0,                // Not in jog mode
+    JOG_READY,                  // In jog mode, pump at rest
+    JOG_STREAMING,              // Sending segments
+    JOG_STOPPING,               // Cancel sent: waiting for the last "ok" and Idle
+} jog_state_t;
+
+typedef enum {
+    JOG_ACTION_NONE = 0,
+    JOG_ACTION_LINE,            // Send the line (no terminator) as G-code
+    JOG_ACTION_CANCEL,          // Send FLUIDNC_JOG_CANCEL as a realtime byte
+    JOG_ACTION_QUERY,           // Send '?' as a realtime byte
+} jog_action_t;
+
+typedef struct {
+    jog_state_t state;
+    char axis;
+    float feed_mm_min;          // Current segment feed
+    float ahead_mm;             // Planned, unexecuted (estimate)
+    uint8_t unacked;
+    uint32_t segments;
+    uint32_t cancels;
+    uint32_t reversals;
+    uint32_t errors;            // Error responses to jogs
+    float moved_mm;             // Net distance since jog_stream_begin()
+    uint32_t stop_us;           // Last cancel -> Idle report
+    uint32_t max_stop_us;
+} jog_stream_stats_t;
+
+/**
+ * @brief Load configuration (NULL = JOG_STREAM_DEFAULT_CONFIG), jog mode off
+ */
+void jog_stream_init(const jog_stream_config_t *config);
+
+/**
+ * @brief Enter jog mode for one axis ('X' 'Y' 'Z' 'A')
+ * @return false for an unknown axis or while a previous jog is stopping
+ */
+bool jog_stream_begin(char axis);
+
+/**
+ * @brief Leave jog mode: cancels any motion; poll until !jog_stream_busy()
+ */
+void jog_stream_end(void);
+
+/**
+ * @brief Drop everything without a cancel (e-stop / alarm: FluidNC is being reset)
+ */
+void jog_stream_abort(void);
+
+void jog_stream_on_detents(int32_t detents, int64_t now_us);
+void jog_stream_on_status(const fluidnc_status_t *status, int64_t now_us);
+
+/**
+ * @param ok true for "ok", false for "error:N"
+ */
+void jog_stream_on_response(bool ok);
+
+/**
+ * @brief Next thing to send, if any; call every loop (and until NONE)
+ */
+jog_action_t jog_stream_poll(int64_t now_us, char *line, size_t len);
+
+/**
+ * @brief In jog mode, or still stopping after jog_stream_end()
+ */
+bool jog_stream_busy(void);
+
+jog_state_t jog_stream_state(void);
+void jog_stream_get_stats(jog_stream_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JOG_STREAM_H
@@ -0,0 +1,106 @@
+/**
+ * @file latency_hist.c
+ * @brief Fixed-size log-linear latency histogram (p50/p99/max)
+ *
+ * See latency_hist.h for the bucket layout.
+ */
+
+#include "latency_hist.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define SUB_COUNT   (1u << LATENCY_HIST_SUB_BITS)
+
+static uint32_t bucket_index(uint32_t us) {
+    if (us < 16) {
+        return us;
+    }
+    uint32_t exp = 31 - (uint32_t)__builtin_clz(us);       // floor(log2(us)), >= 4
+    if (exp >= LATENCY_HIST_MAX_EXP) {
+        return LATENCY_HIST_BUCKETS - 1;
+    }
+    uint32_t sub = (us >> (exp - LATENCY_HIST_SUB_BITS)) & (SUB_COUNT - 1);
+    return 16 + (exp - 4) * SUB_COUNT + sub;
+}
+
+/**
+ * @brief Largest value that still lands in bucket idx
+ */
+static uint32_t bucket_upper(uint32_t idx) {
+    if (idx < 16) {
+        return idx;
+    }
+    if (idx >= LATENCY_HIST_BUCKETS - 1) {
+        return UINT32_MAX;
+    }
+    uint32_t exp = 4 + (idx - 16) / SUB_COUNT;
+    uint32_t sub = (idx - 16) % SUB_COUNT;
+    uint32_t width = 1u << (exp - LATENCY_HIST_SUB_BITS);
+    return (1u << exp) + (sub + 1) * width - 1;
+}
+
+void latency_hist_reset(latency_hist_t *h) {
+    memset(h, 0, sizeof(*h));
+    h->min = UINT32_MAX;
+}
+
+void latency_hist_add(latency_hist_t *h, uint32_t us) {
+    h->buckets[bucket_index(us)]++;
+    h->count++;
+    h->sum += us;
+    if (us < h->min) h->min = us;
+    if (us > h->max) h->max = us;
+}
+
+void latency_hist_merge(latency_hist_t *dst, const latency_hist_t *src) {
+    for (uint32_t i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        dst->buckets[i] += src->buckets[i];
+    }
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->count > 0) {
+        if (src->min < dst->min) dst->min = src->min;
+        if (src->max > dst->max) dst->max = src->max;
+    }
+}
+
+uint32_t latency_hist_percentile(const latency_hist_t *h, float pct) {
+    if (h->count == 0) {
+        return 0;
+    }
+    if (pct <= 0.0f) return h->min;
+    if (pct >= 100.0f) return h->max;
+
+    // Rank of the sample we want (1-based, rounded up)
+    uint64_t rank = (uint64_t)((double)h->count * pct / 100.0 + 0.999999);
+    if (rank == 0) rank = 1;
+
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            uint32_t v = bucket_upper(i);
+            if (v > h->max) v = h->max;
+            if (v < h->min) v = h->min;
+            return v;
+        }
+    }
+    return h->max;
+}
+
+uint32_t latency_hist_mean(const latency_hist_t *h) {
+    return h->count ? (uint32_t)(h->sum / h->count) : 0;
+}
+
+void latency_hist_print(const char *label, const latency_hist_t *h) {
+    if (h->count == 0) {
+        printf("%-16s n=0\n", label);
+        return;
+    }
+    printf("%-16s n=%-5lu p50=%7lu us  p99=%7lu us  max=%7lu us  min=%7lu us\n",
+           label, (unsigned long)h->count,
+           (unsigned long)latency_hist_percentile(h, 50.0f),
+           (unsigned long)latency_hist_percentile(h, 99.0f),
+           (unsigned long)h->max, (unsigned long)h->min);
+}
@@ -0,0 +1,76 @@
+/**
+ * @file latency_hist.h
+ * @brief Fixed-size log-linear latency histogram (p50/p99/max)
+ *
+ * Microsecond samples go into 176 buckets: exact below 16 us, then 8
+ * buckets per power of two up to ~16 s, so any percentile is within
+ * 12.5% of the true value. No heap, no locks, 720 bytes per histogram.
+ *
+ * Shared by the firmware (safety_latency.c) and the host tools; does
+ * not depend on ESP-IDF.
+ *
+ * Usage:
+ *   static latency_hist_t h;
+ *   latency_hist_reset(&h);
+ *   latency_hist_add(&h, elapsed_us);
+ *   latency_hist_percentile(&h, 99.0f);
+ */
+
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LATENCY_HIST_SUB_BITS   3       // 8 buckets per power of two
+#define LATENCY_HIST_MAX_EXP    24      // Samples >= 2^24 us (~16.7 s) go in the last bucket
+#define LATENCY_HIST_BUCKETS    (16 + (LATENCY_HIST_MAX_EXP - 4) * (1 << LATENCY_HIST_SUB_BITS))
+
+typedef struct {
+    uint32_t buckets[LATENCY_HIST_BUCKETS];
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+} latency_hist_t;
+
+/**
+ * @brief Clear all samples
+ */
+void latency_hist_reset(latency_hist_t *h);
+
+/**
+ * @brief Record one sample (microseconds)
+ */
+void latency_hist_add(latency_hist_t *h, uint32_t us);
+
+/**
+ * @brief Merge all samples of src into dst
+ */
+void latency_hist_merge(latency_hist_t *dst, const latency_hist_t *src);
+
+/**
+ * @brief Value at or below which pct percent of samples fall
+ * @param pct 0..100
+ * @return Upper edge of the matching bucket, clamped to [min, max]; 0 if empty
+ */
+uint32_t latency_hist_percentile(const latency_hist_t *h, float pct);
+
+/**
+ * @brief Arithmetic mean (0 if empty)
+ */
+uint32_t latency_hist_mean(const latency_hist_t *h);
+
+/**
+ * @brief Print "label  n=.. p50=.. p99=.. max=.." on one line
+ */
+void latency_hist_print(const char *label, const latency_hist_t *h);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LATENCY_HIST_H
@@ -0,0 +1,77 @@
+/**
+ * @file line_framer.c
+ * @brief Line assembly for line_framer.h
+ */
+
+#include "line_framer.h"
+
+static inline bool is_blank(uint8_t c) {
+    return c == ' ' || c == '\t';
+}
+
+void line_framer_init(line_framer_t *f, char *buf, size_t size, line_framer_overflow_t mode) {
+    f->buf = buf;
+    f->size = size;
+    f->overflow_mode = mode;
+    f->lines = 0;
+    f->dropped = 0;
+    f->truncated = 0;
+    line_framer_clear(f);
+}
+
+void line_framer_clear(line_framer_t *f) {
+    f->len = 0;
+    f->overlong = false;
+    f->start_us = 0;
+    if (f->size > 0) f->buf[0] = '\0';
+}
+
+bool line_framer_push(line_framer_t *f, uint8_t c, int64_t now_us, line_framer_line_t *out) {
+    if (c == '\n' || c == '\r') {
+        bool overlong = f->overlong;
+        size_t len = f->len;
+        f->len = 0;
+        f->overlong = false;
+
+        if (overlong && f->overflow_mode == LINE_FRAMER_DROP) {
+            f->dropped++;
+            return false;
+        }
+        while (len > 0 && is_blank((uint8_t)f->buf[len - 1])) len--;
+        if (len == 0) return false;         // Blank line, or the second half of CRLF
+
+        f->buf[len] = '\0';
+        if (overlong) f->truncated++;
+        f->lines++;
+        out->text = f->buf;
+        out->len = len;
+        out->start_us = f->start_us;
+        out->end_us = now_us;
+        out->truncated = overlong;
+        return true;
+    }
+
+    if (f->len == 0 && !f->overlong) {
+        if (is_blank(c)) return false;      // Leading blanks
+        f->start_us = now_us;
+    }
+    if (f->len < f->size - 1) {
+        f->buf[f->len++] = (char)c;
+    } else {
+        f->overlong = true;
+    }
+    return false;
+}
+
+size_t line_framer_feed(line_framer_t *f, const uint8_t *data, size_t len, int64_t now_us,
+                        line_framer_cb_t on_line, void *ctx) {
+    size_t lines = 0;
+    line_framer_line_t line;
+    for (size_t i = 0; i < len; i++) {
+        if (line_framer_push(f, data[i], now_us, &line)) {
+            on_line(&line, ctx);
+            lines++;
+        }
+    }
+    return lines;
+}
@@ -0,0 +1,118 @@
+/**
+ * @file line_framer.h
+ * @brief Zero-allocation line assembler for UART and console input
+ *
+ * Replaces Stream::readStringUntil('\n'), which blocks up to the stream
+ * timeout (1 s) waiting for the terminator and allocates a String per
+ * line. Bytes go in as they arrive (from the UART RX ring, one at a time
+ * or in chunks); complete lines come out with the time of their first
+ * and last byte. Nothing blocks and nothing touches the heap.
+ *
+ * RULES:
+ * - CR, LF, CRLF and LFCR all end a line; empty lines are skipped
+ * - Leading and trailing spaces / tabs are trimmed
+ * - A line longer than the buffer is dropped whole (LINE_FRAMER_DROP) or
+ *   cut to the buffer and flagged (LINE_FRAMER_TRUNCATE); either way the
+ *   rest of it up to the terminator is discarded, so the next line is clean
+ * - The line text lives in the framer's buffer: valid until the next byte
+ *
+ * Shared by the firmware (task_comms.c), the sketches and the host tools;
+ * does not depend on ESP-IDF or Arduino.
+ *
+ * Usage (sketch):
+ *   static char rxBuf[128];
+ *   static line_framer_t rx;
+ *   line_framer_init(&rx, rxBuf, sizeof(rxBuf), LINE_FRAMER_DROP);
+ *   line_framer_line_t line;
+ *   while (line_framer_read(&rx, UartSerial, esp_timer_get_time(), &line)) {
+ *       handleLine(line.text);
+ *   }
+ */
+
+#ifndef LINE_FRAMER_H
+#define LINE_FRAMER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    LINE_FRAMER_DROP = 0,           // Overlong line discarded (G-code responses: never act on half a line)
+    LINE_FRAMER_TRUNCATE,           // Overlong line delivered cut, truncated = true
+} line_framer_overflow_t;
+
+typedef struct {
+    const char *text;               // NUL-terminated, trimmed
+    size_t len;
+    int64_t start_us;               // First byte of the line
+    int64_t end_us;                 // Terminator
+    bool truncated;
+} line_framer_line_t;
+
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+    line_framer_overflow_t overflow_mode;
+    bool overlong;                  // Current line did not fit
+    int64_t start_us;
+    uint32_t lines;                 // Delivered
+    uint32_t dropped;               // Overlong, discarded
+    uint32_t truncated;             // Overlong, delivered cut
+} line_framer_t;
+
+/**
+ * @brief Bind a framer to its buffer
+ * @param buf Storage for one line plus the NUL (size >= 2)
+ * @param size Size of buf
+ */
+void line_framer_init(line_framer_t *f, char *buf, size_t size, line_framer_overflow_t mode);
+
+/**
+ * @brief Discard any partial line (after a reset of the far end, a port reopen, ...)
+ */
+void line_framer_clear(line_framer_t *f);
+
+/**
+ * @brief Add one byte
+ * @param now_us Arrival time of the byte (esp_timer_get_time(), virtual time on the host)
+ * @param out Filled when the byte completes a line
+ * @return true if out holds a line
+ */
+bool line_framer_push(line_framer_t *f, uint8_t c, int64_t now_us, line_framer_line_t *out);
+
+typedef void (*line_framer_cb_t)(const line_framer_line_t *line, void *ctx);
+
+/**
+ * @brief Add a chunk, calling on_line for every line it completes
+ * @return Number of lines delivered
+ */
+size_t line_framer_feed(line_framer_t *f, const uint8_t *data, size_t len, int64_t now_us,
+                        line_framer_cb_t on_line, void *ctx);
+
+#ifdef __cplusplus
+}
+
+/**
+ * @brief Drain what the stream already holds, stopping at the first complete line
+ *
+ * Never waits: returns false once the stream is empty and no line has
+ * completed. All bytes of one call share now_us. Works with any type that
+ * has available() and read() (HardwareSerial, the host Serial shim).
+ */
+template <typename StreamT>
+inline bool line_framer_read(line_framer_t *f, StreamT &stream, int64_t now_us, line_framer_line_t *out) {
+    while (stream.available() > 0) {
+        int c = stream.read();
+        if (c < 0) break;
+        if (line_framer_push(f, (uint8_t)c, now_us, out)) return true;
+    }
+    return false;
+}
+#endif
+
+#endif // LINE_FRAMER_H
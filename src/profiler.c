@@ -0,0 +1,204 @@
+/**
+ * @file profiler.c
+ * @brief Region, call-site and loop-period tables for profiler.h
+ */
+
+#include "profiler.h"
+
+#if PROFILER_ENABLED
+
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+    const char *name;
+    latency_hist_t hist;
+    uint32_t over;              // Passes longer than the threshold
+} region_t;
+
+typedef struct {
+    const char *what;
+    const char *func;
+    int line;
+    uint32_t calls;
+    uint32_t over;              // Calls longer than the threshold
+    uint32_t long_loops;        // Long loop iterations this call was the slowest part of
+    uint64_t total_us;
+    uint32_t max_us;
+} site_t;
+
+static region_t regions[PROFILER_MAX_REGIONS];
+static int region_count = 0;
+static site_t sites[PROFILER_MAX_SITES];
+static int site_count = 0;
+static uint32_t sites_dropped = 0;      // Calls from sites that did not fit the table
+
+static uint32_t cycles_per_us = 1;
+static uint32_t threshold_us = 5000;
+
+static latency_hist_t loop_hist;
+static uint32_t loop_last = 0;
+static bool loop_started = false;
+static uint32_t long_loops = 0;
+static uint32_t long_loops_unattributed = 0;
+static uint32_t worst_loop_us = 0;
+static int worst_loop_site = -1;
+
+// Slowest call of the current loop iteration
+static int iter_site = -1;
+static uint32_t iter_site_us = 0;
+
+static inline uint32_t to_us(uint32_t cycles) {
+    return cycles / cycles_per_us;
+}
+
+void profiler_init(uint32_t cpu_mhz, uint32_t block_threshold_us) {
+#if defined(__XTENSA__)
+    cycles_per_us = cpu_mhz > 0 ? cpu_mhz : 240;
+#else
+    (void)cpu_mhz;
+    cycles_per_us = 1000;       // profiler_cycles() counts ns on the host
+#endif
+    threshold_us = block_threshold_us;
+    region_count = 0;
+    profiler_reset();
+}
+
+int profiler_region(const char *name) {
+    for (int i = 0; i < region_count; i++) {
+        if (regions[i].name == name || strcmp(regions[i].name, name) == 0) return i;
+    }
+    if (region_count >= PROFILER_MAX_REGIONS) return -1;
+    region_t *r = &regions[region_count];
+    r->name = name;
+    latency_hist_reset(&r->hist);
+    r->over = 0;
+    return region_count++;
+}
+
+void profiler_region_add(int region, uint32_t cycles) {
+    if (region < 0 || region >= region_count) return;
+    uint32_t us = to_us(cycles);
+    latency_hist_add(&regions[region].hist, us);
+    if (us > threshold_us) regions[region].over++;
+}
+
+static int find_site(const char *what, int line) {
+    for (int i = 0; i < site_count; i++) {
+        if (sites[i].what == what && sites[i].line == line) return i;
+    }
+    if (site_count >= PROFILER_MAX_SITES) return -1;
+    memset(&sites[site_count], 0, sizeof(site_t));
+    sites[site_count].what = what;
+    sites[site_count].line = line;
+    return site_count++;
+}
+
+void profiler_call_add(const char *what, const char *func, int line, uint32_t cycles) {
+    int i = find_site(what, line);
+    if (i < 0) {
+        sites_dropped++;
+        return;
+    }
+    site_t *s = &sites[i];
+    uint32_t us = to_us(cycles);
+    s->func = func;
+    s->calls++;
+    s->total_us += us;
+    if (us > s->max_us) s->max_us = us;
+    if (us > threshold_us) s->over++;
+
+    if (us > iter_site_us) {
+        iter_site = i;
+        iter_site_us = us;
+    }
+}
+
+void profiler_loop_tick(void) {
+    uint32_t now = profiler_cycles();
+    if (loop_started) {
+        uint32_t period_us = to_us(now - loop_last);
+        latency_hist_add(&loop_hist, period_us);
+        if (period_us > threshold_us) {
+            long_loops++;
+            if (iter_site >= 0) {
+                sites[iter_site].long_loops++;
+            } else {
+                long_loops_unattributed++;
+            }
+            if (period_us > worst_loop_us) {
+                worst_loop_us = period_us;
+                worst_loop_site = iter_site;
+            }
+        }
+    }
+    loop_started = true;
+    loop_last = now;
+    iter_site = -1;
+    iter_site_us = 0;
+}
+
+void profiler_reset(void) {
+    for (int i = 0; i < region_count; i++) {
+        latency_hist_reset(&regions[i].hist);
+        regions[i].over = 0;
+    }
+    site_count = 0;
+    sites_dropped = 0;
+    latency_hist_reset(&loop_hist);
+    loop_started = false;
+    long_loops = 0;
+    long_loops_unattributed = 0;
+    worst_loop_us = 0;
+    worst_loop_site = -1;
+    iter_site = -1;
+    iter_site_us = 0;
+}
+
+void profiler_report(void) {
+    printf("\n=== Profiler (blocking threshold %lu us) ===\n", (unsigned long)threshold_us);
+
+    printf("\nRegions:\n");
+    printf("  %-16s %7s %8s %8s %8s %8s %6s\n", "name", "n", "min us", "avg us", "p99 us", "max us", ">thr");
+    for (int i = 0; i < region_count; i++) {
+        const latency_hist_t *h = &regions[i].hist;
+        printf("  %-16s %7lu %8lu %8lu %8lu %8lu %6lu\n", regions[i].name, (unsigned long)h->count,
+               (unsigned long)(h->count ? h->min : 0), (unsigned long)latency_hist_mean(h),
+               (unsigned long)latency_hist_percentile(h, 99.0f), (unsigned long)h->max,
+               (unsigned long)regions[i].over);
+    }
+
+    printf("\nCalls:\n");
+    printf("  %-32s %-28s %7s %9s %8s %6s %6s\n", "call", "caller", "n", "total ms", "max us", ">thr", "longlp");
+    for (int i = 0; i < site_count; i++) {
+        const site_t *s = &sites[i];
+        char caller[40];
+        snprintf(caller, sizeof(caller), "%s:%d", s->func ? s->func : "?", s->line);
+        printf("  %-32.32s %-28.28s %7lu %9lu %8lu %6lu %6lu\n", s->what, caller, (unsigned long)s->calls,
+               (unsigned long)(s->total_us / 1000), (unsigned long)s->max_us,
+               (unsigned long)s->over, (unsigned long)s->long_loops);
+    }
+    if (sites_dropped > 0) {
+        printf("  (%lu calls from sites beyond the %d-entry table not shown)\n",
+               (unsigned long)sites_dropped, PROFILER_MAX_SITES);
+    }
+
+    printf("\nLoop:\n  ");
+    latency_hist_print("period", &loop_hist);
+    printf("  long iterations (> %lu us): %lu, %lu with no timed call\n", (unsigned long)threshold_us,
+           (unsigned long)long_loops, (unsigned long)long_loops_unattributed);
+    if (worst_loop_us > 0) {
+        if (worst_loop_site >= 0) {
+            printf("  worst: %lu us, slowest call %s (%s:%d)\n", (unsigned long)worst_loop_us,
+                   sites[worst_loop_site].what, sites[worst_loop_site].func, sites[worst_loop_site].line);
+        } else {
+            printf("  worst: %lu us, no timed call in that iteration\n", (unsigned long)worst_loop_us);
+        }
+    }
+}
+
+#else
+
+typedef int profiler_disabled_t;        // Keep the translation unit non-empty
+
+#endif // PROFILER_ENABLED
@@ -0,0 +1,188 @@
+/**
+ * @file profiler.h
+ * @brief Loop-jitter and blocking-call profiler (cycle counter, fixed tables)
+ *
+ * Three views of where the loop's milliseconds go:
+ * - Regions: named scopes timed with the CPU cycle counter; per region
+ *   min / avg / max / p99 in a latency_hist_t (PROFILER_MAX_REGIONS slots)
+ * - Calls: suspected blocking calls (delay, flush, readStringUntil, ...)
+ *   wrapped at the call site; per site calls / total / max and how often
+ *   it exceeded the blocking threshold, with function and line
+ * - Loop: histogram of the loop period; a period over the threshold is
+ *   charged to the slowest call of that iteration
+ *
+ * Compiled in only with -D PROFILER_ENABLED=1. Otherwise every macro is
+ * empty or the bare call and the functions are inline no-ops, so the
+ * instrumentation can stay in the source.
+ *
+ * Single context: record from one task (the Arduino loop). No heap.
+ *
+ * Usage (C++ sketch):
+ *   profiler_init(getCpuFrequencyMhz(), 5000);
+ *   void loop() {
+ *       profiler_loop_tick();
+ *       { PROF_SCOPE("uart_rx"); ... }
+ *       String line = PROF_CALL(UartSerial.readStringUntil('\n'));
+ *       PROF_CALL(delay(10));
+ *   }
+ *   profiler_report();      // console dump
+ *
+ * Shared by the firmware and the host sketches; does not depend on ESP-IDF.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef PROFILER_ENABLED
+#define PROFILER_ENABLED 0
+#endif
+
+#define PROFILER_MAX_REGIONS    8
+#define PROFILER_MAX_SITES      16
+
+#if PROFILER_ENABLED
+#include "latency_hist.h"
+#if !defined(__XTENSA__)
+#include <time.h>
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if PROFILER_ENABLED
+
+/**
+ * @brief Free-running counter: CPU cycles on the ESP32, nanoseconds on the host
+ *
+ * Wraps every 17.9 s at 240 MHz; differences are valid below that.
+ */
+static inline uint32_t profiler_cycles(void) {
+#if defined(__XTENSA__)
+    uint32_t ccount;
+    __asm__ __volatile__("rsr %0, ccount" : "=a"(ccount));
+    return ccount;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec);
+#endif
+}
+
+/**
+ * @brief Clear all tables and set the clock and threshold
+ * @param cpu_mhz CPU clock (getCpuFrequencyMhz()); ignored on the host
+ * @param block_threshold_us A call or loop period longer than this is "blocking"
+ */
+void profiler_init(uint32_t cpu_mhz, uint32_t block_threshold_us);
+
+/**
+ * @brief Slot for a named region (registered on first use)
+ * @param name String literal; compared by pointer first, then by text
+ * @return Slot index, or -1 if the table is full
+ */
+int profiler_region(const char *name);
+
+/**
+ * @brief Add one timed pass through a region
+ */
+void profiler_region_add(int region, uint32_t cycles);
+
+/**
+ * @brief Add one timed call at a call site
+ * @param what Call text (the PROF_CALL argument)
+ * @param func Caller (__func__)
+ * @param line Caller line
+ */
+void profiler_call_add(const char *what, const char *func, int line, uint32_t cycles);
+
+/**
+ * @brief Mark the start of a loop iteration (records the previous period)
+ */
+void profiler_loop_tick(void);
+
+/**
+ * @brief Print regions, call sites and the loop histogram
+ */
+void profiler_report(void);
+
+/**
+ * @brief Clear the figures, keep the registered regions and settings
+ */
+void profiler_reset(void);
+
+#define PROF_CONCAT_(a, b) a##b
+#define PROF_CONCAT(a, b) PROF_CONCAT_(a, b)
+
+/**
+ * @brief Time from here to PROF_END(var) as region `name` (C)
+ */
+#define PROF_BEGIN(var, name)                                               \
+    static int PROF_CONCAT(var, _region) = -2;                              \
+    if (PROF_CONCAT(var, _region) == -2) PROF_CONCAT(var, _region) = profiler_region(name); \
+    uint32_t PROF_CONCAT(var, _t0) = profiler_cycles()
+#define PROF_END(var) \
+    profiler_region_add(PROF_CONCAT(var, _region), profiler_cycles() - PROF_CONCAT(var, _t0))
+
+#else // !PROFILER_ENABLED
+
+static inline void profiler_init(uint32_t cpu_mhz, uint32_t block_threshold_us) {
+    (void)cpu_mhz;
+    (void)block_threshold_us;
+}
+static inline void profiler_loop_tick(void) {}
+static inline void profiler_report(void) {}
+static inline void profiler_reset(void) {}
+
+#define PROF_BEGIN(var, name) do {} while (0)
+#define PROF_END(var) do {} while (0)
+
+#endif // PROFILER_ENABLED
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef __cplusplus
+#if PROFILER_ENABLED
+
+// Times the enclosing scope as one region
+class ProfScope {
+public:
+    explicit ProfScope(int region) : region_(region), start_(profiler_cycles()) {}
+    ~ProfScope() { profiler_region_add(region_, profiler_cycles() - start_); }
+private:
+    int region_;
+    uint32_t start_;
+};
+
+// Runs fn, records its duration against the call site, returns its result
+template <typename Fn>
+inline auto profiler_watch(const char *what, const char *func, int line, Fn fn) -> decltype(fn()) {
+    struct Timer {
+        const char *what, *func;
+        int line;
+        uint32_t start;
+        ~Timer() { profiler_call_add(what, func, line, profiler_cycles() - start); }
+    } timer{what, func, line, profiler_cycles()};
+    return fn();
+}
+
+#define PROF_SCOPE(name)                                                    \
+    static const int PROF_CONCAT(prof_region_, __LINE__) = profiler_region(name); \
+    ProfScope PROF_CONCAT(prof_scope_, __LINE__)(PROF_CONCAT(prof_region_, __LINE__))
+#define PROF_CALL(expr) profiler_watch(#expr, __func__, __LINE__, [&]() { return expr; })
+
+#else
+
+#define PROF_SCOPE(name) do {} while (0)
+#define PROF_CALL(expr) (expr)
+
+#endif // PROFILER_ENABLED
+#endif // __cplusplus
+
+#endif // PROFILER_H
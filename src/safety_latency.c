@@ -0,0 +1,182 @@
+/**
+ * @file safety_latency.c
+ * @brief Microsecond timeline of every e-stop, with p50/p99/max histograms
+ *
+ * See safety_latency.h for the stage definitions.
+ */
+
+#include "safety_latency.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "fluidnc_status.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_attr.h"
+#else
+#define IRAM_ATTR
+#endif
+
+static const char *const stage_names[SAFETY_STAGE_COUNT] = {
+    [SAFETY_STAGE_EDGE]    = "EDGE",
+    [SAFETY_STAGE_ISR]     = "ISR",
+    [SAFETY_STAGE_WIRE]    = "WIRE",
+    [SAFETY_STAGE_HOLD]    = "HOLD",
+    [SAFETY_STAGE_STOPPED] = "STOPPED",
+};
+
+// Current trace - stamped from the ISR, committed from task context
+static volatile int64_t trace_us[SAFETY_STAGE_COUNT];
+static volatile bool trace_open = false;
+
+// Previous status report of the current trace, for the MPos-unchanged test
+static fluidnc_status_t prev_status;
+static int64_t prev_status_us = 0;
+static bool have_prev = false;
+
+static latency_hist_t hists[SAFETY_STAGE_COUNT];
+static uint32_t traces_committed = 0;
+static uint32_t traces_incomplete = 0;     // Replaced before reaching STOPPED
+static bool hists_ready = false;
+
+static void ensure_init(void) {
+    if (!hists_ready) {
+        for (int i = 0; i < SAFETY_STAGE_COUNT; i++) {
+            latency_hist_reset(&hists[i]);
+        }
+        hists_ready = true;
+    }
+}
+
+/**
+ * @brief Move the open trace into the histograms
+ */
+static void commit_trace(void) {
+    if (!trace_open) return;
+    trace_open = false;
+    ensure_init();
+
+    int64_t edge = trace_us[SAFETY_STAGE_EDGE];
+    for (int s = SAFETY_STAGE_EDGE + 1; s < SAFETY_STAGE_COUNT; s++) {
+        int64_t t = trace_us[s];
+        if (t != 0 && t >= edge) {
+            int64_t d = t - edge;
+            latency_hist_add(&hists[s], d > UINT32_MAX ? UINT32_MAX : (uint32_t)d);
+        }
+    }
+    traces_committed++;
+}
+
+void IRAM_ATTR safety_latency_begin(int64_t edge_us) {
+    // Histograms are not touched from here; an unfinished trace is only counted
+    if (trace_open) {
+        trace_open = false;
+        traces_incomplete++;
+    }
+    for (int s = 0; s < SAFETY_STAGE_COUNT; s++) {
+        trace_us[s] = 0;
+    }
+    trace_us[SAFETY_STAGE_EDGE] = edge_us;
+    have_prev = false;
+    trace_open = true;
+}
+
+void IRAM_ATTR safety_latency_mark(safety_stage_t stage, int64_t t_us) {
+    if (!trace_open || stage >= SAFETY_STAGE_COUNT) return;
+    if (trace_us[stage] == 0) {
+        trace_us[stage] = t_us;
+    }
+}
+
+bool safety_latency_on_status(const char *line, int64_t now_us) {
+    if (!trace_open) return false;
+
+    fluidnc_status_t st;
+    if (!fluidnc_status_parse(line, &st)) return false;
+
+    if (st.state == FLUIDNC_STATE_HOLD || st.state == FLUIDNC_STATE_ALARM) {
+        safety_latency_mark(SAFETY_STAGE_HOLD, now_us);
+    }
+
+    // Hold:0 = deceleration done; Idle = nothing was moving; Alarm = motion killed
+    int64_t stopped_us = 0;
+    if ((st.state == FLUIDNC_STATE_HOLD && st.substate == 0) ||
+        st.state == FLUIDNC_STATE_IDLE || st.state == FLUIDNC_STATE_ALARM) {
+        stopped_us = now_us;
+    }
+    bool prev_moving = prev_status.state == FLUIDNC_STATE_RUN || prev_status.state == FLUIDNC_STATE_JOG;
+    bool moving = st.state == FLUIDNC_STATE_RUN || st.state == FLUIDNC_STATE_JOG;
+    if (have_prev && !prev_moving && !moving &&
+        fluidnc_status_same_position(&prev_status, &st, SAFETY_STOPPED_TOL_MM)) {
+        // Already stopped when the earlier report was generated
+        if (stopped_us == 0 || prev_status_us < stopped_us) {
+            stopped_us = prev_status_us;
+        }
+    }
+
+    prev_status = st;
+    prev_status_us = now_us;
+    have_prev = st.axis_count > 0;
+
+    if (stopped_us != 0) {
+        safety_latency_mark(SAFETY_STAGE_STOPPED, stopped_us);
+        commit_trace();
+        return true;
+    }
+    return false;
+}
+
+bool safety_latency_active(void) {
+    return trace_open;
+}
+
+void safety_latency_last_trace(int64_t out_us[SAFETY_STAGE_COUNT]) {
+    for (int s = 0; s < SAFETY_STAGE_COUNT; s++) {
+        out_us[s] = trace_us[s];
+    }
+}
+
+const latency_hist_t *safety_latency_hist(safety_stage_t stage) {
+    ensure_init();
+    return stage < SAFETY_STAGE_COUNT ? &hists[stage] : NULL;
+}
+
+void safety_latency_reset(void) {
+    trace_open = false;
+    for (int s = 0; s < SAFETY_STAGE_COUNT; s++) {
+        trace_us[s] = 0;
+        latency_hist_reset(&hists[s]);
+    }
+    hists_ready = true;
+    have_prev = false;
+    traces_committed = 0;
+    traces_incomplete = 0;
+}
+
+void safety_latency_report(void) {
+    ensure_init();
+
+    printf("\n=== SAFETY LATENCY (us from STOP edge) ===\n");
+    printf("Last trace:%s\n", trace_open ? " (open)" : "");
+    int64_t edge = trace_us[SAFETY_STAGE_EDGE];
+    for (int s = SAFETY_STAGE_EDGE + 1; s < SAFETY_STAGE_COUNT; s++) {
+        if (edge != 0 && trace_us[s] != 0) {
+            printf("  %-8s +%lld\n", stage_names[s], (long long)(trace_us[s] - edge));
+        } else {
+            printf("  %-8s -\n", stage_names[s]);
+        }
+    }
+    printf("Histograms (%lu completed traces, %lu incomplete):\n",
+           (unsigned long)traces_committed, (unsigned long)traces_incomplete);
+    for (int s = SAFETY_STAGE_EDGE + 1; s < SAFETY_STAGE_COUNT; s++) {
+        char label[24];
+        snprintf(label, sizeof(label), "  EDGE->%s", stage_names[s]);
+        latency_hist_print(label, &hists[s]);
+    }
+    printf("==========================================\n");
+}
+
+const char *safety_stage_name(safety_stage_t stage) {
+    return stage < SAFETY_STAGE_COUNT ? stage_names[stage] : "?";
+}
@@ -0,0 +1,96 @@
+/**
+ * @file safety_latency.h
+ * @brief Microsecond timeline of every e-stop, with p50/p99/max histograms
+ *
+ * Each e-stop is one trace. Stages are stamped with the same microsecond
+ * clock (esp_timer on target, virtual time on the host):
+ *
+ *   EDGE     STOP edge seen (first instruction of the GPIO ISR)
+ *   ISR      '!' written into the UART TX FIFO
+ *   WIRE     Last bit of '!' left the pin (FIFO backlog + 1 byte at the baud rate)
+ *   HOLD     First <Hold or <Alarm status received
+ *   STOPPED  Motion confirmed stopped: Hold:0, Idle or Alarm, or MPos
+ *            unchanged between two consecutive reports (stamped at the
+ *            first of the pair)
+ *
+ * When a trace completes (STOPPED stamped) the EDGE->stage interval of
+ * every stamped stage goes into that stage's latency_hist_t. safety_latency_report() prints them.
+ *
+ * One trace is in flight at a time. begin/mark are ISR-safe; the
+ * status/report functions run in task context.
+ */
+
+#ifndef SAFETY_LATENCY_H
+#define SAFETY_LATENCY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "latency_hist.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SAFETY_STOPPED_TOL_MM   0.001f  // MPos "unchanged" tolerance
+
+typedef enum {
+    SAFETY_STAGE_EDGE = 0,
+    SAFETY_STAGE_ISR,
+    SAFETY_STAGE_WIRE,
+    SAFETY_STAGE_HOLD,
+    SAFETY_STAGE_STOPPED,
+    SAFETY_STAGE_COUNT
+} safety_stage_t;
+
+/**
+ * @brief Start a new trace (a previous trace that never reached STOPPED is counted as incomplete)
+ * @param edge_us Time of the triggering edge
+ */
+void safety_latency_begin(int64_t edge_us);
+
+/**
+ * @brief Stamp a stage of the current trace; the first stamp of a stage wins
+ */
+void safety_latency_mark(safety_stage_t stage, int64_t t_us);
+
+/**
+ * @brief Feed every status line received while a trace is open
+ * @return true if this line completed the trace (STOPPED stamped)
+ */
+bool safety_latency_on_status(const char *line, int64_t now_us);
+
+/**
+ * @brief True while a trace is open
+ */
+bool safety_latency_active(void);
+
+/**
+ * @brief Stamps of the current (or last) trace; 0 = not reached
+ */
+void safety_latency_last_trace(int64_t out_us[SAFETY_STAGE_COUNT]);
+
+/**
+ * @brief EDGE->stage histogram (stage > EDGE)
+ */
+const latency_hist_t *safety_latency_hist(safety_stage_t stage);
+
+/**
+ * @brief Clear all histograms and the current trace
+ */
+void safety_latency_reset(void);
+
+/**
+ * @brief Print the last trace and the p50/p99/max table to the console
+ */
+void safety_latency_report(void);
+
+/**
+ * @brief Stage name for logging ("EDGE", "ISR", ...)
+ */
+const char *safety_stage_name(safety_stage_t stage);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SAFETY_LATENCY_H
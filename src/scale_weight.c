@@ -0,0 +1,33 @@
+/**
+ * @file scale_weight.c
+ * @brief Weight from a scale response line
+ */
+
+#include "scale_weight.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+
+bool scale_weight_parse(const char *line, float *grams, char *unit, size_t unit_len) {
+    const char *p = line;
+    while (*p && !(*p == '+' || *p == '-' || *p == '.' || (*p >= '0' && *p <= '9'))) {
+        p++;
+    }
+    if (*p == '\0') return false;
+
+    char *end;
+    float value = strtof(p, &end);
+    if (end == p) return false;
+    *grams = value;
+
+    if (unit != NULL && unit_len > 0) {
+        while (*end == ' ') end++;
+        size_t n = 0;
+        while (n + 1 < unit_len && (isalpha((unsigned char)end[n]) || end[n] == '%')) {
+            unit[n] = end[n];
+            n++;
+        }
+        unit[n] = '\0';
+    }
+    return true;
+}
@@ -0,0 +1,54 @@
+/**
+ * @file scale_weight.h
+ * @brief Weight from a scale response line ("  +012.34 g", "ST,GS,-0.50kg")
+ *
+ * The first signed decimal number in the line is the weight; the letters
+ * right after it (spaces skipped) are the unit. Same rule as
+ * docs/reference/readscale.py, without String copies.
+ *
+ * The scale only answers a burst of commands typed a character at a
+ * time (test_06), so a reading takes SCALE_READING_MS - about 1.4 s, not
+ * the gap between bursts. Anything that works on readings (flow_control.h,
+ * the batch simulator) is sized from it.
+ *
+ * Shared by the firmware (task_scale.c), test_15, the benchmark sketch
+ * and the host tools; does not depend on ESP-IDF.
+ */
+
+#ifndef SCALE_WEIGHT_H
+#define SCALE_WEIGHT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Burst protocol (see test_15_scale_integration.cpp)
+#define SCALE_BURST_CMD         "@P<CR><LF>"    // Literal text, not control chars
+#define SCALE_REPEATS_PER_BURST 13
+#define SCALE_CHAR_DELAY_MS     7
+#define SCALE_LINE_DELAY_MS     9
+#define SCALE_READ_WINDOW_MS    160
+#define SCALE_GAP_MS            200             // Between a read window and the next burst
+
+#define SCALE_BURST_MS  (SCALE_REPEATS_PER_BURST * \
+                         ((sizeof(SCALE_BURST_CMD) - 1) * SCALE_CHAR_DELAY_MS + SCALE_LINE_DELAY_MS))
+#define SCALE_READING_MS (SCALE_BURST_MS + SCALE_READ_WINDOW_MS + SCALE_GAP_MS)    // 1387 ms
+
+/**
+ * @brief Parse the weight (and optionally the unit) from one line
+ * @param line NUL-terminated line, CR / LF optional
+ * @param grams Parsed value (in the scale's unit; not converted)
+ * @param unit Receives the unit text, may be NULL
+ * @param unit_len Size of unit (including the NUL)
+ * @return false if the line holds no number
+ */
+bool scale_weight_parse(const char *line, float *grams, char *unit, size_t unit_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SCALE_WEIGHT_H
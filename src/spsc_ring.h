@@ -0,0 +1,104 @@
+/**
+ * @file spsc_ring.h
+ * @brief Bounded lock-free single-producer / single-consumer ring buffer
+ *
+ * Fixed-size element ring used to hand events between an ISR or timer
+ * callback (producer) and the main loop or a task (consumer) without
+ * locks, heap allocation or blocking.
+ *
+ * RULES:
+ * - Exactly one context may push and exactly one context may pop
+ * - Capacity must be a power of two; storage is supplied by the caller
+ * - push/pop are IRAM-safe (no flash access, no OS calls)
+ *
+ * Usage:
+ *   static my_event_t storage[16];
+ *   static spsc_ring_t ring;
+ *   spsc_ring_init(&ring, storage, sizeof(my_event_t), 16);
+ *   spsc_ring_push(&ring, &ev);      // producer
+ *   spsc_ring_pop(&ring, &ev);       // consumer
+ */
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint8_t *storage;        // capacity * elem_size bytes, caller-owned
+    uint32_t elem_size;      // Size of one element in bytes
+    uint32_t mask;           // capacity - 1 (capacity is a power of two)
+    uint32_t head;           // Next slot to write (producer-owned)
+    uint32_t tail;           // Next slot to read (consumer-owned)
+    uint32_t dropped;        // Pushes rejected because the ring was full
+} spsc_ring_t;
+
+/**
+ * @brief Initialize a ring over caller-supplied storage
+ * @param capacity Number of elements; must be a power of two
+ * @return false if capacity is not a power of two
+ */
+static inline bool spsc_ring_init(spsc_ring_t *ring, void *storage,
+                                  uint32_t elem_size, uint32_t capacity) {
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0) {
+        return false;
+    }
+    ring->storage = (uint8_t *)storage;
+    ring->elem_size = elem_size;
+    ring->mask = capacity - 1;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->dropped = 0;
+    return true;
+}
+
+/**
+ * @brief Push one element (producer side)
+ * @return false if the ring is full (element dropped and counted)
+ */
+static inline bool spsc_ring_push(spsc_ring_t *ring, const void *elem) {
+    uint32_t head = ring->head;
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    if (head - tail > ring->mask) {
+        ring->dropped++;
+        return false;
+    }
+    memcpy(ring->storage + (head & ring->mask) * ring->elem_size, elem, ring->elem_size);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * @brief Pop one element (consumer side)
+ * @return false if the ring is empty
+ */
+static inline bool spsc_ring_pop(spsc_ring_t *ring, void *elem) {
+    uint32_t tail = ring->tail;
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+        return false;
+    }
+    memcpy(elem, ring->storage + (tail & ring->mask) * ring->elem_size, ring->elem_size);
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * @brief Number of elements currently queued (approximate from either side)
+ */
+static inline uint32_t spsc_ring_count(const spsc_ring_t *ring) {
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) -
+           __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SPSC_RING_H
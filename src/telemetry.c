@@ -0,0 +1,594 @@
+/**
+ * @file telemetry.c
+ * @brief Queues, outbox replay, batching and JSON encoding for telemetry.h
+ */
+
+#include "telemetry.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+#define QUEUE_MASK      (TELEMETRY_QUEUE - 1)
+#define ACK_MASK        (TELEMETRY_ACKS - 1)
+#define STATUS_MASK     (TELEMETRY_STATUS_RING - 1)
+#define CLOCK_SET_MS    1577836800000LL     // 2020-01-01: anything earlier is an unset clock
+
+_Static_assert(sizeof(telemetry_sample_t) == TLM_STORE_SAMPLE_SIZE, "sample must fill an outbox slot");
+_Static_assert((TELEMETRY_QUEUE & QUEUE_MASK) == 0, "TELEMETRY_QUEUE must be a power of two");
+_Static_assert((TELEMETRY_ACKS & ACK_MASK) == 0, "TELEMETRY_ACKS must be a power of two");
+_Static_assert((TELEMETRY_STATUS_RING & STATUS_MASK) == 0, "TELEMETRY_STATUS_RING must be a power of two");
+_Static_assert(TLM_CODEC_HEADER_SIZE + TELEMETRY_STATUS_RING * TLM_CODEC_RECORD_MAX <= TELEMETRY_PAYLOAD_MAX,
+               "a full status ring must fit one frame");
+
+static const char *const topic_paths[TELEMETRY_TOPICS] = {
+    "dosing/consumption",
+    "batch/events",
+    "inventory/levels",
+    "dosing/accuracy",
+};
+
+static const char *const batch_events[] = {"start", "complete", "abort"};
+
+// ============================================================================
+// INIT / PUSH (any task)
+// ============================================================================
+
+void telemetry_init(telemetry_t *t, const telemetry_config_t *cfg, const telemetry_transport_t *io,
+                    const char *store_label) {
+    portMUX_TYPE unlocked = portMUX_INITIALIZER_UNLOCKED;
+    memset(t, 0, sizeof(*t));
+    t->mux = unlocked;
+    t->cfg = *cfg;
+    t->io = *io;
+    t->oldest_pending_ms = -1;
+    for (int i = 0; i < TELEMETRY_TOPICS; i++) {
+        snprintf(t->topics[i], sizeof(t->topics[i]), "%s/%s", cfg->topic_prefix, topic_paths[i]);
+    }
+    snprintf(t->status_topic, sizeof(t->status_topic), "%s/status/%s", cfg->topic_prefix, cfg->device_id);
+
+    t->have_store = store_label != NULL && tlm_store_init(&t->store, store_label);
+    if (t->have_store) {
+        // Continue the numbering after the newest stored sample
+        telemetry_sample_t last;
+        if (t->store.head_pos > t->store.tail_pos && tlm_store_read(&t->store, t->store.head_pos - 1, &last)) {
+            t->next_seq = last.seq + 1;
+        }
+        t->send_pos = t->store.tail_pos;
+        t->max_sent_pos = t->store.tail_pos;
+    }
+}
+
+static int64_t clock_now(const telemetry_t *t) {
+    int64_t ms = t->cfg.clock_ms ? t->cfg.clock_ms() : 0;
+    return ms >= CLOCK_SET_MS ? ms : 0;
+}
+
+static bool push_high(telemetry_t *t, telemetry_sample_t *s) {
+    s->time_ms = clock_now(t);
+    bool ok = false;
+    portENTER_CRITICAL(&t->mux);
+    if (t->queue_head - t->queue_tail >= TELEMETRY_QUEUE) {
+        t->stats.dropped_queue++;               // Drop newest: the queue keeps its order
+    } else {
+        s->seq = t->next_seq++;
+        t->queue[t->queue_head & QUEUE_MASK] = *s;
+        t->queue_head++;
+        t->stats.pushed++;
+        ok = true;
+    }
+    portEXIT_CRITICAL(&t->mux);
+    return ok;
+}
+
+bool telemetry_push_dose(telemetry_t *t, uint8_t pump, uint8_t recipe, float target_g, float actual_g,
+                         uint32_t duration_ms) {
+    telemetry_sample_t s;
+    memset(&s, 0, sizeof(s));
+    s.topic = TELEMETRY_DOSE;
+    s.pump = pump;
+    s.recipe = recipe;
+    s.a = target_g;
+    s.b = actual_g;
+    s.duration_ms = duration_ms;
+    return push_high(t, &s);
+}
+
+bool telemetry_push_batch(telemetry_t *t, telemetry_batch_event_t event, uint8_t recipe, uint8_t pumps) {
+    telemetry_sample_t s;
+    memset(&s, 0, sizeof(s));
+    s.topic = TELEMETRY_BATCH;
+    s.event = (uint8_t)event;
+    s.recipe = recipe;
+    s.pump = pumps;
+    return push_high(t, &s);
+}
+
+void telemetry_push_inventory(telemetry_t *t, uint8_t pump, float remaining_g, float capacity_g) {
+    if (pump >= TELEMETRY_PUMPS) return;
+    telemetry_sample_t s;
+    memset(&s, 0, sizeof(s));
+    s.topic = TELEMETRY_INVENTORY;
+    s.pump = pump;
+    s.a = remaining_g;
+    s.b = capacity_g;
+    s.time_ms = clock_now(t);
+
+    portENTER_CRITICAL(&t->mux);
+    if (t->latest_valid & (1u << pump)) t->stats.coalesced++;     // Latest value wins
+    s.seq = ++t->inventory_gen;
+    t->latest[pump] = s;
+    t->latest_valid |= (uint8_t)(1u << pump);
+    portEXIT_CRITICAL(&t->mux);
+}
+
+void telemetry_push_accuracy(telemetry_t *t, uint8_t pump, const telemetry_accuracy_t *acc) {
+    if (pump >= TELEMETRY_PUMPS) return;
+    int64_t now = clock_now(t);
+    portENTER_CRITICAL(&t->mux);
+    if (t->accuracy_valid & (1u << pump)) t->stats.coalesced++;   // Latest value wins
+    t->accuracy[pump] = *acc;
+    t->accuracy_ms[pump] = now;
+    t->accuracy_seq[pump]++;
+    t->accuracy_valid |= (uint8_t)(1u << pump);
+    portEXIT_CRITICAL(&t->mux);
+}
+
+void telemetry_push_status(telemetry_t *t, const tlm_status_t *s) {
+    portENTER_CRITICAL(&t->mux);
+    if (t->status_head - t->status_tail >= TELEMETRY_STATUS_RING) {
+        t->status_tail++;                       // Drop oldest: a live stream wants the newest
+        t->stats.status_dropped++;
+    }
+    t->status[t->status_head & STATUS_MASK] = *s;
+    t->status_head++;
+    t->stats.status_samples++;
+    portEXIT_CRITICAL(&t->mux);
+}
+
+void telemetry_on_ack(telemetry_t *t, int msg_id) {
+    portENTER_CRITICAL(&t->mux);
+    if (t->ack_head - t->ack_tail < TELEMETRY_ACKS) {
+        t->acks[t->ack_head & ACK_MASK] = msg_id;
+        t->ack_head++;
+    }                                           // Lost ack: the message is resent, seq de-duplicates
+    portEXIT_CRITICAL(&t->mux);
+}
+
+// ============================================================================
+// JSON
+// ============================================================================
+
+/**
+ * @brief Append text to buf at *len; false (and *len unchanged) if it does not fit
+ */
+__attribute__((format(printf, 4, 5))) static bool put(char *buf, size_t size, size_t *len, const char *fmt, ...) {
+    if (*len >= size) return false;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf + *len, size - *len, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= size - *len) return false;
+    *len += (size_t)n;
+    return true;
+}
+
+/**
+ * @brief Name for a JSON string: quotes, backslashes and control characters dropped
+ */
+static const char *json_name(const char *name, char *out, size_t size) {
+    size_t n = 0;
+    for (const char *p = name ? name : ""; *p && n < size - 1; p++) {
+        if (*p == '"' || *p == '\\' || (unsigned char)*p < 0x20) continue;
+        out[n++] = *p;
+    }
+    out[n] = '\0';
+    return out;
+}
+
+static const char *recipe_name(const telemetry_t *t, uint8_t recipe) {
+    if (t->cfg.recipes != NULL && recipe < t->cfg.recipe_count) return t->cfg.recipes[recipe];
+    return recipe == 0 ? "manual" : "?";
+}
+
+static const char *chemical_name(const telemetry_t *t, uint8_t pump) {
+    return pump < TELEMETRY_PUMPS && t->cfg.chemicals[pump] ? t->cfg.chemicals[pump] : "?";
+}
+
+static bool encode_sample(const telemetry_t *t, const telemetry_sample_t *s, char *buf, size_t size, size_t *len) {
+    char device[32];
+    char name[48];
+    bool ok = put(buf, size, len, "{");
+    if (s->time_ms > 0) {
+        ok = ok && put(buf, size, len, "\"timestamp\":%lld.%03d,", (long long)(s->time_ms / 1000),
+                       (int)(s->time_ms % 1000));
+    }
+    ok = ok && put(buf, size, len, "\"device_id\":\"%s\",", json_name(t->cfg.device_id, device, sizeof(device)));
+    if (s->topic != TELEMETRY_INVENTORY) ok = ok && put(buf, size, len, "\"seq\":%lu,", (unsigned long)s->seq);
+
+    switch (s->topic) {
+        case TELEMETRY_DOSE:
+            ok = ok && put(buf, size, len, "\"pump\":%u,\"chemical\":\"%s\",", (unsigned)s->pump + 1,
+                           json_name(chemical_name(t, s->pump), name, sizeof(name)));
+            ok = ok && put(buf, size, len, "\"target_g\":%.2f,\"actual_g\":%.2f,\"error_g\":%.2f,",
+                           (double)s->a, (double)s->b, (double)(s->b - s->a));
+            ok = ok && put(buf, size, len, "\"recipe\":\"%s\",\"mode\":\"%s\",\"duration_ms\":%lu}",
+                           json_name(recipe_name(t, s->recipe), name, sizeof(name)),
+                           s->recipe == 0 ? "manual" : "recipe", (unsigned long)s->duration_ms);
+            break;
+        case TELEMETRY_BATCH:
+            ok = ok && put(buf, size, len, "\"event\":\"%s\",\"recipe\":\"%s\",\"pumps\":%u}",
+                           s->event < 3 ? batch_events[s->event] : "?",
+                           json_name(recipe_name(t, s->recipe), name, sizeof(name)), (unsigned)s->pump);
+            break;
+        case TELEMETRY_INVENTORY:
+            ok = ok && put(buf, size, len,
+                           "\"chemical\":\"%s\",\"remaining_g\":%.1f,\"capacity_g\":%.1f,\"percent_full\":%.1f}",
+                           json_name(chemical_name(t, s->pump), name, sizeof(name)), (double)s->a, (double)s->b,
+                           s->b > 0.0f ? (double)(s->a * 100.0f / s->b) : 0.0);
+            break;
+        default:
+            ok = false;
+            break;
+    }
+    return ok;
+}
+
+static bool encode_accuracy(const telemetry_t *t, uint8_t pump, const telemetry_accuracy_t *a, int64_t time_ms,
+                            char *buf, size_t size, size_t *len) {
+    char device[32];
+    char name[48];
+    bool ok = put(buf, size, len, "{");
+    if (time_ms > 0) {
+        ok = ok && put(buf, size, len, "\"timestamp\":%lld.%03d,", (long long)(time_ms / 1000), (int)(time_ms % 1000));
+    }
+    ok = ok && put(buf, size, len, "\"device_id\":\"%s\",\"pump\":%u,\"chemical\":\"%s\",",
+                   json_name(t->cfg.device_id, device, sizeof(device)), (unsigned)pump + 1,
+                   json_name(chemical_name(t, pump), name, sizeof(name)));
+    ok = ok && put(buf, size, len,
+                   "\"doses\":%lu,\"mean_error_g\":%.3f,\"sd_error_g\":%.3f,\"correction_g\":%.3f,"
+                   "\"mean_time_s\":%.2f}",
+                   (unsigned long)a->doses, (double)a->mean_error_g, (double)a->sd_error_g,
+                   (double)a->correction_g, (double)a->mean_time_s);
+    return ok;
+}
+
+size_t telemetry_encode(const telemetry_t *t, const telemetry_sample_t *samples, size_t n, char *buf,
+                        size_t size, size_t *encoded) {
+    size_t len = 0;
+    *encoded = 0;
+    if (!put(buf, size, &len, "[")) return 0;
+    for (size_t i = 0; i < n; i++) {
+        size_t mark = len;
+        // Room for the closing bracket is kept back
+        if ((i > 0 && !put(buf, size - 1, &len, ",")) || !encode_sample(t, &samples[i], buf, size - 1, &len)) {
+            len = mark;
+            break;
+        }
+        (*encoded)++;
+    }
+    if (*encoded == 0) return 0;
+    buf[len++] = ']';
+    buf[len] = '\0';
+    return len;
+}
+
+// ============================================================================
+// SERVICE (telemetry task)
+// ============================================================================
+
+static void take_acks(telemetry_t *t) {
+    for (;;) {
+        int msg_id;
+        bool have;
+        portENTER_CRITICAL(&t->mux);
+        have = t->ack_head != t->ack_tail;
+        if (have) msg_id = t->acks[t->ack_tail++ & ACK_MASK];
+        portEXIT_CRITICAL(&t->mux);
+        if (!have) break;
+
+        for (int i = 0; i < t->inflight_count; i++) {
+            if (t->inflight[i].msg_id == msg_id && !t->inflight[i].acked) {
+                t->inflight[i].acked = true;
+                t->stats.acked++;
+                break;
+            }
+        }
+    }
+
+    // Retire in order: the outbox tail only moves over a contiguous acknowledged prefix
+    while (t->inflight_count > 0 && t->inflight[0].acked) {
+        uint32_t before = t->store.tail_pos;
+        if (t->have_store) tlm_store_ack(&t->store, t->inflight[0].end_pos);
+        t->stats.samples_acked += t->store.tail_pos - before;
+        t->inflight_count--;
+        memmove(&t->inflight[0], &t->inflight[1], sizeof(t->inflight[0]) * (size_t)t->inflight_count);
+    }
+}
+
+static bool pop_queue(telemetry_t *t, telemetry_sample_t *out) {
+    bool have;
+    portENTER_CRITICAL(&t->mux);
+    have = t->queue_head != t->queue_tail;
+    if (have) *out = t->queue[t->queue_tail++ & QUEUE_MASK];
+    portEXIT_CRITICAL(&t->mux);
+    return have;
+}
+
+static int publish(telemetry_t *t, uint8_t topic, const telemetry_sample_t *samples, size_t n, size_t *sent) {
+    size_t len = telemetry_encode(t, samples, n, t->payload, sizeof(t->payload), sent);
+    if (len == 0) return -1;
+    int msg_id = t->io.publish(t->io.ctx, t->topics[topic], t->payload, len);
+    if (msg_id >= 0) t->stats.published++;
+    return msg_id;
+}
+
+/**
+ * @brief Samples of one topic among the window positions before end, in order
+ */
+static size_t gather(const telemetry_sample_t *window, const uint32_t *positions, size_t n, uint8_t topic,
+                     uint32_t end, telemetry_sample_t *out, uint32_t *out_positions) {
+    size_t count = 0;
+    for (size_t i = 0; i < n && positions[i] < end; i++) {
+        if (window[i].topic != topic) continue;
+        out_positions[count] = positions[i];
+        out[count++] = window[i];
+    }
+    return count;
+}
+
+/**
+ * @brief Publish due windows from the outbox, oldest first, within the in-flight limit
+ *
+ * A window is the next TELEMETRY_BATCH_MAX samples in outbox order; it goes
+ * out as one message per topic in it. Only the last message carries the
+ * window's end position, and messages retire in order, so the tail passes
+ * the window once all of its messages are acknowledged.
+ */
+static void publish_outbox(telemetry_t *t, int64_t now_ms) {
+    if (t->send_pos < t->store.tail_pos) t->send_pos = t->store.tail_pos;     // Dropped under us
+    if (t->send_pos >= t->store.head_pos) {
+        t->oldest_pending_ms = -1;
+        return;
+    }
+    if (t->oldest_pending_ms < 0) t->oldest_pending_ms = now_ms;
+
+    while (t->send_pos < t->store.head_pos) {
+        telemetry_sample_t window[TELEMETRY_BATCH_MAX];
+        uint32_t positions[TELEMETRY_BATCH_MAX];
+        size_t n = 0;
+        uint32_t pos = t->send_pos;
+        while (pos < t->store.head_pos && n < TELEMETRY_BATCH_MAX) {
+            if (tlm_store_read(&t->store, pos, &window[n])) {
+                positions[n++] = pos;
+            } else {
+                t->stats.damaged++;             // Torn write: skipped, acknowledged with the window
+            }
+            pos++;
+        }
+        // A partial window at the end waits for company, up to TELEMETRY_BATCH_AGE_MS
+        bool partial = n < TELEMETRY_BATCH_MAX;
+        if (n > 0 && partial && now_ms - t->oldest_pending_ms < TELEMETRY_BATCH_AGE_MS) return;
+
+        // Shrink the window until every topic fits one payload
+        telemetry_sample_t group[TELEMETRY_BATCH_MAX];
+        uint32_t group_positions[TELEMETRY_BATCH_MAX];
+        uint32_t end = pos;
+        int messages;
+        bool refit;
+        do {
+            refit = false;
+            messages = 0;
+            for (uint8_t topic = 0; topic < TELEMETRY_TOPICS && !refit; topic++) {
+                size_t count = gather(window, positions, n, topic, end, group, group_positions);
+                if (count == 0) continue;
+                size_t fit = 0;
+                telemetry_encode(t, group, count, t->payload, sizeof(t->payload), &fit);
+                if (fit == 0) {
+                    // Cannot be encoded at any size: skipped like a torn sample
+                    for (size_t i = 0; i < n; i++) {
+                        if (positions[i] == group_positions[0]) window[i].topic = TELEMETRY_TOPICS;
+                    }
+                    t->stats.damaged++;
+                    refit = true;
+                } else if (fit < count) {
+                    end = group_positions[fit];
+                    refit = true;
+                }
+                messages++;
+            }
+        } while (refit);
+        if (messages == 0) {
+            t->send_pos = end;
+            continue;
+        }
+        if (t->inflight_count + messages > TELEMETRY_INFLIGHT) return;
+
+        int sent = 0;
+        for (uint8_t topic = 0; topic < TELEMETRY_TOPICS; topic++) {
+            size_t count = gather(window, positions, n, topic, end, group, group_positions);
+            if (count == 0) continue;
+            size_t encoded = 0;
+            int msg_id = publish(t, topic, group, count, &encoded);
+            // Transport busy: the window is sent again next service (a duplicate if part went out)
+            if (msg_id < 0) return;
+            bool last = ++sent == messages;
+            telemetry_inflight_t *f = &t->inflight[t->inflight_count++];
+            f->msg_id = msg_id;
+            f->end_pos = last ? end : t->send_pos;
+            f->acked = false;
+        }
+        if (end <= t->max_sent_pos) t->stats.resent += (uint32_t)sent;
+        if (end > t->max_sent_pos) t->max_sent_pos = end;
+        t->send_pos = end;
+        t->oldest_pending_ms = t->send_pos < t->store.head_pos ? now_ms : -1;
+    }
+}
+
+/**
+ * @brief No outbox: publish straight from the RAM queue (lost while offline once it overflows)
+ */
+static void publish_queue(telemetry_t *t) {
+    telemetry_sample_t batch[TELEMETRY_BATCH_MAX];
+    size_t n = 0;
+    for (;;) {
+        portENTER_CRITICAL(&t->mux);
+        n = 0;
+        while (n < TELEMETRY_BATCH_MAX && t->queue_tail + n != t->queue_head) {
+            const telemetry_sample_t *s = &t->queue[(t->queue_tail + n) & QUEUE_MASK];
+            if (n > 0 && s->topic != batch[0].topic) break;
+            batch[n++] = *s;
+        }
+        portEXIT_CRITICAL(&t->mux);
+        if (n == 0) return;
+
+        size_t sent = 0;
+        if (publish(t, batch[0].topic, batch, n, &sent) < 0) return;
+        portENTER_CRITICAL(&t->mux);
+        t->queue_tail += (uint32_t)sent;
+        portEXIT_CRITICAL(&t->mux);
+    }
+}
+
+static void publish_inventory(telemetry_t *t, int64_t now_ms) {
+    if (now_ms < t->next_inventory_ms) return;
+    telemetry_sample_t levels[TELEMETRY_PUMPS];
+    uint32_t seqs[TELEMETRY_PUMPS];
+    uint8_t pumps[TELEMETRY_PUMPS];
+    size_t n = 0;
+    portENTER_CRITICAL(&t->mux);
+    for (uint8_t p = 0; p < TELEMETRY_PUMPS; p++) {
+        if (!(t->latest_valid & (1u << p))) continue;
+        pumps[n] = p;
+        seqs[n] = t->latest[p].seq;
+        levels[n++] = t->latest[p];
+    }
+    portEXIT_CRITICAL(&t->mux);
+    if (n == 0) return;
+
+    size_t sent = 0;
+    if (publish(t, TELEMETRY_INVENTORY, levels, n, &sent) < 0) return;
+    t->next_inventory_ms = now_ms + TELEMETRY_INVENTORY_MS;
+    portENTER_CRITICAL(&t->mux);
+    for (size_t i = 0; i < sent; i++) {
+        // Keep a level that was replaced while this one was being sent
+        if (t->latest[pumps[i]].seq == seqs[i]) t->latest_valid &= (uint8_t)~(1u << pumps[i]);
+    }
+    portEXIT_CRITICAL(&t->mux);
+}
+
+static void publish_accuracy(telemetry_t *t, int64_t now_ms) {
+    if (now_ms < t->next_accuracy_ms) return;
+    telemetry_accuracy_t acc[TELEMETRY_PUMPS];
+    int64_t times[TELEMETRY_PUMPS];
+    uint32_t seqs[TELEMETRY_PUMPS];
+    uint8_t pumps[TELEMETRY_PUMPS];
+    size_t n = 0;
+    portENTER_CRITICAL(&t->mux);
+    for (uint8_t p = 0; p < TELEMETRY_PUMPS; p++) {
+        if (!(t->accuracy_valid & (1u << p))) continue;
+        pumps[n] = p;
+        seqs[n] = t->accuracy_seq[p];
+        times[n] = t->accuracy_ms[p];
+        acc[n++] = t->accuracy[p];
+    }
+    portEXIT_CRITICAL(&t->mux);
+    if (n == 0) return;
+
+    // Four short objects always fit one payload
+    size_t len = 0;
+    bool ok = put(t->payload, sizeof(t->payload), &len, "[");
+    for (size_t i = 0; i < n && ok; i++) {
+        ok = (i == 0 || put(t->payload, sizeof(t->payload), &len, ",")) &&
+             encode_accuracy(t, pumps[i], &acc[i], times[i], t->payload, sizeof(t->payload), &len);
+    }
+    ok = ok && put(t->payload, sizeof(t->payload), &len, "]");
+    if (!ok) return;
+    if (t->io.publish(t->io.ctx, t->topics[TELEMETRY_ACCURACY], t->payload, len) < 0) return;
+    t->stats.published++;
+    t->next_accuracy_ms = now_ms + TELEMETRY_ACCURACY_MS;
+    portENTER_CRITICAL(&t->mux);
+    for (size_t i = 0; i < n; i++) {
+        // Keep figures that were replaced while these were being sent
+        if (t->accuracy_seq[pumps[i]] == seqs[i]) t->accuracy_valid &= (uint8_t)~(1u << pumps[i]);
+    }
+    portEXIT_CRITICAL(&t->mux);
+}
+
+/**
+ * @brief One binary frame with every queued status sample (not stored, not tracked)
+ */
+static void publish_status(telemetry_t *t, int64_t now_ms) {
+    if (now_ms < t->next_status_ms) return;
+    t->next_status_ms = now_ms + TELEMETRY_STATUS_MS;
+
+    // Sample times are monotonic; one offset per frame moves them to Unix time
+    int64_t unix_ms = clock_now(t);
+    int64_t offset = unix_ms > 0 ? unix_ms - now_ms : 0;
+    tlm_codec_encoder_t e;
+    tlm_codec_begin(&e, (uint8_t *)t->payload, sizeof(t->payload), t->status_frame_seq, unix_ms > 0);
+
+    uint32_t pos;
+    portENTER_CRITICAL(&t->mux);
+    pos = t->status_tail;
+    portEXIT_CRITICAL(&t->mux);
+    for (;;) {
+        tlm_status_t s;
+        bool have;
+        portENTER_CRITICAL(&t->mux);
+        if ((int32_t)(t->status_tail - pos) > 0) pos = t->status_tail;     // Overwritten meanwhile
+        have = pos != t->status_head;
+        if (have) s = t->status[pos & STATUS_MASK];
+        portEXIT_CRITICAL(&t->mux);
+        if (!have) break;
+        s.time_ms += offset;
+        if (!tlm_codec_add(&e, &s)) break;
+        pos++;
+    }
+    if (e.count == 0) return;
+
+    size_t len = tlm_codec_end(&e);
+    if (t->io.publish(t->io.ctx, t->status_topic, t->payload, len) < 0) return;
+    t->status_frame_seq++;
+    t->stats.status_frames++;
+    t->stats.status_bytes += (uint32_t)len;
+    portENTER_CRITICAL(&t->mux);
+    if ((int32_t)(pos - t->status_tail) > 0) t->status_tail = pos;
+    portEXIT_CRITICAL(&t->mux);
+}
+
+void telemetry_service(telemetry_t *t, int64_t now_ms) {
+    take_acks(t);
+
+    telemetry_sample_t s;
+    while (t->have_store && pop_queue(t, &s)) {
+        tlm_store_append(&t->store, &s);        // Flash first: a reset now loses nothing
+    }
+
+    bool connected = t->io.connected(t->io.ctx);
+    if (!connected) {
+        if (t->was_connected) {
+            // Unacknowledged messages are sent again after the reconnect
+            t->inflight_count = 0;
+            t->send_pos = t->store.tail_pos;
+        }
+        t->was_connected = false;
+        return;
+    }
+    t->was_connected = true;
+
+    if (t->have_store) {
+        publish_outbox(t, now_ms);
+    } else {
+        publish_queue(t);
+    }
+    publish_inventory(t, now_ms);
+    publish_accuracy(t, now_ms);
+    publish_status(t, now_ms);
+}
+
+void telemetry_get_stats(const telemetry_t *t, telemetry_stats_t *out) {
+    *out = t->stats;
+    out->dropped_store = t->store.dropped;
+    out->pending = t->have_store ? tlm_store_pending(&t->store) : t->queue_head - t->queue_tail;
+}
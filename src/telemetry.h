@@ -0,0 +1,261 @@
+/**
+ * @file telemetry.h
+ * @brief MQTT telemetry: per-priority queues, batched JSON, flash store-and-forward
+ *
+ * Publishes the topics of docs/integration/MQTT_TIMESCALEDB_INTEGRATION_GUIDE.md
+ * in the JSON layout its Telegraf configuration reads:
+ *   <prefix>/dosing/consumption   one object per dose
+ *   <prefix>/batch/events         batch start / complete / abort
+ *   <prefix>/inventory/levels     remaining grams per chemical
+ *   <prefix>/dosing/accuracy      dose error and bias correction per chemical
+ * Each message is a JSON array of samples of one topic (Telegraf's json
+ * parser turns every element into one row). Must-deliver samples go out in
+ * windows of TELEMETRY_BATCH_MAX in outbox order, one message per topic in
+ * the window; a partial window waits up to TELEMETRY_BATCH_AGE_MS.
+ *
+ * PRIORITIES AND DROP POLICIES:
+ *   HIGH (dose, batch)  Must deliver. Queued in RAM, then written to the
+ *                       flash outbox (tlm_store.h) and published from
+ *                       there; removed only when the broker has acknowledged
+ *                       the message (QoS 1). Broker down, WiFi down or a
+ *                       reset: the outbox replays them in order. A full RAM
+ *                       queue drops the NEWEST sample (what is queued keeps
+ *                       its order); a full outbox drops its oldest sector.
+ *   LOW (inventory)     Latest value wins. One slot per chemical; a newer
+ *                       level replaces the queued one (counted as coalesced);
+ *                       published every TELEMETRY_INVENTORY_MS. Not stored
+ *                       while offline - the next level supersedes it.
+ *   LOW (accuracy)      The same, one slot per chemical: the running figures
+ *                       of dose_stats.h after each dose, every
+ *                       TELEMETRY_ACCURACY_MS.
+ *   STREAM (status)     Weight and state at 10-20 Hz. Binary tlm_codec.h
+ *                       frames on <prefix>/status/<device_id>, one per
+ *                       TELEMETRY_STATUS_MS (~5 bytes per sample instead of
+ *                       ~150 as JSON). A ring of TELEMETRY_STATUS_RING
+ *                       samples; when full (offline) the OLDEST is dropped.
+ *
+ * RULES:
+ * - telemetry_push_*() are O(1) copies under a spinlock: safe from any
+ *   task, never wait on flash or the network. Control tasks only call these.
+ * - telemetry_service() does all flash writes, JSON encoding and publishes;
+ *   call it from one low-priority task (main/task_telemetry.c).
+ * - The transport's publish() must not block (esp_mqtt_client_enqueue()
+ *   on the target, a non-blocking socket on the host).
+ * - Delivery is at least once: after a reconnect, a batch whose PUBACK was
+ *   lost is sent again. Every dose and batch sample carries "seq" for
+ *   de-duplication.
+ * - Samples keep their own time; "timestamp" (Unix seconds) is omitted while
+ *   the clock is not set, so Telegraf stamps them on arrival.
+ *
+ * Shared by the firmware (main/) and the host tools (host/telemetry); uses
+ * a portMUX and esp_partition (host stand-ins in host/esp_idf).
+ *
+ * Usage:
+ *   static telemetry_t tlm;
+ *   telemetry_init(&tlm, &config, &transport, "tlmq");
+ *   control:    telemetry_push_dose(&tlm, pump, recipe, target_g, actual_g, duration_ms);
+ *               telemetry_push_accuracy(&tlm, pump, &acc);  // After dose_stats_record()
+ *               telemetry_push_status(&tlm, &status);       // 20 Hz
+ *   telemetry:  telemetry_service(&tlm, now_ms);
+ *   MQTT task:  telemetry_on_ack(&tlm, msg_id);          // PUBACK
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "tlm_codec.h"
+#include "tlm_store.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TELEMETRY_PUMPS         4
+#define TELEMETRY_QUEUE         32      // HIGH samples between two services (power of two)
+#define TELEMETRY_ACKS          16      // PUBACKs between two services (power of two)
+#define TELEMETRY_BATCH_MAX     16      // Samples per message
+#define TELEMETRY_BATCH_AGE_MS  5000    // Longest a partial batch waits for more samples
+#define TELEMETRY_INFLIGHT      4       // Unacknowledged messages
+#define TELEMETRY_INVENTORY_MS  10000   // Inventory levels published at most this often
+#define TELEMETRY_ACCURACY_MS   10000   // Dosing accuracy, the same
+#define TELEMETRY_STATUS_RING   64      // Status samples between two frames (power of two)
+#define TELEMETRY_STATUS_MS     1000    // One status frame per period
+#define TELEMETRY_PAYLOAD_MAX   4096    // TELEMETRY_BATCH_MAX samples of any topic
+#define TELEMETRY_TOPIC_MAX     64
+
+typedef enum {
+    TELEMETRY_DOSE = 0,
+    TELEMETRY_BATCH,
+    TELEMETRY_INVENTORY,
+    TELEMETRY_ACCURACY,         // LOW, not a telemetry_sample_t: never in the outbox
+    TELEMETRY_TOPICS,
+} telemetry_topic_t;
+
+typedef enum {
+    TELEMETRY_BATCH_START = 0,
+    TELEMETRY_BATCH_COMPLETE,
+    TELEMETRY_BATCH_ABORT,
+} telemetry_batch_event_t;
+
+/** One sample, as queued and as stored in the outbox (28 bytes) */
+typedef struct __attribute__((packed)) {
+    int64_t time_ms;            // Unix ms, 0 if the clock was not set
+    uint32_t seq;               // HIGH: delivery order; inventory: slot generation
+    uint8_t topic;              // telemetry_topic_t
+    uint8_t pump;               // 0..3 (chemical); batch: number of pumps used
+    uint8_t recipe;             // Index into config.recipes, 0 = manual dose
+    uint8_t event;              // telemetry_batch_event_t
+    float a;                    // dose: target g;  inventory: remaining g
+    float b;                    // dose: actual g;  inventory: capacity g
+    uint32_t duration_ms;       // dose
+} telemetry_sample_t;
+
+/** LOW: dosing accuracy of one chemical (dose_stats_summary_t) */
+typedef struct {
+    uint32_t doses;
+    float mean_error_g;
+    float sd_error_g;
+    float correction_g;         // Applied to the next dose
+    float mean_time_s;
+} telemetry_accuracy_t;
+
+typedef struct {
+    /** Non-blocking publish (QoS 1); returns the message id (> 0), or < 0 if not accepted now */
+    int (*publish)(void *ctx, const char *topic, const char *payload, size_t len);
+    bool (*connected)(void *ctx);
+    void *ctx;
+} telemetry_transport_t;
+
+typedef struct {
+    const char *device_id;
+    const char *topic_prefix;                       // "factory"
+    const char *chemicals[TELEMETRY_PUMPS];         // Per pump
+    const char *const *recipes;                     // [0] = "manual"
+    size_t recipe_count;
+    int64_t (*clock_ms)(void);                      // Unix ms, <= 0 if not set
+} telemetry_config_t;
+
+typedef struct {
+    uint32_t pushed;            // HIGH samples accepted
+    uint32_t dropped_queue;     // HIGH samples dropped: RAM queue full
+    uint32_t dropped_store;     // HIGH samples lost: outbox full (from tlm_store)
+    uint32_t coalesced;         // LOW samples replaced by a newer one
+    uint32_t published;         // Messages handed to the transport
+    uint32_t acked;             // Messages acknowledged
+    uint32_t samples_acked;
+    uint32_t resent;            // Messages sent again after a reconnect
+    uint32_t damaged;           // Outbox samples skipped (torn write)
+    uint32_t pending;           // In the outbox, not yet acknowledged
+    uint32_t status_samples;    // Status stream: pushed
+    uint32_t status_dropped;    // Overwritten before they were sent
+    uint32_t status_frames;
+    uint32_t status_bytes;      // Frame bytes published
+} telemetry_stats_t;
+
+typedef struct {
+    int msg_id;
+    uint32_t end_pos;           // Outbox position after the last sample of the message
+    bool acked;
+} telemetry_inflight_t;
+
+typedef struct {
+    telemetry_config_t cfg;
+    telemetry_transport_t io;
+    tlm_store_t store;
+    bool have_store;
+
+    portMUX_TYPE mux;
+    telemetry_sample_t queue[TELEMETRY_QUEUE];
+    uint32_t queue_head;
+    uint32_t queue_tail;
+    telemetry_sample_t latest[TELEMETRY_PUMPS];     // LOW: one per chemical
+    uint8_t latest_valid;                           // Bit per pump
+    telemetry_accuracy_t accuracy[TELEMETRY_PUMPS]; // LOW: one per chemical
+    int64_t accuracy_ms[TELEMETRY_PUMPS];           // Unix ms when pushed, 0 if the clock was not set
+    uint32_t accuracy_seq[TELEMETRY_PUMPS];         // Slot generation
+    uint8_t accuracy_valid;                         // Bit per pump
+    int acks[TELEMETRY_ACKS];
+    uint32_t ack_head;
+    uint32_t ack_tail;
+    uint32_t next_seq;
+    uint32_t inventory_gen;
+
+    telemetry_inflight_t inflight[TELEMETRY_INFLIGHT];
+    int inflight_count;
+    uint32_t send_pos;          // Next outbox position to publish
+    uint32_t max_sent_pos;      // Highest position ever sent (resend accounting)
+    int64_t oldest_pending_ms;  // service time the first unsent sample was seen, -1 if none
+    int64_t next_inventory_ms;
+    int64_t next_accuracy_ms;
+
+    tlm_status_t status[TELEMETRY_STATUS_RING];
+    uint32_t status_head;
+    uint32_t status_tail;
+    uint32_t status_frame_seq;
+    int64_t next_status_ms;
+    bool was_connected;
+
+    telemetry_stats_t stats;
+    char topics[TELEMETRY_TOPICS][TELEMETRY_TOPIC_MAX];
+    char status_topic[TELEMETRY_TOPIC_MAX];
+    char payload[TELEMETRY_PAYLOAD_MAX];
+} telemetry_t;
+
+/**
+ * @brief Bind config and transport, open the outbox, continue the seq numbering
+ * @param store_label Outbox partition ("tlmq"); without it HIGH samples are
+ *                    published from RAM only and lost while offline
+ */
+void telemetry_init(telemetry_t *t, const telemetry_config_t *cfg, const telemetry_transport_t *io,
+                    const char *store_label);
+
+/** HIGH: one finished dose (pump 0..3, actual may differ from target) */
+bool telemetry_push_dose(telemetry_t *t, uint8_t pump, uint8_t recipe, float target_g, float actual_g,
+                         uint32_t duration_ms);
+
+/** HIGH: batch start / complete / abort */
+bool telemetry_push_batch(telemetry_t *t, telemetry_batch_event_t event, uint8_t recipe, uint8_t pumps);
+
+/** LOW: inventory level of one chemical */
+void telemetry_push_inventory(telemetry_t *t, uint8_t pump, float remaining_g, float capacity_g);
+
+/** LOW: dosing accuracy of one chemical, after a dose */
+void telemetry_push_accuracy(telemetry_t *t, uint8_t pump, const telemetry_accuracy_t *acc);
+
+/**
+ * @brief STATUS: one sample of the weight / state stream
+ *
+ * s->time_ms is monotonic ms on the clock of telemetry_service()'s now_ms;
+ * it is moved to Unix time when the frame is built, if the clock is set.
+ */
+void telemetry_push_status(telemetry_t *t, const tlm_status_t *s);
+
+/** Transport callback: message acknowledged (any task) */
+void telemetry_on_ack(telemetry_t *t, int msg_id);
+
+/**
+ * @brief Move queued samples to the outbox, publish due batches, retire acknowledged ones
+ * @param now_ms Monotonic ms (batch age)
+ */
+void telemetry_service(telemetry_t *t, int64_t now_ms);
+
+void telemetry_get_stats(const telemetry_t *t, telemetry_stats_t *out);
+
+/**
+ * @brief JSON array of up to n samples of one topic into buf
+ * @param encoded Samples that fit (the first *encoded of the n)
+ * @return Length, 0 if not even one sample fits
+ */
+size_t telemetry_encode(const telemetry_t *t, const telemetry_sample_t *samples, size_t n, char *buf,
+                        size_t size, size_t *encoded);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TELEMETRY_H
@@ -29,6 +29,8 @@
 
 #include <Arduino.h>
 #include "pin_definitions.h"
+#include "console.h"
+#include "esp_timer.h"
 
 // Serial port configuration
 // Start with most common settings: 9600 8N1
@@ -57,6 +59,8 @@ unsigned long totalLines = 0;
 unsigned long lastBurstTime = 0;
 bool continuousMode = true;  // Default to continuous like Python code
 
+console_t console;
+
 /**
  * Print data in HEX format for debugging
  */
@@ -462,6 +466,70 @@ void processLine(const char* line, size_t len) {
     Serial.println("----------------------------------------");
 }
 
+// ============================================================================
+// CONSOLE COMMANDS
+// ============================================================================
+
+console_status_t cmdContinuous(console_call_t *call) {
+    (void)call;
+    continuousMode = !continuousMode;
+    Serial.print("\n[Continuous mode: ");
+    Serial.print(continuousMode ? "ON" : "OFF");
+    Serial.println("]");
+    if (continuousMode) {
+        Serial.println("Continuously sending bursts (like Python)");
+    } else {
+        Serial.println("Stopped continuous bursts");
+    }
+    return CONSOLE_DONE;
+}
+
+console_status_t cmdRead(console_call_t *call) {
+    (void)call;
+    Serial.println("\n[Manual Read Triggered]");
+    readScaleWithBurst();
+    return CONSOLE_DONE;
+}
+
+console_status_t cmdOptimize(console_call_t *call) {
+    (void)call;
+    Serial.println("\n[Timing Optimization Test]");
+    continuousMode = false;  // Stop continuous mode during test
+    runTimingTest();
+    return CONSOLE_DONE;
+}
+
+console_status_t cmdSingle(console_call_t *call) {
+    (void)call;
+    Serial.println("\n[Sending single @P<CR><LF> command]");
+    ScaleSerial.print("@P<CR><LF>");
+    ScaleSerial.flush();
+    return CONSOLE_DONE;
+}
+
+console_status_t cmdTestCommands(console_call_t *call) {
+    (void)call;
+    Serial.println("\n[Sending test commands]");
+    Serial.println("Sending: P");
+    ScaleSerial.println("P");
+    delay(100);
+    Serial.println("Sending: W");
+    ScaleSerial.println("W");
+    delay(100);
+    Serial.println("Sending: ENQ (0x05)");
+    ScaleSerial.write(0x05);
+    delay(100);
+    return CONSOLE_DONE;
+}
+
+const console_cmd_t commands[] = {
+    {"o", "", "Timing optimization test", cmdOptimize, 0},
+    {"c", "", "Toggle continuous mode", cmdContinuous, 0},
+    {"r", "", "Manual read", cmdRead, 0},
+    {"p", "", "Send @P<CR><LF>", cmdSingle, 0},
+    {"t", "", "Test commands (P, W, ENQ)", cmdTestCommands, 0},
+};
+
 void setup() {
     Serial.begin(115200);
     delay(500);
@@ -524,56 +592,14 @@ void setup() {
 
     rxIndex = 0;
     lastDataTime = millis();
+
+    console_io_t io = console_stream_io(Serial);
+    console_init(&console, commands, sizeof(commands) / sizeof(commands[0]), &io);
 }
 
 void loop() {
-    // Handle user commands from serial monitor
-    if (Serial.available()) {
-        String cmd = Serial.readStringUntil('\n');
-        cmd.trim();
-        cmd.toLowerCase();
-
-        if (cmd == "c") {
-            continuousMode = !continuousMode;
-            Serial.print("\n[Continuous mode: ");
-            Serial.print(continuousMode ? "ON" : "OFF");
-            Serial.println("]");
-            if (continuousMode) {
-                Serial.println("Continuously sending bursts (like Python)");
-            } else {
-                Serial.println("Stopped continuous bursts");
-            }
-        } else if (cmd == "r") {
-            Serial.println("\n[Manual Read Triggered]");
-            readScaleWithBurst();
-        } else if (cmd == "o") {
-            Serial.println("\n[Timing Optimization Test]");
-            continuousMode = false;  // Stop continuous mode during test
-            runTimingTest();
-        } else if (cmd == "p") {
-            Serial.println("\n[Sending single @P<CR><LF> command]");
-            ScaleSerial.print("@P<CR><LF>");
-            ScaleSerial.flush();
-        } else if (cmd == "t") {
-            Serial.println("\n[Sending test commands]");
-            Serial.println("Sending: P");
-            ScaleSerial.println("P");
-            delay(100);
-            Serial.println("Sending: W");
-            ScaleSerial.println("W");
-            delay(100);
-            Serial.println("Sending: ENQ (0x05)");
-            ScaleSerial.write(0x05);
-            delay(100);
-        } else {
-            Serial.println("\nUnknown command. Available commands:");
-            Serial.println("  o - Timing optimization test");
-            Serial.println("  c - Toggle continuous mode");
-            Serial.println("  r - Manual read");
-            Serial.println("  p - Send @P<CR><LF>");
-            Serial.println("  t - Test commands");
-        }
-    }
+    // Handle user commands from serial monitor (never blocks)
+    console_poll(&console, esp_timer_get_time());
 
     // Continuous mode - send bursts as fast as possible (like Python)
     if (continuousMode) {
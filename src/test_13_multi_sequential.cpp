@@ -30,6 +30,7 @@
 
 #include <Arduino.h>
 #include "pin_definitions.h"
+#include "button_events.h"
 
 #define UartSerial         Serial2
 
@@ -145,15 +146,13 @@ int readEncoder() {
 }
 
 bool readEncoderButton() {
-    bool pressed = (digitalRead(ENCODER_SW_PIN) == LOW);
-
-    if (pressed != encButton.lastPressed) {
-        delay(50);
-        pressed = (digitalRead(ENCODER_SW_PIN) == LOW);
-
-        if (pressed != encButton.lastPressed) {
-            encButton.lastPressed = pressed;
-            encButton.pressed = pressed;
+    // Non-blocking: debounced SELECT edges come from the button event engine
+    button_event_t ev;
+    while (button_events_poll(&ev)) {
+        if (ev.button != BUTTON_SELECT) continue;
+        if (ev.type == BUTTON_EVENT_PRESS || ev.type == BUTTON_EVENT_RELEASE) {
+            encButton.pressed = (ev.type == BUTTON_EVENT_PRESS);
+            encButton.lastPressed = encButton.pressed;
             return true;
         }
     }
@@ -204,11 +203,11 @@ void setup() {
     // Initialize encoder
     pinMode(ENCODER_CLK_PIN, INPUT_PULLUP);
     pinMode(ENCODER_DT_PIN, INPUT_PULLUP);
-    pinMode(ENCODER_SW_PIN, INPUT);
     encoder.clkState = digitalRead(ENCODER_CLK_PIN);
     encoder.dtState = digitalRead(ENCODER_DT_PIN);
     encoder.lastClkState = encoder.clkState;
     encoder.position = 0;
+    button_events_init();  // Encoder SW (SELECT) via interrupt-driven events
     Serial.println("✓ Encoder initialized");
 
     // Initialize UART
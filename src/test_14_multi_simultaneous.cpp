@@ -29,12 +29,19 @@
 
 #include <Arduino.h>
 #include "pin_definitions.h"
+#include "button_events.h"
+#include "esp_timer.h"
+#include "line_framer.h"
 
 #define UartSerial         Serial2
 
 const float ML_PER_MM = 0.05;
 const float SAFE_TEST_FEEDRATE = 300.0; // Max feedrate for testing safety
 
+// Console line assembly (never blocks, no String)
+char consoleBuf[64];
+line_framer_t consoleRx;
+
 struct MultiPumpCommand {
     float volumeX, volumeY, volumeZ, volumeA;
     float flowRateMlMin;
@@ -138,15 +145,13 @@ int readEncoder() {
 }
 
 bool readEncoderButton() {
-    bool pressed = (digitalRead(ENCODER_SW_PIN) == LOW);
-
-    if (pressed != encButton.lastPressed) {
-        delay(50);
-        pressed = (digitalRead(ENCODER_SW_PIN) == LOW);
-
-        if (pressed != encButton.lastPressed) {
-            encButton.lastPressed = pressed;
-            encButton.pressed = pressed;
+    // Non-blocking: debounced SELECT edges come from the button event engine
+    button_event_t ev;
+    while (button_events_poll(&ev)) {
+        if (ev.button != BUTTON_SELECT) continue;
+        if (ev.type == BUTTON_EVENT_PRESS || ev.type == BUTTON_EVENT_RELEASE) {
+            encButton.pressed = (ev.type == BUTTON_EVENT_PRESS);
+            encButton.lastPressed = encButton.pressed;
             return true;
         }
     }
@@ -197,15 +202,16 @@ void setup() {
     // Initialize encoder
     pinMode(ENCODER_CLK_PIN, INPUT_PULLUP);
     pinMode(ENCODER_DT_PIN, INPUT_PULLUP);
-    pinMode(ENCODER_SW_PIN, INPUT);
     encoder.clkState = digitalRead(ENCODER_CLK_PIN);
     encoder.dtState = digitalRead(ENCODER_DT_PIN);
     encoder.lastClkState = encoder.clkState;
     encoder.position = 0;
+    button_events_init();  // Encoder SW (SELECT) via interrupt-driven events
     Serial.println("✓ Encoder initialized");
 
     // Initialize UART
     UartSerial.begin(115200, SERIAL_8N1, UART_TEST_RX_PIN, UART_TEST_TX_PIN);
+    line_framer_init(&consoleRx, consoleBuf, sizeof(consoleBuf), LINE_FRAMER_DROP);
     Serial.println("✓ UART initialized\n");
 
     Serial.println("Predefined Patterns:");
@@ -236,43 +242,43 @@ void loop() {
     handleEncoder();
 
     // Handle user commands
-    if (Serial.available()) {
-        String input = Serial.readStringUntil('\n');
-        input.trim();
+    line_framer_line_t line;
+    if (line_framer_read(&consoleRx, Serial, esp_timer_get_time(), &line)) {
+        const char *input = line.text;
 
         MultiPumpCommand cmd;
 
-        if (input == "1") {
+        if (strcmp(input, "1") == 0) {
             // Equal mix
             cmd = {5.0, 5.0, 5.0, 5.0, 20.0};
             dispenseMultiple(cmd);
-        } else if (input == "2") {
+        } else if (strcmp(input, "2") == 0) {
             // Ratio mix
             cmd = {4.0, 2.0, 2.0, 1.0, 15.0};
             dispenseMultiple(cmd);
-        } else if (input == "3") {
+        } else if (strcmp(input, "3") == 0) {
             // Custom - user can modify
             cmd = {3.0, 2.0, 1.5, 0.5, 10.0};
             dispenseMultiple(cmd);
-        } else if (input == "!" || input == "x") {
+        } else if (strcmp(input, "!") == 0 || strcmp(input, "x") == 0) {
             Serial.println("\n⚠ EMERGENCY STOP!");
             sendCommand("!");
             Serial.println("All pumps stopped (HOLD state)");
             Serial.println("Type '~' to resume or '$' to reset");
-        } else if (input == "~" || input == "c") {
+        } else if (strcmp(input, "~") == 0 || strcmp(input, "c") == 0) {
             Serial.println("\nResuming from HOLD...");
             sendCommand("~");
             Serial.println("System resumed");
-        } else if (input == "$") {
+        } else if (strcmp(input, "$") == 0) {
             Serial.println("\nResetting system...");
             UartSerial.write(0x18);  // Ctrl-X soft reset
             UartSerial.flush();
             delay(100);
             sendCommand("$X");  // Unlock
             Serial.println("System reset and unlocked");
-        } else if (input == "s") {
+        } else if (strcmp(input, "s") == 0) {
             sendCommand("?");
-        } else if (input == "h") {
+        } else if (strcmp(input, "h") == 0) {
             sendCommand("$H");
         }
     }
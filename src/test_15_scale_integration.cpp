@@ -20,22 +20,72 @@
  * - Monitor scale readings in real-time
  * - Stop when target reached
  * - Report actual weight vs. target
+ * - Dosing accuracy per pump and chemical (dose_stats.h): each dose is
+ *   scored on the settled scale, and the pump's mean overshoot is taken
+ *   off the next stop point; 'a' shows the figures, kept in NVS
+ * - Stall / tube-failure detection: commanded MPos vs scale response on
+ *   every status report; a fault sends a feed hold straight into the UART
+ *   FIFO and names the pump (see flow_monitor.h)
+ * - Dispensing is an incremental jog ("$J="), so reaching the target is a
+ *   jog cancel: the pump decelerates to Idle and the next dispense can
+ *   start as soon as the Idle report arrives - no Ctrl-X, no $X, no
+ *   sleeps (see fluidnc_ctl.h)
  *
  * Build command:
  *   pio run -e test_15_scale_integration -t upload -t monitor
  */
 
 #include <Arduino.h>
+#include <Preferences.h>
 #include "pin_definitions.h"
+#include "button_events.h"
+#include "dose_stats.h"
+#include "esp_timer.h"
+#include "estop.h"
+#include "flow_monitor.h"
+#include "fluidnc_ctl.h"
+#include "fluidnc_status.h"
+#include "line_framer.h"
+#include "scale_weight.h"
 
 #define RodentSerial       Serial2  // To FluidNC
 #define ScaleSerial        Serial1  // To digital scale
 
+#define STATS_NVS_NS       "dose"
+#define STATS_NVS_KEY      "stats"
+
 float currentWeight = 0.0;
 float targetWeight = 10.0;  // Default target
+float stopWeight = 0.0;     // Scale reading that ends the dispense (corrected target)
 bool dispensing = false;
+bool recovering = false;    // fluidnc_ctl stop / reset in progress
 String lastWeightStr = "";  // For change detection
 unsigned long lastScaleRead = 0;
+unsigned long lastWeightMs = 0;     // Last valid reading, changed or not
+
+// Dose being scored: settled weight once the jog cancel is done
+dose_stats_t doseStats;
+dose_stats_store_t statsStore;
+char dosePump = 'X';
+char doseChemical[DOSE_STATS_NAME_MAX] = "";
+float doseStartWeight = 0.0;
+float doseTargetG = 0.0;
+float doseSetpointG = 0.0;
+int64_t doseStartUs = 0;
+uint32_t doseTimeUs = 0;
+bool settling = false;      // Target reached, not scored yet
+unsigned long stoppedMs = 0;
+const unsigned long SETTLE_MS = 1500;       // Drips and scale filter after the stop
+
+// Line assembly (never blocks, no String); Rodent status reports feed the flow monitor
+char consoleBuf[64];
+char rodentBuf[128];
+char scaleBuf[48];
+line_framer_t consoleRx;
+line_framer_t rodentRx;
+line_framer_t scaleRx;
+unsigned long lastStatusMs = 0;
+const unsigned long STATUS_POLL_MS = 250;   // '?' if auto-report goes quiet
 
 // Scale protocol parameters (based on working Python code)
 const char SCALE_CMD[] = "@P<CR><LF>";  // Command to request weight (literal text, not control chars)
@@ -61,7 +111,7 @@ EncoderState encoder = {0, false, false, false};
 EncoderButton encButton = {false, false};
 
 // Forward declarations
-void dispenseToWeight(char pump, float targetGrams, float flowRateMlMin);
+void dispenseToWeight(char pump, float targetGrams, float flowRateMlMin, const char *chemical);
 
 void sendRodentCommand(const char* cmd) {
     Serial.print("→ Rodent: ");
@@ -70,6 +120,43 @@ void sendRodentCommand(const char* cmd) {
     RodentSerial.flush();
 }
 
+/**
+ * Controller stop / reset steps: realtime bytes through the UART driver,
+ * "$X" as a line. Reports the result once it is done.
+ */
+void serviceController() {
+    fluidnc_ctl_action_t action;
+    while (fluidnc_ctl_poll(esp_timer_get_time(), &action)) {
+        if (action.kind == FLUIDNC_CTL_ACTION_REALTIME) {
+            estop_send_realtime(action.byte);
+        } else {
+            sendRodentCommand(action.line);
+        }
+    }
+
+    if (recovering && (fluidnc_ctl_ready() || fluidnc_ctl_state() == FLUIDNC_CTL_FAILED)) {
+        recovering = false;
+        fluidnc_ctl_stats_t st;
+        fluidnc_ctl_get_stats(&st);
+        if (st.state == FLUIDNC_CTL_READY) {
+            Serial.printf("Ready for next dispense (%.1f ms, resets %lu, unlocks %lu)\n", st.last_us / 1000.0f,
+                          (unsigned long)st.resets, (unsigned long)st.unlocks);
+        } else {
+            Serial.println("✗ Controller did not recover - '$' to retry");
+        }
+    }
+}
+
+void stopController(bool reset) {
+    if (reset) {
+        fluidnc_ctl_reset(esp_timer_get_time());
+    } else {
+        fluidnc_ctl_stop(esp_timer_get_time());
+    }
+    recovering = true;
+    serviceController();    // First step goes out now, the rest from loop()
+}
+
 void sendScaleCommandBurst() {
     // Send burst of commands with character-level delays
     for (int repeat = 0; repeat < REPEATS_PER_BURST; repeat++) {
@@ -84,70 +171,38 @@ void sendScaleCommandBurst() {
     ScaleSerial.flush();
 }
 
-bool parseWeight(String line, float &weight, String &unit) {
-    // Parse weight from scale response
-    // Expected format: "  +012.34 g" or similar
-    line.trim();
-    if (line.length() == 0) return false;
-
-    // Extract number (including sign and decimal point)
-    int startIdx = -1;
-    int endIdx = -1;
-
-    for (int i = 0; i < line.length(); i++) {
-        char c = line.charAt(i);
-        if ((c == '+' || c == '-' || c == '.' || (c >= '0' && c <= '9')) && startIdx == -1) {
-            startIdx = i;
-        }
-        if (startIdx != -1 && (c < '0' || c > '9') && c != '.' && c != '+' && c != '-') {
-            endIdx = i;
-            break;
-        }
-    }
-
-    if (startIdx == -1) return false;
-    if (endIdx == -1) endIdx = line.length();
-
-    String weightStr = line.substring(startIdx, endIdx);
-    weight = weightStr.toFloat();
-
-    // Extract unit (everything after the number)
-    unit = line.substring(endIdx);
-    unit.trim();
-
-    return true;
-}
-
 void readScaleWithBurst() {
     // 1. Send burst of commands
     sendScaleCommandBurst();
 
     // 2. Read responses during the window
     unsigned long windowEnd = millis() + READ_WINDOW_MS;
-    String lastReading = "";
+    char lastReading[sizeof(scaleBuf)] = "";
     float lastWeight = 0.0;
-    String lastUnit = "";
+    char lastUnit[8] = "";
+    int64_t lastReadingUs = 0;
 
+    line_framer_clear(&scaleRx);
     while (millis() < windowEnd) {
-        if (ScaleSerial.available()) {
-            String line = ScaleSerial.readStringUntil('\n');
-            line.trim();
-
-            if (line.length() > 0) {
-                float weight;
-                String unit;
-                if (parseWeight(line, weight, unit)) {
-                    lastWeight = weight;
-                    lastUnit = unit;
-                    lastReading = line;
-                }
+        line_framer_line_t line;
+        while (line_framer_read(&scaleRx, ScaleSerial, esp_timer_get_time(), &line)) {
+            float weight;
+            char unit[sizeof(lastUnit)];
+            if (scale_weight_parse(line.text, &weight, unit, sizeof(unit))) {
+                lastWeight = weight;
+                strcpy(lastUnit, unit);
+                strcpy(lastReading, line.text);
+                lastReadingUs = line.end_us;
             }
         }
         delay(2);  // Small delay to avoid tight loop
     }
 
     // 3. Process last valid reading (if changed)
-    if (lastReading.length() > 0) {
+    if (lastReading[0] != '\0') {
+        flow_monitor_on_scale(lastWeight, lastReadingUs);
+        lastWeightMs = millis();
+
         String weightStr = String(lastWeight, 2);
 
         if (weightStr != lastWeightStr) {
@@ -163,17 +218,14 @@ void readScaleWithBurst() {
             Serial.println(")");
 
             // Check if target reached during dispensing
-            if (dispensing && currentWeight >= targetWeight) {
+            if (dispensing && currentWeight >= stopWeight) {
                 Serial.println("✓ Target weight reached!");
-                sendRodentCommand("!");  // Stop
                 dispensing = false;
-                delay(100);
-                // Auto-reset for next dispense
-                RodentSerial.write(0x18);  // Ctrl-X soft reset
-                RodentSerial.flush();
-                delay(100);
-                sendRodentCommand("$X");  // Unlock
-                Serial.println("System reset - ready for next dispense");
+                doseTimeUs = (uint32_t)(lastReadingUs - doseStartUs);
+                settling = true;
+                stoppedMs = millis();
+                flow_monitor_stop();
+                stopController(false);  // Jog cancel: no reset, no unlock
             }
         }
     }
@@ -192,16 +244,17 @@ int readEncoder() {
 }
 
 bool readEncoderButton() {
-    bool pressed = (digitalRead(ENCODER_SW_PIN) == LOW);
-    if (pressed != encButton.lastPressed) {
-        delay(50);
-        pressed = (digitalRead(ENCODER_SW_PIN) == LOW);
-        if (pressed != encButton.lastPressed) {
-            encButton.lastPressed = pressed;
-            encButton.pressed = pressed;
+    // Non-blocking: debounced SELECT edges come from the button event engine
+    button_event_t ev;
+    while (button_events_poll(&ev)) {
+        if (ev.button != BUTTON_SELECT) continue;
+        if (ev.type == BUTTON_EVENT_PRESS || ev.type == BUTTON_EVENT_RELEASE) {
+            encButton.pressed = (ev.type == BUTTON_EVENT_PRESS);
+            encButton.lastPressed = encButton.pressed;
             return true;
         }
     }
+
     return false;
 }
 
@@ -218,11 +271,67 @@ void handleEncoder() {
     if (readEncoderButton() && encButton.pressed && !dispensing) {
         Serial.println("Encoder: START weight-based dispense");
         // Flow rate of 7.5 ml/min gives 150 mm/min feedrate (safe default)
-        dispenseToWeight('X', targetWeight, 7.5);
+        dispenseToWeight('X', targetWeight, 7.5, "");
     }
 }
 
-void dispenseToWeight(char pump, float targetGrams, float flowRateMlMin) {
+/**
+ * Score the dose on the settled scale: error, running figures, next correction
+ */
+void recordDose() {
+    settling = false;
+    float finalG = currentWeight - doseStartWeight;
+    const dose_stats_slot_t *slot = dose_stats_record(&doseStats, dosePump, doseChemical, doseTargetG,
+                                                      doseSetpointG, finalG, doseTimeUs, esp_timer_get_time());
+    if (!slot) return;
+    char text[128];
+    dose_stats_format(&doseStats, slot, text, sizeof(text));
+    Serial.printf("Settled: %.2f g for %.2f g (error %+.2f g, stopped at %.2f g) in %.1f s\n", finalG, doseTargetG,
+                  finalG - doseTargetG, doseSetpointG, doseTimeUs / 1e6);
+    Serial.printf("  %s\n", text);
+}
+
+void printDoseStats() {
+    Serial.println("\n=== DOSING ACCURACY ===");
+    int shown = 0;
+    for (uint8_t i = 0; i < DOSE_STATS_SLOTS; i++) {
+        const dose_stats_slot_t *slot = dose_stats_slot(&doseStats, i);
+        if (!slot) continue;
+        char text[128];
+        dose_stats_format(&doseStats, slot, text, sizeof(text));
+        dose_stats_summary_t sum;
+        dose_stats_summary(&doseStats, slot, &sum);
+        Serial.println(text);
+        Serial.printf("  offset %+.3f g, %lu outliers, time %.1f +/- %.1f s (max %.1f)\n", sum.offset_g,
+                      (unsigned long)slot->outliers, sum.mean_time_s, sum.sd_time_s, sum.max_time_s);
+        Serial.printf("  error from %+.2f g in %.2f g bins:", -DOSE_STATS_BINS / 2 * doseStats.cfg.bin_g,
+                      doseStats.cfg.bin_g);
+        for (int b = 0; b < DOSE_STATS_BINS; b++) Serial.printf(" %u", (unsigned)slot->bins[b]);
+        Serial.println();
+        shown++;
+    }
+    if (shown == 0) Serial.println("No doses yet");
+    dose_stats_stats_t st;
+    dose_stats_get_stats(&doseStats, &st);
+    Serial.printf("Recorded %lu, corrected %lu, saves %lu\n", (unsigned long)st.records, (unsigned long)st.corrected,
+                  (unsigned long)doseStats.store.saves);
+    Serial.println("=======================");
+}
+
+void dispenseToWeight(char pump, float targetGrams, float flowRateMlMin, const char *chemical) {
+    if (estop_is_latched()) {
+        Serial.println("✗ E-stop latched - press '$' to reset first");
+        return;
+    }
+    if (!fluidnc_ctl_ready()) {
+        Serial.println("✗ Controller still stopping - try again");
+        return;
+    }
+
+    if (settling) {
+        recordDose();       // Scored with what the scale shows now
+    }
+
     Serial.println("\n[Weight-Based Dispensing]");
     Serial.print("Pump: ");
     Serial.println(pump);
@@ -233,22 +342,30 @@ void dispenseToWeight(char pump, float targetGrams, float flowRateMlMin) {
     Serial.print(flowRateMlMin);
     Serial.println(" ml/min");
 
-    targetWeight = currentWeight + targetGrams;
-    dispensing = true;
+    // Stop point: the target less what this pump usually delivers after the stop
+    dosePump = pump;
+    strncpy(doseChemical, chemical, sizeof(doseChemical) - 1);
+    doseChemical[sizeof(doseChemical) - 1] = '\0';
+    doseTargetG = targetGrams;
+    doseSetpointG = dose_stats_setpoint(&doseStats, pump, doseChemical, targetGrams);
+    if (doseSetpointG != targetGrams) {
+        Serial.printf("Stop point: %.2f g (bias correction %+.2f g)\n", doseSetpointG, doseSetpointG - targetGrams);
+    }
 
-    // Reset pump position
-    char cmd[32];
-    snprintf(cmd, sizeof(cmd), "G92 %c0", pump);
-    sendRodentCommand(cmd);
-    delay(100);
+    doseStartWeight = currentWeight;
+    stopWeight = currentWeight + doseSetpointG;
+    doseStartUs = esp_timer_get_time();
+    dispensing = true;
+    flow_monitor_start(currentWeight, doseStartUs);
 
-    // Start continuous dispensing
+    // Start continuous dispensing: a relative jog, so the stop is a jog cancel
     float feedRate = flowRateMlMin / 0.05;  // Convert ml/min to mm/min
     // Constrain feedrate to max safe value for testing (300 mm/min)
     if (feedRate > 300.0) {
         feedRate = 300.0;
     }
-    snprintf(cmd, sizeof(cmd), "G1 %c1000 F%.1f", pump, feedRate);
+    char cmd[32];
+    snprintf(cmd, sizeof(cmd), "$J=G91 %c1000 F%.1f", pump, feedRate);
     sendRodentCommand(cmd);
 
     Serial.print("Dispensing... monitoring scale (feedrate: ");
@@ -256,6 +373,81 @@ void dispenseToWeight(char pump, float targetGrams, float flowRateMlMin) {
     Serial.println(" mm/min)");
 }
 
+/**
+ * Flow fault: feed hold first, then tell the operator
+ */
+void handleFlowFault(const flow_fault_t *fault) {
+    estop_send_realtime('!');
+    dispensing = false;
+    flow_monitor_stop();
+
+    char text[32];
+    flow_fault_format(fault, text, sizeof(text));
+    Serial.print("\n⚠ FLOW FAULT ");
+    Serial.println(text);
+    Serial.print("  Expected ");
+    Serial.print(fault->expected_g, 2);
+    Serial.print(" g, scale saw ");
+    Serial.print(fault->actual_g, 2);
+    Serial.println(fault->ambiguous ? " g (several pumps running)" : " g");
+    if (fault->type == FLOW_FAULT_NO_FLOW) {
+        Serial.println("  Check tube for burst / reservoir empty");
+    }
+    Serial.println("Pump stopped (jog cancelled by the hold) - 'w' to dispense again");
+}
+
+void printFlowMonitor() {
+    flow_monitor_stats_t st;
+    flow_monitor_get_stats(&st);
+    flow_fault_t fault;
+
+    Serial.println("\n=== FLOW MONITOR ===");
+    Serial.print("Armed:     ");
+    Serial.println(st.armed ? "yes" : "no");
+    Serial.print("Expected:  ");
+    Serial.print(st.expected_g, 2);
+    Serial.print(" g  (");
+    Serial.print(st.expected_rate_g_s, 3);
+    Serial.println(" g/s)");
+    Serial.print("Scale:     ");
+    Serial.print(st.actual_g, 2);
+    Serial.print(" g  (");
+    Serial.print(st.actual_rate_g_s, 3);
+    Serial.println(" g/s)");
+    Serial.print("Judgements: ");
+    Serial.println(st.evaluations);
+    if (flow_monitor_get_fault(&fault)) {
+        char text[32];
+        flow_fault_format(&fault, text, sizeof(text));
+        Serial.print("Fault:     ");
+        Serial.println(text);
+    }
+    Serial.println("====================");
+}
+
+/**
+ * Rodent responses: status reports go to the flow monitor and e-stop,
+ * everything else is echoed
+ */
+void handleRodentLine(const char *line) {
+    if (line[0] == '<') {
+        lastStatusMs = millis();
+        estop_on_status_line(line);
+
+        fluidnc_status_t status;
+        if (fluidnc_status_parse(line, &status)) {
+            fluidnc_ctl_on_status(&status, esp_timer_get_time());
+            const flow_fault_t *fault = flow_monitor_on_status(&status, esp_timer_get_time());
+            if (fault) {
+                handleFlowFault(fault);
+            }
+        }
+        return;
+    }
+    fluidnc_ctl_on_line(line, esp_timer_get_time());
+    Serial.println(line);
+}
+
 void setup() {
     Serial.begin(115200);
     delay(500);
@@ -265,22 +457,39 @@ void setup() {
     Serial.println("╚════════════════════════════════════════════════════════════╝\n");
 
     // Initialize UART to Rodent
+    // Status reports (75 ms) keep arriving during the ~1 s scale burst
+    RodentSerial.setRxBufferSize(1024);
     RodentSerial.begin(115200, SERIAL_8N1, UART_TEST_RX_PIN, UART_TEST_TX_PIN);
     Serial.println("✓ Rodent UART initialized");
 
     // Initialize encoder
     pinMode(ENCODER_CLK_PIN, INPUT_PULLUP);
     pinMode(ENCODER_DT_PIN, INPUT_PULLUP);
-    pinMode(ENCODER_SW_PIN, INPUT);
     encoder.clkState = digitalRead(ENCODER_CLK_PIN);
     encoder.dtState = digitalRead(ENCODER_DT_PIN);
     encoder.lastClkState = encoder.clkState;
     encoder.position = 0;
+    button_events_init();  // Encoder SW (SELECT) via interrupt-driven events
     Serial.println("✓ Encoder initialized");
 
+    estop_init(RODENT_UART_NUM, 115200);
+    flow_monitor_init(NULL);
+    fluidnc_ctl_init(NULL);
+    Serial.println("✓ Flow monitor initialized (stall / tube-failure detection)");
+
     // Initialize UART to Scale
     ScaleSerial.begin(SCALE_BAUD_RATE, SERIAL_8N1, SCALE_RX_PIN, SCALE_TX_PIN);
-    Serial.println("✓ Scale UART initialized\n");
+    line_framer_init(&consoleRx, consoleBuf, sizeof(consoleBuf), LINE_FRAMER_DROP);
+    line_framer_init(&rodentRx, rodentBuf, sizeof(rodentBuf), LINE_FRAMER_DROP);
+    line_framer_init(&scaleRx, scaleBuf, sizeof(scaleBuf), LINE_FRAMER_DROP);
+    Serial.println("✓ Scale UART initialized");
+
+    Preferences prefs;
+    prefs.begin(STATS_NVS_NS);
+    bool stored = prefs.getBytes(STATS_NVS_KEY, &statsStore, sizeof(statsStore)) == sizeof(statsStore);
+    prefs.end();
+    dose_stats_init(&doseStats, NULL, stored ? &statsStore : NULL);
+    Serial.printf("✓ Dose statistics %s\n\n", stored ? "restored" : "empty");
 
     Serial.println("Controls:");
     Serial.println("  ENCODER rotate  - Adjust target weight (0.5-100g)");
@@ -288,17 +497,23 @@ void setup() {
     Serial.println("\nCommands:");
     Serial.println("  w <pump> <grams> <flowrate> - Dispense to weight");
     Serial.println("  Example: w X 10.5 15.0 (dispense 10.5g via pump X @ 15ml/min)");
+    Serial.println("  w <pump> <grams> <flowrate> <chemical> - Same, figures kept per chemical");
+    Serial.println("  a - Dosing accuracy (error, overshoot, correction per pump and chemical)");
+    Serial.println("  a clear [pump] - Forget the figures (after a tube change)");
     Serial.println("  t - Tare scale (zero)");
     Serial.println("  r - Read scale");
-    Serial.println("  s - Stop dispensing");
-    Serial.println("  ! or x - EMERGENCY STOP (stop pump immediately)");
-    Serial.println("  ~ or c - Resume from HOLD (after emergency stop)");
-    Serial.println("  $ - Reset system (Ctrl-X + unlock)\n");
+    Serial.println("  s - Stop dispensing (jog cancel, no reset)");
+    Serial.println("  ! or x - EMERGENCY STOP (feed hold straight into the UART FIFO)");
+    Serial.println("  ~ or c - Resume from HOLD (G-code moves only; a hold ends a jog)");
+    Serial.println("  f - Flow monitor status");
+    Serial.println("  $ - Reset system (stop, Ctrl-X, unlock if alarmed)\n");
 
     delay(1000);
 }
 
 void loop() {
+    estop_service();
+
     // Handle encoder (runs fast for good responsiveness)
     handleEncoder();
 
@@ -306,7 +521,7 @@ void loop() {
     // - When dispensing: poll frequently (every 200ms) for quick response
     // - When idle: poll slowly (every 2 seconds) to keep encoder responsive
     unsigned long now = millis();
-    unsigned long scaleInterval = dispensing ? 200 : 2000;  // 200ms when dispensing, 2s when idle
+    unsigned long scaleInterval = dispensing || settling ? 200 : 2000;  // 200ms when dispensing, 2s when idle
 
     if (now - lastScaleRead >= scaleInterval) {
         readScaleWithBurst();
@@ -314,52 +529,78 @@ void loop() {
     }
 
     // Handle user commands
-    if (Serial.available()) {
-        String input = Serial.readStringUntil('\n');
-        input.trim();
+    line_framer_line_t line;
+    if (line_framer_read(&consoleRx, Serial, esp_timer_get_time(), &line)) {
+        const char *input = line.text;
 
-        if (input.startsWith("w ")) {
+        if (strncmp(input, "w ", 2) == 0) {
             char pump;
             float grams, flowrate;
-            if (sscanf(input.c_str(), "w %c %f %f", &pump, &grams, &flowrate) == 3) {
-                dispenseToWeight(pump, grams, flowrate);
+            char chemical[DOSE_STATS_NAME_MAX] = "";
+            if (sscanf(input, "w %c %f %f %15s", &pump, &grams, &flowrate, chemical) >= 3) {
+                dispenseToWeight(pump, grams, flowrate, chemical);
             }
-        } else if (input == "t") {
+        } else if (strcmp(input, "t") == 0) {
             // Tare command (varies by scale - this is generic)
             ScaleSerial.println("T");
             Serial.println("Taring scale...");
-        } else if (input == "r") {
+        } else if (strcmp(input, "r") == 0) {
             Serial.println("Reading scale...");
             readScaleWithBurst();
-        } else if (input == "s") {
-            sendRodentCommand("!");
+        } else if (strcmp(input, "s") == 0) {
             dispensing = false;
-            Serial.println("Stopped");
-        } else if (input == "!" || input == "x") {
+            flow_monitor_stop();
+            Serial.println("Stopping...");
+            stopController(false);
+        } else if (strcmp(input, "!") == 0 || strcmp(input, "x") == 0) {
             Serial.println("\n⚠ EMERGENCY STOP!");
             sendRodentCommand("!");
             dispensing = false;
-            Serial.println("Pump stopped (HOLD state)");
-            Serial.println("Type '~' to resume or '$' to reset");
-        } else if (input == "~" || input == "c") {
+            flow_monitor_stop();
+            Serial.println("Pump stopped (a hold ends the dispense jog)");
+            Serial.println("Type 'w' to dispense again or '$' to reset");
+        } else if (strcmp(input, "~") == 0 || strcmp(input, "c") == 0) {
             Serial.println("\nResuming from HOLD...");
             sendRodentCommand("~");
             Serial.println("System resumed");
-        } else if (input == "$") {
+        } else if (strcmp(input, "f") == 0) {
+            printFlowMonitor();
+        } else if (strcmp(input, "a") == 0) {
+            printDoseStats();
+        } else if (strncmp(input, "a clear", 7) == 0) {
+            char pump = '\0';
+            sscanf(input, "a clear %c", &pump);
+            Serial.printf("Dose statistics cleared (%u)\n", (unsigned)dose_stats_reset(&doseStats, pump, NULL));
+        } else if (strcmp(input, "$") == 0) {
             Serial.println("\nResetting system...");
-            RodentSerial.write(0x18);  // Ctrl-X soft reset
-            RodentSerial.flush();
-            delay(100);
-            sendRodentCommand("$X");  // Unlock
-            Serial.println("System reset and unlocked");
+            estop_clear();
+            dispensing = false;
+            flow_monitor_stop();
+            stopController(true);   // Ends on the banner / "ok", not on a sleep
         }
     }
 
-    // Echo Rodent responses
-    if (RodentSerial.available()) {
-        while (RodentSerial.available()) {
-            Serial.write(RodentSerial.read());
-        }
+    // Rodent responses, one line at a time
+    while (line_framer_read(&rodentRx, RodentSerial, esp_timer_get_time(), &line)) {
+        handleRodentLine(line.text);
+    }
+    serviceController();    // After the reports: a long scale burst is not a stop timeout
+
+    // Score the dose once the pump is stopped and the scale has had time to settle
+    if (settling && fluidnc_ctl_ready() && (long)(lastWeightMs - stoppedMs) >= (long)SETTLE_MS) {
+        recordDose();
+    }
+    if (dose_stats_save(&doseStats, esp_timer_get_time(), &statsStore)) {
+        Preferences prefs;
+        prefs.begin(STATS_NVS_NS);
+        prefs.putBytes(STATS_NVS_KEY, &statsStore, sizeof(statsStore));
+        prefs.end();
+    }
+
+    // Auto-report covers motion; poll only if it goes quiet
+    if (dispensing && millis() - lastStatusMs >= STATUS_POLL_MS) {
+        estop_send_realtime('?');
+        lastStatusMs = millis();
     }
 
     delay(10);
@@ -16,6 +16,22 @@
  * - Execute multi-step mixing procedures
  * - Provide user feedback during execution
  * - Use encoder for recipe selection
+ * - Reset ('$') without sleeps: Ctrl-X after motion has stopped, then the
+ *   banner and a status report decide whether $X is needed (fluidnc_ctl.h)
+ * - Feeds capped by each pump's max rate as FluidNC reports it ("$$" at
+ *   start-up, fluidnc_config.h), not only by SAFE_TEST_FEEDRATE
+ * - Batch queue (batch_queue.h): N batches of one or more recipes run back
+ *   to back, the next one planned while the current one dispenses, with a
+ *   container-swap handshake between batches; the queue is kept in NVS
+ *   and comes back HELD after a reboot
+ * - Dosing journal (dose_journal.h): the running batch's steps and MPos
+ *   checkpoints go to flash ("spiffs", first 64 KB), so after a reset or a
+ *   stop START / 'g' resumes the batch where it stopped instead of running
+ *   it again from the start
+ * - Reservoir stock (inventory.h): drawn by the pumps' actual travel,
+ *   saved to NVS in coalesced writes; a batch the stock cannot complete
+ *   is blocked before it starts, and queueing warns which batch will be
+ *   the first one short
  *
  * Build command:
  *   pio run -e test_16_recipe_system -t upload -t monitor
@@ -23,12 +39,29 @@
 
 #include <Arduino.h>
 #include <LiquidCrystal_I2C.h>
+#include <Preferences.h>
 #include "pin_definitions.h"
+#include "batch_queue.h"
+#include "button_events.h"
+#include "console.h"
+#include "dose_journal.h"
+#include "inventory.h"
+#include "esp_timer.h"
+#include "fluidnc_config.h"
+#include "fluidnc_ctl.h"
+#include "fluidnc_status.h"
+#include "line_framer.h"
 
 #define UartSerial         Serial2
 
 LiquidCrystal_I2C lcd(LCD_I2C_ADDR, 16, 2);
 
+// FluidNC line assembly (never blocks, no String)
+char uartBuf[128];
+line_framer_t uartRx;
+
+console_t console;
+
 // Encoder state
 struct EncoderState {
     int32_t position;
@@ -38,68 +71,66 @@ struct EncoderState {
     bool lastClkState;
 };
 
-struct EncoderButton {
-    bool pressed;
-    bool lastPressed;
-};
-
 EncoderState encoder = {0, 0, false, false, false};
-EncoderButton encButton = {false, false};
-
-// Button states
-bool lastStartState = HIGH;
-bool lastStopState = HIGH;
 
-struct Ingredient {
-    char pump;
-    float volumeMl;
-    float flowRateMlMin;
-};
-
-struct Recipe {
-    const char* name;
-    Ingredient* ingredients;
-    int stepCount;
-};
-
-// Define recipes
-Ingredient cleaningRecipe[] = {
+// Define recipes (pump, ml, ml/min). The queue stores recipes by index: append only
+const batch_step_t cleaningRecipe[] = {
     {'X', 5.0, 30.0},
     {'Y', 5.0, 30.0},
     {'Z', 5.0, 30.0},
     {'A', 5.0, 30.0}
 };
 
-Ingredient colorMixRecipe[] = {
+const batch_step_t colorMixRecipe[] = {
     {'X', 10.0, 15.0},  // Cyan base
     {'Y', 5.0, 10.0},   // Magenta
     {'Z', 2.5, 10.0}    // Yellow
 };
 
-Ingredient nutrientMixRecipe[] = {
+const batch_step_t nutrientMixRecipe[] = {
     {'X', 20.0, 25.0},  // Water
     {'Y', 2.0, 5.0},    // Concentrate A
     {'Z', 1.5, 5.0},    // Concentrate B
     {'A', 0.5, 2.0}     // Additive
 };
 
-Recipe recipes[] = {
+const batch_recipe_t recipes[] = {
     {"Cleaning Flush", cleaningRecipe, 4},
     {"Color Mix", colorMixRecipe, 3},
     {"Nutrient Mix", nutrientMixRecipe, 4}
 };
 const int recipeCount = 3;
 
-enum SystemMode { MODE_BROWSE, MODE_EXECUTING };
-SystemMode mode = MODE_BROWSE;
-
 int selectedRecipe = 0;  // Currently selected (browsing)
-int currentRecipe = -1;  // Currently executing
-int currentStep = 0;
-bool waitingForCompletion = false;
 
 const float ML_PER_MM = 0.05;
-const float SAFE_TEST_FEEDRATE = 300.0; // Max feedrate for testing safety
+const float SAFE_TEST_FEEDRATE = 300.0; // Max feedrate for testing safety (axis max rate caps it further)
+bool configReported = false;
+
+// Batch queue: what the display last showed, and NVS
+#define QUEUE_NVS_NS       "batch"
+#define QUEUE_NVS_KEY      "queue"
+#define STOCK_NVS_KEY      "stock"
+#define STOCK_DEFAULT_ML   1000.0f  // First boot: every reservoir this size and full
+#define STOCK_RESERVE_ML   20.0f    // Dead volume (also covers the draws a reset loses)
+#define SWAP_TIMED_MS      10000    // Default for "w timed"
+batch_queue_state_t shownState = BATCH_QUEUE_IDLE;
+uint8_t shownStep = 0;
+uint32_t shownDone = 0;
+int64_t batchStartUs = 0;
+
+// Dosing journal: fed by status reports, polled while there is a batch to follow
+#define JOURNAL_PARTITION  "spiffs"
+#define STATUS_POLL_MS     250
+#define STATUS_FRESH_MS    1000     // A resume needs an Idle report at most this old
+dose_journal_t journal;
+fluidnc_status_t lastStatus;
+int64_t lastStatusUs = -1;
+int64_t statusAskUs = 0;
+bool statusEcho = false;            // 's' asked: print the next report
+
+// Reservoir stock, one chemical per pump
+inventory_t inventory;
 
 void sendCommand(const char* cmd) {
     Serial.print("→ ");
@@ -108,6 +139,60 @@ void sendCommand(const char* cmd) {
     UartSerial.flush();
 }
 
+/**
+ * Realtime command as a single byte: "!\n" would also be an empty line,
+ * answered with an "ok" the batch queue would take for its own
+ */
+void sendRealtime(char c) {
+    Serial.print("→ ");
+    Serial.println(c);
+    UartSerial.write(c);
+}
+
+/**
+ * fluidnc_ctl steps: realtime bytes written straight to the UART, "$X" as a line;
+ * then the limits discovery ("$I", "$$") once no recovery owns the line
+ */
+void serviceController() {
+    fluidnc_ctl_action_t action;
+    while (fluidnc_ctl_poll(esp_timer_get_time(), &action)) {
+        if (action.kind == FLUIDNC_CTL_ACTION_REALTIME) {
+            UartSerial.write(action.byte);
+        } else {
+            sendCommand(action.line);
+        }
+    }
+    if (!fluidnc_ctl_ready()) return;
+
+    const char *line = fluidnc_config_poll(esp_timer_get_time());
+    if (line) sendCommand(line);
+    line = batch_queue_poll(esp_timer_get_time());     // Only while RUNNING, one line per "ok"
+    if (line) sendCommand(line);
+
+    fluidnc_config_state_t cs = fluidnc_config_state();
+    if (configReported || (cs != FLUIDNC_CONFIG_DONE && cs != FLUIDNC_CONFIG_FAILED)) return;
+    configReported = true;
+    if (cs == FLUIDNC_CONFIG_FAILED) {
+        Serial.printf("⚠ FluidNC limits not read - feeds capped at %.0f mm/min\n", SAFE_TEST_FEEDRATE);
+        return;
+    }
+    const fluidnc_config_t *c = fluidnc_config_get();
+    for (int i = 0; i < c->axis_count; i++) {
+        Serial.printf("✓ Pump %c: max %.0f mm/min, %.0f mm/s², %.1f steps/mm\n", "XYZA"[i],
+                      c->axes[i].max_rate_mm_min, c->axes[i].accel_mm_s2, c->axes[i].steps_per_mm);
+    }
+}
+
+/**
+ * SAFE_TEST_FEEDRATE, or the pump's max rate if FluidNC reported a lower one
+ */
+float maxFeedFor(char pump) {
+    const char *axes = "XYZA";
+    const char *p = strchr(axes, pump);
+    float limit = fluidnc_config_max_feed(fluidnc_config_get(), p ? (int)(p - axes) : -1, SAFE_TEST_FEEDRATE);
+    return limit < SAFE_TEST_FEEDRATE ? limit : SAFE_TEST_FEEDRATE;
+}
+
 int readEncoder() {
     encoder.clkState = digitalRead(ENCODER_CLK_PIN);
 
@@ -132,21 +217,11 @@ int readEncoder() {
     return 0;
 }
 
-bool readEncoderButton() {
-    bool pressed = (digitalRead(ENCODER_SW_PIN) == LOW);
-
-    if (pressed != encButton.lastPressed) {
-        delay(50);
-        pressed = (digitalRead(ENCODER_SW_PIN) == LOW);
-
-        if (pressed != encButton.lastPressed) {
-            encButton.lastPressed = pressed;
-            encButton.pressed = pressed;
-            return true;
-        }
-    }
-
-    return false;
+/**
+ * Counts on the 16-column LCD: at most 999, so every line fits its buffer
+ */
+unsigned lcdCount(uint32_t n) {
+    return n > 999 ? 999 : (unsigned)n;
 }
 
 void updateLCD(const char* line1, const char* line2) {
@@ -164,57 +239,144 @@ void updateBrowseDisplay() {
     updateLCD(line1, line2);
 }
 
-void executeRecipeStep(Recipe& recipe, int step) {
-    if (step >= recipe.stepCount) {
-        Serial.println("\n✓ Recipe complete!");
-        updateLCD("Recipe Complete!", recipe.name);
-        mode = MODE_BROWSE;
-        delay(2000);
+/**
+ * Queue state on the LCD: browsing when idle, else batch, step and pump
+ */
+void updateQueueDisplay() {
+    const batch_plan_t *plan = batch_queue_current();
+    batch_queue_state_t st = batch_queue_state();
+    if (st == BATCH_QUEUE_IDLE) {
         updateBrowseDisplay();
         return;
     }
 
-    Ingredient ing = recipe.ingredients[step];
-    float distMm = ing.volumeMl / ML_PER_MM;
-    float feedRate = ing.flowRateMlMin / ML_PER_MM;
+    char line1[17], line2[17];
+    if (plan == nullptr) {              // Restored from NVS, not planned yet
+        snprintf(line1, sizeof(line1), "Queued: %u", lcdCount(batch_queue_remaining()));
+        updateLCD(line1, "START to run");
+        return;
+    }
+    snprintf(line1, sizeof(line1), "Batch %u/%u %s", lcdCount(plan->batch + 1), lcdCount(plan->batches),
+             st == BATCH_QUEUE_RUNNING ? "" : batch_queue_state_name(st));
+    if (st == BATCH_QUEUE_RUNNING && shownStep < plan->step_count) {
+        const batch_move_t *m = &plan->steps[shownStep];
+        snprintf(line2, sizeof(line2), "%d/%d %c %.1fml", shownStep + 1, plan->step_count, m->pump, m->ml);
+    } else if (st == BATCH_QUEUE_SWAP) {
+        snprintf(line2, sizeof(line2), "Swap, then START");
+    } else if (st == BATCH_QUEUE_BLOCKED) {
+        snprintf(line2, sizeof(line2), "Blocked: see log");
+    } else {
+        snprintf(line2, sizeof(line2), "START to run");
+    }
+    updateLCD(line1, line2);
+}
 
-    // Constrain feedrate to max safe value for testing
-    if (feedRate > SAFE_TEST_FEEDRATE) {
-        feedRate = SAFE_TEST_FEEDRATE;
+void printPlan(const batch_plan_t *plan) {
+    Serial.printf("\n[Batch %u/%u of job #%lu] %d steps, ~%.1f s\n", plan->batch + 1, plan->batches,
+                  (unsigned long)plan->job_id, plan->step_count, plan->est_ms / 1000.0f);
+    for (int i = 0; i < plan->step_count; i++) {
+        const batch_move_t *m = &plan->steps[i];
+        Serial.printf("  %d. %-14s pump %c: %.1f ml (%.1f mm/min)%s\n", i + 1, recipes[m->recipe].name, m->pump,
+                      m->ml, m->feed_mm_min, i < plan->first_step ? "  done" : "");
+    }
+    if (plan->first_done_mm > 0.0f) {
+        Serial.printf("  resumed in step %d: %.2f ml already in\n", plan->first_step + 1,
+                      plan->first_done_mm * ML_PER_MM);
     }
+}
+
+/**
+ * Plan of the batch at the head of the queue, if the journal holds it as interrupted
+ */
+bool interruptedBatch(batch_plan_t *plan) {
+    const batch_job_t *job = batch_queue_job(0);
+    return job != nullptr && batch_queue_plan(job, job->done, plan) && dose_journal_matches(&journal, plan);
+}
 
-    Serial.println("\n[" + String(recipe.name) + "]");
-    Serial.print("Step ");
-    Serial.print(step + 1);
-    Serial.print("/");
-    Serial.println(recipe.stepCount);
-    Serial.print("Pump ");
-    Serial.print(ing.pump);
-    Serial.print(": ");
-    Serial.print(ing.volumeMl);
-    Serial.print("ml @ ");
-    Serial.print(ing.flowRateMlMin);
-    Serial.print("ml/min (");
-    Serial.print(feedRate, 1);
-    Serial.println(" mm/min)");
+void journalStarted(const batch_plan_t *plan, int64_t now_us) {
+    (void)now_us;
+    if (!dose_journal_start(&journal, plan, NAN)) Serial.println("⚠ No MPos from FluidNC yet - batch not journaled");
+    inventory_started(&inventory, plan);
+}
 
-    // Update LCD
-    char lcdLine1[17], lcdLine2[17];
-    snprintf(lcdLine1, sizeof(lcdLine1), "%s %d/%d", recipe.name, step + 1, recipe.stepCount);
-    snprintf(lcdLine2, sizeof(lcdLine2), "Pump %c: %.1fml", ing.pump, ing.volumeMl);
-    updateLCD(lcdLine1, lcdLine2);
+void journalFinished(const batch_plan_t *plan, int64_t now_us) {
+    (void)plan;
+    (void)now_us;
+    dose_journal_done(&journal, NAN);
+    inventory_finished(&inventory);
+}
 
-    // Reset position
-    char cmd[64];
-    snprintf(cmd, sizeof(cmd), "G92 %c0", ing.pump);
-    sendCommand(cmd);
-    delay(100);
+const char *checkStock(const batch_plan_t *plan) {
+    return inventory_check(&inventory, plan);
+}
+
+/**
+ * The queued batches against the stock: which reservoir runs short first, and when
+ */
+void warnStock() {
+    inventory_forecast_t forecast[INVENTORY_PUMPS];
+    if (inventory_forecast(&inventory, forecast) == 0) return;
+    for (int p = 0; p < INVENTORY_PUMPS; p++) {
+        const inventory_forecast_t *f = &forecast[p];
+        if (f->job_id == 0) continue;
+        const inventory_reservoir_t *r = inventory_reservoir(&inventory, "XYZA"[p]);
+        Serial.printf("⚠ %s (pump %c) runs short at batch %u of job #%lu, after %lu batches (~%lu min): "
+                      "%.0f ml short - refill, then 'fill %c'\n", r->name[0] ? r->name : "Reservoir", "XYZA"[p],
+                      f->batch + 1, (unsigned long)f->job_id, (unsigned long)f->batches_ok,
+                      (unsigned long)(f->empty_ms / 60000), -f->left_ml, "XYZA"[p]);
+    }
+}
 
-    // Execute
-    snprintf(cmd, sizeof(cmd), "G1 %c%.2f F%.1f", ing.pump, distMm, feedRate);
-    sendCommand(cmd);
+/**
+ * Start the queue, continue it after a hold, or confirm the container swap
+ */
+void runQueue() {
+    if (fluidnc_config_busy() || !fluidnc_ctl_ready()) {
+        Serial.println("Still reading the FluidNC limits / recovering - try again");
+        return;
+    }
+    // An interrupted batch goes on where it stopped, by the journal and FluidNC's position
+    int64_t now = esp_timer_get_time();
+    batch_queue_state_t qs = batch_queue_state();
+    batch_plan_t plan;
+    bool ok;
+    if ((qs == BATCH_QUEUE_HELD || qs == BATCH_QUEUE_BLOCKED) && interruptedBatch(&plan)) {
+        if (lastStatusUs < 0 || now - lastStatusUs > STATUS_FRESH_MS * 1000LL ||
+            lastStatus.state != FLUIDNC_STATE_IDLE) {
+            Serial.println("Waiting for FluidNC to be Idle ('~' or '$' after a stop) - try again");
+            sendRealtime('?');
+            return;
+        }
+        dose_journal_point_t point;
+        dose_journal_point(&journal, &plan, &lastStatus, &point);
+        Serial.printf("Resuming batch %u/%u in step %u/%u, %.2f ml in (%s position)\n", plan.batch + 1,
+                      plan.batches, point.step + 1, plan.step_count, point.done_ml,
+                      point.live ? "FluidNC's" : "journaled");
+        ok = batch_queue_resume(now, point.step, point.done_mm);
+    } else {
+        ok = batch_queue_run(now);
+    }
+    if (!ok) {
+        batch_queue_stats_t st;
+        batch_queue_get_stats(&st);
+        if (st.state == BATCH_QUEUE_BLOCKED) {
+            Serial.printf("✗ Batch cannot run: %s\n", st.blocked ? st.blocked : "?");
+        } else if (st.state == BATCH_QUEUE_IDLE) {
+            Serial.println("Queue empty");
+        }
+    }
+}
 
-    waitingForCompletion = true;
+void queueBatches(const uint8_t *ids, uint8_t count, uint16_t batches) {
+    uint32_t id = batch_queue_add(ids, count, batches);
+    if (id == 0) {
+        Serial.println("✗ Not queued (queue full, unknown recipe or too many steps)");
+        return;
+    }
+    Serial.printf("Queued job #%lu: %u x", (unsigned long)id, batches);
+    for (uint8_t i = 0; i < count; i++) Serial.printf("%s %s", i ? " +" : "", recipes[ids[i]].name);
+    Serial.printf(" (%lu batches queued)\n", (unsigned long)batch_queue_remaining());
+    warnStock();
 }
 
 void startRecipe(int recipeIndex) {
@@ -222,20 +384,78 @@ void startRecipe(int recipeIndex) {
         Serial.println("Invalid recipe index");
         return;
     }
+    uint8_t id = (uint8_t)recipeIndex;
+    queueBatches(&id, 1, 1);
+    if (batch_queue_state() == BATCH_QUEUE_HELD) runQueue();
+}
 
-    currentRecipe = recipeIndex;
-    currentStep = 0;
-    mode = MODE_EXECUTING;
+/**
+ * Console / LCD follow-up on queue changes, and the queue saved when it changed
+ */
+void serviceQueue() {
+    batch_queue_stats_t st;
+    batch_queue_get_stats(&st);
+    int64_t now = esp_timer_get_time();
+
+    if (st.batches_done != shownDone) {
+        shownDone = st.batches_done;
+        Serial.printf("✓ Batch done in %.1f s (%lu to go)\n", (now - batchStartUs) / 1e6,
+                      (unsigned long)batch_queue_remaining());
+        if (st.state == BATCH_QUEUE_IDLE) Serial.println("\n✓ Queue complete!");
+    }
+    uint8_t step = batch_queue_step(now);
+    if (st.state != shownState || step != shownStep) {
+        if (st.state == BATCH_QUEUE_RUNNING && shownState != BATCH_QUEUE_RUNNING) {
+            batchStartUs = now;
+            printPlan(batch_queue_current());
+            if (shownState == BATCH_QUEUE_SWAP) {
+                Serial.printf("  container swap %.1f s, restart %.1f ms\n", st.swap_us_last / 1e6,
+                              st.gap_us_last / 1000.0);
+            }
+        } else if (st.state == BATCH_QUEUE_SWAP && shownState != BATCH_QUEUE_SWAP) {
+            Serial.println("Swap the container, then START / 'g'");
+        } else if (st.state == BATCH_QUEUE_BLOCKED && shownState != BATCH_QUEUE_BLOCKED) {
+            Serial.printf("✗ Next batch blocked: %s\n", st.blocked ? st.blocked : "?");
+        }
+        shownState = st.state;
+        shownStep = step;
+        updateQueueDisplay();
+    }
 
-    Serial.println("\nStarting recipe: " + String(recipes[recipeIndex].name));
-    updateLCD("Starting:", recipes[recipeIndex].name);
-    delay(1000);
+    batch_queue_store_t store;
+    if (batch_queue_save(&store)) {
+        Preferences prefs;
+        prefs.begin(QUEUE_NVS_NS);
+        prefs.putBytes(QUEUE_NVS_KEY, &store, sizeof(store));
+        prefs.end();
+    }
+    inventory_store_t stock;
+    if (inventory_save(&inventory, now, &stock)) {       // Coalesced: not one write per report
+        Preferences prefs;
+        prefs.begin(QUEUE_NVS_NS);
+        prefs.putBytes(STOCK_NVS_KEY, &stock, sizeof(stock));
+        prefs.end();
+    }
 
-    executeRecipeStep(recipes[currentRecipe], currentStep);
+    // Reports for the journal: progress while running, the position a batch starts or resumes from
+    if ((st.state != BATCH_QUEUE_IDLE || journal.batch.open) && now - statusAskUs >= STATUS_POLL_MS * 1000LL) {
+        statusAskUs = now;
+        UartSerial.write('?');
+    }
+}
+
+/**
+ * Motion stopped (STOP, reset): the journal keeps the batch's progress for the next START
+ */
+void holdQueue() {
+    if (batch_queue_state() == BATCH_QUEUE_RUNNING) {
+        Serial.println("Batch held - START / 'g' resumes it where it stopped, 'fresh' runs it from the start");
+    }
+    batch_queue_hold();
 }
 
 void handleEncoder() {
-    if (mode == MODE_BROWSE) {
+    if (batch_queue_state() == BATCH_QUEUE_IDLE) {
         int direction = readEncoder();
         if (direction != 0) {
             selectedRecipe = ((encoder.position % recipeCount) + recipeCount) % recipeCount;
@@ -244,40 +464,271 @@ void handleEncoder() {
             updateBrowseDisplay();
         }
     }
+}
 
-    // Encoder button press
-    if (readEncoderButton() && encButton.pressed) {
-        if (mode == MODE_BROWSE) {
-            Serial.println("Encoder SELECT: Starting recipe");
-            startRecipe(selectedRecipe);
+void handleButtons() {
+    // Debounced events from the button engine - never blocks, STOP first
+    button_event_t ev;
+    while (button_events_poll(&ev)) {
+        if (ev.type != BUTTON_EVENT_PRESS) continue;
+
+        switch (ev.button) {
+            case BUTTON_STOP:
+                sendRealtime('!');
+                Serial.println("STOP button: Emergency stop");
+                holdQueue();
+                break;
+
+            case BUTTON_SELECT:
+                if (batch_queue_state() == BATCH_QUEUE_IDLE) {
+                    Serial.println("Encoder SELECT: Starting recipe");
+                    startRecipe(selectedRecipe);
+                }
+                break;
+
+            case BUTTON_START:
+                if (batch_queue_state() == BATCH_QUEUE_IDLE) {
+                    Serial.println("START button: Starting recipe");
+                    startRecipe(selectedRecipe);
+                } else if (batch_queue_state() != BATCH_QUEUE_RUNNING) {
+                    Serial.println("START button: Running the queue");
+                    runQueue();
+                }
+                break;
+
+            default:
+                break;
         }
     }
 }
 
-void handleButtons() {
-    bool startPressed = (digitalRead(START_BUTTON_PIN) == LOW);
-    bool stopPressed = (digitalRead(STOP_BUTTON_PIN) == LOW);
-
-    // START button
-    if (startPressed && !lastStartState) {
-        if (mode == MODE_BROWSE) {
-            Serial.println("START button: Starting recipe");
-            startRecipe(selectedRecipe);
+// ============================================================================
+// CONSOLE COMMANDS
+// ============================================================================
+
+console_status_t cmdRecipe(console_call_t *call) {
+    startRecipe(atoi(call->cmd->name) - 1);
+    return CONSOLE_DONE;
+}
+
+console_status_t cmdStop(console_call_t *call) {
+    (void)call;
+    Serial.println("\n⚠ EMERGENCY STOP!");
+    sendRealtime('!');
+    holdQueue();
+    Serial.println("All pumps stopped (HOLD state)");
+    Serial.println("Type '~' to resume or '$' to reset");
+    return CONSOLE_DONE;
+}
+
+console_status_t cmdResume(console_call_t *call) {
+    (void)call;
+    Serial.println("\nResuming from HOLD...");
+    sendRealtime('~');
+    Serial.println("System resumed");
+    return CONSOLE_DONE;
+}
+
+console_status_t cmdReset(console_call_t *call) {
+    if (call->step == 0) {
+        Serial.println("\nResetting system...");
+        holdQueue();
+        fluidnc_ctl_reset(esp_timer_get_time());
+        serviceController();
+        return CONSOLE_MORE;
+    }
+
+    // Done on the banner and a report (plus "ok" to $X if it was locked)
+    fluidnc_ctl_stats_t st;
+    fluidnc_ctl_get_stats(&st);
+    if (st.state == FLUIDNC_CTL_READY) {
+        Serial.printf("System reset%s in %.1f ms\n", st.unlocks ? " and unlocked" : "", st.last_us / 1000.0f);
+        updateQueueDisplay();
+        return CONSOLE_DONE;
+    }
+    if (st.state == FLUIDNC_CTL_FAILED) {
+        Serial.println("✗ No answer from FluidNC after Ctrl-X - check the UART");
+        return CONSOLE_DONE;
+    }
+    return CONSOLE_MORE;
+}
+
+console_status_t cmdStatus(console_call_t *call) {
+    (void)call;
+    statusEcho = true;          // Reports polled for the journal are not printed
+    sendRealtime('?');
+    return CONSOLE_DONE;
+}
+
+console_status_t cmdBatch(console_call_t *call) {
+    uint8_t ids[BATCH_QUEUE_MAX_RECIPES];
+    uint8_t count = 0;
+    for (int i = 1; i < call->argc && count < BATCH_QUEUE_MAX_RECIPES; i++) {
+        long r = call->arg[i].i;
+        if (r < 1 || r > recipeCount) {
+            console_printf(call, "Unknown recipe %ld\n", r);
+            return CONSOLE_DONE;
         }
+        ids[count++] = (uint8_t)(r - 1);
+    }
+    long batches = call->arg[0].i;
+    if (batches < 1 || batches > 9999) {
+        console_printf(call, "1-9999 batches\n");
+        return CONSOLE_DONE;
     }
+    queueBatches(ids, count, (uint16_t)batches);
+    return CONSOLE_DONE;
+}
 
-    // STOP button
-    if (stopPressed && !lastStopState) {
-        sendCommand("!");
-        Serial.println("STOP button: Emergency stop");
-        mode = MODE_BROWSE;
-        updateBrowseDisplay();
+console_status_t cmdGo(console_call_t *call) {
+    (void)call;
+    runQueue();
+    return CONSOLE_DONE;
+}
+
+console_status_t cmdQueue(console_call_t *call) {
+    batch_queue_stats_t st;
+    batch_queue_get_stats(&st);
+    console_printf(call, "Queue %s: %lu batches to go, %lu done, next %s\n", batch_queue_state_name(st.state),
+                   (unsigned long)batch_queue_remaining(), (unsigned long)st.batches_done,
+                   st.next_ready ? "planned" : st.blocked ? st.blocked : "-");
+    for (uint8_t i = 0; const batch_job_t *j = batch_queue_job(i); i++) {
+        console_printf(call, "  #%lu %u/%u:", (unsigned long)j->id, j->done, j->batches);
+        for (uint8_t r = 0; r < j->recipe_count; r++) console_printf(call, " %s", recipes[j->recipes[r]].name);
+        console_printf(call, "\n");
+    }
+    console_printf(call, "  restart after a batch: last %.1f ms, max %.1f ms\n", st.gap_us_last / 1000.0,
+                   st.gap_us_max / 1000.0);
+    return CONSOLE_DONE;
+}
+
+console_status_t cmdClear(console_call_t *call) {
+    if (batch_queue_clear()) {
+        dose_journal_abort(&journal);
+        inventory_finished(&inventory);
+        console_printf(call, "Queue cleared\n");
+    } else {
+        console_printf(call, "Running - stop first\n");
+    }
+    updateQueueDisplay();
+    return CONSOLE_DONE;
+}
+
+console_status_t cmdFresh(console_call_t *call) {
+    if (batch_queue_state() == BATCH_QUEUE_RUNNING) {
+        console_printf(call, "Running - stop first\n");
+    } else if (!journal.batch.open) {
+        console_printf(call, "No interrupted batch\n");
+    } else {
+        dose_journal_abort(&journal);
+        console_printf(call, "Interrupted batch dropped: START / 'g' runs it again from the start\n");
+    }
+    return CONSOLE_DONE;
+}
+
+console_status_t cmdStock(console_call_t *call) {
+    inventory_forecast_t forecast[INVENTORY_PUMPS];
+    inventory_forecast(&inventory, forecast);
+    for (int p = 0; p < INVENTORY_PUMPS; p++) {
+        const inventory_reservoir_t *r = inventory_reservoir(&inventory, "XYZA"[p]);
+        if (r->capacity_ml <= 0.0f) {
+            console_printf(call, "  %c  not tracked\n", "XYZA"[p]);
+            continue;
+        }
+        console_printf(call, "  %c  %-15s %6.1f / %.0f ml (reserve %.0f), queued %.1f ml", "XYZA"[p],
+                       r->name[0] ? r->name : "-", r->stock_ml, r->capacity_ml, r->reserve_ml, forecast[p].demand_ml);
+        if (forecast[p].job_id != 0) {
+            console_printf(call, " - SHORT at batch %u of job #%lu\n", forecast[p].batch + 1,
+                           (unsigned long)forecast[p].job_id);
+        } else {
+            console_printf(call, "\n");
+        }
+    }
+    inventory_stats_t st;
+    inventory_get_stats(&inventory, &st);
+    console_printf(call, "  %lu draws in %lu writes, %lu batches blocked\n", (unsigned long)st.draws,
+                   (unsigned long)st.saves, (unsigned long)st.blocked);
+    return CONSOLE_DONE;
+}
+
+console_status_t cmdStockSet(console_call_t *call) {
+    const inventory_reservoir_t *r = inventory_reservoir(&inventory, (char)toupper(call->arg[0].c));
+    float reserve = call->argc > 2 ? call->arg[2].f : (r ? r->reserve_ml : STOCK_RESERVE_ML);
+    const char *name = call->argc > 3 ? call->arg[3].s : NULL;
+    if (!inventory_set(&inventory, (char)toupper(call->arg[0].c), name, call->arg[1].f, reserve, 1.0f)) {
+        console_printf(call, "Pump X Y Z A, reserve below the capacity\n");
+    }
+    return CONSOLE_DONE;
+}
+
+console_status_t cmdFill(console_call_t *call) {
+    char pump = (char)toupper(call->arg[0].c);
+    float ml = call->argc > 1 ? call->arg[1].f : -1.0f;
+    bool ok = false;
+    for (int p = 0; p < INVENTORY_PUMPS; p++) {
+        if (pump == '*' || pump == "XYZA"[p]) ok |= inventory_refill(&inventory, "XYZA"[p], ml);
+    }
+    if (!ok) console_printf(call, "No tracked reservoir on %c ('stock' sets one up)\n", pump);
+    if (ok && batch_queue_state() == BATCH_QUEUE_BLOCKED) console_printf(call, "Refilled - START / 'g' goes on\n");
+    return CONSOLE_DONE;
+}
+
+console_status_t cmdJournal(console_call_t *call) {
+    dose_journal_stats_t st;
+    dose_journal_get_stats(&journal, &st);
+    const dose_journal_batch_t *b = &journal.batch;
+    if (b->open) {
+        console_printf(call, "Open: job #%u batch %u, step %u, MPos %.2f %.2f %.2f %.2f\n", b->job, b->batch + 1,
+                       b->step + 1, b->pos[0], b->pos[1], b->pos[2], b->pos[3]);
+    } else {
+        console_printf(call, "No batch open\n");
     }
+    console_printf(call, "%lu records (%lu checkpoints), %lu sector erases (max %lu per sector), %lu write errors, "
+                   "slowest write %.1f ms\n", (unsigned long)st.records, (unsigned long)st.checkpoints,
+                   (unsigned long)st.erases, (unsigned long)st.max_erase_count, (unsigned long)st.write_errors,
+                   st.max_write_us / 1000.0);
+    return CONSOLE_DONE;
+}
 
-    lastStartState = startPressed;
-    lastStopState = stopPressed;
+console_status_t cmdSwap(console_call_t *call) {
+    static const char *const names[] = {"none", "confirm", "timed"};
+    for (int m = 0; m < 3; m++) {
+        if (strcasecmp(call->arg[0].s, names[m]) != 0) continue;
+        uint32_t ms = call->argc > 1 ? (uint32_t)call->arg[1].i : SWAP_TIMED_MS;
+        batch_queue_set_swap((batch_swap_t)m, ms);
+        if (m == BATCH_SWAP_TIMED) {
+            console_printf(call, "Container swap: %lu ms between batches\n", (unsigned long)ms);
+        } else {
+            console_printf(call, "Container swap: %s\n", names[m]);
+        }
+        return CONSOLE_DONE;
+    }
+    console_printf(call, "none | confirm | timed [ms]\n");
+    return CONSOLE_DONE;
 }
 
+const console_cmd_t commands[] = {
+    {"1", "", "Run one Cleaning Flush", cmdRecipe, 0},
+    {"2", "", "Run one Color Mix", cmdRecipe, 0},
+    {"3", "", "Run one Nutrient Mix", cmdRecipe, 0},
+    {"b", "ii?iii", "Queue batches: b <count> <recipe> [recipe...]", cmdBatch, 0},
+    {"g", "", "Run the queue / container swapped", cmdGo, 0},
+    {"q", "", "Show the queue", cmdQueue, 0},
+    {"clr", "", "Clear the queue", cmdClear, 0},
+    {"w", "s?i", "Container swap: none | confirm | timed [ms]", cmdSwap, 0},
+    {"fresh", "", "Drop the interrupted batch's progress (run it from the start)", cmdFresh, 0},
+    {"j", "", "Show the dosing journal", cmdJournal, 0},
+    {"inv", "", "Show the reservoir stock against the queue", cmdStock, 0},
+    {"stock", "cf?fs", "Set up a reservoir: stock <pump> <capacity ml> [reserve ml] [name]", cmdStockSet, 0},
+    {"fill", "c?f", "Reservoir refilled: fill <pump|*> [ml] (default full)", cmdFill, 0},
+    {"!", "", "Emergency stop", cmdStop, CONSOLE_IMMEDIATE},
+    {"x", "", "Emergency stop", cmdStop, CONSOLE_IMMEDIATE},
+    {"~", "", "Resume from HOLD", cmdResume, 0},
+    {"c", "", "Resume from HOLD", cmdResume, 0},
+    {"$", "", "Reset system (Ctrl-X, unlock if alarmed)", cmdReset, 0},
+    {"s", "", "Query status", cmdStatus, 0},
+};
+
 void setup() {
     Serial.begin(115200);
     delay(500);
@@ -295,20 +746,33 @@ void setup() {
     // Initialize encoder
     pinMode(ENCODER_CLK_PIN, INPUT_PULLUP);
     pinMode(ENCODER_DT_PIN, INPUT_PULLUP);
-    pinMode(ENCODER_SW_PIN, INPUT);
     encoder.clkState = digitalRead(ENCODER_CLK_PIN);
     encoder.dtState = digitalRead(ENCODER_DT_PIN);
     encoder.lastClkState = encoder.clkState;
     encoder.position = 0;
     Serial.println("✓ Encoder initialized");
 
-    // Initialize buttons
-    pinMode(START_BUTTON_PIN, INPUT_PULLUP);
-    pinMode(STOP_BUTTON_PIN, INPUT_PULLUP);
+    // Initialize buttons (START, STOP, encoder SELECT) - interrupt-driven events
+    button_events_init();
     Serial.println("✓ Buttons initialized");
 
     // Initialize UART
     UartSerial.begin(115200, SERIAL_8N1, UART_TEST_RX_PIN, UART_TEST_TX_PIN);
+    line_framer_init(&uartRx, uartBuf, sizeof(uartBuf), LINE_FRAMER_DROP);
+    fluidnc_ctl_init(NULL);
+    fluidnc_config_init(NULL);
+    fluidnc_config_start(NULL, esp_timer_get_time());     // No cache here: "$$" every start
+    batch_queue_config_t queueCfg = BATCH_QUEUE_DEFAULT_CONFIG;
+    queueCfg.recipes = recipes;
+    queueCfg.recipe_count = recipeCount;
+    queueCfg.ml_per_mm = ML_PER_MM;
+    queueCfg.max_feed = maxFeedFor;
+    queueCfg.check = checkStock;
+    queueCfg.started = journalStarted;
+    queueCfg.finished = journalFinished;
+    batch_queue_init(&queueCfg);
+    console_io_t io = console_stream_io(Serial);
+    console_init(&console, commands, sizeof(commands) / sizeof(commands[0]), &io);
     Serial.println("✓ UART initialized\n");
 
     Serial.println("Available Recipes:");
@@ -318,23 +782,74 @@ void setup() {
         Serial.print(". ");
         Serial.print(recipes[i].name);
         Serial.print(" (");
-        Serial.print(recipes[i].stepCount);
+        Serial.print(recipes[i].step_count);
         Serial.println(" steps)");
     }
 
+    // Queue left from before the reset: HELD until START / 'g' (check the container first)
+    batch_queue_store_t store;
+    Preferences prefs;
+    prefs.begin(QUEUE_NVS_NS);
+    if (prefs.getBytes(QUEUE_NVS_KEY, &store, sizeof(store)) == sizeof(store) && batch_queue_load(&store) &&
+        batch_queue_remaining() > 0) {
+        Serial.printf("\n⚠ %lu queued batches restored - check the container, then START / 'g'\n",
+                      (unsigned long)batch_queue_remaining());
+    }
+
+    // Reservoir stock as last saved; first boot: full reservoirs of the default size
+    inventory_store_t stock;
+    bool stored = prefs.getBytes(STOCK_NVS_KEY, &stock, sizeof(stock)) == sizeof(stock);
+    prefs.end();
+    inventory_config_t stockCfg = INVENTORY_DEFAULT_CONFIG;
+    stockCfg.ml_per_mm = ML_PER_MM;
+    inventory_init(&inventory, &stockCfg, stored ? &stock : NULL);
+    inventory_set_recipes(&inventory, recipes, recipeCount);
+    if (!stored) {
+        for (int p = 0; p < INVENTORY_PUMPS; p++) {
+            inventory_set(&inventory, "XYZA"[p], NULL, STOCK_DEFAULT_ML, STOCK_RESERVE_ML, 1.0f);
+            inventory_refill(&inventory, "XYZA"[p], -1.0f);
+        }
+        Serial.printf("⚠ Reservoir stock not set up - assuming %.0f ml, full ('stock', 'fill')\n", STOCK_DEFAULT_ML);
+    }
+    warnStock();
+    shownState = batch_queue_state();
+
+    // Batch interrupted by the reset: offer to go on where it stopped
+    if (!dose_journal_init(&journal, JOURNAL_PARTITION, NULL)) {
+        Serial.println("⚠ No \"" JOURNAL_PARTITION "\" partition - batches are not journaled");
+    }
+    batch_plan_t plan;
+    dose_journal_point_t point;
+    if (interruptedBatch(&plan) && dose_journal_point(&journal, &plan, nullptr, &point)) {
+        Serial.printf("⚠ Batch %u/%u of job #%lu stopped in step %u/%u", plan.batch + 1, plan.batches,
+                      (unsigned long)plan.job_id, point.step + 1, plan.step_count);
+        if (point.step < plan.step_count) {
+            Serial.printf(" (pump %c, %.2f of %.2f ml)", plan.steps[point.step].pump, point.done_ml,
+                          plan.steps[point.step].ml);
+        }
+        Serial.println("\n  START / 'g' resumes it there, 'fresh' runs it again from the start");
+    }
+
     Serial.println("\nControls:");
     Serial.println("  ENCODER rotate  - Browse recipes");
     Serial.println("  ENCODER button  - Start selected recipe");
-    Serial.println("  START button    - Start selected recipe");
+    Serial.println("  START button    - Start selected recipe / run the queue / container swapped");
     Serial.println("  STOP button     - Emergency stop");
     Serial.println("  Serial: 1-3     - Start recipe by number");
+    Serial.println("  Serial: b N r.. - Queue N batches of recipes r.. (e.g. b 40 2 3)");
+    Serial.println("  Serial: g / q   - Run the queue / show it");
+    Serial.println("  Serial: w mode  - Container swap: none, confirm, timed [ms]");
+    Serial.println("  Serial: fresh   - Run an interrupted batch from the start, not where it stopped");
+    Serial.println("  Serial: inv     - Reservoir stock; stock X 1000 20 Water / fill X - set up / refilled");
     Serial.println("  Serial: ! or x  - Emergency stop");
     Serial.println("  Serial: ~ or c  - Resume from HOLD");
-    Serial.println("  Serial: $       - Reset system\n");
+    Serial.println("  Serial: $       - Reset system");
+    Serial.println("  Serial: help    - List commands\n");
 
-    updateBrowseDisplay();
+    updateQueueDisplay();
     delay(1000);
-    sendCommand("?");
+    statusEcho = true;
+    sendRealtime('?');
 }
 
 void loop() {
@@ -342,55 +857,39 @@ void loop() {
     handleEncoder();
     handleButtons();
 
-    // Handle serial commands
-    if (Serial.available()) {
-        String input = Serial.readStringUntil('\n');
-        input.trim();
-
-        int recipeNum = input.toInt();
-        if (recipeNum >= 1 && recipeNum <= recipeCount) {
-            startRecipe(recipeNum - 1);
-        } else if (input == "!" || input == "x") {
-            Serial.println("\n⚠ EMERGENCY STOP!");
-            sendCommand("!");
-            mode = MODE_BROWSE;
-            waitingForCompletion = false;
-            updateBrowseDisplay();
-            Serial.println("All pumps stopped (HOLD state)");
-            Serial.println("Type '~' to resume or '$' to reset");
-        } else if (input == "~" || input == "c") {
-            Serial.println("\nResuming from HOLD...");
-            sendCommand("~");
-            Serial.println("System resumed");
-        } else if (input == "$") {
-            Serial.println("\nResetting system...");
-            UartSerial.write(0x18);  // Ctrl-X soft reset
-            UartSerial.flush();
-            delay(100);
-            sendCommand("$X");  // Unlock
-            Serial.println("System reset and unlocked");
-        } else if (input == "s") {
-            sendCommand("?");
-        }
-    }
+    // Handle serial commands (every complete line, never blocks)
+    console_poll(&console, esp_timer_get_time());
 
     // Process UART responses
-    if (UartSerial.available()) {
-        String response = UartSerial.readStringUntil('\n');
-        response.trim();
-        Serial.print("← ");
-        Serial.println(response);
-
-        // Check completion
-        if (waitingForCompletion && response.indexOf("Idle") >= 0) {
-            waitingForCompletion = false;
-            currentStep++;
-            delay(500);
-            if (mode == MODE_EXECUTING) {
-                executeRecipeStep(recipes[currentRecipe], currentStep);
+    line_framer_line_t line;
+    if (line_framer_read(&uartRx, UartSerial, esp_timer_get_time(), &line)) {
+        const char *response = line.text;
+
+        // Batch completion is the "ok" to its closing "G4 P0" (batch_queue.h), not an Idle report
+        fluidnc_status_t status;
+        if (fluidnc_status_parse(response, &status)) {
+            if (statusEcho) {
+                Serial.print("← ");
+                Serial.println(response);
+                statusEcho = false;
+            }
+            fluidnc_ctl_on_status(&status, esp_timer_get_time());
+            dose_journal_update(&journal, &status, NAN, esp_timer_get_time());
+            inventory_update(&inventory, &status, esp_timer_get_time());
+            lastStatus = status;
+            lastStatusUs = esp_timer_get_time();
+        } else {
+            Serial.print("← ");
+            Serial.println(response);
+            if (!fluidnc_config_on_line(response, esp_timer_get_time()) &&
+                !batch_queue_on_line(response, esp_timer_get_time())) {
+                if (strncmp(response, "ALARM", 5) == 0) holdQueue();
+                fluidnc_ctl_on_line(response, esp_timer_get_time());
             }
         }
     }
+    serviceController();
+    serviceQueue();
 
     delay(1);
 }
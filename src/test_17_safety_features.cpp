@@ -12,14 +12,16 @@
  * - Test emergency stop functionality
  * - Verify safety interlocks
  * - Test alarm conditions
- * - Validate safety response times
+ * - Validate safety response times (press-to-Hold latency, 'l' command)
  *
  * Safety Features:
- * - Hardware emergency stop button
+ * - Hardware emergency stop button (ISR -> '!' in the UART FIFO, see estop.h)
  * - Software e-stop command
  * - Timeout protection
  * - Alarm state detection
  * - Visual/audio feedback
+ * - Reset ('r') ends on FluidNC's answer, not a sleep: $X only if a report
+ *   shows Alarm, Ctrl-X only if still held (fluidnc_ctl.h)
  *
  * Build command:
  *   pio run -e test_17_safety_features -t upload -t monitor
@@ -30,11 +32,23 @@
 #include <WiFi.h>
 #include "esp_bt.h"
 #include "pin_definitions.h"
+#include "button_events.h"
+#include "esp_timer.h"
+#include "estop.h"
+#include "fluidnc_ctl.h"
+#include "fluidnc_status.h"
+#include "line_framer.h"
 
 #define UartSerial         Serial2
 
 CRGB leds[LED_TOTAL_COUNT];
 
+// Console and FluidNC line assembly (never blocks, no String)
+char consoleBuf[64];
+char uartBuf[128];
+line_framer_t consoleRx;
+line_framer_t uartRx;
+
 enum SafetyState {
     SAFE_NORMAL,
     SAFE_WARNING,
@@ -48,6 +62,7 @@ unsigned long lastCommandTime = 0;
 const unsigned long HEARTBEAT_TIMEOUT = 5000;  // 5 seconds
 const unsigned long COMMAND_TIMEOUT = 30000;   // 30 seconds max run time
 bool systemRunning = false;
+bool resetting = false;     // fluidnc_ctl recovery after 'r'
 
 void sendCommand(const char* cmd) {
     Serial.print("→ ");
@@ -83,9 +98,8 @@ void triggerEmergencyStop(const char* reason) {
     Serial.print("Reason: ");
     Serial.println(reason);
 
-    sendCommand("!");  // Feed hold
-    delay(100);
-    sendCommand("\x18");  // Soft reset (Ctrl-X)
+    // '!' goes out immediately; Ctrl-X follows from estop_service() once Hold:0 is seen
+    estop_trigger(reason);
 
     safetyState = SAFE_ESTOP;
     systemRunning = false;
@@ -105,21 +119,53 @@ void checkSafety() {
         return;
     }
 
-    // Check hardware e-stop button
-    if (digitalRead(STOP_BUTTON_PIN) == LOW) {
-        triggerEmergencyStop("Hardware E-Stop button pressed");
-        return;
+    // Hardware e-stop button: the ISR already sent '!', just reflect the latch
+    if (estop_is_latched() && safetyState != SAFE_ESTOP) {
+        Serial.println("\n!!! EMERGENCY STOP !!!");
+        Serial.println("Reason: Hardware E-Stop button pressed");
+        safetyState = SAFE_ESTOP;
+        systemRunning = false;
+        updateSafetyLEDs();
     }
 }
 
 void resetSafety() {
     Serial.println("Resetting safety system...");
-    sendCommand("$X");  // Unlock alarm
-    delay(500);
-    safetyState = SAFE_NORMAL;
+    if (estop_is_latched() && !estop_clear()) {
+        Serial.println("✗ E-Stop still active - release STOP and wait for reset");
+        return;
+    }
     systemRunning = false;
-    updateSafetyLEDs();
-    Serial.println("✓ Safety system reset - SAFE to operate");
+    resetting = true;
+    fluidnc_ctl_stop(esp_timer_get_time());
+}
+
+/**
+ * Recovery steps after 'r' (realtime bytes on the e-stop FIFO path); SAFE
+ * once FluidNC reports Idle
+ */
+void serviceReset() {
+    fluidnc_ctl_action_t action;
+    while (fluidnc_ctl_poll(esp_timer_get_time(), &action)) {
+        if (action.kind == FLUIDNC_CTL_ACTION_REALTIME) {
+            estop_send_realtime(action.byte);
+        } else {
+            sendCommand(action.line);
+        }
+    }
+    if (!resetting) return;
+
+    fluidnc_ctl_stats_t st;
+    fluidnc_ctl_get_stats(&st);
+    if (st.state == FLUIDNC_CTL_READY) {
+        resetting = false;
+        safetyState = SAFE_NORMAL;
+        updateSafetyLEDs();
+        Serial.printf("✓ Safety system reset in %.1f ms - SAFE to operate\n", st.last_us / 1000.0f);
+    } else if (st.state == FLUIDNC_CTL_FAILED) {
+        resetting = false;
+        Serial.println("✗ FluidNC did not come back to Idle - 'r' to retry");
+    }
 }
 
 void setup() {
@@ -142,15 +188,17 @@ void setup() {
     updateSafetyLEDs();
     Serial.println("✓ Safety LEDs initialized (WiFi/BT disabled)");
 
-    // Initialize buttons
-    pinMode(START_BUTTON_PIN, INPUT_PULLUP);
-    pinMode(MODE_BUTTON_PIN, INPUT_PULLUP);
-    pinMode(STOP_BUTTON_PIN, INPUT_PULLUP);
-    Serial.println("✓ Safety buttons initialized");
-
-    // Initialize UART
+    // Initialize UART (driver must exist before the e-stop binds to it)
     UartSerial.begin(115200, SERIAL_8N1, UART_TEST_RX_PIN, UART_TEST_TX_PIN);
-    Serial.println("✓ UART initialized\n");
+    line_framer_init(&consoleRx, consoleBuf, sizeof(consoleBuf), LINE_FRAMER_DROP);
+    line_framer_init(&uartRx, uartBuf, sizeof(uartBuf), LINE_FRAMER_DROP);
+    Serial.println("✓ UART initialized");
+
+    // Initialize buttons and the ISR e-stop path
+    button_events_init();
+    estop_init(RODENT_UART_NUM, 115200);
+    fluidnc_ctl_init(NULL);
+    Serial.println("✓ Safety buttons initialized (STOP on ISR)\n");
 
     Serial.println("Safety Features:");
     Serial.println("  • Hardware E-Stop button (STOP)");
@@ -167,20 +215,22 @@ void setup() {
     Serial.println("  t - Test run (5 second move)");
     Serial.println("  e - Software e-stop");
     Serial.println("  r - Reset safety system");
-    Serial.println("  h - Send heartbeat\n");
+    Serial.println("  h - Send heartbeat");
+    Serial.println("  l - E-Stop latency report (p50/p99/max per stage)\n");
 }
 
 void loop() {
     // Continuous safety check
+    estop_service();
     checkSafety();
     updateSafetyLEDs();
 
     // Handle user commands
-    if (Serial.available()) {
-        String input = Serial.readStringUntil('\n');
-        input.trim();
+    line_framer_line_t line;
+    if (line_framer_read(&consoleRx, Serial, esp_timer_get_time(), &line)) {
+        const char *input = line.text;
 
-        if (input == "t") {
+        if (strcmp(input, "t") == 0) {
             if (safetyState == SAFE_NORMAL) {
                 Serial.println("Starting test run...");
                 systemRunning = true;
@@ -191,36 +241,51 @@ void loop() {
             } else {
                 Serial.println("Cannot run - system not in SAFE state!");
             }
-        } else if (input == "e") {
+        } else if (strcmp(input, "e") == 0) {
             triggerEmergencyStop("Software e-stop command");
-        } else if (input == "r") {
+        } else if (strcmp(input, "r") == 0) {
             resetSafety();
-        } else if (input == "h") {
+        } else if (strcmp(input, "h") == 0) {
             lastHeartbeat = millis();
             Serial.println("Heartbeat updated");
+        } else if (strcmp(input, "l") == 0) {
+            estop_report();
         }
     }
 
-    // Process responses
-    if (UartSerial.available()) {
-        String response = UartSerial.readStringUntil('\n');
-        response.trim();
+    // Process responses (drain all, so status lines are timestamped promptly)
+    while (line_framer_read(&uartRx, UartSerial, esp_timer_get_time(), &line)) {
+        const char *response = line.text;
         Serial.print("← ");
         Serial.println(response);
 
+        if (estop_on_status_line(response)) {
+            estop_status_t st;
+            estop_get_status(&st);
+            Serial.printf("⏱  E-Stop -> Hold: %lu us\n", (unsigned long)st.last_latency_us);
+        }
+
+        fluidnc_status_t status;
+        if (fluidnc_status_parse(response, &status)) {
+            fluidnc_ctl_on_status(&status, esp_timer_get_time());
+        } else {
+            fluidnc_ctl_on_line(response, esp_timer_get_time());
+        }
+
         // Check for alarm state
-        if (response.indexOf("ALARM") >= 0) {
+        if (strstr(response, "ALARM") != NULL) {
             safetyState = SAFE_ALARM;
             systemRunning = false;
             Serial.println("⚠️  ALARM detected!");
         }
 
         // Check for idle (task complete)
-        if (response.indexOf("Idle") >= 0 && systemRunning) {
+        if (strstr(response, "Idle") != NULL && systemRunning) {
             Serial.println("✓ Task completed safely");
             systemRunning = false;
         }
     }
+    serviceReset();
 
     delay(50);
 }
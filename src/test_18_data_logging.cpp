@@ -12,20 +12,23 @@
  * - Monitor system performance
  * - Generate operation reports
  *
- * Logged Data:
- * - Timestamp
- * - Command sent
- * - Response received
- * - Duration
- * - Success/failure status
+ * Logged Data (one 32-byte event_log.h record per command, in flash):
+ * - Timestamp (boot number + microseconds since boot)
+ * - Command number and its first 4 characters
+ * - Duration to the response
+ * - Result: ok / error / timeout
+ * - Hold, resume and reset events
  *
  * Features:
  * - Intelligent logging: Only logs actual commands, not status queries
  * - Verbose mode: Toggle to see all status updates
  * - Rate limiting: Status queries every 5 seconds (not logged unless verbose)
  * - Response timeout: 2 second timeout for command responses
- * - Circular buffer: Stores last 50 log entries
- * - Statistics: Command success rate, uptime, memory usage
+ * - Persistent log: wear-leveled ring in the "spiffs" partition of the
+ *   default partition table, ~44 000 records, survives resets; no heap use
+ * - Binary dump ('d') for audits; decode the capture to CSV with
+ *   host/evlog/evlog_decode.py
+ * - Statistics: Command success rate, uptime, memory usage, log wear
  *
  * Build command:
  *   pio run -e test_18_data_logging -t upload -t monitor
@@ -33,38 +36,61 @@
 
 #include <Arduino.h>
 #include "pin_definitions.h"
+#include "console.h"
+#include "esp_timer.h"
+#include "event_log.h"
+#include "line_framer.h"
 
 #define UartSerial         Serial2
 
-struct LogEntry {
-    unsigned long timestamp;
-    String command;
-    String response;
-    unsigned long duration;
-    bool success;
-};
-
-#define MAX_LOG_ENTRIES 50
-LogEntry logBuffer[MAX_LOG_ENTRIES];
-int logIndex = 0;
+event_log_t evlog;
 int totalCommands = 0;
 int successfulCommands = 0;
 int failedCommands = 0;
 
 unsigned long commandStartTime = 0;
-String lastCommand = "";
+int64_t commandStartUs = 0;
+uint16_t commandId = 0;             // Numbers every command sent this boot
+uint32_t commandTag = 0;            // First 4 characters, stored in the record
+bool loggingCommand = false;        // Current command gets a record
 bool waitingForResponse = false;
 bool verboseLogging = false;  // Only log actual commands, not status updates
 unsigned long lastStatusQuery = 0;
 const unsigned long STATUS_QUERY_INTERVAL = 5000;  // Query status every 5 seconds
 
+// FluidNC line assembly (never blocks, no String)
+char uartBuf[128];
+line_framer_t uartRx;
+
+console_t console;
+#define CONSOLE_TX_BUFFER   1024    // Log dumps stream out without blocking the loop
+#define LOG_LINE_MAX        96      // Longest printed log line
+event_log_cursor_t dumpCursor;      // Position of the running 'l' / 'd' dump
+uint32_t dumpCount = 0;             // Records sent by the running 'd'
+uint32_t dumpCrc = 0;
+bool binaryDump = false;            // No text output while set
+
+/**
+ * First 4 characters of a command, little endian (decoders print them as text)
+ */
+uint32_t commandTagOf(const char *cmd) {
+    uint32_t tag = 0;
+    for (int i = 0; i < 4 && cmd[i]; i++) {
+        tag |= (uint32_t)(uint8_t)cmd[i] << (8 * i);
+    }
+    return tag;
+}
+
 void logCommand(const char* cmd, bool isStatusQuery = false) {
-    lastCommand = String(cmd);
     commandStartTime = millis();
+    commandStartUs = esp_timer_get_time();
+    commandId++;
+    commandTag = commandTagOf(cmd);
+    loggingCommand = !isStatusQuery || verboseLogging;
     waitingForResponse = true;
 
     // Only print non-status queries or when verbose logging is enabled
-    if (!isStatusQuery || verboseLogging) {
+    if (loggingCommand && !binaryDump) {
         Serial.print("[");
         Serial.print(millis());
         Serial.print("] → ");
@@ -75,27 +101,19 @@ void logCommand(const char* cmd, bool isStatusQuery = false) {
     UartSerial.flush();
 }
 
-void logResponse(String response, bool isStatusResponse = false) {
+void logResponse(const char *response, bool isStatusResponse = false) {
     if (!waitingForResponse) return;
 
     unsigned long duration = millis() - commandStartTime;
-    bool success = (response.indexOf("ok") >= 0) || (response.indexOf("Idle") >= 0) ||
-                   (response.indexOf("Run") >= 0) || (response.indexOf("Jog") >= 0);
+    bool success = strstr(response, "ok") != NULL || strstr(response, "Idle") != NULL ||
+                   strstr(response, "Run") != NULL || strstr(response, "Jog") != NULL;
 
     // Only log actual commands, not status queries (unless verbose mode)
     bool shouldLog = !isStatusResponse || verboseLogging;
 
     if (shouldLog) {
-        // Add to log buffer
-        LogEntry entry;
-        entry.timestamp = commandStartTime;
-        entry.command = lastCommand;
-        entry.response = response;
-        entry.duration = duration;
-        entry.success = success;
-
-        logBuffer[logIndex % MAX_LOG_ENTRIES] = entry;
-        logIndex++;
+        event_log_append(&evlog, EVENT_COMMAND, success ? EVENT_RESULT_OK : EVENT_RESULT_ERROR, commandId,
+                         (uint32_t)(esp_timer_get_time() - commandStartUs), NAN, commandTag);
 
         totalCommands++;
         if (success) {
@@ -104,6 +122,10 @@ void logResponse(String response, bool isStatusResponse = false) {
             failedCommands++;
         }
 
+        if (binaryDump) {
+            waitingForResponse = false;
+            return;
+        }
         Serial.print("[");
         Serial.print(millis());
         Serial.print("] ← ");
@@ -139,34 +161,192 @@ void printStatistics() {
     Serial.print("Free heap:           ");
     Serial.print(ESP.getFreeHeap() / 1024.0, 1);
     Serial.println(" KB");
+    Serial.printf("Log records:         %lu of %lu (%lu sectors, boot %u)\n",
+                  (unsigned long)event_log_count(&evlog), (unsigned long)event_log_capacity(&evlog),
+                  (unsigned long)evlog.sectors, (unsigned)evlog.boot);
+    Serial.printf("Log wear:            max %lu erases per sector\n", (unsigned long)evlog.max_erase_count);
+    Serial.printf("Log dropped/errors:  %lu / %lu\n", (unsigned long)evlog.dropped,
+                  (unsigned long)evlog.write_errors);
     Serial.println();
 }
 
-void printLog(int count) {
-    Serial.println("\n╔════════════════════════════════════════════════════════════╗");
-    Serial.println("║                      Command Log                           ║");
-    Serial.println("╚════════════════════════════════════════════════════════════╝");
+/**
+ * One record as a log line
+ */
+void printRecord(console_call_t *call, const event_record_t &rec) {
+    char tag[5] = {0};
+    for (int i = 0; i < 4; i++) {
+        uint8_t c = (uint8_t)(rec.arg >> (8 * i));
+        tag[i] = (c >= 0x20 && c < 0x7F) ? (char)c : '\0';
+        if (tag[i] == '\0') break;
+    }
+    console_printf(call, "[%u:%lu.%03lus] %-10s #%-5u %-4s %-7s (%lums)%s\n", (unsigned)rec.boot,
+                   (unsigned long)(rec.t_us / 1000000), (unsigned long)(rec.t_us / 1000 % 1000),
+                   event_type_name(rec.type), (unsigned)rec.cmd_id, rec.type == EVENT_COMMAND ? tag : "",
+                   event_result_name(rec.result), (unsigned long)(rec.duration_us / 1000),
+                   rec.result == EVENT_RESULT_OK ? " ✓" : " ✗");
+}
 
-    int startIdx = max(0, logIndex - count);
-    int entries = min(count, logIndex);
+// ============================================================================
+// CONSOLE COMMANDS
+// ============================================================================
 
-    for (int i = startIdx; i < startIdx + entries; i++) {
-        LogEntry entry = logBuffer[i % MAX_LOG_ENTRIES];
-        Serial.print("[");
-        Serial.print(entry.timestamp / 1000);
-        Serial.print("s] ");
-        Serial.print(entry.command);
-        Serial.print(" → ");
-        Serial.print(entry.response.substring(0, 30));
-        Serial.print(" (");
-        Serial.print(entry.duration);
-        Serial.print("ms) ");
-        Serial.println(entry.success ? "✓" : "✗");
+/**
+ * Log listing from flash: as many records per loop pass as the TX buffer takes
+ */
+console_status_t cmdLog(console_call_t *call) {
+    if (call->step == 0) {
+        uint32_t count = call->argc > 0 && call->arg[0].i > 0 ? (uint32_t)call->arg[0].i : 10;
+        while (event_log_service(&evlog, EVENT_LOG_STAGE) > 0) {
+        }
+        call->cursor = event_log_seek(&evlog, &dumpCursor, count);
+        console_printf(call, "\n╔════════════════════════════════════════════════════════════╗\n");
+        console_printf(call, "║                      Command Log                           ║\n");
+        console_printf(call, "╚════════════════════════════════════════════════════════════╝\n");
     }
-    Serial.println();
+
+    event_record_t rec;
+    while (call->cursor > 0) {
+        if (console_room(call) < LOG_LINE_MAX) return CONSOLE_MORE;
+        if (!event_log_next(&evlog, &dumpCursor, &rec)) {
+            console_printf(call, "[log overwritten under the listing]\n");
+            break;
+        }
+        printRecord(call, rec);
+        call->cursor--;
+    }
+    console_printf(call, "\n");
+    return CONSOLE_DONE;
 }
 
+/**
+ * Binary dump for host/evlog/evlog_decode.py: header, records, trailer
+ */
+console_status_t cmdDump(console_call_t *call) {
+    if (call->step == 0) {
+        uint32_t count = call->argc > 0 ? (uint32_t)call->arg[0].i : 0;     // 0 = everything
+        while (event_log_service(&evlog, EVENT_LOG_STAGE) > 0) {
+        }
+        call->cursor = event_log_seek(&evlog, &dumpCursor, count);
+        event_log_dump_header_t header;
+        event_log_dump_header(&evlog, &dumpCursor, call->cursor, &header);
+        console_write(call, &header, sizeof(header));
+        dumpCount = 0;
+        dumpCrc = 0;
+        binaryDump = true;
+    }
+
+    event_record_t rec;
+    while (call->cursor > 0) {
+        if (console_room(call) < sizeof(rec) + sizeof(event_log_dump_trailer_t)) return CONSOLE_MORE;
+        if (!event_log_next(&evlog, &dumpCursor, &rec)) break;     // Trailer count tells the decoder
+        console_write(call, &rec, sizeof(rec));
+        dumpCrc = event_log_crc32(dumpCrc, &rec, sizeof(rec));
+        dumpCount++;
+        call->cursor--;
+    }
+    if (console_room(call) < sizeof(event_log_dump_trailer_t)) return CONSOLE_MORE;
+    event_log_dump_trailer_t trailer;
+    event_log_dump_trailer(dumpCount, dumpCrc, &trailer);
+    console_write(call, &trailer, sizeof(trailer));
+    binaryDump = false;
+    return CONSOLE_DONE;
+}
+
+console_status_t cmdExecute(console_call_t *call) {
+    logCommand(call->arg[0].s);
+    return CONSOLE_DONE;
+}
+
+console_status_t cmdStop(console_call_t *call) {
+    console_abort(call->console);   // Also ends a running dump
+    binaryDump = false;
+    Serial.println("\n⚠ EMERGENCY STOP!");
+    event_log_append(&evlog, EVENT_HOLD, EVENT_RESULT_OK, commandId, 0, NAN, 0);
+    logCommand("!");
+    Serial.println("All pumps stopped (HOLD state)");
+    Serial.println("Type '~' to resume or '$' to reset");
+    return CONSOLE_DONE;
+}
+
+console_status_t cmdResume(console_call_t *call) {
+    (void)call;
+    Serial.println("\nResuming from HOLD...");
+    event_log_append(&evlog, EVENT_RESUME, EVENT_RESULT_OK, commandId, 0, NAN, 0);
+    logCommand("~");
+    Serial.println("System resumed");
+    return CONSOLE_DONE;
+}
+
+console_status_t cmdReset(console_call_t *call) {
+    (void)call;
+    Serial.println("\nResetting system...");
+    UartSerial.write(0x18);  // Ctrl-X soft reset
+    UartSerial.flush();
+    delay(100);
+    logCommand("$X");
+    Serial.println("System reset and unlocked");
+    return CONSOLE_DONE;
+}
+
+console_status_t cmdStatistics(console_call_t *call) {
+    (void)call;
+    printStatistics();
+    return CONSOLE_DONE;
+}
+
+console_status_t cmdClear(console_call_t *call) {
+    (void)call;
+    totalCommands = 0;
+    successfulCommands = 0;
+    failedCommands = 0;
+    // The flash history is the audit trail: mark the point instead of erasing it
+    event_log_append(&evlog, EVENT_MARK, EVENT_RESULT_OK, commandId, 0, NAN, 0);
+    Serial.println("Statistics cleared (mark added to the log)");
+    return CONSOLE_DONE;
+}
+
+console_status_t cmdVerbose(console_call_t *call) {
+    (void)call;
+    verboseLogging = !verboseLogging;
+    Serial.print("Verbose logging: ");
+    Serial.println(verboseLogging ? "ON" : "OFF");
+    return CONSOLE_DONE;
+}
+
+console_status_t cmdQuery(console_call_t *call) {
+    (void)call;
+    logCommand("?", true);
+    return CONSOLE_DONE;
+}
+
+console_status_t cmdAbort(console_call_t *call) {
+    if (console_busy(call->console)) {
+        console_abort(call->console);
+        binaryDump = false;
+        Serial.println("\n[dump aborted]");
+    }
+    return CONSOLE_DONE;
+}
+
+const console_cmd_t commands[] = {
+    {"x", "r", "Execute G-code (logged)", cmdExecute, 0},
+    {"!", "", "EMERGENCY STOP", cmdStop, CONSOLE_IMMEDIATE},
+    {"e", "", "EMERGENCY STOP", cmdStop, CONSOLE_IMMEDIATE},
+    {"~", "", "Resume from HOLD", cmdResume, 0},
+    {"r", "", "Resume from HOLD", cmdResume, 0},
+    {"$", "", "Reset system (Ctrl-X + unlock)", cmdReset, 0},
+    {"l", "?i", "Show log (default: 10 entries)", cmdLog, 0},
+    {"d", "?i", "Binary dump of the last N records (default: all)", cmdDump, 0},
+    {"s", "", "Show statistics", cmdStatistics, 0},
+    {"c", "", "Clear statistics (mark in the log)", cmdClear, 0},
+    {"v", "", "Toggle verbose logging", cmdVerbose, 0},
+    {"?", "", "Query status", cmdQuery, 0},
+    {"q", "", "Abort a running log dump", cmdAbort, CONSOLE_IMMEDIATE},
+};
+
 void setup() {
+    Serial.setTxBufferSize(CONSOLE_TX_BUFFER);
     Serial.begin(115200);
     delay(500);
 
@@ -176,8 +356,17 @@ void setup() {
 
     // Initialize UART
     UartSerial.begin(115200, SERIAL_8N1, UART_TEST_RX_PIN, UART_TEST_TX_PIN);
+    line_framer_init(&uartRx, uartBuf, sizeof(uartBuf), LINE_FRAMER_TRUNCATE);   // Log what fits
+    console_io_t io = console_stream_io(Serial);
+    console_init(&console, commands, sizeof(commands) / sizeof(commands[0]), &io);
     Serial.println("✓ UART initialized");
-    Serial.println("✓ Logging system active\n");
+    if (event_log_init(&evlog, "spiffs")) {
+        Serial.printf("✓ Event log: %lu records in flash, capacity %lu, boot %u\n\n",
+                      (unsigned long)event_log_count(&evlog), (unsigned long)event_log_capacity(&evlog),
+                      (unsigned)evlog.boot);
+    } else {
+        Serial.println("✗ No \"spiffs\" partition - events are not logged\n");
+    }
 
     Serial.println("Commands:");
     Serial.println("  x <gcode> - Execute G-code (logged)");
@@ -185,10 +374,12 @@ void setup() {
     Serial.println("  ~ or r - Resume from HOLD (after emergency stop)");
     Serial.println("  $ - Reset system (Ctrl-X + unlock)");
     Serial.println("  l [count] - Show log (default: 10 entries)");
+    Serial.println("  d [count] - Binary dump for evlog_decode.py (default: all)");
     Serial.println("  s - Show statistics");
-    Serial.println("  c - Clear log");
+    Serial.println("  c - Clear statistics (the flash log is kept)");
     Serial.println("  v - Toggle verbose logging (status updates)");
     Serial.println("  ? - Query status");
+    Serial.println("  q - Abort a running log dump");
     Serial.println("\nExamples:");
     Serial.println("  x G92 X0");
     Serial.println("  x G1 X10 F150");
@@ -203,52 +394,8 @@ void setup() {
 }
 
 void loop() {
-    // Handle user commands
-    if (Serial.available()) {
-        String input = Serial.readStringUntil('\n');
-        input.trim();
-
-        if (input.startsWith("x ")) {
-            String cmd = input.substring(2);
-            logCommand(cmd.c_str());
-        } else if (input == "!" || input == "e") {
-            Serial.println("\n⚠ EMERGENCY STOP!");
-            logCommand("!");
-            Serial.println("All pumps stopped (HOLD state)");
-            Serial.println("Type '~' to resume or '$' to reset");
-        } else if (input == "~" || input == "r") {
-            Serial.println("\nResuming from HOLD...");
-            logCommand("~");
-            Serial.println("System resumed");
-        } else if (input == "$") {
-            Serial.println("\nResetting system...");
-            UartSerial.write(0x18);  // Ctrl-X soft reset
-            UartSerial.flush();
-            delay(100);
-            logCommand("$X");
-            Serial.println("System reset and unlocked");
-        } else if (input.startsWith("l")) {
-            int count = 10;
-            if (input.length() > 2) {
-                count = input.substring(2).toInt();
-            }
-            printLog(count);
-        } else if (input == "s") {
-            printStatistics();
-        } else if (input == "c") {
-            logIndex = 0;
-            totalCommands = 0;
-            successfulCommands = 0;
-            failedCommands = 0;
-            Serial.println("Log cleared");
-        } else if (input == "v") {
-            verboseLogging = !verboseLogging;
-            Serial.print("Verbose logging: ");
-            Serial.println(verboseLogging ? "ON" : "OFF");
-        } else if (input == "?") {
-            logCommand("?", true);
-        }
-    }
+    // Handle user commands (every complete line, never blocks; 'l' streams out over several passes)
+    console_poll(&console, esp_timer_get_time());
 
     // Periodic status query (rate limited)
     if (millis() - lastStatusQuery >= STATUS_QUERY_INTERVAL) {
@@ -260,27 +407,33 @@ void loop() {
 
     // Timeout for waiting responses (2 seconds)
     if (waitingForResponse && (millis() - commandStartTime > 2000)) {
-        if (verboseLogging) {
+        if (loggingCommand) {
+            event_log_append(&evlog, EVENT_COMMAND, EVENT_RESULT_TIMEOUT, commandId,
+                             (uint32_t)(esp_timer_get_time() - commandStartUs), NAN, commandTag);
+        }
+        if (verboseLogging && !binaryDump) {
             Serial.println("[TIMEOUT] No response received");
         }
         waitingForResponse = false;
     }
 
     // Process responses
-    if (UartSerial.available()) {
-        String response = UartSerial.readStringUntil('\n');
-        response.trim();
-        if (response.length() > 0) {
-            // Determine if this is a status response (contains machine state)
-            bool isStatus = (response.indexOf("<Idle") >= 0) ||
-                           (response.indexOf("<Run") >= 0) ||
-                           (response.indexOf("<Jog") >= 0) ||
-                           (response.indexOf("<Hold") >= 0) ||
-                           (response.indexOf("<Alarm") >= 0);
-
-            logResponse(response, isStatus);
-        }
+    line_framer_line_t line;
+    if (line_framer_read(&uartRx, UartSerial, esp_timer_get_time(), &line)) {
+        const char *response = line.text;
+
+        // Determine if this is a status response (contains machine state)
+        bool isStatus = strstr(response, "<Idle") != NULL ||
+                        strstr(response, "<Run") != NULL ||
+                        strstr(response, "<Jog") != NULL ||
+                        strstr(response, "<Hold") != NULL ||
+                        strstr(response, "<Alarm") != NULL;
+
+        logResponse(response, isStatus);
     }
 
+    // Staged records to flash (a sector erase every 127 records stalls ~45 ms)
+    event_log_service(&evlog, EVENT_LOG_SERVICE_BATCH);
+
     delay(10);
 }
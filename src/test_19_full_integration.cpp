@@ -19,12 +19,34 @@
  * - Production-ready functionality
  *
  * Features:
- * - Recipe selection via encoder
+ * - Recipe selection via encoder, batch count via encoder
+ * - Batch queue (batch_queue.h): the batches run back to back with a
+ *   container-swap confirmation (START) in between, the next batch planned
+ *   while the current one dispenses; the queue survives a reboot (NVS)
+ * - Dosing journal (dose_journal.h): a batch cut by STOP or a reset is
+ *   resumed where it stopped (START), not run again from the start
+ * - Reservoir stock (inventory.h): drawn by the pumps' travel, saved in
+ *   coalesced NVS writes; a batch the stock cannot complete is blocked
+ *   before it starts
  * - LCD status display
  * - LED visual feedback
  * - Button control
- * - Safety monitoring
+ * - Safety monitoring (STOP handled in the GPIO ISR, see estop.h)
  * - Data logging
+ * - Loop profiler (profiler.h): where the milliseconds go
+ * - Fast boot (boot_seq.h): no settle sleeps, the LCD address cached in
+ *   NVS, FluidNC awaited from loop() - STOP and the console work while it
+ *   boots; the per-stage timeline is printed once everything has settled
+ *
+ * Serial commands:
+ *   p  Print the profiler tables (regions, blocking calls, loop period)
+ *   r  Reset the profiler figures
+ *   1-4  Queue one batch of that recipe
+ *   g  Run the queue / container swapped (as START), resume a stopped batch
+ *   f  Drop the stopped batch's progress: 'g' runs it from the start
+ *   i  Show the reservoir stock against the queue
+ *   F  All reservoirs refilled (full)
+ *   q  Show the queue
  *
  * Build command:
  *   pio run -e test_19_full_integration -t upload -t monitor
@@ -33,44 +55,89 @@
 #include <Arduino.h>
 #include <LiquidCrystal_I2C.h>
 #include <FastLED.h>
+#include <Preferences.h>
 #include <WiFi.h>
 #include "esp_bt.h"
 #include "pin_definitions.h"
+#include "batch_queue.h"
+#include "boot_seq.h"
+#include "button_events.h"
+#include "dose_journal.h"
+#include "esp_timer.h"
+#include "estop.h"
+#include "fluidnc_status.h"
+#include "inventory.h"
+#include "line_framer.h"
+#include "profiler.h"
 
 #define UartSerial         Serial2
+#define PROFILER_BLOCK_US  5000     // Calls / loop iterations longer than this count as blocking
+#define FLUIDNC_QUERY_MS   100      // '?' while FluidNC is still booting
+#define FLUIDNC_BOOT_MS    3000     // Give up waiting (it keeps being asked from the console)
+#define QUEUE_NVS_NS       "batch"
+#define QUEUE_NVS_KEY      "queue"
+#define MAX_BATCHES        99       // Encoder range in MODE_COUNT
+#define STATUS_POLL_MS     250      // '?' while a batch runs or is open (journal)
+#define STOCK_NVS_KEY      "stock"
+#define STOCK_DEFAULT_ML   1000.0f  // First boot: every reservoir this size and full
+#define STOCK_RESERVE_ML   20.0f
+#define LOOP_IDLE_MS       10       // loop() sleep when it had nothing to send or read
 
 // Peripherals
-LiquidCrystal_I2C lcd(LCD_I2C_ADDR, 16, 2);
+LiquidCrystal_I2C lcdMain(LCD_I2C_ADDR, 16, 2);
+LiquidCrystal_I2C lcdAlt(LCD_I2C_ADDR_ALT, 16, 2);
+LiquidCrystal_I2C *lcd = nullptr;  // The backpack that answered (boot stage "lcd")
 CRGB leds[LED_TOTAL_COUNT];
 
+// Boot
+bool fluidncHeard = false;      // Any line from FluidNC since reset
+int64_t fluidncAskUs = 0;
+int64_t interactiveUs = 0;      // setup() returned: STOP, buttons and console live
+bool bootReported = false;
+
+// FluidNC line assembly (never blocks, no String)
+char uartBuf[128];
+line_framer_t uartRx;
+
 // Encoder variables
 volatile int encoderPos = 0;
 int lastEncoderPos = 0;
 
 // System state
-enum SystemMode { MODE_IDLE, MODE_SELECT, MODE_RUNNING, MODE_COMPLETE, MODE_ERROR };
+enum SystemMode { MODE_IDLE, MODE_SELECT, MODE_COUNT, MODE_RUNNING, MODE_COMPLETE, MODE_ERROR };
 SystemMode currentMode = MODE_IDLE;
 
-// Recipe structure
-struct Recipe {
-    const char* name;
-    float volumes[4];  // X, Y, Z, A
-    float flowRate;
-};
-
-Recipe recipes[] = {
-    {"Water Flush", {10, 10, 10, 10}, 30.0},
-    {"Color Mix A", {5, 3, 2, 0}, 15.0},
-    {"Color Mix B", {3, 5, 2, 0}, 15.0},
-    {"Nutrient 1:1", {10, 10, 0, 0}, 20.0}
+// Recipes: pumps X, Y, Z, A in order, 0 ml = pump not used.
+// The queue stores recipes by index: append only
+const batch_step_t waterFlush[] = {{'X', 10, 30}, {'Y', 10, 30}, {'Z', 10, 30}, {'A', 10, 30}};
+const batch_step_t colorMixA[] = {{'X', 5, 15}, {'Y', 3, 15}, {'Z', 2, 15}, {'A', 0, 15}};
+const batch_step_t colorMixB[] = {{'X', 3, 15}, {'Y', 5, 15}, {'Z', 2, 15}, {'A', 0, 15}};
+const batch_step_t nutrient11[] = {{'X', 10, 20}, {'Y', 10, 20}, {'Z', 0, 20}, {'A', 0, 20}};
+
+const batch_recipe_t recipes[] = {
+    {"Water Flush", waterFlush, 4},
+    {"Color Mix A", colorMixA, 4},
+    {"Color Mix B", colorMixB, 4},
+    {"Nutrient 1:1", nutrient11, 4}
 };
 const int recipeCount = 4;
 int selectedRecipe = 0;
-int currentStep = 0;
+int batchCount = 1;             // MODE_COUNT
 
 const float ML_PER_MM = 0.05;
 const float SAFE_TEST_FEEDRATE = 300.0; // Max feedrate for testing safety
-bool waitingForIdle = false;
+
+// Batch queue as last shown
+batch_queue_state_t shownState = BATCH_QUEUE_IDLE;
+uint8_t shownStep = 0;
+uint32_t shownDone = 0;
+
+// Dosing journal, fed by the status reports
+dose_journal_t journal;
+fluidnc_status_t lastStatus;
+bool haveStatus = false;
+int64_t statusAskUs = 0;
+inventory_t inventory;
 
 void IRAM_ATTR encoderISR() {
     static unsigned long lastInterrupt = 0;
@@ -88,12 +155,18 @@ void IRAM_ATTR encoderISR() {
 void sendCommand(const char* cmd) {
     Serial.print("→ ");
     Serial.println(cmd);
-    UartSerial.println(cmd);
-    UartSerial.flush();
+    UartSerial.println(cmd);        // No flush(): the "ok" paces the stream, not the wire
+}
+
+/**
+ * Counts on the 16-column LCD: at most 999, so every line fits its buffer
+ */
+unsigned lcdCount(uint32_t n) {
+    return n > 999 ? 999 : (unsigned)n;
 }
 
 void updateDisplay() {
-    lcd.clear();
+    PROF_SCOPE("display");
     char line1[17], line2[17];
 
     switch (currentMode) {
@@ -109,123 +182,279 @@ void updateDisplay() {
             fill_solid(leds, LED_TOTAL_COUNT, CRGB::Blue);
             break;
 
-        case MODE_RUNNING:
-            snprintf(line1, sizeof(line1), "Running %d/4", currentStep + 1);
-            snprintf(line2, sizeof(line2), "%.14s", recipes[selectedRecipe].name);
+        case MODE_COUNT:
+            snprintf(line1, sizeof(line1), "%.16s", recipes[selectedRecipe].name);
+            snprintf(line2, sizeof(line2), "Batches: %d", batchCount);
+            fill_solid(leds, LED_TOTAL_COUNT, CRGB::Blue);
+            break;
+
+        case MODE_RUNNING: {
+            const batch_plan_t *plan = batch_queue_current();
+            int steps = plan ? plan->step_count : 1;
+            snprintf(line1, sizeof(line1), "Batch %u/%u", plan ? lcdCount(plan->batch + 1) : 0,
+                     plan ? lcdCount(plan->batches) : 0);
+            snprintf(line2, sizeof(line2), "Step %d/%d %c", shownStep + 1, steps,
+                     plan && shownStep < steps ? plan->steps[shownStep].pump : ' ');
             // Show progress on LEDs
-            int litLEDs = (currentStep + 1) * 8;
+            int litLEDs = (shownStep + 1) * LED_TOTAL_COUNT / steps;
             fill_solid(leds, litLEDs, CRGB::Cyan);
             fill_solid(leds + litLEDs, LED_TOTAL_COUNT - litLEDs, CRGB::Black);
             break;
+        }
 
         case MODE_COMPLETE:
-            strcpy(line1, "Complete!");
-            snprintf(line2, sizeof(line2), "%.14s", recipes[selectedRecipe].name);
-            fill_solid(leds, LED_TOTAL_COUNT, CRGB::Green);
+            // Stays up until the next input: a batch boundary, not a pause
+            if (batch_queue_state() == BATCH_QUEUE_SWAP) {
+                snprintf(line1, sizeof(line1), "Done, %u to go", lcdCount(batch_queue_remaining()));
+                strcpy(line2, "Swap, then START");
+                fill_solid(leds, LED_TOTAL_COUNT, CRGB::Yellow);
+            } else if (batch_queue_state() == BATCH_QUEUE_BLOCKED) {
+                strcpy(line1, "Next blocked");
+                strcpy(line2, "See log");
+                fill_solid(leds, LED_TOTAL_COUNT, CRGB::Orange);
+            } else if (batch_queue_state() == BATCH_QUEUE_HELD) {
+                snprintf(line1, sizeof(line1), "Queued: %u", lcdCount(batch_queue_remaining()));
+                strcpy(line2, "START to run");
+                fill_solid(leds, LED_TOTAL_COUNT, CRGB::Yellow);
+            } else {
+                strcpy(line1, "Complete!");
+                snprintf(line2, sizeof(line2), "%u batches", lcdCount(shownDone));
+                fill_solid(leds, LED_TOTAL_COUNT, CRGB::Green);
+            }
             break;
 
         case MODE_ERROR:
-            strcpy(line1, "ERROR!");
-            strcpy(line2, "Press STOP");
+            if (estop_is_latched()) {
+                strcpy(line1, "E-STOP!");
+                strcpy(line2, "START to reset");
+            } else {
+                strcpy(line1, "ERROR!");
+                strcpy(line2, "Press STOP");
+            }
             fill_solid(leds, LED_TOTAL_COUNT, CRGB::Red);
             break;
     }
 
-    lcd.setCursor(0, 0);
-    lcd.print(line1);
-    lcd.setCursor(0, 1);
-    lcd.print(line2);
-    FastLED.show();
+    if (lcd) {
+        PROF_CALL(lcd->clear());
+        lcd->setCursor(0, 0);
+        lcd->print(line1);
+        lcd->setCursor(0, 1);
+        lcd->print(line2);
+    }
+    PROF_CALL(FastLED.show());
 }
 
-void executeRecipeStep() {
-    if (currentStep >= 4) {
-        currentMode = MODE_COMPLETE;
-        updateDisplay();
-        delay(3000);
-        currentMode = MODE_IDLE;
-        updateDisplay();
+float maxFeedFor(char pump) {
+    (void)pump;
+    return SAFE_TEST_FEEDRATE;
+}
+
+/**
+ * Start the queue, continue it after a hold, or confirm the container swap
+ */
+void runQueue() {
+    if (estop_is_latched()) {
+        return;  // No motion while the e-stop is latched
+    }
+    if (!fluidncHeard) {
+        Serial.println("FluidNC not up yet");
         return;
     }
+    // A batch the journal holds as stopped goes on from FluidNC's position once it is Idle again
+    const batch_job_t *job = batch_queue_job(0);
+    batch_queue_state_t qs = batch_queue_state();
+    batch_plan_t plan;
+    dose_journal_point_t point;
+    bool ok;
+    if ((qs == BATCH_QUEUE_HELD || qs == BATCH_QUEUE_BLOCKED) && job != nullptr &&
+        batch_queue_plan(job, job->done, &plan) && dose_journal_matches(&journal, &plan)) {
+        if (!haveStatus || lastStatus.state != FLUIDNC_STATE_IDLE) {
+            Serial.println("FluidNC not Idle - clear the stop first, then START");
+            return;
+        }
+        dose_journal_point(&journal, &plan, &lastStatus, &point);
+        Serial.printf("Resuming batch in step %u/%u, %.2f ml in\n", point.step + 1, plan.step_count, point.done_ml);
+        ok = batch_queue_resume(esp_timer_get_time(), point.step, point.done_mm);
+    } else {
+        ok = batch_queue_run(esp_timer_get_time());
+    }
+    if (!ok) {
+        batch_queue_stats_t st;
+        batch_queue_get_stats(&st);
+        if (st.state == BATCH_QUEUE_BLOCKED) Serial.printf("✗ Batch cannot run: %s\n", st.blocked);
+    }
+}
 
-    Recipe r = recipes[selectedRecipe];
-    float volume = r.volumes[currentStep];
+void journalStarted(const batch_plan_t *plan, int64_t now_us) {
+    (void)now_us;
+    if (!dose_journal_start(&journal, plan, NAN)) Serial.println("⚠ No MPos yet - batch not journaled");
+    inventory_started(&inventory, plan);
+}
 
-    if (volume > 0) {
-        char pump = 'X' + currentStep;
-        float distMm = volume / ML_PER_MM;
-        float feedRate = r.flowRate / ML_PER_MM;
+void journalFinished(const batch_plan_t *plan, int64_t now_us) {
+    (void)plan;
+    (void)now_us;
+    dose_journal_done(&journal, NAN);
+    inventory_finished(&inventory);
+}
+
+const char *checkStock(const batch_plan_t *plan) {
+    return inventory_check(&inventory, plan);
+}
 
-        // Constrain feedrate to max safe value for testing
-        if (feedRate > SAFE_TEST_FEEDRATE) {
-            feedRate = SAFE_TEST_FEEDRATE;
+void printStock() {
+    inventory_forecast_t forecast[INVENTORY_PUMPS];
+    inventory_forecast(&inventory, forecast);
+    for (int p = 0; p < INVENTORY_PUMPS; p++) {
+        const inventory_reservoir_t *r = inventory_reservoir(&inventory, "XYZA"[p]);
+        Serial.printf("  %c %6.1f ml, queued %.1f ml", "XYZA"[p], r->stock_ml, forecast[p].demand_ml);
+        if (forecast[p].job_id != 0) {
+            Serial.printf(" - SHORT at batch %u of job #%lu", forecast[p].batch + 1, (unsigned long)forecast[p].job_id);
         }
+        Serial.println();
+    }
+}
 
-        Serial.print("Step ");
-        Serial.print(currentStep + 1);
-        Serial.print(": Pump ");
-        Serial.print(pump);
-        Serial.print(" - ");
-        Serial.print(volume);
-        Serial.print("ml (feedrate: ");
-        Serial.print(feedRate, 1);
-        Serial.println(" mm/min)");
-
-        char cmd[64];
-        snprintf(cmd, sizeof(cmd), "G92 %c0", pump);
-        sendCommand(cmd);
-        delay(100);
-
-        snprintf(cmd, sizeof(cmd), "G1 %c%.2f F%.1f", pump, distMm, feedRate);
-        sendCommand(cmd);
-
-        waitingForIdle = true;
-    } else {
-        // Skip this pump
-        currentStep++;
-        executeRecipeStep();
+void queueBatches(int recipe, int batches) {
+    uint8_t id = (uint8_t)recipe;
+    if (batch_queue_add(&id, 1, (uint16_t)batches) == 0) {
+        Serial.println("✗ Queue full");
+        return;
     }
+    Serial.printf("Queued %d x %s (%lu batches queued)\n", batches, recipes[recipe].name,
+                  (unsigned long)batch_queue_remaining());
+    inventory_forecast_t forecast[INVENTORY_PUMPS];
+    if (inventory_forecast(&inventory, forecast) > 0) {
+        Serial.println("⚠ Not enough stock for the whole queue - refill, then 'F':");
+        printStock();
+    }
+    if (batch_queue_state() == BATCH_QUEUE_HELD) runQueue();
 }
 
-void handleButtons() {
-    // Encoder button (SELECT)
-    if (digitalRead(ENCODER_SW_PIN) == LOW) {
-        delay(200);  // Debounce
-        if (currentMode == MODE_IDLE) {
-            currentMode = MODE_SELECT;
-            selectedRecipe = 0;
-            encoderPos = 0;
-            updateDisplay();
-        } else if (currentMode == MODE_SELECT) {
-            currentMode = MODE_RUNNING;
-            currentStep = 0;
-            updateDisplay();
-            delay(1000);
-            executeRecipeStep();
-        }
-        while (digitalRead(ENCODER_SW_PIN) == LOW) delay(10);
+void printQueue() {
+    batch_queue_stats_t st;
+    batch_queue_get_stats(&st);
+    Serial.printf("Queue %s: %lu to go, %lu done, restart after a batch %.1f ms (max %.1f)\n",
+                  batch_queue_state_name(st.state), (unsigned long)batch_queue_remaining(),
+                  (unsigned long)st.batches_done, st.gap_us_last / 1000.0, st.gap_us_max / 1000.0);
+    for (uint8_t i = 0; batch_queue_job(i) != nullptr; i++) {
+        const batch_job_t *j = batch_queue_job(i);
+        Serial.printf("  #%lu %u/%u %s\n", (unsigned long)j->id, j->done, j->batches, recipes[j->recipes[0]].name);
     }
+}
 
-    // START button
-    if (digitalRead(START_BUTTON_PIN) == LOW) {
-        delay(200);
-        if (currentMode == MODE_SELECT || currentMode == MODE_COMPLETE) {
+/**
+ * Follow the queue on the display and save it when it changed
+ * @return true if a line was sent
+ */
+bool serviceQueue() {
+    PROF_SCOPE("batch_queue");
+    int64_t now = esp_timer_get_time();
+    const char *line = nullptr;
+    if (!estop_is_latched()) line = batch_queue_poll(now);     // One line per "ok"
+    if (line) sendCommand(line);
+
+    batch_queue_stats_t st;
+    batch_queue_get_stats(&st);
+    uint8_t step = batch_queue_step(now);
+    if (st.batches_done != shownDone) {
+        shownDone = st.batches_done;
+        Serial.printf("✓ Batch done (%lu to go)\n", (unsigned long)batch_queue_remaining());
+    }
+    if (st.state != shownState || step != shownStep) {
+        if (st.state == BATCH_QUEUE_RUNNING) {
             currentMode = MODE_RUNNING;
-            currentStep = 0;
-            updateDisplay();
-            delay(1000);
-            executeRecipeStep();
+        } else if (shownState == BATCH_QUEUE_RUNNING && currentMode == MODE_RUNNING) {
+            currentMode = MODE_COMPLETE;        // SWAP, BLOCKED or all done
         }
-        while (digitalRead(START_BUTTON_PIN) == LOW) delay(10);
+        if (st.state == BATCH_QUEUE_BLOCKED && shownState != BATCH_QUEUE_BLOCKED) {
+            Serial.printf("✗ Next batch blocked: %s\n", st.blocked);
+        }
+        shownState = st.state;
+        shownStep = step;
+        updateDisplay();
     }
 
-    // STOP button
-    if (digitalRead(STOP_BUTTON_PIN) == LOW) {
-        delay(200);
-        sendCommand("!");  // Emergency stop
-        currentMode = MODE_IDLE;
-        updateDisplay();
-        while (digitalRead(STOP_BUTTON_PIN) == LOW) delay(10);
+    batch_queue_store_t store;
+    if (batch_queue_save(&store)) {
+        Preferences prefs;
+        prefs.begin(QUEUE_NVS_NS);
+        PROF_CALL(prefs.putBytes(QUEUE_NVS_KEY, &store, sizeof(store)));
+        prefs.end();
+    }
+    inventory_store_t stock;
+    if (inventory_save(&inventory, now, &stock)) {       // Coalesced draws, not one write per report
+        Preferences prefs;
+        prefs.begin(QUEUE_NVS_NS);
+        PROF_CALL(prefs.putBytes(STOCK_NVS_KEY, &stock, sizeof(stock)));
+        prefs.end();
+    }
+
+    // Reports for the journal (realtime '?': no "ok" to confuse the queue)
+    if (fluidncHeard && (st.state != BATCH_QUEUE_IDLE || journal.batch.open) &&
+        now - statusAskUs >= STATUS_POLL_MS * 1000LL) {
+        statusAskUs = now;
+        UartSerial.write('?');
+    }
+    return line != nullptr;
+}
+
+void handleButtons() {
+    // Debounced events from the button engine - never blocks, STOP first
+    button_event_t ev;
+    while (button_events_poll(&ev)) {
+        if (ev.type != BUTTON_EVENT_PRESS) continue;
+
+        switch (ev.button) {
+            case BUTTON_STOP:
+                // Feed hold already went out from the GPIO ISR; only update the UI
+                Serial.println("!!! E-STOP !!!");
+                batch_queue_hold();     // The journal keeps where it stopped: START resumes
+                currentMode = MODE_ERROR;
+                updateDisplay();
+                break;
+
+            case BUTTON_SELECT:
+                if (currentMode == MODE_IDLE) {
+                    currentMode = MODE_SELECT;
+                    selectedRecipe = 0;
+                    encoderPos = 0;
+                    updateDisplay();
+                } else if (currentMode == MODE_SELECT) {
+                    currentMode = MODE_COUNT;
+                    batchCount = 1;
+                    lastEncoderPos = encoderPos = 0;
+                    updateDisplay();
+                } else if (currentMode == MODE_COUNT) {
+                    queueBatches(selectedRecipe, batchCount);
+                } else if (currentMode == MODE_COMPLETE && batch_queue_state() == BATCH_QUEUE_IDLE) {
+                    currentMode = MODE_SELECT;
+                    lastEncoderPos = encoderPos = 0;
+                    updateDisplay();
+                }
+                break;
+
+            case BUTTON_START:
+                if (estop_is_latched()) {
+                    // Reset only once STOP is released and Ctrl-X has gone out
+                    if (estop_clear()) {
+                        sendCommand("$X");
+                        currentMode = batch_queue_state() == BATCH_QUEUE_IDLE ? MODE_IDLE : MODE_COMPLETE;
+                        updateDisplay();
+                    }
+                } else if (currentMode == MODE_SELECT || currentMode == MODE_COUNT) {
+                    queueBatches(selectedRecipe, currentMode == MODE_COUNT ? batchCount : 1);
+                } else if (batch_queue_state() != BATCH_QUEUE_IDLE && batch_queue_state() != BATCH_QUEUE_RUNNING) {
+                    runQueue();             // Container swapped / continue after a hold
+                } else if (currentMode == MODE_COMPLETE) {
+                    queueBatches(selectedRecipe, 1);
+                }
+                break;
+
+            default:
+                break;
+        }
     }
 }
 
@@ -234,48 +463,197 @@ void handleEncoder() {
         selectedRecipe = ((encoderPos % recipeCount) + recipeCount) % recipeCount;
         lastEncoderPos = encoderPos;
         updateDisplay();
+    } else if (currentMode == MODE_COUNT && encoderPos != lastEncoderPos) {
+        batchCount = constrain(batchCount + encoderPos - lastEncoderPos, 1, MAX_BATCHES);
+        lastEncoderPos = encoderPos;
+        updateDisplay();
     }
 }
 
-void setup() {
-    Serial.begin(115200);
-    delay(500);
+void handleConsole() {
+    while (Serial.available()) {
+        char c = (char)Serial.read();
+        if (c == 'p') {
+            profiler_report();
+        } else if (c == 'r') {
+            profiler_reset();
+            Serial.println("Profiler reset");
+        } else if (c >= '1' && c < '1' + recipeCount) {
+            queueBatches(c - '1', 1);
+        } else if (c == 'g') {
+            runQueue();
+        } else if (c == 'q') {
+            printQueue();
+        } else if (c == 'f' && journal.batch.open && batch_queue_state() != BATCH_QUEUE_RUNNING) {
+            dose_journal_abort(&journal);
+            Serial.println("Stopped batch dropped: START runs it from the start");
+        } else if (c == 'i') {
+            printStock();
+        } else if (c == 'F') {
+            for (int p = 0; p < INVENTORY_PUMPS; p++) inventory_refill(&inventory, "XYZA"[p], -1.0f);
+            Serial.println("Reservoirs refilled");
+        }
+    }
+}
 
-    Serial.println("\n╔════════════════════════════════════════════════════════════╗");
-    Serial.println("║           Test 19: Full System Integration                ║");
-    Serial.println("╚════════════════════════════════════════════════════════════╝\n");
+// ============================================================================
+// BOOT STAGES (boot_seq.h) - none of them sleeps
+// ============================================================================
 
-    // Initialize LCD
-    Wire.begin(LCD_SDA_PIN, LCD_SCL_PIN);
-    lcd.init();
-    lcd.backlight();
-    Serial.println("✓ LCD initialized");
+bool bootUart() {
+    UartSerial.begin(115200, SERIAL_8N1, UART_TEST_RX_PIN, UART_TEST_TX_PIN);
+    line_framer_init(&uartRx, uartBuf, sizeof(uartBuf), LINE_FRAMER_DROP);
+    estop_init(RODENT_UART_NUM, 115200);       // STOP is live from here
+    return true;
+}
 
+bool bootControls() {
+    button_events_init();
+    pinMode(ENCODER_CLK_PIN, INPUT_PULLUP);
+    pinMode(ENCODER_DT_PIN, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(ENCODER_CLK_PIN), encoderISR, FALLING);
+    return true;
+}
+
+bool bootLeds() {
     // Disable WiFi and Bluetooth to prevent LED data corruption
     WiFi.mode(WIFI_OFF);
     btStop();
-
-    // Initialize LEDs
     FastLED.addLeds<WS2812B, LED_DATA_PIN, GRB>(leds, LED_TOTAL_COUNT);
     FastLED.setBrightness(50);
-    FastLED.clear(true);  // Clear buffer to remove garbage data
-    delay(50);  // Stabilize RMT peripheral
-    Serial.println("✓ LEDs initialized (WiFi/BT disabled)");
+    FastLED.clear(true);    // show() returns once the frame is out: nothing to wait for
+    return true;
+}
 
-    // Initialize buttons and encoder
-    pinMode(START_BUTTON_PIN, INPUT_PULLUP);
-    pinMode(STOP_BUTTON_PIN, INPUT_PULLUP);
-    pinMode(ENCODER_CLK_PIN, INPUT_PULLUP);
-    pinMode(ENCODER_DT_PIN, INPUT_PULLUP);
-    pinMode(ENCODER_SW_PIN, INPUT_PULLUP);
-    attachInterrupt(digitalPinToInterrupt(ENCODER_CLK_PIN), encoderISR, FALLING);
-    Serial.println("✓ Controls initialized");
+bool lcdAnswers(uint8_t addr) {
+    Wire.beginTransmission(addr);
+    return Wire.endTransmission() == 0;
+}
 
-    // Initialize UART
-    UartSerial.begin(115200, SERIAL_8N1, UART_TEST_RX_PIN, UART_TEST_TX_PIN);
-    Serial.println("✓ UART initialized\n");
+/**
+ * The address that answered last time is tried first (one probe on a warm
+ * boot), then both backpack addresses - never a full bus scan
+ */
+bool bootLcd() {
+    Wire.begin(LCD_SDA_PIN, LCD_SCL_PIN);
+    Preferences prefs;
+    prefs.begin("boot");
+    uint8_t cached = prefs.getUChar("lcd_addr", 0);
+    uint8_t addr = 0;
+    if (cached != 0 && lcdAnswers(cached)) {
+        addr = cached;
+    } else if (lcdAnswers(LCD_I2C_ADDR)) {
+        addr = LCD_I2C_ADDR;
+    } else if (lcdAnswers(LCD_I2C_ADDR_ALT)) {
+        addr = LCD_I2C_ADDR_ALT;
+    }
+    if (addr != 0 && addr != cached) prefs.putUChar("lcd_addr", addr);
+    prefs.end();
+    if (addr == 0) return false;
+
+    lcd = addr == LCD_I2C_ADDR_ALT ? &lcdAlt : &lcdMain;
+    lcd->init();
+    lcd->backlight();
+    return true;
+}
+
+bool bootFluidnc() {
+    UartSerial.write('?');      // Realtime: a "?" line would add a stray "ok" (batch_queue.h)
+    fluidncAskUs = esp_timer_get_time();
+    return true;
+}
 
-    Serial.println("Available Recipes:");
+/**
+ * Ready on the first line back (report, or the banner if it was still
+ * booting); input sent before FluidNC is up is lost, so keep asking
+ */
+bool fluidncReady() {
+    if (fluidncHeard) return true;
+    if (esp_timer_get_time() - fluidncAskUs >= FLUIDNC_QUERY_MS * 1000LL) {
+        UartSerial.write('?');
+        fluidncAskUs = esp_timer_get_time();
+    }
+    return false;
+}
+
+enum { STAGE_UART, STAGE_CONTROLS, STAGE_LEDS, STAGE_LCD, STAGE_FLUIDNC };
+
+const boot_stage_t bootStages[] = {
+    {"uart", bootUart, nullptr, 0, 0},                                  // STOP first
+    {"controls", bootControls, nullptr, 0, 0},
+    {"leds", bootLeds, nullptr, 0, 0},
+    {"lcd", bootLcd, nullptr, 0, 0},
+    {"fluidnc", bootFluidnc, fluidncReady, BOOT_DEP(STAGE_UART), FLUIDNC_BOOT_MS},
+};
+
+void reportBoot() {
+    char timeline[512];
+    boot_seq_format(timeline, sizeof(timeline));
+    Serial.println("\nBoot timeline:");
+    Serial.print(timeline);
+    Serial.printf("  interactive at %.1f ms\n", interactiveUs / 1000.0);
+    if (boot_seq_stage_state(STAGE_LCD) != BOOT_STAGE_READY) {
+        Serial.println("⚠ No LCD at 0x27 / 0x3F - running without display");
+    }
+    if (boot_seq_stage_state(STAGE_FLUIDNC) != BOOT_STAGE_READY) {
+        Serial.println("⚠ No answer from FluidNC - check the UART");
+    }
+}
+
+void setup() {
+    Serial.begin(115200);   // UART0: no settle delay needed
+
+    Serial.println("\n╔════════════════════════════════════════════════════════════╗");
+    Serial.println("║           Test 19: Full System Integration                ║");
+    Serial.println("╚════════════════════════════════════════════════════════════╝\n");
+
+    // Everything but FluidNC settles in this first pass; FluidNC is awaited from loop()
+    boot_seq_init(bootStages, sizeof(bootStages) / sizeof(bootStages[0]));
+    boot_seq_poll(esp_timer_get_time());
+    Serial.println("✓ UART initialized (E-Stop on ISR)");
+    Serial.println("✓ Controls initialized");
+    Serial.println("✓ LEDs initialized (WiFi/BT disabled)");
+    if (lcd) Serial.println("✓ LCD initialized");
+
+    batch_queue_config_t queueCfg = BATCH_QUEUE_DEFAULT_CONFIG;
+    queueCfg.recipes = recipes;
+    queueCfg.recipe_count = recipeCount;
+    queueCfg.ml_per_mm = ML_PER_MM;
+    queueCfg.max_feed = maxFeedFor;
+    queueCfg.check = checkStock;
+    queueCfg.started = journalStarted;
+    queueCfg.finished = journalFinished;
+    batch_queue_init(&queueCfg);
+    // Queue left from before the reset: HELD until START (check the container first)
+    batch_queue_store_t store;
+    Preferences prefs;
+    prefs.begin(QUEUE_NVS_NS);
+    if (prefs.getBytes(QUEUE_NVS_KEY, &store, sizeof(store)) == sizeof(store) && batch_queue_load(&store) &&
+        batch_queue_remaining() > 0) {
+        Serial.printf("⚠ %lu queued batches restored - check the container, then START\n",
+                      (unsigned long)batch_queue_remaining());
+        currentMode = MODE_COMPLETE;
+    }
+    inventory_store_t stock;
+    bool stored = prefs.getBytes(STOCK_NVS_KEY, &stock, sizeof(stock)) == sizeof(stock);
+    prefs.end();
+    inventory_config_t stockCfg = INVENTORY_DEFAULT_CONFIG;
+    stockCfg.ml_per_mm = ML_PER_MM;
+    inventory_init(&inventory, &stockCfg, stored ? &stock : NULL);
+    inventory_set_recipes(&inventory, recipes, recipeCount);
+    if (!stored) {
+        for (int p = 0; p < INVENTORY_PUMPS; p++) {
+            inventory_set(&inventory, "XYZA"[p], NULL, STOCK_DEFAULT_ML, STOCK_RESERVE_ML, 1.0f);
+            inventory_refill(&inventory, "XYZA"[p], -1.0f);
+        }
+    }
+    shownState = batch_queue_state();
+    if (dose_journal_init(&journal, "spiffs", NULL) && journal.batch.open) {
+        Serial.printf("⚠ Batch %u of job #%u stopped in step %u - START resumes it, 'f' runs it from the start\n",
+                      journal.batch.batch + 1, journal.batch.job, journal.batch.step + 1);
+    }
+
+    Serial.println("\nAvailable Recipes:");
     for (int i = 0; i < recipeCount; i++) {
         Serial.print("  ");
         Serial.print(i + 1);
@@ -286,40 +664,84 @@ void setup() {
     Serial.println("\nOperation:");
     Serial.println("  1. Press SELECT to choose recipe");
     Serial.println("  2. Rotate encoder to browse");
-    Serial.println("  3. Press SELECT or START to begin");
-    Serial.println("  4. Press STOP for emergency stop\n");
+    Serial.println("  3. Press SELECT, rotate to set the batch count, SELECT or START to queue and run");
+    Serial.println("  4. Between batches swap the container and press START");
+    Serial.println("  5. Press STOP for emergency stop");
+    Serial.println("  Serial '1'-'4' = queue one batch, 'g' = run / swapped, 'q' = show the queue");
+    Serial.println("  Serial 'f' = run a stopped batch from the start instead of resuming it");
+    Serial.println("  Serial 'i' = reservoir stock, 'F' = all reservoirs refilled");
+#if PROFILER_ENABLED
+    Serial.println("  Serial 'p' = profiler report, 'r' = reset\n");
+#else
+    Serial.println("  (profiler compiled out - build with -D PROFILER_ENABLED=1)\n");
+#endif
 
     updateDisplay();
-    delay(1000);
-    sendCommand("?");
+    profiler_init(getCpuFrequencyMhz(), PROFILER_BLOCK_US);
+    interactiveUs = esp_timer_get_time();
 }
 
 void loop() {
-    handleButtons();
-    handleEncoder();
+    profiler_loop_tick();
+    {
+        PROF_SCOPE("estop_service");
+        estop_service();
+    }
+    {
+        PROF_SCOPE("controls");
+        handleButtons();
+        handleEncoder();
+    }
+    handleConsole();
+    if (!bootReported && boot_seq_poll(esp_timer_get_time())) {
+        bootReported = true;
+        reportBoot();
+    }
 
     // Process UART responses
-    if (UartSerial.available()) {
-        String response = UartSerial.readStringUntil('\n');
-        response.trim();
-        if (response.length() > 0) {
-            Serial.print("← ");
-            Serial.println(response);
-
-            if (waitingForIdle && response.indexOf("Idle") >= 0) {
-                waitingForIdle = false;
-                currentStep++;
-                updateDisplay();
-                delay(500);
-                executeRecipeStep();
+    bool busy = false;
+    {
+        PROF_SCOPE("uart_rx");
+        line_framer_line_t line;
+        if (line_framer_read(&uartRx, UartSerial, esp_timer_get_time(), &line)) {
+            busy = true;
+            const char *response = line.text;
+            fluidncHeard = true;
+
+            // Reports feed the journal; they are polled while a batch runs, so not echoed
+            fluidnc_status_t status;
+            if (fluidnc_status_parse(response, &status)) {
+                dose_journal_update(&journal, &status, NAN, esp_timer_get_time());
+                inventory_update(&inventory, &status, esp_timer_get_time());
+                lastStatus = status;
+                haveStatus = true;
+            } else {
+                Serial.print("← ");
+                Serial.println(response);
+            }
+
+            if (estop_on_status_line(response)) {
+                estop_status_t st;
+                estop_get_status(&st);
+                Serial.printf("⏱  E-Stop -> Hold: %lu us\n", (unsigned long)st.last_latency_us);
             }
 
-            if (response.indexOf("error") >= 0 || response.indexOf("ALARM") >= 0) {
+            // A batch ends on the "ok" to its "G4 P0"; an "error" holds the queue
+            bool batchLine = batch_queue_on_line(response, esp_timer_get_time());
+
+            if (strstr(response, "error") != NULL || strstr(response, "ALARM") != NULL) {
+                if (!batchLine) batch_queue_hold();
                 currentMode = MODE_ERROR;
                 updateDisplay();
             }
         }
     }
+    busy |= serviceQueue();
 
-    delay(10);
+    // Streaming: straight into the next "ok" / line. Idle: sleep
+    if (busy) {
+        yield();
+    } else {
+        PROF_CALL(delay(LOOP_IDLE_MS));
+    }
 }
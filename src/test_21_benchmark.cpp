@@ -0,0 +1,481 @@
+/**
+ * Test 21: Benchmark Suite (on target)
+ *
+ * Hardware:
+ * - BTT Rodent V1.1 board running FluidNC (UART mode)
+ * - ESP32 Dev Module
+ * - Direct UART connection (GPIO 16/17)
+ * - Digital scale on UART1 (full run only)
+ * - Pump X with tubing in a beaker on the scale (full run only)
+ *
+ * Purpose:
+ * - Measure what the host suite cannot: parse rates on the ESP32, real
+ *   UART command throughput, software e-stop latency against the real
+ *   FluidNC, heap high-water mark and loop jitter
+ * - Full run: recipe makespan for the built-in recipes and dosing
+ *   accuracy vs. speed, weighed on the scale
+ * - Soak: 10 minutes of command traffic, timeouts and heap low point
+ *
+ * Results are printed as JSON between BENCH-JSON-BEGIN / BENCH-JSON-END.
+ * Save the serial log and compare it against the target baseline:
+ *   python3 host/bench/bench_compare.py monitor.log host/bench/baseline_target.json
+ * (first run on a new board: add --update to create the baseline)
+ *
+ * Serial commands:
+ *   b  Quick run: parsers, UART, e-stop, heap, loop jitter (pumps move briefly)
+ *   f  Full run: quick + recipes + dosing accuracy (~15 min, dispenses liquid)
+ *   s  Soak: 10 min of "G4 P0" traffic
+ *   j  Print the last results as JSON again
+ *
+ * Build command:
+ *   pio run -e test_21_benchmark -t upload -t monitor
+ */
+
+#include <Arduino.h>
+#include "pin_definitions.h"
+#include "button_events.h"
+#include "esp_timer.h"
+#include "estop.h"
+#include "fluidnc_status.h"
+#include "latency_hist.h"
+#include "line_framer.h"
+#include "safety_latency.h"
+#include "scale_weight.h"
+
+#define RodentSerial       Serial2  // To FluidNC
+#define ScaleSerial        Serial1  // To digital scale
+
+#define MAX_METRICS         40
+#define PARSE_BENCH_US      1000000     // Per parser
+#define UART_BENCH_CMDS     200
+#define RX_BUFFER_BYTES     128         // FluidNC serial RX buffer (character counting)
+#define OK_TIMEOUT_MS       2000
+#define ESTOP_RUNS          10
+#define LOOP_BENCH_MS       5000
+#define STATUS_POLL_MS      75          // '?' during the loop benchmark
+#define SOAK_MINUTES        10
+#define SAFE_TEST_FEEDRATE  300.0f      // As test_16
+#define ML_PER_MM           0.05f
+#define DOSE_ML             5.0f
+#define DOSE_REPEATS        3
+#define SCALE_SETTLE_MS     3000
+
+struct Metric {
+    char name[40];
+    float value;
+    const char *unit;
+    bool higherIsBetter;
+};
+
+Metric metrics[MAX_METRICS];
+int metricCount = 0;
+
+// Line assembly (no readStringUntil: nothing here may block blindly)
+char rodentBuf[128];
+char scaleBuf[48];
+line_framer_t rodentRx;
+line_framer_t scaleRx;
+
+struct Ingredient {
+    char pump;
+    float volumeMl;
+    float flowRateMlMin;
+};
+
+struct Recipe {
+    const char *slug;
+    const Ingredient *steps;
+    int stepCount;
+};
+
+// Mirrors test_16_recipe_system.cpp
+const Ingredient cleaningRecipe[] = {{'X', 5.0, 30.0}, {'Y', 5.0, 30.0}, {'Z', 5.0, 30.0}, {'A', 5.0, 30.0}};
+const Ingredient colorMixRecipe[] = {{'X', 10.0, 15.0}, {'Y', 5.0, 10.0}, {'Z', 2.5, 10.0}};
+const Ingredient nutrientMixRecipe[] = {{'X', 20.0, 25.0}, {'Y', 2.0, 5.0}, {'Z', 1.5, 5.0}, {'A', 0.5, 2.0}};
+
+const Recipe recipes[] = {
+    {"cleaning_flush", cleaningRecipe, 4},
+    {"color_mix", colorMixRecipe, 3},
+    {"nutrient_mix", nutrientMixRecipe, 4},
+};
+
+// ============================================================================
+// RESULTS
+// ============================================================================
+
+void record(const char *name, float value, const char *unit, bool higherIsBetter) {
+    if (metricCount >= MAX_METRICS) return;
+    Metric &m = metrics[metricCount++];
+    snprintf(m.name, sizeof(m.name), "%s", name);
+    m.value = value;
+    m.unit = unit;
+    m.higherIsBetter = higherIsBetter;
+    Serial.printf("  %-34s %12.3f %s\n", name, value, unit);
+}
+
+void printJson() {
+    Serial.println("BENCH-JSON-BEGIN");
+    Serial.println("{\n  \"suite\": \"target\",\n  \"version\": 1,\n  \"metrics\": {");
+    for (int i = 0; i < metricCount; i++) {
+        const Metric &m = metrics[i];
+        Serial.printf("    \"%s\": {\"value\": %.6g, \"unit\": \"%s\", \"better\": \"%s\", \"kind\": \"target\"}%s\n",
+                      m.name, m.value, m.unit, m.higherIsBetter ? "higher" : "lower",
+                      i + 1 < metricCount ? "," : "");
+    }
+    Serial.println("  }\n}");
+    Serial.println("BENCH-JSON-END");
+}
+
+// ============================================================================
+// RODENT I/O
+// ============================================================================
+
+/**
+ * @brief Next complete line from FluidNC, if one has arrived (never blocks)
+ */
+const char *pollRodentLine() {
+    line_framer_line_t line;
+    if (!line_framer_read(&rodentRx, RodentSerial, esp_timer_get_time(), &line)) return NULL;
+    estop_on_status_line(line.text);
+    return line.text;
+}
+
+void sendLine(const char *line) {
+    RodentSerial.print(line);
+    RodentSerial.print("\n");
+}
+
+/**
+ * @brief Wait for "ok" (false on error:N, ALARM or timeout)
+ */
+bool waitOk(uint32_t timeoutMs) {
+    uint32_t start = millis();
+    while (millis() - start < timeoutMs) {
+        estop_service();
+        const char *line = pollRodentLine();
+        if (line == NULL) continue;
+        if (strcmp(line, "ok") == 0) return true;
+        if (strncmp(line, "error:", 6) == 0 || strncmp(line, "ALARM:", 6) == 0) return false;
+    }
+    return false;
+}
+
+/**
+ * @brief Poll '?' until the machine has run and is Idle again
+ */
+bool waitMoveDone(uint32_t timeoutMs) {
+    uint32_t start = millis();
+    uint32_t lastPoll = 0;
+    bool seenRun = false;
+    while (millis() - start < timeoutMs) {
+        estop_service();
+        if (millis() - lastPoll >= 50) {
+            RodentSerial.write('?');
+            lastPoll = millis();
+        }
+        const char *line = pollRodentLine();
+        fluidnc_status_t st;
+        if (line == NULL || !fluidnc_status_parse(line, &st)) continue;
+        if (st.state == FLUIDNC_STATE_RUN) seenRun = true;
+        if (st.state == FLUIDNC_STATE_IDLE && seenRun) return true;
+        if (st.state == FLUIDNC_STATE_ALARM) return false;
+    }
+    return false;
+}
+
+bool dispense(char pump, float volumeMl, float flowMlMin) {
+    float feed = min(flowMlMin / ML_PER_MM, SAFE_TEST_FEEDRATE);
+    char cmd[48];
+    snprintf(cmd, sizeof(cmd), "G91 G1 %c%.3f F%.1f", pump, volumeMl / ML_PER_MM, feed);
+    sendLine(cmd);
+    if (!waitOk(OK_TIMEOUT_MS)) return false;
+    uint32_t expectedMs = (uint32_t)(volumeMl / ML_PER_MM / feed * 60000.0f);
+    return waitMoveDone(expectedMs * 2 + 5000);
+}
+
+// ============================================================================
+// SCALE (test_15 burst protocol)
+// ============================================================================
+
+bool readScale(float *grams) {
+    static const char SCALE_CMD[] = "@P<CR><LF>";   // Literal text, not control chars
+    for (int repeat = 0; repeat < 13; repeat++) {
+        for (size_t i = 0; i < sizeof(SCALE_CMD) - 1; i++) {
+            ScaleSerial.write(SCALE_CMD[i]);
+            delay(7);
+        }
+        delay(9);
+    }
+
+    bool found = false;
+    uint32_t start = millis();
+    line_framer_clear(&scaleRx);
+    while (millis() - start < 160) {
+        line_framer_line_t line;
+        while (line_framer_read(&scaleRx, ScaleSerial, esp_timer_get_time(), &line)) {
+            if (scale_weight_parse(line.text, grams, NULL, 0)) found = true;
+        }
+    }
+    return found;
+}
+
+// ============================================================================
+// BENCHMARKS
+// ============================================================================
+
+void benchParsers() {
+    static const char *const statusLines[] = {
+        "<Idle|MPos:0.000,0.000,0.000,0.000|FS:0,0|Ov:100,100,100>",
+        "<Run|MPos:12.345,0.000,0.000,0.000|FS:150,0>",
+        "<Hold:1|MPos:40.012,0.000,0.000,0.000|FS:75,0|Ov:100,100,100>",
+        "<Alarm|MPos:0.000,0.000,0.000,0.000|FS:0,0>",
+    };
+    static const char *const weightLines[] = {"  +012.34 g", "ST,GS,  -0.50 g", "+0000.00g", "OL"};
+
+    Serial.println("\n[parsers]");
+    uint32_t n = 0;
+    volatile uint32_t sink = 0;
+    int64_t start = esp_timer_get_time();
+    while (esp_timer_get_time() - start < PARSE_BENCH_US) {
+        fluidnc_status_t st;
+        for (int i = 0; i < 4; i++) sink = sink + fluidnc_status_parse(statusLines[i], &st);
+        n += 4;
+    }
+    record("status_parse_rate", n * 1e6f / (float)(esp_timer_get_time() - start), "lines/s", true);
+
+    n = 0;
+    start = esp_timer_get_time();
+    while (esp_timer_get_time() - start < PARSE_BENCH_US) {
+        float g;
+        for (int i = 0; i < 4; i++) sink = sink + scale_weight_parse(weightLines[i], &g, NULL, 0);
+        n += 4;
+    }
+    record("weight_parse_rate", n * 1e6f / (float)(esp_timer_get_time() - start), "lines/s", true);
+}
+
+void benchUart() {
+    Serial.println("\n[uart]");
+    while (pollRodentLine() != NULL) {}
+
+    // One line in flight, as task_control.c
+    uint32_t acked = 0;
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < UART_BENCH_CMDS; i++) {
+        sendLine("G4 P0");
+        if (!waitOk(OK_TIMEOUT_MS)) break;
+        acked++;
+    }
+    record("uart_cmds_per_s_ack", acked * 1e6f / (float)(esp_timer_get_time() - start), "cmd/s", true);
+
+    // Character counting against the FluidNC RX buffer
+    const size_t cmdLen = 6;        // "G4 P0\n"
+    size_t inFlight = 0;
+    uint32_t sent = 0;
+    acked = 0;
+    start = esp_timer_get_time();
+    uint32_t lastProgress = millis();
+    while (acked < UART_BENCH_CMDS && millis() - lastProgress < OK_TIMEOUT_MS) {
+        while (sent < UART_BENCH_CMDS && (inFlight + 1) * cmdLen <= RX_BUFFER_BYTES) {
+            sendLine("G4 P0");
+            sent++;
+            inFlight++;
+        }
+        const char *line = pollRodentLine();
+        if (line != NULL && strcmp(line, "ok") == 0) {
+            acked++;
+            inFlight--;
+            lastProgress = millis();
+        }
+    }
+    record("uart_cmds_per_s_stream", acked * 1e6f / (float)(esp_timer_get_time() - start), "cmd/s", true);
+}
+
+void benchEstop() {
+    Serial.println("\n[estop] (pump X moves)");
+    safety_latency_reset();
+    for (int i = 0; i < ESTOP_RUNS; i++) {
+        sendLine("G91 G1 X20 F150");
+        if (!waitOk(OK_TIMEOUT_MS)) break;
+
+        // Trigger at a random point of the move
+        uint32_t until = millis() + 300 + (esp_random() % 400);
+        while ((int32_t)(millis() - until) < 0) {
+            estop_service();
+            pollRodentLine();
+        }
+        estop_trigger("benchmark");
+
+        uint32_t start = millis();
+        while (safety_latency_active() && millis() - start < 3000) {
+            estop_service();
+            pollRodentLine();
+        }
+        // Ctrl-X went out: wait for the banner, then unlock
+        start = millis();
+        while (!estop_clear() && millis() - start < 3000) {
+            estop_service();
+            pollRodentLine();
+        }
+        delay(500);
+        while (pollRodentLine() != NULL) {}
+        sendLine("$X");
+        waitOk(OK_TIMEOUT_MS);
+    }
+    record("estop_software_hold_p99_us",
+           latency_hist_percentile(safety_latency_hist(SAFETY_STAGE_HOLD), 99.0f), "us", false);
+    record("estop_software_stopped_p99_us",
+           latency_hist_percentile(safety_latency_hist(SAFETY_STAGE_STOPPED), 99.0f), "us", false);
+}
+
+void benchLoop() {
+    Serial.println("\n[loop]");
+    static latency_hist_t period;
+    latency_hist_reset(&period);
+
+    uint32_t start = millis();
+    uint32_t lastPoll = 0;
+    int64_t last = esp_timer_get_time();
+    while (millis() - start < LOOP_BENCH_MS) {
+        // A production-shaped iteration: e-stop service, UART drain, status parse
+        estop_service();
+        if (millis() - lastPoll >= STATUS_POLL_MS) {
+            RodentSerial.write('?');
+            lastPoll = millis();
+        }
+        const char *line;
+        while ((line = pollRodentLine()) != NULL) {
+            fluidnc_status_t st;
+            fluidnc_status_parse(line, &st);
+        }
+        delay(1);
+
+        int64_t now = esp_timer_get_time();
+        latency_hist_add(&period, (uint32_t)(now - last));
+        last = now;
+    }
+    uint32_t p50 = latency_hist_percentile(&period, 50.0f);
+    record("loop_period_p50_us", p50, "us", false);
+    record("loop_jitter_p99_us", latency_hist_percentile(&period, 99.0f) - p50, "us", false);
+    record("loop_period_max_us", period.max, "us", false);
+}
+
+void benchHeap() {
+    Serial.println("\n[heap]");
+    record("heap_free_bytes", ESP.getFreeHeap(), "bytes", true);
+    record("heap_min_free_bytes", ESP.getMinFreeHeap(), "bytes", true);
+    record("loop_stack_free_min_bytes", uxTaskGetStackHighWaterMark(NULL), "bytes", true);
+}
+
+void benchRecipes() {
+    Serial.println("\n[recipes] (all pumps dispense)");
+    for (const Recipe &r : recipes) {
+        uint32_t start = millis();
+        bool ok = true;
+        for (int s = 0; s < r.stepCount && ok; s++) {
+            ok = dispense(r.steps[s].pump, r.steps[s].volumeMl, r.steps[s].flowRateMlMin);
+        }
+        char name[40];
+        snprintf(name, sizeof(name), "makespan_s.%s", r.slug);
+        record(name, ok ? (millis() - start) / 1000.0f : 0.0f, "s", false);
+    }
+}
+
+void benchDosing() {
+    static const float flows[] = {5.0f, 15.0f, 30.0f, 60.0f};
+    Serial.println("\n[dosing accuracy vs speed] (pump X into the beaker on the scale)");
+    for (float flow : flows) {
+        float worst = -1.0f;
+        for (int r = 0; r < DOSE_REPEATS; r++) {
+            float before, after;
+            if (!readScale(&before) || !dispense('X', DOSE_ML, flow)) break;
+            delay(SCALE_SETTLE_MS);
+            if (!readScale(&after)) break;
+            worst = max(worst, fabsf(after - before - DOSE_ML));     // Density 1 g/ml
+        }
+        char name[40];
+        snprintf(name, sizeof(name), "dose_error_p99_g.flow_%.0f", flow);
+        if (worst >= 0.0f) {
+            record(name, worst, "g", false);       // Max of DOSE_REPEATS stands in for p99
+        } else {
+            Serial.printf("  %s: no scale reading / move failed\n", name);
+        }
+    }
+}
+
+void soak() {
+    Serial.printf("\n[soak] %d minutes of G4 P0 traffic\n", SOAK_MINUTES);
+    uint32_t start = millis();
+    uint32_t sent = 0, timeouts = 0;
+    uint32_t heapLow = ESP.getFreeHeap();
+    while (millis() - start < (uint32_t)SOAK_MINUTES * 60000) {
+        sendLine("G4 P0");
+        sent++;
+        if (!waitOk(OK_TIMEOUT_MS)) timeouts++;
+        heapLow = min(heapLow, ESP.getFreeHeap());
+    }
+    record("soak_cmds", sent, "cmd", true);
+    record("soak_timeouts", timeouts, "cmd", false);
+    record("soak_heap_min_free_bytes", heapLow, "bytes", true);
+}
+
+void runSuite(bool full) {
+    metricCount = 0;
+    Serial.println("\n╔════════════════════════════════════════════════════════════╗");
+    Serial.println("║              Target Benchmark Suite                        ║");
+    Serial.println("╚════════════════════════════════════════════════════════════╝");
+
+    benchParsers();
+    benchUart();
+    benchEstop();
+    benchLoop();
+    if (full) {
+        benchRecipes();
+        benchDosing();
+    }
+    benchHeap();
+    printJson();
+}
+
+void setup() {
+    Serial.begin(115200);
+    delay(500);
+
+    Serial.println("\n╔════════════════════════════════════════════════════════════╗");
+    Serial.println("║              Test 21: Benchmark Suite                      ║");
+    Serial.println("╚════════════════════════════════════════════════════════════╝\n");
+
+    button_events_init();
+    RodentSerial.begin(115200, SERIAL_8N1, UART_TEST_RX_PIN, UART_TEST_TX_PIN);
+    estop_init(RODENT_UART_NUM, 115200);
+    ScaleSerial.begin(SCALE_BAUD_RATE, SERIAL_8N1, SCALE_RX_PIN, SCALE_TX_PIN);
+    line_framer_init(&rodentRx, rodentBuf, sizeof(rodentBuf), LINE_FRAMER_DROP);
+    line_framer_init(&scaleRx, scaleBuf, sizeof(scaleBuf), LINE_FRAMER_DROP);
+    Serial.println("✓ Rodent UART, e-stop and scale UART initialized");
+
+    Serial.println("\nCommands:");
+    Serial.println("  b  Quick run (parsers, UART, e-stop, loop, heap)");
+    Serial.println("  f  Full run (+ recipes, dosing accuracy - dispenses liquid)");
+    Serial.println("  s  Soak (10 min)");
+    Serial.println("  j  Print last results as JSON\n");
+}
+
+void loop() {
+    estop_service();
+    pollRodentLine();
+
+    if (Serial.available()) {
+        char c = (char)Serial.read();
+        switch (c) {
+            case 'b': runSuite(false); break;
+            case 'f': runSuite(true); break;
+            case 's':
+                metricCount = 0;
+                soak();
+                benchHeap();
+                printJson();
+                break;
+            case 'j': printJson(); break;
+            default: break;
+        }
+    }
+}
@@ -0,0 +1,206 @@
+/**
+ * @file tlm_codec.c
+ * @brief Varint / zigzag frame encoder and decoder for tlm_codec.h
+ */
+
+#include "tlm_codec.h"
+
+#include <math.h>
+#include <string.h>
+
+#define STATUS_STATE_MASK   0x03
+#define STATUS_FAULT        0x04
+#define STATUS_DOSE         0x08
+#define STATUS_MACHINE_SHIFT 4
+
+// ============================================================================
+// PRIMITIVES
+// ============================================================================
+
+static void put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static void put_u64(uint8_t *p, uint64_t v) {
+    for (int i = 0; i < 8; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t get_u64(const uint8_t *p) {
+    uint64_t v = 0;
+    for (int i = 7; i >= 0; i--) v = v << 8 | p[i];
+    return v;
+}
+
+static uint8_t *put_varint(uint8_t *p, uint32_t v) {
+    while (v >= 0x80) {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+static uint8_t *put_svarint(uint8_t *p, int32_t v) {
+    return put_varint(p, ((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+}
+
+static bool get_varint(tlm_codec_decoder_t *d, uint32_t *v) {
+    uint32_t result = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (d->p >= d->end) return false;
+        uint8_t b = *d->p++;
+        result |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            *v = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool get_svarint(tlm_codec_decoder_t *d, int32_t *v) {
+    uint32_t u;
+    if (!get_varint(d, &u)) return false;
+    *v = (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+    return true;
+}
+
+static int32_t to_cg(float g) {
+    if (isnan(g)) return 0;
+    float cg = roundf(g * 100.0f);
+    if (cg > 2.0e9f) return 2000000000;
+    if (cg < -2.0e9f) return -2000000000;
+    return (int32_t)cg;
+}
+
+// ============================================================================
+// ENCODER
+// ============================================================================
+
+void tlm_codec_begin(tlm_codec_encoder_t *e, uint8_t *buf, size_t size, uint32_t frame_seq, bool clock_set) {
+    memset(e, 0, sizeof(*e));
+    e->buf = buf;
+    e->size = size;
+    e->len = TLM_CODEC_HEADER_SIZE;
+    buf[0] = TLM_CODEC_SCHEMA;
+    buf[1] = clock_set ? TLM_CODEC_FLAG_CLOCK : 0;
+    put_u32(buf + 4, frame_seq);
+}
+
+bool tlm_codec_add(tlm_codec_encoder_t *e, const tlm_status_t *s) {
+    if (e->count == UINT16_MAX || e->len + TLM_CODEC_RECORD_MAX > e->size) return false;
+    if (e->count == 0) {
+        e->base_ms = s->time_ms;
+        e->last_ms = s->time_ms;
+    }
+
+    int64_t dt = s->time_ms - e->last_ms;
+    if (dt < 0) dt = 0;                         // Clock stepped back: keep order
+    if (dt > (int64_t)UINT32_MAX) dt = UINT32_MAX;
+    int32_t weight = to_cg(s->weight_g);
+    int32_t dosed = to_cg(s->dosed_g);
+    int32_t target = to_cg(s->target_g);
+    bool dose = e->count == 0 || target != e->last_target_cg || s->pump != e->last_pump ||
+                s->fault != e->last_fault;
+
+    uint8_t *p = e->buf + e->len;
+    p = put_varint(p, (uint32_t)dt);
+    p = put_svarint(p, (int32_t)((uint32_t)weight - (uint32_t)e->last_weight_cg));
+    p = put_svarint(p, (int32_t)((uint32_t)dosed - (uint32_t)e->last_dosed_cg));
+    *p++ = (uint8_t)((s->state & STATUS_STATE_MASK) | (s->fault ? STATUS_FAULT : 0) | (dose ? STATUS_DOSE : 0) |
+                     (s->machine & 0x0F) << STATUS_MACHINE_SHIFT);
+    if (dose) {
+        *p++ = s->pump;
+        p = put_svarint(p, target);
+        *p++ = s->fault;
+    }
+
+    e->len = (size_t)(p - e->buf);
+    e->count++;
+    e->last_ms += dt;
+    e->last_weight_cg = weight;
+    e->last_dosed_cg = dosed;
+    e->last_target_cg = target;
+    e->last_pump = s->pump;
+    e->last_fault = s->fault;
+    return true;
+}
+
+size_t tlm_codec_end(tlm_codec_encoder_t *e) {
+    put_u16(e->buf + 2, e->count);
+    put_u64(e->buf + 8, (uint64_t)e->base_ms);
+    return e->len;
+}
+
+// ============================================================================
+// DECODER
+// ============================================================================
+
+bool tlm_codec_open(tlm_codec_decoder_t *d, const uint8_t *frame, size_t len) {
+    memset(d, 0, sizeof(*d));
+    if (len < TLM_CODEC_HEADER_SIZE || frame[0] != TLM_CODEC_SCHEMA) return false;
+    d->schema = frame[0];
+    d->flags = frame[1];
+    d->count = (uint16_t)(frame[2] | frame[3] << 8);
+    d->frame_seq = get_u32(frame + 4);
+    d->base_ms = (int64_t)get_u64(frame + 8);
+    d->p = frame + TLM_CODEC_HEADER_SIZE;
+    d->end = frame + len;
+    d->remaining = d->count;
+    d->last.time_ms = d->base_ms;
+    return true;
+}
+
+bool tlm_codec_next(tlm_codec_decoder_t *d, tlm_status_t *out) {
+    if (d->remaining == 0 || d->error) return false;
+
+    uint32_t dt;
+    int32_t d_weight;
+    int32_t d_dosed;
+    if (!get_varint(d, &dt) || !get_svarint(d, &d_weight) || !get_svarint(d, &d_dosed) || d->p >= d->end) {
+        d->error = true;
+        return false;
+    }
+    uint8_t status = *d->p++;
+    tlm_status_t s = d->last;
+    if (status & STATUS_DOSE) {
+        int32_t target;
+        if (d->p >= d->end || (s.pump = *d->p++, !get_svarint(d, &target)) || d->p >= d->end) {
+            d->error = true;
+            return false;
+        }
+        s.target_g = (float)target / 100.0f;
+        s.fault = *d->p++;
+    } else if (d->remaining == d->count) {
+        d->error = true;                        // First record must carry the dose block
+        return false;
+    }
+
+    d->weight_cg = (int32_t)((uint32_t)d->weight_cg + (uint32_t)d_weight);
+    d->dosed_cg = (int32_t)((uint32_t)d->dosed_cg + (uint32_t)d_dosed);
+    s.time_ms = d->last.time_ms + dt;
+    s.weight_g = (float)d->weight_cg / 100.0f;
+    s.dosed_g = (float)d->dosed_cg / 100.0f;
+    s.state = status & STATUS_STATE_MASK;
+    s.machine = status >> STATUS_MACHINE_SHIFT;
+    if (!(status & STATUS_FAULT)) s.fault = 0;
+
+    d->last = s;
+    d->remaining--;
+    *out = s;
+    return true;
+}
+
+const char *tlm_codec_state_name(uint8_t state) {
+    static const char *const names[] = {"IDLE", "DOSING", "HOLD", "ESTOP"};
+    return state < 4 ? names[state] : "?";
+}
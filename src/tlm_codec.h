@@ -0,0 +1,147 @@
+/**
+ * @file tlm_codec.h
+ * @brief Compact binary encoding of the station status stream (schema 1)
+ *
+ * Weight and state at 10-20 Hz as JSON costs ~150 bytes per sample; this
+ * schema needs ~4. One frame carries the samples of one publish period:
+ *
+ *   HEADER (16 bytes, little-endian)
+ *     u8   schema          TLM_CODEC_SCHEMA - decoders reject others
+ *     u8   flags           bit 0: times are Unix ms (clock set)
+ *     u16  count           records that follow
+ *     u32  frame_seq       +1 per frame: gaps = frames lost
+ *     i64  base_ms         time of the first record
+ *   RECORD (4..23 bytes)
+ *     varint  dt_ms        since the previous record (first: since base_ms)
+ *     svarint d_weight     scale, centigrams, delta to the previous record
+ *     svarint d_dosed      dosed so far, centigrams, delta
+ *     u8      status       bits 0-1 control state, 2 fault active,
+ *                          3 dose block follows, 4-7 FluidNC state
+ *     [dose block, when pump / target / fault changed or first record]
+ *     u8      pump         0..3
+ *     svarint target       centigrams, absolute
+ *     u8      fault        flow_monitor fault code, 0 = none
+ *
+ * varint = LEB128 (7 bits per byte, low first); svarint = zigzag + varint.
+ * Masses are fixed point 0.01 g (the scale resolution), so a decoded value
+ * is the encoded one rounded to 0.01 g. Deltas restart in every frame: a
+ * lost frame never corrupts the next one.
+ *
+ * RULES:
+ * - A new field or meaning is a new schema number; old decoders refuse it
+ *   rather than mis-read it
+ * - No allocation; encoder and decoder work on caller buffers
+ *
+ * Shared by the firmware (main/) and the host decoder (host/telemetry);
+ * does not depend on ESP-IDF.
+ *
+ * Usage:
+ *   tlm_codec_encoder_t e;
+ *   tlm_codec_begin(&e, buf, sizeof(buf), frame_seq, clock_set);
+ *   while (...) tlm_codec_add(&e, &status);
+ *   size_t len = tlm_codec_end(&e);
+ */
+
+#ifndef TLM_CODEC_H
+#define TLM_CODEC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TLM_CODEC_SCHEMA        1
+#define TLM_CODEC_HEADER_SIZE   16
+#define TLM_CODEC_RECORD_MAX    23          // Worst case bytes per record
+#define TLM_CODEC_FLAG_CLOCK    0x01
+
+/** Control states carried in the status byte (control_state_t of main/app_tasks.h) */
+typedef enum {
+    TLM_STATE_IDLE = 0,
+    TLM_STATE_DOSING,
+    TLM_STATE_HOLD,
+    TLM_STATE_ESTOP,
+} tlm_state_t;
+
+/** One status sample */
+typedef struct {
+    int64_t time_ms;            // Unix ms when the clock is set, else monotonic ms
+    float weight_g;             // Scale
+    float dosed_g;              // Delivered in the current dose
+    float target_g;             // Current dose target, 0 = none
+    uint8_t state;              // tlm_state_t
+    uint8_t machine;            // fluidnc_state_t (0..15)
+    uint8_t pump;               // 0..3
+    uint8_t fault;              // flow_monitor fault code, 0 = none
+} tlm_status_t;
+
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t len;
+    uint16_t count;
+    int64_t base_ms;
+    int64_t last_ms;
+    int32_t last_weight_cg;
+    int32_t last_dosed_cg;
+    int32_t last_target_cg;
+    uint8_t last_pump;
+    uint8_t last_fault;
+} tlm_codec_encoder_t;
+
+typedef struct {
+    uint8_t schema;
+    uint8_t flags;
+    uint16_t count;
+    uint32_t frame_seq;
+    int64_t base_ms;
+
+    const uint8_t *p;
+    const uint8_t *end;
+    uint16_t remaining;
+    bool error;                 // Truncated or malformed record
+    tlm_status_t last;
+    int32_t weight_cg;          // Running totals, exact
+    int32_t dosed_cg;
+} tlm_codec_decoder_t;
+
+/**
+ * @brief Start a frame in buf (at least TLM_CODEC_HEADER_SIZE + TLM_CODEC_RECORD_MAX bytes)
+ */
+void tlm_codec_begin(tlm_codec_encoder_t *e, uint8_t *buf, size_t size, uint32_t frame_seq, bool clock_set);
+
+/**
+ * @brief Append one sample
+ * @return false if the frame is full (the sample is not added)
+ */
+bool tlm_codec_add(tlm_codec_encoder_t *e, const tlm_status_t *s);
+
+/**
+ * @brief Finish the header
+ * @return Frame length in bytes
+ */
+size_t tlm_codec_end(tlm_codec_encoder_t *e);
+
+/**
+ * @brief Parse a frame header
+ * @return false if too short or not schema TLM_CODEC_SCHEMA
+ */
+bool tlm_codec_open(tlm_codec_decoder_t *d, const uint8_t *frame, size_t len);
+
+/**
+ * @brief Next sample of the frame
+ * @return false at the end of the frame, or on a malformed record (d->error)
+ */
+bool tlm_codec_next(tlm_codec_decoder_t *d, tlm_status_t *out);
+
+/** "IDLE", "DOSING", "HOLD", "ESTOP" */
+const char *tlm_codec_state_name(uint8_t state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TLM_CODEC_H
@@ -0,0 +1,199 @@
+/**
+ * @file tlm_store.c
+ * @brief Sector ring with in-place acknowledgement for tlm_store.h
+ */
+
+#include "tlm_store.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define SECTOR_MAGIC        0x51544C54u     // "TLTQ"
+#define STORE_VERSION       1
+#define SLOTS               TLM_STORE_SLOTS_PER_SECTOR
+#define ACK_PENDING         0xFF
+#define ACK_DONE            0x00
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t slot_size;
+    uint16_t reserved;
+    uint32_t first_pos;         // Position of slot 0; the highest is the head sector
+    uint32_t erase_count;
+    uint8_t pad[14];
+    uint16_t crc;
+} sector_header_t;
+
+typedef struct __attribute__((packed)) {
+    uint8_t sample[TLM_STORE_SAMPLE_SIZE];
+    uint16_t crc;               // CRC-16/CCITT of sample
+    uint8_t reserved;
+    uint8_t ack;                // ACK_PENDING -> ACK_DONE in place
+} slot_t;
+
+_Static_assert(sizeof(sector_header_t) == TLM_STORE_SLOT_SIZE, "sector header must be one slot");
+_Static_assert(sizeof(slot_t) == TLM_STORE_SLOT_SIZE, "slot must be 32 bytes");
+
+static uint16_t crc16(const void *data, size_t len) {
+    const uint8_t *p = data;
+    uint16_t crc = 0xFFFF;                      // CRC-16/CCITT-FALSE, as event_log.c
+    while (len--) {
+        crc ^= (uint16_t)(*p++) << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static bool header_valid(const sector_header_t *h) {
+    return h->magic == SECTOR_MAGIC && h->version == STORE_VERSION && h->slot_size == TLM_STORE_SLOT_SIZE &&
+           h->first_pos % SLOTS == 0 && h->crc == crc16(h, offsetof(sector_header_t, crc));
+}
+
+static bool slot_erased(const slot_t *slot) {
+    const uint8_t *p = (const uint8_t *)slot;
+    for (size_t i = 0; i < sizeof(*slot); i++) {
+        if (p[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+static inline uint32_t sector_of(const tlm_store_t *s, uint32_t pos) {
+    return (pos / SLOTS) % s->sectors;
+}
+
+static inline size_t slot_addr(const tlm_store_t *s, uint32_t pos) {
+    return (size_t)sector_of(s, pos) * TLM_STORE_SECTOR_SIZE + TLM_STORE_SLOT_SIZE * (size_t)(pos % SLOTS + 1);
+}
+
+static bool read_header(const tlm_store_t *s, uint32_t sector, sector_header_t *h) {
+    return esp_partition_read(s->part, (size_t)sector * TLM_STORE_SECTOR_SIZE, h, sizeof(*h)) == ESP_OK &&
+           header_valid(h);
+}
+
+static bool read_slot(const tlm_store_t *s, uint32_t pos, slot_t *slot) {
+    return esp_partition_read(s->part, slot_addr(s, pos), slot, sizeof(*slot)) == ESP_OK;
+}
+
+// ============================================================================
+// INIT
+// ============================================================================
+
+bool tlm_store_init(tlm_store_t *s, const char *label) {
+    memset(s, 0, sizeof(*s));
+    s->part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (s->part == NULL) return false;
+    s->sectors = s->part->size / TLM_STORE_SECTOR_SIZE;
+    if (s->sectors < 2) return false;
+
+    // Head sector: highest first position
+    bool found = false;
+    uint32_t head_first = 0;
+    for (uint32_t sec = 0; sec < s->sectors; sec++) {
+        sector_header_t h;
+        if (!read_header(s, sec, &h) || sector_of(s, h.first_pos) != sec) continue;
+        if (h.erase_count > s->max_erase_count) s->max_erase_count = h.erase_count;
+        if (!found || h.first_pos > head_first) head_first = h.first_pos;
+        found = true;
+    }
+    if (!found) return true;                    // Blank: head = tail = 0
+
+    // Head: first erased slot of the head sector; a torn slot closes the sector
+    slot_t slot;
+    uint32_t pos = head_first;
+    while (pos < head_first + SLOTS && read_slot(s, pos, &slot) && !slot_erased(&slot)) {
+        if (slot.crc != crc16(slot.sample, sizeof(slot.sample))) {
+            pos = head_first + SLOTS;
+            break;
+        }
+        pos++;
+    }
+    s->head_pos = pos;
+
+    // Tail: first pending slot, starting at the oldest sector still belonging to this ring
+    uint32_t span = (s->sectors - 1) * SLOTS;
+    uint32_t oldest = head_first >= span ? head_first - span : 0;
+    for (uint32_t first = oldest; first <= head_first; first += SLOTS) {
+        sector_header_t h;
+        if (!read_header(s, sector_of(s, first), &h) || h.first_pos != first) {
+            oldest = first + SLOTS;             // Erased or stale: nothing pending there
+        } else {
+            break;
+        }
+    }
+    s->tail_pos = oldest < s->head_pos ? oldest : s->head_pos;
+    while (s->tail_pos < s->head_pos && read_slot(s, s->tail_pos, &slot) && slot.ack == ACK_DONE) {
+        s->tail_pos++;
+    }
+    return true;
+}
+
+// ============================================================================
+// APPEND / READ / ACK
+// ============================================================================
+
+static bool open_sector(tlm_store_t *s) {
+    // Pending samples in the sector about to be reused are lost
+    uint32_t span = (s->sectors - 1) * SLOTS;
+    if (s->head_pos >= span && s->tail_pos < s->head_pos - span) {
+        s->dropped += s->head_pos - span - s->tail_pos;
+        s->tail_pos = s->head_pos - span;
+    }
+
+    uint32_t sector = sector_of(s, s->head_pos);
+    sector_header_t h;
+    uint32_t erase_count = read_header(s, sector, &h) ? h.erase_count + 1 : 1;
+    if (esp_partition_erase_range(s->part, (size_t)sector * TLM_STORE_SECTOR_SIZE, TLM_STORE_SECTOR_SIZE) !=
+        ESP_OK) {
+        return false;
+    }
+    memset(&h, 0xFF, sizeof(h));
+    h.magic = SECTOR_MAGIC;
+    h.version = STORE_VERSION;
+    h.slot_size = TLM_STORE_SLOT_SIZE;
+    h.first_pos = s->head_pos;
+    h.erase_count = erase_count;
+    h.crc = crc16(&h, offsetof(sector_header_t, crc));
+    if (erase_count > s->max_erase_count) s->max_erase_count = erase_count;
+    return esp_partition_write(s->part, (size_t)sector * TLM_STORE_SECTOR_SIZE, &h, sizeof(h)) == ESP_OK;
+}
+
+bool tlm_store_append(tlm_store_t *s, const void *sample) {
+    if (s->part == NULL) return false;
+    if (s->head_pos % SLOTS == 0 && !open_sector(s)) {
+        s->write_errors++;
+        return false;
+    }
+
+    slot_t slot;
+    memcpy(slot.sample, sample, sizeof(slot.sample));
+    slot.crc = crc16(slot.sample, sizeof(slot.sample));
+    slot.reserved = 0xFF;
+    slot.ack = ACK_PENDING;
+    if (esp_partition_write(s->part, slot_addr(s, s->head_pos), &slot, sizeof(slot)) != ESP_OK) {
+        s->write_errors++;
+        s->head_pos += SLOTS - s->head_pos % SLOTS;     // Damaged slot: continue in a fresh sector
+        return false;
+    }
+    s->head_pos++;
+    return true;
+}
+
+bool tlm_store_read(const tlm_store_t *s, uint32_t pos, void *sample) {
+    slot_t slot;
+    if (s->part == NULL || pos < s->tail_pos || pos >= s->head_pos || !read_slot(s, pos, &slot)) return false;
+    if (slot.crc != crc16(slot.sample, sizeof(slot.sample))) return false;
+    memcpy(sample, slot.sample, sizeof(slot.sample));
+    return true;
+}
+
+void tlm_store_ack(tlm_store_t *s, uint32_t end_pos) {
+    if (end_pos > s->head_pos) end_pos = s->head_pos;
+    static const uint8_t done = ACK_DONE;
+    for (; s->tail_pos < end_pos; s->tail_pos++) {
+        size_t addr = slot_addr(s, s->tail_pos) + offsetof(slot_t, ack);
+        if (esp_partition_write(s->part, addr, &done, 1) != ESP_OK) s->write_errors++;
+    }
+}
@@ -0,0 +1,89 @@
+/**
+ * @file tlm_store.h
+ * @brief Flash outbox for telemetry samples: append, read in order, acknowledge
+ *
+ * Store-and-forward behind telemetry.h. Every must-deliver sample (dose,
+ * batch event) is written here before it is published and stays until the
+ * broker has acknowledged it, so samples survive a broker outage, a WiFi
+ * drop and a reset, and are replayed in their original order.
+ *
+ * LAYOUT:
+ *   A ring of 4 KB sectors like event_log.h: a 32-byte header (magic,
+ *   first position, erase count) and 127 32-byte slots. Positions are
+ *   absolute (+1 per sample, never reused); position p lives in sector
+ *   (p / 127) % sectors. Each slot ends in an ack byte that is 0xFF when
+ *   written and cleared to 0x00 in place once the broker acknowledged the
+ *   sample (a NOR write needs no erase for 1 -> 0), so the first
+ *   unacknowledged position is found again after a reset.
+ *
+ * RULES:
+ * - Single user (the telemetry service); not safe to call from two tasks
+ * - Acknowledgements are in order: tlm_store_ack() moves the tail forward
+ * - When the ring is full the oldest sector is erased anyway: its pending
+ *   samples are dropped and counted (the outage outlasted the store)
+ *
+ * Shared by the firmware (main/) and the host tools; uses esp_partition
+ * (host stand-in in host/esp_idf).
+ */
+
+#ifndef TLM_STORE_H
+#define TLM_STORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_partition.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TLM_STORE_SECTOR_SIZE       4096
+#define TLM_STORE_SLOT_SIZE         32
+#define TLM_STORE_SLOTS_PER_SECTOR  ((TLM_STORE_SECTOR_SIZE - TLM_STORE_SLOT_SIZE) / TLM_STORE_SLOT_SIZE)
+#define TLM_STORE_SAMPLE_SIZE       28
+
+typedef struct {
+    const esp_partition_t *part;
+    uint32_t sectors;
+    uint32_t head_pos;          // Next position to write
+    uint32_t tail_pos;          // First unacknowledged position
+    uint32_t dropped;           // Pending samples lost to a full ring
+    uint32_t write_errors;
+    uint32_t max_erase_count;
+} tlm_store_t;
+
+/**
+ * @brief Find the partition and recover head and tail from flash
+ * @return false if there is no such partition
+ */
+bool tlm_store_init(tlm_store_t *s, const char *label);
+
+/**
+ * @brief Append one sample (TLM_STORE_SAMPLE_SIZE bytes); may erase a sector
+ */
+bool tlm_store_append(tlm_store_t *s, const void *sample);
+
+/**
+ * @brief Sample at a position in [tail_pos, head_pos)
+ * @return false if it is damaged (torn write) - skip it
+ */
+bool tlm_store_read(const tlm_store_t *s, uint32_t pos, void *sample);
+
+/**
+ * @brief Mark [tail_pos, end_pos) acknowledged and move the tail to end_pos
+ */
+void tlm_store_ack(tlm_store_t *s, uint32_t end_pos);
+
+/**
+ * @brief Samples written and not yet acknowledged
+ */
+static inline uint32_t tlm_store_pending(const tlm_store_t *s) {
+    return s->head_pos - s->tail_pos;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TLM_STORE_H
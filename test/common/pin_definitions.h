@@ -65,7 +65,8 @@
 #define LCD_SDA_PIN         GPIO_NUM_21     // I2C Data (safe, no change)
 #define LCD_SCL_PIN         GPIO_NUM_22     // I2C Clock (safe, no change)
 #define LCD_I2C_NUM         I2C_NUM_0       // I2C Port 0
-#define LCD_I2C_ADDR        0x27            // LCD I2C Address (or 0x3F)
+#define LCD_I2C_ADDR        0x27            // LCD I2C Address (PCF8574T backpack)
+#define LCD_I2C_ADDR_ALT    0x3F            // ... PCF8574AT backpack
 #define LCD_I2C_FREQ        100000          // 100kHz I2C frequency
 
 // ============================================================================
@@ -152,7 +153,7 @@
 #define MIN_FLOW_RATE_ML_MIN    1.0         // Minimum flow rate
 #define MAX_FLOW_RATE_ML_MIN    500.0       // Maximum flow rate
 #define MIN_FEEDRATE_MM_MIN     10.0        // Minimum G-code feedrate
-#define MAX_FEEDRATE_MM_MIN     5000.0      // Maximum G-code feedrate
+#define MAX_FEEDRATE_MM_MIN     5000.0      // Maximum G-code feedrate (until FluidNC reports the axis max rate)
 
 // ============================================================================
 // GPIO CONFIGURATION HELPERS